@@ -29,7 +29,10 @@
  *   Nano/Atmega328 PINS:
  *     TX - connect TX pin to RX pin of Additional vga controller board.
  *
+ *   Define VGA_UART_FRAMED here and in vga_server_demo to send crc protected
+ *   and compressed packets instead of plain escaped bytes.
  */
+//#define VGA_UART_FRAMED
 #include "ssd1306.h"
 #include "nano_gfx.h"
 #include "sova.h"
@@ -163,7 +166,11 @@ static void drawLinesDemo()
 void setup()
 {
     ssd1306_setFixedFont(ssd1306xled_font6x8);
+#ifdef VGA_UART_FRAMED
+    ssd1306_uartInit_Framed(57600);
+#else
     ssd1306_uartInit_Builtin(57600);
+#endif
     vga_96x40_8colors_init();
     delay(3000); // wait until VGA monitor starts
 
@@ -51,6 +51,12 @@
 //#define UART_INTERRUPT_ENABLE
 #include "ssd1306_uart.h"
 
+// Must match vga_client_demo. Text commands are only available without it.
+//#define VGA_UART_FRAMED
+#ifdef VGA_UART_FRAMED
+#include "intf/uart/ssd1306_uart_frame.h"
+#endif
+
 /////////////////////////// UART /////////////////////////////////
 
 enum
@@ -166,6 +172,10 @@ void loop()
     if (uart_byte_available())
     {
         uint8_t data = uart_read_byte();
+    #ifdef VGA_UART_FRAMED
+        ssd1306_uartFrameReceive(data);
+    #else
         vga_uart_on_receive(data);
+    #endif
     }
 }
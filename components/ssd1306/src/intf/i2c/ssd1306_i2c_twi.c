@@ -37,6 +37,7 @@
 
 static uint8_t s_sa = SSD1306_SA;
 
+#if !defined(CONFIG_TWI_I2C_ISR_ENABLE)
 static uint8_t ssd1306_twi_start(void)
 {
     uint8_t twst;
@@ -107,6 +108,7 @@ static void ssd1306_i2cStop_Twi(void)
 {
     ssd1306_twi_stop();
 }
+#endif
 
 void ssd1306_i2cConfigure_Twi(uint8_t arg)
 {
@@ -122,6 +124,7 @@ void ssd1306_i2cConfigure_Twi(uint8_t arg)
     TWCR = (1 << TWEN) | (1 << TWEA);
 }
 
+#if !defined(CONFIG_TWI_I2C_ISR_ENABLE)
 static void ssd1306_i2cSendByte_Twi(uint8_t data)
 {
     for(;;)
@@ -157,15 +160,135 @@ static void ssd1306_i2cClose_Twi()
 {
 }
 
+#else
+
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+/* Ring entries are data bytes, or start and stop conditions */
+#define TWI_RING_START  0x100
+#define TWI_RING_STOP   0x200
+#define TWI_RING_MASK   (SSD1306_TWI_RING_SIZE - 1)
+
+static volatile uint16_t s_ring[SSD1306_TWI_RING_SIZE];
+static volatile uint8_t s_ring_head;    // moved by the caller
+static volatile uint8_t s_ring_tail;    // moved by the interrupt
+static volatile uint8_t s_twi_busy;     // interrupt is draining the ring
+static uint8_t s_twi_started;           // start condition of the tail entry is out
+
+/* Runs from TWI interrupt, or with interrupts off */
+static void ssd1306_twi_next(void)
+{
+    for(;;)
+    {
+        if (s_ring_tail == s_ring_head)
+        {
+            /* TWINT stays set and holds SCL low, until more bytes are queued */
+            TWCR = (1<<TWEN);
+            s_twi_busy = 0;
+            return;
+        }
+        uint16_t entry = s_ring[s_ring_tail];
+        if ((entry & TWI_RING_START) && !s_twi_started)
+        {
+            s_twi_started = 1;
+            TWCR = (1<<TWINT) | (1<<TWSTA) | (1<<TWEN) | (1<<TWIE);
+            return;
+        }
+        s_twi_started = 0;
+        s_ring_tail = (s_ring_tail + 1) & TWI_RING_MASK;
+        if (entry & TWI_RING_STOP)
+        {
+            /* No interrupt follows stop, a few microseconds at 400kHz */
+            TWCR = (1<<TWINT) | (1<<TWSTO) | (1<<TWEN);
+            while (TWCR & (1<<TWSTO));
+            continue;
+        }
+        /* Errors are not reported, as our API functions have void type */
+        TWDR = (uint8_t)entry;
+        TWCR = (1<<TWINT) | (1<<TWEN) | (1<<TWIE);
+        return;
+    }
+}
+
+ISR(TWI_vect)
+{
+    ssd1306_twi_next();
+}
+
+static void ssd1306_twi_put(uint16_t entry)
+{
+    uint8_t next = (s_ring_head + 1) & TWI_RING_MASK;
+    /* Ring is full, so the interrupt is draining it */
+    while (next == s_ring_tail);
+    s_ring[s_ring_head] = entry;
+    s_ring_head = next;
+    if (!s_twi_busy)
+    {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            if (!s_twi_busy)
+            {
+                s_twi_busy = 1;
+                ssd1306_twi_next();
+            }
+        }
+    }
+}
+
+static void ssd1306_i2cStart_TwiIsr(void)
+{
+    ssd1306_twi_put(TWI_RING_START | (s_sa << 1));
+}
+
+static void ssd1306_i2cStop_TwiIsr(void)
+{
+    ssd1306_twi_put(TWI_RING_STOP);
+}
+
+static void ssd1306_i2cSendByte_TwiIsr(uint8_t data)
+{
+    ssd1306_twi_put(data);
+}
+
+static void ssd1306_i2cSendBytes_TwiIsr(const uint8_t *buffer, uint16_t size)
+{
+    while (size--)
+    {
+        ssd1306_twi_put(*buffer);
+        buffer++;
+    }
+}
+
+void ssd1306_i2cFlush_Twi(void)
+{
+    while (s_twi_busy);
+}
+
+static void ssd1306_i2cClose_TwiIsr()
+{
+    ssd1306_i2cFlush_Twi();
+}
+
+#endif
+
 void ssd1306_i2cInit_Twi(uint8_t sa)
 {
     if (sa) s_sa = sa;
     ssd1306_intf.spi = 0;
+#if defined(CONFIG_TWI_I2C_ISR_ENABLE)
+    ssd1306_intf.start = ssd1306_i2cStart_TwiIsr;
+    ssd1306_intf.stop = ssd1306_i2cStop_TwiIsr;
+    ssd1306_intf.send = ssd1306_i2cSendByte_TwiIsr;
+    ssd1306_intf.send_buffer = ssd1306_i2cSendBytes_TwiIsr;
+    ssd1306_intf.close = ssd1306_i2cClose_TwiIsr;
+#else
     ssd1306_intf.start = ssd1306_i2cStart_Twi;
     ssd1306_intf.stop = ssd1306_i2cStop_Twi;
     ssd1306_intf.send = ssd1306_i2cSendByte_Twi;
     ssd1306_intf.send_buffer = ssd1306_i2cSendBytes_Twi;
     ssd1306_intf.close = ssd1306_i2cClose_Twi;
+#endif
 }
 
 #endif
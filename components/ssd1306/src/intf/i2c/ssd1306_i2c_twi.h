@@ -61,6 +61,25 @@ void ssd1306_i2cConfigure_Twi(uint8_t arg);
  */
 void ssd1306_i2cInit_Twi(uint8_t sa);
 
+#if defined(CONFIG_TWI_I2C_ISR_ENABLE)
+
+#ifndef SSD1306_TWI_RING_SIZE
+/** Bytes queued for the TWI interrupt, power of 2 up to 128. 2 bytes of RAM each */
+#define SSD1306_TWI_RING_SIZE  32
+#endif
+
+/**
+ * @ingroup LCD_HW_INTERFACE_API
+ *
+ * Waits until the TWI interrupt sent all queued bytes.
+ * With CONFIG_TWI_I2C_ISR_ENABLE, ssd1306_i2cInit_Twi() sets up send functions,
+ * which only queue bytes and return, and the TWI interrupt sends them. They wait
+ * only while the queue is full, so global interrupts must be enabled.
+ */
+void ssd1306_i2cFlush_Twi(void);
+
+#endif
+
 #ifdef __cplusplus
 }
 #endif
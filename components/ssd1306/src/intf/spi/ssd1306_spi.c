@@ -49,6 +49,9 @@ void ssd1306_spiInit(int8_t cesPin, int8_t dcPin)
 
 void ssd1306_spiDataMode(uint8_t mode)
 {
+#ifdef CONFIG_SSD1306_INTF_TRACE_ENABLE
+    ssd1306_intfTraceDataMode(mode);
+#endif
     if (s_ssd1306_dc)
     {
         digitalWrite(s_ssd1306_dc, mode ? HIGH : LOW);
@@ -24,7 +24,10 @@
 
 #include "ssd1306_interface.h"
 #include "spi/ssd1306_spi.h"
+#include "lcd/lcd_common.h"
+#include "ssd1306_hal/io.h"
 #include <stddef.h>
+#include <string.h>
 
 static void ssd1306_send_buffer_generic(const uint8_t* buffer, uint16_t size);
 
@@ -51,6 +54,50 @@ void ssd1306_dataStart(void)
         ssd1306_intf.send(0x40);
 }
 
+static uint8_t s_command_batch[SSD1306_COMMAND_BATCH_SIZE];
+static uint8_t s_command_batch_len = 0;
+
+void ssd1306_commandBatchAdd(uint8_t command)
+{
+    if (s_command_batch_len < SSD1306_COMMAND_BATCH_SIZE)
+    {
+        s_command_batch[s_command_batch_len++] = command;
+    }
+}
+
+void ssd1306_commandBatchSend(void)
+{
+    ssd1306_commandStart();
+    ssd1306_intf.send_buffer(s_command_batch, s_command_batch_len);
+    ssd1306_intf.stop();
+    s_command_batch_len = 0;
+}
+
+void ssd1306_commandBatchDataStart(void)
+{
+    if (ssd1306_intf.spi)
+    {
+        ssd1306_commandStart();
+        ssd1306_intf.send_buffer(s_command_batch, s_command_batch_len);
+        ssd1306_spiDataMode(1);
+    }
+    else
+    {
+        // Co=1 D/C=0 before each command, Co=0 D/C=1 turns the rest into data
+        uint8_t buffer[SSD1306_COMMAND_BATCH_SIZE * 2 + 1];
+        uint8_t len = 0;
+        for (uint8_t i = 0; i < s_command_batch_len; i++)
+        {
+            buffer[len++] = 0x80;
+            buffer[len++] = s_command_batch[i];
+        }
+        buffer[len++] = 0x40;
+        ssd1306_intf.start();
+        ssd1306_intf.send_buffer(buffer, len);
+    }
+    s_command_batch_len = 0;
+}
+
 void ssd1306_sendCommand(uint8_t command)
 {
     ssd1306_commandStart();
@@ -66,3 +113,361 @@ void ssd1306_send_buffer_generic(const uint8_t* buffer, uint16_t size)
         buffer++;
     }
 }
+
+/* Bytes on the stack for transports without send_fill, a multiple of 1 to 4 byte patterns */
+#define SSD1306_FILL_BLOCK_SIZE  24
+
+void ssd1306_intfSendPattern(const uint8_t *pattern, uint8_t size, uint32_t count)
+{
+    uint8_t block[SSD1306_FILL_BLOCK_SIZE];
+    uint8_t len = SSD1306_FILL_BLOCK_SIZE / size * size;
+    if (ssd1306_intf.send_fill && !memcmp(pattern, pattern + 1, size - 1))
+    {
+        // black and white 16-bit pixels are single byte fills
+        ssd1306_intfSendFill(pattern[0], count * size);
+        return;
+    }
+    for (uint8_t i = 0; i < len; i++)
+    {
+        block[i] = pattern[i % size];
+    }
+    count *= size;
+    while (count)
+    {
+        uint8_t n = count > len ? len : count;
+        ssd1306_intf.send_buffer(block, n);
+        count -= n;
+    }
+}
+
+void ssd1306_intfSendFill(uint8_t data, uint32_t count)
+{
+    if (ssd1306_intf.send_fill)
+    {
+        while (count)
+        {
+            uint16_t n = count > 0xFFFF ? 0xFFFF : count;
+            ssd1306_intf.send_fill(data, n);
+            count -= n;
+        }
+        return;
+    }
+    ssd1306_intfSendPattern(&data, 1, count);
+}
+
+#ifdef CONFIG_SSD1306_INTF_STATS_ENABLE
+
+// functions of the interface while the counters are attached
+static ssd1306_interface_t s_stats_intf;
+static ssd1306_intf_stats_t s_stats;
+static uint32_t s_stats_start_us;
+
+static void ssd1306_statsStart(void)
+{
+    s_stats_start_us = micros();
+    s_stats_intf.start();
+}
+
+static void ssd1306_statsStop(void)
+{
+    s_stats_intf.stop();
+    uint32_t us = micros() - s_stats_start_us;
+    s_stats.transactions++;
+    s_stats.busy_us += us;
+    if (us > s_stats.max_us)
+    {
+        s_stats.max_us = us;
+    }
+}
+
+static void ssd1306_statsSend(uint8_t data)
+{
+    s_stats.bytes++;
+    s_stats.sends++;
+    s_stats_intf.send(data);
+}
+
+static void ssd1306_statsSendBuffer(const uint8_t *buffer, uint16_t size)
+{
+    s_stats.bytes += size;
+    s_stats.sends++;
+    if (s_stats_intf.send_buffer == ssd1306_send_buffer_generic)
+    {
+        // the generic one goes through ssd1306_intf.send, which counts again
+        while (size--)
+        {
+            s_stats_intf.send(*buffer++);
+        }
+    }
+    else
+    {
+        s_stats_intf.send_buffer(buffer, size);
+    }
+}
+
+void ssd1306_intfStatsAttach(void)
+{
+    if (ssd1306_intf.start == ssd1306_statsStart)
+    {
+        return;
+    }
+    s_stats_intf = ssd1306_intf;
+    ssd1306_intf.start = ssd1306_statsStart;
+    ssd1306_intf.stop = ssd1306_statsStop;
+    ssd1306_intf.send = ssd1306_statsSend;
+    ssd1306_intf.send_buffer = ssd1306_statsSendBuffer;
+    // fills go through ssd1306_statsSendBuffer
+    ssd1306_intf.send_fill = NULL;
+    // display drivers take copies of the send functions at init
+    if (ssd1306_lcd.send_pixels1 == s_stats_intf.send)
+        ssd1306_lcd.send_pixels1 = ssd1306_statsSend;
+    if (ssd1306_lcd.send_pixels8 == s_stats_intf.send)
+        ssd1306_lcd.send_pixels8 = ssd1306_statsSend;
+    if (ssd1306_lcd.send_pixels_buffer1 == s_stats_intf.send_buffer)
+        ssd1306_lcd.send_pixels_buffer1 = ssd1306_statsSendBuffer;
+    if (ssd1306_lcd.send_pixels_buffer8 == s_stats_intf.send_buffer)
+        ssd1306_lcd.send_pixels_buffer8 = ssd1306_statsSendBuffer;
+}
+
+void ssd1306_intfStatsDetach(void)
+{
+    if (ssd1306_intf.start != ssd1306_statsStart)
+    {
+        return;
+    }
+    ssd1306_intf.start = s_stats_intf.start;
+    ssd1306_intf.stop = s_stats_intf.stop;
+    ssd1306_intf.send = s_stats_intf.send;
+    ssd1306_intf.send_buffer = s_stats_intf.send_buffer;
+    ssd1306_intf.send_fill = s_stats_intf.send_fill;
+    if (ssd1306_lcd.send_pixels1 == ssd1306_statsSend)
+        ssd1306_lcd.send_pixels1 = s_stats_intf.send;
+    if (ssd1306_lcd.send_pixels8 == ssd1306_statsSend)
+        ssd1306_lcd.send_pixels8 = s_stats_intf.send;
+    if (ssd1306_lcd.send_pixels_buffer1 == ssd1306_statsSendBuffer)
+        ssd1306_lcd.send_pixels_buffer1 = s_stats_intf.send_buffer;
+    if (ssd1306_lcd.send_pixels_buffer8 == ssd1306_statsSendBuffer)
+        ssd1306_lcd.send_pixels_buffer8 = s_stats_intf.send_buffer;
+}
+
+void ssd1306_intfStatsGet(ssd1306_intf_stats_t *stats)
+{
+    *stats = s_stats;
+}
+
+void ssd1306_intfStatsReset(void)
+{
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
+#endif
+
+#ifdef CONFIG_SSD1306_INTF_TRACE_ENABLE
+
+// functions of the interface while the trace is recorded
+static ssd1306_interface_t s_trace_intf;
+static uint8_t *s_trace_buf;
+static uint16_t s_trace_size;
+static uint16_t s_trace_len = 0;
+static uint16_t s_trace_run;      // offset of the length of the open data event, 0 for none
+static uint32_t s_trace_last_us;
+static uint32_t s_trace_dropped;
+static void (*s_trace_flush)(const uint8_t *data, uint16_t len);
+
+static void ssd1306_traceFlush(void)
+{
+    if (s_trace_flush && s_trace_len)
+    {
+        s_trace_flush(s_trace_buf, s_trace_len);
+        s_trace_len = 0;
+    }
+    s_trace_run = 0;
+}
+
+static uint8_t ssd1306_traceRoom(uint16_t need)
+{
+    if ((uint32_t)s_trace_len + need <= s_trace_size)
+    {
+        return 1;
+    }
+    ssd1306_traceFlush();
+    return (uint32_t)s_trace_len + need <= s_trace_size;
+}
+
+static uint8_t ssd1306_traceEvent(uint8_t type, uint16_t extra)
+{
+    // type, up to 5 bytes of varint
+    if (!ssd1306_traceRoom(6 + extra))
+    {
+        s_trace_dropped++;
+        return 0;
+    }
+    uint32_t now = micros();
+    uint32_t delta = now - s_trace_last_us;
+    s_trace_last_us = now;
+    s_trace_buf[s_trace_len++] = type;
+    while (delta >= 0x80)
+    {
+        s_trace_buf[s_trace_len++] = (delta & 0x7F) | 0x80;
+        delta >>= 7;
+    }
+    s_trace_buf[s_trace_len++] = delta;
+    s_trace_run = 0;
+    return 1;
+}
+
+static void ssd1306_traceData(const uint8_t *data, uint16_t size)
+{
+    while (size)
+    {
+        if (!s_trace_run)
+        {
+            if (!ssd1306_traceEvent(SSD1306_TRACE_DATA, 2 + 1))
+            {
+                return;
+            }
+            s_trace_run = s_trace_len;
+            s_trace_buf[s_trace_len++] = 0;
+            s_trace_buf[s_trace_len++] = 0;
+        }
+        uint16_t run = s_trace_buf[s_trace_run] | (s_trace_buf[s_trace_run + 1] << 8);
+        uint16_t chunk = s_trace_size - s_trace_len;
+        if (chunk > size) chunk = size;
+        if (chunk > 0xFFFF - run) chunk = 0xFFFF - run;
+        if (!chunk)
+        {
+            // full buffer or run, the rest goes to a new data event
+            if (s_trace_len == s_trace_size)
+            {
+                if (!s_trace_flush)
+                {
+                    s_trace_dropped++;
+                    return;
+                }
+                ssd1306_traceFlush();
+            }
+            s_trace_run = 0;
+            continue;
+        }
+        memcpy(&s_trace_buf[s_trace_len], data, chunk);
+        s_trace_len += chunk;
+        run += chunk;
+        s_trace_buf[s_trace_run] = run & 0xFF;
+        s_trace_buf[s_trace_run + 1] = run >> 8;
+        data += chunk;
+        size -= chunk;
+    }
+}
+
+static void ssd1306_traceStart(void)
+{
+    ssd1306_traceEvent(SSD1306_TRACE_START, 0);
+    s_trace_intf.start();
+}
+
+static void ssd1306_traceStop(void)
+{
+    s_trace_intf.stop();
+    ssd1306_traceEvent(SSD1306_TRACE_STOP, 0);
+}
+
+static void ssd1306_traceSend(uint8_t data)
+{
+    ssd1306_traceData(&data, 1);
+    s_trace_intf.send(data);
+}
+
+static void ssd1306_traceSendBuffer(const uint8_t *buffer, uint16_t size)
+{
+    ssd1306_traceData(buffer, size);
+    if (s_trace_intf.send_buffer == ssd1306_send_buffer_generic)
+    {
+        // the generic one goes through ssd1306_intf.send, which records again
+        while (size--)
+        {
+            s_trace_intf.send(*buffer++);
+        }
+    }
+    else
+    {
+        s_trace_intf.send_buffer(buffer, size);
+    }
+}
+
+void ssd1306_intfTraceDataMode(uint8_t mode)
+{
+    if (ssd1306_intf.start == ssd1306_traceStart)
+    {
+        ssd1306_traceEvent(mode ? SSD1306_TRACE_DC_HIGH : SSD1306_TRACE_DC_LOW, 0);
+    }
+}
+
+void ssd1306_intfTraceAttach(uint8_t *buffer, uint16_t size,
+                             void (*flush)(const uint8_t *data, uint16_t len))
+{
+    if (ssd1306_intf.start == ssd1306_traceStart || size < 32)
+    {
+        return;
+    }
+    s_trace_buf = buffer;
+    s_trace_size = size;
+    s_trace_flush = flush;
+    s_trace_run = 0;
+    s_trace_dropped = 0;
+    s_trace_last_us = micros();
+    memcpy(buffer, "SSDT", 4);
+    buffer[4] = SSD1306_TRACE_VERSION;
+    buffer[5] = ssd1306_intf.spi ? 1 : 0;
+    buffer[6] = 0;
+    buffer[7] = 0;
+    s_trace_len = SSD1306_TRACE_HEADER_SIZE;
+    s_trace_intf = ssd1306_intf;
+    ssd1306_intf.start = ssd1306_traceStart;
+    ssd1306_intf.stop = ssd1306_traceStop;
+    ssd1306_intf.send = ssd1306_traceSend;
+    ssd1306_intf.send_buffer = ssd1306_traceSendBuffer;
+    ssd1306_intf.send_fill = NULL;
+    // display drivers take copies of the send functions at init
+    if (ssd1306_lcd.send_pixels1 == s_trace_intf.send)
+        ssd1306_lcd.send_pixels1 = ssd1306_traceSend;
+    if (ssd1306_lcd.send_pixels8 == s_trace_intf.send)
+        ssd1306_lcd.send_pixels8 = ssd1306_traceSend;
+    if (ssd1306_lcd.send_pixels_buffer1 == s_trace_intf.send_buffer)
+        ssd1306_lcd.send_pixels_buffer1 = ssd1306_traceSendBuffer;
+    if (ssd1306_lcd.send_pixels_buffer8 == s_trace_intf.send_buffer)
+        ssd1306_lcd.send_pixels_buffer8 = ssd1306_traceSendBuffer;
+}
+
+void ssd1306_intfTraceDetach(void)
+{
+    if (ssd1306_intf.start != ssd1306_traceStart)
+    {
+        return;
+    }
+    ssd1306_intf.start = s_trace_intf.start;
+    ssd1306_intf.stop = s_trace_intf.stop;
+    ssd1306_intf.send = s_trace_intf.send;
+    ssd1306_intf.send_buffer = s_trace_intf.send_buffer;
+    ssd1306_intf.send_fill = s_trace_intf.send_fill;
+    if (ssd1306_lcd.send_pixels1 == ssd1306_traceSend)
+        ssd1306_lcd.send_pixels1 = s_trace_intf.send;
+    if (ssd1306_lcd.send_pixels8 == ssd1306_traceSend)
+        ssd1306_lcd.send_pixels8 = s_trace_intf.send;
+    if (ssd1306_lcd.send_pixels_buffer1 == ssd1306_traceSendBuffer)
+        ssd1306_lcd.send_pixels_buffer1 = s_trace_intf.send_buffer;
+    if (ssd1306_lcd.send_pixels_buffer8 == ssd1306_traceSendBuffer)
+        ssd1306_lcd.send_pixels_buffer8 = s_trace_intf.send_buffer;
+    ssd1306_traceFlush();
+}
+
+uint16_t ssd1306_intfTraceLength(void)
+{
+    return s_trace_len;
+}
+
+uint32_t ssd1306_intfTraceDropped(void)
+{
+    return s_trace_dropped;
+}
+
+#endif
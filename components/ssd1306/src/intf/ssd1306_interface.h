@@ -78,6 +78,17 @@ typedef struct
      * @param size - number of bytes to send
      */
     void (*send_buffer)(const uint8_t *buffer, uint16_t size);
+    /**
+     * @brief Sends the same byte count times
+     *
+     * Optional, transports can fill their buffers in place or use a DMA pattern.
+     * Transports leaving it NULL are served through send_buffer, use
+     * ssd1306_intfSendFill() instead of calling it directly.
+     *
+     * @param data - byte to send
+     * @param count - number of times to send it
+     */
+    void (*send_fill)(uint8_t data, uint16_t count);
     /**
      * @brief deinitializes internal resources, allocated for interface.
      *
@@ -93,6 +104,95 @@ typedef struct
  */
 extern ssd1306_interface_t ssd1306_intf;
 
+#ifdef CONFIG_SSD1306_INTF_STATS_ENABLE
+/** Traffic through ssd1306_intf since the last ssd1306_intfStatsReset() */
+typedef struct
+{
+    uint32_t transactions;  ///< start() and stop() pairs
+    uint32_t bytes;         ///< bytes sent, command and control bytes included
+    uint32_t sends;         ///< send() and send_buffer() calls
+    uint32_t busy_us;       ///< time from start() to the return of stop(), summed
+    uint32_t max_us;        ///< longest transaction
+} ssd1306_intf_stats_t;
+
+/**
+ * Routes the calls of the current interface, and of the display driver set up
+ * on it, through counters. Call it once the display is initialized, instances
+ * saved by ssd1306_displayEnd() before that are not counted.
+ */
+void ssd1306_intfStatsAttach(void);
+
+/**
+ * Restores the functions replaced by ssd1306_intfStatsAttach(). Counters keep their values.
+ */
+void ssd1306_intfStatsDetach(void);
+
+/**
+ * Copies the counters to stats
+ */
+void ssd1306_intfStatsGet(ssd1306_intf_stats_t *stats);
+
+/**
+ * Sets all counters to 0
+ */
+void ssd1306_intfStatsReset(void);
+#endif
+
+#ifdef CONFIG_SSD1306_INTF_TRACE_ENABLE
+/**
+ * A trace starts with the 8 byte header "SSDT", SSD1306_TRACE_VERSION, 1 for spi, 0 for i2c,
+ * and 2 zero bytes. Each event follows as one byte type, the microseconds since the
+ * previous event as LEB128 varint, then for SSD1306_TRACE_DATA a 16-bit little endian
+ * length and the bytes. Consecutive send() calls are merged into one data event.
+ */
+#define SSD1306_TRACE_VERSION    1
+#define SSD1306_TRACE_HEADER_SIZE 8
+
+/** Event types of the trace */
+enum
+{
+    SSD1306_TRACE_START = 1,   ///< ssd1306_intf.start()
+    SSD1306_TRACE_STOP  = 2,   ///< ssd1306_intf.stop()
+    SSD1306_TRACE_DATA  = 3,   ///< bytes passed to send() or send_buffer()
+    SSD1306_TRACE_DC_LOW  = 4, ///< ssd1306_spiDataMode(0), command mode
+    SSD1306_TRACE_DC_HIGH = 5, ///< ssd1306_spiDataMode(1), data mode
+};
+
+/**
+ * Routes the calls of the current interface, and of the display driver set up
+ * on it, through the trace recorder, as ssd1306_intfStatsAttach() does.
+ * Events are stored in buffer. When it is full, it is passed to flush and reused,
+ * without flush further events are dropped.
+ * @param buffer - memory for the trace, at least 32 bytes
+ * @param size - size of buffer
+ * @param flush - called with the recorded bytes, i.e. to write them to a file, or NULL
+ */
+void ssd1306_intfTraceAttach(uint8_t *buffer, uint16_t size,
+                             void (*flush)(const uint8_t *data, uint16_t len));
+
+/**
+ * Restores the functions replaced by ssd1306_intfTraceAttach() and passes
+ * the rest of the trace to flush.
+ */
+void ssd1306_intfTraceDetach(void);
+
+/**
+ * Returns bytes of the trace held in the buffer, header included. Without flush
+ * the whole trace stays there after ssd1306_intfTraceDetach().
+ */
+uint16_t ssd1306_intfTraceLength(void);
+
+/**
+ * Returns number of events dropped because the buffer was full.
+ */
+uint32_t ssd1306_intfTraceDropped(void);
+
+/**
+ * Records a D/C change, called by ssd1306_spiDataMode().
+ */
+void ssd1306_intfTraceDataMode(uint8_t mode);
+#endif
+
 /**
  * Deprecated
  */
@@ -140,6 +240,46 @@ void ssd1306_commandStart(void);
  */
 void ssd1306_dataStart(void);
 
+/** Commands a batch holds, further ones are dropped */
+#define SSD1306_COMMAND_BATCH_SIZE  16
+
+/**
+ * Appends command or command argument to the batch sent by
+ * ssd1306_commandBatchSend() or ssd1306_commandBatchDataStart().
+ * @param command - command byte to add
+ */
+void ssd1306_commandBatchAdd(uint8_t command);
+
+/**
+ * Sends all batched commands in a single transaction and empties the batch.
+ */
+void ssd1306_commandBatchSend(void);
+
+/**
+ * Sends all batched commands and leaves the transaction open for bitmap data,
+ * as ssd1306_dataStart() does. Over i2c every command goes with a continuation
+ * control byte, so commands and data share one transaction. This suits
+ * the ssd1306 and compatible controllers.
+ */
+void ssd1306_commandBatchDataStart(void);
+
+/**
+ * Sends data count times in the open transaction, through ssd1306_intf.send_fill
+ * if the transport has it, or in blocks through ssd1306_intf.send_buffer.
+ * @param data - byte to send
+ * @param count - number of times to send it
+ */
+void ssd1306_intfSendFill(uint8_t data, uint32_t count);
+
+/**
+ * Sends a pattern of up to 4 bytes count times in the open transaction,
+ * i.e. both bytes of a 16-bit pixel.
+ * @param pattern - bytes to repeat
+ * @param size - number of bytes in pattern, 1 to 4
+ * @param count - number of times to send the pattern
+ */
+void ssd1306_intfSendPattern(const uint8_t *pattern, uint8_t size, uint32_t count);
+
 /**
  * @}
  */
@@ -31,6 +31,7 @@
 #if defined(CONFIG_AVR_UART_AVAILABLE) && defined(CONFIG_AVR_UART_ENABLE)
 
 #include "ssd1306_uart.h"
+#include "ssd1306_uart_frame.h"
 
 static void ssd1306_uartStart(void)
 {
@@ -72,4 +73,11 @@ void ssd1306_uartInit_Builtin(uint32_t baud)
     ssd1306_intf.close = ssd1306_uartStart;
 }
 
+void ssd1306_uartInit_Framed(uint32_t baud)
+{
+    if (!baud) baud = 115200;
+    uart_init(baud);
+    ssd1306_uartFrameInit(uart_send_byte);
+}
+
 #endif
@@ -48,6 +48,18 @@ extern "C" {
  */
 void ssd1306_uartInit_Builtin(uint32_t baud);
 
+/**
+ * @ingroup LCD_HW_INTERFACE_API
+ *
+ * Initializes uart transport, which sends display traffic in crc protected and
+ * compressed packets, described in ssd1306_uart_frame.h. Other side should pass
+ * received bytes to ssd1306_uartFrameReceive().
+ * @param baud uart baud rate, 0 for 115200
+ *
+ * @note: after call to this function you need to initialize lcd display.
+ */
+void ssd1306_uartInit_Framed(uint32_t baud);
+
 #ifdef __cplusplus
 }
 #endif
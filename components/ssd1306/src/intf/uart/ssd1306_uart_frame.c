@@ -0,0 +1,320 @@
+/*
+    MIT License
+
+    Copyright (c) 2018, Alexey Dynda
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "ssd1306_uart_frame.h"
+#include "intf/ssd1306_interface.h"
+#include <string.h>
+
+#if SSD1306_UART_FRAME_SIZE > 250
+#error "SSD1306_UART_FRAME_SIZE must fit packet length byte"
+#endif
+
+#define FRAME_FLAG       0x7E
+#define FRAME_ESCAPE     0x7D
+/* PackBits adds a byte per 128 bytes of literals at most */
+#define FRAME_PAYLOAD_MAX  (SSD1306_UART_FRAME_SIZE + SSD1306_UART_FRAME_SIZE / 128 + 1)
+
+static uint16_t ssd1306_frameCrc(uint16_t crc, uint8_t data)
+{
+    crc ^= (uint16_t)data << 8;
+    for (uint8_t i=8; i>0; i--)
+    {
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+    return crc;
+}
+
+///////////////////////////////// SENDER //////////////////////////////////////
+
+static void (*s_frame_send)(uint8_t data);
+static uint8_t s_tx[SSD1306_UART_FRAME_SIZE];
+static uint8_t s_tx_len = 0;
+static uint8_t s_tx_flags = 0;
+
+static void ssd1306_framePut(uint8_t data)
+{
+    if ((data == FRAME_FLAG) || (data == FRAME_ESCAPE))
+    {
+        s_frame_send(FRAME_ESCAPE);
+        data ^= 0x20;
+    }
+    s_frame_send(data);
+}
+
+/* PackBits: n < 128 is followed by n+1 literal bytes, n > 128 by a byte repeated 257-n times */
+static uint8_t ssd1306_framePack(const uint8_t *src, uint8_t len, uint8_t *dst)
+{
+    uint8_t out = 0;
+    uint8_t i = 0;
+    while (i < len)
+    {
+        uint8_t run = 1;
+        while ((i + run < len) && (run < 128) && (src[i + run] == src[i]))
+        {
+            run++;
+        }
+        if (run >= 2)
+        {
+            dst[out++] = 257 - run;
+            dst[out++] = src[i];
+            i += run;
+            continue;
+        }
+        // literals up to the next run of 3 bytes, shorter runs are not worth the header
+        uint8_t start = i;
+        uint8_t count = 0;
+        while ((i < len) && (count < 128))
+        {
+            if ((i + 2 < len) && (src[i] == src[i + 1]) && (src[i] == src[i + 2]))
+            {
+                break;
+            }
+            i++;
+            count++;
+        }
+        dst[out++] = count - 1;
+        memcpy(&dst[out], &src[start], count);
+        out += count;
+    }
+    return out;
+}
+
+static void ssd1306_frameFlush(uint8_t flags)
+{
+    uint8_t packed[FRAME_PAYLOAD_MAX];
+    const uint8_t *payload = s_tx;
+    uint8_t len = s_tx_len;
+    uint8_t packed_len = ssd1306_framePack(s_tx, s_tx_len, packed);
+    if (packed_len < len)
+    {
+        payload = packed;
+        len = packed_len;
+        flags |= SSD1306_UART_FRAME_RLE;
+    }
+    uint16_t crc = ssd1306_frameCrc(0xFFFF, flags);
+    crc = ssd1306_frameCrc(crc, len);
+    if (flags & SSD1306_UART_FRAME_FIRST)
+    {
+        s_frame_send(FRAME_FLAG);
+    }
+    ssd1306_framePut(flags);
+    ssd1306_framePut(len);
+    for (uint8_t i=0; i<len; i++)
+    {
+        crc = ssd1306_frameCrc(crc, payload[i]);
+        ssd1306_framePut(payload[i]);
+    }
+    ssd1306_framePut(crc & 0xFF);
+    ssd1306_framePut(crc >> 8);
+    s_frame_send(FRAME_FLAG);
+    s_tx_len = 0;
+}
+
+static void ssd1306_frameStart(void)
+{
+    s_tx_len = 0;
+    s_tx_flags = SSD1306_UART_FRAME_FIRST;
+}
+
+static void ssd1306_frameStop(void)
+{
+    ssd1306_frameFlush(s_tx_flags | SSD1306_UART_FRAME_LAST);
+}
+
+static void ssd1306_frameSendBytes(const uint8_t *buffer, uint16_t len)
+{
+    while (len)
+    {
+        uint8_t chunk = SSD1306_UART_FRAME_SIZE - s_tx_len;
+        if (chunk > len)
+        {
+            chunk = len;
+        }
+        memcpy(&s_tx[s_tx_len], buffer, chunk);
+        s_tx_len += chunk;
+        buffer += chunk;
+        len -= chunk;
+        if (s_tx_len == SSD1306_UART_FRAME_SIZE)
+        {
+            ssd1306_frameFlush(s_tx_flags);
+            s_tx_flags = 0;
+        }
+    }
+}
+
+static void ssd1306_frameSendByte(uint8_t data)
+{
+    ssd1306_frameSendBytes(&data, 1);
+}
+
+static void ssd1306_frameClose(void)
+{
+}
+
+void ssd1306_uartFrameInit(void (*send)(uint8_t data))
+{
+    s_frame_send = send;
+    ssd1306_intf.spi = 0;
+    ssd1306_intf.start = ssd1306_frameStart;
+    ssd1306_intf.stop = ssd1306_frameStop;
+    ssd1306_intf.send = ssd1306_frameSendByte;
+    ssd1306_intf.send_buffer = ssd1306_frameSendBytes;
+    ssd1306_intf.close = ssd1306_frameClose;
+}
+
+///////////////////////////////// RECEIVER ////////////////////////////////////
+
+// flags, length, payload, crc
+static uint8_t s_rx[2 + FRAME_PAYLOAD_MAX + 2];
+static uint8_t s_rx_len = 0;
+static uint8_t s_rx_escape = 0;
+static uint8_t s_rx_overflow = 0;
+static uint8_t s_rx_open = 0;     // transaction is started on the display
+static uint8_t s_rx_skip = 0;     // rest of a damaged transaction is dropped
+static uint16_t s_rx_errors = 0;
+
+static void ssd1306_frameRepeat(uint8_t data, uint8_t count)
+{
+    uint8_t block[16];
+    memset(block, data, sizeof(block));
+    while (count)
+    {
+        uint8_t n = count > sizeof(block) ? sizeof(block) : count;
+        ssd1306_intf.send_buffer(block, n);
+        count -= n;
+    }
+}
+
+static void ssd1306_frameUnpack(const uint8_t *src, uint8_t len)
+{
+    uint8_t i = 0;
+    while (i < len)
+    {
+        uint8_t n = src[i++];
+        if (n < 128)
+        {
+            n = (n + 1 > len - i) ? len - i : n + 1;
+            ssd1306_intf.send_buffer(&src[i], n);
+            i += n;
+        }
+        else if ((n > 128) && (i < len))
+        {
+            ssd1306_frameRepeat(src[i++], 257 - n);
+        }
+    }
+}
+
+static void ssd1306_frameApply(void)
+{
+    uint8_t flags = s_rx[0];
+    uint8_t len = s_rx[1];
+    uint16_t crc = 0xFFFF;
+    for (uint8_t i=0; i < s_rx_len - 2; i++)
+    {
+        crc = ssd1306_frameCrc(crc, s_rx[i]);
+    }
+    if (s_rx_overflow || (len != s_rx_len - 4) ||
+        (crc != (s_rx[s_rx_len - 2] | ((uint16_t)s_rx[s_rx_len - 1] << 8))))
+    {
+        s_rx_errors++;
+        if (s_rx_open)
+        {
+            ssd1306_intf.stop();
+            s_rx_open = 0;
+        }
+        s_rx_skip = 1;
+        return;
+    }
+    if (flags & SSD1306_UART_FRAME_FIRST)
+    {
+        if (s_rx_open)
+        {
+            ssd1306_intf.stop();
+        }
+        ssd1306_intf.start();
+        s_rx_open = 1;
+        s_rx_skip = 0;
+    }
+    if (s_rx_skip || !s_rx_open)
+    {
+        return;
+    }
+    if (flags & SSD1306_UART_FRAME_RLE)
+    {
+        ssd1306_frameUnpack(&s_rx[2], len);
+    }
+    else
+    {
+        ssd1306_intf.send_buffer(&s_rx[2], len);
+    }
+    if (flags & SSD1306_UART_FRAME_LAST)
+    {
+        ssd1306_intf.stop();
+        s_rx_open = 0;
+    }
+}
+
+void ssd1306_uartFrameReceive(uint8_t data)
+{
+    if (data == FRAME_FLAG)
+    {
+        // empty frames between packets are fine, a torn one is an error
+        if (s_rx_len >= 4 || s_rx_overflow)
+        {
+            ssd1306_frameApply();
+        }
+        else if (s_rx_len)
+        {
+            s_rx_errors++;
+            s_rx_skip = 1;
+        }
+        s_rx_len = 0;
+        s_rx_escape = 0;
+        s_rx_overflow = 0;
+        return;
+    }
+    if (data == FRAME_ESCAPE)
+    {
+        s_rx_escape = 1;
+        return;
+    }
+    if (s_rx_escape)
+    {
+        data ^= 0x20;
+        s_rx_escape = 0;
+    }
+    if (s_rx_len < sizeof(s_rx))
+    {
+        s_rx[s_rx_len++] = data;
+    }
+    else
+    {
+        s_rx_overflow = 1;
+    }
+}
+
+uint16_t ssd1306_uartFrameErrors(void)
+{
+    return s_rx_errors;
+}
@@ -0,0 +1,89 @@
+/*
+    MIT License
+
+    Copyright (c) 2018, Alexey Dynda
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+/**
+ * @file ssd1306_uart_frame.h framed transport of the display traffic over a serial link
+ *
+ * @details Each transaction, started by ssd1306_intf.start() and finished by
+ *          ssd1306_intf.stop(), is cut into packets of up to SSD1306_UART_FRAME_SIZE bytes:
+ *
+ *          [0x7E], flags, length, payload[length], crc16 (lsb first), 0x7E
+ *
+ *          Leading 0x7E is sent only before the first packet of a transaction.
+ *          flags has SSD1306_UART_FRAME_FIRST on the first packet of a transaction,
+ *          SSD1306_UART_FRAME_LAST on the last one, and SSD1306_UART_FRAME_RLE when payload
+ *          is PackBits compressed. crc16 is CRC-16/CCITT-FALSE over flags, length and payload.
+ *          0x7E and 0x7D in between are sent as 0x7D followed by the byte ^ 0x20, so
+ *          receivers resynchronize on the next 0x7E after a lost byte.
+ *          The transport works as i2c: the first byte of a transaction is 0x00 for commands
+ *          or 0x40 for display data.
+ */
+
+#ifndef _SSD1306_UART_FRAME_H_
+#define _SSD1306_UART_FRAME_H_
+
+#include "ssd1306_hal/io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SSD1306_UART_FRAME_SIZE
+/** Transaction bytes carried by one packet, larger packets cost RAM on both sides */
+#define SSD1306_UART_FRAME_SIZE  64
+#endif
+
+#define SSD1306_UART_FRAME_FIRST  0x01  ///< packet starts transaction
+#define SSD1306_UART_FRAME_LAST   0x02  ///< packet ends transaction
+#define SSD1306_UART_FRAME_RLE    0x04  ///< payload is PackBits compressed
+
+/**
+ * @ingroup LCD_HW_INTERFACE_API
+ *
+ * Sets ssd1306_intf up to send the display traffic as framed packets through send.
+ * For the AVR USART there is ssd1306_uartInit_Framed().
+ * @param send function writing one byte to the serial link
+ *
+ * @note: after call to this function you need to initialize lcd display.
+ */
+void ssd1306_uartFrameInit(void (*send)(uint8_t data));
+
+/**
+ * Processes byte received from the serial link. Complete packets are passed
+ * to the display interface, set up on the receiving side, i.e. vga controller.
+ * Packets with a wrong crc are dropped along with the rest of their transaction.
+ * @param data byte received
+ */
+void ssd1306_uartFrameReceive(uint8_t data);
+
+/**
+ * Returns number of packets dropped by ssd1306_uartFrameReceive().
+ */
+uint16_t ssd1306_uartFrameErrors(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SSD1306_UART_FRAME_H_ */
@@ -87,6 +87,33 @@ static inline void vga_controller_put_pixels(uint8_t x, uint8_t y, uint8_t pixel
     }
 }
 
+/*
+ * Function sends 8 columns of 8 vertical pixels to buffer, x must be a multiple of 8.
+ * The columns are transposed to the 8 scan line bytes they cover, so each buffer
+ * byte is stored once instead of being masked bit by bit.
+ */
+static inline void vga_controller_put_block(uint8_t x, uint8_t y, const uint8_t *columns)
+{
+    uint8_t lines[8] = {0};
+    volatile uint8_t *p = &__vga_buffer[(x >> 3) + (uint16_t)(y * 16)];
+    for (uint8_t j=0; j<8; j++)
+    {
+        uint8_t pixels = columns[j];
+        // left column ends up in bit 0, as vga_controller_put_pixels() sets it
+        for (uint8_t i=0; i<8; i++)
+        {
+            lines[i] >>= 1;
+            if (pixels & 0x01) lines[i] |= 0x80;
+            pixels >>= 1;
+        }
+    }
+    for (uint8_t i=0; i<8; i++)
+    {
+        *p = lines[i];
+        p += 16;
+    }
+}
+
 static void vga_controller_send_byte(uint8_t data)
 {
     if (s_vga_command == 0xFF)
@@ -132,10 +159,26 @@ static void vga_controller_send_byte(uint8_t data)
 
 static void vga_controller_send_bytes(const uint8_t *buffer, uint16_t len)
 {
-    while (len--)
+    while (len)
     {
-        ssd1306_intf.send(*buffer);
+        // whole bytes of the scan lines are written, when 8 columns are aligned to them
+        if ((s_vga_command == 0x40) && (len >= 8) && !(s_cursor_x & 0x07) &&
+            (s_cursor_x + 7 <= s_column_end) && (s_cursor_y < 64))
+        {
+            vga_controller_put_block(s_cursor_x, s_cursor_y, buffer);
+            buffer += 8;
+            len -= 8;
+            s_cursor_x += 8;
+            if (s_cursor_x > s_column_end)
+            {
+                s_cursor_x = s_column;
+                s_cursor_y += 8;
+            }
+            continue;
+        }
+        vga_controller_send_byte(*buffer);
         buffer++;
+        len--;
     }
 }
 
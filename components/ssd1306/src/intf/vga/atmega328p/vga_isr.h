@@ -30,7 +30,9 @@
  * If you want to use vga_controller module in debug mode without producing VGA output,
  * define VGA_CONTROLLER_DEBUG before including this header. If you want to use library with
  * AVR sleep mode, then jitter fix is not required, you will able to use TIMER0, so define
- * SSD1306_VGA_SLEEP_MODE before including this header.
+ * SSD1306_VGA_SLEEP_MODE before including this header. Define SSD1306_VGA_LINE_POINTERS
+ * to use h-sync ISR, which follows the buffer by line pointer only, without scan line
+ * counters. It spends less cycles per line, but picture may need new DEJITTER_OFFSET.
  */
 
 #ifndef _SSD1306_VGA_ATMEGA328P_ISR_H_
@@ -91,18 +93,30 @@ static const uint8_t V_BACKPORCH_LINES = 40;
 
 // Lines to skip before starting to draw first line of the screen content
 // This includes V-sync signal + front porch
+#if defined(SSD1306_VGA_LINE_POINTERS)
+// Scan lines left to output from s_current_scan_line_data
+volatile uint8_t s_scan_line_index;
+// End of the buffer, output stops when the line pointer gets there
+static const volatile uint8_t * const __VGA_BUFFER_END =
+        &__vga_buffer[__VGA_VERTICAL_PIXELS * __VGA_LINE_BYTES];
+#else
 volatile int s_current_scan_line;
+volatile uint8_t s_scan_line_index;
+#endif
 
 volatile uint8_t s_lines_to_skip;
-volatile uint8_t s_scan_line_index;
 volatile const uint8_t * volatile s_current_scan_line_data = __VGA_BUFFER_PTR;
 extern volatile uint8_t s_vga_frames;
 extern unsigned long timer0_millis;
 // ISR: Vsync pulse
 ISR(TIMER1_OVF_vect)
 {
+#if defined(SSD1306_VGA_LINE_POINTERS)
+    s_scan_line_index = __VGA_PIXEL_HEIGHT;
+#else
     s_current_scan_line = 0;
     s_scan_line_index = 0;
+#endif
     s_current_scan_line_data = __VGA_BUFFER_PTR;
     s_lines_to_skip = V_BACKPORCH_LINES;
     s_vga_frames++;
@@ -222,10 +236,18 @@ ISR(TIMER2_COMPB_vect) // for end of h-sync pulse
         s_lines_to_skip--;
         return;
     }
+#if defined(SSD1306_VGA_LINE_POINTERS)
+    // 16-bit compare of the pointer, no counters are read here
+    else if (s_current_scan_line_data == __VGA_BUFFER_END)
+    {
+        return;
+    }
+#else
     else if (s_current_scan_line >= VGA_TOTAL_MODE_LINES)
     {
         return;
     }
+#endif
     #ifndef SSD1306_VGA_SLEEP_MODE
     // This is dejitter code, it purpose to start pixels output at the same offset after h-sync
     asm volatile(
@@ -251,6 +273,13 @@ ISR(TIMER2_COMPB_vect) // for end of h-sync pulse
     : "r30", "r31", "r24", "r25");
     #endif
     do_scan_line();
+#if defined(SSD1306_VGA_LINE_POINTERS)
+    if ( !--s_scan_line_index )
+    {
+        s_scan_line_index = __VGA_PIXEL_HEIGHT;
+        s_current_scan_line_data += __VGA_LINE_BYTES;
+    }
+#else
     s_current_scan_line++;
     s_scan_line_index++;
     if ( s_scan_line_index >= __VGA_PIXEL_HEIGHT )
@@ -258,6 +287,7 @@ ISR(TIMER2_COMPB_vect) // for end of h-sync pulse
         s_scan_line_index=0;
         s_current_scan_line_data += __VGA_LINE_BYTES;
     }
+#endif
 }
 
 #endif  // VGA_CONTROLLER_DEBUG
@@ -0,0 +1,209 @@
+/*
+    MIT License
+
+    Copyright (c) 2018, Alexey Dynda
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+/**
+ * @file display_ssd1306.h SSD1306 driver resolved at compile time
+ */
+
+#ifndef _DISPLAY_SSD1306_H_
+#define _DISPLAY_SSD1306_H_
+
+#ifdef __cplusplus
+
+#include "ssd1306_hal/io.h"
+#include "nano_gfx_types.h"
+#include "lcd/ssd1306_commands.h"
+
+/**
+ * @ingroup LCD_INTERFACE_API
+ * @{
+ */
+
+/**
+ * SSD1306 driver bound to its transport at compile time. Unlike the C api,
+ * where every byte goes through ssd1306_lcd and ssd1306_intf function
+ * pointers, the send loops inline into the interface. Over i2c the address
+ * window and the data of a block go in one transaction.
+ *
+ * @code
+ *  InterfaceEspI2C<> bus;
+ *  DisplaySSD1306<InterfaceEspI2C<>> oled(bus);
+ *
+ *  bus.begin();
+ *  oled.begin();
+ *  oled.clear();
+ * @endcode
+ *
+ * @tparam I transport with start(), send(), sendBuffer(), dataMode(), stop()
+ *         and a static spi flag
+ * @tparam W width in pixels
+ * @tparam H height in pixels, 32 or 64
+ */
+template <class I, lcduint_t W = 128, lcduint_t H = 64>
+class DisplaySSD1306
+{
+public:
+    static const lcduint_t width = W;
+    static const lcduint_t height = H;
+    static const uint8_t pages = H / 8;
+
+    explicit DisplaySSD1306(I &intf)
+        : m_intf(intf)
+    {
+    }
+
+    /**
+     * Sends the init sequence of ssd1306_128x64_init(), or of the 128x32
+     * panel when H is 32.
+     */
+    void begin()
+    {
+        const uint8_t init[] =
+        {
+            SSD1306_DISPLAYOFF,
+            SSD1306_MEMORYMODE, HORIZONTAL_ADDRESSING_MODE,
+            SSD1306_COMSCANDEC,
+            SSD1306_SETSTARTLINE | 0x00,
+            SSD1306_SETCONTRAST, 0x7F,
+            SSD1306_SEGREMAP | 0x01,
+            SSD1306_NORMALDISPLAY,
+            SSD1306_SETMULTIPLEX, H - 1,
+            SSD1306_SETDISPLAYOFFSET, 0x00,
+            SSD1306_SETDISPLAYCLOCKDIV, 0x80,
+            SSD1306_SETPRECHARGE, 0x22,
+            SSD1306_SETCOMPINS, H == 64 ? 0x12 : 0x02,
+            SSD1306_SETVCOMDETECT, 0x20,
+            SSD1306_CHARGEPUMP, 0x14,
+            SSD1306_DISPLAYALLON_RESUME,
+            SSD1306_DISPLAYON,
+        };
+        commands(init, sizeof(init));
+    }
+
+    /**
+     * Sends commands in one transaction.
+     */
+    void commands(const uint8_t *cmds, uint8_t len)
+    {
+        m_intf.start();
+        commandMode();
+        m_intf.sendBuffer(cmds, len);
+        m_intf.stop();
+    }
+
+    /**
+     * Opens the block of w columns from x and pages from page down for data,
+     * close it with end().
+     */
+    inline void setBlock(lcduint_t x, uint8_t page, lcduint_t w)
+    {
+        const uint8_t cmds[] =
+        {
+            SSD1306_COLUMNADDR, (uint8_t)x, (uint8_t)(w ? (x + w - 1) : (W - 1)),
+            SSD1306_PAGEADDR, page, (uint8_t)(pages - 1),
+        };
+        m_intf.start();
+        if (I::spi)
+        {
+            commandMode();
+            m_intf.sendBuffer(cmds, sizeof(cmds));
+            dataMode();
+        }
+        else
+        {
+            // Co=1 control byte before each command, then the rest is data
+            for (uint8_t i = 0; i < sizeof(cmds); i++)
+            {
+                m_intf.send(0x80);
+                m_intf.send(cmds[i]);
+            }
+            m_intf.send(0x40);
+        }
+    }
+
+    /** Sends 8 vertical pixels of the block */
+    inline void sendPixels(uint8_t data)
+    {
+        m_intf.send(data);
+    }
+
+    inline void end()
+    {
+        m_intf.stop();
+    }
+
+    /**
+     * Draws a buffer in ssd1306 page layout.
+     * @param x left column
+     * @param page top page
+     * @param w width in pixels
+     * @param h height in pages
+     * @param buf w * h bytes
+     */
+    void drawBuffer(lcduint_t x, uint8_t page, lcduint_t w, uint8_t h, const uint8_t *buf)
+    {
+        setBlock(x, page, w);
+        m_intf.sendBuffer(buf, w * h);
+        end();
+    }
+
+    void fill(uint8_t pattern)
+    {
+        setBlock(0, 0, 0);
+        for (uint16_t i = 0; i < W * pages; i++)
+        {
+            sendPixels(pattern);
+        }
+        end();
+    }
+
+    void clear()
+    {
+        fill(0x00);
+    }
+
+private:
+    I &m_intf;
+
+    inline void commandMode()
+    {
+        if (I::spi)
+            m_intf.dataMode(0);
+        else
+            m_intf.send(0x00);
+    }
+
+    inline void dataMode()
+    {
+        if (I::spi)
+            m_intf.dataMode(1);
+    }
+};
+
+/**
+ * @}
+ */
+
+#endif
+
+#endif // _DISPLAY_SSD1306_H_
@@ -25,12 +25,22 @@
 #include "lcd/lcd_common.h"
 #include "intf/ssd1306_interface.h"
 #include "intf/spi/ssd1306_spi.h"
+#include "nano_gfx_types.h"
 #include <stddef.h>
 
-#define CMD_ARG 0xFF
+#if defined(__AVR__)
+#define RGB16_LINE_BYTES  2
+#else
+#define RGB16_LINE_BYTES  32
+#endif
+
+extern uint16_t ssd1306_color;
 
 ssd1306_lcd_t ssd1306_lcd = { 0 };
 
+/* RGB565 pixels, converted for a single send_buffer() call */
+static uint8_t s_line16[RGB16_LINE_BYTES * 16];
+
 void ssd1306_sendData(uint8_t data)
 {
     ssd1306_dataStart();
@@ -51,23 +61,44 @@ void ssd1306_configureI2cDisplay(const uint8_t *config, uint8_t configSize)
 
 void ssd1306_configureSpiDisplay(const uint8_t *config, uint8_t configSize)
 {
+    // bytes are collected while D/C stays the same
+    uint8_t run[16];
+    uint8_t len = 0;
+    uint8_t dc = 0;
     ssd1306_intf.start();
     ssd1306_spiDataMode(0);
     for( uint8_t i=0; i<configSize; i++)
     {
         uint8_t data = pgm_read_byte(&config[i]);
+        uint8_t level = 0;
+        if (data == CMD_DELAY)
+        {
+            if (len) ssd1306_intf.send_buffer(run, len);
+            len = 0;
+            ssd1306_intf.stop();
+            delay(pgm_read_byte(&config[++i]));
+            ssd1306_intf.start();
+            continue;
+        }
         if (data == CMD_ARG)
         {
             data = pgm_read_byte(&config[++i]);
-            ssd1306_spiDataMode(1);
-            ssd1306_intf.send(data);
-            ssd1306_spiDataMode(0);
+            level = 1;
         }
-        else
+        if ((level != dc) || (len == sizeof(run)))
         {
-            ssd1306_intf.send(data);
+            if (len) ssd1306_intf.send_buffer(run, len);
+            len = 0;
+            if (level != dc)
+            {
+                ssd1306_spiDataMode(level);
+                dc = level;
+            }
         }
+        run[len++] = data;
     }
+    if (len) ssd1306_intf.send_buffer(run, len);
+    if (dc) ssd1306_spiDataMode(0);
     ssd1306_intf.stop();
 }
 
@@ -91,3 +122,109 @@ void ssd1306_resetController(int8_t rstPin, uint8_t delayMs)
     digitalWrite(rstPin, HIGH);
 }
 
+void ssd1306_sendPixelsRgb16(const uint8_t *buffer, uint16_t len)
+{
+    // 8 pixels of 2 bytes for each monochrome byte
+    uint8_t hi = ssd1306_color >> 8;
+    uint8_t lo = ssd1306_color;
+    while (len)
+    {
+        uint16_t count = len < RGB16_LINE_BYTES ? len : RGB16_LINE_BYTES;
+        uint8_t *p = s_line16;
+        for (uint16_t i = 0; i < count; i++)
+        {
+            uint8_t data = buffer[i];
+            for (uint8_t bit = 8; bit > 0; bit--)
+            {
+                if (data & 0x01)
+                {
+                    p[0] = hi;
+                    p[1] = lo;
+                }
+                else
+                {
+                    p[0] = 0;
+                    p[1] = 0;
+                }
+                p += 2;
+                data >>= 1;
+            }
+        }
+        ssd1306_intf.send_buffer(s_line16, count * 16);
+        buffer += count;
+        len -= count;
+    }
+}
+
+#if !defined(__AVR__)
+/* RGB8_TO_RGB16() for every 3-3-2 color, big endian as the controllers take it */
+#define RGB8_LUT1(c)  RGB8_TO_RGB16((c))
+#define RGB8_LUT4(c)  RGB8_LUT1(c), RGB8_LUT1((c) + 1), RGB8_LUT1((c) + 2), RGB8_LUT1((c) + 3)
+#define RGB8_LUT16(c) RGB8_LUT4(c), RGB8_LUT4((c) + 4), RGB8_LUT4((c) + 8), RGB8_LUT4((c) + 12)
+#define RGB8_LUT64(c) RGB8_LUT16(c), RGB8_LUT16((c) + 16), RGB8_LUT16((c) + 32), RGB8_LUT16((c) + 48)
+
+static const uint16_t s_rgb8ToRgb16[256] =
+{
+    RGB8_LUT64(0), RGB8_LUT64(64), RGB8_LUT64(128), RGB8_LUT64(192)
+};
+#endif
+
+void ssd1306_sendPixels8Rgb16(const uint8_t *buffer, uint16_t len)
+{
+    while (len)
+    {
+        uint16_t count = len < sizeof(s_line16) / 2 ? len : sizeof(s_line16) / 2;
+        uint8_t *p = s_line16;
+        for (uint16_t i = 0; i < count; i++)
+        {
+#if defined(__AVR__)
+            // 512 bytes of table are too much there, shifts are cheap anyway
+            uint16_t color = RGB8_TO_RGB16(buffer[i]);
+#else
+            uint16_t color = s_rgb8ToRgb16[buffer[i]];
+#endif
+            p[0] = color >> 8;
+            p[1] = color;
+            p += 2;
+        }
+        ssd1306_intf.send_buffer(s_line16, count * 2);
+        buffer += count;
+        len -= count;
+    }
+}
+
+void ssd1306_sendPixels4Rgb16(const uint8_t *buffer, uint16_t len, const uint16_t *palette)
+{
+    // even number of pixels per line, so that each line starts with a high nibble
+    const uint16_t maxCount = (sizeof(s_line16) / 2) & ~1;
+    while (len)
+    {
+        uint16_t count = len < maxCount ? len : maxCount;
+        uint8_t *p = s_line16;
+        for (uint16_t i = count >> 1; i; i--, p += 4)
+        {
+            uint8_t data = *buffer++;
+            uint16_t left = palette[data >> 4];
+            uint16_t right = palette[data & 0x0F];
+            p[0] = left >> 8;
+            p[1] = left;
+            p[2] = right >> 8;
+            p[3] = right;
+        }
+        if (count & 1)
+        {
+            // odd row width, only the last pixel of a row can be alone
+            uint16_t color = palette[*buffer >> 4];
+            p[0] = color >> 8;
+            p[1] = color;
+        }
+        ssd1306_intf.send_buffer(s_line16, count * 2);
+        len -= count;
+    }
+}
+
+void ssd1306_sendPixelRgb16(uint8_t data)
+{
+    ssd1306_sendPixelsRgb16(&data, 1);
+}
+
@@ -141,6 +141,14 @@ typedef struct
      */
     void (*send_pixels8)(uint8_t data);
 
+    /**
+     * Sends buffer of RGB pixels encoded in 3-3-2 format, as many calls of
+     * send_pixels8() would do. NULL for monochrome displays.
+     * @param buffer - buffer containing RGB8 pixels.
+     * @param len - number of pixels in buffer.
+     */
+    void (*send_pixels_buffer8)(const uint8_t *buffer, uint16_t len);
+
     /**
      * @brief Sets library display mode for direct draw functions.
      *
@@ -239,13 +247,20 @@ void         ssd1306_sendData(uint8_t data) __attribute__ ((deprecated));
  */
 #define ssd1306_sendPixel8        ssd1306_lcd.send_pixels8
 
+/** Marks the next byte of ssd1306_configureSpiDisplay() table as command argument */
+#define CMD_ARG     0xFF
+
+/** Makes ssd1306_configureSpiDisplay() wait for the milliseconds given in the next byte */
+#define CMD_DELAY   0xFE
+
 /**
  * @brief Sends configuration being passed to lcd display i2c/spi controller.
  *
  * Sends configuration being passed to lcd display i2c/spi controller.
- * The data bytes are sent to lcd controller as is. In case of spi display
- * this function sends cmd arguments in command mode. If lcd controller requires
- * arguments to be sent in data mode, please use ssd1306_configureSpiDisplay().
+ * The data bytes are sent to lcd controller as is, in a single transaction.
+ * In case of spi display this function sends cmd arguments in command mode.
+ * If lcd controller requires arguments to be sent in data mode, please use
+ * ssd1306_configureSpiDisplay().
  *
  * @param config configuration, located in flash, to send to i2c/spi controller.
  * @param configSize - size of configuration data in bytes.
@@ -259,7 +274,10 @@ void ssd1306_configureI2cDisplay(const uint8_t *config, uint8_t configSize);
  * to be sent is less than 255, then data byte is sent in command mode. If data byte
  * is 0xFF, the function does't send it to controller, but switches to spi data mode,
  * and next byte after will be sent in data spi mode. Then the function will switch back
- * to command mode. If lcd controller requires cmd arguments to be sent in command mode,
+ * to command mode. CMD_DELAY followed by a byte waits that many milliseconds, i.e.
+ * after sleep out. Bytes of the same mode are sent together, and the whole configuration
+ * goes in one transaction, unless it has delays.
+ * If lcd controller requires cmd arguments to be sent in command mode,
  * please use ssd1306_configureI2cDisplay().
  *
  * @param config configuration, located in flash, to send to i2c/spi controller.
@@ -294,6 +312,42 @@ void ssd1306_setMode(lcd_mode_t mode);
  */
 void ssd1306_resetController(int8_t rstPin, uint8_t delayMs);
 
+/**
+ * Sends monochrome pixels to a controller in 16-bit RGB mode, set bits as
+ * ssd1306_color, cleared ones as black. Bytes are expanded into a line of
+ * RGB565 pixels, which goes out with a single ssd1306_intf.send_buffer() call.
+ *
+ * @param buffer monochrome pixels, bit 0 of each byte first
+ * @param len number of bytes in buffer
+ */
+void ssd1306_sendPixelsRgb16(const uint8_t *buffer, uint16_t len);
+
+/**
+ * Sends RGB8 pixels to a controller in 16-bit RGB mode. Pixels are converted
+ * to RGB565 lines, which go out with single ssd1306_intf.send_buffer() calls.
+ *
+ * @param buffer pixels in 3-3-2 format
+ * @param len number of pixels in buffer
+ */
+void ssd1306_sendPixels8Rgb16(const uint8_t *buffer, uint16_t len);
+
+/**
+ * Sends 4-bit palette pixels to a controller in 16-bit RGB mode, converted to
+ * RGB565 lines as ssd1306_sendPixels8Rgb16() does.
+ *
+ * @param buffer pixels, 2 in each byte, the high nibble first
+ * @param len number of pixels to send
+ * @param palette 16 RGB565 colors, located in RAM
+ */
+void ssd1306_sendPixels4Rgb16(const uint8_t *buffer, uint16_t len, const uint16_t *palette);
+
+/**
+ * Sends 8 monochrome pixels as ssd1306_sendPixelsRgb16() does.
+ *
+ * @param data monochrome pixels, bit 0 first
+ */
+void ssd1306_sendPixelRgb16(uint8_t data);
+
 /**
  * Macro SSD1306_COMPAT_SPI_BLOCK_8BIT_CMDS() generates 2 static functions,
  * applicable for many oled controllers with 8-bit commands:
@@ -32,9 +32,6 @@
 #include "sdl_core.h"
 #endif
 
-#define CMD_ARG     0xFF
-
-extern uint16_t ssd1306_color;
 extern uint32_t s_ssd1306_spi_clock;
 
 static uint8_t s_rotation = 0x00;
@@ -192,33 +189,6 @@ void    il9163_setMode(lcd_mode_t mode)
     s_rotation = mode ? 0x00 : 0x04;
 }
 
-static void il9163_sendPixels(uint8_t data)
-{
-    for (uint8_t i=8; i>0; i--)
-    {
-        if ( data & 0x01 )
-        {
-            ssd1306_intf.send( (uint8_t)(ssd1306_color>>8) );
-            ssd1306_intf.send( (uint8_t)(ssd1306_color) );
-        }
-        else
-        {
-            ssd1306_intf.send( 0B00000000 );
-            ssd1306_intf.send( 0B00000000 );
-        }
-        data >>= 1;
-    }
-}
-
-static void il9163_sendPixelsBuffer(const uint8_t *buffer, uint16_t len)
-{
-    while(len--)
-    {
-        il9163_sendPixels(*buffer);
-        buffer++;
-    }
-}
-
 static void il9163_sendPixel8(uint8_t data)
 {
     uint16_t color = RGB8_TO_RGB16(data);
@@ -234,9 +204,10 @@ void    il9163_128x128_init()
     s_rgb_bit = 0b00001000; // set BGR mode mapping
     ssd1306_lcd.set_block = il9163_setBlock;
     ssd1306_lcd.next_page = il9163_nextPage;
-    ssd1306_lcd.send_pixels1  = il9163_sendPixels;
-    ssd1306_lcd.send_pixels_buffer1 = il9163_sendPixelsBuffer;
+    ssd1306_lcd.send_pixels1  = ssd1306_sendPixelRgb16;
+    ssd1306_lcd.send_pixels_buffer1 = ssd1306_sendPixelsRgb16;
     ssd1306_lcd.send_pixels8 = il9163_sendPixel8;
+    ssd1306_lcd.send_pixels_buffer8 = ssd1306_sendPixels8Rgb16;
     ssd1306_lcd.set_mode = il9163_setMode;
     ssd1306_configureSpiDisplay(s_oled128x128_initData, sizeof(s_oled128x128_initData));
 }
@@ -370,9 +341,10 @@ void    st7735_128x160_init()
     s_rgb_bit = 0b00000000; // set RGB mode mapping
     ssd1306_lcd.set_block = st7735_setBlock;
     ssd1306_lcd.next_page = il9163_nextPage;
-    ssd1306_lcd.send_pixels1  = il9163_sendPixels;
-    ssd1306_lcd.send_pixels_buffer1 = il9163_sendPixelsBuffer;
+    ssd1306_lcd.send_pixels1  = ssd1306_sendPixelRgb16;
+    ssd1306_lcd.send_pixels_buffer1 = ssd1306_sendPixelsRgb16;
     ssd1306_lcd.send_pixels8 = il9163_sendPixel8;
+    ssd1306_lcd.send_pixels_buffer8 = ssd1306_sendPixels8Rgb16;
     ssd1306_lcd.set_mode = il9163_setMode;
     ssd1306_configureSpiDisplay(s_oled128x160_initData, sizeof(s_oled128x160_initData));
 }
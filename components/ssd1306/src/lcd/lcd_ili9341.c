@@ -32,9 +32,6 @@
 #include "sdl_core.h"
 #endif
 
-#define CMD_ARG     0xFF
-
-extern uint16_t ssd1306_color;
 extern uint32_t s_ssd1306_spi_clock;
 
 static uint8_t s_rotation = 0x00;
@@ -160,33 +157,6 @@ void    ili9341_setMode(lcd_mode_t mode)
     }
 }
 
-static void ili9341_sendPixels(uint8_t data)
-{
-    for (uint8_t i=8; i>0; i--)
-    {
-        if ( data & 0x01 )
-        {
-            ssd1306_intf.send( (uint8_t)(ssd1306_color>>8) );
-            ssd1306_intf.send( (uint8_t)(ssd1306_color) );
-        }
-        else
-        {
-            ssd1306_intf.send( 0B00000000 );
-            ssd1306_intf.send( 0B00000000 );
-        }
-        data >>= 1;
-    }
-}
-
-static void ili9341_sendPixelsBuffer(const uint8_t *buffer, uint16_t len)
-{
-    while(len--)
-    {
-        ili9341_sendPixels(*buffer);
-        buffer++;
-    }
-}
-
 static void ili9341_sendPixel8(uint8_t data)
 {
     uint16_t color = RGB8_TO_RGB16(data);
@@ -202,9 +172,10 @@ void    ili9341_240x320_init()
     s_rgb_bit = 0b00001000; // set BGR mode mapping
     ssd1306_lcd.set_block = ili9341_setBlock;
     ssd1306_lcd.next_page = ili9341_nextPage;
-    ssd1306_lcd.send_pixels1  = ili9341_sendPixels;
-    ssd1306_lcd.send_pixels_buffer1 = ili9341_sendPixelsBuffer;
+    ssd1306_lcd.send_pixels1  = ssd1306_sendPixelRgb16;
+    ssd1306_lcd.send_pixels_buffer1 = ssd1306_sendPixelsRgb16;
     ssd1306_lcd.send_pixels8 = ili9341_sendPixel8;
+    ssd1306_lcd.send_pixels_buffer8 = ssd1306_sendPixels8Rgb16;
     ssd1306_lcd.set_mode = ili9341_setMode;
     ssd1306_configureSpiDisplay(s_oled240x320_initData, sizeof(s_oled240x320_initData));
 }
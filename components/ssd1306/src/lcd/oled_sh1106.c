@@ -104,10 +104,7 @@ void    sh1106_128x64_init()
     ssd1306_lcd.send_pixels1 = ssd1306_intf.send;
     ssd1306_lcd.send_pixels_buffer1 = ssd1306_intf.send_buffer;
     ssd1306_lcd.set_mode = sh1106_setMode;
-    for( uint8_t i=0; i<sizeof(s_oled128x64_initData); i++)
-    {
-        ssd1306_sendCommand(pgm_read_byte(&s_oled128x64_initData[i]));
-    }
+    ssd1306_configureI2cDisplay(s_oled128x64_initData, sizeof(s_oled128x64_initData));
 }
 
 void    sh1106_128x64_i2c_init()
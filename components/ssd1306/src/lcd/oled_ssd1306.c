@@ -84,27 +84,13 @@ static const uint8_t PROGMEM s_oled128x32_initData[] =
 
 static void ssd1306_setBlock(lcduint_t x, lcduint_t y, lcduint_t w)
 {
-    ssd1306_intf.start();
-    if (ssd1306_intf.spi)
-        ssd1306_spiDataMode(0);
-    else
-        ssd1306_intf.send(0x00);
-    ssd1306_intf.send(SSD1306_COLUMNADDR);
-    ssd1306_intf.send(x);
-    ssd1306_intf.send(w ? (x + w - 1) : (ssd1306_lcd.width - 1));
-    ssd1306_intf.send(SSD1306_PAGEADDR);
-    ssd1306_intf.send(y);
-    ssd1306_intf.send((ssd1306_lcd.height >> 3) - 1);
-    if (ssd1306_intf.spi)
-    {
-        ssd1306_spiDataMode(1);
-    }
-    else
-    {
-        ssd1306_intf.stop();
-        ssd1306_intf.start();
-        ssd1306_intf.send(0x40);
-    }
+    ssd1306_commandBatchAdd(SSD1306_COLUMNADDR);
+    ssd1306_commandBatchAdd(x);
+    ssd1306_commandBatchAdd(w ? (x + w - 1) : (ssd1306_lcd.width - 1));
+    ssd1306_commandBatchAdd(SSD1306_PAGEADDR);
+    ssd1306_commandBatchAdd(y);
+    ssd1306_commandBatchAdd((ssd1306_lcd.height >> 3) - 1);
+    ssd1306_commandBatchDataStart();
 }
 
 static void ssd1306_nextPage(void)
@@ -166,6 +152,63 @@ void ssd1306_flipVertical(uint8_t mode)
     }
 }
 
+void ssd1306_setStartLine(uint8_t line)
+{
+    ssd1306_sendCommand(SSD1306_SETSTARTLINE | (line & 0x3F));
+}
+
+void ssd1306_setDisplayOffset(uint8_t offset)
+{
+    ssd1306_commandBatchAdd(SSD1306_SETDISPLAYOFFSET);
+    ssd1306_commandBatchAdd(offset & 0x3F);
+    ssd1306_commandBatchSend();
+}
+
+void ssd1306_setScrollArea(uint8_t top, uint8_t rows)
+{
+    ssd1306_commandBatchAdd(SSD1306_SET_VERTICAL_SCROLL_AREA);
+    ssd1306_commandBatchAdd(top);
+    ssd1306_commandBatchAdd(rows);
+    ssd1306_commandBatchSend();
+}
+
+void ssd1306_startScroll(uint8_t left, uint8_t startPage, uint8_t endPage,
+                         uint8_t interval, uint8_t vertical)
+{
+    // the controller requires scrolling off while parameters change
+    ssd1306_commandBatchAdd(SSD1306_DEACTIVATE_SCROLL);
+    if (vertical)
+    {
+        ssd1306_commandBatchAdd(left ? SSD1306_VERTICAL_AND_LEFT_HORIZONTAL_SCROLL
+                                     : SSD1306_VERTICAL_AND_RIGHT_HORIZONTAL_SCROLL);
+    }
+    else
+    {
+        ssd1306_commandBatchAdd(left ? SSD1306_LEFT_HORIZONTAL_SCROLL
+                                     : SSD1306_RIGHT_HORIZONTAL_SCROLL);
+    }
+    ssd1306_commandBatchAdd(0x00);
+    ssd1306_commandBatchAdd(startPage & 0x07);
+    ssd1306_commandBatchAdd(interval & 0x07);
+    ssd1306_commandBatchAdd(endPage & 0x07);
+    if (vertical)
+    {
+        ssd1306_commandBatchAdd(vertical & 0x3F);
+    }
+    else
+    {
+        ssd1306_commandBatchAdd(0x00);
+        ssd1306_commandBatchAdd(0xFF);
+    }
+    ssd1306_commandBatchAdd(SSD1306_ACTIVATE_SCROLL);
+    ssd1306_commandBatchSend();
+}
+
+void ssd1306_stopScroll(void)
+{
+    ssd1306_sendCommand(SSD1306_DEACTIVATE_SCROLL);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //  I2C SSD1306 128x64
 ///////////////////////////////////////////////////////////////////////////////
@@ -186,10 +229,7 @@ void    ssd1306_128x64_init()
     ssd1306_lcd.send_pixels1  = ssd1306_intf.send;
     ssd1306_lcd.send_pixels_buffer1 = ssd1306_intf.send_buffer;
     ssd1306_lcd.set_mode = ssd1306_setMode_int;
-    for( uint8_t i=0; i<sizeof(s_oled128x64_initData); i++)
-    {
-        ssd1306_sendCommand(pgm_read_byte(&s_oled128x64_initData[i]));
-    }
+    ssd1306_configureI2cDisplay(s_oled128x64_initData, sizeof(s_oled128x64_initData));
 }
 
 void    ssd1306_128x64_i2c_init()
@@ -231,10 +271,7 @@ void    ssd1306_128x32_init()
     ssd1306_lcd.next_page = ssd1306_nextPage;
     ssd1306_lcd.send_pixels1  = ssd1306_intf.send;
     ssd1306_lcd.set_mode = ssd1306_setMode_int;
-    for( uint8_t i=0; i < sizeof(s_oled128x32_initData); i++)
-    {
-        ssd1306_sendCommand(pgm_read_byte(&s_oled128x32_initData[i]));
-    }
+    ssd1306_configureI2cDisplay(s_oled128x32_initData, sizeof(s_oled128x32_initData));
 }
 
 
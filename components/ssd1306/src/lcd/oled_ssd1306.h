@@ -164,6 +164,57 @@ void         ssd1306_flipHorizontal(uint8_t mode);
  */
 void         ssd1306_flipVertical(uint8_t mode);
 
+/**
+ * @brief sets the GDRAM row shown on the top line
+ *
+ * Sets the GDRAM row shown on the top line of the display. The display
+ * RAM works as a ring, so moving the start line by one text line scrolls
+ * everything up without sending any pixels.
+ *
+ * @param line - GDRAM row, 0 - 63
+ */
+void         ssd1306_setStartLine(uint8_t line);
+
+/**
+ * @brief shifts the common outputs
+ *
+ * Maps display line 0 to common output offset, moving the picture up
+ * by offset rows and wrapping the top rows to the bottom.
+ *
+ * @param offset - 0 - 63
+ */
+void         ssd1306_setDisplayOffset(uint8_t offset);
+
+/**
+ * @brief limits vertical scrolling to a band of rows
+ *
+ * @param top - number of fixed rows above the band
+ * @param rows - number of rows in the band
+ */
+void         ssd1306_setScrollArea(uint8_t top, uint8_t rows);
+
+/**
+ * @brief starts continuous horizontal scrolling done by the controller
+ *
+ * Scrolls pages startPage to endPage in hardware until ssd1306_stopScroll().
+ * GDRAM must not be written while scrolling.
+ *
+ * @param left - 0 to scroll right, 1 to scroll left
+ * @param startPage - first page to scroll
+ * @param endPage - last page to scroll
+ * @param interval - frames between steps as coded by the controller:
+ *                   0 - 5, 1 - 64, 2 - 128, 3 - 256, 4 - 3, 5 - 4, 6 - 25, 7 - 2
+ * @param vertical - rows to move up per step in addition, 0 for horizontal only
+ */
+void         ssd1306_startScroll(uint8_t left, uint8_t startPage, uint8_t endPage,
+                                 uint8_t interval, uint8_t vertical);
+
+/**
+ * Stops scrolling started by ssd1306_startScroll().
+ * The controller leaves GDRAM as it was when scrolling started.
+ */
+void         ssd1306_stopScroll(void);
+
 /**
  * @}
  */
@@ -121,6 +121,7 @@ void    ssd1325_128x64_init()
     ssd1306_lcd.send_pixels_buffer1 = ssd1325_sendPixelsBuffer;
     // Set function for 8-bit mode
     ssd1306_lcd.send_pixels8 = ssd1306_intf.send;
+    ssd1306_lcd.send_pixels_buffer8 = ssd1306_intf.send_buffer;
     ssd1306_lcd.set_mode = ssd1325_setMode;
     // Use one of 2 functions for initialization below
     // Please, read help on this functions and read datasheet before you decide, which
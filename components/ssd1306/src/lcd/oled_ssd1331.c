@@ -157,11 +157,9 @@ void    ssd1331_96x64_init()
     ssd1306_lcd.send_pixels_buffer1 = send_pixels_buffer_compat;
 
     ssd1306_lcd.send_pixels8 = ssd1306_intf.send;
+    ssd1306_lcd.send_pixels_buffer8 = ssd1306_intf.send_buffer;
     ssd1306_lcd.set_mode = ssd1331_setMode;
-    for( uint8_t i=0; i<sizeof(s_oled96x64_initData); i++)
-    {
-        ssd1306_sendCommand(pgm_read_byte(&s_oled96x64_initData[i]));
-    }
+    ssd1306_configureI2cDisplay(s_oled96x64_initData, sizeof(s_oled96x64_initData));
 }
 
 void   ssd1331_96x64_spi_init(int8_t rstPin, int8_t cesPin, int8_t dcPin)
@@ -174,6 +172,13 @@ void   ssd1331_96x64_spi_init(int8_t rstPin, int8_t cesPin, int8_t dcPin)
     ssd1331_96x64_init();
 }
 
+static void ssd1331_sendColor(uint8_t color)
+{
+    ssd1306_intf.send( (color & 0x03) << 4 );
+    ssd1306_intf.send( (color & 0x1C) << 2 );
+    ssd1306_intf.send( (color & 0xE0) >> 2 );
+}
+
 void ssd1331_drawLine(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint16_t color)
 {
     ssd1306_intf.start();
@@ -183,9 +188,7 @@ void ssd1331_drawLine(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint16_t c
     ssd1306_intf.send(y1);
     ssd1306_intf.send(x2);
     ssd1306_intf.send(y2);
-    ssd1306_intf.send( (color & 0x03) << 4 );
-    ssd1306_intf.send( (color & 0x1C) << 2 );
-    ssd1306_intf.send( (color & 0xE0) >> 2 );
+    ssd1331_sendColor( color );
     ssd1306_intf.stop();
 }
 
@@ -193,7 +196,7 @@ void ssd1331_copyBlock(uint8_t left, uint8_t top, uint8_t right, uint8_t bottom,
 {
     ssd1306_intf.start();
     ssd1306_spiDataMode(0);
-    ssd1306_intf.send(0x23);
+    ssd1306_intf.send(SSD1331_COPYBLOCK);
     ssd1306_intf.send(left);
     ssd1306_intf.send(top);
     ssd1306_intf.send(right);
@@ -203,3 +206,86 @@ void ssd1331_copyBlock(uint8_t left, uint8_t top, uint8_t right, uint8_t bottom,
     ssd1306_intf.stop();
 }
 
+//////////////////////// GRAPHIC ACCELERATION //////////////////////////////////
+
+/*
+ * The controller ignores commands while it is drawing. Waits grow with the pixels
+ * drawn, up to the 3 ms other drivers wait for a full screen fill.
+ */
+static void ssd1331_gacWait(uint16_t pixels)
+{
+    delayMicroseconds(40 + (pixels >> 1));
+}
+
+static uint8_t ssd1331_gacActive(void)
+{
+    // GDRAM addressing of the compatible mode does not match draw commands
+    return (ssd1306_lcd.set_mode == ssd1331_setMode) && !(s_rotation & 0x04);
+}
+
+/* Sends point in GDRAM coordinates, rows and columns are swapped when rotated by 90 degrees */
+static void ssd1331_sendPoint(lcdint_t x, lcdint_t y)
+{
+    ssd1306_intf.send( (s_rotation & 1) ? y : x );
+    ssd1306_intf.send( (s_rotation & 1) ? x : y );
+}
+
+uint8_t ssd1331_accelLine(lcdint_t x1, lcdint_t y1, lcdint_t x2, lcdint_t y2, uint8_t color)
+{
+    if ( !ssd1331_gacActive() ||
+         (x1 < 0) || (x2 < 0) || (y1 < 0) || (y2 < 0) ||
+         (x1 >= (lcdint_t)ssd1306_lcd.width) || (x2 >= (lcdint_t)ssd1306_lcd.width) ||
+         (y1 >= (lcdint_t)ssd1306_lcd.height) || (y2 >= (lcdint_t)ssd1306_lcd.height) )
+    {
+        return 0;
+    }
+    ssd1306_intf.start();
+    ssd1306_spiDataMode(0);
+    ssd1306_intf.send(SSD1331_DRAWLINE);
+    ssd1331_sendPoint(x1, y1);
+    ssd1331_sendPoint(x2, y2);
+    ssd1331_sendColor( color );
+    ssd1306_intf.stop();
+    lcduint_t dx = x1 > x2 ? (x1 - x2): (x2 - x1);
+    lcduint_t dy = y1 > y2 ? (y1 - y2): (y2 - y1);
+    ssd1331_gacWait( (dx > dy ? dx : dy) + 1 );
+    return 1;
+}
+
+uint8_t ssd1331_accelFill(lcdint_t x1, lcdint_t y1, lcdint_t x2, lcdint_t y2, uint8_t color)
+{
+    if (!ssd1331_gacActive())
+    {
+        return 0;
+    }
+    if ( (x2 < 0) || (y2 < 0) || (x1 >= (lcdint_t)ssd1306_lcd.width) || (y1 >= (lcdint_t)ssd1306_lcd.height) )
+    {
+        return 1;
+    }
+    if (x1 < 0) x1 = 0;
+    if (y1 < 0) y1 = 0;
+    if (x2 >= (lcdint_t)ssd1306_lcd.width) x2 = ssd1306_lcd.width - 1;
+    if (y2 >= (lcdint_t)ssd1306_lcd.height) y2 = ssd1306_lcd.height - 1;
+    ssd1306_intf.start();
+    ssd1306_spiDataMode(0);
+    if (color)
+    {
+        ssd1306_intf.send(SSD1331_FILLMODE);
+        ssd1306_intf.send(0x01);
+        ssd1306_intf.send(SSD1331_DRAWRECT);
+        ssd1331_sendPoint(x1, y1);
+        ssd1331_sendPoint(x2, y2);
+        ssd1331_sendColor( color ); // outline
+        ssd1331_sendColor( color ); // fill
+    }
+    else
+    {
+        ssd1306_intf.send(SSD1331_CLEARWINDOW);
+        ssd1331_sendPoint(x1, y1);
+        ssd1331_sendPoint(x2, y2);
+    }
+    ssd1306_intf.stop();
+    ssd1331_gacWait( (uint16_t)(x2 - x1 + 1) * (uint16_t)(y2 - y1 + 1) );
+    return 1;
+}
+
@@ -124,6 +124,33 @@ void         ssd1331_drawLine(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, ui
  */
 void ssd1331_copyBlock(uint8_t left, uint8_t top, uint8_t right, uint8_t bottom, uint8_t newLeft, uint8_t newTop);
 
+/**
+ * Draws line with ssd1331 graphic acceleration commands, if ssd1331 is active
+ * display in LCD_MODE_NORMAL. Unlike ssd1331_drawLine() coordinates are rotated
+ * by ssd1331_setRotation() as for ssd1306_drawLine8(). Waits until the controller
+ * has drawn the line.
+ * @param x1 - x position in pixels of start point
+ * @param y1 - y position in pixels of start point
+ * @param x2 - x position in pixels of end point
+ * @param y2 - y position in pixels of end point
+ * @param color - color of the line, refer to RGB_COLOR8 macros
+ * @return 0 if line is not drawn, and pixels need to be sent instead
+ */
+uint8_t ssd1331_accelLine(lcdint_t x1, lcdint_t y1, lcdint_t x2, lcdint_t y2, uint8_t color);
+
+/**
+ * Fills rectangle with ssd1331 graphic acceleration commands, clear window command
+ * for black, under the same conditions as ssd1331_accelLine(). Rectangle is clipped
+ * by the display.
+ * @param x1 - x position in pixels of top-left corner
+ * @param y1 - y position in pixels of top-left corner
+ * @param x2 - x position in pixels of bottom-right corner, not less than x1
+ * @param y2 - y position in pixels of bottom-right corner, not less than y1
+ * @param color - fill color, refer to RGB_COLOR8 macros
+ * @return 0 if rectangle is not filled, and pixels need to be sent instead
+ */
+uint8_t ssd1331_accelFill(lcdint_t x1, lcdint_t y1, lcdint_t x2, lcdint_t y2, uint8_t color);
+
 /**
  * @}
  */
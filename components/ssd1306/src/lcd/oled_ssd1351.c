@@ -33,9 +33,6 @@
 #include "sdl_core.h"
 #endif
 
-#define CMD_ARG     0xFF
-
-extern uint16_t ssd1306_color;
 extern uint32_t s_ssd1306_spi_clock;
 
 static const PROGMEM uint8_t s_oled128x128_initData[] =
@@ -141,33 +138,6 @@ void    ssd1351_setMode(lcd_mode_t mode)
     }
 }
 
-static void ssd1351_sendPixels(uint8_t data)
-{
-    for (uint8_t i=8; i>0; i--)
-    {
-        if ( data & 0x01 )
-        {
-            ssd1306_intf.send( (uint8_t)(ssd1306_color>>8) );
-            ssd1306_intf.send( (uint8_t)(ssd1306_color) );
-        }
-        else
-        {
-            ssd1306_intf.send( 0B00000000 );
-            ssd1306_intf.send( 0B00000000 );
-        }
-        data >>= 1;
-    }
-}
-
-static void ssd1351_sendPixelsBuffer(const uint8_t *buffer, uint16_t len)
-{
-    while(len--)
-    {
-        ssd1351_sendPixels(*buffer);
-        buffer++;
-    }
-}
-
 static void ssd1351_sendPixel8(uint8_t data)
 {
     uint16_t color = RGB8_TO_RGB16(data);
@@ -182,9 +152,10 @@ void    ssd1351_128x128_init()
     ssd1306_lcd.width = 128;
     ssd1306_lcd.set_block = ssd1351_setBlock;
     ssd1306_lcd.next_page = ssd1351_nextPage;
-    ssd1306_lcd.send_pixels1  = ssd1351_sendPixels;
-    ssd1306_lcd.send_pixels_buffer1 = ssd1351_sendPixelsBuffer;
+    ssd1306_lcd.send_pixels1  = ssd1306_sendPixelRgb16;
+    ssd1306_lcd.send_pixels_buffer1 = ssd1306_sendPixelsRgb16;
     ssd1306_lcd.send_pixels8 = ssd1351_sendPixel8;
+    ssd1306_lcd.send_pixels_buffer8 = ssd1306_sendPixels8Rgb16;
     ssd1306_lcd.set_mode = ssd1351_setMode;
     ssd1306_intf.start();
     ssd1306_spiDataMode(0);
@@ -153,6 +153,7 @@ void    template_WxH_init()
     ssd1306_lcd.send_pixels_buffer1 = template_sendPixelsBuffer;
     // Set function for 8-bit mode
     ssd1306_lcd.send_pixels8 = ssd1306_intf.send;
+    ssd1306_lcd.send_pixels_buffer8 = ssd1306_intf.send_buffer;
     ssd1306_lcd.set_mode = template_setMode;
     // Use one of 2 functions for initialization below
     // Please, read help on this functions and read datasheet before you decide, which
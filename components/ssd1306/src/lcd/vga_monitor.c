@@ -128,6 +128,7 @@ void vga_96x40_8colors_init(void)
     ssd1306_lcd.send_pixels1  = vga_send_pixels;
     ssd1306_lcd.send_pixels_buffer1 = vga_send_pixels_buffer;
     ssd1306_lcd.send_pixels8 = ssd1306_intf.send;
+    ssd1306_lcd.send_pixels_buffer8 = ssd1306_intf.send_buffer;
     ssd1306_lcd.set_mode = vga_set_mode;
 }
 
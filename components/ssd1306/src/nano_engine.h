@@ -30,9 +30,11 @@
 #define _NANO_ENGINE_H_
 
 #include "nano_engine/sprite.h"
+#include "nano_engine/sprite_layer.h"
 #include "nano_engine/canvas.h"
 #include "nano_engine/adafruit.h"
 #include "nano_engine/tiler.h"
+#include "nano_engine/frame.h"
 #include "nano_engine/core.h"
 
 // DO NOT DECLARE NanoEngine8, NanoEngine16, NanoEngine1 as class NAME: public NanoEngine<T>
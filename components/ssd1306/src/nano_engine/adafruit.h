@@ -42,6 +42,9 @@
 #include "ssd1306.h"
 #include "ssd1306_hal/Print_internal.h"
 #include "nano_gfx_types.h"
+#include "intf/ssd1306_interface.h"
+#include "lcd/lcd_common.h"
+#include "rect.h"
 
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 /* This is special case for non-Arduino platforms, since Adafruit requires *
@@ -65,7 +68,10 @@
  * This is basic template class for all canvas classes,
  * based on Adafruit_GFX. This base class provides functionality
  * compatible with native NanoCanvas implementation of ssd1306
- * library
+ * library.
+ * Every Adafruit GFX primitive ends in drawPixel(), which grows the bounding
+ * box of the pixels changed since clearDirty(). blt(rect) and bltDirty() of
+ * derived classes send only that area.
  */
 template <uint8_t BPP>
 class AdafruitCanvasOps: public Adafruit_GFX
@@ -90,6 +96,7 @@ public:
         , offset{0}
         , m_buffer(buffer)
     {
+        clearDirty();
     }
 
     /**
@@ -109,6 +116,37 @@ public:
      */
     void setOffset(lcdint_t ox, lcdint_t oy) { offset.x = ox; offset.y = oy; };
 
+    /** Returns true if pixels were drawn since clearDirty() */
+    bool isDirty() const { return m_dirty.p1.x <= m_dirty.p2.x; }
+
+    /**
+     * Returns bounding box of the pixels drawn since clearDirty(), in canvas
+     * coordinates (offset applied). Only valid if isDirty().
+     */
+    NanoRect dirtyRect() const
+    {
+        return { { (lcdint_t)(m_dirty.p1.x + offset.x), (lcdint_t)(m_dirty.p1.y + offset.y) },
+                 { (lcdint_t)(m_dirty.p2.x + offset.x), (lcdint_t)(m_dirty.p2.y + offset.y) } };
+    }
+
+    /** Forgets the drawn area */
+    void clearDirty() { m_dirty = { { (lcdint_t)WIDTH, (lcdint_t)HEIGHT }, { -1, -1 } }; }
+
+    /**
+     * Marks the drawn area for refresh by a NanoEngine and forgets it, so the
+     * engine redraws only the tiles it covers.
+     * @tparam E NanoEngine class, for example NanoEngine1
+     */
+    template <class E>
+    void refreshDirty()
+    {
+        if (isDirty())
+        {
+            E::refresh(dirtyRect());
+        }
+        clearDirty();
+    }
+
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
     // We need to override Adafruit GFX implementation of fillScreen, because
     // NanoEngine uses offsets, when refreshing screen content.
@@ -123,6 +161,31 @@ protected:
     /** pixels buffer */
     uint8_t *m_buffer;
 
+    /** Drawn area in buffer coordinates, p1 past p2 if none */
+    NanoRect m_dirty;
+
+    /** Grows the drawn area by a pixel in buffer coordinates */
+    inline void markDirty(int16_t x, int16_t y)
+    {
+        if (x < m_dirty.p1.x) m_dirty.p1.x = x;
+        if (x > m_dirty.p2.x) m_dirty.p2.x = x;
+        if (y < m_dirty.p1.y) m_dirty.p1.y = y;
+        if (y > m_dirty.p2.y) m_dirty.p2.y = y;
+    }
+
+    /**
+     * Clips rect in canvas coordinates to the buffer.
+     * @return false if nothing of rect is in the buffer
+     */
+    bool localRect(const NanoRect &rect, NanoRect &local) const
+    {
+        local.p1.x = max((lcdint_t)(rect.p1.x - offset.x), (lcdint_t)0);
+        local.p1.y = max((lcdint_t)(rect.p1.y - offset.y), (lcdint_t)0);
+        local.p2.x = min((lcdint_t)(rect.p2.x - offset.x), (lcdint_t)(WIDTH - 1));
+        local.p2.y = min((lcdint_t)(rect.p2.y - offset.y), (lcdint_t)(HEIGHT - 1));
+        return (local.p1.x <= local.p2.x) && (local.p1.y <= local.p2.y);
+    }
+
 private:
     inline void rotatePosition(int16_t &x, int16_t &y)
     {
@@ -164,6 +227,25 @@ public:
      * Draws canvas on the LCD display using offset values.
      */
     virtual void blt() = 0;
+
+    /**
+     * Draws part of canvas on the LCD display using offset values.
+     * @param rect - area in canvas coordinates (offset applied)
+     */
+    virtual void blt(const NanoRect &rect) { (void)rect; blt(); }
+
+    /**
+     * Draws the area changed since the last call, or since clearDirty(),
+     * on the LCD display using offset values.
+     */
+    void bltDirty()
+    {
+        if (this->isDirty())
+        {
+            blt(this->dirtyRect());
+        }
+        this->clearDirty();
+    }
 };
 
 /////////////////////////////////////////////////////////////////////////////////
@@ -199,6 +281,30 @@ public:
     {
         ssd1306_drawBufferFast(offset.x, offset.y, WIDTH, HEIGHT, m_buffer);
     }
+
+    /**
+     * Draws part of canvas on the LCD display using offset values.
+     * Whole pages of 8 rows are sent.
+     * @param rect - area in canvas coordinates (offset applied)
+     */
+    void blt(const NanoRect &rect) override
+    {
+        NanoRect local;
+        if (!localRect(rect, local))
+        {
+            return;
+        }
+        lcduint_t w = local.width();
+        const uint8_t *buf = m_buffer + (local.p1.y >> 3) * WIDTH + local.p1.x;
+        ssd1306_lcd.set_block(offset.x + local.p1.x, (offset.y + local.p1.y) >> 3, w);
+        for (lcdint_t page = local.p1.y >> 3; page <= (local.p2.y >> 3); page++)
+        {
+            ssd1306_lcd.send_pixels_buffer1(buf, w);
+            buf += WIDTH;
+            ssd1306_lcd.next_page();
+        }
+        ssd1306_intf.stop();
+    }
 };
 
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
@@ -212,6 +318,7 @@ void AdafruitCanvasOps<1>::drawPixel(int16_t x, int16_t y, uint16_t color)
         return;
     }
     rotatePosition(x, y);
+    markDirty(x, y);
 
     switch (color)
     {
@@ -255,6 +362,35 @@ public:
     {
         ssd1306_drawBufferFast8(offset.x, offset.y, WIDTH, HEIGHT, m_buffer);
     }
+
+    /**
+     * Draws part of canvas on the LCD display using offset values.
+     * @param rect - area in canvas coordinates (offset applied)
+     */
+    void blt(const NanoRect &rect) override
+    {
+        NanoRect local;
+        if (!localRect(rect, local))
+        {
+            return;
+        }
+        lcduint_t w = local.width();
+        const uint8_t *buf = m_buffer + local.p1.y * WIDTH + local.p1.x;
+        // the block wraps to its next row by itself
+        ssd1306_lcd.set_block(offset.x + local.p1.x, offset.y + local.p1.y, w);
+        for (lcdint_t y = local.p1.y; y <= local.p2.y; y++, buf += WIDTH)
+        {
+            if (ssd1306_lcd.send_pixels_buffer8)
+            {
+                ssd1306_lcd.send_pixels_buffer8(buf, w);
+            }
+            else
+            {
+                for (lcduint_t i = 0; i < w; i++) ssd1306_lcd.send_pixels8(buf[i]);
+            }
+        }
+        ssd1306_intf.stop();
+    }
 };
 
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
@@ -268,6 +404,7 @@ void AdafruitCanvasOps<8>::drawPixel(int16_t x, int16_t y, uint16_t color)
         return;
     }
     rotatePosition(x, y);
+    markDirty(x, y);
 
     m_buffer[x+y*WIDTH] = color;
 }
@@ -307,6 +444,27 @@ public:
     {
         ssd1306_drawBufferFast16(offset.x, offset.y, WIDTH, HEIGHT, m_buffer);
     }
+
+    /**
+     * Draws part of canvas on the LCD display using offset values.
+     * @param rect - area in canvas coordinates (offset applied)
+     */
+    void blt(const NanoRect &rect) override
+    {
+        NanoRect local;
+        if (!localRect(rect, local))
+        {
+            return;
+        }
+        lcduint_t w = local.width();
+        const uint8_t *buf = m_buffer + (local.p1.y * WIDTH + local.p1.x) * 2;
+        ssd1306_lcd.set_block(offset.x + local.p1.x, offset.y + local.p1.y, w);
+        for (lcdint_t y = local.p1.y; y <= local.p2.y; y++, buf += WIDTH * 2)
+        {
+            ssd1306_intf.send_buffer(buf, w * 2);
+        }
+        ssd1306_intf.stop();
+    }
 };
 
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
@@ -320,6 +478,7 @@ void AdafruitCanvasOps<16>::drawPixel(int16_t x, int16_t y, uint16_t color)
         return;
     }
     rotatePosition(x, y);
+    markDirty(x, y);
 
     m_buffer[(x+y*WIDTH) * 2 + 0] = color;
     m_buffer[(x+y*WIDTH) * 2 + 1] = color >> 8;
@@ -32,6 +32,126 @@ extern "C" SFixedFontInfo s_fixedFont;
 extern "C" uint8_t g_ssd1306_unicode;
 #endif
 
+/**
+ * Sets (or clears) the mask bits in len bytes of the buffer.
+ * Bytes up to a 32-bit boundary go one by one, then 4 at a time.
+ */
+static void canvasMaskBytes(uint8_t *buf, uint8_t mask, bool set, lcduint_t len)
+{
+    uint8_t value = set ? mask : (uint8_t)~mask;
+    for (; len && ((uintptr_t)buf & 3); len--, buf++)
+    {
+        if (set) *buf |= value; else *buf &= value;
+    }
+    uint32_t word = value * 0x01010101UL;
+    uint32_t *words = reinterpret_cast<uint32_t *>(buf);
+    for (; len >= 4; len -= 4, words++)
+    {
+        if (set) *words |= word; else *words &= word;
+    }
+    buf = reinterpret_cast<uint8_t *>(words);
+    for (; len; len--, buf++)
+    {
+        if (set) *buf |= value; else *buf &= value;
+    }
+}
+
+/**
+ * Fills count pixels of 16-bit color, high byte first.
+ * Bytes up to a 32-bit boundary go one by one, then 2 pixels at a time.
+ */
+static void canvasFill16(uint8_t *buf, uint16_t color, lcduint_t count)
+{
+    uint8_t bytes[4] = { (uint8_t)(color >> 8), (uint8_t)(color & 0xFF) };
+    lcduint_t len = count << 1;
+    uint8_t phase = 0;
+    for (; len && ((uintptr_t)buf & 3); len--, phase ^= 1)
+    {
+        *buf++ = bytes[phase];
+    }
+    bytes[2] = bytes[0];
+    bytes[3] = bytes[1];
+    uint8_t pattern[4] = { bytes[phase], bytes[phase ^ 1], bytes[phase], bytes[phase ^ 1] };
+    uint32_t word;
+    memcpy(&word, pattern, sizeof(word));
+    uint32_t *words = reinterpret_cast<uint32_t *>(buf);
+    for (; len >= 4; len -= 4)
+    {
+        *words++ = word;
+    }
+    buf = reinterpret_cast<uint8_t *>(words);
+    for (; len; len--, phase ^= 1)
+    {
+        *buf++ = bytes[phase];
+    }
+}
+
+template <uint8_t BYTES, bool TRANSPARENT>
+static inline void canvasBlitColumn(uint8_t *p, lcduint_t stride, uint8_t data, uint8_t rows,
+                                    uint8_t hi, uint8_t lo)
+{
+    for (; rows; rows--, data >>= 1, p += stride)
+    {
+        if (data & 0x01)
+        {
+            p[0] = BYTES == 2 ? hi : lo;
+            if (BYTES == 2) p[1] = lo;
+        }
+        else if (!TRANSPARENT)
+        {
+            p[0] = 0x00;
+            if (BYTES == 2) p[1] = 0x00;
+        }
+    }
+}
+
+template <uint8_t BYTES, bool TRANSPARENT>
+static void canvasBlit1Rows(uint8_t *dst, lcduint_t stride, const uint8_t *bitmap, lcduint_t w,
+                            lcduint_t cols, lcduint_t rows, uint8_t offs, uint16_t color)
+{
+    uint8_t hi = color >> 8;
+    uint8_t lo = color & 0xFF;
+    while (rows)
+    {
+        uint8_t n = rows < (lcduint_t)(8 - offs) ? rows : 8 - offs;
+        uint8_t *p = dst;
+        if (n == 8)
+        {
+            // whole source page, the bit loop is unrolled
+            for (lcduint_t x = 0; x < cols; x++, p += BYTES)
+            {
+                canvasBlitColumn<BYTES, TRANSPARENT>(p, stride, pgm_read_byte(&bitmap[x]), 8, hi, lo);
+            }
+        }
+        else
+        {
+            for (lcduint_t x = 0; x < cols; x++, p += BYTES)
+            {
+                canvasBlitColumn<BYTES, TRANSPARENT>(p, stride, pgm_read_byte(&bitmap[x]) >> offs, n, hi, lo);
+            }
+        }
+        dst += n * stride;
+        bitmap += w;
+        rows -= n;
+        offs = 0;
+    }
+}
+
+/**
+ * Copies the visible part of a page ordered 1-bit bitmap to a canvas of 1 or 2 bytes
+ * per pixel. dst is the top left canvas pixel, bitmap the source byte holding it,
+ * and offs its bit. Clipping is done by the caller, so the loops test nothing else.
+ */
+template <uint8_t BYTES>
+static void canvasBlit1(uint8_t *dst, lcduint_t stride, const uint8_t *bitmap, lcduint_t w,
+                        lcduint_t cols, lcduint_t rows, uint8_t offs, uint16_t color, bool transparent)
+{
+    if (transparent)
+        canvasBlit1Rows<BYTES, true>(dst, stride, bitmap, w, cols, rows, offs, color);
+    else
+        canvasBlit1Rows<BYTES, false>(dst, stride, bitmap, w, cols, rows, offs, color);
+}
+
 /////////////////////////////////////////////////////////////////////////////////
 //
 //                            COMMON GRAPHICS
@@ -150,20 +270,66 @@ uint8_t NanoCanvasOps<BPP>::printChar(uint8_t c)
 template <uint8_t BPP>
 size_t NanoCanvasOps<BPP>::write(uint8_t c)
 {
-    if (c == '\n')
-    {
-        m_cursorY += (lcdint_t)s_fixedFont.h.height;
-        m_cursorX = 0;
-    }
-    else if (c == '\r')
-    {
-        // skip non-printed char
-    }
-    else
+    return NanoCanvasOps<BPP>::write(&c, 1);
+}
+
+template <uint8_t BPP>
+size_t NanoCanvasOps<BPP>::write(const uint8_t *buffer, size_t size)
+{
+    const uint8_t passes = m_fontStyle == STYLE_BOLD ? 2 : 1;
+    const uint8_t mode = m_textMode;
+    const bool wrapLocal = (m_textMode & CANVAS_TEXT_WRAP_LOCAL) != 0;
+    const bool wrap = wrapLocal || (m_textMode & CANVAS_TEXT_WRAP);
+    const lcdint_t localX = (lcdint_t)m_w - (lcdint_t)s_fixedFont.h.width;
+    const lcdint_t screenX = (lcdint_t)ssd1306_lcd.width - (lcdint_t)s_fixedFont.h.width;
+    // with both flags the nearer edge wins
+    lcdint_t maxX = !wrapLocal ? screenX :
+                    (m_textMode & CANVAS_TEXT_WRAP) && screenX < localX ? screenX : localX;
+    const lcdint_t maxY = (lcdint_t)m_h - (lcdint_t)s_fixedFont.h.height;
+    size_t n = 0;
+    for (; size; size--, buffer++)
     {
-        return printChar( c );
+        uint8_t c = *buffer;
+        if (c == '\n')
+        {
+            m_cursorY += (lcdint_t)s_fixedFont.h.height;
+            m_cursorX = 0;
+            n++;
+            continue;
+        }
+        if (c == '\r')
+        {
+            // skip non-printed char
+            n++;
+            continue;
+        }
+        uint16_t unicode = ssd1306_unicode16FromUtf8(c);
+        if (unicode == SSD1306_MORE_CHARS_REQUIRED) continue;
+        SCharInfo char_info;
+        ssd1306_getCharBitmap(unicode, &char_info);
+        for (uint8_t i = 0; i < passes; i++)
+        {
+            drawBitmap1(m_cursorX + i,
+                        m_cursorY,
+                        char_info.width,
+                        char_info.height,
+                        char_info.glyph );
+            m_textMode |= CANVAS_MODE_TRANSPARENT;
+        }
+        m_textMode = mode;
+        m_cursorX += (lcdint_t)(char_info.width + char_info.spacing);
+        if ( wrap && m_cursorX > maxX )
+        {
+            m_cursorY += (lcdint_t)s_fixedFont.h.height;
+            m_cursorX = 0;
+            if ( wrapLocal && m_cursorY > maxY )
+            {
+                m_cursorY = 0;
+            }
+        }
+        n++;
     }
-    return 1;
+    return n;
 }
 
 template <uint8_t BPP>
@@ -172,11 +338,7 @@ void NanoCanvasOps<BPP>::printFixed(lcdint_t xpos, lcdint_t y, const char *ch, E
     m_fontStyle = style;
     m_cursorX = xpos;
     m_cursorY = y;
-    while (*ch)
-    {
-        write(*ch);
-        ch++;
-    }
+    write(ch);
 }
 
 template <uint8_t BPP>
@@ -326,17 +488,7 @@ void NanoCanvasOps<1>::fillRect(lcdint_t x1, lcdint_t y1, lcdint_t x2, lcdint_t
         {
             mask = (mask >> (7 - (y2 & 7)));
         }
-        for (uint8_t x=x1; x<=x2; x++)
-        {
-            if (m_color)
-            {
-                m_buf[BANK_ADDR1(bank) + x] |= mask;
-            }
-            else
-            {
-                m_buf[BANK_ADDR1(bank) + x] &= ~mask;
-            }
-        }
+        canvasMaskBytes(&m_buf[BANK_ADDR1(bank) + x1], mask, m_color != 0, x2 - x1 + 1);
     }
 };
 
@@ -457,6 +609,259 @@ void NanoCanvas1_8::blt()
     ssd1306_drawMonoBuffer8(offset.x, offset.y, m_w, m_h, m_buf);
 }
 
+/////////////////////////////////////////////////////////////////////////////////
+//
+//                             4-BIT GRAPHICS
+//
+/////////////////////////////////////////////////////////////////////////////////
+
+#define STRIDE4 ((m_w + 1) >> 1)
+#define YADDR4(y) (static_cast<uint32_t>(y) * STRIDE4)
+
+static inline void canvasPut4(uint8_t *row, lcduint_t x, uint8_t color)
+{
+    uint8_t *p = row + (x >> 1);
+    if (x & 1)
+        *p = (*p & 0xF0) | color;
+    else
+        *p = (*p & 0x0F) | (color << 4);
+}
+
+/**
+ * Fills pixels x1 to x2 of the row. Pixels between the first and the last byte
+ * boundary are written as whole bytes.
+ */
+static void canvasFill4(uint8_t *row, lcduint_t x1, lcduint_t x2, uint8_t color)
+{
+    if (x1 & 1)
+    {
+        canvasPut4(row, x1++, color);
+    }
+    if (!(x2 & 1) && (x2 >= x1))
+    {
+        canvasPut4(row, x2, color);
+        if (x2 == x1) return;
+        x2--;
+    }
+    if (x2 > x1)
+    {
+        memset(row + (x1 >> 1), color * 0x11, ((x2 - x1) >> 1) + 1);
+    }
+}
+
+template <>
+void NanoCanvasOps<4>::putPixel(lcdint_t x, lcdint_t y)
+{
+    x -= offset.x;
+    y -= offset.y;
+    if ((x >= 0) && (y >= 0) && (x < (lcdint_t)m_w) && (y < (lcdint_t)m_h))
+    {
+        canvasPut4(m_buf + YADDR4(y), x, m_color & 0x0F);
+    }
+}
+
+template <>
+void NanoCanvasOps<4>::drawVLine(lcdint_t x1, lcdint_t y1, lcdint_t y2)
+{
+    x1 -= offset.x;
+    y1 -= offset.y;
+    y2 -= offset.y;
+    if (y1 > y2)
+    {
+        ssd1306_swap_data(y1, y2, lcdint_t);
+    }
+    if ((x1 < 0) || (x1 >= (lcdint_t)m_w)) return;
+    if ((y2 < 0) || (y1 >= (lcdint_t)m_h)) return;
+    y1 = max(y1,0);
+    y2 = min(y2,(lcdint_t)m_h-1);
+    uint8_t *row = m_buf + YADDR4(y1);
+    for (lcdint_t y = y1; y <= y2; y++, row += STRIDE4)
+    {
+        canvasPut4(row, x1, m_color & 0x0F);
+    }
+}
+
+template <>
+void NanoCanvasOps<4>::drawHLine(lcdint_t x1, lcdint_t y1, lcdint_t x2)
+{
+    x1 -= offset.x;
+    y1 -= offset.y;
+    x2 -= offset.x;
+    if (x1 > x2)
+    {
+        ssd1306_swap_data(x1, x2, lcdint_t);
+    }
+    if ((x2 < 0) || (x1 >= (lcdint_t)m_w)) return;
+    if ((y1 < 0) || (y1 >= (lcdint_t)m_h)) return;
+    x1 = max(x1,0);
+    x2 = min(x2,(lcdint_t)m_w-1);
+    canvasFill4(m_buf + YADDR4(y1), x1, x2, m_color & 0x0F);
+}
+
+template <>
+void NanoCanvasOps<4>::fillRect(lcdint_t x1, lcdint_t y1, lcdint_t x2, lcdint_t y2)
+{
+    if (y1 > y2)
+    {
+        ssd1306_swap_data(y1, y2, lcdint_t);
+    }
+    if (x1 > x2)
+    {
+        ssd1306_swap_data(x1, x2, lcdint_t);
+    }
+    x1 -= offset.x;
+    y1 -= offset.y;
+    x2 -= offset.x;
+    y2 -= offset.y;
+    if ((x2 < 0) || (x1 >= (lcdint_t)m_w)) return;
+    if ((y2 < 0) || (y1 >= (lcdint_t)m_h)) return;
+    x1 = max(x1,0);
+    x2 = min(x2,(lcdint_t)m_w-1);
+    y1 = max(y1,0);
+    y2 = min(y2,(lcdint_t)m_h-1);
+    uint8_t *row = m_buf + YADDR4(y1);
+    for (lcdint_t y = y1; y <= y2; y++, row += STRIDE4)
+    {
+        canvasFill4(row, x1, x2, m_color & 0x0F);
+    }
+}
+
+template <>
+void NanoCanvasOps<4>::drawBitmap1(lcdint_t xpos, lcdint_t ypos, lcduint_t w, lcduint_t h, const uint8_t *bitmap)
+{
+    /* calculate char rectangle */
+    lcdint_t x1 = xpos - offset.x;
+    lcdint_t y1 = ypos - offset.y;
+    lcdint_t x2 = x1 + (lcdint_t)w - 1;
+    lcdint_t y2 = y1 + (lcdint_t)h - 1;
+    /* clip bitmap */
+    if ((x2 < 0) || (x1 >= (lcdint_t)m_w)) return;
+    if ((y2 < 0) || (y1 >= (lcdint_t)m_h)) return;
+    lcdint_t sx = 0;
+    lcdint_t sy = 0;
+    if (x1 < 0)
+    {
+        sx = -x1;
+        x1 = 0;
+    }
+    if (y1 < 0)
+    {
+        sy = -y1;
+        y1 = 0;
+    }
+    if (y2 >= (lcdint_t)m_h)
+    {
+         y2 = (lcdint_t)m_h - 1;
+    }
+    if (x2 >= (lcdint_t)m_w)
+    {
+         x2 = (lcdint_t)m_w - 1;
+    }
+    uint8_t color = m_color & 0x0F;
+    bool transparent = m_textMode & CANVAS_MODE_TRANSPARENT;
+    uint8_t *row = m_buf + YADDR4(y1);
+    for (lcdint_t y = y1; y <= y2; y++, sy++, row += STRIDE4)
+    {
+        const uint8_t *src = bitmap + ((lcduint_t)sy >> 3) * w + sx;
+        uint8_t mask = 1 << (sy & 0x07);
+        for (lcdint_t x = x1; x <= x2; x++, src++)
+        {
+            if (pgm_read_byte(src) & mask)
+                canvasPut4(row, x, color);
+            else if (!transparent)
+                canvasPut4(row, x, 0);
+        }
+    }
+}
+
+template <>
+void NanoCanvasOps<4>::drawBitmap8(lcdint_t xpos, lcdint_t ypos, lcduint_t w, lcduint_t h, const uint8_t *bitmap)
+{
+    /* calculate char rectangle */
+    lcdint_t x1 = xpos - offset.x;
+    lcdint_t y1 = ypos - offset.y;
+    lcdint_t x2 = x1 + (lcdint_t)w - 1;
+    lcdint_t y2 = y1 + (lcdint_t)h - 1;
+    /* clip bitmap */
+    if ((x2 < 0) || (x1 >= (lcdint_t)m_w)) return;
+    if ((y2 < 0) || (y1 >= (lcdint_t)m_h)) return;
+
+    if (x1 < 0)
+    {
+        bitmap -= x1;
+        x1 = 0;
+    }
+    if (y1 < 0)
+    {
+        bitmap += (lcduint_t)(-y1) * w;
+        y1 = 0;
+    }
+    if (y2 >= (lcdint_t)m_h)
+    {
+         y2 = (lcdint_t)m_h - 1;
+    }
+    if (x2 >= (lcdint_t)m_w)
+    {
+         x2 = (lcdint_t)m_w - 1;
+    }
+    bool transparent = m_textMode & CANVAS_MODE_TRANSPARENT;
+    uint8_t *row = m_buf + YADDR4(y1);
+    for (lcdint_t y = y1; y <= y2; y++, row += STRIDE4, bitmap += w)
+    {
+        for (lcdint_t x = x1; x <= x2; x++)
+        {
+            uint8_t data = pgm_read_byte(&bitmap[x - x1]) & 0x0F;
+            if (data || !transparent) canvasPut4(row, x, data);
+        }
+    }
+}
+
+template <>
+void NanoCanvasOps<4>::clear()
+{
+    memset(m_buf, 0, YADDR4(m_h));
+}
+
+/* This method must be implemented always after clear() */
+template <>
+void NanoCanvasOps<4>::begin(lcdint_t w, lcdint_t h, uint8_t *bytes)
+{
+    m_w = w;
+    m_h = h;
+    offset.x = 0;
+    offset.y = 0;
+    m_cursorX = 0;
+    m_cursorY = 0;
+    m_color = 0x0F; // last palette entry, white by default
+    m_textMode = 0;
+    m_p = 3;
+    while (w >> (m_p+1)) { m_p++; };
+    m_buf = bytes;
+    clear();
+}
+
+//                NANO CANVAS 4
+
+const uint16_t NanoCanvas4::DEFAULT_PALETTE[16] =
+{
+    RGB_COLOR16(0, 0, 0),       RGB_COLOR16(128, 0, 0),     RGB_COLOR16(0, 128, 0),
+    RGB_COLOR16(128, 128, 0),   RGB_COLOR16(0, 0, 128),     RGB_COLOR16(128, 0, 128),
+    RGB_COLOR16(0, 128, 128),   RGB_COLOR16(192, 192, 192), RGB_COLOR16(128, 128, 128),
+    RGB_COLOR16(255, 0, 0),     RGB_COLOR16(0, 255, 0),     RGB_COLOR16(255, 255, 0),
+    RGB_COLOR16(0, 0, 255),     RGB_COLOR16(255, 0, 255),   RGB_COLOR16(0, 255, 255),
+    RGB_COLOR16(255, 255, 255),
+};
+
+void NanoCanvas4::blt(lcdint_t x, lcdint_t y)
+{
+    ssd1306_drawBufferFast4(x, y, m_w, m_h, m_buf, m_palette);
+}
+
+void NanoCanvas4::blt()
+{
+    ssd1306_drawBufferFast4(offset.x, offset.y, m_w, m_h, m_buf, m_palette);
+}
+
 /////////////////////////////////////////////////////////////////////////////////
 //
 //                             8-BIT GRAPHICS
@@ -547,12 +952,8 @@ void NanoCanvasOps<8>::fillRect(lcdint_t x1, lcdint_t y1, lcdint_t x2, lcdint_t
     uint8_t *buf = m_buf + YADDR8(y1) + x1;
     for (lcdint_t y = y1; y <= y2; y++)
     {
-        for (lcdint_t x = x1; x <= x2; x++)
-        {
-            *buf = m_color;
-            buf++;
-        }
-        buf += ((lcdint_t)(m_w) - (x2 - x1 + 1));
+        memset(buf, m_color, x2 - x1 + 1);
+        buf += m_w;
     }
 }
 
@@ -588,29 +989,8 @@ void NanoCanvasOps<8>::drawBitmap1(lcdint_t xpos, lcdint_t ypos, lcduint_t w, lc
     {
          x2 = (lcdint_t)m_w - 1;
     }
-    uint8_t offs2 = 8 - offs;
-    lcdint_t y = y1;
-    while ( y <= y2)
-    {
-        for ( lcdint_t x = x1; x <= x2; x++ )
-        {
-            uint8_t data = pgm_read_byte( bitmap );
-            uint16_t addr = YADDR8(y) + x;
-            for (uint8_t n = 0; n < min(y2 - y + 1, 8); n++)
-            {
-                if ( data & (1<<(n + offs)) )
-                    m_buf[addr] = m_color;
-                else if (!(m_textMode & CANVAS_MODE_TRANSPARENT))
-                    m_buf[addr] = 0x00;
-                addr += (lcduint_t)m_w;
-            }
-            bitmap++;
-        }
-        bitmap += (w - (x2 - x1 + 1));
-        y = y + offs2;
-        offs = 0;
-        offs2 = 8;
-    }
+    canvasBlit1<1>(m_buf + YADDR8(y1) + x1, m_w, bitmap, w, x2 - x1 + 1, y2 - y1 + 1,
+                   offs, m_color, m_textMode & CANVAS_MODE_TRANSPARENT);
 }
 
 template <>
@@ -643,20 +1023,25 @@ void NanoCanvasOps<8>::drawBitmap8(lcdint_t xpos, lcdint_t ypos, lcduint_t w, lc
     {
          x2 = (lcdint_t)m_w - 1;
     }
-    lcdint_t y = y1;
-    while ( y <= y2 )
+    lcduint_t cols = x2 - x1 + 1;
+    uint8_t *buf = m_buf + YADDR8(y1) + x1;
+    for (lcdint_t y = y1; y <= y2; y++, buf += m_w, bitmap += w)
     {
-        for ( lcdint_t x = x1; x <= x2; x++ )
+        if (m_textMode & CANVAS_MODE_TRANSPARENT)
         {
-            uint8_t data = pgm_read_byte( bitmap );
-            if ( (data) || (!(m_textMode & CANVAS_MODE_TRANSPARENT)) )
+            for (lcduint_t x = 0; x < cols; x++)
             {
-                m_buf[YADDR8(y) + x] = data;
+                uint8_t data = pgm_read_byte(&bitmap[x]);
+                if (data) buf[x] = data;
+            }
+        }
+        else
+        {
+            for (lcduint_t x = 0; x < cols; x++)
+            {
+                buf[x] = pgm_read_byte(&bitmap[x]);
             }
-            bitmap++;
         }
-        bitmap += (w - (x2 - x1 + 1));
-        y++;
     }
 }
 
@@ -789,13 +1174,8 @@ void NanoCanvasOps<16>::fillRect(lcdint_t x1, lcdint_t y1, lcdint_t x2, lcdint_t
     uint8_t *buf = m_buf + YADDR16(y1) + (x1<<1);
     for (lcdint_t y = y1; y <= y2; y++)
     {
-        for (lcdint_t x = x1; x <= x2; x++)
-        {
-            buf[0] = m_color >> 8;
-            buf[1] = m_color & 0xFF;
-            buf+=2;
-        }
-        buf += ( ((lcdint_t)(m_w) - (x2 - x1 + 1)) <<1 );
+        canvasFill16(buf, m_color, x2 - x1 + 1);
+        buf += (lcdint_t)(m_w) << 1;
     }
 }
 
@@ -831,35 +1211,8 @@ void NanoCanvasOps<16>::drawBitmap1(lcdint_t xpos, lcdint_t ypos, lcduint_t w, l
     {
          x2 = (lcdint_t)m_w - 1;
     }
-    uint8_t offs2 = 8 - offs;
-    lcdint_t y = y1;
-    while ( y <= y2)
-    {
-        for ( lcdint_t x = x1; x <= x2; x++ )
-        {
-            uint8_t data = pgm_read_byte( bitmap );
-            uint16_t addr = YADDR16(y) + (x<<1);
-            for (uint8_t n = 0; n < min(y2 - y + 1, 8); n++)
-            {
-                if ( data & (1<<(n + offs)) )
-                {
-                    m_buf[addr] = m_color >> 8;
-                    m_buf[addr+1] = m_color & 0xFF;
-                }
-                else if (!(m_textMode & CANVAS_MODE_TRANSPARENT))
-                {
-                    m_buf[addr] = 0x00;
-                    m_buf[addr+1] = 0x00;
-                }
-                addr += ((lcduint_t)m_w << 1);
-            }
-            bitmap++;
-        }
-        bitmap += (w - (x2 - x1 + 1));
-        y = y + offs2;
-        offs = 0;
-        offs2 = 8;
-    }
+    canvasBlit1<2>(m_buf + YADDR16(y1) + (x1<<1), (lcduint_t)m_w << 1, bitmap, w, x2 - x1 + 1, y2 - y1 + 1,
+                   offs, m_color, m_textMode & CANVAS_MODE_TRANSPARENT);
 }
 
 template <>
@@ -892,23 +1245,24 @@ void NanoCanvasOps<16>::drawBitmap8(lcdint_t xpos, lcdint_t ypos, lcduint_t w, l
     {
          x2 = (lcdint_t)m_w - 1;
     }
-    lcdint_t y = y1;
-    while ( y <= y2 )
+    lcduint_t cols = x2 - x1 + 1;
+    bool transparent = m_textMode & CANVAS_MODE_TRANSPARENT;
+    uint8_t *buf = m_buf + YADDR16(y1) + (x1<<1);
+    for (lcdint_t y = y1; y <= y2; y++, buf += (lcduint_t)m_w << 1, bitmap += w)
     {
-        for ( lcdint_t x = x1; x <= x2; x++ )
+        uint8_t *p = buf;
+        for (lcduint_t x = 0; x < cols; x++, p += 2)
         {
-            uint8_t data = pgm_read_byte( bitmap );
-            if ( (data) || (!(m_textMode & CANVAS_MODE_TRANSPARENT)) )
+            uint8_t data = pgm_read_byte(&bitmap[x]);
+            if ( data || !transparent )
             {
                 uint16_t color = (((uint16_t)data & 0b11100000) << 8) |
                                  (((uint16_t)data & 0b00011100) << 6) |
                                  (((uint16_t)data & 0b00000011) << 3);
-                m_buf[YADDR16(y) + (x<<1)] = color;
+                p[0] = color >> 8;
+                p[1] = color & 0xFF;
             }
-            bitmap++;
         }
-        bitmap += (w - (x2 - x1 + 1));
-        y++;
     }
 }
 
@@ -936,6 +1290,41 @@ void NanoCanvasOps<16>::begin(lcdint_t w, lcdint_t h, uint8_t *bytes)
     clear();
 }
 
+template <uint8_t BPP>
+void NanoCanvasOps<BPP>::copyFrom(const uint8_t *bytes, lcduint_t w, lcduint_t h)
+{
+    lcdint_t x = offset.x;
+    lcdint_t y = offset.y;
+    lcduint_t cols = (x < 0) || (x >= (lcdint_t)w) ? 0 : min((lcdint_t)m_w, (lcdint_t)w - x);
+    lcduint_t rows = (y < 0) || (y >= (lcdint_t)h) ? 0 : min((lcdint_t)m_h, (lcdint_t)h - y);
+    if ((cols < m_w) || (rows < m_h))
+    {
+        clear();
+    }
+    if (!cols || !rows)
+    {
+        return;
+    }
+    if (BPP == 1)
+    {
+        // 8 rows share a byte, the buffer is a row of pages w bytes long
+        for (lcduint_t page = 0; page < ((rows + 7) >> 3); page++)
+        {
+            memcpy(m_buf + page * m_w, bytes + (uint32_t)((y >> 3) + page) * w + x, cols);
+        }
+        return;
+    }
+    const uint32_t stride = ((uint32_t)m_w * BPP + 7) >> 3;
+    const uint32_t srcStride = ((uint32_t)w * BPP + 7) >> 3;
+    const uint32_t len = ((uint32_t)cols * BPP + 7) >> 3;
+    const uint8_t *src = bytes + (uint32_t)y * srcStride + (((uint32_t)x * BPP) >> 3);
+    for (lcduint_t row = 0; row < rows; row++)
+    {
+        memcpy(m_buf + row * stride, src, len);
+        src += srcStride;
+    }
+}
+
 /////////////////////////////////////////////////////////////////////////////////
 //
 //                      NanoCanvasOps class initiation
@@ -943,6 +1332,7 @@ void NanoCanvasOps<16>::begin(lcdint_t w, lcdint_t h, uint8_t *bytes)
 /////////////////////////////////////////////////////////////////////////////////
 
 template class NanoCanvasOps<1>;
+template class NanoCanvasOps<4>;
 template class NanoCanvasOps<8>;
 template class NanoCanvasOps<16>;
 
@@ -248,6 +248,16 @@ public:
      */
     size_t write(uint8_t c) override;
 
+    /**
+     * Writes a run of chars to canvas. Style and wrap limits are
+     * taken once for the run.
+     * @param buffer - chars to print
+     * @param size - number of chars in buffer
+     */
+    size_t write(const uint8_t *buffer, size_t size) override;
+
+    using Print::write;
+
     /**
      * Draws single character to canvas
      * @param c - character code to print
@@ -292,6 +302,35 @@ public:
      */
     void setColor(uint16_t color) { m_color = color; };
 
+    /**
+     * Switches canvas to another memory buffer and size. Unlike begin(), the
+     * content, offset, color and mode are left as they are.
+     *
+     * @param w - width
+     * @param h - height
+     * @param bytes - pointer to memory buffer to use
+     */
+    void setBuffer(lcdint_t w, lcdint_t h, uint8_t *bytes)
+    {
+        m_w = w;
+        m_h = h;
+        m_p = 3;
+        while (w >> (m_p+1)) { m_p++; };
+        m_buf = bytes;
+    }
+
+    /**
+     * Copies the area under the canvas from a bigger buffer of the same canvas type,
+     * the canvas offset being the position of the area in it. Parts of the canvas
+     * outside the buffer are cleared. For 1-bit canvases offset y must be a multiple
+     * of 8, for 4-bit ones offset x must be even, as for engine tiles.
+     *
+     * @param bytes - buffer to copy from
+     * @param w - width of the buffer in pixels
+     * @param h - height of the buffer in pixels
+     */
+    void copyFrom(const uint8_t *bytes, lcduint_t w, lcduint_t h);
+
 protected:
     lcduint_t m_w;    ///< width of NanoCanvas area in pixels
     lcduint_t m_h;    ///< height of NanoCanvas area in pixels
@@ -384,6 +423,54 @@ public:
     void blt() override;
 };
 
+/////////////////////////////////////////////////////////////////////////////////
+//
+//                             4-BIT GRAPHICS
+//
+/////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * NanoCanvas4 represents objects for drawing in memory buffer
+ * NanoCanvas4 keeps 2 pixels in each byte, the left one in the high nibble.
+ * Pixels are indexes in a palette of 16 RGB565 colors, which is applied only
+ * when the canvas is sent to the display, so it works with 16-bit displays in
+ * normal mode. Each row starts with a new byte, buffer size is ((w + 1) / 2) * h.
+ * setColor() takes palette index, drawBitmap8() takes bitmaps of one index per byte.
+ */
+class NanoCanvas4: public NanoCanvasBase<4>
+{
+public:
+    using NanoCanvasBase::NanoCanvasBase;
+
+    /** Default palette: black, 7 dark colors, gray, 7 bright colors */
+    static const uint16_t DEFAULT_PALETTE[16];
+
+    /**
+     * Sets palette to use for blt(). Palette is not copied and can be changed
+     * at any moment, changes show up on the next blt().
+     * @param palette - 16 RGB565 colors, located in RAM, or NULL for DEFAULT_PALETTE.
+     */
+    void setPalette(const uint16_t *palette) { m_palette = palette ? palette : DEFAULT_PALETTE; };
+
+    /** Returns palette used by blt() */
+    const uint16_t *palette() const { return m_palette; };
+
+    /**
+     * Draws canvas on the LCD display
+     * @param x - horizontal position in pixels
+     * @param y - vertical position in pixels
+     */
+    void blt(lcdint_t x, lcdint_t y) override;
+
+    /**
+     * Draws canvas on the LCD display using offset values.
+     */
+    void blt() override;
+
+private:
+    const uint16_t *m_palette = DEFAULT_PALETTE;
+};
+
 /////////////////////////////////////////////////////////////////////////////////
 //
 //                             8-BIT GRAPHICS
@@ -422,6 +509,8 @@ public:
 /**
  * NanoCanvas16 represents objects for drawing in memory buffer
  * NanoCanvas16 represents each pixel as 2-bytes with RGB bits: RRRRRGGG-GGGBBBBB
+ * The high byte is stored first, which is the order 16-bit controllers take
+ * over SPI, so blt() passes the buffer to the interface without conversion.
  * For details refer to SSD1351 datasheet
  */
 class NanoCanvas16: public NanoCanvasBase<16>
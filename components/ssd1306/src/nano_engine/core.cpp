@@ -100,6 +100,12 @@ void NanoEngineInputs::connectGpioKeypad(const uint8_t * gpioKeys)
     sdl_set_gpio_keys(gpioKeys);
 #endif
     m_onButtons = gpioButtons;
+#if defined(CONFIG_PLATFORM_INPUTS_AVAILABLE)
+    if (ssd1306_platform_buttonsStart(gpioKeys, 6, HIGH) == 0)
+    {
+        m_onButtons = gpioIrqButtons;
+    }
+#endif
 }
 
 uint8_t NanoEngineInputs::gpioButtons()
@@ -114,12 +120,23 @@ uint8_t NanoEngineInputs::gpioButtons()
     return buttons;
 }
 
+uint8_t NanoEngineInputs::s_ky40_clk;
+uint8_t NanoEngineInputs::s_ky40_dt;
+uint8_t NanoEngineInputs::s_ky40_sw;
+
 void NanoEngineInputs::connectKY40encoder(uint8_t pina_clk, uint8_t pinb_dt, int8_t pinc_sw)
 {
     s_ky40_clk = pina_clk;
     s_ky40_dt = pinb_dt;
     s_ky40_sw = pinc_sw;
     m_onButtons = ky40Buttons;
+#if defined(CONFIG_PLATFORM_INPUTS_AVAILABLE)
+    s_ky40_steps = 0;
+    if (ssd1306_platform_encoderStart(pina_clk, pinb_dt) == 0)
+    {
+        m_onButtons = ky40CounterButtons;
+    }
+#endif
 }
 
 uint8_t NanoEngineInputs::ky40Buttons()
@@ -146,6 +163,36 @@ uint8_t NanoEngineInputs::ky40Buttons()
     return buttons;
 }
 
+#if defined(CONFIG_PLATFORM_INPUTS_AVAILABLE)
+int16_t NanoEngineInputs::s_ky40_steps = 0;
+
+uint8_t NanoEngineInputs::gpioIrqButtons()
+{
+    return ssd1306_platform_buttons();
+}
+
+uint8_t NanoEngineInputs::ky40CounterButtons()
+{
+    uint8_t buttons = BUTTON_NONE;
+    s_ky40_steps += ssd1306_platform_encoderSteps();
+    if ( s_ky40_steps > 0 )
+    {
+        buttons = BUTTON_DOWN;
+        s_ky40_steps--;
+    }
+    else if ( s_ky40_steps < 0 )
+    {
+        buttons = BUTTON_UP;
+        s_ky40_steps++;
+    }
+    if ( s_ky40_sw >=0 && digitalRead( s_ky40_sw ) == LOW )
+    {
+        buttons |= BUTTON_A;
+    }
+    return buttons;
+}
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////
 ////// NANO ENGINE CORE CLASS /////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
@@ -163,19 +210,64 @@ uint8_t   NanoEngineCore::m_cpuLoad = 0;
 uint32_t  NanoEngineCore::m_lastFrameTs;
 /** Callback to call before starting oled update */
 TLoopCallback NanoEngineCore::m_loop = nullptr;
+#if defined(CONFIG_PLATFORM_SLEEP_AVAILABLE)
+uint32_t  NanoEngineCore::m_frameDurationUs = 1000000/ENGINE_DEFAULT_FPS;
+uint32_t  NanoEngineCore::m_frameStartUs;
+uint32_t  NanoEngineCore::m_frameTimeUs = 0;
+uint32_t  NanoEngineCore::m_frameJitterUs = 0;
+uint32_t  NanoEngineCore::m_missedFrames = 0;
+#endif
 
 
 void NanoEngineCore::begin()
 {
     m_lastFrameTs = millis();
+#if defined(CONFIG_PLATFORM_SLEEP_AVAILABLE)
+    m_frameStartUs = micros();
+#endif
 }
 
 void NanoEngineCore::setFrameRate(uint8_t fps)
 {
     m_fps = fps;
     m_frameDurationMs = 1000/fps;
+#if defined(CONFIG_PLATFORM_SLEEP_AVAILABLE)
+    m_frameDurationUs = 1000000UL/fps;
+#endif
 }
 
+#if defined(CONFIG_PLATFORM_SLEEP_AVAILABLE)
+
+bool NanoEngineCore::nextFrame()
+{
+    uint32_t deadline = m_frameStartUs + m_frameDurationUs;
+    ssd1306_platform_sleepUntil(deadline);
+    uint32_t late = micros() - deadline;
+    if (late >= m_frameDurationUs)
+    {
+        // Whole frames went by, the schedule starts over from now
+        // instead of rushing out the frames missed
+        m_missedFrames += late / m_frameDurationUs;
+        deadline += late;
+    }
+    else
+    {
+        m_frameJitterUs = (m_frameJitterUs * 7 + late) / 8;
+    }
+    m_frameStartUs = deadline;
+    if (m_loop) m_loop();
+    return true;
+}
+
+void NanoEngineCore::frameDone()
+{
+    m_frameTimeUs = micros() - m_frameStartUs;
+    uint32_t load = (uint32_t)(((uint64_t)m_frameTimeUs * 100) / m_frameDurationUs);
+    m_cpuLoad = load > 255 ? 255 : load;
+}
+
+#else
+
 bool NanoEngineCore::nextFrame()
 {
     bool needUpdate = (uint32_t)(millis() - m_lastFrameTs) >= m_frameDurationMs;
@@ -183,3 +275,5 @@ bool NanoEngineCore::nextFrame()
     return needUpdate;
 }
 
+#endif
+
@@ -119,7 +119,10 @@ public:
 
     /**
      * @brief Configures NanoEngine to use KY40 Rotary Encoder.
-     * Configures NanoEngine to use KY40 Rotary Encoder.
+     * Configures NanoEngine to use KY40 Rotary Encoder. Where the platform has
+     * counters (CONFIG_PLATFORM_INPUTS_AVAILABLE) steps are counted in hardware,
+     * and each buttonsState() call reports one of the steps made since, so none
+     * are lost when frames are slow.
      * @param pina_clk pin number to use as clk (see KY40 docs).
      * @param pinb_dt pin number to use as direction pin (see KY40 docs).
      * @param pinc_sw optional pin number ot use as push button.
@@ -134,6 +137,9 @@ public:
      * Down, Left, Right, Up, A, B. If you don't want to use some specific button,
      * then just set not used button to 0.
      * Once you call this function, you can read buttons state via buttonsState().
+     * Where the platform has button interrupts (CONFIG_PLATFORM_INPUTS_AVAILABLE)
+     * pins are not read by buttonsState(), and a press shorter than a frame is
+     * still reported once.
      *
      * @param gpioKeys pointer to 6-button pins array.
      *
@@ -155,6 +161,11 @@ private:
     static uint8_t arduboyButtons();
     static uint8_t gpioButtons();
     static uint8_t ky40Buttons();
+#if defined(CONFIG_PLATFORM_INPUTS_AVAILABLE)
+    static int16_t s_ky40_steps;
+    static uint8_t gpioIrqButtons();
+    static uint8_t ky40CounterButtons();
+#endif
 };
 
 
@@ -195,8 +206,29 @@ public:
      */
     static uint8_t getCpuLoad() { return m_cpuLoad; };
 
+#if defined(CONFIG_PLATFORM_SLEEP_AVAILABLE)
+    /**
+     * Returns time in microseconds from the deadline of the last frame until
+     * display() finished it, the loop callback included.
+     */
+    static uint32_t getFrameTimeUs() { return m_frameTimeUs; };
+
     /**
-     * Returns true if it is time to render next frame
+     * Returns how late frames start after their deadline in microseconds,
+     * averaged over the last frames.
+     */
+    static uint32_t getFrameJitterUs() { return m_frameJitterUs; };
+
+    /**
+     * Returns number of frame deadlines passed without a frame
+     */
+    static uint32_t getMissedFrames() { return m_missedFrames; };
+#endif
+
+    /**
+     * Returns true if it is time to render next frame.
+     * On platforms, which can sleep until a point in time, the call blocks
+     * until the next frame deadline and always returns true.
      */
     static bool nextFrame();
 
@@ -218,6 +250,18 @@ protected:
     static uint32_t  m_lastFrameTs;
     /** Callback to call before starting oled update */
     static TLoopCallback m_loop;
+#if defined(CONFIG_PLATFORM_SLEEP_AVAILABLE)
+    /** Duration between frames in microseconds */
+    static uint32_t  m_frameDurationUs;
+    /** Deadline in microseconds of the frame being drawn */
+    static uint32_t  m_frameStartUs;
+    static uint32_t  m_frameTimeUs;
+    static uint32_t  m_frameJitterUs;
+    static uint32_t  m_missedFrames;
+
+    /** Updates frame time and cpu load once display() has sent the frame */
+    static void frameDone();
+#endif
 };
 
 /**
@@ -268,7 +312,11 @@ void NanoEngine<C,W,H,B>::display()
 {
     m_lastFrameTs = millis();
     NanoEngineTiler<C,W,H,B>::displayBuffer();
+#if defined(CONFIG_PLATFORM_SLEEP_AVAILABLE)
+    frameDone();
+#else
     m_cpuLoad = ((millis() - m_lastFrameTs)*100)/m_frameDurationMs;
+#endif
 }
 
 template<class C, uint8_t W, uint8_t H, uint8_t B>
@@ -286,7 +334,7 @@ void NanoEngine<C,W,H,B>::notify(const char *str)
 {
     NanoEngineTiler<C,W,H,B>::displayPopup(str);
     delay(1000);
-    m_lastFrameTs = millis();
+    NanoEngineCore::begin();
     NanoEngineTiler<C,W,H,B>::refresh();
 }
 
@@ -0,0 +1,352 @@
+/*
+    MIT License
+
+    Copyright (c) 2018, Alexey Dynda
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+/**
+ * @file frame.h Full-frame canvas, sending only the changed areas
+ */
+
+
+#ifndef _NANO_ENGINE_FRAME_H_
+#define _NANO_ENGINE_FRAME_H_
+
+#include "canvas.h"
+#include "lcd/lcd_common.h"
+#include "intf/ssd1306_interface.h"
+#include "ssd1306_fonts.h"
+#include <stdlib.h>
+
+/**
+ * @ingroup NANO_ENGINE_API
+ * @{
+ */
+
+extern "C" SFixedFontInfo s_fixedFont;
+
+#ifndef NE_FRAME_DIRTY_RECTS
+/** Number of separate areas NanoFrameCanvas tracks, more ones are merged */
+#define NE_FRAME_DIRTY_RECTS   8
+#endif
+
+/** Sends len pixels of 16-bit canvas, located in one row or in full rows */
+inline void nanoFrameSendPixels(const NanoCanvasOps<16> &, const uint8_t *data, uint32_t len)
+{
+    len <<= 1;
+    while (len)
+    {
+        uint16_t size = len > 0x8000 ? 0x8000 : len;
+        ssd1306_intf.send_buffer(data, size);
+        data += size;
+        len -= size;
+    }
+}
+
+/** Sends len pixels of 8-bit canvas, located in one row or in full rows */
+inline void nanoFrameSendPixels(const NanoCanvasOps<8> &, const uint8_t *data, uint32_t len)
+{
+    while (len)
+    {
+        uint16_t size = len > 0x8000 ? 0x8000 : len;
+        if (ssd1306_lcd.send_pixels_buffer8)
+        {
+            ssd1306_lcd.send_pixels_buffer8(data, size);
+        }
+        else
+        {
+            for (uint16_t i = 0; i < size; i++) ssd1306_lcd.send_pixels8(data[i]);
+        }
+        data += size;
+        len -= size;
+    }
+}
+
+/** Sends len pixels of 4-bit canvas, starting with the high nibble of data */
+inline void nanoFrameSendPixels(const NanoCanvas4 &canvas, const uint8_t *data, uint32_t len)
+{
+    while (len)
+    {
+        uint16_t size = len > 0x8000 ? 0x8000 : len;
+        ssd1306_sendPixels4Rgb16(data, size, canvas.palette());
+        data += size >> 1;
+        len -= size;
+    }
+}
+
+/**
+ * NanoFrameCanvas keeps the whole display in memory, like NanoCanvas8, NanoCanvas16
+ * or NanoCanvas4 given as C, and remembers the areas drawn since the last flush().
+ * flush() sends only those areas, so there is no need for NanoEngine draw callbacks
+ * when the frame fits in memory. On ESP32 with CONFIG_SPIRAM_SUPPORT the frame is
+ * allocated in PSRAM, SPI transport copies the data to its DMA buffers.
+ *
+ * Only drawing functions of this class mark changed areas. If the buffer is changed
+ * by other means, call refresh() for the area.
+ */
+template <class C>
+class NanoFrameCanvas: public C
+{
+public:
+    NanoFrameCanvas(): C() {}
+
+    ~NanoFrameCanvas() { end(); }
+
+    /**
+     * Allocates the frame, clears it and marks it for sending.
+     * @param w - width in pixels, the display width by default
+     * @param h - height in pixels, the display height by default
+     * @return false if there is no memory for the frame
+     */
+    bool begin(lcduint_t w = 0, lcduint_t h = 0)
+    {
+        end();
+        if (!w) w = ssd1306_lcd.width;
+        if (!h) h = ssd1306_lcd.height;
+        uint32_t size = ((uint32_t)w * h * C::BITS_PER_PIXEL + 7) >> 3;
+#if defined(CONFIG_PLATFORM_FRAME_ALLOC_AVAILABLE)
+        m_frame = static_cast<uint8_t *>(ssd1306_platform_frameAlloc(size));
+#else
+        m_frame = static_cast<uint8_t *>(malloc(size));
+#endif
+        if (!m_frame)
+        {
+            return false;
+        }
+        C::begin(w, h, m_frame);
+        refresh();
+        return true;
+    }
+
+    /** Frees the frame */
+    void end()
+    {
+        if (!m_frame)
+        {
+            return;
+        }
+#if defined(CONFIG_PLATFORM_FRAME_ALLOC_AVAILABLE)
+        ssd1306_platform_frameFree(m_frame);
+#else
+        free(m_frame);
+#endif
+        m_frame = nullptr;
+        m_dirtyCount = 0;
+    }
+
+    /** Marks the whole frame for sending */
+    void refresh()
+    {
+        m_dirtyCount = 0;
+        markLocal(0, 0, C::m_w - 1, C::m_h - 1);
+    }
+
+    /** Marks an area in canvas coordinates (offset applied) for sending */
+    void refresh(lcdint_t x1, lcdint_t y1, lcdint_t x2, lcdint_t y2)
+    {
+        markLocal(x1 - C::offset.x, y1 - C::offset.y, x2 - C::offset.x, y2 - C::offset.y);
+    }
+
+    /** Marks an area in canvas coordinates (offset applied) for sending */
+    void refresh(const NanoRect &rect) { refresh(rect.p1.x, rect.p1.y, rect.p2.x, rect.p2.y); }
+
+    /** Returns number of areas waiting for flush() */
+    uint8_t dirtyCount() const { return m_dirtyCount; }
+
+    /**
+     * Sends the areas changed since the last call to the display, the canvas
+     * offset is its position on the display.
+     */
+    void flush()
+    {
+        for (uint8_t i = 0; i < m_dirtyCount; i++)
+        {
+            sendRect(m_dirty[i]);
+        }
+        m_dirtyCount = 0;
+    }
+
+    void putPixel(lcdint_t x, lcdint_t y) { C::putPixel(x, y); refresh(x, y, x, y); }
+
+    void putPixel(const NanoPoint &p) { putPixel(p.x, p.y); }
+
+    void drawHLine(lcdint_t x1, lcdint_t y1, lcdint_t x2) { C::drawHLine(x1, y1, x2); refresh(x1, y1, x2, y1); }
+
+    void drawVLine(lcdint_t x1, lcdint_t y1, lcdint_t y2) { C::drawVLine(x1, y1, y2); refresh(x1, y1, x1, y2); }
+
+    /* NanoCanvasOps line steps can end a pixel past the end points */
+    void drawLine(lcdint_t x1, lcdint_t y1, lcdint_t x2, lcdint_t y2)
+    {
+        C::drawLine(x1, y1, x2, y2);
+        refresh(min(x1, x2) - 1, min(y1, y2) - 1, max(x1, x2) + 1, max(y1, y2) + 1);
+    }
+
+    void drawLine(const NanoRect &rect) { drawLine(rect.p1.x, rect.p1.y, rect.p2.x, rect.p2.y); }
+
+    void drawRect(lcdint_t x1, lcdint_t y1, lcdint_t x2, lcdint_t y2) { C::drawRect(x1, y1, x2, y2); refresh(x1, y1, x2, y2); }
+
+    void drawRect(const NanoRect &rect) { drawRect(rect.p1.x, rect.p1.y, rect.p2.x, rect.p2.y); }
+
+    void fillRect(lcdint_t x1, lcdint_t y1, lcdint_t x2, lcdint_t y2) { C::fillRect(x1, y1, x2, y2); refresh(x1, y1, x2, y2); }
+
+    void fillRect(const NanoRect &rect) { fillRect(rect.p1.x, rect.p1.y, rect.p2.x, rect.p2.y); }
+
+    void drawBitmap1(lcdint_t x, lcdint_t y, lcduint_t w, lcduint_t h, const uint8_t *bitmap)
+    {
+        C::drawBitmap1(x, y, w, h, bitmap);
+        refresh(x, y, x + (lcdint_t)w - 1, y + (lcdint_t)h - 1);
+    }
+
+    void drawBitmap8(lcdint_t x, lcdint_t y, lcduint_t w, lcduint_t h, const uint8_t *bitmap)
+    {
+        C::drawBitmap8(x, y, w, h, bitmap);
+        refresh(x, y, x + (lcdint_t)w - 1, y + (lcdint_t)h - 1);
+    }
+
+    void clear() { C::clear(); refresh(); }
+
+    /* Text can wrap, so the rows from the text line to the bottom are marked */
+    size_t write(uint8_t c) override
+    {
+        lcdint_t y = C::m_cursorY;
+        size_t result = C::write(c);
+        markLocal(0, min(y, C::m_cursorY) - C::offset.y, C::m_w - 1, C::m_h - 1);
+        return result;
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        lcdint_t y = C::m_cursorY;
+        size_t result = C::write(buffer, size);
+        markLocal(0, min(y, C::m_cursorY) - C::offset.y, C::m_w - 1, C::m_h - 1);
+        return result;
+    }
+
+    using C::write;
+
+    void printFixed(lcdint_t xpos, lcdint_t y, const char *ch, EFontStyle style = STYLE_NORMAL)
+    {
+        C::printFixed(xpos, y, ch, style);
+        markLocal(0, y - C::offset.y, C::m_w - 1, C::m_h - 1);
+    }
+
+    void printFixedPgm(lcdint_t xpos, lcdint_t y, const char *ch, EFontStyle style = STYLE_NORMAL)
+    {
+        C::printFixedPgm(xpos, y, ch, style);
+        markLocal(0, y - C::offset.y, C::m_w - 1, C::m_h - 1);
+    }
+
+private:
+    uint8_t  *m_frame = nullptr;
+    NanoRect  m_dirty[NE_FRAME_DIRTY_RECTS];
+    uint8_t   m_dirtyCount = 0;
+
+    static uint32_t area(const NanoRect &r) { return (uint32_t)r.width() * r.height(); }
+
+    static NanoRect merged(const NanoRect &a, const NanoRect &b)
+    {
+        return { { min(a.p1.x, b.p1.x), min(a.p1.y, b.p1.y) },
+                 { max(a.p2.x, b.p2.x), max(a.p2.y, b.p2.y) } };
+    }
+
+    static bool touching(const NanoRect &a, const NanoRect &b)
+    {
+        return (a.p1.x <= b.p2.x + 1) && (b.p1.x <= a.p2.x + 1) &&
+               (a.p1.y <= b.p2.y + 1) && (b.p1.y <= a.p2.y + 1);
+    }
+
+    /** Adds an area in buffer coordinates, touching areas are merged into one */
+    void markLocal(lcdint_t x1, lcdint_t y1, lcdint_t x2, lcdint_t y2)
+    {
+        if (x1 > x2) ssd1306_swap_data(x1, x2, lcdint_t);
+        if (y1 > y2) ssd1306_swap_data(y1, y2, lcdint_t);
+        if ((x2 < 0) || (y2 < 0) || (x1 >= (lcdint_t)C::m_w) || (y1 >= (lcdint_t)C::m_h)) return;
+        NanoRect rect = { { max(x1, (lcdint_t)0), max(y1, (lcdint_t)0) },
+                          { min(x2, (lcdint_t)(C::m_w - 1)), min(y2, (lcdint_t)(C::m_h - 1)) } };
+        uint8_t i = 0;
+        while (i < m_dirtyCount)
+        {
+            if (touching(m_dirty[i], rect))
+            {
+                // the bigger area can touch others, so look through all again
+                rect = merged(m_dirty[i], rect);
+                m_dirty[i] = m_dirty[--m_dirtyCount];
+                i = 0;
+                continue;
+            }
+            i++;
+        }
+        if (m_dirtyCount == NE_FRAME_DIRTY_RECTS)
+        {
+            // grow the area, which adds the least pixels to send
+            uint8_t best = 0;
+            uint32_t bestGrowth = 0xFFFFFFFF;
+            for (i = 0; i < m_dirtyCount; i++)
+            {
+                uint32_t growth = area(merged(m_dirty[i], rect)) - area(m_dirty[i]);
+                if (growth < bestGrowth)
+                {
+                    bestGrowth = growth;
+                    best = i;
+                }
+            }
+            rect = merged(m_dirty[best], rect);
+            m_dirty[best] = m_dirty[--m_dirtyCount];
+            // merged area is re-added, as it can touch the others now
+            markLocal(rect.p1.x, rect.p1.y, rect.p2.x, rect.p2.y);
+            return;
+        }
+        m_dirty[m_dirtyCount++] = rect;
+    }
+
+    void sendRect(NanoRect rect)
+    {
+        if (C::BITS_PER_PIXEL < 8)
+        {
+            // rows of 4-bit pixels are sent from whole bytes
+            rect.p1.x &= ~1;
+            rect.p2.x = min((lcdint_t)(rect.p2.x | 1), (lcdint_t)(C::m_w - 1));
+        }
+        lcduint_t w = rect.width();
+        lcduint_t h = rect.height();
+        uint32_t stride = ((uint32_t)C::m_w * C::BITS_PER_PIXEL + 7) >> 3;
+        const uint8_t *data = C::m_buf + rect.p1.y * stride + (((uint32_t)rect.p1.x * C::BITS_PER_PIXEL) >> 3);
+        ssd1306_lcd.set_block(rect.p1.x + C::offset.x, rect.p1.y + C::offset.y, w);
+        if ((w == C::m_w) && !((w * C::BITS_PER_PIXEL) & 7))
+        {
+            // full rows follow each other in the buffer
+            nanoFrameSendPixels(*this, data, (uint32_t)w * h);
+        }
+        else
+        {
+            for (lcduint_t row = 0; row < h; row++, data += stride)
+            {
+                nanoFrameSendPixels(*this, data, w);
+            }
+        }
+        ssd1306_intf.stop();
+    }
+};
+
+/**
+ * @}
+ */
+
+#endif
@@ -55,10 +55,16 @@ public:
      */
     NanoSprite(const NanoPoint &pos, const NanoPoint &size, const uint8_t *bitmap)
          : m_rect{pos, pos + size}
+         , m_shown{pos, pos + size}
          , m_bitmap( bitmap )
     {
     }
 
+    ~NanoSprite()
+    {
+        E.cancelMove( &m_shown );
+    }
+
     /**
      * Draws monochrome sprite on Engine canvas
      */
@@ -76,13 +82,13 @@ public:
     }
 
     /**
-     * Moves sprite to new position
+     * Moves sprite to new position. The area it leaves and the one it enters
+     * are marked for refreshing by the next frame, see NanoEngineTiler::refreshMove().
      */
     void moveTo(const NanoPoint &p)
     {
-        refresh();
         m_rect = { p, p + m_rect.size() };
-        refresh();
+        E.refreshMove( &m_shown, m_rect );
     }
 
     /**
@@ -90,9 +96,8 @@ public:
      */
     void moveBy(const NanoPoint &p)
     {
-        refresh();
         m_rect += p;
-        refresh();
+        E.refreshMove( &m_shown, m_rect );
     }
 
     /**
@@ -155,6 +160,8 @@ public:
 
 private:
     NanoRect       m_rect;
+    /** Area the sprite was shown in at the last frame */
+    NanoRect       m_shown;
     const uint8_t *m_bitmap;
 };
 
@@ -177,7 +184,13 @@ public:
          : m_pos(pos)
          , m_size(size)
          , m_bitmap( bitmap )
+         , m_shown{pos, pos + size - (NanoPoint){1, 1}}
+    {
+    }
+
+    ~NanoFixedSprite()
     {
+        E.cancelMove( &m_shown );
     }
 
     /**
@@ -202,9 +215,8 @@ public:
      */
     void moveTo(const NanoPoint &p)
     {
-        refresh();
         m_pos = p;
-        refresh();
+        E.refreshMove( &m_shown, { m_pos, m_pos + m_size - (NanoPoint){1, 1} } );
     }
 
     /**
@@ -212,9 +224,8 @@ public:
      */
     void moveBy(const NanoPoint &p)
     {
-        refresh();
         m_pos += p;
-        refresh();
+        E.refreshMove( &m_shown, { m_pos, m_pos + m_size - (NanoPoint){1, 1} } );
     }
 
     /**
@@ -293,6 +304,8 @@ protected:
 
 private:
     const uint8_t *m_bitmap;
+    /** Area the sprite was shown in at the last frame */
+    NanoRect       m_shown;
 };
 
 /**
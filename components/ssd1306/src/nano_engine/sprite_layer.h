@@ -0,0 +1,248 @@
+/*
+    MIT License
+
+    Copyright (c) 2018, Alexey Dynda
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+/**
+ * @file sprite_layer.h Sprites indexed by position
+ */
+
+#ifndef _NANO_SPRITE_LAYER_H_
+#define _NANO_SPRITE_LAYER_H_
+
+#include "point.h"
+#include "rect.h"
+#include "ssd1306_hal/io.h"
+
+/**
+ * @ingroup NANO_ENGINE_API
+ * @{
+ */
+
+#ifndef NE_SPRITE_LAYER_SIZE
+#if defined(__AVR__)
+/** Default number of sprites in NanoSpriteLayer, up to 32 */
+#define NE_SPRITE_LAYER_SIZE   8
+#else
+/** Default number of sprites in NanoSpriteLayer, up to 32 */
+#define NE_SPRITE_LAYER_SIZE   32
+#endif
+#endif
+
+/** Index cells of NanoSpriteLayer are (1 << NE_SPRITE_CELL_BITS) pixels wide and high */
+#define NE_SPRITE_CELL_BITS    5
+
+#if defined(__AVR__)
+#define NE_SPRITE_GRID_X       4
+#define NE_SPRITE_GRID_Y       2
+#else
+/** Index columns of NanoSpriteLayer, power of 2. Cells further apart share columns */
+#define NE_SPRITE_GRID_X       8
+/** Index rows of NanoSpriteLayer, power of 2. Cells further apart share rows */
+#define NE_SPRITE_GRID_Y       4
+#endif
+
+/**
+ * Replacement for SpritePool for NanoEngine. Sprites are kept in a grid of
+ * cells, each cell lists the sprites overlapping it. Drawing a tile only looks
+ * at the sprites listed in the cells under the tile instead of at every
+ * sprite, and moving a sprite refreshes only the tiles it leaves and enters.
+ * Sprites are drawn in the order of their ids, higher ids on top.
+ * The grid wraps around, so any world coordinates can be used.
+ *
+ * @code{.cpp}
+ * NanoEngine1 engine;
+ * NanoSpriteLayer<NanoEngine1, engine> sprites;
+ *
+ * bool drawAll()
+ * {
+ *     engine.canvas.clear();
+ *     return sprites.draw();
+ * }
+ * @endcode
+ */
+template<typename T, T &E, uint8_t N = NE_SPRITE_LAYER_SIZE>
+class NanoSpriteLayer
+{
+    static_assert(N <= 32, "NanoSpriteLayer holds up to 32 sprites");
+
+public:
+    NanoSpriteLayer(): m_used(0), m_cells{} {}
+
+    /**
+     * Adds monochrome sprite and marks its area for refreshing.
+     * @param pos position of the sprite in global coordinates
+     * @param size size of sprite
+     * @param bitmap sprite content (in flash memory)
+     * @returns id of the sprite or -1 if the layer is full
+     */
+    int8_t add(const NanoPoint &pos, const NanoPoint &size, const uint8_t *bitmap)
+    {
+        for (uint8_t id = 0; id < N; id++)
+        {
+            if (!(m_used & bit(id)))
+            {
+                m_used |= bit(id);
+                m_sprites[id].rect = { pos, pos + size - (NanoPoint){1, 1} };
+                m_sprites[id].bitmap = bitmap;
+                place(id);
+                return id;
+            }
+        }
+        return -1;
+    }
+
+    /**
+     * Removes sprite and marks its area for refreshing.
+     * @param id id of the sprite returned by add()
+     */
+    void remove(uint8_t id)
+    {
+        if (m_used & bit(id))
+        {
+            unplace(id);
+            m_used &= ~bit(id);
+        }
+    }
+
+    /**
+     * Moves sprite to new position
+     */
+    void moveTo(uint8_t id, const NanoPoint &p)
+    {
+        unplace(id);
+        m_sprites[id].rect = { p, p + m_sprites[id].rect.size() - (NanoPoint){1, 1} };
+        place(id);
+    }
+
+    /**
+     * Moves sprite to new position by specified offset
+     */
+    void moveBy(uint8_t id, const NanoPoint &p)
+    {
+        unplace(id);
+        m_sprites[id].rect += p;
+        place(id);
+    }
+
+    /**
+     * Changes sprite bitmap to new one of the same size.
+     */
+    void setBitmap(uint8_t id, const uint8_t *bitmap)
+    {
+        m_sprites[id].bitmap = bitmap;
+        E.refreshWorld(m_sprites[id].rect);
+    }
+
+    /**
+     * Returns area of the sprite in global coordinates
+     */
+    const NanoRect &rect(uint8_t id) const { return m_sprites[id].rect; }
+
+    /**
+     * Draws the sprites overlapping the area of Engine canvas. Call it from
+     * the draw callback.
+     * @returns true, so that it can end the draw callback
+     */
+    bool draw()
+    {
+        NanoRect area = { E.canvas.offset, E.canvas.offsetEnd() };
+        uint32_t mask = cells(area) & m_used;
+        for (uint8_t id = 0; mask; id++, mask >>= 1)
+        {
+            const Sprite &sprite = m_sprites[id];
+            if ((mask & 1) && overlaps(sprite.rect, area))
+            {
+                E.canvas.drawBitmap1(sprite.rect.p1.x, sprite.rect.p1.y,
+                                     sprite.rect.width(), sprite.rect.height(), sprite.bitmap);
+            }
+        }
+        return true;
+    }
+
+private:
+    typedef struct
+    {
+        NanoRect       rect;
+        const uint8_t *bitmap;
+    } Sprite;
+
+    Sprite   m_sprites[N];
+    uint32_t m_used;
+    /** Bit n of a cell is set when sprite n overlaps it */
+    uint32_t m_cells[NE_SPRITE_GRID_Y][NE_SPRITE_GRID_X];
+
+    static uint32_t bit(uint8_t id) { return (uint32_t)1 << id; }
+
+    static bool overlaps(const NanoRect &a, const NanoRect &b)
+    {
+        return (a.p1.x <= b.p2.x) && (b.p1.x <= a.p2.x) &&
+               (a.p1.y <= b.p2.y) && (b.p1.y <= a.p2.y);
+    }
+
+    /** Calls f for every cell under rect, each cell once even if the grid wraps around */
+    template<typename F>
+    void forCells(const NanoRect &rect, F f)
+    {
+        lcdint_t cx = rect.p1.x >> NE_SPRITE_CELL_BITS;
+        lcdint_t cy = rect.p1.y >> NE_SPRITE_CELL_BITS;
+        lcdint_t nx = (rect.p2.x >> NE_SPRITE_CELL_BITS) - cx + 1;
+        lcdint_t ny = (rect.p2.y >> NE_SPRITE_CELL_BITS) - cy + 1;
+        if (nx > NE_SPRITE_GRID_X) nx = NE_SPRITE_GRID_X;
+        if (ny > NE_SPRITE_GRID_Y) ny = NE_SPRITE_GRID_Y;
+        for (lcdint_t j = 0; j < ny; j++)
+        {
+            uint32_t *row = m_cells[(cy + j) & (NE_SPRITE_GRID_Y - 1)];
+            for (lcdint_t i = 0; i < nx; i++)
+            {
+                f(row[(cx + i) & (NE_SPRITE_GRID_X - 1)]);
+            }
+        }
+    }
+
+    uint32_t cells(const NanoRect &rect)
+    {
+        uint32_t mask = 0;
+        forCells(rect, [&mask](uint32_t &cell) { mask |= cell; });
+        return mask;
+    }
+
+    void place(uint8_t id)
+    {
+        uint32_t b = bit(id);
+        forCells(m_sprites[id].rect, [b](uint32_t &cell) { cell |= b; });
+        E.refreshWorld(m_sprites[id].rect);
+    }
+
+    void unplace(uint8_t id)
+    {
+        uint32_t b = bit(id);
+        E.refreshWorld(m_sprites[id].rect);
+        forCells(m_sprites[id].rect, [b](uint32_t &cell) { cell &= ~b; });
+    }
+};
+
+/**
+ * @}
+ */
+
+#endif
+
@@ -31,6 +31,7 @@
 
 #include "canvas.h"
 #include "lcd/lcd_common.h"
+#include "ssd1306_fonts.h"
 
 /**
  * @ingroup NANO_ENGINE_API
@@ -62,6 +63,48 @@ extern "C" SFixedFontInfo s_fixedFont;
 #define ADATILE_8x8_RGB8      AdafruitCanvas8,  8,  8,      3    ///< Use Adafruit GFX implementation as NanoEngine canvas
 #define ADATILE_8x8_RGB16     AdafruitCanvas16, 8,  8,      3    ///< Use Adafruit GFX implementation as NanoEngine canvas
 
+#ifndef NE_MAX_DISPLAY_WIDTH
+#if defined(__AVR__)
+/** Widest display the engine tracks refresh areas for, in pixels */
+#define NE_MAX_DISPLAY_WIDTH   128
+#else
+#define NE_MAX_DISPLAY_WIDTH   320
+#endif
+#endif
+
+#ifndef NE_MOVE_SLOTS
+/**
+ * Sprite moves the engine collects until the next frame, see NanoEngineTiler::refreshMove().
+ * Moves past the limit mark their tiles at once. 0 disables collecting.
+ */
+#define NE_MOVE_SLOTS          16
+#endif
+
+/** Canvases which can be switched to a region buffer, see NanoEngineTiler::setRegionBuffer() */
+template <uint8_t BPP>
+inline bool nanoCanvasSetBuffer(NanoCanvasOps<BPP> *canvas, lcdint_t w, lcdint_t h, uint8_t *bytes)
+{
+    canvas->setBuffer(w, h, bytes);
+    return true;
+}
+
+/** Other canvases, Adafruit ones for example, are always drawn tile by tile */
+inline bool nanoCanvasSetBuffer(const void *, lcdint_t, lcdint_t, uint8_t *)
+{
+    return false;
+}
+
+/** Canvases which can start from a background, see NanoEngineTiler::setBackground() */
+template <uint8_t BPP>
+inline void nanoCanvasCopyFrom(NanoCanvasOps<BPP> *canvas, const uint8_t *bytes, lcduint_t w, lcduint_t h)
+{
+    canvas->copyFrom(bytes, w, h);
+}
+
+inline void nanoCanvasCopyFrom(const void *, const uint8_t *, lcduint_t, lcduint_t)
+{
+}
+
 /**
  * Type of user-specified draw callback.
  */
@@ -93,8 +136,12 @@ public:
     static const lcduint_t NE_TILE_WIDTH = W;
     /** Height of tile in pixels */
     static const lcduint_t NE_TILE_HEIGHT = H;
-    /** Max tiles supported in X */
+    /** Max tiles supported in Y */
     static const uint8_t NE_MAX_TILES_NUM = 64 >> (B - 3);
+    /** Max tiles supported in X */
+    static const uint8_t NE_MAX_TILES_X = (NE_MAX_DISPLAY_WIDTH + (1 << B) - 1) >> B;
+    /** 16-bit words holding refresh flags of one row of tiles */
+    static const uint8_t NE_ROW_WORDS = (NE_MAX_TILES_X + 15) >> 4;
 
     /** object, representing canvas. Use it in your draw handler */
     static C canvas;
@@ -104,7 +151,7 @@ public:
      */
     static void refresh()
     {
-        memset(m_refreshFlags,0xFF,sizeof(uint16_t) * NanoEngineTiler<C,W,H,B>::NE_MAX_TILES_NUM);
+        memset(m_refreshFlags,0xFF,sizeof(m_refreshFlags));
     }
 
     /**
@@ -124,7 +171,8 @@ public:
     static void refresh(const NanoPoint &point)
     {
         if ((point.y<0) || ((point.y>>B)>=NE_MAX_TILES_NUM)) return;
-        m_refreshFlags[(point.y>>B)] |= (1<<(point.x>>B));
+        if ((point.x<0) || ((point.x>>B)>=NE_MAX_TILES_X)) return;
+        setDirty(point.x>>B, point.y>>B);
     }
 
     /**
@@ -133,16 +181,18 @@ public:
      */
     static void refresh(lcdint_t x1, lcdint_t y1, lcdint_t x2, lcdint_t y2)
     {
-        if (y2 < 0) return;
+        if ((y2 < 0) || (x2 < 0)) return;
         if (y1 < 0) y1 = 0;
         if (x1 < 0) x1 = 0;
         y1 = y1>>B;
         y2 = min((y2>>B), NE_MAX_TILES_NUM - 1);
-        for (uint8_t y=y1; y<=y2; y++)
+        x1 = x1>>B;
+        x2 = min((x2>>B), NE_MAX_TILES_X - 1);
+        for (lcdint_t y=y1; y<=y2; y++)
         {
-            for(uint8_t x=x1>>B; x<=(x2>>B); x++)
+            for(lcdint_t x=x1; x<=x2; x++)
             {
-                m_refreshFlags[y] |= (1<<x);
+                setDirty(x, y);
             }
         }
     }
@@ -176,6 +226,53 @@ public:
         refresh( point - offset );
     }
 
+    /**
+     * Marks for refresh the move of an object from the area it was shown in to a new
+     * one, both in global (World) coordinates. The tiles are marked when the next frame
+     * is displayed, so an object moved several times in a frame marks only the area it
+     * was shown in and the one it ends up in, not the ones in between.
+     * @param shown - area the object was shown in, display() sets it to the new area.
+     *        It must stay valid until then, or cancelMove() must be called.
+     * @param rect - new area
+     */
+    static void refreshMove(NanoRect *shown, const NanoRect &rect)
+    {
+        for (uint8_t i = 0; i < m_moveCount; i++)
+        {
+            if (m_moves[i].shown == shown)
+            {
+                m_moves[i].rect = rect;
+                return;
+            }
+        }
+        if (m_moveCount < NE_MOVE_SLOTS)
+        {
+            m_moves[m_moveCount].shown = shown;
+            m_moves[m_moveCount].rect = rect;
+            m_moveCount++;
+            return;
+        }
+        refreshWorld(*shown);
+        refreshWorld(rect);
+        *shown = rect;
+    }
+
+    /**
+     * Forgets a move collected by refreshMove(), the area shown is not refreshed.
+     * @param shown - area passed to refreshMove()
+     */
+    static void cancelMove(NanoRect *shown)
+    {
+        for (uint8_t i = 0; i < m_moveCount; i++)
+        {
+            if (m_moves[i].shown == shown)
+            {
+                m_moves[i] = m_moves[--m_moveCount];
+                return;
+            }
+        }
+    }
+
     /**
      * Switches engine canvas to local coordinates system. This method can be useful
      * to ease up drawing of some static elements on lcd display.
@@ -251,12 +348,176 @@ public:
      */
     static bool collision(NanoPoint &p, NanoRect &rect) { return rect.collision( p ); }
 
+    /**
+     * Enables dirty-region mode. Adjacent tiles to refresh are then merged into
+     * rectangles, as big as fit the buffer, and the draw callback runs once for
+     * each rectangle instead of once for each tile. The canvas covers the whole
+     * rectangle while the callback runs. Canvases other than NanoCanvas ones keep
+     * drawing tile by tile.
+     * @param buffer - memory for the merged rectangles, nullptr to draw tile by tile again
+     * @param size - size of the buffer in bytes
+     */
+    static void setRegionBuffer(uint8_t *buffer, uint32_t size)
+    {
+        m_regionBuffer = buffer;
+        m_regionSize = size;
+    }
+
+    /**
+     * Enables the background layer. Static content, a grid or labels for example, is
+     * drawn once by the callback into the buffer, which covers the whole display. Each
+     * tile or region then starts as a copy of it, so the draw callback set by
+     * drawCallback() draws only what moves, and must not clear the canvas.
+     * Only NanoCanvas canvases support it. On ESP32 the buffer can be in PSRAM.
+     * @param buffer - memory of backgroundSize() bytes, nullptr to disable the layer
+     * @param callback - draws the background, in local coordinates of the whole display
+     * @returns false if the canvas can not use a background
+     */
+    static bool setBackground(uint8_t *buffer, TNanoEngineOnDraw callback)
+    {
+        m_background = nullptr;
+        m_onDrawBackground = callback;
+        if (buffer && !nanoCanvasSetBuffer(&canvas, W, H, m_buffer))
+        {
+            return false;
+        }
+        m_background = buffer;
+        refreshBackground();
+        return true;
+    }
+
+    /**
+     * Draws the background again, after its static content changed, and marks all
+     * tiles for update.
+     */
+    static void refreshBackground()
+    {
+        if (m_background && m_onDrawBackground)
+        {
+            nanoCanvasSetBuffer(&canvas, ssd1306_lcd.width, ssd1306_lcd.height, m_background);
+            canvas.setOffset(0, 0);
+            canvas.clear();
+            m_onDrawBackground();
+            nanoCanvasSetBuffer(&canvas, W, H, m_buffer);
+        }
+        refresh();
+    }
+
+    /**
+     * Enables skipping unchanged tiles. A 32-bit hash of each tile is kept after it
+     * is drawn, and tiles whose pixels hash the same as what was last sent are not
+     * sent again, only drawn. Regions of setRegionBuffer() and the popup are always sent.
+     * @warning Call invalidateTiles() after anything other than the engine drew on the display.
+     * @param hashes - table of tileCount() entries, nullptr to send every dirty tile again
+     * @param count - number of entries in the table
+     * @returns false if the table is too small for the display
+     */
+    static bool setTileHashes(uint32_t *hashes, uint16_t count)
+    {
+        m_tileHashes = nullptr;
+        if (hashes && count < tileCount())
+        {
+            return false;
+        }
+        m_tileHashes = hashes;
+        invalidateTiles();
+        return true;
+    }
+
+    /** Forgets the hashes of setTileHashes(), every dirty tile is sent again */
+    static void invalidateTiles()
+    {
+        if (m_tileHashes)
+        {
+            memset(m_tileHashes, 0, tileCount() * sizeof(uint32_t));
+        }
+    }
+
+    /** Number of tiles covering the current display */
+    static uint16_t tileCount()
+    {
+        return (uint16_t)((ssd1306_lcd.width + W - 1) / W) * ((ssd1306_lcd.height + H - 1) / H);
+    }
+
+    /**
+     * Changes the size of the tiles sent at runtime. Dirty tiles are still marked at
+     * the W x H size of the template, but display() draws and sends blocks of
+     * 2^shift x 2^shift of them at once, and a block goes out if any of its tiles is
+     * dirty. Bigger blocks cost fewer transfers and more pixels drawn. The block must
+     * fit the display evenly. Blocks take precedence over setRegionBuffer().
+     * Only NanoCanvas canvases support it.
+     * @param shift - 0 sends single tiles again
+     * @param buffer - memory of tileBufferSize(shift) bytes
+     * @param size - size of the buffer in bytes
+     * @returns false if the block does not fit the buffer, the display or the canvas
+     */
+    static bool setTileScale(uint8_t shift, uint8_t *buffer, uint32_t size)
+    {
+        if (shift && (!buffer || (size < tileBufferSize(shift)) ||
+                      (ssd1306_lcd.width % (W << shift)) || (ssd1306_lcd.height % (H << shift)) ||
+                      !nanoCanvasSetBuffer(&canvas, W, H, m_buffer)))
+        {
+            return false;
+        }
+        m_tileScale = shift;
+        m_tileBuffer = buffer;
+        return true;
+    }
+
+    /** Size of the buffer setTileScale() needs for blocks of 2^shift x 2^shift tiles */
+    static constexpr uint32_t tileBufferSize(uint8_t shift) { return sizeof(m_buffer) << (shift * 2); }
+
+    /** Runtime tile scale set by setTileScale() */
+    static uint8_t tileScale() { return m_tileScale; }
+
+    /**
+     * Measures on the attached display how long a full frame takes for each tile
+     * scale the buffer allows, and keeps the fastest. Frames are cleared tiles, so
+     * call it at startup, once the display is set up. The screen is redrawn by the
+     * next display().
+     * @param buffer - memory for the blocks, nullptr to only measure single tiles
+     * @param size - size of the buffer in bytes
+     * @returns chosen scale, see setTileScale()
+     */
+    static uint8_t tuneTileScale(uint8_t *buffer, uint32_t size);
+
+    /** Size of the background buffer for the current display in bytes */
+    static uint32_t backgroundSize()
+    {
+        return C::BITS_PER_PIXEL == 1 ? (uint32_t)ssd1306_lcd.width * ((ssd1306_lcd.height + 7) >> 3)
+                                      : (((uint32_t)ssd1306_lcd.width * C::BITS_PER_PIXEL + 7) >> 3) * ssd1306_lcd.height;
+    }
+
+#if defined(CONFIG_PLATFORM_WORKER_AVAILABLE)
+    /**
+     * Enables parallel mode. Tiles are then sent to the display by a worker task
+     * on the other core, while the draw callback fills the next tile in turn in
+     * the buffer and in the internal one. The callback API stays the same, it
+     * still runs in the task calling display(). Canvases other than NanoCanvas
+     * ones keep drawing and sending from the calling task.
+     * @param buffer - second tile buffer of bufferSize() bytes, nullptr to send from the calling task again
+     */
+    static void setParallelBuffer(uint8_t *buffer) { m_parallelBuffer = buffer; }
+
+    /** Size of a tile buffer in bytes */
+    static constexpr uint32_t bufferSize() { return sizeof(m_buffer); }
+#endif
+
 protected:
     /**
      * Contains information on tiles to be updated.
      * Elements of array are rows and bits are columns.
      */
-    static uint16_t   m_refreshFlags[NE_MAX_TILES_NUM];
+    static uint16_t   m_refreshFlags[NE_MAX_TILES_NUM][NE_ROW_WORDS];
+
+    static void setDirty(uint8_t x, uint8_t y) { m_refreshFlags[y][x >> 4] |= (1 << (x & 0x0F)); }
+
+    static void clearDirty(uint8_t x, uint8_t y) { m_refreshFlags[y][x >> 4] &= ~(1 << (x & 0x0F)); }
+
+    static bool isDirty(uint8_t x, uint8_t y) { return m_refreshFlags[y][x >> 4] & (1 << (x & 0x0F)); }
+
+    /** Marks the tiles of the moves collected since the last frame */
+    static void applyMoves();
 
     /** Callback to call if specific tile needs to be updated */
     static TNanoEngineOnDraw m_onDraw;
@@ -279,15 +540,114 @@ private:
     /** Buffer, used by NanoCanvas */
     static uint8_t    m_buffer[W * H * C::BITS_PER_PIXEL / 8];
 
+    static uint8_t   *m_regionBuffer;
+    static uint32_t   m_regionSize;
+
+    static uint8_t   *m_background;
+    static TNanoEngineOnDraw m_onDrawBackground;
+
+    static uint32_t  *m_tileHashes;
+
+    static uint8_t   *m_tileBuffer;
+    static uint8_t    m_tileScale;
+
+    /** Sends dirty blocks of setTileScale() */
+    static void displayBlocks();
+
+    /**
+     * Hashes a drawn tile, returns false if it matches what was sent for the tile last.
+     * Tiles sent other ways pass a null buffer, their hashes are forgotten.
+     */
+    static bool tileChanged(uint8_t tx, uint8_t ty, const uint8_t *data)
+    {
+        if (!m_tileHashes)
+        {
+            return true;
+        }
+        uint32_t &last = m_tileHashes[ty * ((ssd1306_lcd.width + W - 1) / W) + tx];
+        // FNV-1a, 0 is left for unknown content
+        uint32_t hash = 2166136261u;
+        for (uint32_t i = 0; data && (i < sizeof(m_buffer)); i++)
+        {
+            hash = (hash ^ data[i]) * 16777619u;
+        }
+        hash = !data ? 0 : (hash ? hash : 1);
+        if (hash && (hash == last))
+        {
+            return false;
+        }
+        last = hash;
+        return true;
+    }
+
+    /** Starts the canvas at its offset as a copy of the background, if there is one */
+    static void loadBackground()
+    {
+        if (m_background)
+        {
+            nanoCanvasCopyFrom(&canvas, m_background, ssd1306_lcd.width, ssd1306_lcd.height);
+        }
+    }
+
+    /** Draws the tiles to refresh, merged into rectangles that fit the region buffer */
+    static void displayRegions();
+
+#if defined(CONFIG_PLATFORM_WORKER_AVAILABLE)
+    static uint8_t   *m_parallelBuffer;
+
+    /** Copies of the canvas for the tiles handed over to the worker, one per tile buffer */
+    static C          m_bltCanvas[2];
+
+    static void bltJob(void *arg) { static_cast<C *>(arg)->blt(); }
+#endif
+
     static NanoPoint offset;
+
+    struct NanoMove
+    {
+        NanoRect *shown;
+        NanoRect  rect;
+    };
+
+    static NanoMove   m_moves[NE_MOVE_SLOTS ? NE_MOVE_SLOTS : 1];
+    static uint8_t    m_moveCount;
 };
 
 template<class C, lcduint_t W, lcduint_t H, uint8_t B>
-uint16_t NanoEngineTiler<C,W,H,B>::m_refreshFlags[NE_MAX_TILES_NUM];
+uint16_t NanoEngineTiler<C,W,H,B>::m_refreshFlags[NE_MAX_TILES_NUM][NE_ROW_WORDS];
+
+template<class C, lcduint_t W, lcduint_t H, uint8_t B>
+uint8_t *NanoEngineTiler<C,W,H,B>::m_regionBuffer = nullptr;
+
+template<class C, lcduint_t W, lcduint_t H, uint8_t B>
+uint32_t NanoEngineTiler<C,W,H,B>::m_regionSize = 0;
+
+template<class C, lcduint_t W, lcduint_t H, uint8_t B>
+uint8_t *NanoEngineTiler<C,W,H,B>::m_background = nullptr;
+
+template<class C, lcduint_t W, lcduint_t H, uint8_t B>
+TNanoEngineOnDraw NanoEngineTiler<C,W,H,B>::m_onDrawBackground = nullptr;
+
+template<class C, lcduint_t W, lcduint_t H, uint8_t B>
+uint32_t *NanoEngineTiler<C,W,H,B>::m_tileHashes = nullptr;
+
+template<class C, lcduint_t W, lcduint_t H, uint8_t B>
+uint8_t *NanoEngineTiler<C,W,H,B>::m_tileBuffer = nullptr;
+
+template<class C, lcduint_t W, lcduint_t H, uint8_t B>
+uint8_t NanoEngineTiler<C,W,H,B>::m_tileScale = 0;
 
 template<class C, lcduint_t W, lcduint_t H, uint8_t B>
 uint8_t NanoEngineTiler<C,W,H,B>::m_buffer[W * H * C::BITS_PER_PIXEL / 8];
 
+#if defined(CONFIG_PLATFORM_WORKER_AVAILABLE)
+template<class C, lcduint_t W, lcduint_t H, uint8_t B>
+uint8_t *NanoEngineTiler<C,W,H,B>::m_parallelBuffer = nullptr;
+
+template<class C, lcduint_t W, lcduint_t H, uint8_t B>
+C NanoEngineTiler<C,W,H,B>::m_bltCanvas[2] = { C(W, H, m_buffer), C(W, H, m_buffer) };
+#endif
+
 template<class C, lcduint_t W, lcduint_t H, uint8_t B>
 C NanoEngineTiler<C,W,H,B>::canvas(W, H, m_buffer);
 
@@ -297,50 +657,270 @@ NanoPoint NanoEngineTiler<C,W,H,B>::offset = {0, 0};
 template<class C, lcduint_t W, lcduint_t H, uint8_t B>
 TNanoEngineOnDraw NanoEngineTiler<C,W,H,B>::m_onDraw = nullptr;
 
+template<class C, lcduint_t W, lcduint_t H, uint8_t B>
+typename NanoEngineTiler<C,W,H,B>::NanoMove NanoEngineTiler<C,W,H,B>::m_moves[NE_MOVE_SLOTS ? NE_MOVE_SLOTS : 1];
+
+template<class C, lcduint_t W, lcduint_t H, uint8_t B>
+uint8_t NanoEngineTiler<C,W,H,B>::m_moveCount = 0;
+
+template<class C, lcduint_t W, lcduint_t H, uint8_t B>
+void NanoEngineTiler<C,W,H,B>::applyMoves()
+{
+    for (uint8_t i = 0; i < m_moveCount; i++)
+    {
+        // tiles both areas share are marked once, a bounding rect would add corners
+        refreshWorld(*m_moves[i].shown);
+        refreshWorld(m_moves[i].rect);
+        *m_moves[i].shown = m_moves[i].rect;
+    }
+    m_moveCount = 0;
+}
+
 template<class C, lcduint_t W, lcduint_t H, uint8_t B>
 void NanoEngineTiler<C,W,H,B>::displayBuffer()
 {
+    applyMoves();
     if (!m_onDraw)  // If onDraw handler is not set, just output current canvas
     {
         canvas.blt();
         return;
     }
+    if (m_tileScale && nanoCanvasSetBuffer(&canvas, W << m_tileScale, H << m_tileScale, m_tileBuffer))
+    {
+        displayBlocks();
+        return;
+    }
+    // only NanoCanvas canvases can be switched to the region buffer
+    if (m_regionBuffer && nanoCanvasSetBuffer(&canvas, W, H, m_buffer))
+    {
+        displayRegions();
+        return;
+    }
+#if defined(CONFIG_PLATFORM_WORKER_AVAILABLE)
+    uint8_t *buffers[2] = { m_buffer, m_parallelBuffer };
+    uint8_t next = 0;
+    bool parallel = m_parallelBuffer && nanoCanvasSetBuffer(&canvas, W, H, m_buffer) &&
+                    (ssd1306_platform_workerStart() == 0);
+#endif
     for (lcduint_t y = 0; y < ssd1306_lcd.height; y = y + NE_TILE_HEIGHT)
     {
-        uint16_t flag = m_refreshFlags[y >> NE_TILE_SIZE_BITS];
-        m_refreshFlags[y >> NE_TILE_SIZE_BITS] = 0;
+        uint8_t ty = y >> NE_TILE_SIZE_BITS;
         for (lcduint_t x = 0; x < ssd1306_lcd.width; x = x + NE_TILE_WIDTH)
         {
-            if (flag & 0x01)
+            uint8_t tx = x >> NE_TILE_SIZE_BITS;
+            if ((ty < NE_MAX_TILES_NUM) && (tx < NE_MAX_TILES_X) && isDirty(tx, ty))
             {
+#if defined(CONFIG_PLATFORM_WORKER_AVAILABLE)
+                if (parallel)
+                {
+                    // the tile sent from this buffer two tiles ago must be out
+                    ssd1306_platform_workerWait(1);
+                    nanoCanvasSetBuffer(&canvas, W, H, buffers[next]);
+                }
+#endif
                 canvas.setOffset(x, y);
+                loadBackground();
                 if (m_onDraw())
                 {
                     canvas.setOffset(x, y);
+#if defined(CONFIG_PLATFORM_WORKER_AVAILABLE)
+                    if (!tileChanged(tx, ty, parallel ? buffers[next] : m_buffer))
+                    {
+                        continue;
+                    }
+                    if (parallel)
+                    {
+                        m_bltCanvas[next] = canvas;
+                        ssd1306_platform_workerPost(bltJob, &m_bltCanvas[next]);
+                        next ^= 1;
+                        continue;
+                    }
+#else
+                    if (!tileChanged(tx, ty, m_buffer))
+                    {
+                        continue;
+                    }
+#endif
                     canvas.blt();
                 }
             }
-            flag >>=1;
         }
+        if (ty < NE_MAX_TILES_NUM)
+        {
+            memset(m_refreshFlags[ty], 0, sizeof(m_refreshFlags[ty]));
+        }
+    }
+#if defined(CONFIG_PLATFORM_WORKER_AVAILABLE)
+    if (parallel)
+    {
+        // the frame is out when display() returns, and the canvas is back on the internal buffer
+        ssd1306_platform_workerWait(0);
+        nanoCanvasSetBuffer(&canvas, W, H, m_buffer);
     }
+#endif
+}
+
+template<class C, lcduint_t W, lcduint_t H, uint8_t B>
+void NanoEngineTiler<C,W,H,B>::displayRegions()
+{
+    const uint32_t tileSize = sizeof(m_buffer);
+    uint8_t tilesX = min((ssd1306_lcd.width + W - 1) / W, (lcduint_t)NE_MAX_TILES_X);
+    uint8_t tilesY = min((ssd1306_lcd.height + H - 1) / H, (lcduint_t)NE_MAX_TILES_NUM);
+    for (uint8_t ty = 0; ty < tilesY; ty++)
+    {
+        for (uint8_t tx = 0; tx < tilesX; tx++)
+        {
+            if (!isDirty(tx, ty))
+            {
+                continue;
+            }
+            // grow the run to the right, then down while the rows below are dirty under it
+            uint8_t n = 1;
+            while ((tx + n < tilesX) && isDirty(tx + n, ty) && (tileSize * (n + 1) <= m_regionSize))
+            {
+                n++;
+            }
+            uint8_t m = 1;
+            while ((ty + m < tilesY) && (tileSize * n * (m + 1) <= m_regionSize))
+            {
+                uint8_t i = 0;
+                while ((i < n) && isDirty(tx + i, ty + m)) i++;
+                if (i < n) break;
+                m++;
+            }
+            for (uint8_t j = 0; j < m; j++)
+            {
+                for (uint8_t i = 0; i < n; i++)
+                {
+                    clearDirty(tx + i, ty + j);
+                    tileChanged(tx + i, ty + j, nullptr);
+                }
+            }
+            if ((n > 1) || (m > 1))
+            {
+                nanoCanvasSetBuffer(&canvas, W * n, H * m, m_regionBuffer);
+            }
+            else
+            {
+                nanoCanvasSetBuffer(&canvas, W, H, m_buffer);
+            }
+            canvas.setOffset(tx * W, ty * H);
+            loadBackground();
+            if (m_onDraw())
+            {
+                canvas.setOffset(tx * W, ty * H);
+                canvas.blt();
+            }
+        }
+    }
+    nanoCanvasSetBuffer(&canvas, W, H, m_buffer);
+}
+
+template<class C, lcduint_t W, lcduint_t H, uint8_t B>
+void NanoEngineTiler<C,W,H,B>::displayBlocks()
+{
+    const uint8_t k = 1 << m_tileScale;
+    uint8_t tilesX = min((ssd1306_lcd.width + W - 1) / W, (lcduint_t)NE_MAX_TILES_X);
+    uint8_t tilesY = min((ssd1306_lcd.height + H - 1) / H, (lcduint_t)NE_MAX_TILES_NUM);
+    for (uint8_t ty = 0; ty < tilesY; ty += k)
+    {
+        for (uint8_t tx = 0; tx < tilesX; tx += k)
+        {
+            bool dirty = false;
+            for (uint8_t j = 0; (j < k) && (ty + j < tilesY); j++)
+            {
+                for (uint8_t i = 0; (i < k) && (tx + i < tilesX); i++)
+                {
+                    if (isDirty(tx + i, ty + j))
+                    {
+                        dirty = true;
+                        clearDirty(tx + i, ty + j);
+                    }
+                    tileChanged(tx + i, ty + j, nullptr);
+                }
+            }
+            if (!dirty)
+            {
+                continue;
+            }
+            canvas.setOffset(tx * W, ty * H);
+            loadBackground();
+            if (m_onDraw())
+            {
+                canvas.setOffset(tx * W, ty * H);
+                canvas.blt();
+            }
+        }
+    }
+    nanoCanvasSetBuffer(&canvas, W, H, m_buffer);
+}
+
+template<class C, lcduint_t W, lcduint_t H, uint8_t B>
+uint8_t NanoEngineTiler<C,W,H,B>::tuneTileScale(uint8_t *buffer, uint32_t size)
+{
+    TNanoEngineOnDraw onDraw = m_onDraw;
+    uint8_t *regionBuffer = m_regionBuffer;
+    uint32_t *hashes = m_tileHashes;
+    // single tiles are measured as tiles, not merged or skipped
+    m_onDraw = []() -> bool { canvas.clear(); return true; };
+    m_regionBuffer = nullptr;
+    m_tileHashes = nullptr;
+    uint8_t best = 0;
+    uint32_t bestTime = UINT32_MAX;
+    for (uint8_t shift = 0; (shift < 8) && setTileScale(shift, buffer, size); shift++)
+    {
+#if defined(CONFIG_PLATFORM_SLEEP_AVAILABLE)
+        uint32_t start = micros();
+#else
+        uint32_t start = millis();
+#endif
+        // the first frame may pay for bus setup, so two are taken
+        for (uint8_t n = 0; n < 2; n++)
+        {
+            refresh();
+            displayBuffer();
+        }
+#if defined(CONFIG_PLATFORM_SLEEP_AVAILABLE)
+        uint32_t time = micros() - start;
+#else
+        uint32_t time = millis() - start;
+#endif
+        if (time < bestTime)
+        {
+            bestTime = time;
+            best = shift;
+        }
+    }
+    setTileScale(best, buffer, size);
+    m_onDraw = onDraw;
+    m_regionBuffer = regionBuffer;
+    m_tileHashes = hashes;
+    invalidateTiles();
+    refresh();
+    return best;
 }
 
 template<class C, lcduint_t W, lcduint_t H, uint8_t B>
 void NanoEngineTiler<C,W,H,B>::displayPopup(const char *msg)
 {
-    NanoRect rect = { {8, (ssd1306_lcd.height>>1) - 8}, {ssd1306_lcd.width - 8, (ssd1306_lcd.height>>1) + 8} };
-    // TODO: It would be nice to calculate message height
-    NanoPoint textPos = { (ssd1306_lcd.width - (lcdint_t)strlen(msg)*s_fixedFont.h.width) >> 1, (ssd1306_lcd.height>>1) - 4 };
+    STextSize size;
+    ssd1306_measureText(msg, 0, 0, &size);
+    NanoRect rect = { {8, (lcdint_t)(ssd1306_lcd.height>>1) - (lcdint_t)(size.height>>1) - 4},
+                      {(lcdint_t)ssd1306_lcd.width - 8, (lcdint_t)(ssd1306_lcd.height>>1) + (lcdint_t)(size.height>>1) + 4} };
+    NanoPoint textPos = { ((lcdint_t)ssd1306_lcd.width - (lcdint_t)size.width) >> 1,
+                          (lcdint_t)(ssd1306_lcd.height>>1) - (lcdint_t)(size.height>>1) };
+    applyMoves();
     refresh(rect);
     for (lcduint_t y = 0; y < ssd1306_lcd.height; y = y + NE_TILE_HEIGHT)
     {
-        uint16_t flag = m_refreshFlags[y >> NE_TILE_SIZE_BITS];
-        m_refreshFlags[y >> NE_TILE_SIZE_BITS] = 0;
+        uint8_t ty = y >> NE_TILE_SIZE_BITS;
         for (lcduint_t x = 0; x < ssd1306_lcd.width; x = x + NE_TILE_WIDTH)
         {
-            if (flag & 0x01)
+            uint8_t tx = x >> NE_TILE_SIZE_BITS;
+            if ((ty < NE_MAX_TILES_NUM) && (tx < NE_MAX_TILES_X) && isDirty(tx, ty))
             {
                 canvas.setOffset(x, y);
+                loadBackground();
                 if (m_onDraw) m_onDraw();
                 canvas.setOffset(x, y);
                 canvas.setColor(RGB_COLOR8(0,0,0));
@@ -349,9 +929,13 @@ void NanoEngineTiler<C,W,H,B>::displayPopup(const char *msg)
                 canvas.drawRect(rect);
                 canvas.printFixed( textPos.x, textPos.y, msg);
 
+                tileChanged(tx, ty, nullptr);
                 canvas.blt();
             }
-            flag >>=1;
+        }
+        if (ty < NE_MAX_TILES_NUM)
+        {
+            memset(m_refreshFlags[ty], 0, sizeof(m_refreshFlags[ty]));
         }
     }
 }
@@ -516,6 +516,11 @@ void SPRITE::eraseTrace()
     ssd1306_eraseTrace(this);
 }
 
+void SPRITE::move()
+{
+    ssd1306_moveSprite(this);
+}
+
 void SPRITE::erase()
 {
     ssd1306_eraseSprite(this);
@@ -112,6 +112,48 @@ typedef struct
     const uint8_t *glyph; ///< char data, located in progmem.
 } SCharInfo;
 
+/** Size of text in the active font, see ssd1306_measureText() */
+typedef struct
+{
+    lcduint_t width;    ///< width of the longest line in pixels
+    lcduint_t height;   ///< height of all lines in pixels
+    uint8_t lines;      ///< number of lines
+} STextSize;
+
+#ifndef SSD1306_LAYOUT_MAX_LINES
+/** Lines kept by a text layout, the rest of the text is cut */
+#define SSD1306_LAYOUT_MAX_LINES  4
+#endif
+
+#ifndef SSD1306_LAYOUT_TEXT_SIZE
+/** Longest text, with the terminating zero, a text layout keeps */
+#define SSD1306_LAYOUT_TEXT_SIZE  64
+#endif
+
+/** Text broken into lines in the active font, see ssd1306_layoutText() */
+typedef struct
+{
+    STextSize size;                                 ///< size of the lines kept
+    uint8_t starts[SSD1306_LAYOUT_MAX_LINES];       ///< offset of each line in text
+    uint8_t lengths[SSD1306_LAYOUT_MAX_LINES];      ///< length of each line in bytes
+    lcduint_t widths[SSD1306_LAYOUT_MAX_LINES];     ///< width of each line in pixels
+    char text[SSD1306_LAYOUT_TEXT_SIZE];            ///< text laid out
+    uint8_t factor;                                 ///< scale factor the text is laid out for
+    lcduint_t max_width;                            ///< width the lines are wrapped at, 0 for none
+    const uint8_t *font;                            ///< font tables the text is measured in
+    const uint8_t *secondary_font;
+} STextLayout;
+
+/** Chars of a font scaled and styled in advance, see ssd1306_createFontAtlas() */
+typedef struct
+{
+    uint8_t *data;      ///< char widths, offsets and page rows of every char, in RAM
+    uint16_t first;     ///< first char in the atlas
+    uint16_t count;     ///< number of chars in the atlas
+    uint8_t pages;      ///< height of the scaled chars in pages
+    uint8_t width;      ///< width of the scaled font, chars wrap when it does not fit
+} SFontAtlas;
+
 /**
  * Rectangle region. not used now
  */
@@ -168,6 +210,12 @@ typedef struct SPRITE
      */
     void eraseTrace();
 
+    /**
+     * Moves sprite on the display to the position set by setPos(), sending
+     * each changed page once. Same as eraseTrace() and draw().
+     */
+    void move();
+
     /**
      * Clears sprite from the display leaving black rectangle.
      */
@@ -33,6 +33,7 @@
 #include "ssd1306_8bit.h"
 #include "ssd1306_16bit.h"
 #include "ssd1306_fonts.h"
+#include "ssd1306_display.h"
 
 #include "lcd/lcd_common.h"
 #include "lcd/oled_ssd1306.h"
@@ -31,10 +31,40 @@ void ssd1306_drawBufferFast16(lcdint_t x, lcdint_t y, lcduint_t w, lcduint_t h,
 {
     uint32_t count = (w * h) << 1;
     ssd1306_lcd.set_block(x, y, w);
-    while (count--)
+    // canvas bytes are already in the order the display takes them
+    while (count)
     {
-        ssd1306_intf.send( *data );
-        data++;
+        uint16_t len = count > 0x8000 ? 0x8000 : count;
+        ssd1306_intf.send_buffer( data, len );
+        data += len;
+        count -= len;
+    }
+    ssd1306_intf.stop();
+}
+
+void ssd1306_drawBufferFast4(lcdint_t x, lcdint_t y, lcduint_t w, lcduint_t h,
+                             const uint8_t *data, const uint16_t *palette)
+{
+    ssd1306_lcd.set_block(x, y, w);
+    if (!(w & 1))
+    {
+        // rows end on whole bytes, the buffer goes as one
+        uint32_t count = (uint32_t)w * h;
+        while (count)
+        {
+            uint16_t len = count > 0x8000 ? 0x8000 : count;
+            ssd1306_sendPixels4Rgb16( data, len, palette );
+            data += len >> 1;
+            count -= len;
+        }
+    }
+    else
+    {
+        for (lcduint_t row = 0; row < h; row++)
+        {
+            ssd1306_sendPixels4Rgb16( data, w, palette );
+            data += (w + 1) >> 1;
+        }
     }
     ssd1306_intf.stop();
 }
@@ -52,7 +52,8 @@ extern "C" {
 
 /**
  * Draws 16-bit bitmap, located in SRAM, on the display
- * Each byte represents separate pixel: refer to RGB_COLOR16 to understand RGB scheme, being used.
+ * Each pixel takes 2 bytes, high byte first: refer to RGB_COLOR16 to understand RGB scheme, being used.
+ * The bytes go to ssd1306_intf.send_buffer() as they are, in blocks of up to 32K.
  *
  * @param x - horizontal position in pixels
  * @param y - vertical position in pixels
@@ -62,6 +63,21 @@ extern "C" {
  */
 void ssd1306_drawBufferFast16(lcdint_t x, lcdint_t y, lcduint_t w, lcduint_t h, const uint8_t *data);
 
+/**
+ * Draws 4-bit bitmap, located in SRAM, on the display.
+ * Each byte keeps 2 pixels, the left one in the high nibble, and each row starts
+ * with a new byte. Pixels are indexes in the palette of 16 RGB_COLOR16 colors.
+ *
+ * @param x - horizontal position in pixels
+ * @param y - vertical position in pixels
+ * @param w - width of bitmap in pixels
+ * @param h - height of bitmap in pixels
+ * @param data - pointer to data, located in SRAM.
+ * @param palette - 16 colors, located in SRAM.
+ */
+void ssd1306_drawBufferFast4(lcdint_t x, lcdint_t y, lcduint_t w, lcduint_t h,
+                             const uint8_t *data, const uint16_t *palette);
+
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 static inline void ssd1331_drawBufferFast16(lcdint_t x, lcdint_t y, lcduint_t w, lcduint_t h, const uint8_t *data)
 {
@@ -37,6 +37,9 @@
 // TODO: remove
 #include "lcd/ssd1306_commands.h"
 
+#include <stdio.h>
+#include <stdarg.h>
+
 uint8_t s_ssd1306_invertByte = 0x00000000;
 const uint8_t *s_font6x8 = &ssd1306xled_font6x8[4];
 extern lcduint_t ssd1306_cursorX;
@@ -50,11 +53,20 @@ void ssd1306_fillScreen(uint8_t fill_Data)
 {
     fill_Data ^= s_ssd1306_invertByte;
     ssd1306_lcd.set_block(0, 0, 0);
+    // displays taking the bytes as they are, get whole pages in one run
+    uint8_t bulk = ssd1306_lcd.send_pixels1 == ssd1306_intf.send;
     for(uint8_t m=(ssd1306_lcd.height >> 3); m>0; m--)
     {
-        for(uint8_t n=ssd1306_lcd.width; n>0; n--)
+        if (bulk)
+        {
+            ssd1306_intfSendFill(fill_Data, ssd1306_lcd.width);
+        }
+        else
         {
-            ssd1306_lcd.send_pixels1(fill_Data);
+            for(uint8_t n=ssd1306_lcd.width; n>0; n--)
+            {
+                ssd1306_lcd.send_pixels1(fill_Data);
+            }
         }
         ssd1306_lcd.next_page();
     }
@@ -63,16 +75,17 @@ void ssd1306_fillScreen(uint8_t fill_Data)
 
 void ssd1306_clearScreen()
 {
-    ssd1306_lcd.set_block(0, 0, 0);
-    for(uint8_t m=(ssd1306_lcd.height >> 3); m>0; m--)
-    {
-        for(uint8_t n=ssd1306_lcd.width; n>0; n--)
-        {
-            ssd1306_lcd.send_pixels1( s_ssd1306_invertByte );
-        }
-        ssd1306_lcd.next_page();
-    }
-    ssd1306_intf.stop();
+    ssd1306_fillScreen( 0x00 );
+}
+
+uint8_t ssd1306_printFixedf(uint8_t xpos, uint8_t y, EFontStyle style, const char *format, ...)
+{
+    char text[SSD1306_PRINTF_MAX];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    return ssd1306_printFixed(xpos, y, text, style);
 }
 
 uint8_t ssd1306_printFixed(uint8_t xpos, uint8_t y, const char *ch, EFontStyle style)
@@ -112,13 +125,8 @@ uint8_t ssd1306_printFixed(uint8_t xpos, uint8_t y, const char *ch, EFontStyle s
             ssd1306_lcd.set_block(xpos, y, ssd1306_lcd.width - xpos);
         }
         uint16_t unicode;
-        do
-        {
-            unicode = ssd1306_unicode16FromUtf8(ch[j]);
-            j++;
-        } while ( unicode == SSD1306_MORE_CHARS_REQUIRED );
         SCharInfo char_info;
-        ssd1306_getCharBitmap(unicode, &char_info);
+        j = ssd1306_nextChar(&ch[j], &unicode, &char_info) - ch;
         ldata = 0;
         x += char_info.width + char_info.spacing;
         if (char_info.height > page_offset * 8)
@@ -239,6 +247,44 @@ uint8_t ssd1306_printFixed2x(uint8_t xpos, uint8_t y, const char ch[], EFontStyl
 }
 
 
+static uint8_t ssd1306_scaledColumn(const uint8_t *glyph, EFontStyle style, uint8_t *ldata,
+                                    uint8_t page_offset, uint8_t factor)
+{
+    uint8_t data;
+    if ( style == STYLE_NORMAL )
+    {
+        data = pgm_read_byte(glyph);
+    }
+    else if ( style == STYLE_BOLD )
+    {
+        uint8_t temp = pgm_read_byte(glyph);
+        data = temp | *ldata;
+        *ldata = temp;
+    }
+    else
+    {
+        uint8_t temp = pgm_read_byte(glyph+1);
+        data = (temp & 0xF0) | *ldata;
+        *ldata = (temp & 0x0F);
+    }
+    if ( factor > 0 )
+    {
+        uint8_t accum = 0;
+        uint8_t mask = ~((0xFF) << (1<<factor));
+        // N=0  ->   right shift is always 0
+        // N=1  ->   right shift goes through 0, 4
+        // N=2  ->   right shift goes through 0, 2, 4, 6
+        // N=3  ->   right shift goes through 0, 1, 2, 3, 4, 5, 6, 7
+        data >>= ((page_offset & ((1<<factor) - 1))<<(3-factor));
+        for (uint8_t idx = 0; idx < 1<<(3-factor); idx++)
+        {
+             accum |= (((data>>idx) & 0x01) ? (mask<<(idx<<factor)) : 0);
+        }
+        data = accum;
+    }
+    return data;
+}
+
 uint8_t ssd1306_printFixedN(uint8_t xpos, uint8_t y, const char ch[], EFontStyle style, uint8_t factor)
 {
     uint8_t i, j=0;
@@ -276,13 +322,8 @@ uint8_t ssd1306_printFixedN(uint8_t xpos, uint8_t y, const char ch[], EFontStyle
             ssd1306_lcd.set_block(xpos, y, ssd1306_lcd.width - xpos);
         }
         uint16_t unicode;
-        do
-        {
-            unicode = ssd1306_unicode16FromUtf8(ch[j]);
-            j++;
-        } while ( unicode == SSD1306_MORE_CHARS_REQUIRED );
         SCharInfo char_info;
-        ssd1306_getCharBitmap(unicode, &char_info);
+        j = ssd1306_nextChar(&ch[j], &unicode, &char_info) - ch;
         ldata = 0;
         x += ((char_info.width + char_info.spacing) << factor);
         if (char_info.height > (page_offset >> factor) * 8)
@@ -290,38 +331,7 @@ uint8_t ssd1306_printFixedN(uint8_t xpos, uint8_t y, const char ch[], EFontStyle
             char_info.glyph += (page_offset >> factor) * char_info.width;
             for( i=char_info.width; i>0; i--)
             {
-                uint8_t data;
-                if ( style == STYLE_NORMAL )
-                {
-                    data = pgm_read_byte(char_info.glyph);
-                }
-                else if ( style == STYLE_BOLD )
-                {
-                    uint8_t temp = pgm_read_byte(char_info.glyph);
-                    data = temp | ldata;
-                    ldata = temp;
-                }
-                else
-                {
-                    uint8_t temp = pgm_read_byte(char_info.glyph+1);
-                    data = (temp & 0xF0) | ldata;
-                    ldata = (temp & 0x0F);
-                }
-                if ( factor > 0 )
-                {
-                    uint8_t accum = 0;
-                    uint8_t mask = ~((0xFF) << (1<<factor));
-                    // N=0  ->   right shift is always 0
-                    // N=1  ->   right shift goes through 0, 4
-                    // N=2  ->   right shift goes through 0, 2, 4, 6
-                    // N=3  ->   right shift goes through 0, 1, 2, 3, 4, 5, 6, 7
-                    data >>= ((page_offset & ((1<<factor) - 1))<<(3-factor));
-                    for (uint8_t idx = 0; idx < 1<<(3-factor); idx++)
-                    {
-                         accum |= (((data>>idx) & 0x01) ? (mask<<(idx<<factor)) : 0);
-                    }
-                    data = accum;
-                }
+                uint8_t data = ssd1306_scaledColumn(char_info.glyph, style, &ldata, page_offset, factor);
                 for (uint8_t z=(1<<factor); z>0; z--)
                 {
                     ssd1306_lcd.send_pixels1(data^s_ssd1306_invertByte);
@@ -340,6 +350,152 @@ uint8_t ssd1306_printFixedN(uint8_t xpos, uint8_t y, const char ch[], EFontStyle
     return j;
 }
 
+uint8_t ssd1306_printLayout(uint8_t xpos, uint8_t y, const STextLayout *layout, EFontStyle style)
+{
+    char line[SSD1306_LAYOUT_TEXT_SIZE];
+    uint8_t i;
+    for (i = 0; i < layout->size.lines; i++)
+    {
+        memcpy(line, &layout->text[layout->starts[i]], layout->lengths[i]);
+        line[layout->lengths[i]] = '\0';
+        ssd1306_printFixedN(xpos, y + i * (s_fixedFont.h.height << layout->factor), line, style, layout->factor);
+    }
+    return i;
+}
+
+uint16_t ssd1306_createFontAtlas(SFontAtlas *atlas, uint8_t *buffer, uint16_t size,
+                                 uint16_t first, uint16_t count, EFontStyle style, uint8_t factor)
+{
+    uint8_t pages = s_fixedFont.pages << factor;
+    // width of each char, then its offset, low byte first
+    uint32_t total = (uint32_t)count * 3;
+    for (uint16_t n = 0; n < count; n++)
+    {
+        SCharInfo char_info;
+        ssd1306_getCharBitmap(first + n, &char_info);
+        uint8_t width = (char_info.width + char_info.spacing) << factor;
+        if (buffer && total + (uint32_t)width * pages <= size)
+        {
+            buffer[n] = width;
+            buffer[count + n * 2] = total & 0xFF;
+            buffer[count + n * 2 + 1] = total >> 8;
+            uint8_t *p = &buffer[total];
+            for (uint8_t page_offset = 0; page_offset < pages; page_offset++)
+            {
+                const uint8_t *glyph = char_info.glyph + (page_offset >> factor) * char_info.width;
+                uint8_t ldata = 0;
+                uint8_t i = 0;
+                if (char_info.height > (page_offset >> factor) * 8)
+                {
+                    for (; i < char_info.width; i++)
+                    {
+                        uint8_t data = ssd1306_scaledColumn(glyph, style, &ldata, page_offset, factor);
+                        for (uint8_t z=(1<<factor); z>0; z--)
+                        {
+                            *p++ = data;
+                        }
+                        glyph++;
+                    }
+                }
+                for (i <<= factor; i < width; i++)
+                {
+                    *p++ = 0;
+                }
+            }
+        }
+        total += (uint32_t)width * pages;
+    }
+    if (total > 0xFFFF)
+    {
+        return 0;
+    }
+    if (!buffer)
+    {
+        return total;
+    }
+    if (total > size)
+    {
+        return 0;
+    }
+    atlas->data = buffer;
+    atlas->first = first;
+    atlas->count = count;
+    atlas->pages = pages;
+    atlas->width = s_fixedFont.h.width << factor;
+    return total;
+}
+
+uint8_t ssd1306_getAtlasColumns(const SFontAtlas *atlas, uint16_t unicode, uint8_t page,
+                                const uint8_t **data)
+{
+    uint16_t n = unicode - atlas->first;
+    if ( (unicode < atlas->first) || (n >= atlas->count) || (page >= atlas->pages) )
+    {
+        *data = NULL;
+        return atlas->width;
+    }
+    uint8_t width = atlas->data[n];
+    uint16_t offset = atlas->data[atlas->count + n * 2] | (atlas->data[atlas->count + n * 2 + 1] << 8);
+    *data = &atlas->data[offset + page * width];
+    return width;
+}
+
+uint8_t ssd1306_printAtlas(uint8_t xpos, uint8_t y, const char ch[], const SFontAtlas *atlas)
+{
+    uint8_t i, j=0;
+    uint8_t text_index = 0;
+    uint8_t page_offset = 0;
+    uint8_t x = xpos;
+    y >>= 3;
+    ssd1306_lcd.set_block(xpos, y, ssd1306_lcd.width - xpos);
+    for(;;)
+    {
+        if( (x > ssd1306_lcd.width - atlas->width) || (ch[j] == '\0') )
+        {
+            x = xpos;
+            y++;
+            if (y >= (ssd1306_lcd.height >> 3))
+            {
+                break;
+            }
+            page_offset++;
+            if (page_offset == atlas->pages)
+            {
+                text_index = j;
+                page_offset = 0;
+                if (ch[j] == '\0')
+                {
+                    break;
+                }
+            }
+            else
+            {
+                j = text_index;
+            }
+            ssd1306_intf.stop();
+            ssd1306_lcd.set_block(xpos, y, ssd1306_lcd.width - xpos);
+        }
+        uint16_t unicode;
+        j = ssd1306_nextChar(&ch[j], &unicode, NULL) - ch;
+        const uint8_t *data;
+        uint8_t width = ssd1306_getAtlasColumns(atlas, unicode, page_offset, &data);
+        x += width;
+        if ( data && !s_ssd1306_invertByte )
+        {
+            ssd1306_lcd.send_pixels_buffer1(data, width);
+        }
+        else
+        {
+            for (i = 0; i < width; i++)
+            {
+                ssd1306_lcd.send_pixels1((data ? data[i] : 0)^s_ssd1306_invertByte);
+            }
+        }
+    }
+    ssd1306_intf.stop();
+    return j;
+}
+
 size_t ssd1306_write(uint8_t ch)
 {
     if (ch == '\r')
@@ -535,6 +691,60 @@ void         ssd1306_putPixels(uint8_t x, uint8_t y, uint8_t pixels)
     ssd1306_intf.stop();
 }
 
+void         ssd1306_putPixelList(const SPixel *pixels, uint16_t count)
+{
+    uint8_t bytes[SSD1306_PIXEL_BATCH_COLUMNS];
+    uint8_t pages = ssd1306_lcd.height >> 3;
+    for (uint8_t page = 0; page < pages; page++)
+    {
+        // the first pass finds the parts of the page to merge
+        uint32_t parts = 0;
+        for (uint16_t i = 0; i < count; i++)
+        {
+            if ((pixels[i].y >> 3) == page && pixels[i].x < ssd1306_lcd.width)
+            {
+                parts |= (uint32_t)1 << (pixels[i].x / SSD1306_PIXEL_BATCH_COLUMNS);
+            }
+        }
+        for (uint8_t part = 0; parts; part++, parts >>= 1)
+        {
+            if (!(parts & 1))
+            {
+                continue;
+            }
+            lcduint_t left = part * SSD1306_PIXEL_BATCH_COLUMNS;
+            memset(bytes, 0, sizeof(bytes));
+            for (uint16_t i = 0; i < count; i++)
+            {
+                if ((pixels[i].y >> 3) == page && pixels[i].x >= left &&
+                    pixels[i].x < left + SSD1306_PIXEL_BATCH_COLUMNS)
+                {
+                    bytes[pixels[i].x - left] |= 1 << (pixels[i].y & 0x07);
+                }
+            }
+            for (uint8_t col = 0; col < SSD1306_PIXEL_BATCH_COLUMNS; )
+            {
+                if (!bytes[col])
+                {
+                    col++;
+                    continue;
+                }
+                uint8_t end = col;
+                while ((end < SSD1306_PIXEL_BATCH_COLUMNS) && bytes[end])
+                {
+                    end++;
+                }
+                ssd1306_lcd.set_block(left + col, page, end - col);
+                for (; col < end; col++)
+                {
+                    ssd1306_lcd.send_pixels1(bytes[col]^s_ssd1306_invertByte);
+                }
+                ssd1306_intf.stop();
+            }
+        }
+    }
+}
+
 void         ssd1306_putPixel_delayed(uint8_t x, uint8_t y, uint8_t complete)
 {
     static uint8_t lx = 0, ly = 0xFF;
@@ -555,48 +765,112 @@ void         ssd1306_putPixel_delayed(uint8_t x, uint8_t y, uint8_t complete)
     }
 }
 
+/**
+ * Pixels of a line are gathered into the byte of their column and page. Bytes
+ * of adjacent columns on the same page go out in one block, so a line costs a
+ * set_block() per page it crosses instead of one per pixel.
+ */
+typedef struct
+{
+    uint8_t x;       ///< column of the byte being gathered
+    uint8_t page;    ///< page of the byte being gathered
+    uint8_t bits;    ///< pixels gathered so far
+    uint8_t right;   ///< last column of the line
+    uint8_t open;    ///< a block is open and continues at column x + 1 of runPage
+    uint8_t runX;
+    uint8_t runPage;
+} SLineRun;
+
+static void ssd1306_lineSend(SLineRun *run)
+{
+    if (!run->bits)
+    {
+        return;
+    }
+    if (!run->open || run->runPage != run->page || run->runX != run->x)
+    {
+        if (run->open)
+        {
+            ssd1306_intf.stop();
+        }
+        ssd1306_lcd.set_block(run->x, run->page, run->right - run->x + 1);
+        run->open = 1;
+        run->runPage = run->page;
+    }
+    ssd1306_lcd.send_pixels1(run->bits^s_ssd1306_invertByte);
+    run->runX = run->x + 1;
+}
+
+static void ssd1306_linePixel(SLineRun *run, uint8_t x, uint8_t y)
+{
+    if ((x != run->x) || ((y >> 3) != run->page))
+    {
+        ssd1306_lineSend(run);
+        run->x = x;
+        run->page = y >> 3;
+        run->bits = 0;
+    }
+    run->bits |= (1 << (y & 0x07));
+}
+
 void         ssd1306_drawLine(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2)
 {
-    lcduint_t  dx = x1 > x2 ? (x1 - x2): (x2 - x1);
+    if (x1 > x2)
+    {
+        ssd1306_swap_data(x1, x2, uint8_t);
+        ssd1306_swap_data(y1, y2, uint8_t);
+    }
+    if (y1 == y2)
+    {
+        ssd1306_drawHLine(x1, y1, x2);
+        return;
+    }
+    if (x1 == x2)
+    {
+        ssd1306_drawVLine(x1, y1 < y2 ? y1 : y2, y1 < y2 ? y2 : y1);
+        return;
+    }
+    lcduint_t  dx = x2 - x1;
     lcduint_t  dy = y1 > y2 ? (y1 - y2): (y2 - y1);
     lcduint_t  err = 0;
+    SLineRun run = { x1, (uint8_t)(y1 >> 3), 0, x2, 0, 0, 0 };
     if (dy > dx)
     {
-        if (y1 > y2)
-        {
-            ssd1306_swap_data(x1, x2, uint8_t);
-            ssd1306_swap_data(y1, y2, uint8_t);
-        }
-        for(; y1<=y2; y1++)
+        for(;;)
         {
             err += dx;
             if (err >= dy)
             {
                  err -= dy;
-                 x1 < x2 ? x1++: x1--;
+                 x1++;
             }
-            ssd1306_putPixel_delayed( x1, y1, 0 );
+            ssd1306_linePixel( &run, x1, y1 );
+            if (y1 == y2)
+            {
+                break;
+            }
+            if (y1 < y2) y1++; else y1--;
         }
-        ssd1306_putPixel_delayed( 0, 0, 1 );
     }
     else
     {
-        if (x1 > x2)
-        {
-            ssd1306_swap_data(x1, x2, uint8_t);
-            ssd1306_swap_data(y1, y2, uint8_t);
-        }
         for(; x1<=x2; x1++)
         {
             err += dy;
-            if (err >= dx)
+            // a diagonal steps from the second pixel on, so that it ends at y2
+            if (err > dx)
             {
                  err -= dx;
                  if (y1 < y2) y1++; else y1--;
             }
-            ssd1306_putPixel( x1, y1 );
+            ssd1306_linePixel( &run, x1, y1 );
         }
     }
+    ssd1306_lineSend( &run );
+    if (run.open)
+    {
+        ssd1306_intf.stop();
+    }
 }
 
 void         ssd1306_drawHLine(uint8_t x1, uint8_t y1, uint8_t x2)
@@ -687,6 +961,133 @@ void ssd1306_drawBitmap(uint8_t x, uint8_t y, uint8_t w, uint8_t h, const uint8_
     ssd1306_intf.stop();
 }
 
+/** Decompressed bytes on their way to the display */
+typedef struct
+{
+    uint8_t x;
+    uint8_t y;
+    uint8_t w;
+    uint8_t visible;    // columns that fit on the display
+    uint8_t col;
+    uint8_t page;
+    uint8_t block;      // 0 - no block set, 1 - set at column 0, 2 - set in the middle of a page
+    uint8_t len;
+    uint8_t chunk[16];
+} SBitmapStream;
+
+static void ssd1306_streamFlush(SBitmapStream *s)
+{
+    if (s->len)
+    {
+        ssd1306_lcd.send_pixels_buffer1(s->chunk, s->len);
+        s->len = 0;
+    }
+}
+
+static void ssd1306_streamEnd(SBitmapStream *s)
+{
+    ssd1306_streamFlush(s);
+    if (s->block)
+    {
+        ssd1306_intf.stop();
+        s->block = 0;
+    }
+}
+
+static void ssd1306_streamPut(SBitmapStream *s, uint8_t data)
+{
+    if (s->col < s->visible)
+    {
+        if (!s->block)
+        {
+            ssd1306_lcd.set_block(s->x + s->col, s->y + s->page, s->visible - s->col);
+            s->block = s->col ? 2 : 1;
+        }
+        s->chunk[s->len++] = data ^ s_ssd1306_invertByte;
+        if (s->len == sizeof(s->chunk))
+        {
+            ssd1306_streamFlush(s);
+        }
+    }
+    if (++s->col == s->w)
+    {
+        s->col = 0;
+        s->page++;
+        if (s->block == 1)
+        {
+            ssd1306_streamFlush(s);
+            ssd1306_lcd.next_page();
+        }
+        else
+        {
+            // the block would go on at the column it was set at
+            ssd1306_streamEnd(s);
+        }
+    }
+}
+
+static void ssd1306_streamSkip(SBitmapStream *s, uint8_t count)
+{
+    ssd1306_streamEnd(s);
+    s->col += count;
+    while (s->col >= s->w)
+    {
+        s->col -= s->w;
+        s->page++;
+    }
+}
+
+void ssd1306_drawCompressedBitmap(uint8_t x, uint8_t y, const uint8_t *buf)
+{
+    SBitmapStream s;
+    if (x >= ssd1306_lcd.width)
+    {
+        return;
+    }
+    s.x = x;
+    s.y = y;
+    s.w = pgm_read_byte(&buf[0]);
+    s.visible = (ssd1306_lcd.width - x) < s.w ? (ssd1306_lcd.width - x) : s.w;
+    s.col = 0;
+    s.page = 0;
+    s.block = 0;
+    s.len = 0;
+    uint16_t left = s.w * (pgm_read_byte(&buf[1]) >> 3);
+    buf += 2;
+    while (left)
+    {
+        uint8_t op = pgm_read_byte(buf++);
+        uint8_t count = (op & 0x3F) + 1;
+        if (count > left)
+        {
+            count = left;
+        }
+        left -= count;
+        switch (op & 0xC0)
+        {
+            case 0x00:
+                while (count--)
+                {
+                    ssd1306_streamPut(&s, pgm_read_byte(buf++));
+                }
+                break;
+            case 0x40:
+            {
+                uint8_t data = pgm_read_byte(buf++);
+                while (count--)
+                {
+                    ssd1306_streamPut(&s, data);
+                }
+                break;
+            }
+            default:
+                ssd1306_streamSkip(&s, count);
+                break;
+        }
+    }
+    ssd1306_streamEnd(&s);
+}
+
 void gfx_drawMonoBitmap(lcdint_t x, lcdint_t y, lcduint_t w, lcduint_t h, const uint8_t *buf)
 {
     lcduint_t origin_width = w;
@@ -857,6 +1258,67 @@ void ssd1306_eraseTrace(SPRITE *sprite)
     }
 }
 
+/** Sends columns x1..x2 of a page: sprite bits at the new position, background elsewhere */
+static void ssd1306_sendSpriteRun(SPRITE *sprite, uint8_t page, int16_t x1, int16_t x2)
+{
+    uint8_t offsety = sprite->y & 0x7;
+    uint8_t top = sprite->y >> 3;
+    uint8_t covered = (page == top) || (offsety && (page == top + 1));
+    ssd1306_lcd.set_block(x1, page, x2 - x1 + 1);
+    for (int16_t x = x1; x <= x2; x++)
+    {
+        uint8_t data = 0;
+        if ( covered && (x >= sprite->x) && (x < sprite->x + sprite->w) )
+        {
+            data = pgm_read_byte( &sprite->data[x - sprite->x] );
+            data = (page == top) ? (data << offsety) : (data >> (8 - offsety));
+        }
+        ssd1306_lcd.send_pixels1( s_ssd1306_invertByte^data );
+    }
+    ssd1306_intf.stop();
+}
+
+void ssd1306_moveSprite(SPRITE *sprite)
+{
+    int16_t last_page = (ssd1306_lcd.height >> 3) - 1;
+    int16_t last_column = ssd1306_lcd.width - 1;
+    int16_t old_top = sprite->ly >> 3;
+    int16_t old_bottom = (sprite->ly + 7) >> 3;
+    int16_t new_top = sprite->y >> 3;
+    int16_t new_bottom = (sprite->y + 7) >> 3;
+    int16_t top = min(old_top, new_top);
+    int16_t bottom = min(max(old_bottom, new_bottom), last_page);
+    for (int16_t page = top; page <= bottom; page++)
+    {
+        // columns of the page covered by the old and by the new image, empty if x1 > x2
+        int16_t ox1 = sprite->lx, ox2 = min(sprite->lx + sprite->w - 1, last_column);
+        int16_t nx1 = sprite->x, nx2 = min(sprite->x + sprite->w - 1, last_column);
+        if ( (page < old_top) || (page > old_bottom) )
+        {
+            ox2 = ox1 - 1;
+        }
+        if ( (page < new_top) || (page > new_bottom) )
+        {
+            nx2 = nx1 - 1;
+        }
+        if ( (ox1 <= ox2) && (nx1 <= nx2) && (ox1 <= nx2 + 1) && (nx1 <= ox2 + 1) )
+        {
+            ssd1306_sendSpriteRun(sprite, page, min(ox1, nx1), max(ox2, nx2));
+            continue;
+        }
+        if (ox1 <= ox2)
+        {
+            ssd1306_sendSpriteRun(sprite, page, ox1, ox2);
+        }
+        if (nx1 <= nx2)
+        {
+            ssd1306_sendSpriteRun(sprite, page, nx1, nx2);
+        }
+    }
+    sprite->lx = sprite->x;
+    sprite->ly = sprite->y;
+}
+
 SPRITE       ssd1306_createSprite(uint8_t x, uint8_t y, uint8_t w, const uint8_t *data)
 {
     return (SPRITE){x,y,w,x,y,data,NULL};
@@ -882,3 +1344,134 @@ void ssd1306_setFont6x8(const uint8_t * progmemFont)
     s_font6x8 = progmemFont + 4;
 }
 
+
+///////////////////////////////////////////////////////////////////////////////
+////// SHADOW FRAMEBUFFER /////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+static uint8_t *s_shadow = NULL;
+static ssd1306_lcd_t s_shadow_lcd;
+static void (*s_shadow_stop)(void);
+// drawing session opened by shadow set_block, closed without touching the bus
+static uint8_t s_shadow_session;
+static lcduint_t s_shadow_x, s_shadow_w, s_shadow_col, s_shadow_page;
+// changed columns per page, first > last when clean
+static lcduint_t s_dirty_first[SSD1306_SHADOW_MAX_PAGES];
+static lcduint_t s_dirty_last[SSD1306_SHADOW_MAX_PAGES];
+
+static void ssd1306_shadowClean(void)
+{
+    for (uint8_t i = 0; i < SSD1306_SHADOW_MAX_PAGES; i++)
+    {
+        s_dirty_first[i] = ssd1306_lcd.width;
+        s_dirty_last[i] = 0;
+    }
+}
+
+static void ssd1306_shadowSetBlock(lcduint_t x, lcduint_t y, lcduint_t w)
+{
+    s_shadow_x = x;
+    s_shadow_w = w ? w : ssd1306_lcd.width - x;
+    s_shadow_col = x;
+    s_shadow_page = y;
+    s_shadow_session = 1;
+}
+
+static void ssd1306_shadowNextPage(void)
+{
+    // horizontal addressing wraps to the next page by itself
+}
+
+static void ssd1306_shadowSendPixels1(uint8_t data)
+{
+    uint8_t pages = ssd1306_lcd.height >> 3;
+    if (s_shadow_page < pages && s_shadow_col < ssd1306_lcd.width)
+    {
+        uint8_t *p = &s_shadow[s_shadow_page * ssd1306_lcd.width + s_shadow_col];
+        // redrawing the same content leaves the page clean
+        if (*p != data)
+        {
+            *p = data;
+            if (s_shadow_col < s_dirty_first[s_shadow_page]) s_dirty_first[s_shadow_page] = s_shadow_col;
+            if (s_shadow_col > s_dirty_last[s_shadow_page]) s_dirty_last[s_shadow_page] = s_shadow_col;
+        }
+    }
+    if (++s_shadow_col >= s_shadow_x + s_shadow_w)
+    {
+        s_shadow_col = s_shadow_x;
+        s_shadow_page = (s_shadow_page + 1) % pages;
+    }
+}
+
+static void ssd1306_shadowSendPixelsBuffer1(const uint8_t *buffer, uint16_t len)
+{
+    while (len--)
+    {
+        ssd1306_shadowSendPixels1(*buffer++);
+    }
+}
+
+static void ssd1306_shadowStop(void)
+{
+    // sessions not opened by the shadow, commands for example, are real
+    if (s_shadow_session)
+    {
+        s_shadow_session = 0;
+        return;
+    }
+    s_shadow_stop();
+}
+
+void ssd1306_setShadowBuffer(uint8_t *buffer)
+{
+    if (buffer && !s_shadow && (ssd1306_lcd.height >> 3) <= SSD1306_SHADOW_MAX_PAGES)
+    {
+        s_shadow_lcd = ssd1306_lcd;
+        s_shadow_stop = ssd1306_intf.stop;
+        ssd1306_lcd.set_block = ssd1306_shadowSetBlock;
+        ssd1306_lcd.next_page = ssd1306_shadowNextPage;
+        ssd1306_lcd.send_pixels1 = ssd1306_shadowSendPixels1;
+        ssd1306_lcd.send_pixels_buffer1 = ssd1306_shadowSendPixelsBuffer1;
+        ssd1306_intf.stop = ssd1306_shadowStop;
+        s_shadow_session = 0;
+        s_shadow = buffer;
+        // the panel content is unknown, start from a blank screen
+        memset(s_shadow, s_ssd1306_invertByte, ssd1306_lcd.width * (ssd1306_lcd.height >> 3));
+        ssd1306_shadowClean();
+        for (uint8_t i = 0; i < (ssd1306_lcd.height >> 3); i++)
+        {
+            s_dirty_first[i] = 0;
+            s_dirty_last[i] = ssd1306_lcd.width - 1;
+        }
+    }
+    else if (!buffer && s_shadow)
+    {
+        ssd1306_flush();
+        ssd1306_lcd.set_block = s_shadow_lcd.set_block;
+        ssd1306_lcd.next_page = s_shadow_lcd.next_page;
+        ssd1306_lcd.send_pixels1 = s_shadow_lcd.send_pixels1;
+        ssd1306_lcd.send_pixels_buffer1 = s_shadow_lcd.send_pixels_buffer1;
+        ssd1306_intf.stop = s_shadow_stop;
+        s_shadow = NULL;
+    }
+}
+
+void ssd1306_flush(void)
+{
+    if (!s_shadow)
+    {
+        return;
+    }
+    for (uint8_t i = 0; i < (ssd1306_lcd.height >> 3); i++)
+    {
+        if (s_dirty_first[i] > s_dirty_last[i])
+        {
+            continue;
+        }
+        lcduint_t w = s_dirty_last[i] - s_dirty_first[i] + 1;
+        s_shadow_lcd.set_block(s_dirty_first[i], i, w);
+        s_shadow_lcd.send_pixels_buffer1(&s_shadow[i * ssd1306_lcd.width + s_dirty_first[i]], w);
+        s_shadow_stop();
+    }
+    ssd1306_shadowClean();
+}
@@ -97,6 +97,25 @@ void         ssd1306_positiveMode(void);
  */
 uint8_t     ssd1306_printFixed(uint8_t xpos, uint8_t y, const char *ch, EFontStyle style);
 
+#ifndef SSD1306_PRINTF_MAX
+/** Longest text ssd1306_printFixedf() prints, including the terminator */
+#define SSD1306_PRINTF_MAX  32
+#endif
+
+/**
+ * Prints formatted text to screen using fixed font, like ssd1306_printFixed().
+ * The text is formatted on the stack and cut at SSD1306_PRINTF_MAX - 1 chars,
+ * the heap is not used as long as the format has no floating point conversions.
+ * @param xpos - horizontal position in pixels
+ * @param y - vertical position in pixels
+ * @param style - font style (EFontStyle)
+ * @param format - printf format string
+ * @returns number of chars printed
+ * @see ssd1306_printFixed
+ */
+uint8_t     ssd1306_printFixedf(uint8_t xpos, uint8_t y, EFontStyle style, const char *format, ...)
+                                __attribute__ ((format (printf, 4, 5)));
+
 /**
  * Prints text to screen using double size fixed font.
  * @param xpos - horizontal position in pixels
@@ -135,6 +154,56 @@ uint8_t     ssd1306_printFixed2x(uint8_t xpos, uint8_t y, const char ch[], EFont
  */
 uint8_t     ssd1306_printFixedN(uint8_t xpos, uint8_t y, const char ch[], EFontStyle style, uint8_t factor);
 
+/**
+ * Prints the lines of a text layout one below the other, left aligned.
+ * @param xpos - horizontal position in pixels
+ * @param y - vertical position of the first line in pixels
+ * @param layout - layout made by ssd1306_layoutText()
+ * @param style - font style (EFontStyle), normal by default.
+ * @returns number of lines printed
+ * @see ssd1306_layoutText
+ */
+uint8_t     ssd1306_printLayout(uint8_t xpos, uint8_t y, const STextLayout *layout, EFontStyle style);
+
+/**
+ * Renders chars of the active font, scaled by factor as ssd1306_printFixedN() does,
+ * into a RAM buffer. Printing from the atlas then copies ready columns to the display.
+ * @param atlas - atlas to set up
+ * @param buffer - RAM buffer for the chars, NULL to only get the size needed
+ * @param size - size of the buffer in bytes
+ * @param first - first char to render
+ * @param count - number of chars to render, 96 for a whole ascii font
+ * @param style - font style (EFontStyle)
+ * @param factor - 0, 1, 2, 3.
+ * @returns bytes the atlas needs, 0 if the buffer is too small
+ * @note The atlas keeps working after another font is set.
+ */
+uint16_t    ssd1306_createFontAtlas(SFontAtlas *atlas, uint8_t *buffer, uint16_t size,
+                                    uint16_t first, uint16_t count, EFontStyle style, uint8_t factor);
+
+/**
+ * Returns the column data of one page row of an atlas char.
+ * @param atlas - atlas made by ssd1306_createFontAtlas()
+ * @param unicode - char to look for
+ * @param page - page row of the scaled char, 0 is the top one
+ * @param data - set to the columns, NULL if the char is not in the atlas
+ * @returns number of columns, the width of the scaled font for missing chars
+ */
+uint8_t     ssd1306_getAtlasColumns(const SFontAtlas *atlas, uint16_t unicode, uint8_t page,
+                                    const uint8_t **data);
+
+/**
+ * Prints text to screen like ssd1306_printFixedN() does, from the chars of an atlas.
+ * Chars not in the atlas are left blank.
+ * @param xpos - horizontal position in pixels
+ * @param y - vertical position in pixels
+ * @param ch - NULL-terminated string to print
+ * @param atlas - atlas made by ssd1306_createFontAtlas()
+ * @returns number of chars in string
+ * @see ssd1306_createFontAtlas
+ */
+uint8_t     ssd1306_printAtlas(uint8_t xpos, uint8_t y, const char ch[], const SFontAtlas *atlas);
+
 /**
  * @brief Prints single character to display at current cursor position
  *
@@ -234,6 +303,40 @@ void         ssd1306_putPixel(uint8_t x, uint8_t y);
  */
 void         ssd1306_putPixels(uint8_t x, uint8_t y, uint8_t pixels);
 
+#ifndef SSD1306_PIXEL_BATCH_COLUMNS
+/** Columns of a page ssd1306_putPixelList() merges on the stack at a time */
+#define SSD1306_PIXEL_BATCH_COLUMNS  32
+#endif
+
+/** Pixel for ssd1306_putPixelList() */
+typedef struct
+{
+    uint8_t x;  ///< horizontal position in pixels
+    uint8_t y;  ///< vertical position in pixels
+} SPixel;
+
+/**
+ * Puts a list of pixels on the LCD, in any order.
+ * Pixels are merged into the bytes of their page and column, and every run of
+ * adjacent bytes on a page is sent as one block, so the bus carries each byte
+ * touched once, whatever the number of pixels.
+ *
+ * ~~~~~~~~~~~~~~~{.c}
+ * // Plot a sensor graph
+ * SPixel points[128];
+ * for (uint8_t i = 0; i < 128; i++) { points[i].x = i; points[i].y = 63 - samples[i] / 16; }
+ * ssd1306_putPixelList(points, 128);
+ * ~~~~~~~~~~~~~~~
+ *
+ * @param pixels - pixels to draw
+ * @param count - number of pixels
+ *
+ * @warning Like ssd1306_putPixel(), the other pixels of a byte touched are
+ *          cleared on the display. The list is scanned once per page and
+ *          SSD1306_PIXEL_BATCH_COLUMNS wide part of a page touched.
+ */
+void         ssd1306_putPixelList(const SPixel *pixels, uint16_t count);
+
 /**
  * Draws rectangle
  * @param x1 - left boundary in pixel units
@@ -250,6 +353,9 @@ void         ssd1306_drawRect(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2);
  * @param x2 - x position in pixels of end point
  * @param y2 - y position in pixels of end point
  *
+ * Bytes of adjacent columns on the same page are sent as one block, horizontal
+ * and vertical lines are drawn with ssd1306_drawHLine() and ssd1306_drawVLine().
+ *
  * @warning Remember that this function draws line directly in GDRAM of oled controller.
  *          Since there is no way to detect pixels already being displayed, some pixels
  *          can be overwritten by black color. If you use RGB oled, based on ssd1331 controller,
@@ -327,6 +433,18 @@ void         ssd1306_drawBufferFast(lcdint_t x, lcdint_t y, lcduint_t w, lcduint
  */
 void         ssd1306_drawBitmap(uint8_t x, uint8_t y, uint8_t w, uint8_t h, const uint8_t *buf);
 
+/**
+ * Draws compressed bitmap, located in Flash, on the display.
+ * The bitmap is decompressed while it is sent, so no RAM buffer is needed.
+ * Delta frames made by tools/bitmapcompress.py only send the bytes that differ
+ * from the previous frame, which must be on the display at the same position.
+ *
+ * @param x - horizontal position in pixels
+ * @param y - vertical position in blocks (pixels/8)
+ * @param buf - pointer to compressed data, located in Flash (see tools/format.txt)
+ */
+void         ssd1306_drawCompressedBitmap(uint8_t x, uint8_t y, const uint8_t *buf);
+
 /**
  * Draws bitmap, located in Flash, on the display
  *
@@ -376,6 +494,15 @@ void         ssd1306_eraseSprite(SPRITE *sprite);
  */
 void         ssd1306_eraseTrace(SPRITE *sprite);
 
+/**
+ * Moves sprite from the last drawn position to the one in x and y fields.
+ * Does the same as ssd1306_eraseTrace() followed by ssd1306_drawSprite(), but
+ * every page and column touched by the old or the new image is sent only once,
+ * with the new bits set and the old ones cleared.
+ * @param sprite - pointer to SPRITE structure
+ */
+void         ssd1306_moveSprite(SPRITE *sprite);
+
 /**
  * Creates sprite object. Sprite height is fixed to 8 pixels
  * @param x - horizontal position in pixels
@@ -506,10 +633,133 @@ void ssd1306_menuDown(SAppMenu *menu);
  */
 void ssd1306_menuUp(SAppMenu *menu);
 
+#ifndef SSD1306_LIST_MENU_MAX_ROWS
+/** Rows a list menu shows at most, 8 fill a 64 pixel display */
+#define SSD1306_LIST_MENU_MAX_ROWS   8
+#endif
+
+#ifndef SSD1306_LIST_MENU_TEXT_SIZE
+/** Size of the buffer list menu items are generated into, 21 chars of 6x8 font */
+#define SSD1306_LIST_MENU_TEXT_SIZE  22
+#endif
+
+/**
+ * Callback generating text of list menu item.
+ *
+ * @param index - index of the item, 0 - count-1
+ * @param text - buffer to write null-terminated text to
+ * @param size - size of the buffer
+ * @param arg - pointer passed to ssd1306_createListMenu()
+ */
+typedef void (*SMenuItemProvider)(uint16_t index, char *text, uint8_t size, void *arg);
+
+/**
+ * Describes list menu object. Unlike SAppMenu, items are not kept in memory,
+ * but generated by the provider when their row is drawn.
+ */
+typedef struct
+{
+    /// callback generating text of menu items
+    SMenuItemProvider provider;
+    /// pointer passed to the provider
+    void       *arg;
+    /// count of menu items in the menu
+    uint16_t    count;
+    /// currently selected item. Internally updated.
+    uint16_t    selection;
+    /// item on the top line. Internally updated
+    uint16_t    scrollPosition;
+    /// selected item, when last redraw operation was performed. Internally updated.
+    uint16_t    drawnSelection;
+    /// display page shown on the top line. Internally updated
+    uint8_t     startPage;
+    /// item drawn in each display page. Internally updated
+    uint16_t    pageItems[SSD1306_LIST_MENU_MAX_ROWS];
+} SAppListMenu;
+
+/**
+ * Creates list menu object, which gets text of items from the provider.
+ * Selection is set to the first item by default.
+ *
+ * @param menu - Pointer to SAppListMenu structure
+ * @param provider - callback generating text of menu items
+ * @param arg - pointer to pass to the provider
+ * @param count - count of menu items, up to 65534
+ */
+void ssd1306_createListMenu(SAppListMenu *menu, SMenuItemProvider provider, void *arg, uint16_t count);
+
+/**
+ * Clears the display and shows visible menu items, one per 8 pixel row,
+ * without a frame. Call it again after changing count of items, or
+ * after drawing anything else on the display.
+ *
+ * @param menu - Pointer to SAppListMenu structure
+ *
+ * @warning works only in SSD1306 compatible mode.
+ */
+void ssd1306_showListMenu(SAppListMenu *menu);
+
+/**
+ * Updates list menu on the display. Only rows, whose item or selection state
+ * changed, are drawn. On 64 pixel ssd1306 and sh1106 displays scrolling moves
+ * the display start line, so scrolling by one item draws two rows only.
+ *
+ * @param menu - Pointer to SAppListMenu structure
+ *
+ * @warning works only in SSD1306 compatible mode.
+ */
+void ssd1306_updateListMenu(SAppListMenu *menu);
+
+/**
+ * Returns currently selected item of list menu.
+ * First item has zero-index.
+ *
+ * @param menu - Pointer to SAppListMenu structure
+ */
+uint16_t ssd1306_listMenuSelection(SAppListMenu *menu);
+
+/**
+ * Moves selection pointer down by 1 item, or to the first item from the last one.
+ * Use ssd1306_updateListMenu() to refresh menu state on the display.
+ *
+ * @param menu - Pointer to SAppListMenu structure
+ */
+void ssd1306_listMenuDown(SAppListMenu *menu);
+
+/**
+ * Moves selection pointer up by 1 item, or to the last item from the first one.
+ * Use ssd1306_updateListMenu() to refresh menu state on the display.
+ *
+ * @param menu - Pointer to SAppListMenu structure
+ */
+void ssd1306_listMenuUp(SAppListMenu *menu);
+
 /**
  * @}
  */
 
+/** Pages the shadow framebuffer covers, 64 rows */
+#define SSD1306_SHADOW_MAX_PAGES  8
+
+/**
+ * @brief Switches direct draw functions to a shadow framebuffer.
+ *
+ * Switches all 1-bit direct draw functions to a framebuffer in RAM. The panel
+ * is only updated by ssd1306_flush(), which sends the changed columns of each
+ * page. Call the function after the display is initialized, pass NULL to
+ * flush and draw directly again. Displays taller than SSD1306_SHADOW_MAX_PAGES
+ * pages are left in direct mode.
+ *
+ * @param buffer - width * height / 8 bytes, NULL to disable shadow mode
+ */
+void ssd1306_setShadowBuffer(uint8_t *buffer);
+
+/**
+ * Sends the columns changed since the last flush to the panel.
+ * Does nothing when shadow mode is off.
+ */
+void ssd1306_flush(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -29,6 +29,7 @@
 #include "ssd1306_hal/io.h"
 
 #include "lcd/ssd1331_commands.h"
+#include "lcd/oled_ssd1331.h"
 #include "lcd/lcd_common.h"
 
 extern uint16_t ssd1306_color;
@@ -83,8 +84,18 @@ void ssd1306_drawMonoBuffer8(lcdint_t xpos, lcdint_t ypos, lcduint_t w, lcduint_
 
 void ssd1306_drawBufferFast8(lcdint_t x, lcdint_t y, lcduint_t w, lcduint_t h, const uint8_t *data)
 {
-    uint32_t count = w * h;
+    uint32_t count = (uint32_t)w * h;
     ssd1306_lcd.set_block(x, y, w);
+    if (ssd1306_lcd.send_pixels_buffer8)
+    {
+        while (count)
+        {
+            uint16_t len = count < 0x8000 ? count : 0x8000;
+            ssd1306_lcd.send_pixels_buffer8( data, len );
+            data += len;
+            count -= len;
+        }
+    }
     while (count--)
     {
         ssd1306_lcd.send_pixels8( *data );
@@ -93,13 +104,50 @@ void ssd1306_drawBufferFast8(lcdint_t x, lcdint_t y, lcduint_t w, lcduint_t h, c
     ssd1306_intf.stop();
 }
 
+static uint8_t s_pixel[4];
+static uint8_t s_pixel_len;
+
+static void ssd1306_capturePixel(uint8_t data)
+{
+    if (s_pixel_len < sizeof(s_pixel))
+    {
+        s_pixel[s_pixel_len] = data;
+    }
+    s_pixel_len++;
+}
+
 void ssd1306_fillScreen8(uint8_t fill_Data)
 {
+    if (ssd1331_accelFill(0, 0, ssd1306_lcd.width - 1, ssd1306_lcd.height - 1, fill_Data))
+    {
+        return;
+    }
     ssd1306_lcd.set_block(0, 0, 0);
     uint32_t count = (uint32_t)ssd1306_lcd.width * (uint32_t)ssd1306_lcd.height;
-    while (count--)
+    if (ssd1306_lcd.send_pixels8 == ssd1306_intf.send)
+    {
+        ssd1306_intfSendFill(fill_Data, count);
+        ssd1306_intf.stop();
+        return;
+    }
+    // Catch the bytes of one pixel in the display format, i.e. RGB565, and repeat them
+    void (*send)(uint8_t) = ssd1306_intf.send;
+    s_pixel_len = 0;
+    ssd1306_intf.send = ssd1306_capturePixel;
+    ssd1306_lcd.send_pixels8( fill_Data );
+    ssd1306_intf.send = send;
+    if (s_pixel_len && s_pixel_len <= sizeof(s_pixel))
+    {
+        ssd1306_intfSendPattern(s_pixel, s_pixel_len, count);
+    }
+    else
     {
-        ssd1306_lcd.send_pixels8( fill_Data );
+        // the pixel went out bypassing ssd1306_intf.send, or did not fit
+        if (!s_pixel_len) count--;
+        while (count--)
+        {
+            ssd1306_lcd.send_pixels8( fill_Data );
+        }
     }
     ssd1306_intf.stop();
 }
@@ -138,8 +186,22 @@ void ssd1306_drawHLine8(lcdint_t x1, lcdint_t y1, lcdint_t x2)
     ssd1306_intf.stop();
 }
 
+static void ssd1306_span8(lcdint_t x, lcdint_t y, lcduint_t w, lcduint_t count)
+{
+    ssd1306_lcd.set_block(x, y, w);
+    while (count--)
+    {
+        ssd1306_lcd.send_pixels8( ssd1306_color );
+    }
+    ssd1306_intf.stop();
+}
+
 void ssd1306_drawLine8(lcdint_t x1, lcdint_t y1, lcdint_t x2, lcdint_t y2)
 {
+    if (ssd1331_accelLine(x1, y1, x2, y2, ssd1306_color))
+    {
+        return;
+    }
     lcduint_t  dx = x1 > x2 ? (x1 - x2): (x2 - x1);
     lcduint_t  dy = y1 > y2 ? (y1 - y2): (y2 - y1);
     lcduint_t  err = 0;
@@ -150,16 +212,20 @@ void ssd1306_drawLine8(lcdint_t x1, lcdint_t y1, lcdint_t x2, lcdint_t y2)
             ssd1306_swap_data(x1, x2, lcdint_t);
             ssd1306_swap_data(y1, y2, lcdint_t);
         }
+        // pixels of a column go out as one block, a vertical line is a single one
+        lcdint_t top = y1;
         for(; y1<=y2; y1++)
         {
             err += dx;
             if (err >= dy)
             {
                  err -= dy;
+                 ssd1306_span8( x1, top, 1, y1 - top );
+                 top = y1;
                  x1 < x2 ? x1++: x1--;
             }
-            ssd1306_putPixel8( x1, y1 );
         }
+        ssd1306_span8( x1, top, 1, y2 - top + 1 );
     }
     else
     {
@@ -168,16 +234,24 @@ void ssd1306_drawLine8(lcdint_t x1, lcdint_t y1, lcdint_t x2, lcdint_t y2)
             ssd1306_swap_data(x1, x2, lcdint_t);
             ssd1306_swap_data(y1, y2, lcdint_t);
         }
+        // same for the pixels of a row
+        lcdint_t left = x1;
         for(; x1<=x2; x1++)
         {
             err += dy;
-            if (err >= dx)
+            // a diagonal steps from the second pixel on, so that it ends at y2
+            if (err > dx)
             {
                  err -= dx;
+                 if (x1 > left)
+                 {
+                     ssd1306_span8( left, y1, x1 - left, x1 - left );
+                 }
+                 left = x1;
                  if (y1 < y2) y1++; else y1--;
             }
-            ssd1306_putPixel8( x1, y1 );
         }
+        ssd1306_span8( left, y1, x2 - left + 1, x2 - left + 1 );
     }
 }
 
@@ -199,6 +273,10 @@ void ssd1306_fillRect8(lcdint_t x1, lcdint_t y1, lcdint_t x2, lcdint_t y2)
     {
         ssd1306_swap_data(x1, x2, lcdint_t);
     }
+    if (ssd1331_accelFill(x1, y1, x2, y2, ssd1306_color))
+    {
+        return;
+    }
     ssd1306_lcd.set_block(x1, y1, x2 - x1 + 1);
     uint16_t count = (x2 - x1 + 1) * (y2 - y1 + 1);
     while (count--)
@@ -253,6 +331,10 @@ void ssd1306_drawBitmap8(lcdint_t xpos, lcdint_t ypos, lcduint_t w, lcduint_t h,
 
 void ssd1306_clearBlock8(uint8_t x, uint8_t y, uint8_t w, uint8_t h)
 {
+    if (w && h && ssd1331_accelFill(x, y, x + w - 1, y + h - 1, 0x00))
+    {
+        return;
+    }
     ssd1306_lcd.set_block(x, y, w);
     uint32_t count = w * h;
     while (count--)
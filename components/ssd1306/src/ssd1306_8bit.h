@@ -144,6 +144,7 @@ void ssd1306_drawHLine8(lcdint_t x1, lcdint_t y1, lcdint_t x2);
  * Draw line directly in OLED display GDRAM.
  * This is software implementation. Some OLED controllers have hardware implementation.
  * Refer to datasheet.
+ * Runs of pixels in the same row or column are sent as one block.
  *
  * @param x1 - start horizontal position in pixels
  * @param y1 - start vertical position in pixels
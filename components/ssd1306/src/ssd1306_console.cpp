@@ -24,10 +24,52 @@
 
 #include "ssd1306_console.h"
 
+extern "C" lcduint_t ssd1306_cursorY;
+extern "C" SFixedFontInfo s_fixedFont;
+
+#ifndef CONFIG_PLATFORM_CRITICAL_AVAILABLE
+static inline void ssd1306_platform_enterCritical(void) {}
+static inline void ssd1306_platform_exitCritical(void) {}
+#endif
+
 void Ssd1306Console::clear()
 {
     ssd1306_clearScreen();
     setCursor(0,0);
+    if (m_scrolling)
+    {
+        ssd1306_setStartLine(0);
+        m_scrolling = false;
+    }
+}
+
+size_t Ssd1306Console::write(uint8_t ch)
+{
+    return Ssd1306Console::write(&ch, 1);
+}
+
+size_t Ssd1306Console::write(const uint8_t *buffer, size_t size)
+{
+    bool startLine = ssd1306_lcd.type == LCD_TYPE_SSD1306 || ssd1306_lcd.type == LCD_TYPE_SH1106;
+    bool moved = false;
+    size_t n = 0;
+    for (; size; size--, buffer++)
+    {
+        lcduint_t y = ssd1306_cursorY;
+        n += ssd1306_write(*buffer);
+        // ssd1306_write() wraps to the top line and clears it, which is the
+        // line below the bottom one if the display starts right after it
+        if (startLine && ssd1306_cursorY < y)
+        {
+            m_scrolling = true;
+        }
+        moved |= ssd1306_cursorY != y;
+    }
+    if (moved && m_scrolling)
+    {
+        ssd1306_setStartLine((ssd1306_cursorY + s_fixedFont.h.height) % ssd1306_lcd.height);
+    }
+    return n;
 }
 
 void Ssd1306Console::setCursor(lcduint_t x, lcduint_t y)
@@ -35,3 +77,166 @@ void Ssd1306Console::setCursor(lcduint_t x, lcduint_t y)
     ssd1306_setCursor8(x,y);
 }
 
+
+void Ssd1306BufferedConsole::begin()
+{
+    uint8_t pages = s_fixedFont.pages ? s_fixedFont.pages : 1;
+    uint8_t rows = (ssd1306_lcd.height >> 3) / pages;
+    uint8_t columns = s_fixedFont.h.width ? ssd1306_lcd.width / s_fixedFont.h.width : 0;
+    m_rows = rows < SSD1306_CONSOLE_ROWS ? rows : SSD1306_CONSOLE_ROWS;
+    m_columns = columns < SSD1306_CONSOLE_COLUMNS ? columns : SSD1306_CONSOLE_COLUMNS;
+    // ring index is the display page, moving the start line scrolls the ring
+    m_startLine = (ssd1306_lcd.type == LCD_TYPE_SSD1306 || ssd1306_lcd.type == LCD_TYPE_SH1106) &&
+                  (ssd1306_lcd.height == 64) && (pages == 1) && (m_rows == 8);
+    clear();
+}
+
+void Ssd1306BufferedConsole::clear()
+{
+    ssd1306_platform_enterCritical();
+    m_first = 0;
+    m_count = m_rows ? 1 : 0;
+    m_column = 0;
+    m_length[0] = 0;
+    m_dirty = 0;
+    ssd1306_platform_exitCritical();
+    ssd1306_clearScreen();
+    if (m_startLine)
+    {
+        ssd1306_setStartLine(0);
+    }
+    m_drawnFirst = 0;
+}
+
+void Ssd1306BufferedConsole::newLine()
+{
+    if (m_count < m_rows)
+    {
+        m_count++;
+    }
+    else
+    {
+        m_first = (m_first + 1) % m_rows;
+    }
+    uint8_t line = (m_first + m_count - 1) % m_rows;
+    m_length[line] = 0;
+    m_column = 0;
+    m_dirty |= (1 << line);
+}
+
+size_t Ssd1306BufferedConsole::write(uint8_t ch)
+{
+    return Ssd1306BufferedConsole::write(&ch, 1);
+}
+
+size_t Ssd1306BufferedConsole::write(const uint8_t *buffer, size_t size)
+{
+    if (!m_rows || !m_columns)
+    {
+        return 0;
+    }
+    size_t n = 0;
+    ssd1306_platform_enterCritical();
+    while (size--)
+    {
+        n += put(*buffer++);
+    }
+    ssd1306_platform_exitCritical();
+    return n;
+}
+
+/* Called with the lock held */
+size_t Ssd1306BufferedConsole::put(uint8_t ch)
+{
+    size_t n = 0;
+    if (ch == '\r')
+    {
+        m_column = 0;
+    }
+    else if (ch == '\n')
+    {
+        newLine();
+    }
+    else
+    {
+        if (m_column >= m_columns)
+        {
+            newLine();
+        }
+        uint8_t line = (m_first + m_count - 1) % m_rows;
+        m_text[line][m_column++] = ch;
+        if (m_column > m_length[line])
+        {
+            m_length[line] = m_column;
+        }
+        m_dirty |= (1 << line);
+        n = 1;
+    }
+    return n;
+}
+
+void Ssd1306BufferedConsole::drawLine(uint8_t row, const char *text)
+{
+    uint8_t pages = s_fixedFont.pages ? s_fixedFont.pages : 1;
+    lcduint_t width = 0;
+    if (text[0])
+    {
+        STextSize size;
+        ssd1306_measureText(text, 0, 0, &size);
+        width = size.width < ssd1306_lcd.width ? size.width : ssd1306_lcd.width;
+        ssd1306_printFixed(0, (row * pages) << 3, text, STYLE_NORMAL);
+    }
+    if (width < ssd1306_lcd.width)
+    {
+        ssd1306_clearBlock(width, row * pages, ssd1306_lcd.width - width, pages << 3);
+    }
+}
+
+void Ssd1306BufferedConsole::flush()
+{
+    char text[SSD1306_CONSOLE_ROWS][SSD1306_CONSOLE_COLUMNS + 1];
+    ssd1306_platform_enterCritical();
+    uint8_t first = m_first;
+    uint16_t dirty = m_dirty;
+    if (!m_startLine && first != m_drawnFirst)
+    {
+        // every line moved to another row
+        dirty = (1 << m_count) - 1;
+    }
+    for (uint8_t i = 0; i < m_rows; i++)
+    {
+        if (dirty & (1 << i))
+        {
+            memcpy(text[i], m_text[i], m_length[i]);
+            text[i][m_length[i]] = '\0';
+        }
+    }
+    m_dirty = 0;
+    ssd1306_platform_exitCritical();
+    m_lastRender = millis();
+    if (!dirty)
+    {
+        return;
+    }
+    uint8_t drawnFirst = m_drawnFirst;
+    m_drawnFirst = first;
+    for (uint8_t i = 0; i < m_rows; i++)
+    {
+        if (dirty & (1 << i))
+        {
+            drawLine(m_startLine ? i : (i + m_rows - first) % m_rows, text[i]);
+        }
+    }
+    if (m_startLine && first != drawnFirst)
+    {
+        ssd1306_setStartLine(first << 3);
+    }
+}
+
+void Ssd1306BufferedConsole::update()
+{
+    if ((uint32_t)(millis() - m_lastRender) >= m_interval)
+    {
+        flush();
+    }
+}
@@ -65,6 +65,23 @@ public:
         return W(ch);
     }
 
+    /**
+     * Writes a run of chars to the display, without a virtual call per char
+     * @param buffer - chars to write
+     * @param size - number of chars in buffer
+     */
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        size_t n = 0;
+        while (size--)
+        {
+            n += W(*buffer++);
+        }
+        return n;
+    }
+
+    using Print::write;
+
 private:
 
 };
@@ -101,8 +118,133 @@ public:
      */
     void   setCursor(lcduint_t x, lcduint_t y);
 
+    /**
+     * Writes single character. Once the screen is full, every new line
+     * scrolls the text up by moving the start line of ssd1306 and sh1106
+     * controllers, so only the new line is sent. Other displays wrap to
+     * the top. The font height must divide the display height.
+     *
+     * @param ch - character to write
+     */
+    size_t write(uint8_t ch) override;
+
+    /**
+     * Writes a run of chars. The start line is moved once, after the last
+     * line the run scrolled in.
+     *
+     * @param buffer - chars to write
+     * @param size - number of chars in buffer
+     */
+    size_t write(const uint8_t *buffer, size_t size) override;
+
+    using Print::write;
+
 private:
+    /** Text reached the bottom line, start line follows the cursor */
+    bool m_scrolling = false;
+};
+
+#ifndef SSD1306_CONSOLE_COLUMNS
+/** Chars kept per line by Ssd1306BufferedConsole, 21 fill 128 pixels of 6x8 font */
+#define SSD1306_CONSOLE_COLUMNS  21
+#endif
+
+#ifndef SSD1306_CONSOLE_ROWS
+/** Lines kept by Ssd1306BufferedConsole, up to 16 */
+#define SSD1306_CONSOLE_ROWS     8
+#endif
+
+/**
+ * Ssd1306BufferedConsole keeps printed text as a ring of lines in RAM.
+ * write() does not touch the display, so several tasks can print at little
+ * cost. Changed lines are drawn by flush(), or by update() at most once per
+ * refresh interval. Once the screen is full, a new line scrolls the text up
+ * by moving the start line of 64 pixel ssd1306 and sh1106 displays, when the
+ * font is 8 pixels high. Other displays redraw all lines.
+ * Text is taken as ascii, one char per byte, and lines wrap at the display width.
+ * ~~~~~~~~~~~~~~~{.cpp}
+ * Ssd1306BufferedConsole  console;
+ * void setup()
+ * {
+ *      ssd1306_128x64_spi_init(3, 4, 5);
+ *      ssd1306_setFixedFont(ssd1306xled_font6x8);
+ *      console.begin();
+ * }
+ * void loop()
+ * {
+ *      console.print( "Hello" );
+ *      console.update();
+ * }
+ * ~~~~~~~~~~~~~~~
+ */
+class Ssd1306BufferedConsole: public Print
+{
+public:
+    /**
+     * Creates console object.
+     *
+     * @param interval minimum time between two renders by update() in milliseconds
+     */
+    explicit Ssd1306BufferedConsole(uint16_t interval = 100): m_interval(interval) { };
+
+    /**
+     * Fits lines to the display and the font, and clears the screen.
+     * Call it after the display and the font are set up.
+     */
+    void   begin();
+
+    /**
+     * Removes all text and clears the screen.
+     */
+    void   clear();
 
+    /**
+     * Adds single character to the last line. Can be called from any task.
+     *
+     * @param ch - character to write
+     */
+    size_t write(uint8_t ch) override;
+
+    /**
+     * Adds a run of chars, taking the lock once. Can be called from any task.
+     *
+     * @param buffer - chars to write
+     * @param size - number of chars in buffer
+     */
+    size_t write(const uint8_t *buffer, size_t size) override;
+
+    using Print::write;
+
+    /**
+     * Draws changed lines, if the refresh interval passed since they were drawn last.
+     */
+    void   update();
+
+    /**
+     * Draws changed lines now. Only one task may draw at a time.
+     */
+    void   flush();
+
+private:
+    char     m_text[SSD1306_CONSOLE_ROWS][SSD1306_CONSOLE_COLUMNS];
+    uint8_t  m_length[SSD1306_CONSOLE_ROWS];
+    /** Lines changed since the last render, bit per ring index */
+    uint16_t m_dirty = 0;
+    uint8_t  m_rows = 0;
+    uint8_t  m_columns = 0;
+    /** Ring index of the top line and count of lines in use */
+    uint8_t  m_first = 0;
+    uint8_t  m_count = 0;
+    uint8_t  m_column = 0;
+    /** Ring index of the top line on the display */
+    uint8_t  m_drawnFirst = 0;
+    bool     m_startLine = false;
+    uint16_t m_interval;
+    uint32_t m_lastRender = 0;
+
+    void   newLine();
+    size_t put(uint8_t ch);
+    void   drawLine(uint8_t row, const char *text);
 };
 
 #endif
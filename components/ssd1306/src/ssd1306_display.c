@@ -0,0 +1,93 @@
+/*
+    MIT License
+
+    Copyright (c) 2016-2018, Alexey Dynda
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "ssd1306_display.h"
+#include "intf/spi/ssd1306_spi.h"
+#include "ssd1306_hal/io.h"
+
+#ifndef CONFIG_PLATFORM_LOCK_AVAILABLE
+static inline void ssd1306_platform_lock(void) {}
+static inline void ssd1306_platform_unlock(void) {}
+#endif
+
+extern uint16_t ssd1306_color;
+extern lcduint_t ssd1306_cursorX;
+extern lcduint_t ssd1306_cursorY;
+extern SFixedFontInfo s_fixedFont;
+extern void (*s_ssd1306_getCharBitmap)(uint16_t unicode, SCharInfo *info);
+extern uint8_t s_ssd1306_invertByte;
+extern const uint8_t *s_font6x8;
+
+// state of the global api while an instance is loaded
+static ssd1306_display_t s_default;
+
+static void ssd1306_displaySave(ssd1306_display_t *display)
+{
+    display->intf = ssd1306_intf;
+    display->lcd = ssd1306_lcd;
+    display->color = ssd1306_color;
+    display->cursor_x = ssd1306_cursorX;
+    display->cursor_y = ssd1306_cursorY;
+    display->font = s_fixedFont;
+    display->get_char_bitmap = s_ssd1306_getCharBitmap;
+    display->invert_byte = s_ssd1306_invertByte;
+    display->font6x8 = s_font6x8;
+    display->spi_cs = s_ssd1306_cs;
+    display->spi_dc = s_ssd1306_dc;
+    display->spi_clock = s_ssd1306_spi_clock;
+    display->valid = 1;
+}
+
+static void ssd1306_displayLoad(const ssd1306_display_t *display)
+{
+    ssd1306_intf = display->intf;
+    ssd1306_lcd = display->lcd;
+    ssd1306_color = display->color;
+    ssd1306_cursorX = display->cursor_x;
+    ssd1306_cursorY = display->cursor_y;
+    s_fixedFont = display->font;
+    s_ssd1306_getCharBitmap = display->get_char_bitmap;
+    s_ssd1306_invertByte = display->invert_byte;
+    s_font6x8 = display->font6x8;
+    s_ssd1306_cs = display->spi_cs;
+    s_ssd1306_dc = display->spi_dc;
+    s_ssd1306_spi_clock = display->spi_clock;
+}
+
+void ssd1306_displayBegin(ssd1306_display_t *display)
+{
+    ssd1306_platform_lock();
+    ssd1306_displaySave(&s_default);
+    if (display->valid)
+    {
+        ssd1306_displayLoad(display);
+    }
+}
+
+void ssd1306_displayEnd(ssd1306_display_t *display)
+{
+    ssd1306_displaySave(display);
+    ssd1306_displayLoad(&s_default);
+    ssd1306_platform_unlock();
+}
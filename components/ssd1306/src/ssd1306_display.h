@@ -0,0 +1,113 @@
+/*
+    MIT License
+
+    Copyright (c) 2016-2018, Alexey Dynda
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+/**
+ * @file ssd1306_display.h Display instances
+ */
+
+#ifndef _SSD1306_DISPLAY_H_
+#define _SSD1306_DISPLAY_H_
+
+#include "nano_gfx_types.h"
+#include "lcd/lcd_common.h"
+#include "intf/ssd1306_interface.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup LCD_DISPLAY_API DISPLAYS: several displays at a time
+ * @{
+ *
+ * @brief Switches the library between displays.
+ *
+ * @details All draw functions work on the display set up last. A display instance
+ *          keeps the interface, lcd callbacks, color, cursor and font of one display
+ *          and loads them while the display is in use. Each display needs its own
+ *          bus, an i2c oled and a spi lcd for example, the platform keeps one state
+ *          per bus type.
+ *
+ * @code
+ *  static ssd1306_display_t oled, tft;
+ *
+ *  ssd1306_displayBegin(&oled);
+ *  ssd1306_128x64_i2c_init();
+ *  ssd1306_displayEnd(&oled);
+ *  ssd1306_displayBegin(&tft);
+ *  ili9341_240x320_spi_init(-1, -1, -1);
+ *  ssd1306_displayEnd(&tft);
+ *
+ *  // in any task
+ *  ssd1306_displayBegin(&oled);
+ *  ssd1306_printFixed(0, 8, "Ready", STYLE_NORMAL);
+ *  ssd1306_displayEnd(&oled);
+ * @endcode
+ */
+
+/** State of one display */
+typedef struct
+{
+    ssd1306_interface_t intf;
+    ssd1306_lcd_t lcd;
+    uint16_t color;
+    lcduint_t cursor_x;
+    lcduint_t cursor_y;
+    SFixedFontInfo font;
+    void (*get_char_bitmap)(uint16_t unicode, SCharInfo *info);
+    uint8_t invert_byte;
+    const uint8_t *font6x8;
+    int8_t spi_cs;
+    int8_t spi_dc;
+    uint32_t spi_clock;
+    /** set by ssd1306_displayEnd(), zero the structure before first use */
+    uint8_t valid;
+} ssd1306_display_t;
+
+/**
+ * Takes the library for the calling task and loads the display. The state
+ * used by the global api is kept aside until ssd1306_displayEnd(), so code
+ * not using instances keeps its display. Calls do not nest.
+ *
+ * @param display - display to draw on. Not yet initialized display only takes
+ *        the library, so that the display can be initialized as usual.
+ */
+void ssd1306_displayBegin(ssd1306_display_t *display);
+
+/**
+ * Stores the display state, restores the state of the global api and lets
+ * other tasks use the library.
+ *
+ * @param display - display passed to ssd1306_displayBegin()
+ */
+void ssd1306_displayEnd(ssd1306_display_t *display);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SSD1306_DISPLAY_H_
@@ -115,6 +115,16 @@ void ssd1306_setFixedFont(const uint8_t * progmemFont);
  */
 void ssd1306_setFreeFont(const uint8_t * progmemFont);
 
+/**
+ * Function allows to set indexed font for the library.
+ * Indexed fonts keep a block directory sorted by unicode, and a jump table over
+ * the range of each block, so a glyph is found by binary search in the font itself.
+ * Use them for large sparse char sets, like CJK, generated with "-f indexed".
+ * A secondary font, set by ssd1306_setSecondaryFont(), must be indexed too.
+ * @param progmemFont - font to setup located in Flash area
+ */
+void ssd1306_setIndexedFont(const uint8_t * progmemFont);
+
 /**
  * Function allows sets secondary font for specific language.
  * Use it if you want to use additional font to combine capabilities of
@@ -124,6 +134,31 @@ void ssd1306_setFreeFont(const uint8_t * progmemFont);
  */
 void ssd1306_setSecondaryFont(const uint8_t * progmemUnicode);
 
+#ifndef SSD1306_GLYPH_DIRECTORY_SIZE
+/**
+ * Unicode blocks of each font table kept sorted in RAM for binary search.
+ * Blocks past the limit are still found, the old way, by walking the table.
+ */
+#define SSD1306_GLYPH_DIRECTORY_SIZE  8
+#endif
+
+#ifndef SSD1306_GLYPH_CACHE_SIZE
+/**
+ * Recently drawn chars, whose SCharInfo ssd1306_getCharBitmap() returns
+ * without looking into the font. Define to 0 to save RAM.
+ */
+#define SSD1306_GLYPH_CACHE_SIZE      8
+#endif
+
+#ifndef SSD1306_FONT_RAM_SIZE
+/**
+ * Bytes of RAM the ascii glyphs of a fixed font are copied to by ssd1306_setFixedFont(),
+ * so that printing does not read program memory. Fonts that do not fit are read in
+ * place. 0 disables the copy.
+ */
+#define SSD1306_FONT_RAM_SIZE         0
+#endif
+
 /**
  * Function allows to set another font for the library.
  * By default, the font supports only first 128 - 32 ascii chars.
@@ -152,6 +187,45 @@ void ssd1306_setFont6x8(const uint8_t * progmemFont) __attribute__ ((deprecated)
  */
 void ssd1306_getCharBitmap(uint16_t ch, SCharInfo *info);
 
+/**
+ * Reads the next char of a string and its bitmap in the active font.
+ * Ascii chars of a fixed font are taken straight from the font table, other
+ * chars are decoded from utf8 (if enabled) in one call and looked up through
+ * ssd1306_getCharBitmap(). Unlike ssd1306_unicode16FromUtf8(), no decoder state
+ * is kept between calls.
+ *
+ * @param text NULL-terminated text, pointing to the char to read
+ * @param unicode pointer to store the char to, 0 at the end of the text
+ * @param info pointer to SCharInfo structure to fill with char data, NULL if not needed
+ * @returns pointer to the char after the one read
+ */
+const char *ssd1306_nextChar(const char *text, uint16_t *unicode, SCharInfo *info);
+
+/**
+ * Measures text as it prints in the active font.
+ * Lines end at '\n', and also before a char that would not fit in maxWidth.
+ *
+ * @param text NULL-terminated utf8 (if enabled) text to measure
+ * @param factor scale factor, as for ssd1306_printFixedN()
+ * @param maxWidth width to wrap lines at in pixels, 0 to only break lines at '\n'
+ * @param size pointer to STextSize structure to fill
+ */
+void ssd1306_measureText(const char *text, uint8_t factor, lcduint_t maxWidth, STextSize *size);
+
+/**
+ * Breaks text into lines, as ssd1306_measureText() does, and keeps them in layout.
+ * Laying out the same text again in the same font only compares the text, and
+ * does not look up any glyphs.
+ *
+ * @param layout layout to fill, zero it before first use
+ * @param text NULL-terminated utf8 (if enabled) text
+ * @param factor scale factor, as for ssd1306_printFixedN()
+ * @param maxWidth width to wrap lines at in pixels, 0 to only break lines at '\n'
+ * @returns 1 if the lines changed, 0 if the layout was up to date
+ * @note Text longer than SSD1306_LAYOUT_TEXT_SIZE is cut, and laid out again every time.
+ */
+uint8_t ssd1306_layoutText(STextLayout *layout, const char *text, uint8_t factor, lcduint_t maxWidth);
+
 /**
  * Enables utf8 support for all text-functions.
  * @note Unicode-16 only supported in text decoding functions.
@@ -41,6 +41,7 @@ enum
     SSD1306_NEW_FIXED_FORMAT = 0x01,
     SSD1306_NEW_FORMAT       = 0x02,
     SSD1306_SQUIX_FORMAT     = 0x03,
+    SSD1306_INDEXED_FORMAT   = 0x04,
 };
 
 uint16_t ssd1306_color = 0xFFFF;
@@ -50,10 +51,64 @@ SFixedFontInfo s_fixedFont = { {0} };
 #ifdef CONFIG_SSD1306_UNICODE_ENABLE
 uint8_t g_ssd1306_unicode = 1;
 #endif
-static void (*s_ssd1306_getCharBitmap)(uint16_t unicode, SCharInfo *info) = NULL;
+void (*s_ssd1306_getCharBitmap)(uint16_t unicode, SCharInfo *info) = NULL;
+
+/** Unicode block as found in the font table */
+typedef struct
+{
+    uint16_t start_code;
+    uint8_t count;
+    const uint8_t *data;       ///< block data following the record
+} SGlyphBlock;
+
+/** Sorted unicode blocks of a font table */
+typedef struct
+{
+    const uint8_t *table;      ///< table the directory is built for
+    uint8_t type;              ///< font format and glyph size the blocks were read with
+    uint8_t glyph_size;
+    uint8_t count;
+    const uint8_t *rest;       ///< first block that did not fit, NULL if all did
+    SGlyphBlock blocks[SSD1306_GLYPH_DIRECTORY_SIZE];
+} SGlyphDirectory;
+
+/** Primary and secondary table */
+static SGlyphDirectory s_glyphDirectory[2];
+
+#if SSD1306_GLYPH_CACHE_SIZE > 0
+typedef struct
+{
+    uint16_t unicode;
+    SCharInfo info;
+} SGlyphCacheEntry;
+
+/** Most recently used first */
+static struct
+{
+    void (*getCharBitmap)(uint16_t unicode, SCharInfo *info);
+    const uint8_t *primary_table;
+#ifdef CONFIG_SSD1306_UNICODE_ENABLE
+    const uint8_t *secondary_table;
+    uint8_t unicode;
+#endif
+    uint8_t count;
+    SGlyphCacheEntry entries[SSD1306_GLYPH_CACHE_SIZE];
+} s_glyphCache;
+#endif
+
+#if SSD1306_FONT_RAM_SIZE > 0
+/** Ascii glyphs of the fixed font, from ssd1306_setFixedFont() */
+static struct
+{
+    const uint8_t *table;      ///< table the glyphs were copied from, NULL if they did not fit
+    uint8_t chars;
+    uint8_t data[SSD1306_FONT_RAM_SIZE];
+} s_fontRam;
+#endif
 
 static const uint8_t *ssd1306_getCharGlyph(char ch);
 static const uint8_t *ssd1306_getU16CharGlyph(uint16_t unicode);
+static void __ssd1306_oldFormatGetBitmap(uint16_t unicode, SCharInfo *info);
 
 lcduint_t      ssd1306_displayHeight()
 {
@@ -78,6 +133,101 @@ static const uint8_t * ssd1306_readUnicodeRecord(SUnicodeBlockRecord *r, const u
     return (r->count > 0) ? (&p[3]): NULL;
 }
 
+static const uint8_t *ssd1306_readGlyphBlock(SGlyphBlock *b, const uint8_t *p)
+{
+    SUnicodeBlockRecord r;
+    const uint8_t *data = ssd1306_readUnicodeRecord( &r, p );
+    if (!data)
+    {
+        return NULL;
+    }
+    b->start_code = r.start_code;
+    b->count = r.count;
+    b->data = data;
+    if (s_fixedFont.h.type == SSD1306_NEW_FORMAT)
+    {
+        // jump table (offset|offset|width|height), then bitmap size and bitmap data
+        data += r.count * 4;
+        return data + 2 + ((pgm_read_byte(&data[0]) << 8) | (pgm_read_byte(&data[1])));
+    }
+    return data + r.count * s_fixedFont.glyph_size;
+}
+
+static void ssd1306_buildGlyphDirectory(SGlyphDirectory *dir, const uint8_t *table)
+{
+    dir->table = table;
+    dir->type = s_fixedFont.h.type;
+    dir->glyph_size = s_fixedFont.glyph_size;
+    dir->count = 0;
+    dir->rest = NULL;
+    while (table)
+    {
+        SGlyphBlock b;
+        const uint8_t *next = ssd1306_readGlyphBlock( &b, table );
+        if (!next)
+        {
+            break;
+        }
+        if (dir->count == SSD1306_GLYPH_DIRECTORY_SIZE)
+        {
+            dir->rest = table;
+            break;
+        }
+        uint8_t i = dir->count++;
+        while ( (i > 0) && (dir->blocks[i - 1].start_code > b.start_code) )
+        {
+            dir->blocks[i] = dir->blocks[i - 1];
+            i--;
+        }
+        dir->blocks[i] = b;
+        table = next;
+    }
+}
+
+/**
+ * Looks for the block of the table, index 0 for the primary one, holding unicode.
+ * The directory is rebuilt when the font changed, e.g. by ssd1306_display_begin().
+ */
+static const SGlyphBlock *ssd1306_findGlyphBlock(uint8_t index, const uint8_t *table,
+                                                 uint16_t unicode, SGlyphBlock *b)
+{
+    SGlyphDirectory *dir = &s_glyphDirectory[index];
+    if ( (dir->table != table) || (dir->type != s_fixedFont.h.type) ||
+         (dir->glyph_size != s_fixedFont.glyph_size) )
+    {
+        ssd1306_buildGlyphDirectory( dir, table );
+    }
+    uint8_t lo = 0;
+    uint8_t hi = dir->count;
+    while (lo < hi)
+    {
+        uint8_t mid = (lo + hi) >> 1;
+        const SGlyphBlock *m = &dir->blocks[mid];
+        if ( unicode < m->start_code )
+        {
+            hi = mid;
+        }
+        else if ( unicode >= (m->start_code + m->count) )
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            return m;
+        }
+    }
+    const uint8_t *p = dir->rest;
+    while (p)
+    {
+        p = ssd1306_readGlyphBlock( b, p );
+        if ( p && ( unicode >= b->start_code) && ( unicode < (b->start_code + b->count) ) )
+        {
+            return b;
+        }
+    }
+    return NULL;
+}
+
 
 void ssd1306_setSecondaryFont(const uint8_t * progmemUnicode)
 {
@@ -87,31 +237,256 @@ void ssd1306_setSecondaryFont(const uint8_t * progmemUnicode)
     {
         s_fixedFont.secondary_table += sizeof(SFontHeaderRecord);
     }
+    if (s_fixedFont.h.type != SSD1306_INDEXED_FORMAT)
+    {
+        ssd1306_buildGlyphDirectory( &s_glyphDirectory[1], s_fixedFont.secondary_table );
+    }
 #endif
 }
 
+#if SSD1306_GLYPH_CACHE_SIZE > 0
+static void ssd1306_checkGlyphCache(void)
+{
+    if ( (s_glyphCache.getCharBitmap == s_ssd1306_getCharBitmap) &&
+#ifdef CONFIG_SSD1306_UNICODE_ENABLE
+         (s_glyphCache.secondary_table == s_fixedFont.secondary_table) &&
+         (s_glyphCache.unicode == g_ssd1306_unicode) &&
+#endif
+         (s_glyphCache.primary_table == s_fixedFont.primary_table) )
+    {
+        return;
+    }
+    s_glyphCache.getCharBitmap = s_ssd1306_getCharBitmap;
+    s_glyphCache.primary_table = s_fixedFont.primary_table;
+#ifdef CONFIG_SSD1306_UNICODE_ENABLE
+    s_glyphCache.secondary_table = s_fixedFont.secondary_table;
+    s_glyphCache.unicode = g_ssd1306_unicode;
+#endif
+    s_glyphCache.count = 0;
+}
+#endif
+
 void ssd1306_getCharBitmap(uint16_t unicode, SCharInfo *info)
 {
-    return s_ssd1306_getCharBitmap( unicode, info );
+#if SSD1306_GLYPH_CACHE_SIZE > 0
+    if (!info)
+    {
+        return;
+    }
+    ssd1306_checkGlyphCache();
+    uint8_t i = 0;
+    while ( (i < s_glyphCache.count) && (s_glyphCache.entries[i].unicode != unicode) )
+    {
+        i++;
+    }
+    if ( i < s_glyphCache.count )
+    {
+        *info = s_glyphCache.entries[i].info;
+    }
+    else
+    {
+        s_ssd1306_getCharBitmap( unicode, info );
+        if ( s_glyphCache.count < SSD1306_GLYPH_CACHE_SIZE )
+        {
+            s_glyphCache.count++;
+        }
+        i = s_glyphCache.count - 1;
+    }
+    // move the char to the front, dropping the least recently used one on a miss
+    for (; i > 0; i--)
+    {
+        s_glyphCache.entries[i] = s_glyphCache.entries[i - 1];
+    }
+    s_glyphCache.entries[0].unicode = unicode;
+    s_glyphCache.entries[0].info = *info;
+#else
+    s_ssd1306_getCharBitmap( unicode, info );
+#endif
+}
+
+/**
+ * Fills info for an ascii char without the font callback and the cache, if the
+ * active font is a fixed one holding it.
+ * @return 0 if the char must be looked up the usual way
+ */
+static inline uint8_t ssd1306_getAsciiBitmap(uint8_t ch, SCharInfo *info)
+{
+    if ( (s_ssd1306_getCharBitmap != __ssd1306_oldFormatGetBitmap) || (ch < s_fixedFont.h.ascii_offset) )
+    {
+        return 0;
+    }
+#ifdef CONFIG_SSD1306_UNICODE_ENABLE
+    // other fixed fonts keep ascii in a unicode block, which is searched in utf8 mode
+    if ( g_ssd1306_unicode && (s_fixedFont.h.type != SSD1306_OLD_FIXED_FORMAT) )
+    {
+        return 0;
+    }
+#endif
+    info->width = s_fixedFont.h.width;
+    info->height = s_fixedFont.h.height;
+    info->spacing = 0;
+    info->glyph = ssd1306_getCharGlyph( ch );
+    return 1;
+}
+
+const char *ssd1306_nextChar(const char *text, uint16_t *unicode, SCharInfo *info)
+{
+    uint8_t ch = *text;
+    if (!ch)
+    {
+        *unicode = 0;
+        return text;
+    }
+    text++;
+    if (ch < 0x80)
+    {
+        *unicode = ch;
+        if ( info && !ssd1306_getAsciiBitmap( ch, info ) )
+        {
+            ssd1306_getCharBitmap( ch, info );
+        }
+        return text;
+    }
+    uint16_t code = ch;
+#ifdef CONFIG_SSD1306_UNICODE_ENABLE
+    if ( ch >= 0xc0 )
+    {
+        // same decoding as ssd1306_unicode16FromUtf8(), but the whole sequence at once,
+        // never reading past the end of a cut sequence
+        uint8_t more = (ch >= 0xe0) ? 2 : 1;
+        code = ch & ((ch >= 0xe0) ? 0x0f : 0x1f);
+        for (; more && *text; more--)
+        {
+            code = (code << 6) | (*text++ & 0x3f);
+        }
+    }
+#endif
+    *unicode = code;
+    if (info)
+    {
+        ssd1306_getCharBitmap( code, info );
+    }
+    return text;
+}
+
+static void ssd1306_endTextLine(STextSize *size, STextLayout *layout,
+                                uint16_t start, uint16_t len, lcduint_t width)
+{
+    // a layout keeps lines until the first one that does not fit
+    if ( layout && (layout->size.lines == size->lines) && (size->lines < SSD1306_LAYOUT_MAX_LINES) &&
+         (start + len < SSD1306_LAYOUT_TEXT_SIZE) )
+    {
+        layout->starts[size->lines] = start;
+        layout->lengths[size->lines] = len;
+        layout->widths[size->lines] = width;
+        layout->size.lines++;
+        if (width > layout->size.width)
+        {
+            layout->size.width = width;
+        }
+    }
+    if (width > size->width)
+    {
+        size->width = width;
+    }
+    size->lines++;
+}
+
+static void ssd1306_breakText(const char *text, uint8_t factor, lcduint_t maxWidth,
+                              STextSize *size, STextLayout *layout)
+{
+    const char *line = text;
+    const char *p = text;
+    lcduint_t width = 0;
+    size->width = 0;
+    size->lines = 0;
+    for (;;)
+    {
+        uint16_t unicode;
+        SCharInfo char_info;
+        const char *next = ssd1306_nextChar( p, &unicode, (*p == '\n') ? NULL : &char_info );
+        lcduint_t char_width = 0;
+        if ( unicode && (unicode != '\n') )
+        {
+            char_width = (char_info.width + char_info.spacing) << factor;
+        }
+        if ( (unicode == '\n') || ( (p != line) && ( !unicode || (maxWidth && (width + char_width > maxWidth)) ) ) )
+        {
+            ssd1306_endTextLine(size, layout, line - text, p - line, width);
+            width = 0;
+            line = (unicode == '\n') ? next : p;
+        }
+        if (!unicode)
+        {
+            break;
+        }
+        width += char_width;
+        p = next;
+    }
+    size->height = size->lines * (s_fixedFont.h.height << factor);
+}
+
+void ssd1306_measureText(const char *text, uint8_t factor, lcduint_t maxWidth, STextSize *size)
+{
+    ssd1306_breakText(text, factor, maxWidth, size, NULL);
+}
+
+uint8_t ssd1306_layoutText(STextLayout *layout, const char *text, uint8_t factor, lcduint_t maxWidth)
+{
+    if ( (layout->font == s_fixedFont.primary_table) &&
+#ifdef CONFIG_SSD1306_UNICODE_ENABLE
+         (layout->secondary_font == s_fixedFont.secondary_table) &&
+#endif
+         (layout->factor == factor) && (layout->max_width == maxWidth) &&
+         (strlen(text) < SSD1306_LAYOUT_TEXT_SIZE) && !strcmp(layout->text, text) )
+    {
+        return 0;
+    }
+    STextSize size;
+    strncpy(layout->text, text, SSD1306_LAYOUT_TEXT_SIZE - 1);
+    layout->text[SSD1306_LAYOUT_TEXT_SIZE - 1] = '\0';
+    layout->size.width = 0;
+    layout->size.lines = 0;
+    ssd1306_breakText(text, factor, maxWidth, &size, layout);
+    layout->size.height = layout->size.lines * (s_fixedFont.h.height << factor);
+    layout->factor = factor;
+    layout->max_width = maxWidth;
+    layout->font = s_fixedFont.primary_table;
+#ifdef CONFIG_SSD1306_UNICODE_ENABLE
+    layout->secondary_font = s_fixedFont.secondary_table;
+#endif
+    return 1;
 }
 
 uint16_t ssd1306_unicode16FromUtf8(uint8_t ch)
 {
 #ifdef CONFIG_SSD1306_UNICODE_ENABLE
     static uint16_t unicode = 0;
+    static uint8_t more = 0;
     ch &= 0x000000FF;
-    if (!unicode)
+    if (!more)
     {
+        // 3-byte sequences cover the rest of the BMP, CJK included
+        if ( ch >= 0xe0 )
+        {
+            unicode = ch & 0x0f;
+            more = 2;
+            return SSD1306_MORE_CHARS_REQUIRED;
+        }
         if ( ch >= 0xc0 )
         {
-            unicode = ch;
+            unicode = ch & 0x1f;
+            more = 1;
             return SSD1306_MORE_CHARS_REQUIRED;
         }
         return ch;
     }
-    uint16_t code = ((unicode & 0x1f) << 6) | (ch & 0x3f);
-    unicode = 0;
-    return code;
+    unicode = (unicode << 6) | (ch & 0x3f);
+    if (--more)
+    {
+        return SSD1306_MORE_CHARS_REQUIRED;
+    }
+    return unicode;
 #else
     return ch;
 #endif
@@ -141,36 +516,28 @@ void ssd1306_enableAsciiMode(void)
 
 static const uint8_t *ssd1306_getCharGlyph(char ch)
 {
+#if SSD1306_FONT_RAM_SIZE > 0
+    int16_t index = ch - s_fixedFont.h.ascii_offset;
+    if ( (s_fontRam.table == s_fixedFont.primary_table) && (index >= 0) && (index < s_fontRam.chars) )
+    {
+        return &s_fontRam.data[ index * s_fixedFont.glyph_size ];
+    }
+#endif
      return &s_fixedFont.primary_table[ (ch - s_fixedFont.h.ascii_offset) *
                                         s_fixedFont.glyph_size +
                                         (s_fixedFont.h.type == 0x01 ? sizeof(SUnicodeBlockRecord) : 0) ];
 }
 
-static const uint8_t *ssd1306_searchCharGlyph(const uint8_t * unicode_table, uint16_t unicode)
+static const uint8_t *ssd1306_searchCharGlyph(uint8_t index, const uint8_t * unicode_table, uint16_t unicode)
 {
-    SUnicodeBlockRecord r;
-    const uint8_t *data = unicode_table;
-    // looking for required unicode table
-    while (1)
-    {
-        ssd1306_readUnicodeRecord( &r, data );
-        if (r.count == 0)
-        {
-            break;
-        }
-        data += sizeof(SUnicodeBlockRecord);
-        if ( ( unicode >= r.start_code) && ( unicode < (r.start_code + r.count) ) )
-        {
-            break;
-        }
-        data += r.count * s_fixedFont.glyph_size;
-    }
-    if (r.count == 0)
+    SGlyphBlock found;
+    const SGlyphBlock *b = ssd1306_findGlyphBlock( index, unicode_table, unicode, &found );
+    if (!b)
     {
         // Sorry, no glyph found for the specified character
         return NULL;
     }
-    return &data[ (unicode - r.start_code) * s_fixedFont.glyph_size ];
+    return &b->data[ (unicode - b->start_code) * s_fixedFont.glyph_size ];
 }
 
 static const uint8_t *ssd1306_getU16CharGlyph(uint16_t unicode)
@@ -185,11 +552,11 @@ static const uint8_t *ssd1306_getU16CharGlyph(uint16_t unicode)
         }
         if (s_fixedFont.primary_table)
         {
-            glyph = ssd1306_searchCharGlyph( s_fixedFont.primary_table, unicode );
+            glyph = ssd1306_searchCharGlyph( 0, s_fixedFont.primary_table, unicode );
         }
         if (!glyph && s_fixedFont.secondary_table)
         {
-            glyph = ssd1306_searchCharGlyph( s_fixedFont.secondary_table, unicode );
+            glyph = ssd1306_searchCharGlyph( 1, s_fixedFont.secondary_table, unicode );
         }
         if (!glyph)
         {
@@ -215,6 +582,34 @@ static void __ssd1306_oldFormatGetBitmap(uint16_t unicode, SCharInfo *info)
     }
 }
 
+#if SSD1306_FONT_RAM_SIZE > 0
+static void ssd1306_copyFontToRam(void)
+{
+    const uint8_t *glyphs = s_fixedFont.primary_table;
+    uint16_t chars = (s_fixedFont.h.ascii_offset < 128) ? (128 - s_fixedFont.h.ascii_offset) : 0;
+    if ( s_fixedFont.h.type == 0x01 )
+    {
+        // ascii codes index the first unicode block
+        SUnicodeBlockRecord r;
+        ssd1306_readUnicodeRecord( &r, glyphs );
+        glyphs += sizeof(SUnicodeBlockRecord);
+        chars = r.count;
+    }
+    uint16_t size = chars * s_fixedFont.glyph_size;
+    s_fontRam.table = NULL;
+    if ( !size || (size > SSD1306_FONT_RAM_SIZE) )
+    {
+        return;
+    }
+    for (uint16_t i = 0; i < size; i++)
+    {
+        s_fontRam.data[i] = pgm_read_byte( &glyphs[i] );
+    }
+    s_fontRam.chars = chars;
+    s_fontRam.table = s_fixedFont.primary_table;
+}
+#endif
+
 void ssd1306_setFixedFont(const uint8_t * progmemFont)
 {
     s_fixedFont.h.type   = pgm_read_byte( &progmemFont[0] );
@@ -228,6 +623,9 @@ void ssd1306_setFixedFont(const uint8_t * progmemFont)
 #ifdef CONFIG_SSD1306_UNICODE_ENABLE
     s_fixedFont.secondary_table = NULL;
 #endif
+#if SSD1306_FONT_RAM_SIZE > 0
+    ssd1306_copyFontToRam();
+#endif
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -238,52 +636,31 @@ static void __ssd1306_newFormatGetBitmap(uint16_t unicode, SCharInfo *info)
 {
     if (info)
     {
-        uint8_t table_index = 0;
-        const uint8_t *data = s_fixedFont.primary_table;
-        while (data)
-        {
-            SUnicodeBlockRecord r;
-            data = ssd1306_readUnicodeRecord( &r, data );
-            if (!data)
-            {
+        SGlyphBlock found;
+        const SGlyphBlock *b = ssd1306_findGlyphBlock( 0, s_fixedFont.primary_table, unicode, &found );
 #ifdef CONFIG_SSD1306_UNICODE_ENABLE
-                if ( table_index == 0 )
-                {
-                    table_index++;
-                    data = s_fixedFont.secondary_table;
-                    continue;
-                }
-#endif
-                break;
-            }
-            /* Check that unicode in the section being processed */
-            if ( ( unicode < r.start_code) || ( unicode >= (r.start_code + r.count) ) )
-            {
-                // skip jump table
-                data += r.count * 4;
-                // skip block bitmap data
-                data += ((pgm_read_byte(&data[0]) << 8) | (pgm_read_byte(&data[1]))) + 2;
-                continue;
-            }
-            /* At this point data points to jump table (offset|offset|bytes|width) */
-            unicode -= r.start_code;
-            data += unicode * 4;
-            uint16_t offset = (pgm_read_byte(&data[0]) << 8) | (pgm_read_byte(&data[1]));
-            uint8_t glyph_width = pgm_read_byte(&data[2]);
-            uint8_t glyph_height = pgm_read_byte(&data[3]);
-            info->width = glyph_width;
-            info->height = glyph_height;
-            info->spacing = glyph_width ? 1 : (s_fixedFont.h.width >> 1);
-            info->glyph = data + (r.count - unicode) * 4 + 2 + offset;
-            break;
+        if (!b)
+        {
+            b = ssd1306_findGlyphBlock( 1, s_fixedFont.secondary_table, unicode, &found );
         }
-        if (!info->glyph)
+#endif
+        if (!b)
         {
             info->width = 0;
             info->height = 0;
             info->spacing = s_fixedFont.h.width >> 1;
             info->glyph = s_fixedFont.primary_table;
+            return;
         }
+        /* At this point data points to jump table (offset|offset|bytes|width) */
+        const uint8_t *data = b->data + (unicode - b->start_code) * 4;
+        uint16_t offset = (pgm_read_byte(&data[0]) << 8) | (pgm_read_byte(&data[1]));
+        uint8_t glyph_width = pgm_read_byte(&data[2]);
+        uint8_t glyph_height = pgm_read_byte(&data[3]);
+        info->width = glyph_width;
+        info->height = glyph_height;
+        info->spacing = glyph_width ? 1 : (s_fixedFont.h.width >> 1);
+        info->glyph = b->data + b->count * 4 + 2 + offset;
     }
 }
 
@@ -299,6 +676,7 @@ void ssd1306_setFreeFont(const uint8_t * progmemFont)
 #ifdef CONFIG_SSD1306_UNICODE_ENABLE
     s_fixedFont.secondary_table = NULL;
 #endif
+    ssd1306_buildGlyphDirectory( &s_glyphDirectory[0], s_fixedFont.primary_table );
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -353,3 +731,87 @@ void ssd1306_setSquixFont(const uint8_t * progmemFont)
     s_fixedFont.secondary_table = NULL;
 #endif
 }
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+/// INDEXED FORMAT
+/// Block directory sorted by unicode, each block with a dense jump table over its range
+
+static uint8_t ssd1306_indexedFormatFind(const uint8_t *table, uint16_t unicode, SCharInfo *info)
+{
+    if (!table)
+    {
+        return 0;
+    }
+    uint16_t lo = 0;
+    uint16_t hi = (pgm_read_byte(&table[0]) << 8) | pgm_read_byte(&table[1]);
+    while (lo < hi)
+    {
+        uint16_t mid = (lo + hi) >> 1;
+        /* directory entry: unicode(2B)|count(2B)|block offset(4B) */
+        const uint8_t *e = table + 2 + mid * 8;
+        uint16_t start_code = (pgm_read_byte(&e[0]) << 8) | pgm_read_byte(&e[1]);
+        uint16_t count = (pgm_read_byte(&e[2]) << 8) | pgm_read_byte(&e[3]);
+        if ( unicode < start_code )
+        {
+            hi = mid;
+        }
+        else if ( (uint16_t)(unicode - start_code) >= count )
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            uint32_t block = ((uint32_t)pgm_read_byte(&e[4]) << 24) | ((uint32_t)pgm_read_byte(&e[5]) << 16) |
+                             ((uint16_t)pgm_read_byte(&e[6]) << 8) | pgm_read_byte(&e[7]);
+            /* jump table (offset|offset|width|height), then bitmap data of the block */
+            const uint8_t *data = table + block + (unicode - start_code) * 4;
+            uint16_t offset = (pgm_read_byte(&data[0]) << 8) | pgm_read_byte(&data[1]);
+            if ( offset == 0xFFFF )
+            {
+                // gap the generator filled to save a directory entry
+                return 0;
+            }
+            info->width = pgm_read_byte(&data[2]);
+            info->height = pgm_read_byte(&data[3]);
+            info->spacing = info->width ? 1 : (s_fixedFont.h.width >> 1);
+            info->glyph = table + block + (uint32_t)count * 4 + offset;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void __ssd1306_indexedFormatGetBitmap(uint16_t unicode, SCharInfo *info)
+{
+    if (info)
+    {
+        if ( ssd1306_indexedFormatFind( s_fixedFont.primary_table, unicode, info ) )
+        {
+            return;
+        }
+#ifdef CONFIG_SSD1306_UNICODE_ENABLE
+        if ( ssd1306_indexedFormatFind( s_fixedFont.secondary_table, unicode, info ) )
+        {
+            return;
+        }
+#endif
+        info->width = 0;
+        info->height = 0;
+        info->spacing = s_fixedFont.h.width >> 1;
+        info->glyph = s_fixedFont.primary_table;
+    }
+}
+
+void ssd1306_setIndexedFont(const uint8_t * progmemFont)
+{
+    s_fixedFont.h.type   = pgm_read_byte( &progmemFont[0] );
+    s_fixedFont.h.width  = pgm_read_byte(&progmemFont[1]);
+    s_fixedFont.h.height = pgm_read_byte(&progmemFont[2]);
+    s_fixedFont.h.ascii_offset = pgm_read_byte(&progmemFont[3]);
+    s_fixedFont.primary_table = progmemFont + 4;
+    s_ssd1306_getCharBitmap = __ssd1306_indexedFormatGetBitmap;
+    s_fixedFont.pages = (s_fixedFont.h.height + 7) >> 3;
+#ifdef CONFIG_SSD1306_UNICODE_ENABLE
+    s_fixedFont.secondary_table = NULL;
+#endif
+}
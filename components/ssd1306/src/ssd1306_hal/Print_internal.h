@@ -38,6 +38,7 @@
 
 #include "ssd1306_hal/io.h"
 #include <stdio.h>
+#include <string.h>
 
 /** Implements own Print class for plain AVR and Linux environment */
 class Print
@@ -54,21 +55,42 @@ public:
     virtual size_t write(uint8_t ch) = 0;
 
     /**
-     * Prints string via write()
-     * @param str string to print
+     * Prints a run of chars. The default calls write(uint8_t) for each one,
+     * inherited classes override it to set up once per run.
+     * @param buffer chars to print
+     * @param size number of chars in buffer
      * @return returns number of printed symbols
      */
-    size_t print(const char* str)
+    virtual size_t write(const uint8_t *buffer, size_t size)
     {
         size_t n = 0;
-        while (*str)
+        while (size--)
         {
-            n += write(*str);
-            str++;
+            n += write(*buffer++);
         }
         return n;
     }
 
+    /**
+     * Prints string as one run
+     * @param str string to print
+     * @return returns number of printed symbols
+     */
+    size_t write(const char *str)
+    {
+        return str ? write(reinterpret_cast<const uint8_t *>(str), strlen(str)) : 0;
+    }
+
+    /**
+     * Prints string via write()
+     * @param str string to print
+     * @return returns number of printed symbols
+     */
+    size_t print(const char* str)
+    {
+        return write(str);
+    }
+
     /**
      * Prints number via write()
      * @param n integer to print
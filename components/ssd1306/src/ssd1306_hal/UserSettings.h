@@ -54,6 +54,12 @@
 /** Define this macro if you need to enable TWI I2C module for compilation */
 // #define CONFIG_TWI_I2C_ENABLE
 
+/**
+ * Define this macro to send TWI I2C data from the TWI interrupt in the background.
+ * The library then owns TWI_vect, so the Wire library can not be used with it.
+ */
+// #define CONFIG_TWI_I2C_ISR_ENABLE
+
 /** Define this macro if you need to enable AVR SPI module for compilation */
 // #define CONFIG_AVR_SPI_ENABLE
 
@@ -89,6 +95,22 @@
  */
 #define CONFIG_SSD1306_UNICODE_ENABLE
 
+/**
+ * Define this macro to count the bytes and transactions going through ssd1306_intf,
+ * see ssd1306_intfStatsAttach(). Nothing is compiled in otherwise.
+ */
+#ifndef CONFIG_SSD1306_INTF_STATS_ENABLE
+// #define CONFIG_SSD1306_INTF_STATS_ENABLE
+#endif
+
+/**
+ * Define this macro to record the traffic going through ssd1306_intf as a binary trace,
+ * see ssd1306_intfTraceAttach(). Nothing is compiled in otherwise.
+ */
+#ifndef CONFIG_SSD1306_INTF_TRACE_ENABLE
+// #define CONFIG_SSD1306_INTF_TRACE_ENABLE
+#endif
+
 /**
  * @}
  */
@@ -0,0 +1,135 @@
+/*
+    MIT License
+
+    Copyright (c) 2018, Alexey Dynda
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+/**
+ * @file interface_i2c.h Inlined i2c transport for ESP32
+ */
+
+#ifndef _SSD1306_ESP_INTERFACE_I2C_H_
+#define _SSD1306_ESP_INTERFACE_I2C_H_
+
+#ifdef __cplusplus
+
+#include "ssd1306_hal/io.h"
+#include "driver/i2c.h"
+
+/**
+ * i2c transport resolved at compile time, for DisplaySSD1306 and similar
+ * templates. Bytes are staged in the object and go out with a single
+ * i2c_master_write() on stop(), so send() inlines to a store.
+ * The bus is shared and locked like the one of the C api.
+ *
+ * @tparam BUFFER_SIZE bytes staged per transaction, bytes beyond are sent one by one
+ */
+template <uint16_t BUFFER_SIZE = 1040>
+class InterfaceEspI2C
+{
+public:
+    /** Commands and data are told apart by control bytes */
+    static const bool spi = false;
+
+    /**
+     * @param busId i2c port
+     * @param addr i2c address of the display
+     */
+    InterfaceEspI2C(int8_t busId = I2C_NUM_1, uint8_t addr = 0x3C)
+        : m_bus(busId)
+        , m_addr(addr)
+    {
+    }
+
+    /**
+     * Installs the bus driver unless another device did already.
+     */
+    esp_err_t begin(int8_t sda = 21, int8_t scl = 22, uint32_t clock = 400000)
+    {
+        return ssd1306_platform_i2cBusInit(m_bus, sda, scl, clock);
+    }
+
+    void start()
+    {
+        ssd1306_platform_i2cBusLock(m_bus);
+        m_cmd = i2c_cmd_link_create();
+        i2c_master_start(m_cmd);
+        i2c_master_write_byte(m_cmd, (m_addr << 1) | I2C_MASTER_WRITE, 0x1);
+        m_len = 0;
+        m_linked = false;
+    }
+
+    inline void send(uint8_t data)
+    {
+        if (m_len < BUFFER_SIZE && !m_linked)
+        {
+            m_buffer[m_len++] = data;
+        }
+        else
+        {
+            link();
+            i2c_master_write_byte(m_cmd, data, 0x1);
+        }
+    }
+
+    inline void sendBuffer(const uint8_t *buffer, uint16_t len)
+    {
+        while (len--)
+        {
+            send(*buffer++);
+        }
+    }
+
+    /** D/C goes with control bytes over i2c, nothing to switch */
+    inline void dataMode(uint8_t mode)
+    {
+    }
+
+    void stop()
+    {
+        link();
+        i2c_master_stop(m_cmd);
+        i2c_master_cmd_begin(m_bus, m_cmd, 1000 / portTICK_RATE_MS);
+        i2c_cmd_link_delete(m_cmd);
+        ssd1306_platform_i2cBusUnlock(m_bus);
+    }
+
+private:
+    int8_t m_bus;
+    uint8_t m_addr;
+    i2c_cmd_handle_t m_cmd = nullptr;
+    uint8_t m_buffer[BUFFER_SIZE];
+    uint16_t m_len = 0;
+    bool m_linked = false;
+
+    void link()
+    {
+        // staged bytes must stay untouched until i2c_master_cmd_begin()
+        if (!m_linked && m_len)
+        {
+            i2c_master_write(m_cmd, m_buffer, m_len, 0x1);
+        }
+        m_linked = true;
+    }
+};
+
+#endif
+
+#endif // _SSD1306_ESP_INTERFACE_I2C_H_
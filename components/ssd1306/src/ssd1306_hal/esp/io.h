@@ -53,6 +53,18 @@
 /** The macro is defined when STM32 i2c implementation is available */
 #define CONFIG_PLATFORM_I2C_AVAILABLE
 #define CONFIG_PLATFORM_SPI_AVAILABLE
+/** The macro is defined when display instances are serialized between tasks */
+#define CONFIG_PLATFORM_LOCK_AVAILABLE
+/** The macro is defined when short sections can run protected from other tasks and cores */
+#define CONFIG_PLATFORM_CRITICAL_AVAILABLE
+/** The macro is defined when jobs can be run by a task on the other core */
+#define CONFIG_PLATFORM_WORKER_AVAILABLE
+/** The macro is defined when micros() counts and tasks can sleep until a point in time */
+#define CONFIG_PLATFORM_SLEEP_AVAILABLE
+/** The macro is defined when frame buffers are allocated by the platform */
+#define CONFIG_PLATFORM_FRAME_ALLOC_AVAILABLE
+/** The macro is defined when buttons and encoders are tracked by interrupts and counters */
+#define CONFIG_PLATFORM_INPUTS_AVAILABLE
 
 #ifdef __cplusplus
 extern "C" {
@@ -74,16 +86,130 @@ static inline int  analogRead(int pin)    // analogRead()
 
 uint32_t millis(void);
 
-static inline uint32_t micros(void)       // micros()
-{
-    return 0;
-};
+uint32_t micros(void);
 
 void delay(uint32_t ms);
 
-static inline void delayMicroseconds(uint32_t us)  // delayMicroseconds()
-{
-}
+#if defined(CONFIG_PLATFORM_I2C_AVAILABLE) && defined(CONFIG_PLATFORM_I2C_ENABLE)
+#include "esp_err.h"
+
+/**
+ * Installs the i2c driver of a bus, later calls for the same bus only return
+ * how the first one went. The display and other devices share the bus.
+ */
+esp_err_t ssd1306_platform_i2cBusInit(int8_t busId, int8_t sda, int8_t scl, uint32_t clock);
+
+/**
+ * Changes the clock of an installed bus, for all devices on it.
+ */
+esp_err_t ssd1306_platform_i2cBusClock(int8_t busId, uint32_t clock);
+
+/**
+ * Held by display transactions from start to stop. Take it to run several
+ * transactions of other devices back to back.
+ */
+void ssd1306_platform_i2cBusLock(int8_t busId);
+
+void ssd1306_platform_i2cBusUnlock(int8_t busId);
+
+/**
+ * Writes len bytes to register reg of the device at addr in one transaction.
+ */
+esp_err_t ssd1306_platform_i2cWrite(int8_t busId, uint8_t addr, uint8_t reg, const uint8_t *data, uint16_t len);
+
+/**
+ * Reads len bytes from register reg of the device at addr, the register is
+ * written and read back with a repeated start in one transaction.
+ */
+esp_err_t ssd1306_platform_i2cRead(int8_t busId, uint8_t addr, uint8_t reg, uint8_t *data, uint16_t len);
+#endif
+
+#if defined(CONFIG_PLATFORM_SPI_AVAILABLE) && defined(CONFIG_PLATFORM_SPI_ENABLE)
+/**
+ * Routes the spi bus to other pins through the GPIO matrix, call it before
+ * the display is initialized. -1 keeps the default pin of the bus.
+ */
+void ssd1306_platform_spiSetPins(int8_t sclk, int8_t mosi);
+#endif
+
+/** Taken by ssd1306_displayBegin(), released by ssd1306_displayEnd() */
+void ssd1306_platform_lock(void);
+
+void ssd1306_platform_unlock(void);
+
+/**
+ * Protects a few RAM accesses from other tasks and cores, with interrupts off.
+ * Do not call display functions between enter and exit.
+ */
+void ssd1306_platform_enterCritical(void);
+
+void ssd1306_platform_exitCritical(void);
+
+/**
+ * Allocates a display frame buffer, in PSRAM when CONFIG_SPIRAM_SUPPORT is enabled
+ * and internal memory otherwise. Returns NULL if there is no memory.
+ */
+void *ssd1306_platform_frameAlloc(uint32_t size);
+
+void ssd1306_platform_frameFree(void *frame);
+
+/**
+ * Starts the worker task on the core the caller does not run on, later calls
+ * do nothing. Returns 0 when the worker runs.
+ */
+int ssd1306_platform_workerStart(void);
+
+/**
+ * Queues a job for the worker, jobs run in the order they are posted.
+ * Blocks while the worker queue is full.
+ */
+void ssd1306_platform_workerPost(void (*job)(void *arg), void *arg);
+
+/**
+ * Waits until no more than left of the jobs posted by the caller are still
+ * queued or running. Only one task may post jobs at a time.
+ */
+void ssd1306_platform_workerWait(uint8_t left);
+
+/**
+ * Watches up to 8 buttons with GPIO edge interrupts. A button is pressed while
+ * its pin is at activeLevel, pins of 0 are skipped. Returns 0 on success.
+ */
+int ssd1306_platform_buttonsStart(const uint8_t *pins, uint8_t count, uint8_t activeLevel);
+
+/**
+ * Returns bits of buttons in pin order, that are pressed now or were pressed
+ * since the last call, so short presses between two calls are not lost.
+ */
+uint8_t ssd1306_platform_buttons(void);
+
+/**
+ * Takes the oldest button change from the queue filled by interrupts.
+ * Returns 0 if there is none, state gets the bits of buttons pressed after it.
+ * Changes are dropped while the queue is full. Only one task may take them.
+ */
+int ssd1306_platform_buttonEvent(uint8_t *state);
+
+/**
+ * Counts steps of a KY-040 style encoder with a PCNT unit, both edges of clk
+ * are a step. Returns 0 on success.
+ */
+int ssd1306_platform_encoderStart(uint8_t clk, uint8_t dt);
+
+/**
+ * Returns steps counted since the last call, positive ones are the
+ * direction ky40 polling reports as BUTTON_DOWN.
+ */
+int16_t ssd1306_platform_encoderSteps(void);
+
+/**
+ * Blocks the caller until micros() reaches us, returns at once if it already
+ * has. Wakes up from a one-shot timer rather than the tick, so the wait is
+ * not rounded to the FreeRTOS tick. Only one task may sleep at a time.
+ */
+void ssd1306_platform_sleepUntil(uint32_t us);
+
+void delayMicroseconds(uint32_t us);  // delayMicroseconds()
 
 // !!!  OPTIONAL !!!
 static inline void randomSeed(int seed)   // randomSeed() -  can be skipped
@@ -30,7 +30,14 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "driver/gpio.h"
+#include "esp_timer.h"
+#include "rom/ets_sys.h"
+
+#if defined(CONFIG_PLATFORM_SPI_AVAILABLE) && defined(CONFIG_PLATFORM_SPI_ENABLE)
+static int platform_spi_set_dc(int pin, int level);
+#endif
 
 #if 1
 // TODO: To complete support. Any help is welcome
@@ -41,6 +48,10 @@ int  digitalRead(int pin)   // digitalRead()
 
 void digitalWrite(int pin, int level)  // digitalWrite()
 {
+#if defined(CONFIG_PLATFORM_SPI_AVAILABLE) && defined(CONFIG_PLATFORM_SPI_ENABLE)
+    if (platform_spi_set_dc(pin, level))
+        return;
+#endif
     gpio_set_level(pin, level);
 }
 
@@ -54,7 +65,12 @@ void pinMode(int pin, int mode)
 
 uint32_t millis(void)
 {
-    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+uint32_t micros(void)
+{
+    return (uint32_t)esp_timer_get_time();
 }
 
 void delay(uint32_t ms)     // delay()
@@ -62,6 +78,335 @@ void delay(uint32_t ms)     // delay()
     vTaskDelay(ms / portTICK_PERIOD_MS);
 }
 
+void delayMicroseconds(uint32_t us)
+{
+    // busy wait, for controller timings shorter than a tick
+    ets_delay_us(us);
+}
+
+static SemaphoreHandle_t s_display_lock = NULL;
+static portMUX_TYPE s_display_lock_mux = portMUX_INITIALIZER_UNLOCKED;
+
+void ssd1306_platform_lock(void)
+{
+    // created on first use, displays may be set up from any task
+    if (!s_display_lock)
+    {
+        SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+        portENTER_CRITICAL(&s_display_lock_mux);
+        if (!s_display_lock)
+        {
+            s_display_lock = lock;
+            lock = NULL;
+        }
+        portEXIT_CRITICAL(&s_display_lock_mux);
+        if (lock)
+        {
+            vSemaphoreDelete(lock);
+        }
+    }
+    xSemaphoreTake(s_display_lock, portMAX_DELAY);
+}
+
+void ssd1306_platform_unlock(void)
+{
+    xSemaphoreGive(s_display_lock);
+}
+
+static portMUX_TYPE s_critical_mux = portMUX_INITIALIZER_UNLOCKED;
+
+void ssd1306_platform_enterCritical(void)
+{
+    portENTER_CRITICAL(&s_critical_mux);
+}
+
+void ssd1306_platform_exitCritical(void)
+{
+    portEXIT_CRITICAL(&s_critical_mux);
+}
+
+#define PLATFORM_WORKER_QUEUE_LEN   2
+#define PLATFORM_WORKER_STACK_SIZE  2048
+#define PLATFORM_WORKER_PRIORITY    5
+
+typedef struct
+{
+    void (*job)(void *arg);
+    void *arg;
+} platform_worker_job_t;
+
+static QueueHandle_t s_worker_queue = NULL;
+static SemaphoreHandle_t s_worker_done = NULL;
+static uint8_t s_worker_pending;    // posted and not collected by ssd1306_platform_workerWait()
+
+static void platform_worker_task(void *arg)
+{
+    platform_worker_job_t job;
+    for (;;)
+    {
+        if (xQueueReceive(s_worker_queue, &job, portMAX_DELAY) == pdTRUE)
+        {
+            job.job(job.arg);
+            xSemaphoreGive(s_worker_done);
+        }
+    }
+}
+
+int ssd1306_platform_workerStart(void)
+{
+    if (s_worker_queue)
+    {
+        return 0;
+    }
+    // the queue holds PLATFORM_WORKER_QUEUE_LEN jobs and one more is running
+    s_worker_done = xSemaphoreCreateCounting(PLATFORM_WORKER_QUEUE_LEN + 1, 0);
+    QueueHandle_t queue = xQueueCreate(PLATFORM_WORKER_QUEUE_LEN, sizeof(platform_worker_job_t));
+    if (!s_worker_done || !queue)
+    {
+        goto fail;
+    }
+    s_worker_queue = queue;
+    if (xTaskCreatePinnedToCore(platform_worker_task, "ssd1306_worker", PLATFORM_WORKER_STACK_SIZE,
+                                NULL, PLATFORM_WORKER_PRIORITY, NULL, !xPortGetCoreID()) != pdPASS)
+    {
+        s_worker_queue = NULL;
+        goto fail;
+    }
+    return 0;
+fail:
+    if (queue)
+    {
+        vQueueDelete(queue);
+    }
+    if (s_worker_done)
+    {
+        vSemaphoreDelete(s_worker_done);
+        s_worker_done = NULL;
+    }
+    return -1;
+}
+
+void ssd1306_platform_workerPost(void (*job)(void *arg), void *arg)
+{
+    platform_worker_job_t item = { job, arg };
+    xQueueSend(s_worker_queue, &item, portMAX_DELAY);
+    s_worker_pending++;
+}
+
+void ssd1306_platform_workerWait(uint8_t left)
+{
+    while (s_worker_pending > left)
+    {
+        xSemaphoreTake(s_worker_done, portMAX_DELAY);
+        s_worker_pending--;
+    }
+}
+
+static esp_timer_handle_t s_sleep_timer = NULL;
+static SemaphoreHandle_t s_sleep_wakeup = NULL;
+
+static void platform_sleep_timer_cb(void *arg)
+{
+    xSemaphoreGive(s_sleep_wakeup);
+}
+
+void ssd1306_platform_sleepUntil(uint32_t us)
+{
+    int32_t left = (int32_t)(us - micros());
+    if (left <= 0)
+    {
+        return;
+    }
+    if (!s_sleep_timer)
+    {
+        esp_timer_create_args_t args = {
+            .callback = platform_sleep_timer_cb,
+            .arg = NULL,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "ssd1306_sleep",
+        };
+        s_sleep_wakeup = xSemaphoreCreateBinary();
+        if (!s_sleep_wakeup || esp_timer_create(&args, &s_sleep_timer) != ESP_OK)
+        {
+            if (s_sleep_wakeup)
+            {
+                vSemaphoreDelete(s_sleep_wakeup);
+                s_sleep_wakeup = NULL;
+            }
+            s_sleep_timer = NULL;
+            // falls back to the tick, rounded up so the deadline is not missed
+            vTaskDelay(((left + 999) / 1000 + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS);
+            return;
+        }
+    }
+    esp_timer_start_once(s_sleep_timer, left);
+    xSemaphoreTake(s_sleep_wakeup, portMAX_DELAY);
+}
+
+#include "sdkconfig.h"
+#include "esp_heap_caps.h"
+
+void *ssd1306_platform_frameAlloc(uint32_t size)
+{
+    void *frame = NULL;
+#ifdef CONFIG_SPIRAM_SUPPORT
+    // not DMA capable, spi transport copies frame data to its DMA buffers anyway
+    frame = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#endif
+    if (!frame)
+    {
+        frame = heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    return frame;
+}
+
+void ssd1306_platform_frameFree(void *frame)
+{
+    heap_caps_free(frame);
+}
+
+#include "esp_attr.h"
+#include "soc/gpio_reg.h"
+#include "driver/pcnt.h"
+
+#define PLATFORM_BUTTONS_MAX        8
+#define PLATFORM_BUTTON_EVENTS      16
+#define PLATFORM_ENCODER_UNIT       PCNT_UNIT_0
+
+static uint8_t s_button_pins[PLATFORM_BUTTONS_MAX];
+static uint8_t s_button_count;
+static uint8_t s_button_active;
+static volatile uint8_t s_button_state;
+// words, xtensa has no byte atomics
+static volatile uint32_t s_button_latch;    // presses not returned by ssd1306_platform_buttons() yet
+// single producer ring, the interrupt moves head and the reader moves tail
+static volatile uint8_t s_button_events[PLATFORM_BUTTON_EVENTS];
+static volatile uint32_t s_button_head;
+static volatile uint32_t s_button_tail;
+
+static void IRAM_ATTR platform_button_isr(void *arg)
+{
+    uint32_t in = REG_READ(GPIO_IN_REG);
+    uint32_t in1 = REG_READ(GPIO_IN1_REG) & GPIO_IN1_DATA;
+    uint8_t state = 0;
+    for (uint8_t i = 0; i < s_button_count; i++)
+    {
+        uint8_t pin = s_button_pins[i];
+        uint8_t level = pin < 32 ? (in >> pin) & 1 : (in1 >> (pin - 32)) & 1;
+        if (pin && (level == s_button_active))
+        {
+            state |= 1 << i;
+        }
+    }
+    if (state == s_button_state)
+    {
+        return;
+    }
+    s_button_state = state;
+    __atomic_or_fetch(&s_button_latch, state, __ATOMIC_RELAXED);
+    uint32_t head = s_button_head;
+    uint32_t next = (head + 1) % PLATFORM_BUTTON_EVENTS;
+    if (next != s_button_tail)
+    {
+        s_button_events[head] = state;
+        __atomic_store_n(&s_button_head, next, __ATOMIC_RELEASE);
+    }
+}
+
+int ssd1306_platform_buttonsStart(const uint8_t *pins, uint8_t count, uint8_t activeLevel)
+{
+    if (count > PLATFORM_BUTTONS_MAX)
+    {
+        return -1;
+    }
+    esp_err_t err = gpio_install_isr_service(0);
+    // installed already by someone else is fine
+    if ((err != ESP_OK) && (err != ESP_ERR_INVALID_STATE))
+    {
+        return -1;
+    }
+    s_button_count = 0;
+    s_button_active = activeLevel ? 1 : 0;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        s_button_pins[i] = pins[i];
+    }
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (!pins[i])
+        {
+            continue;
+        }
+        gpio_set_direction(pins[i], GPIO_MODE_INPUT);
+        gpio_set_intr_type(pins[i], GPIO_INTR_ANYEDGE);
+        if (gpio_isr_handler_add(pins[i], platform_button_isr, NULL) != ESP_OK)
+        {
+            return -1;
+        }
+    }
+    s_button_count = count;
+    platform_button_isr(NULL);
+    return 0;
+}
+
+uint8_t ssd1306_platform_buttons(void)
+{
+    return s_button_state | __atomic_exchange_n(&s_button_latch, 0, __ATOMIC_RELAXED);
+}
+
+int ssd1306_platform_buttonEvent(uint8_t *state)
+{
+    uint32_t tail = s_button_tail;
+    if (tail == __atomic_load_n(&s_button_head, __ATOMIC_ACQUIRE))
+    {
+        return 0;
+    }
+    *state = s_button_events[tail];
+    __atomic_store_n(&s_button_tail, (tail + 1) % PLATFORM_BUTTON_EVENTS, __ATOMIC_RELEASE);
+    return 1;
+}
+
+static int16_t s_encoder_last;
+
+int ssd1306_platform_encoderStart(uint8_t clk, uint8_t dt)
+{
+    pcnt_config_t config = {
+        .pulse_gpio_num = clk,
+        .ctrl_gpio_num = dt,
+        // rising clk counts down while dt is high, falling clk counts up
+        .lctrl_mode = PCNT_MODE_REVERSE,
+        .hctrl_mode = PCNT_MODE_KEEP,
+        .pos_mode = PCNT_COUNT_DEC,
+        .neg_mode = PCNT_COUNT_INC,
+        .counter_h_lim = INT16_MAX,
+        .counter_l_lim = INT16_MIN,
+        .unit = PLATFORM_ENCODER_UNIT,
+        .channel = PCNT_CHANNEL_0,
+    };
+    if (pcnt_unit_config(&config) != ESP_OK)
+    {
+        return -1;
+    }
+    // contact bounce is shorter than the longest filter, 1023 APB cycles
+    pcnt_set_filter_value(PLATFORM_ENCODER_UNIT, 1023);
+    pcnt_filter_enable(PLATFORM_ENCODER_UNIT);
+    pcnt_counter_pause(PLATFORM_ENCODER_UNIT);
+    pcnt_counter_clear(PLATFORM_ENCODER_UNIT);
+    pcnt_counter_resume(PLATFORM_ENCODER_UNIT);
+    s_encoder_last = 0;
+    return 0;
+}
+
+int16_t ssd1306_platform_encoderSteps(void)
+{
+    // the counter is not cleared, so no step is lost between reading and clearing
+    int16_t count = 0;
+    pcnt_get_counter_value(PLATFORM_ENCODER_UNIT, &count);
+    int16_t steps = count - s_encoder_last;
+    s_encoder_last = count;
+    return steps;
+}
+
 #endif
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -69,50 +414,209 @@ void delay(uint32_t ms)     // delay()
 #if defined(CONFIG_PLATFORM_I2C_AVAILABLE) && defined(CONFIG_PLATFORM_I2C_ENABLE)
 
 #include <stdio.h>
+#include "sdkconfig.h"
 #include "driver/i2c.h"
 
+#ifdef CONFIG_OLED_I2C_CLOCK_HZ
+#define PLATFORM_I2C_CLOCK_HZ       CONFIG_OLED_I2C_CLOCK_HZ
+#define PLATFORM_I2C_SDA            CONFIG_OLED_I2C_SDA
+#define PLATFORM_I2C_SCL            CONFIG_OLED_I2C_SCL
+#else
+#define PLATFORM_I2C_CLOCK_HZ       400000
+#define PLATFORM_I2C_SDA            21
+#define PLATFORM_I2C_SCL            22
+#endif
+
+// Bytes staged per transaction, enough for a full 128x64 frame and its control byte.
+// Each i2c_master_write_byte() allocates a command link node, so the staged bytes
+// go in with a single i2c_master_write(), which only keeps a pointer to them.
+#define PLATFORM_I2C_BUFFER_SIZE    1040
+
 static uint8_t s_i2c_addr = 0x3C;
 static int8_t s_bus_id;
 
 static i2c_cmd_handle_t s_cmd_handle;
+static uint8_t s_i2c_buffer[PLATFORM_I2C_BUFFER_SIZE];
+static uint16_t s_i2c_buffer_len;
+static uint8_t s_i2c_buffer_linked;
+
+// The driver is installed once per bus, every device on it shares the lock
+static SemaphoreHandle_t s_i2c_bus_locks[I2C_NUM_MAX];
+static uint8_t s_i2c_bus_installed[I2C_NUM_MAX];
+static portMUX_TYPE s_i2c_bus_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static SemaphoreHandle_t platform_i2c_bus_lock(int8_t busId)
+{
+    // created on first use, a device on the bus may show up in any task
+    if (!s_i2c_bus_locks[busId])
+    {
+        SemaphoreHandle_t lock = xSemaphoreCreateRecursiveMutex();
+        portENTER_CRITICAL(&s_i2c_bus_mux);
+        if (!s_i2c_bus_locks[busId])
+        {
+            s_i2c_bus_locks[busId] = lock;
+            lock = NULL;
+        }
+        portEXIT_CRITICAL(&s_i2c_bus_mux);
+        if (lock)
+        {
+            vSemaphoreDelete(lock);
+        }
+    }
+    return s_i2c_bus_locks[busId];
+}
+
+void ssd1306_platform_i2cBusLock(int8_t busId)
+{
+    xSemaphoreTakeRecursive(platform_i2c_bus_lock(busId), portMAX_DELAY);
+}
+
+void ssd1306_platform_i2cBusUnlock(int8_t busId)
+{
+    xSemaphoreGiveRecursive(s_i2c_bus_locks[busId]);
+}
+
+esp_err_t ssd1306_platform_i2cBusInit(int8_t busId, int8_t sda, int8_t scl, uint32_t clock)
+{
+    esp_err_t ret = ESP_OK;
+
+    ssd1306_platform_i2cBusLock(busId);
+    if (!s_i2c_bus_installed[busId])
+    {
+        i2c_config_t conf;
+        conf.mode = I2C_MODE_MASTER;
+        conf.sda_io_num = sda;
+        conf.sda_pullup_en = GPIO_PULLUP_ENABLE;
+        conf.scl_io_num = scl;
+        conf.scl_pullup_en = GPIO_PULLUP_ENABLE;
+        conf.master.clk_speed = clock;
+        ret = i2c_param_config(busId, &conf);
+        if (ret == ESP_OK)
+        {
+            ret = i2c_driver_install(busId, conf.mode, 0, 0, 0);
+        }
+        s_i2c_bus_installed[busId] = ret == ESP_OK;
+    }
+    ssd1306_platform_i2cBusUnlock(busId);
+    return ret;
+}
+
+esp_err_t ssd1306_platform_i2cBusClock(int8_t busId, uint32_t clock)
+{
+    esp_err_t ret = ESP_ERR_INVALID_STATE;
+
+    if (!clock)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // SCL high and low periods in APB cycles, as i2c_param_config() sets them
+    int half_cycle = I2C_APB_CLK_FREQ / clock / 2;
+    ssd1306_platform_i2cBusLock(busId);
+    if (s_i2c_bus_installed[busId])
+    {
+        ret = i2c_set_period(busId, half_cycle, half_cycle);
+    }
+    ssd1306_platform_i2cBusUnlock(busId);
+    return ret;
+}
+
+esp_err_t ssd1306_platform_i2cWrite(int8_t busId, uint8_t addr, uint8_t reg, const uint8_t *data, uint16_t len)
+{
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, ( addr << 1 ) | I2C_MASTER_WRITE, 0x1);
+    i2c_master_write_byte(cmd, reg, 0x1);
+    i2c_master_write(cmd, (uint8_t *)data, len, 0x1);
+    i2c_master_stop(cmd);
+    // waits for a display transaction that is being staged
+    ssd1306_platform_i2cBusLock(busId);
+    esp_err_t ret = i2c_master_cmd_begin(busId, cmd, 1000 / portTICK_RATE_MS);
+    ssd1306_platform_i2cBusUnlock(busId);
+    i2c_cmd_link_delete(cmd);
+    return ret;
+}
+
+esp_err_t ssd1306_platform_i2cRead(int8_t busId, uint8_t addr, uint8_t reg, uint8_t *data, uint16_t len)
+{
+    if (!len)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, ( addr << 1 ) | I2C_MASTER_WRITE, 0x1);
+    i2c_master_write_byte(cmd, reg, 0x1);
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, ( addr << 1 ) | I2C_MASTER_READ, 0x1);
+    i2c_master_read(cmd, data, len, I2C_MASTER_LAST_NACK);
+    i2c_master_stop(cmd);
+    ssd1306_platform_i2cBusLock(busId);
+    esp_err_t ret = i2c_master_cmd_begin(busId, cmd, 1000 / portTICK_RATE_MS);
+    ssd1306_platform_i2cBusUnlock(busId);
+    i2c_cmd_link_delete(cmd);
+    return ret;
+}
 
 static void platform_i2c_start(void)
 {
     // ... Open i2c channel for your device with specific s_i2c_addr
+    // held until stop, the command link and the staged bytes are shared
+    ssd1306_platform_i2cBusLock(s_bus_id);
     s_cmd_handle = i2c_cmd_link_create();
     i2c_master_start(s_cmd_handle);
     i2c_master_write_byte(s_cmd_handle, ( s_i2c_addr << 1 ) | I2C_MASTER_WRITE, 0x1);
+    s_i2c_buffer_len = 0;
+    s_i2c_buffer_linked = 0;
+}
+
+static void platform_i2c_link_buffer(void)
+{
+    // staged bytes must stay untouched until i2c_master_cmd_begin()
+    if (s_i2c_buffer_len && !s_i2c_buffer_linked)
+    {
+        i2c_master_write(s_cmd_handle, s_i2c_buffer, s_i2c_buffer_len, 0x1);
+    }
+    s_i2c_buffer_linked = 1;
 }
 
 static void platform_i2c_stop(void)
 {
     // ... Complete i2c communication
+    platform_i2c_link_buffer();
     i2c_master_stop(s_cmd_handle);
     /*esp_err_t ret =*/ i2c_master_cmd_begin(s_bus_id, s_cmd_handle, 1000 / portTICK_RATE_MS);
     i2c_cmd_link_delete(s_cmd_handle);
+    ssd1306_platform_i2cBusUnlock(s_bus_id);
+}
+
+static void platform_i2c_send_buffer(const uint8_t *data, uint16_t len)
+{
+    // ... Send len bytes to i2c communication channel here
+    if (!s_i2c_buffer_linked && s_i2c_buffer_len + len <= PLATFORM_I2C_BUFFER_SIZE)
+    {
+        memcpy(s_i2c_buffer + s_i2c_buffer_len, data, len);
+        s_i2c_buffer_len += len;
+        return;
+    }
+    // longer transactions keep what is staged and go on byte by byte
+    platform_i2c_link_buffer();
+    while (len--)
+    {
+        i2c_master_write_byte(s_cmd_handle, *data, 0x1);
+        data++;
+    }
 }
 
 static void platform_i2c_send(uint8_t data)
 {
     // ... Send byte to i2c communication channel
-    i2c_master_write_byte(s_cmd_handle, data, 0x1);
+    platform_i2c_send_buffer(&data, 1);
 }
 
 static void platform_i2c_close(void)
 {
     // ... free all i2c resources here
-    i2c_driver_delete(s_bus_id);
-}
-
-static void platform_i2c_send_buffer(const uint8_t *data, uint16_t len)
-{
-    // ... Send len bytes to i2c communication channel here
-    while (len--)
-    {
-        platform_i2c_send(*data);
-        data++;
-    }
-//    i2c_master_write(cmd, data_wr, size, ACK_CHECK_EN);
+    // the driver stays installed for the other devices on the bus
 }
 
 void ssd1306_platform_i2cInit(int8_t busId, uint8_t addr, int8_t arg)
@@ -124,20 +628,11 @@ void ssd1306_platform_i2cInit(int8_t busId, uint8_t addr, int8_t arg)
     ssd1306_intf.send  = &platform_i2c_send;
     ssd1306_intf.close = &platform_i2c_close;
     ssd1306_intf.send_buffer = &platform_i2c_send_buffer;
+    ssd1306_intf.send_fill = NULL;
     // init your interface here
     if ( busId < 0) busId = I2C_NUM_1;
     s_bus_id = busId;
-    i2c_config_t conf;
-    conf.mode = I2C_MODE_MASTER;
-    conf.sda_io_num = 21; // I2C_EXAMPLE_MASTER_SDA_IO;
-    conf.sda_pullup_en = GPIO_PULLUP_ENABLE;
-    conf.scl_io_num = 22; // I2C_EXAMPLE_MASTER_SCL_IO;
-    conf.scl_pullup_en = GPIO_PULLUP_ENABLE;
-    conf.master.clk_speed = 400000; //I2C_EXAMPLE_MASTER_FREQ_HZ;
-    i2c_param_config(s_bus_id, &conf);
-    i2c_driver_install(s_bus_id, conf.mode, 0, 0, 0);
-//                       I2C_EXAMPLE_MASTER_RX_BUF_DISABLE,
-//                       I2C_EXAMPLE_MASTER_TX_BUF_DISABLE, 0);
+    ssd1306_platform_i2cBusInit(s_bus_id, PLATFORM_I2C_SDA, PLATFORM_I2C_SCL, PLATFORM_I2C_CLOCK_HZ);
 }
 #endif
 
@@ -147,15 +642,82 @@ void ssd1306_platform_i2cInit(int8_t busId, uint8_t addr, int8_t arg)
 
 #include "intf/spi/ssd1306_spi.h"
 #include "driver/spi_master.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+
+// Transactions in flight. Bytes are staged in the next free DMA buffer while
+// the others are sent, a buffer goes out when full, on a D/C change or on stop.
+#define PLATFORM_SPI_QUEUE_LEN      3
+#define PLATFORM_SPI_BUFFER_SIZE    4092
 
 // Store spi handle globally for all spi callbacks
 static spi_device_handle_t s_spi;
 static int8_t s_spi_bus_id;
+// bus pins of ssd1306_platform_spiSetPins(), -1 for the defaults of the bus
+static int8_t s_spi_sclk = -1;
+static int8_t s_spi_mosi = -1;
 // s_first_spi_session is used for delayed spi initialization.
 // Some oled displays have slow max SPI speed, so display init function can change
 // spi frequency s_ssd1306_spi_clock. Register device, only when frequency is known.
 static uint8_t s_first_spi_session = 0;
 
+static spi_transaction_t s_spi_trans[PLATFORM_SPI_QUEUE_LEN];
+static uint8_t *s_spi_buffers[PLATFORM_SPI_QUEUE_LEN];
+static uint8_t s_spi_next;          // buffer being staged
+static uint8_t s_spi_queued;        // transactions not collected yet
+static uint16_t s_spi_staged;
+// level the library last set for D/C, applied per transaction by pre_cb
+static uint8_t s_spi_dc_level;
+
+static void IRAM_ATTR platform_spi_pre_transfer(spi_transaction_t *t)
+{
+    gpio_set_level(s_ssd1306_dc, (int)t->user);
+}
+
+static void platform_spi_wait(uint8_t left)
+{
+    spi_transaction_t *t;
+
+    while (s_spi_queued > left)
+    {
+        spi_device_get_trans_result(s_spi, &t, portMAX_DELAY);
+        s_spi_queued--;
+    }
+}
+
+static void platform_spi_flush(void)
+{
+    if (!s_spi_staged)
+    {
+        return;
+    }
+    spi_transaction_t *t = &s_spi_trans[s_spi_next];
+    memset(t, 0, sizeof(*t));
+    t->length = 8 * s_spi_staged;
+    t->tx_buffer = s_spi_buffers[s_spi_next];
+    t->user = (void *)(int)s_spi_dc_level;
+    spi_device_queue_trans(s_spi, t, portMAX_DELAY);
+    s_spi_queued++;
+    s_spi_next = (s_spi_next + 1) % PLATFORM_SPI_QUEUE_LEN;
+    s_spi_staged = 0;
+}
+
+static int platform_spi_set_dc(int pin, int level)
+{
+    // set directly until ssd1306_platform_spiInit() sets up the buffers
+    if (!s_spi_buffers[0] || pin != s_ssd1306_dc)
+    {
+        return 0;
+    }
+    // bytes staged so far keep the level they were written with
+    if (level != s_spi_dc_level)
+    {
+        platform_spi_flush();
+        s_spi_dc_level = level;
+    }
+    return 1;
+}
+
 static void platform_spi_start(void)
 {
     // ... Open spi channel for your device with specific s_ssd1306_cs, s_ssd1306_dc
@@ -166,7 +728,8 @@ static void platform_spi_start(void)
             .clock_speed_hz = s_ssd1306_spi_clock,
             .mode=0,
             .spics_io_num=s_ssd1306_cs,
-            .queue_size=7,       // max 7 transactions at a time
+            .queue_size=PLATFORM_SPI_QUEUE_LEN,
+            .pre_cb=platform_spi_pre_transfer,
         };
         spi_bus_add_device(s_spi_bus_id ? VSPI_HOST : HSPI_HOST, &devcfg, &s_spi);
         s_first_spi_session = 0;
@@ -176,45 +739,100 @@ static void platform_spi_start(void)
 static void platform_spi_stop(void)
 {
     // ... Complete spi communication
-    // no complete actions required for this implementation
+    // queue what is staged, the transfer completes in the background
+    platform_spi_flush();
 }
 
-static void platform_spi_send(uint8_t data)
+static void platform_spi_send_buffer(const uint8_t *data, uint16_t len)
 {
-    // ... Send byte to spi communication channel
+    // ... Send len bytes to spi communication channel here
     // We do not care here about DC line state, because
     // ssd1306 library already set DC pin via ssd1306_spiDataMode() before call to send().
-    spi_transaction_t t;
-    memset(&t, 0, sizeof(t));
-    t.length = 8;          // 8 bits
-    t.tx_buffer=&data;
-    spi_device_transmit(s_spi, &t);  // Transmit!
+    while (len)
+    {
+        if (!s_spi_staged)
+        {
+            // the buffer to stage in may still be on the bus
+            platform_spi_wait(PLATFORM_SPI_QUEUE_LEN - 1);
+        }
+        uint16_t sz = PLATFORM_SPI_BUFFER_SIZE - s_spi_staged;
+        if (sz > len)
+        {
+            sz = len;
+        }
+        memcpy(s_spi_buffers[s_spi_next] + s_spi_staged, data, sz);
+        s_spi_staged += sz;
+        data += sz;
+        len -= sz;
+        if (s_spi_staged == PLATFORM_SPI_BUFFER_SIZE)
+        {
+            platform_spi_flush();
+        }
+    }
+}
+
+static void platform_spi_send(uint8_t data)
+{
+    // ... Send byte to spi communication channel
+    // staged in place, pixel loops call this for every byte
+    if (!s_spi_staged)
+    {
+        platform_spi_wait(PLATFORM_SPI_QUEUE_LEN - 1);
+    }
+    s_spi_buffers[s_spi_next][s_spi_staged++] = data;
+    if (s_spi_staged == PLATFORM_SPI_BUFFER_SIZE)
+    {
+        platform_spi_flush();
+    }
+}
+
+static void platform_spi_send_fill(uint8_t data, uint16_t count)
+{
+    // memset straight into the DMA buffers, screen clears skip the copy
+    while (count)
+    {
+        if (!s_spi_staged)
+        {
+            platform_spi_wait(PLATFORM_SPI_QUEUE_LEN - 1);
+        }
+        uint16_t sz = PLATFORM_SPI_BUFFER_SIZE - s_spi_staged;
+        if (sz > count)
+        {
+            sz = count;
+        }
+        memset(s_spi_buffers[s_spi_next] + s_spi_staged, data, sz);
+        s_spi_staged += sz;
+        count -= sz;
+        if (s_spi_staged == PLATFORM_SPI_BUFFER_SIZE)
+        {
+            platform_spi_flush();
+        }
+    }
 }
 
 static void platform_spi_close(void)
 {
     // ... free all spi resources here
+    ssd1306_intf.send_fill = NULL;
     if (!s_first_spi_session)
     {
+        platform_spi_flush();
+        platform_spi_wait(0);
         spi_bus_remove_device( s_spi );
+        s_spi = NULL;
     }
     spi_bus_free( s_spi_bus_id ? VSPI_HOST : HSPI_HOST );
+    for (int i = 0; i < PLATFORM_SPI_QUEUE_LEN; i++)
+    {
+        heap_caps_free(s_spi_buffers[i]);
+        s_spi_buffers[i] = NULL;
+    }
 }
 
-static void platform_spi_send_buffer(const uint8_t *data, uint16_t len)
+void ssd1306_platform_spiSetPins(int8_t sclk, int8_t mosi)
 {
-    // ... Send len bytes to spi communication channel here
-    while (len)
-    {
-        size_t sz = len > 32 ? 32: len;
-        spi_transaction_t t;
-        memset(&t, 0, sizeof(t));
-        t.length=8*sz;          // 8 bits
-        t.tx_buffer=data;
-        spi_device_transmit(s_spi, &t);
-        data+=sz;
-        len-=sz;
-    }
+    s_spi_sclk = sclk;
+    s_spi_mosi = mosi;
 }
 
 void ssd1306_platform_spiInit(int8_t busId,
@@ -242,18 +860,29 @@ void ssd1306_platform_spiInit(int8_t busId,
     ssd1306_intf.send  = &platform_spi_send;
     ssd1306_intf.close = &platform_spi_close;
     ssd1306_intf.send_buffer = &platform_spi_send_buffer;
+    ssd1306_intf.send_fill = &platform_spi_send_fill;
 
     // init your interface here
+    // displays are never read, the default miso pin is left alone with custom pins
+    uint8_t custom = s_spi_sclk >= 0 || s_spi_mosi >= 0;
     spi_bus_config_t buscfg=
     {
-        .miso_io_num= s_spi_bus_id ? 19 : 12,
-        .mosi_io_num= s_spi_bus_id ? 23 : 13,
-        .sclk_io_num= s_spi_bus_id ? 18 : 14,
+        .miso_io_num= custom ? -1 : (s_spi_bus_id ? 19 : 12),
+        .mosi_io_num= s_spi_mosi >= 0 ? s_spi_mosi : (s_spi_bus_id ? 23 : 13),
+        .sclk_io_num= s_spi_sclk >= 0 ? s_spi_sclk : (s_spi_bus_id ? 18 : 14),
         .quadwp_io_num=-1,
         .quadhd_io_num=-1,
-        .max_transfer_sz=32
+        .max_transfer_sz=PLATFORM_SPI_BUFFER_SIZE
     };
-    spi_bus_initialize(s_spi_bus_id ? VSPI_HOST : HSPI_HOST, &buscfg, 0); // 0 -no dma
+    spi_bus_initialize(s_spi_bus_id ? VSPI_HOST : HSPI_HOST, &buscfg, 1); // dma channel 1
+    for (int i = 0; i < PLATFORM_SPI_QUEUE_LEN; i++)
+    {
+        s_spi_buffers[i] = heap_caps_malloc(PLATFORM_SPI_BUFFER_SIZE, MALLOC_CAP_DMA);
+    }
+    s_spi_next = 0;
+    s_spi_queued = 0;
+    s_spi_staged = 0;
+    s_spi_dc_level = 0;
     s_first_spi_session = 1;
 }
 #endif
@@ -72,7 +72,12 @@ static inline uint32_t micros(void) { return 0; };
 static inline void pinMode(int pin, int mode) {};
 
 #else                         // ============== LINUX
+#if defined(SDL_EMULATION)
+// lets the emulator show the last frame while the application waits
+static inline void delay(unsigned long ms) { sdl_core_delay(ms); };
+#else
 static inline void delay(unsigned long ms) { usleep(ms*1000);  };
+#endif
 static inline void delayMicroseconds(unsigned long us) { usleep(us); };
 static inline uint32_t millis(void)
 {
@@ -40,6 +40,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include <linux/i2c.h>
 #include <linux/i2c-dev.h>
 #include <linux/spi/spidev.h>
 
@@ -55,6 +56,116 @@
 #endif
 #define OUT 1
 
+#ifdef SSD1306_LINUX_GPIOCHIP
+
+/*
+ * Lines of the gpio character device SSD1306_LINUX_GPIOCHIP, for example "/dev/gpiochip0".
+ * Pin numbers are line offsets on that chip, not global sysfs numbers. A line is requested
+ * once per direction and its handle kept, so a write costs one ioctl.
+ */
+#include <linux/gpio.h>
+
+static int s_chip_fd = -1;
+/* Line handle fd + 1, 0 while the line is not requested */
+static int s_line_fd[MAX_GPIO_COUNT] = {0};
+
+int gpio_export(int pin)
+{
+    if (s_chip_fd < 0)
+    {
+        s_chip_fd = open(SSD1306_LINUX_GPIOCHIP, O_RDWR);
+        if (s_chip_fd < 0)
+        {
+            fprintf(stderr, "Failed to open %s: %s!\n", SSD1306_LINUX_GPIOCHIP, strerror(errno));
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+int gpio_unexport(int pin)
+{
+    if (s_line_fd[pin])
+    {
+        close(s_line_fd[pin] - 1);
+        s_line_fd[pin] = 0;
+    }
+    return(0);
+}
+
+int gpio_direction(int pin, int dir)
+{
+    struct gpiohandle_request req;
+
+    // the direction of a requested line is fixed, it is requested again
+    gpio_unexport(pin);
+    memset(&req, 0, sizeof(req));
+    req.lineoffsets[0] = pin;
+    req.lines = 1;
+    req.flags = IN == dir ? GPIOHANDLE_REQUEST_INPUT : GPIOHANDLE_REQUEST_OUTPUT;
+    strncpy(req.consumer_label, "ssd1306", sizeof(req.consumer_label) - 1);
+    if (s_chip_fd < 0 || ioctl(s_chip_fd, GPIO_GET_LINEHANDLE_IOCTL, &req) < 0)
+    {
+        fprintf(stderr, "Failed to set gpio pin direction[%d]: %s!\n", pin, strerror(errno));
+        return(-1);
+    }
+    s_line_fd[pin] = req.fd + 1;
+    return(0);
+}
+
+int gpio_read(int pin)
+{
+    struct gpiohandle_data data;
+
+    if (!s_line_fd[pin] || ioctl(s_line_fd[pin] - 1, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) < 0)
+    {
+        fprintf(stderr, "Failed to read gpio pin value!\n");
+        return(-1);
+    }
+    return(data.values[0]);
+}
+
+int gpio_write(int pin, int value)
+{
+    struct gpiohandle_data data;
+
+    data.values[0] = LOW == value ? 0 : 1;
+    if (!s_line_fd[pin] || ioctl(s_line_fd[pin] - 1, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data) < 0)
+    {
+        fprintf(stderr, "Failed to set gpio pin value[%d]: %s!\n", pin, strerror(errno));
+        return(-1);
+    }
+    return(0);
+}
+
+#else
+
+/* Value file fd + 1 of each pin, opened on first use and kept, 0 while closed */
+static int s_value_fd[MAX_GPIO_COUNT] = {0};
+
+static int gpio_value_fd(int pin)
+{
+    char path[64];
+    int fd;
+
+    if (s_value_fd[pin])
+    {
+        return s_value_fd[pin] - 1;
+    }
+    snprintf(path, sizeof(path), "/sys/class/gpio/gpio%d/value", pin);
+    fd = open(path, O_RDWR);
+    if (-1 == fd)
+    {
+        // input only pins refuse writing
+        fd = open(path, O_RDONLY);
+    }
+    if (-1 != fd)
+    {
+        s_value_fd[pin] = fd + 1;
+    }
+    return fd;
+}
+
 int gpio_export(int pin)
 {
     char buffer[4];
@@ -93,6 +204,11 @@ int gpio_unexport(int pin)
     ssize_t bytes_written;
     int fd;
 
+    if (s_value_fd[pin])
+    {
+        close(s_value_fd[pin] - 1);
+        s_value_fd[pin] = 0;
+    }
     fd = open("/sys/class/gpio/unexport", O_WRONLY);
     if (-1 == fd)
     {
@@ -136,26 +252,21 @@ int gpio_direction(int pin, int dir)
 
 int gpio_read(int pin)
 {
-    char path[32];
     char value_str[3];
-    int fd;
+    int fd = gpio_value_fd(pin);
 
-    snprintf(path, sizeof(path), "/sys/class/gpio/gpio%d/value", pin);
-    fd = open(path, O_RDONLY);
     if (-1 == fd)
     {
         fprintf(stderr, "Failed to read gpio pin value!\n");
         return(-1);
     }
 
-    if (-1 == read(fd, value_str, 3))
+    if (-1 == pread(fd, value_str, 3, 0))
     {
         fprintf(stderr, "Failed to read gpio pin value!\n");
         return(-1);
     }
 
-    close(fd);
-
     return(atoi(value_str));
 }
 
@@ -163,31 +274,32 @@ int gpio_write(int pin, int value)
 {
     static const char s_values_str[] = "01";
 
-    char path[64];
-    int fd;
-
-    snprintf(path, sizeof(path), "/sys/class/gpio/gpio%d/value", pin);
-    fd = open(path, O_WRONLY);
+    int fd = gpio_value_fd(pin);
     if (-1 == fd)
     {
         fprintf(stderr, "Failed to set gpio pin value[%d]: %s!\n", pin, strerror(errno));
         return(-1);
     }
 
-    if (1 != write(fd, &s_values_str[LOW == value ? 0 : 1], 1))
+    if (1 != pwrite(fd, &s_values_str[LOW == value ? 0 : 1], 1, 0))
     {
         fprintf(stderr, "Failed to set gpio pin value[%d]: %s!\n", pin, strerror (errno));
         return(-1);
     }
-
-    close(fd);
     return(0);
 }
 
+#endif // SSD1306_LINUX_GPIOCHIP
+
 #if !defined(SDL_EMULATION)
 
 static uint8_t s_exported_pin[MAX_GPIO_COUNT] = {0};
+// sends what the spi interface buffered, before D/C or any other pin changes
+static void (*s_gpio_flush)(void) = NULL;
 static uint8_t s_pin_mode[MAX_GPIO_COUNT] = {0};
+/* Level last written + 1, 0 while unknown. D/C is set before every command and data block,
+   mostly to the level it has already */
+static uint8_t s_pin_level[MAX_GPIO_COUNT] = {0};
 
 void pinMode(int pin, int mode)
 {
@@ -199,6 +311,7 @@ void pinMode(int pin, int mode)
         }
         s_exported_pin[pin] = 1;
     }
+    s_pin_level[pin] = 0;
     if (mode == OUTPUT)
     {
         gpio_direction(pin, OUT);
@@ -225,7 +338,16 @@ void digitalWrite(int pin, int level)
     {
         pinMode(pin, OUTPUT);
     }
-    gpio_write( pin, level );
+    level = LOW == level ? LOW : HIGH;
+    if (s_pin_level[pin] == level + 1)
+    {
+        return;
+    }
+    if (s_gpio_flush)
+    {
+        s_gpio_flush();
+    }
+    s_pin_level[pin] = gpio_write( pin, level ) < 0 ? 0 : level + 1;
 }
 
 #endif // SDL_EMULATION
@@ -240,37 +362,81 @@ void digitalWrite(int pin, int level)
 #if !defined(SDL_EMULATION)
 
 
+#ifndef SSD1306_LINUX_I2C_MSG_SIZE
+/** Bytes of one i2c message with the control byte, lower it for adapters with a smaller limit */
+#define SSD1306_LINUX_I2C_MSG_SIZE  128
+#endif
+
+#ifndef SSD1306_LINUX_I2C_MSGS
+/** Messages sent with one I2C_RDWR ioctl, the kernel accepts up to 42 */
+#define SSD1306_LINUX_I2C_MSGS      32
+#endif
+
 static uint8_t s_sa = SSD1306_SA;
 static int     s_fd = -1;
-static uint8_t s_buffer[128];
-static uint8_t s_dataSize = 0;
+static uint8_t s_buffer[SSD1306_LINUX_I2C_MSGS][SSD1306_LINUX_I2C_MSG_SIZE];
+static struct i2c_msg s_msgs[SSD1306_LINUX_I2C_MSGS];
+static uint8_t s_msgCount = 0;    // messages filled before the current one
+static uint16_t s_dataSize = 0;   // bytes in the current message
+static uint8_t s_control = 0;     // first byte of the transaction, repeated in every message
+static uint8_t s_first = 0;
+
+/* A transaction longer than a message goes out as several, joined by repeated starts */
+static void platform_i2c_flush(void)
+{
+    struct i2c_rdwr_ioctl_data data;
+    uint8_t count = s_msgCount + (s_dataSize ? 1 : 0);
+    for (uint8_t i = 0; i < count; i++)
+    {
+        s_msgs[i].addr = s_sa;
+        s_msgs[i].flags = 0;
+        s_msgs[i].len = i < s_msgCount ? SSD1306_LINUX_I2C_MSG_SIZE : s_dataSize;
+        s_msgs[i].buf = s_buffer[i];
+    }
+    s_msgCount = 0;
+    s_dataSize = 0;
+    if (!count)
+    {
+        return;
+    }
+    data.msgs = s_msgs;
+    data.nmsgs = count;
+    if (ioctl(s_fd, I2C_RDWR, &data) < 0)
+    {
+        fprintf(stderr, "Failed to write to the i2c bus: %s.\n", strerror(errno));
+    }
+}
 
 static void platform_i2c_start(void)
 {
+    s_msgCount = 0;
     s_dataSize = 0;
+    s_first = 1;
 }
 
 static void platform_i2c_stop(void)
 {
-    if (write(s_fd, s_buffer, s_dataSize) != s_dataSize)
-    {
-        fprintf(stderr, "Failed to write to the i2c bus: %s.\n", strerror(errno));
-    }
-    s_dataSize = 0;
+    platform_i2c_flush();
 }
 
 static void platform_i2c_send(uint8_t data)
 {
-    s_buffer[s_dataSize] = data;
-    s_dataSize++;
-    if (s_dataSize == sizeof(s_buffer))
+    if (s_first)
+    {
+        s_control = data;
+        s_first = 0;
+    }
+    else if (s_dataSize == SSD1306_LINUX_I2C_MSG_SIZE)
     {
-        /* Send function puts all data to internal buffer.  *
-         * Restart transmission if internal buffer is full. */
-        ssd1306_intf.stop();
-        ssd1306_intf.start();
-        ssd1306_intf.send(0x40);
+        // the full message counts as filled, so that a flush sends all of them
+        s_dataSize = 0;
+        if (++s_msgCount == SSD1306_LINUX_I2C_MSGS)
+        {
+            platform_i2c_flush();
+        }
+        s_buffer[s_msgCount][s_dataSize++] = s_control;
     }
+    s_buffer[s_msgCount][s_dataSize++] = data;
 }
 
 static void platform_i2c_send_buffer(const uint8_t *buffer, uint16_t size)
@@ -341,15 +507,6 @@ void ssd1306_platform_i2cInit(int8_t busId, uint8_t sa, int8_t arg)
 
 #include "sdl_core.h"
 
-static void platform_i2c_send_buffer(const uint8_t *buffer, uint16_t size)
-{
-    while (size--)
-    {
-        sdl_send_byte(*buffer);
-        buffer++;
-    };
-}
-
 void ssd1306_platform_i2cInit(int8_t busId, uint8_t sa, int8_t arg)
 {
     sdl_core_init();
@@ -357,7 +514,7 @@ void ssd1306_platform_i2cInit(int8_t busId, uint8_t sa, int8_t arg)
     ssd1306_intf.start = sdl_send_init;
     ssd1306_intf.stop = sdl_send_stop;
     ssd1306_intf.send = sdl_send_byte;
-    ssd1306_intf.send_buffer = platform_i2c_send_buffer;
+    ssd1306_intf.send_buffer = sdl_send_bytes;
     ssd1306_intf.close = sdl_core_close;
 }
 
@@ -373,8 +530,36 @@ void ssd1306_platform_i2cInit(int8_t busId, uint8_t sa, int8_t arg)
 
 #if !defined(SDL_EMULATION)
 
+/* Default bufsiz of spidev, the kernel refuses longer messages */
+#define SPI_BUFFER_SIZE  4096
+
 static int     s_spi_fd = -1;
 extern uint32_t s_ssd1306_spi_clock;
+static uint8_t s_spi_buffer[SPI_BUFFER_SIZE];
+static uint16_t s_spi_size = 0;
+
+/* Bytes are held until D/C changes, the transaction ends or the buffer is full */
+static void platform_spi_flush(void)
+{
+    struct spi_ioc_transfer mesg;
+    if (!s_spi_size)
+    {
+        return;
+    }
+    memset(&mesg, 0, sizeof mesg);
+    mesg.tx_buf = (unsigned long)&s_spi_buffer[0];
+    mesg.rx_buf = 0;
+    mesg.len = s_spi_size;
+    mesg.delay_usecs = 0;
+    mesg.speed_hz = s_ssd1306_spi_clock;
+    mesg.bits_per_word = 8;
+    mesg.cs_change = 0;
+    s_spi_size = 0;
+    if (ioctl(s_spi_fd, SPI_IOC_MESSAGE(1), &mesg) < 1)
+    {
+        fprintf(stderr, "SPI failed to send SPI message: %s\n", strerror (errno)) ;
+    }
+}
 
 static void platform_spi_start(void)
 {
@@ -382,32 +567,22 @@ static void platform_spi_start(void)
 
 static void platform_spi_stop(void)
 {
+    platform_spi_flush();
 }
 
 static void platform_spi_send(uint8_t data)
 {
-    /* TODO: Yeah, sending single bytes is too slow, but *
-     * need to figure out how to detect data/command bytes *
-     * to send bytes as one block */
-    uint8_t buf[1];
-    struct spi_ioc_transfer mesg;
-    buf[0] = data;
-    memset(&mesg, 0, sizeof mesg);
-    mesg.tx_buf = (unsigned long)&buf[0];
-    mesg.rx_buf = 0;
-    mesg.len = 1;
-    mesg.delay_usecs = 0;
-    mesg.speed_hz = 0;
-    mesg.bits_per_word = 8;
-    mesg.cs_change = 0;
-    if (ioctl(s_spi_fd, SPI_IOC_MESSAGE(1), &mesg) < 1)
+    if (s_spi_size == SPI_BUFFER_SIZE)
     {
-        fprintf(stderr, "SPI failed to send SPI message: %s\n", strerror (errno)) ;
+        platform_spi_flush();
     }
+    s_spi_buffer[s_spi_size++] = data;
 }
 
 static void platform_spi_close(void)
 {
+    platform_spi_flush();
+    s_gpio_flush = NULL;
     if (s_spi_fd >= 0)
     {
         close(s_spi_fd);
@@ -417,10 +592,21 @@ static void platform_spi_close(void)
 
 static void platform_spi_send_buffer(const uint8_t *data, uint16_t len)
 {
-    while (len--)
+    while (len)
     {
-        platform_spi_send(*data);
-        data++;
+        uint16_t size = SPI_BUFFER_SIZE - s_spi_size;
+        if (size > len)
+        {
+            size = len;
+        }
+        memcpy(&s_spi_buffer[s_spi_size], data, size);
+        s_spi_size += size;
+        data += size;
+        len -= size;
+        if (s_spi_size == SPI_BUFFER_SIZE)
+        {
+            platform_spi_flush();
+        }
     }
 }
 
@@ -486,21 +672,13 @@ void ssd1306_platform_spiInit(int8_t busId,
     ssd1306_intf.send = platform_spi_send;
     ssd1306_intf.send_buffer = platform_spi_send_buffer;
     ssd1306_intf.close = platform_spi_close;
+    s_gpio_flush = platform_spi_flush;
 }
 
 #else /* SDL_EMULATION */
 
 #include "sdl_core.h"
 
-static void sdl_send_bytes(const uint8_t *buffer, uint16_t size)
-{
-    while (size--)
-    {
-        sdl_send_byte(*buffer);
-        buffer++;
-    };
-}
-
 void ssd1306_platform_spiInit(int8_t busId, int8_t ces, int8_t dcPin)
 {
     sdl_core_init();
@@ -57,7 +57,12 @@ extern "C" {
 #endif
 
 static inline int  digitalRead(int pin) { return sdl_read_digital(pin); };
+#if defined(SDL_EMULATION)
+// lets the emulator show the last frame while the application waits
+static inline void delay(unsigned long ms) { sdl_core_delay(ms); };
+#else
 static inline void delay(unsigned long ms) { Sleep(ms);  };
+#endif
 static inline void delayMicroseconds(unsigned long us) { Sleep((us+500)/1000); };
 static inline uint32_t millis(void)
 {
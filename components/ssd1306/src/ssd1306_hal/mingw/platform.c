@@ -154,15 +154,6 @@ void ssd1306_platform_i2cInit(int8_t busId, uint8_t sa, int8_t arg)
 
 #include "sdl_core.h"
 
-static void platform_i2c_send_buffer(const uint8_t *buffer, uint16_t size)
-{
-    while (size--)
-    {
-        sdl_send_byte(*buffer);
-        buffer++;
-    };
-}
-
 void ssd1306_platform_i2cInit(int8_t busId, uint8_t sa, int8_t arg)
 {
     sdl_core_init();
@@ -170,7 +161,7 @@ void ssd1306_platform_i2cInit(int8_t busId, uint8_t sa, int8_t arg)
     ssd1306_intf.start = sdl_send_init;
     ssd1306_intf.stop = sdl_send_stop;
     ssd1306_intf.send = sdl_send_byte;
-    ssd1306_intf.send_buffer = platform_i2c_send_buffer;
+    ssd1306_intf.send_buffer = sdl_send_bytes;
     ssd1306_intf.close = sdl_core_close;
 }
 
@@ -305,15 +296,6 @@ void ssd1306_platform_spiInit(int8_t busId,
 
 #include "sdl_core.h"
 
-static void sdl_send_bytes(const uint8_t *buffer, uint16_t size)
-{
-    while (size--)
-    {
-        sdl_send_byte(*buffer);
-        buffer++;
-    };
-}
-
 void ssd1306_platform_spiInit(int8_t busId, int8_t ces, int8_t dcPin)
 {
     sdl_core_init();
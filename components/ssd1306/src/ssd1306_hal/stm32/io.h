@@ -66,8 +66,19 @@ static inline int  digitalRead(int pin)   // digitalRead()
     return LOW;
 }
 
+#if defined(CONFIG_PLATFORM_SPI_AVAILABLE) && defined(CONFIG_PLATFORM_SPI_ENABLE)
+/**
+ * Lets the spi transfers in flight complete before the D/C pin changes.
+ * Call it from digitalWrite() before setting the pin.
+ */
+void ssd1306_platform_spiSetDc(int pin, int level);
+#endif
+
 static inline void digitalWrite(int pin, int level)  // digitalWrite()
 {
+#if defined(CONFIG_PLATFORM_SPI_AVAILABLE) && defined(CONFIG_PLATFORM_SPI_ENABLE)
+    ssd1306_platform_spiSetDc(pin, level);
+#endif
 }
 
 static inline void pinMode(int pin, int mode) // pinMode()
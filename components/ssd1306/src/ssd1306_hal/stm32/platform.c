@@ -31,40 +31,104 @@
 
 // TODO: To add support. Any help is welcome
 
+// Transfers run by DMA from one of two staging buffers, while the library
+// fills the other one. A transfer is started when a buffer is full, on
+// stop, or for spi on a D/C change, and the caller goes on computing.
+#define PLATFORM_DMA_BUFFER_SIZE    256
+
 ////////////////////////////////////////////////////////////////////////////////////////
 // !!! PLATFORM I2C IMPLEMENTATION OPTIONAL !!!
 #if defined(CONFIG_PLATFORM_I2C_AVAILABLE) && defined(CONFIG_PLATFORM_I2C_ENABLE)
+extern I2C_HandleTypeDef hi2c1;
+
 static uint8_t s_i2c_addr = 0x3C;
+static uint8_t s_i2c_buffers[2][PLATFORM_DMA_BUFFER_SIZE];
+static uint8_t s_i2c_next;          // buffer being staged
+static uint16_t s_i2c_staged;
+static uint8_t s_i2c_started;       // a part of the transaction is out already
+
+static void platform_i2c_wait(void)
+{
+    while (HAL_I2C_GetState(&hi2c1) != HAL_I2C_STATE_READY)
+    {
+    }
+}
+
+static void platform_i2c_flush(uint8_t last)
+{
+    uint32_t options;
+    if (!s_i2c_started)
+    {
+        options = last ? I2C_FIRST_AND_LAST_FRAME : I2C_FIRST_FRAME;
+    }
+    else
+    {
+        options = last ? I2C_LAST_FRAME : I2C_NEXT_FRAME;
+    }
+    // the frame before must be out, also to chain frames of one transaction
+    platform_i2c_wait();
+    HAL_I2C_Master_Seq_Transmit_DMA(&hi2c1, s_i2c_addr << 1, s_i2c_buffers[s_i2c_next], s_i2c_staged, options);
+    s_i2c_started = !last;
+    s_i2c_next ^= 1;
+    s_i2c_staged = 0;
+}
 
 static void platform_i2c_start(void)
 {
     // ... Open i2c channel for your device with specific s_i2c_addr
+    s_i2c_staged = 0;
+    s_i2c_started = 0;
 }
 
 static void platform_i2c_stop(void)
 {
     // ... Complete i2c communication
+    // the transfer completes in the background
+    platform_i2c_flush(1);
 }
 
 static void platform_i2c_send(uint8_t data)
 {
     // ... Send byte to i2c communication channel
+    s_i2c_buffers[s_i2c_next][s_i2c_staged++] = data;
+    if (s_i2c_staged == PLATFORM_DMA_BUFFER_SIZE)
+    {
+        platform_i2c_flush(0);
+    }
 }
 
 static void platform_i2c_close(void)
 {
     // ... free all i2c resources here
+    platform_i2c_wait();
 }
 
 static void platform_i2c_send_buffer(const uint8_t *data, uint16_t len)
 {
     // ... Send len bytes to i2c communication channel here
+    while (len)
+    {
+        uint16_t sz = PLATFORM_DMA_BUFFER_SIZE - s_i2c_staged;
+        if (sz > len)
+        {
+            sz = len;
+        }
+        memcpy(s_i2c_buffers[s_i2c_next] + s_i2c_staged, data, sz);
+        s_i2c_staged += sz;
+        data += sz;
+        len -= sz;
+        if (s_i2c_staged == PLATFORM_DMA_BUFFER_SIZE)
+        {
+            platform_i2c_flush(0);
+        }
+    }
 }
 
 void ssd1306_platform_i2cInit(int8_t busId, uint8_t addr, int8_t arg)
 {
     if (addr) s_i2c_addr = addr;
-    if (HAL_I2C_IsDeviceReady(&hi2c1, s_i2c_addr, 1, 20000) != HAL_OK)
+    // hal takes the address shifted to the left
+    if (HAL_I2C_IsDeviceReady(&hi2c1, s_i2c_addr << 1, 1, 20000) != HAL_OK)
     {
         return;
     }
@@ -75,7 +139,7 @@ void ssd1306_platform_i2cInit(int8_t busId, uint8_t addr, int8_t arg)
     ssd1306_intf.close = &platform_i2c_close;
     ssd1306_intf.send_buffer = &platform_i2c_send_buffer;
     // init your interface here
-    //...
+    // hi2c1 and its tx DMA channel are set up by the application, as CubeMX generates them
 }
 #endif
 
@@ -85,6 +149,44 @@ void ssd1306_platform_i2cInit(int8_t busId, uint8_t addr, int8_t arg)
 
 #include "intf/spi/ssd1306_spi.h"
 
+extern SPI_HandleTypeDef hspi1;
+
+static uint8_t s_spi_buffers[2][PLATFORM_DMA_BUFFER_SIZE];
+static uint8_t s_spi_next;          // buffer being staged
+static uint16_t s_spi_staged;
+static uint8_t s_spi_ready;         // set up by ssd1306_platform_spiInit()
+static uint8_t s_spi_dc_level;
+
+static void platform_spi_wait(void)
+{
+    while (HAL_SPI_GetState(&hspi1) != HAL_SPI_STATE_READY)
+    {
+    }
+}
+
+static void platform_spi_flush(void)
+{
+    if (!s_spi_staged)
+    {
+        return;
+    }
+    platform_spi_wait();
+    HAL_SPI_Transmit_DMA(&hspi1, s_spi_buffers[s_spi_next], s_spi_staged);
+    s_spi_next ^= 1;
+    s_spi_staged = 0;
+}
+
+void ssd1306_platform_spiSetDc(int pin, int level)
+{
+    if (s_spi_ready && (pin == s_ssd1306_dc) && (level != s_spi_dc_level))
+    {
+        // bytes staged so far go out with the level they were written with
+        platform_spi_flush();
+        platform_spi_wait();
+        s_spi_dc_level = level;
+    }
+}
+
 static void platform_spi_start(void)
 {
     // ... Open spi channel for your device with specific s_ssd1306_cs, s_ssd1306_dc
@@ -93,21 +195,47 @@ static void platform_spi_start(void)
 static void platform_spi_stop(void)
 {
     // ... Complete spi communication
+    // the transfer completes in the background, cs must stay low until it does
+    platform_spi_flush();
 }
 
 static void platform_spi_send(uint8_t data)
 {
     // ... Send byte to spi communication channel
+    s_spi_buffers[s_spi_next][s_spi_staged++] = data;
+    if (s_spi_staged == PLATFORM_DMA_BUFFER_SIZE)
+    {
+        platform_spi_flush();
+    }
 }
 
 static void platform_spi_close(void)
 {
     // ... free all spi resources here
+    platform_spi_flush();
+    platform_spi_wait();
+    s_spi_ready = 0;
 }
 
 static void platform_spi_send_buffer(const uint8_t *data, uint16_t len)
 {
     // ... Send len bytes to spi communication channel here
+    while (len)
+    {
+        uint16_t sz = PLATFORM_DMA_BUFFER_SIZE - s_spi_staged;
+        if (sz > len)
+        {
+            sz = len;
+        }
+        memcpy(s_spi_buffers[s_spi_next] + s_spi_staged, data, sz);
+        s_spi_staged += sz;
+        data += sz;
+        len -= sz;
+        if (s_spi_staged == PLATFORM_DMA_BUFFER_SIZE)
+        {
+            platform_spi_flush();
+        }
+    }
 }
 
 void ssd1306_platform_spiInit(int8_t busId,
@@ -123,7 +251,9 @@ void ssd1306_platform_spiInit(int8_t busId,
     ssd1306_intf.close = &platform_spi_close;
     ssd1306_intf.send_buffer = &platform_spi_send_buffer;
     // init your interface here
-    //...
+    // hspi1 and its tx DMA channel are set up by the application, as CubeMX generates them
+    s_spi_staged = 0;
+    s_spi_ready = 1;
 }
 #endif
 
@@ -33,6 +33,8 @@
 #define max(x,y) ((x)>(y)?(x):(y))
 #endif
 
+extern SFixedFontInfo s_fixedFont;
+
 static uint8_t getMaxScreenItems(void)
 {
     return (ssd1306_displayHeight() >> 3) - 2;
@@ -176,3 +178,170 @@ void ssd1306_menuUp(SAppMenu *menu)
         menu->selection = menu->count - 1;
     }
 }
+
+/** No item drawn in the page */
+#define LIST_MENU_NO_ITEM  0xFFFF
+
+static uint8_t getListMenuRows(void)
+{
+    return min(ssd1306_displayHeight() >> 3, SSD1306_LIST_MENU_MAX_ROWS);
+}
+
+/** Display RAM works as a ring of pages, which are all visible */
+static uint8_t canScrollListMenu(void)
+{
+    return ((ssd1306_lcd.type == LCD_TYPE_SSD1306) || (ssd1306_lcd.type == LCD_TYPE_SH1106)) &&
+           (ssd1306_displayHeight() == 64) && (SSD1306_LIST_MENU_MAX_ROWS >= 8);
+}
+
+void ssd1306_createListMenu(SAppListMenu *menu, SMenuItemProvider provider, void *arg, uint16_t count)
+{
+    menu->provider = provider;
+    menu->arg = arg;
+    menu->count = count;
+    menu->selection = 0;
+    menu->scrollPosition = 0;
+    menu->drawnSelection = 0;
+    menu->startPage = 0;
+    for (uint8_t i = 0; i < SSD1306_LIST_MENU_MAX_ROWS; i++)
+    {
+        menu->pageItems[i] = LIST_MENU_NO_ITEM;
+    }
+}
+
+static uint16_t calculateListScrollPosition(SAppListMenu *menu)
+{
+    uint8_t rows = getListMenuRows();
+    if ( menu->selection < menu->scrollPosition )
+    {
+        return menu->selection;
+    }
+    else if ( menu->selection - menu->scrollPosition > rows - 1 )
+    {
+        return menu->selection - rows + 1;
+    }
+    return menu->scrollPosition;
+}
+
+static void drawListMenuItem(SAppListMenu *menu, uint8_t page, uint16_t index)
+{
+    lcduint_t width = 0;
+    if ( index != LIST_MENU_NO_ITEM )
+    {
+        char text[SSD1306_LIST_MENU_TEXT_SIZE];
+        text[0] = '\0';
+        menu->provider( index, text, sizeof(text), menu->arg );
+        text[sizeof(text) - 1] = '\0';
+        // cut the text at the last char fitting the row, printFixed() would wrap it
+        uint8_t chars = 0;
+        uint8_t maxChars = s_fixedFont.h.width ? ssd1306_displayWidth() / s_fixedFont.h.width : 0;
+        for (uint8_t i = 0; text[i]; i++)
+        {
+            if ( ((text[i] & 0xC0) != 0x80) && (chars++ == maxChars) )
+            {
+                text[i] = '\0';
+                break;
+            }
+        }
+        STextSize size;
+        ssd1306_measureText( text, 0, 0, &size );
+        width = min(size.width, ssd1306_displayWidth());
+        if (index == menu->selection)
+        {
+            ssd1306_negativeMode();
+        }
+        ssd1306_printFixed( 0, page << 3, text, STYLE_NORMAL );
+    }
+    if ( width < ssd1306_displayWidth() )
+    {
+        ssd1306_clearBlock( width, page, ssd1306_displayWidth() - width, 8 );
+    }
+    ssd1306_positiveMode();
+    menu->pageItems[page] = index;
+}
+
+void ssd1306_showListMenu(SAppListMenu *menu)
+{
+    ssd1306_clearScreen();
+    for (uint8_t i = 0; i < SSD1306_LIST_MENU_MAX_ROWS; i++)
+    {
+        menu->pageItems[i] = LIST_MENU_NO_ITEM;
+    }
+    if ( menu->selection >= menu->count )
+    {
+        menu->selection = menu->count ? menu->count - 1 : 0;
+    }
+    if ( !canScrollListMenu() )
+    {
+        menu->startPage = 0;
+    }
+    ssd1306_updateListMenu(menu);
+    if ( canScrollListMenu() )
+    {
+        ssd1306_setStartLine( menu->startPage << 3 );
+    }
+}
+
+void ssd1306_updateListMenu(SAppListMenu *menu)
+{
+    uint8_t rows = getListMenuRows();
+    uint16_t scrollPosition = calculateListScrollPosition( menu );
+    uint8_t startPage = menu->startPage;
+    if ( canScrollListMenu() )
+    {
+        // pages keep their items, the one scrolled out of view gets the new item
+        int32_t delta = (int32_t)scrollPosition - menu->scrollPosition;
+        startPage = (uint8_t)(((int32_t)startPage + delta % rows + rows) % rows);
+    }
+    for (uint8_t row = 0; row < rows; row++)
+    {
+        uint8_t page = (startPage + row) % rows;
+        uint16_t index = scrollPosition + row;
+        if ( index >= menu->count )
+        {
+            index = LIST_MENU_NO_ITEM;
+        }
+        if ( (menu->pageItems[page] != index) ||
+             ((index != LIST_MENU_NO_ITEM) && (index == menu->selection || index == menu->drawnSelection) &&
+              (menu->selection != menu->drawnSelection)) )
+        {
+            drawListMenuItem( menu, page, index );
+        }
+    }
+    if ( startPage != menu->startPage )
+    {
+        ssd1306_setStartLine( startPage << 3 );
+    }
+    menu->startPage = startPage;
+    menu->scrollPosition = scrollPosition;
+    menu->drawnSelection = menu->selection;
+}
+
+uint16_t ssd1306_listMenuSelection(SAppListMenu *menu)
+{
+    return menu->selection;
+}
+
+void ssd1306_listMenuDown(SAppListMenu *menu)
+{
+    if (menu->selection + 1 < menu->count)
+    {
+        menu->selection++;
+    }
+    else
+    {
+        menu->selection = 0;
+    }
+}
+
+void ssd1306_listMenuUp(SAppListMenu *menu)
+{
+    if (menu->selection > 0)
+    {
+        menu->selection--;
+    }
+    else if (menu->count > 0)
+    {
+        menu->selection = menu->count - 1;
+    }
+}
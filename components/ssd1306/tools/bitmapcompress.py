@@ -0,0 +1,118 @@
+#!/usr/bin/python
+# -*- coding: UTF-8 -*-
+#    MIT License
+#
+#    Copyright (c) 2018, Alexey Dynda
+#
+#    Permission is hereby granted, free of charge, to any person obtaining a copy
+#    of this software and associated documentation files (the "Software"), to deal
+#    in the Software without restriction, including without limitation the rights
+#    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+#    copies of the Software, and to permit persons to whom the Software is
+#    furnished to do so, subject to the following conditions:
+#
+#    The above copyright notice and this permission notice shall be included in all
+#    copies or substantial portions of the Software.
+#
+#    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+#    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+#    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+#    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+#    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+#    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+#    SOFTWARE.
+#
+###################################################################################
+#
+# Compresses page ordered bitmaps for ssd1306_drawCompressedBitmap(), see format.txt.
+# Input files are C sources as made by LCDAssistant, every hex byte found is taken.
+# With several files the first one is a key frame, the next ones hold only what
+# changed since the frame before.
+#
+#     bitmapcompress.py -w 128 -h 64 -n splash splash1.h splash2.h > splash.h
+
+from __future__ import print_function
+import re
+import sys
+
+# shorter runs of unchanged bytes cost more to skip than to send again
+MIN_SKIP = 3
+
+def print_help_and_exit():
+    print("Usage: bitmapcompress.py -w <W> -h <H> [-n <name>] file [file ...] > outputFile")
+    exit(1)
+
+def read_frame(name, size):
+    with open(name) as f:
+        text = re.sub(r'/\*.*?\*/|//[^\n]*', '', f.read(), flags=re.S)
+    data = [int(x, 16) for x in re.findall(r'0[xX]([0-9a-fA-F]{1,2})\b', text)]
+    if len(data) < size:
+        sys.stderr.write("%s: %d bytes found, %d expected\n" % (name, len(data), size))
+        exit(1)
+    return data[:size]
+
+def compress(frame, previous):
+    out = []
+    literal = []
+    def flush_literal():
+        while literal:
+            part = literal[:64]
+            del literal[:64]
+            out.append(len(part) - 1)
+            out.extend(part)
+    i = 0
+    while i < len(frame):
+        n = 1
+        if previous is not None:
+            while i + n < len(frame) and n < 64 and frame[i + n] == previous[i + n]:
+                n += 1
+            if frame[i] == previous[i] and n >= MIN_SKIP:
+                flush_literal()
+                out.append(0x80 | (n - 1))
+                i += n
+                continue
+        n = 1
+        while i + n < len(frame) and n < 64 and frame[i + n] == frame[i]:
+            n += 1
+        if n >= 3:
+            flush_literal()
+            out.append(0x40 | (n - 1))
+            out.append(frame[i])
+            i += n
+            continue
+        literal.append(frame[i])
+        i += 1
+    flush_literal()
+    return out
+
+def main(args):
+    width = height = None
+    name = "bitmap"
+    files = []
+    i = 0
+    while i < len(args):
+        if args[i] == "-w":
+            width = int(args[i + 1]); i += 2
+        elif args[i] == "-h":
+            height = int(args[i + 1]); i += 2
+        elif args[i] == "-n":
+            name = args[i + 1]; i += 2
+        else:
+            files.append(args[i]); i += 1
+    if not width or not height or height % 8 or width > 255 or height > 255 or not files:
+        print_help_and_exit()
+    size = width * height // 8
+    previous = None
+    for index, f in enumerate(files):
+        frame = read_frame(f, size)
+        data = [width, height] + compress(frame, previous)
+        previous = frame
+        label = name if len(files) == 1 else "%s_%d" % (name, index)
+        print("// %s: %d bytes, %d uncompressed" % (f, len(data), size))
+        print("const uint8_t %s[] PROGMEM =\n{" % label)
+        for j in range(0, len(data), 16):
+            print("    " + ", ".join("0x%02X" % b for b in data[j:j + 16]) + ",")
+        print("};\n")
+
+if __name__ == "__main__":
+    main(sys.argv[1:])
@@ -38,12 +38,20 @@ print_help_and_exit()
     echo "        -e      start OLED emulation mode with SDL (Linux only)"
     echo "                OLED emulation allows to run simple demo without OLED hardware"
     echo "                OLED emulation mode requires installed libsdl2-dev package"
+    echo "                environment variables of the emulator:"
+    echo "                  SSD1306_SDL_HEADLESS=1       no window, display is kept in memory"
+    echo "                  SSD1306_SDL_FRAMES=<num>     exit after num frames, printing bus statistics"
+    echo "                  SSD1306_SDL_STATS=<file>     write bytes, transactions and busy time per frame as csv"
+    echo "                  SSD1306_SDL_SNAPSHOT=<fmt>   write frames as PPM, e.g. frame%04d.ppm"
+    echo "                  SSD1306_SDL_SNAPSHOT_EVERY=<num>  only every num-th frame"
     echo "add_build_opts: (additional options)"
     echo "        FREQUENCY=<num>  frequency in Hz, passed as -DF_CPU=<num> to gcc/g++"
     echo "        ADAFRUIT=y       add Adafruit GFX support to ssd1306 library"
     echo ""
     echo "# example: run demo on linux with emulator"
     echo "    ./build_and_run.sh -p linux -e -f demos/ssd1306_demo"
+    echo "# example: benchmark 300 frames of demo without window"
+    echo "    SSD1306_SDL_HEADLESS=1 SSD1306_SDL_FRAMES=300 ./build_and_run.sh -p linux -e -f demos/ssd1306_demo"
     echo "# example: run demo on linux with real ssd1306 oled display"
     echo "    ./build_and_run.sh -p linux -f demos/ssd1306_demo"
     echo "# example: build demo and flash for AVR controller"
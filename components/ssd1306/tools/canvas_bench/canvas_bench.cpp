@@ -0,0 +1,214 @@
+/*
+    MIT License
+
+    Copyright (c) 2018, Alexey Dynda
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+/**
+ * Host microbenchmark for NanoCanvasOps<BPP> primitives and NanoEngineTiler
+ * refreshes. Display traffic goes to a counting interface instead of a bus,
+ * so bytes/op shows what a primitive or refresh would put on the wire.
+ */
+
+#include "ssd1306.h"
+#include "nano_engine.h"
+#include "intf/ssd1306_interface.h"
+#include "intf/spi/ssd1306_spi.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_WIDTH   128
+#define BENCH_HEIGHT  64
+
+static uint64_t s_bytes = 0;
+static uint64_t s_transactions = 0;
+static uint64_t s_durationNs = 200000000ULL;
+static const char *s_filter = NULL;
+
+static void countStart(void) { s_transactions++; }
+static void countStop(void) { }
+static void countSend(uint8_t data) { (void)data; s_bytes++; }
+static void countSendBuffer(const uint8_t *buffer, uint16_t len) { (void)buffer; s_bytes += len; }
+static void countClose(void) { }
+
+static void countingInterface(void)
+{
+    // spi framing without a D/C pin, commands are not prefixed like on i2c
+    s_ssd1306_dc = 0;
+    ssd1306_intf.spi = 1;
+    ssd1306_intf.start = countStart;
+    ssd1306_intf.stop = countStop;
+    ssd1306_intf.send = countSend;
+    ssd1306_intf.send_buffer = countSendBuffer;
+    ssd1306_intf.close = countClose;
+}
+
+static uint64_t nowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Runs op(i) until s_durationNs passes and prints time and display bytes per call */
+template<typename F>
+static void bench(const char *name, uint8_t bpp, F op)
+{
+    char title[48];
+    snprintf(title, sizeof(title), "%s/%u", name, bpp);
+    if (s_filter && !strstr(title, s_filter))
+    {
+        return;
+    }
+    s_bytes = 0;
+    s_transactions = 0;
+    uint32_t count = 0;
+    uint64_t start = nowNs();
+    uint64_t elapsed;
+    do
+    {
+        for (uint8_t i = 0; i < 16; i++)
+        {
+            op(count++);
+        }
+        elapsed = nowNs() - start;
+    } while (elapsed < s_durationNs);
+    printf("%-24s %12.1f %12.1f %10.2f\n", title, (double)elapsed / count,
+           (double)s_bytes / count, (double)s_transactions / count);
+}
+
+static NanoEngine<TILE_16x16_MONO> s_engine1;
+static NanoEngine<TILE_16x16_RGB8> s_engine8;
+static NanoEngine<TILE_8x8_RGB16> s_engine16;
+
+static uint8_t s_bitmap1[32 * 32 / 8];
+static uint8_t s_bitmap8[32 * 32];
+
+template<class C>
+static void benchCanvas(C &canvas, uint8_t bpp)
+{
+    const uint8_t w = BENCH_WIDTH;
+    const uint8_t h = BENCH_HEIGHT;
+    canvas.setColor(0xFFFF);
+    // Coordinates move with the iteration, so that every bit offset is covered
+    bench("putPixel", bpp, [&](uint32_t i) { canvas.putPixel(i % w, (i / w) % h); });
+    bench("drawHLine", bpp, [&](uint32_t i) { canvas.drawHLine(i & 7, i % h, w - 1 - (i & 7)); });
+    bench("drawVLine", bpp, [&](uint32_t i) { canvas.drawVLine(i % w, i & 7, h - 1 - (i & 7)); });
+    bench("fillRect", bpp, [&](uint32_t i) { canvas.fillRect(i & 7, i & 7, (i & 7) + 31, (i & 7) + 31); });
+    bench("drawBitmap1", bpp, [&](uint32_t i) { canvas.drawBitmap1(i & 7, i & 7, 32, 32, s_bitmap1); });
+    bench("printFixed", bpp, [&](uint32_t i) { canvas.printFixed(i & 7, 8, "Hello, world!"); });
+    bench("clear", bpp, [&](uint32_t i) { (void)i; canvas.clear(); });
+    bench("blt", bpp, [&](uint32_t i) { (void)i; canvas.blt(); });
+}
+
+/* drawBitmap8 has no 1-bit implementation */
+template<class C>
+static void benchBitmap8(C &canvas, uint8_t bpp)
+{
+    bench("drawBitmap8", bpp, [&](uint32_t i) { canvas.drawBitmap8(i & 7, i & 7, 32, 32, s_bitmap8); });
+}
+
+template<class E>
+static bool onDraw()
+{
+    E::canvas.clear();
+    E::canvas.setColor(0xFFFF);
+    E::canvas.fillRect(10, 10, 40, 30);
+    E::canvas.drawHLine(0, 50, 127);
+    E::canvas.printFixed(0, 0, "Score 1234");
+    return true;
+}
+
+template<class E>
+static void benchEngine(E &engine, const char *name, uint8_t bpp)
+{
+    engine.begin();
+    engine.drawCallback(onDraw<E>);
+    char title[32];
+    snprintf(title, sizeof(title), "%s.full", name);
+    bench(title, bpp, [&](uint32_t i) { (void)i; engine.refresh(); engine.display(); });
+    snprintf(title, sizeof(title), "%s.sprite", name);
+    // moving 8x8 sprite, old and new areas are refreshed
+    bench(title, bpp, [&](uint32_t i)
+    {
+        lcdint_t x = i % (ssd1306_lcd.width - 9);
+        engine.refresh(x, 20, x + 8, 27);
+        engine.display();
+    });
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-t ms] [-f filter]\n", name);
+    fprintf(stderr, "  -t ms      time per benchmark, 200 by default\n");
+    fprintf(stderr, "  -f filter  run benchmarks, which name/bpp contains filter\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "t:f:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 't': s_durationNs = strtoull(optarg, NULL, 0) * 1000000ULL; break;
+            case 'f': s_filter = optarg; break;
+            default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    for (size_t i = 0; i < sizeof(s_bitmap1); i++) s_bitmap1[i] = (uint8_t)(i * 37);
+    for (size_t i = 0; i < sizeof(s_bitmap8); i++) s_bitmap8[i] = (uint8_t)(i * 13);
+
+    countingInterface();
+    ssd1306_setFixedFont(ssd1306xled_font6x8);
+    printf("%-24s %12s %12s %10s\n", "benchmark/bpp", "ns/op", "bytes/op", "txn/op");
+
+    static uint8_t buffer1[BENCH_WIDTH * BENCH_HEIGHT / 8];
+    static uint8_t buffer4[BENCH_WIDTH * BENCH_HEIGHT / 2];
+    static uint8_t buffer8[BENCH_WIDTH * BENCH_HEIGHT];
+    static uint8_t buffer16[BENCH_WIDTH * BENCH_HEIGHT * 2];
+
+    ssd1306_128x64_init();
+    NanoCanvas1 canvas1(BENCH_WIDTH, BENCH_HEIGHT, buffer1);
+    benchCanvas(canvas1, 1);
+    benchEngine(s_engine1, "tiler16x16", 1);
+
+    ssd1331_96x64_init();
+    NanoCanvas8 canvas8(BENCH_WIDTH, BENCH_HEIGHT, buffer8);
+    benchCanvas(canvas8, 8);
+    benchBitmap8(canvas8, 8);
+    benchEngine(s_engine8, "tiler16x16", 8);
+
+    il9163_128x128_init();
+    NanoCanvas4 canvas4(BENCH_WIDTH, BENCH_HEIGHT, buffer4);
+    benchCanvas(canvas4, 4);
+    benchBitmap8(canvas4, 4);
+
+    NanoCanvas16 canvas16(BENCH_WIDTH, BENCH_HEIGHT, buffer16);
+    benchCanvas(canvas16, 16);
+    benchBitmap8(canvas16, 16);
+    benchEngine(s_engine16, "tiler8x8", 16);
+    return 0;
+}
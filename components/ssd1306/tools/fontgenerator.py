@@ -50,6 +50,7 @@ def print_help_and_exit():
     print "      -g <S> <E> add chars group to the font"
     print "      -f old    old format 1.7.6 and below"
     print "      -f new    new format 1.7.8 and above"
+    print "      -f indexed indexed format, binary search for large unicode sets"
     print "      -d        Print demo text to console"
     print "      --demo-only Prints demo text to console and exits"
     print "Examples:"
@@ -59,6 +60,8 @@ def print_help_and_exit():
     print "      ttf_fonts.py --ttf FreeSans.ttf -d -f new"
     print "   [convert GLCD font generated file to new format]"
     print "      ttf_fonts.py --glcd font.c -f new > ssd1306font.h"
+    print "   [convert ttf font with CJK chars to indexed format]"
+    print "      ttf_fonts.py --ttf NotoSansCJK.ttf -s 12 -g 0x4E00 255 -f indexed > ssd1306font.h"
     exit(1)
 
 if len(sys.argv) < 2:
@@ -66,6 +69,7 @@ if len(sys.argv) < 2:
 
 fsize = 8
 fold = False
+findexed = False
 flimit_bottom = 0
 fwidth = False
 fheight = False
@@ -104,6 +108,8 @@ while idx < len(sys.argv):
         idx += 1
         if sys.argv[idx] == "old":
             fold = True
+        elif sys.argv[idx] == "indexed":
+            findexed = True
     elif opt == "-g":
         idx += 1
         _start_char = sys.argv[idx]
@@ -166,5 +172,8 @@ else:
     if demo_text:
         source.printString(demo_text_.decode("utf-8"))
     if generate_font:
-        font.generate_new_format()
+        if findexed:
+            font.generate_indexed_format()
+        else:
+            font.generate_new_format()
 
@@ -29,6 +29,8 @@
 #include <linux/mutex.h>
 #include <linux/err.h>
 #include <linux/string.h>
+#include <linux/fb.h>
+#include <linux/vmalloc.h>
 
 #include "ssd1306.h"
 #include "intf/ssd1306_interface.h"
@@ -37,8 +39,19 @@
 
 #define DEVICE_CLASS_NAME "ssd1306_lcd"
 
+/*
+ * The panel is also a framebuffer device, 1 bit per pixel, lsb on the left.
+ * Needs CONFIG_FB_DEFERRED_IO and the CONFIG_FB_SYS_* helpers.
+ */
+#define SSD1306_FB_WIDTH	128
+#define SSD1306_FB_HEIGHT	64
+#define SSD1306_FB_PAGES	(SSD1306_FB_HEIGHT / 8)
+#define SSD1306_FB_LINE		(SSD1306_FB_WIDTH / 8)
+#define SSD1306_FB_SIZE		(SSD1306_FB_LINE * SSD1306_FB_HEIGHT)
+
 static int bus = 1;
 static int addr = 0x3C;
+static int fps = 20;
 static struct i2c_client *s_client = NULL;
 static struct ssd1306_data *s_data = NULL;
 //static struct class *ssd1306_class = NULL;
@@ -48,13 +61,20 @@ module_param(addr, int, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
 
 MODULE_PARM_DESC(bus, " I2C Bus number, default 1");
 MODULE_PARM_DESC(addr, " I2C device address, default 0x3C");
+module_param(fps, int, S_IRUSR | S_IRGRP);
+MODULE_PARM_DESC(fps, " Framebuffer refreshes per second, default 20");
 
 struct ssd1306_data {
 	struct mutex lock;
-	u8 index;
-	/// According to https://www.kernel.org/doc/Documentation/i2c/dev-interface
-	/// block buffers need not be longer than 32 bytes
-	u8 data[24];
+	u16 index;
+	/// Sent with i2c_master_send, room for the control byte and a full page
+	u8 data[1 + SSD1306_FB_WIDTH];
+	struct fb_info *info;
+	struct fb_deferred_io defio;
+	u8 *vmem;
+	/// What the panel shows, in its page layout
+	u8 shown[SSD1306_FB_PAGES][SSD1306_FB_WIDTH];
+	u8 page[SSD1306_FB_WIDTH];
 };
 
 
@@ -66,9 +86,11 @@ static void ssd1306_smbus_start(void) {
 
 static void ssd1306_smbus_send(u8 data) {
 	if (s_data->index >= sizeof(s_data->data)) {
+		/* go on in the mode the transmission started with */
+		u8 control = s_data->data[0];
 		ssd1306_smbus_end();
 		ssd1306_smbus_start();
-		s_data->data[0] = 0x40;
+		s_data->data[0] = control;
 		s_data->index++;
 	}
 	s_data->data[s_data->index] = data;
@@ -85,7 +107,7 @@ static void ssd1306_smbus_send_bytes(const u8 *buffer, u16 size)
 
 static void ssd1306_smbus_end(void) {
 	if (s_data->index) {
-		i2c_smbus_write_i2c_block_data(s_client, s_data->data[0], s_data->index - 1, &s_data->data[1]);
+		i2c_master_send(s_client, s_data->data, s_data->index);
 		s_data->index=0;
 	}
 }
@@ -94,6 +116,154 @@ static void ssd1306_smbus_close(void) {
 }
 
 
+/*
+ * Refreshes the pages of the panel that differ from the framebuffer, from
+ * the first to the last changed column. Called from the deferred io work.
+ */
+static void ssd1306_fb_update(struct ssd1306_data *data)
+{
+	int p, x, bit;
+
+	mutex_lock(&data->lock);
+	s_data = data;
+	for (p = 0; p < SSD1306_FB_PAGES; p++) {
+		int left, right;
+		for (x = 0; x < SSD1306_FB_WIDTH; x++) {
+			u8 column = 0;
+			for (bit = 0; bit < 8; bit++) {
+				const u8 *line = data->vmem + (p * 8 + bit) * SSD1306_FB_LINE;
+				column |= ((line[x / 8] >> (x % 8)) & 1) << bit;
+			}
+			data->page[x] = column;
+		}
+		for (left = 0; left < SSD1306_FB_WIDTH && data->page[left] == data->shown[p][left]; left++)
+			;
+		if (left == SSD1306_FB_WIDTH)
+			continue;
+		for (right = SSD1306_FB_WIDTH - 1; data->page[right] == data->shown[p][right]; right--)
+			;
+		ssd1306_drawBuffer(left, p * 8, right - left + 1, 8, &data->page[left]);
+		memcpy(&data->shown[p][left], &data->page[left], right - left + 1);
+	}
+	mutex_unlock(&data->lock);
+}
+
+static void ssd1306_fb_deferred_io(struct fb_info *info, struct list_head *pagelist)
+{
+	ssd1306_fb_update(info->par);
+}
+
+/* Drawing by fbcon and write() does not fault pages in, schedule the refresh */
+static void ssd1306_fb_touch(struct fb_info *info)
+{
+	schedule_delayed_work(&info->deferred_work, info->fbdefio->delay);
+}
+
+static ssize_t ssd1306_fb_write(struct fb_info *info, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	ssize_t res = fb_sys_write(info, buf, count, ppos);
+	if (res > 0)
+		ssd1306_fb_touch(info);
+	return res;
+}
+
+static void ssd1306_fb_fillrect(struct fb_info *info, const struct fb_fillrect *rect)
+{
+	sys_fillrect(info, rect);
+	ssd1306_fb_touch(info);
+}
+
+static void ssd1306_fb_copyarea(struct fb_info *info, const struct fb_copyarea *area)
+{
+	sys_copyarea(info, area);
+	ssd1306_fb_touch(info);
+}
+
+static void ssd1306_fb_imageblit(struct fb_info *info, const struct fb_image *image)
+{
+	sys_imageblit(info, image);
+	ssd1306_fb_touch(info);
+}
+
+static struct fb_ops ssd1306_fb_ops = {
+	.owner		= THIS_MODULE,
+	.fb_read	= fb_sys_read,
+	.fb_write	= ssd1306_fb_write,
+	.fb_fillrect	= ssd1306_fb_fillrect,
+	.fb_copyarea	= ssd1306_fb_copyarea,
+	.fb_imageblit	= ssd1306_fb_imageblit,
+};
+
+static const struct fb_fix_screeninfo ssd1306_fb_fix = {
+	.id		= "ssd1306",
+	.type		= FB_TYPE_PACKED_PIXELS,
+	.visual		= FB_VISUAL_MONO10,
+	.line_length	= SSD1306_FB_LINE,
+	.smem_len	= SSD1306_FB_SIZE,
+	.accel		= FB_ACCEL_NONE,
+};
+
+static const struct fb_var_screeninfo ssd1306_fb_var = {
+	.xres		= SSD1306_FB_WIDTH,
+	.yres		= SSD1306_FB_HEIGHT,
+	.xres_virtual	= SSD1306_FB_WIDTH,
+	.yres_virtual	= SSD1306_FB_HEIGHT,
+	.bits_per_pixel	= 1,
+	.red		= { 0, 1, 0 },
+	.green		= { 0, 1, 0 },
+	.blue		= { 0, 1, 0 },
+};
+
+static int ssd1306_fb_register(struct i2c_client *client, struct ssd1306_data *data)
+{
+	struct fb_info *info;
+	int err;
+
+	info = framebuffer_alloc(0, &client->dev);
+	if (!info)
+		return -ENOMEM;
+	/* vmalloc memory, deferred io maps it page by page */
+	data->vmem = vzalloc(SSD1306_FB_SIZE);
+	if (!data->vmem) {
+		framebuffer_release(info);
+		return -ENOMEM;
+	}
+	info->fbops = &ssd1306_fb_ops;
+	info->fix = ssd1306_fb_fix;
+	info->var = ssd1306_fb_var;
+	info->screen_base = (u8 __force __iomem *)data->vmem;
+	info->par = data;
+	info->flags = FBINFO_DEFAULT | FBINFO_VIRTFB;
+	data->defio.delay = HZ / (fps > 0 ? fps : 20);
+	data->defio.deferred_io = ssd1306_fb_deferred_io;
+	info->fbdefio = &data->defio;
+	fb_deferred_io_init(info);
+
+	err = register_framebuffer(info);
+	if (err) {
+		fb_deferred_io_cleanup(info);
+		vfree(data->vmem);
+		framebuffer_release(info);
+		return err;
+	}
+	data->info = info;
+	dev_info(&client->dev, "fb%d: %dx%d framebuffer\n", info->node,
+		 SSD1306_FB_WIDTH, SSD1306_FB_HEIGHT);
+	return 0;
+}
+
+static void ssd1306_fb_unregister(struct ssd1306_data *data)
+{
+	if (!data->info)
+		return;
+	unregister_framebuffer(data->info);
+	fb_deferred_io_cleanup(data->info);
+	vfree(data->vmem);
+	framebuffer_release(data->info);
+	data->info = NULL;
+}
+
 static ssize_t show_commands(struct device *dev,
 				struct device_attribute *attr, char *buf)
 {
@@ -113,8 +283,10 @@ static ssize_t execute_command(struct device *dev,
 
 	mutex_lock(&s_data->lock);
 	sscanf(buf, "%15s", cmd);
-	if (!strcmp(cmd, "clear"))
+	if (!strcmp(cmd, "clear")) {
 		ssd1306_clearScreen();
+		memset(s_data->shown, 0, sizeof(s_data->shown));
+	}
 	else if (!strcmp(cmd, "pixel")) {
 		int x, y;
 		sscanf(&buf[strlen(cmd) + 1], "%d,%d", &x, &y);
@@ -158,25 +330,32 @@ static int ssd1306_probe(struct i2c_client *client,
 	mutex_lock(&data->lock);
 	s_client = client;
 	ssd1306_128x64_init();
+	/* blank, like the framebuffer, so that only what changes is sent */
 	ssd1306_fillScreen(0x00);
 	ssd1306_setFixedFont(ssd1306xled_font6x8);
-	ssd1306_printFixed (0,  8, "Line 1. text", 0); // STYLE_NORMAL
 	mutex_unlock(&data->lock);
 
+	err = ssd1306_fb_register(client, data);
+	if (err)
+		return err;
+
 
 //	ssd1306_class = class_create(THIS_MODULE, DEVICE_CLASS_NAME);
 	/* Register sysfs hooks */
 	err = sysfs_create_group(&client->dev.kobj, &ssd1306_attr_group);
-	if (err)
+	if (err) {
+		ssd1306_fb_unregister(data);
 		return err;
+	}
 
 	return 0;
 }
 
 static int ssd1306_remove(struct i2c_client *client)
 {
-//	struct ssd1306_data *data = i2c_get_clientdata(client);
+	struct ssd1306_data *data = i2c_get_clientdata(client);
 	sysfs_remove_group(&client->dev.kobj, &ssd1306_attr_group);
+	ssd1306_fb_unregister(data);
 	return 0;
 }
 
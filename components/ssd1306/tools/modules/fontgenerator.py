@@ -124,3 +124,86 @@ class Generator:
         print "    // FONT REQUIRES %d BYTES" % (total_size)
         print "};"
 
+
+    # Returns (width, height, bytes) of the char as the new and indexed formats keep it
+    def _char_data(self, char):
+        bitmap = self.source.charBitmap(char)
+        width = len(bitmap[0])
+        height = len(bitmap)
+        while (height > 0) and (sum(bitmap[height -1]) == 0):
+            height -= 1
+        data = []
+        for row in range((height + 7) / 8):
+            for x in range(width):
+                byte = 0
+                for i in range(8):
+                    y = row * 8 + i
+                    if y >= len(bitmap):
+                       break
+                    byte |= (bitmap[y][x] << i)
+                data.append(byte)
+        return (width, height, data)
+
+    # Splits sorted chars into blocks of the indexed format. Gaps up to max_gap
+    # chars are filled with empty entries, which cost less than a directory entry.
+    def _indexed_blocks(self, chars, max_gap = 1):
+        blocks = []
+        for char in chars:
+            code = ord(char)
+            width, height, data = self._char_data(char)
+            if len(blocks) > 0:
+                b = blocks[-1]
+                gap = code - b['start'] - len(b['chars'])
+                if gap <= max_gap and b['size'] + len(data) < 0xFFFF:
+                    b['chars'].extend([None] * gap)
+                    b['chars'].append((char, width, height, data))
+                    b['size'] += len(data)
+                    continue
+            blocks.append({'start': code, 'chars': [(char, width, height, data)], 'size': len(data)})
+        return blocks
+
+    def generate_indexed_format(self):
+        self.source.expand_chars_top()
+        chars = sorted(set(self.source.get_group_chars()), key=ord)
+        blocks = self._indexed_blocks(chars)
+        # block offsets count from the block count, following the header
+        offset = 2 + len(blocks) * 8
+        for b in blocks:
+            b['offset'] = offset
+            offset += len(b['chars']) * 4 + b['size']
+        total_size = 4 + offset
+        print "extern const uint8_t %s[] PROGMEM;" % ("indexed_" + self.source.name)
+        print "const uint8_t %s[] PROGMEM =" % ("indexed_" + self.source.name)
+        print "{"
+        print "//  type|width|height|first char"
+        print "    0x%02X, 0x%02X, 0x%02X, 0x%02X," % (4, self.source.width, self.source.height, 0x00)
+        print "//  blocks(2B)"
+        print "    0x%02X, 0x%02X," % ((len(blocks) >> 8) & 0xFF, len(blocks) & 0xFF)
+        print "//  unicode(2B)|count(2B)|offset(4B)"
+        for b in blocks:
+            count = len(b['chars'])
+            print "    0x%02X, 0x%02X, 0x%02X, 0x%02X, 0x%02X, 0x%02X, 0x%02X, 0x%02X," % \
+                 ((b['start'] >> 8) & 0xFF, b['start'] & 0xFF, (count >> 8) & 0xFF, count & 0xFF,
+                  (b['offset'] >> 24) & 0xFF, (b['offset'] >> 16) & 0xFF, (b['offset'] >> 8) & 0xFF, b['offset'] & 0xFF),
+            print "// block 0x%04X, %d chars" % (b['start'], count)
+        for b in blocks:
+            print "// BLOCK first 0x%04X total %d chars" % (b['start'], len(b['chars']))
+            # jump table
+            offset = 0
+            for code, c in enumerate(b['chars'], b['start']):
+                if c is None:
+                    print "    0xFF, 0xFF, 0x00, 0x00, // no char (0x%04X/%d)" % (code, code)
+                    continue
+                print "    0x%02X, 0x%02X, 0x%02X, 0x%02X," % (offset >> 8, offset & 0xFF, c[1], c[2]),
+                print "// char '%s' (0x%04X/%d)" % (c[0].encode("utf-8"), code, code)
+                offset += len(c[3])
+            # char data
+            for c in b['chars']:
+                if c is None or len(c[3]) == 0:
+                    continue
+                print "   ",
+                for byte in c[3]:
+                    print "0x%02X," % byte,
+                print "// char '%s' (0x%04X/%d)" % (c[0].encode("utf-8"), ord(c[0]), ord(c[0]))
+        print "    // FONT REQUIRES %d BYTES" % (total_size)
+        print "};"
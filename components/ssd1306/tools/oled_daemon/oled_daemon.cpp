@@ -0,0 +1,296 @@
+/*
+    MIT License
+
+    Copyright (c) 2018, Alexey Dynda
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "ssd1306.h"
+#include "intf/ssd1306_interface.h"
+#include "oled_daemon.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static volatile sig_atomic_t s_quit = 0;
+static oled_daemon_shm_t *s_shm = NULL;
+/** What the display shows, compared with the shared frame buffer on every flush */
+static uint8_t s_shown[OLED_DAEMON_MAX_PAGES][OLED_DAEMON_MAX_WIDTH];
+
+static void on_signal(int sig)
+{
+    s_quit = 1;
+}
+
+static int64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int init_interface(char *intf, char *bus, char *devId)
+{
+#if defined(CONFIG_PLATFORM_SPI_ENABLE)
+    if (!strcmp(intf, "spi"))
+    {
+        ssd1306_platform_spiInit(bus[0] - '0', strtol(devId, NULL, 16), -1);
+    }
+    else
+#endif
+    if (!strcmp(intf, "i2c"))
+    {
+        ssd1306_platform_i2cInit(bus[0] - '0', strtol(devId, NULL, 16), -1);
+    }
+    else
+    {
+        return -1;
+    }
+    return 0;
+}
+
+static int init_driver(char *driver)
+{
+    if (!strcmp(driver, "ssd1306_128x64")) ssd1306_128x64_init();
+    else if (!strcmp(driver, "ssd1306_128x32")) ssd1306_128x32_init();
+    else if (!strcmp(driver, "sh1106_128x64")) sh1106_128x64_init();
+    else return -1;
+    ssd1306_clearScreen();
+    return 0;
+}
+
+static int open_shm(void)
+{
+    int fd = shm_open(OLED_DAEMON_SHM, O_CREAT | O_RDWR, 0666);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to open shared memory: %s\n", strerror(errno));
+        return -1;
+    }
+    if (ftruncate(fd, sizeof(oled_daemon_shm_t)) < 0)
+    {
+        fprintf(stderr, "Failed to size shared memory: %s\n", strerror(errno));
+        close(fd);
+        return -1;
+    }
+    s_shm = (oled_daemon_shm_t *)mmap(NULL, sizeof(oled_daemon_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (s_shm == MAP_FAILED)
+    {
+        s_shm = NULL;
+        fprintf(stderr, "Failed to map shared memory: %s\n", strerror(errno));
+        return -1;
+    }
+    memset(s_shm, 0, sizeof(oled_daemon_shm_t));
+    s_shm->width = ssd1306_displayWidth();
+    s_shm->height = ssd1306_displayHeight();
+    s_shm->magic = OLED_DAEMON_MAGIC;
+    return 0;
+}
+
+static int open_socket(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to create socket: %s\n", strerror(errno));
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        fprintf(stderr, "Failed to bind %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Sends the columns of every page that differ from what is shown, one block
+ * from the first to the last changed column of a page.
+ */
+static void flush_pages(void)
+{
+    uint8_t width = s_shm->width > OLED_DAEMON_MAX_WIDTH ? OLED_DAEMON_MAX_WIDTH : s_shm->width;
+    uint8_t pages = s_shm->height >> 3;
+    uint8_t page[OLED_DAEMON_MAX_WIDTH];
+    if (pages > OLED_DAEMON_MAX_PAGES)
+    {
+        pages = OLED_DAEMON_MAX_PAGES;
+    }
+    for (uint8_t p = 0; p < pages; p++)
+    {
+        // a client may draw meanwhile, work on a copy
+        memcpy(page, s_shm->pages[p], width);
+        uint8_t left = 0;
+        while (left < width && page[left] == s_shown[p][left])
+        {
+            left++;
+        }
+        if (left == width)
+        {
+            continue;
+        }
+        uint8_t right = width - 1;
+        while (page[right] == s_shown[p][right])
+        {
+            right--;
+        }
+        ssd1306_drawBuffer(left, p * 8, right - left + 1, 8, &page[left]);
+        memcpy(&s_shown[p][left], &page[left], right - left + 1);
+    }
+    s_shm->flushes++;
+}
+
+static void handle_command(const char *cmd, int *pending)
+{
+    if (!strcmp(cmd, "flush"))
+    {
+        *pending = 1;
+    }
+    else if (!strcmp(cmd, "clear"))
+    {
+        memset(s_shm->pages, 0, sizeof(s_shm->pages));
+        *pending = 1;
+    }
+    else if (!strcmp(cmd, "quit"))
+    {
+        s_quit = 1;
+    }
+    else
+    {
+        fprintf(stderr, "Unknown command: %s\n", cmd);
+    }
+}
+
+static void run(int sock, int fps)
+{
+    int pending = 0;
+    int64_t next = 0;
+    struct pollfd pfd;
+    pfd.fd = sock;
+    pfd.events = POLLIN;
+    while (!s_quit)
+    {
+        // doorbells rung before the next slot are merged into one update
+        int timeout = -1;
+        if (pending)
+        {
+            int64_t wait = next - now_ms();
+            timeout = wait > 0 ? (int)wait : 0;
+        }
+        int ready = poll(&pfd, 1, timeout);
+        if (ready < 0 && errno != EINTR)
+        {
+            fprintf(stderr, "poll failed: %s\n", strerror(errno));
+            break;
+        }
+        if (ready > 0 && (pfd.revents & POLLIN))
+        {
+            char cmd[64];
+            ssize_t len = recv(sock, cmd, sizeof(cmd) - 1, 0);
+            if (len > 0)
+            {
+                while (len > 0 && (cmd[len - 1] == '\n' || cmd[len - 1] == '\r'))
+                {
+                    len--;
+                }
+                cmd[len] = '\0';
+                handle_command(cmd, &pending);
+            }
+        }
+        int64_t now = now_ms();
+        if (pending && now >= next)
+        {
+            flush_pages();
+            pending = 0;
+            next = now + 1000 / fps;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 5)
+    {
+        fprintf(stderr, "Usage: oled_daemon [interface] [bus] [devId] [oled_driver] [fps] [socket]\n");
+        fprintf(stderr, "        interface     - spi, i2c\n");
+        fprintf(stderr, "        bus           - i2c-bus number or spidev  bus number\n");
+        fprintf(stderr, "        devId         - i2c-bus device address or spi device number in hex\n");
+        fprintf(stderr, "        oled_driver   - ssd1306_128x64, ssd1306_128x32, sh1106_128x64\n");
+        fprintf(stderr, "        fps           - most updates per second, %d by default\n", OLED_DAEMON_DEFAULT_FPS);
+        fprintf(stderr, "        socket        - command socket, %s by default\n", OLED_DAEMON_SOCKET);
+        fprintf(stderr, "Example: oled_daemon i2c 1 0x3c ssd1306_128x64\n");
+        return 1;
+    }
+    int fps = argc > 5 ? atoi(argv[5]) : OLED_DAEMON_DEFAULT_FPS;
+    const char *path = argc > 6 ? argv[6] : OLED_DAEMON_SOCKET;
+    if (fps <= 0)
+    {
+        fps = OLED_DAEMON_DEFAULT_FPS;
+    }
+    if (init_interface(argv[1], argv[2], argv[3]) < 0)
+    {
+        fprintf(stderr, "Unknown interface %s\n", argv[1]);
+        return 1;
+    }
+    if (init_driver(argv[4]) < 0)
+    {
+        fprintf(stderr, "Unknown driver %s\n", argv[4]);
+        return 1;
+    }
+    int res = 1;
+    int sock = -1;
+    if (open_shm() == 0 && (sock = open_socket(path)) >= 0)
+    {
+        signal(SIGINT, on_signal);
+        signal(SIGTERM, on_signal);
+        fprintf(stderr, "Serving %s on %s\n", OLED_DAEMON_SHM, path);
+        run(sock, fps);
+        res = 0;
+    }
+    if (sock >= 0)
+    {
+        close(sock);
+        unlink(path);
+    }
+    if (s_shm)
+    {
+        munmap(s_shm, sizeof(oled_daemon_shm_t));
+        shm_unlink(OLED_DAEMON_SHM);
+    }
+    ssd1306_intf.close();
+    return res;
+}
@@ -0,0 +1,67 @@
+/*
+    MIT License
+
+    Copyright (c) 2018, Alexey Dynda
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+/**
+ * @file oled_daemon.h Shared memory layout and commands of oled_daemon
+ *
+ * oled_daemon owns the display and maps a frame buffer into shared memory.
+ * Clients map OLED_DAEMON_SHM, draw into pages[], and ring the doorbell by
+ * sending "flush" as a datagram to the daemon socket. The daemon compares the
+ * frame buffer with what is on the display and sends only the columns that
+ * changed, at most OLED_DAEMON_DEFAULT_FPS times a second.
+ *
+ * Commands, one per datagram:
+ * - flush - send what changed
+ * - clear - clear the frame buffer and the display
+ * - quit  - stop the daemon
+ */
+
+#ifndef _OLED_DAEMON_H_
+#define _OLED_DAEMON_H_
+
+#include <stdint.h>
+
+/** Name of the shared memory object, for shm_open() */
+#define OLED_DAEMON_SHM            "/oled_daemon"
+/** Default path of the unix datagram socket */
+#define OLED_DAEMON_SOCKET         "/tmp/oled_daemon.sock"
+/** Default cap on display updates per second */
+#define OLED_DAEMON_DEFAULT_FPS    20
+
+#define OLED_DAEMON_MAGIC          0x4F4C4544
+#define OLED_DAEMON_MAX_WIDTH      128
+#define OLED_DAEMON_MAX_PAGES      8
+
+/** Frame buffer in shared memory */
+typedef struct
+{
+    uint32_t magic;        ///< OLED_DAEMON_MAGIC once the daemon is up
+    uint16_t width;        ///< display width in pixels
+    uint16_t height;       ///< display height in pixels
+    uint32_t flushes;      ///< updates sent to the display so far
+    /** ssd1306 layout, each byte is a column of 8 vertical pixels, lsb on top */
+    uint8_t  pages[OLED_DAEMON_MAX_PAGES][OLED_DAEMON_MAX_WIDTH];
+} oled_daemon_shm_t;
+
+#endif
@@ -0,0 +1,322 @@
+/*
+    MIT License
+
+    Copyright (c) 2018, Alexey Dynda
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "ssd1306.h"
+#include "intf/ssd1306_interface.h"
+#include "intf/spi/ssd1306_spi.h"
+#if defined(SDL_EMULATION)
+#include "sdl_core.h"
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Event types and header of ssd1306_intfTraceAttach(), see intf/ssd1306_interface.h */
+enum
+{
+    TRACE_START = 1,
+    TRACE_STOP  = 2,
+    TRACE_DATA  = 3,
+    TRACE_DC_LOW  = 4,
+    TRACE_DC_HIGH = 5,
+};
+
+#define TRACE_VERSION       1
+#define TRACE_HEADER_SIZE   8
+
+typedef struct
+{
+    uint32_t events;
+    uint32_t transactions;
+    uint64_t bytes;
+    uint64_t traced_us;     // sum of the recorded deltas
+} replay_stats_t;
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint8_t *load_trace(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    uint8_t *data = NULL;
+    size_t len = 0;
+    if (!f)
+    {
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    while (1)
+    {
+        uint8_t *grown = (uint8_t *)realloc(data, len + 65536);
+        if (!grown)
+        {
+            free(data);
+            fclose(f);
+            return NULL;
+        }
+        data = grown;
+        size_t n = fread(data + len, 1, 65536, f);
+        len += n;
+        if (n < 65536)
+        {
+            break;
+        }
+    }
+    fclose(f);
+    if (len < TRACE_HEADER_SIZE || memcmp(data, "SSDT", 4) || data[4] != TRACE_VERSION)
+    {
+        fprintf(stderr, "%s is not a version %d ssd1306 trace\n", path, TRACE_VERSION);
+        free(data);
+        return NULL;
+    }
+    *size = len;
+    return data;
+}
+
+static int init_interface(int spi, int argc, char *argv[])
+{
+#if defined(SDL_EMULATION)
+    // the emulator needs no bus, but the D/C pin to tell commands from data
+    if (spi)
+    {
+        ssd1306_platform_spiInit(-1, -1, s_ssd1306_dc);
+    }
+    else
+    {
+        ssd1306_platform_i2cInit(-1, 0, -1);
+    }
+    return 0;
+#else
+    if (argc < 2)
+    {
+        fprintf(stderr, "Bus and device of the display are missing\n");
+        return -1;
+    }
+    if (spi)
+    {
+#if defined(CONFIG_PLATFORM_SPI_ENABLE)
+        ssd1306_platform_spiInit(argv[0][0] - '0', strtol(argv[1], NULL, 16),
+                                 argc > 2 ? strtol(argv[2], NULL, 10) : -1);
+        return 0;
+#else
+        fprintf(stderr, "The trace was taken over spi, the library is built without spi\n");
+        return -1;
+#endif
+    }
+    ssd1306_platform_i2cInit(argv[0][0] - '0', strtol(argv[1], NULL, 16), -1);
+    return 0;
+#endif
+}
+
+#if defined(SDL_EMULATION)
+/* Traces from real hardware lack the byte that selects the emulated controller */
+static int announce_lcd(const char *name)
+{
+    static const struct { const char *name; uint8_t type; } lcds[] =
+    {
+        { "ssd1306", SDL_LCD_SSD1306 }, { "sh1106", SDL_LCD_SH1106 },
+        { "pcd8544", SDL_LCD_PCD8544 }, { "ssd1325", SDL_LCD_SSD1325 },
+        { "ssd1331", SDL_LCD_SSD1331 }, { "ssd1351", SDL_LCD_SSD1351 },
+        { "il9163", SDL_LCD_IL9163 }, { "st7735", SDL_LCD_ST7735 },
+        { "ili9341", SDL_LCD_ILI9341 },
+    };
+    for (size_t i = 0; i < sizeof(lcds) / sizeof(lcds[0]); i++)
+    {
+        if (!strcmp(name, lcds[i].name))
+        {
+            ssd1306_intf.start();
+            if (ssd1306_intf.spi)
+                ssd1306_spiDataMode(0);
+            else
+                ssd1306_intf.send(0x00);
+            ssd1306_intf.send(lcds[i].type);
+            ssd1306_intf.send(0x00);
+            ssd1306_intf.stop();
+            return 0;
+        }
+    }
+    fprintf(stderr, "Unknown controller %s\n", name);
+    return -1;
+}
+#endif
+
+/**
+ * Sends the events of the trace to ssd1306_intf, waiting for the recorded
+ * time between them unless max_speed is set. Returns -1 for a broken trace.
+ */
+static int replay(const uint8_t *trace, size_t size, int max_speed, replay_stats_t *stats)
+{
+    size_t pos = TRACE_HEADER_SIZE;
+    int64_t due = now_us();
+    while (pos < size)
+    {
+        uint8_t type = trace[pos++];
+        uint32_t delta = 0;
+        for (int shift = 0; ; shift += 7)
+        {
+            if (pos >= size || shift > 28)
+            {
+                return -1;
+            }
+            uint8_t b = trace[pos++];
+            delta |= (uint32_t)(b & 0x7F) << shift;
+            if (!(b & 0x80))
+            {
+                break;
+            }
+        }
+        stats->traced_us += delta;
+        if (!max_speed)
+        {
+            due += delta;
+            int64_t wait = due - now_us();
+            if (wait > 0)
+            {
+                usleep(wait);
+            }
+        }
+        stats->events++;
+        switch (type)
+        {
+            case TRACE_START:
+                ssd1306_intf.start();
+                break;
+            case TRACE_STOP:
+                ssd1306_intf.stop();
+                stats->transactions++;
+                break;
+            case TRACE_DATA:
+            {
+                if (pos + 2 > size)
+                {
+                    return -1;
+                }
+                uint16_t len = trace[pos] | (trace[pos + 1] << 8);
+                pos += 2;
+                if (pos + len > size)
+                {
+                    return -1;
+                }
+                ssd1306_intf.send_buffer(&trace[pos], len);
+                stats->bytes += len;
+                pos += len;
+                break;
+            }
+            case TRACE_DC_LOW:
+            case TRACE_DC_HIGH:
+                ssd1306_spiDataMode(type == TRACE_DC_HIGH);
+                break;
+            default:
+                return -1;
+        }
+    }
+    return 0;
+}
+
+static void print_help_and_exit(const char *name)
+{
+    fprintf(stderr, "Usage: %s [options] trace bus devId [dcPin]\n", name);
+    fprintf(stderr, "       replays a trace of ssd1306_intfTraceAttach() on a display\n");
+    fprintf(stderr, "       over the interface it was taken with, i2c or spi\n");
+    fprintf(stderr, "options:\n");
+    fprintf(stderr, "       -m          as fast as possible, not at the recorded speed\n");
+    fprintf(stderr, "       -n count    replay count times\n");
+#if defined(SDL_EMULATION)
+    fprintf(stderr, "       -e lcd      announce controller to the emulator, for traces\n");
+    fprintf(stderr, "                   taken on hardware: ssd1306, sh1106, ssd1331, ili9341...\n");
+#endif
+    fprintf(stderr, "Example: %s -m capture.bin 1 0x3c\n", name);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    int max_speed = 0;
+    int count = 1;
+    const char *lcd = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "mn:e:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'm': max_speed = 1; break;
+            case 'n': count = atoi(optarg); break;
+            case 'e': lcd = optarg; break;
+            default: print_help_and_exit(argv[0]);
+        }
+    }
+    if (optind >= argc || count < 1)
+    {
+        print_help_and_exit(argv[0]);
+    }
+    size_t size;
+    uint8_t *trace = load_trace(argv[optind], &size);
+    if (!trace)
+    {
+        return 1;
+    }
+    if (init_interface(trace[5], argc - optind - 1, &argv[optind + 1]) < 0)
+    {
+        free(trace);
+        return 1;
+    }
+#if defined(SDL_EMULATION)
+    if (lcd && announce_lcd(lcd) < 0)
+    {
+        free(trace);
+        return 1;
+    }
+#else
+    (void)lcd;
+#endif
+    replay_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    int64_t started = now_us();
+    int result = 0;
+    for (int i = 0; i < count && !result; i++)
+    {
+        result = replay(trace, size, max_speed, &stats);
+    }
+    int64_t elapsed = now_us() - started;
+    if (result < 0)
+    {
+        fprintf(stderr, "Trace is broken after %u events\n", stats.events);
+    }
+    printf("%u events, %u transactions, %llu bytes\n", stats.events, stats.transactions,
+           (unsigned long long)stats.bytes);
+    printf("recorded %llu.%03llu ms, replayed in %lld.%03lld ms\n",
+           (unsigned long long)(stats.traced_us / 1000), (unsigned long long)(stats.traced_us % 1000),
+           (long long)(elapsed / 1000), (long long)(elapsed % 1000));
+    ssd1306_intf.close();
+    free(trace);
+    return result < 0 ? 1 : 0;
+}
@@ -54,6 +54,31 @@ static uint8_t s_gpioKeys[6] = {0};
 static sdl_oled_info *p_oled_db[128] = { NULL };
 static sdl_oled_info *p_active_driver = NULL;
 
+static uint32_t s_lastRefresh = 0;
+static int s_refreshPending = 0;
+
+/* Bus statistics, enabled by SSD1306_SDL_STATS, SSD1306_SDL_FRAMES or headless mode */
+typedef struct
+{
+    uint64_t transactions;
+    uint64_t bytes;
+    uint64_t commands;
+    uint64_t data;
+    uint64_t busy_us;
+} sdl_bus_stats;
+
+static int s_statsEnabled = 0;
+static sdl_bus_stats s_total;
+static sdl_bus_stats s_frame;
+static uint32_t s_commandMix[256];
+static uint32_t s_frames = 0;
+static uint32_t s_frameLimit = 0;
+static uint64_t s_frameStart = 0;
+static uint64_t s_sleptUs = 0;
+static FILE *s_statsFile = NULL;
+static const char *s_snapshotPattern = NULL;
+static uint32_t s_snapshotEvery = 1;
+
 static void register_oled(sdl_oled_info *oled_info)
 {
     sdl_oled_info **p = p_oled_db;
@@ -61,6 +86,122 @@ static void register_oled(sdl_oled_info *oled_info)
     *p = oled_info;
 }
 
+static uint64_t sdl_micros(void)
+{
+    return SDL_GetPerformanceCounter() * 1000000 / SDL_GetPerformanceFrequency();
+}
+
+static void sdl_stats_print(void)
+{
+    uint32_t frames = s_frames ? s_frames : 1;
+    fprintf(stderr, "sdl: %u frames, %llu transactions, %llu bytes (%llu command, %llu data)\n",
+            s_frames,
+            (unsigned long long)s_total.transactions,
+            (unsigned long long)s_total.bytes,
+            (unsigned long long)s_total.commands,
+            (unsigned long long)s_total.data);
+    fprintf(stderr, "sdl: per frame %llu bytes, %llu.%03llu ms busy\n",
+            (unsigned long long)(s_total.bytes / frames),
+            (unsigned long long)(s_total.busy_us / frames / 1000),
+            (unsigned long long)(s_total.busy_us / frames % 1000));
+    for (int i=0; i<256; i++)
+    {
+        if (s_commandMix[i])
+        {
+            fprintf(stderr, "sdl: command 0x%02X x %u\n", i, s_commandMix[i]);
+        }
+    }
+    if (s_statsFile)
+    {
+        fclose(s_statsFile);
+        s_statsFile = NULL;
+    }
+}
+
+static void sdl_stats_init(void)
+{
+    const char *value;
+    if (s_statsEnabled)
+    {
+        return;
+    }
+    if ((value = getenv("SSD1306_SDL_STATS")) != NULL)
+    {
+        s_statsFile = fopen(value, "w");
+        if (s_statsFile)
+        {
+            fprintf(s_statsFile, "frame,busy_us,transactions,bytes,commands,data\n");
+        }
+        s_statsEnabled = 1;
+    }
+    if ((value = getenv("SSD1306_SDL_FRAMES")) != NULL)
+    {
+        s_frameLimit = strtoul(value, NULL, 0);
+        s_statsEnabled = 1;
+    }
+    if ((value = getenv("SSD1306_SDL_SNAPSHOT_EVERY")) != NULL)
+    {
+        s_snapshotEvery = strtoul(value, NULL, 0);
+        if (!s_snapshotEvery) s_snapshotEvery = 1;
+    }
+    s_snapshotPattern = getenv("SSD1306_SDL_SNAPSHOT");
+    if (sdl_graphics_is_headless())
+    {
+        s_statsEnabled = 1;
+    }
+    if (s_statsEnabled)
+    {
+        s_frameStart = sdl_micros();
+        atexit(sdl_stats_print);
+    }
+}
+
+/* Called once a frame is complete, i.e. each time the window is redrawn */
+static void sdl_core_frame(void)
+{
+    s_lastRefresh = SDL_GetTicks();
+    s_refreshPending = 0;
+    sdl_graphics_refresh();
+    s_frames++;
+    if (s_snapshotPattern && (s_frames % s_snapshotEvery) == 0)
+    {
+        char path[256];
+        snprintf(path, sizeof(path), s_snapshotPattern, s_frames);
+        if (sdl_graphics_snapshot(path) < 0)
+        {
+            fprintf(stderr, "sdl: failed to write %s\n", path);
+        }
+    }
+    if (!s_statsEnabled)
+    {
+        return;
+    }
+    uint64_t now = sdl_micros();
+    uint64_t elapsed = now - s_frameStart;
+    s_frame.busy_us = elapsed > s_sleptUs ? elapsed - s_sleptUs : 0;
+    s_total.transactions += s_frame.transactions;
+    s_total.bytes += s_frame.bytes;
+    s_total.commands += s_frame.commands;
+    s_total.data += s_frame.data;
+    s_total.busy_us += s_frame.busy_us;
+    if (s_statsFile)
+    {
+        fprintf(s_statsFile, "%u,%llu,%llu,%llu,%llu,%llu\n", s_frames,
+                (unsigned long long)s_frame.busy_us,
+                (unsigned long long)s_frame.transactions,
+                (unsigned long long)s_frame.bytes,
+                (unsigned long long)s_frame.commands,
+                (unsigned long long)s_frame.data);
+    }
+    memset(&s_frame, 0, sizeof(s_frame));
+    s_frameStart = now;
+    s_sleptUs = 0;
+    if (s_frameLimit && s_frames >= s_frameLimit)
+    {
+        exit(0);
+    }
+}
+
 void sdl_core_init(void)
 {
     register_oled( &sdl_ssd1306 );
@@ -71,6 +212,7 @@ void sdl_core_init(void)
     register_oled( &sdl_ili9341 );
     register_oled( &sdl_pcd8544 );
     sdl_graphics_init();
+    sdl_stats_init();
 }
 
 static void sdl_poll_event(void)
@@ -115,8 +257,18 @@ void sdl_set_gpio_keys(const uint8_t * pins)
     memcpy(s_gpioKeys, pins, sizeof(s_gpioKeys));
 }
 
+/* Shows the frame held back by sdl_send_stop, when the application waits for input or time */
+static void sdl_refresh_pending(void)
+{
+    if (s_refreshPending)
+    {
+        sdl_core_frame();
+    }
+}
+
 int sdl_read_analog(int pin)
 {
+    sdl_refresh_pending();
     sdl_poll_event();
     return s_analogInput[pin];
 }
@@ -128,11 +280,22 @@ void sdl_write_digital(int pin, int value)
 
 int sdl_read_digital(int pin)
 {
+    sdl_refresh_pending();
     return s_digitalPins[pin];
 }
 
+void sdl_core_delay(unsigned long ms)
+{
+    sdl_refresh_pending();
+    sdl_poll_event();
+    uint64_t start = sdl_micros();
+    SDL_Delay(ms);
+    s_sleptUs += sdl_micros() - start;
+}
+
 void sdl_core_close(void)
 {
+    sdl_refresh_pending();
     sdl_graphics_close();
     SDL_Quit();
 }
@@ -152,6 +315,7 @@ void sdl_send_init()
     s_active_data_mode = SDM_COMMAND_ARG;
     s_ssdMode = SSD_MODE_NONE;
     s_commandId = SSD_COMMAND_NONE;
+    s_frame.transactions++;
 }
 
 
@@ -161,6 +325,8 @@ static void sdl_send_command_or_arg(uint8_t data)
     {
         s_commandId = data;
         s_cmdArgIndex = -1; // no argument
+        s_frame.commands++;
+        s_commandMix[data]++;
     }
     else
     {
@@ -174,6 +340,7 @@ static void sdl_send_command_or_arg(uint8_t data)
 
 static void sdl_write_data(uint8_t data)
 {
+    s_frame.data++;
     if (p_active_driver)
     {
         p_active_driver->run_data( data );
@@ -182,6 +349,7 @@ static void sdl_write_data(uint8_t data)
 
 void sdl_send_byte(uint8_t data)
 {
+    s_frame.bytes++;
     if (s_dcPin>=0)
     {
         // for spi
@@ -242,10 +410,51 @@ void sdl_send_byte(uint8_t data)
     }
 }
 
+void sdl_send_bytes(const uint8_t *buffer, uint16_t size)
+{
+    while (size)
+    {
+        /* Once the transaction is in GDRAM write mode, the rest of the buffer is pixel data,
+           mode can change only between transactions or with command bytes */
+        if (p_active_driver &&
+            ( s_dcPin >= 0 ? s_digitalPins[s_dcPin] : s_ssdMode == SSD_MODE_DATA ) &&
+            ( p_active_driver->dataMode == SDMS_AUTO || s_active_data_mode == SDM_WRITE_DATA ))
+        {
+            s_ssdMode = SSD_MODE_DATA;
+            s_active_data_mode = SDM_WRITE_DATA;
+            s_frame.bytes += size;
+            s_frame.data += size;
+            if (p_active_driver->run_data_block)
+            {
+                p_active_driver->run_data_block( buffer, size );
+                return;
+            }
+            while (size--)
+            {
+                p_active_driver->run_data( *buffer++ );
+            }
+            return;
+        }
+        sdl_send_byte( *buffer );
+        buffer++;
+        size--;
+    }
+}
+
 void sdl_send_stop()
 {
-    sdl_poll_event();
-    sdl_graphics_refresh();
+    uint32_t now = SDL_GetTicks();
+    /* Drawing updates are usually many small transactions, so the window is redrawn
+       at the canvas rate only, not on every one of them */
+    if (now - s_lastRefresh >= 1000 / CANVAS_REFRESH_RATE)
+    {
+        sdl_poll_event();
+        sdl_core_frame();
+    }
+    else
+    {
+        s_refreshPending = 1;
+    }
     s_ssdMode = -1;
 }
 
@@ -53,10 +53,14 @@ extern void sdl_set_dc_pin(int pin);
 extern void sdl_set_gpio_keys(const uint8_t * pins);
 extern void sdl_send_init();
 extern void sdl_send_byte(uint8_t data);
+// Sends buffer within current transaction, pixel data is passed to the emulated controller as a block
+extern void sdl_send_bytes(const uint8_t *buffer, uint16_t size);
 extern void sdl_send_stop();
 extern int  sdl_read_analog(int pin);
 extern void sdl_write_digital(int pin, int value);
 extern int sdl_read_digital(int pin);
+// Shows frame not yet refreshed, processes window events and waits for ms milliseconds
+extern void sdl_core_delay(unsigned long ms);
 
 extern void sdl_core_close(void);
 
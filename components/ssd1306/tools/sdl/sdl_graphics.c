@@ -41,6 +41,7 @@ static int s_width = 128;
 static int s_height = 64;
 static int s_bpp = 16;
 static uint32_t s_pixfmt = SDL_PIXELFORMAT_RGB565;
+static int s_headless = 0;
 
 static int windowWidth() { return s_width * PIXEL_SIZE + BORDER_SIZE * 2; };
 static int windowHeight() { return s_height * PIXEL_SIZE + BORDER_SIZE * 2 + TOP_HEADER; };
@@ -52,6 +53,12 @@ void sdl_graphics_init(void)
          /* SDL engine is already initialize */
          return;
     }
+    if (getenv("SSD1306_SDL_HEADLESS"))
+    {
+         /* Pixels are kept in g_pixels only, no video subsystem is needed */
+         s_headless = 1;
+         return;
+    }
     SDL_Init(SDL_INIT_EVERYTHING);
     g_window = SDL_CreateWindow
     (
@@ -130,8 +137,17 @@ static void sdl_draw_oled_frame(void)
 #endif
 }
 
+int sdl_graphics_is_headless(void)
+{
+    return s_headless;
+}
+
 void sdl_graphics_refresh(void)
 {
+    if (s_headless)
+    {
+        return;
+    }
     sdl_draw_oled_frame();
     if (g_texture)
     {
@@ -168,6 +184,12 @@ void sdl_graphics_set_oled_params(int width, int height, int bpp, uint32_t pixfm
     s_pixfmt = pixfmt;
     s_width = width;
     s_height = height;
+    if (s_headless)
+    {
+        free(g_pixels);
+        g_pixels = calloc(s_width * s_height, s_bpp / 8);
+        return;
+    }
     if (g_texture)
     {
         SDL_DestroyTexture( g_texture );
@@ -250,8 +272,54 @@ uint32_t sdl_get_pixel(int x, int y)
 }
 
 
+int sdl_graphics_snapshot(const char *path)
+{
+    FILE *f;
+    if (!g_pixels)
+    {
+        return -1;
+    }
+    f = fopen(path, "wb");
+    if (!f)
+    {
+        return -1;
+    }
+    fprintf(f, "P6\n%d %d\n255\n", s_width, s_height);
+    for (int y = 0; y < s_height; y++)
+    {
+        for (int x = 0; x < s_width; x++)
+        {
+            uint32_t color = sdl_get_pixel(x, y);
+            uint8_t rgb[3];
+            switch (s_pixfmt)
+            {
+                case SDL_PIXELFORMAT_RGB332:
+                    rgb[0] = (color & 0xE0);
+                    rgb[1] = (color & 0x1C) << 3;
+                    rgb[2] = (color & 0x03) << 6;
+                    break;
+                case SDL_PIXELFORMAT_RGBX8888:
+                    rgb[0] = color >> 24;
+                    rgb[1] = color >> 16;
+                    rgb[2] = color >> 8;
+                    break;
+                default: // RGB565
+                    rgb[0] = (color >> 8) & 0xF8;
+                    rgb[1] = (color >> 3) & 0xFC;
+                    rgb[2] = (color << 3) & 0xF8;
+                    break;
+            }
+            fwrite(rgb, 1, sizeof(rgb), f);
+        }
+    }
+    return fclose(f) == 0 ? 0 : -1;
+}
+
 void sdl_graphics_close(void)
 {
-    SDL_DestroyWindow(g_window);
+    if (!s_headless)
+    {
+        SDL_DestroyWindow(g_window);
+    }
 }
 
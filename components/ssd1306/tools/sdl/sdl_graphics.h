@@ -39,6 +39,11 @@ extern void sdl_graphics_set_oled_params(int width, int height, int bpp, uint32_
 extern void sdl_put_pixel(int x, int y, uint32_t color);
 extern uint32_t sdl_get_pixel(int x, int y);
 
+// Nonzero when SSD1306_SDL_HEADLESS is set, pixels then exist in memory only
+extern int sdl_graphics_is_headless(void);
+// Writes current display content as binary PPM, returns 0 on success
+extern int sdl_graphics_snapshot(const char *path);
+
 #ifdef __cplusplus
 }
 #endif
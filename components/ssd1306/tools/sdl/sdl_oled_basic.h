@@ -63,6 +63,8 @@ typedef struct
     int   (*detect)(uint8_t data);
     void  (*run_cmd)(uint8_t data);
     void  (*run_data)(uint8_t data);
+    // Optional, writes a run of GDRAM data at once instead of byte by byte through run_data
+    void  (*run_data_block)(const uint8_t *data, uint16_t len);
 } sdl_oled_info;
 
 #if defined(SDL_NO_BORDER)
@@ -136,6 +136,43 @@ void sdl_ssd1306_data(uint8_t data)
     }
 }
 
+static void sdl_ssd1306_data_block(const uint8_t *data, uint16_t len)
+{
+    while (len)
+    {
+        /* Bytes up to the column end land on the same page */
+        int count = s_columnEnd - s_activeColumn + 1;
+        if (count > len)
+        {
+            count = len;
+        }
+        if (count < 1)
+        {
+            count = 1;
+        }
+        int y = s_activePage << 3;
+        for (int x = s_activeColumn; x < s_activeColumn + count; x++)
+        {
+            uint8_t bits = *data++;
+            for (int i=0; i<8; i++)
+            {
+                sdl_put_pixel(x, y + i, (bits & (1<<i)) ? 0xAD59 : 0x0000);
+            }
+        }
+        len -= count;
+        s_activeColumn += count;
+        if (s_activeColumn > s_columnEnd)
+        {
+            s_activeColumn = s_columnStart;
+            s_activePage++;
+            if (s_activePage > s_pageEnd)
+            {
+                s_activePage = s_pageStart;
+            }
+        }
+    }
+}
+
 sdl_oled_info sdl_ssd1306 =
 {
     .width = 128,
@@ -146,4 +183,5 @@ sdl_oled_info sdl_ssd1306 =
     .detect = sdl_ssd1306_detect,
     .run_cmd = sdl_ssd1306_commands,
     .run_data = sdl_ssd1306_data,
+    .run_data_block = sdl_ssd1306_data_block,
 };
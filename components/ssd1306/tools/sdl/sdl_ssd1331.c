@@ -39,7 +39,25 @@ static int s_newColumn;
 static int s_newPage;
 static uint8_t detected = 0;
 static uint32_t s_color = 0;
+static uint32_t s_fillColor = 0;
+static uint8_t s_fillRect = 0;
+static uint8_t s_leftToRight = 0;
+static uint8_t s_topToBottom = 0;
 
+/* Graphic acceleration commands take GDRAM addresses, which are remapped as for data */
+static void gdramPut(int column, int row, uint32_t color)
+{
+    int y = s_topToBottom ? row : (sdl_ssd1331.height - row - 1);
+    int x = s_leftToRight ? column: (sdl_ssd1331.width - column - 1);
+    sdl_put_pixel(x, y, color);
+}
+
+static uint32_t gdramGet(int column, int row)
+{
+    int y = s_topToBottom ? row : (sdl_ssd1331.height - row - 1);
+    int x = s_leftToRight ? column: (sdl_ssd1331.width - column - 1);
+    return sdl_get_pixel(x, y);
+}
 
 static void copyBlock()
 {
@@ -59,8 +77,8 @@ static void copyBlock()
                  ((x_dir > 0) && (x <= x_end)) || ((x_dir < 0) && (x >= x_start));
                  x = x + x_dir)
         {
-            sdl_put_pixel(x, y, sdl_get_pixel( x + s_columnStart - s_newColumn,
-                                               y + s_pageStart - s_newPage ));
+            gdramPut(x, y, gdramGet( x + s_columnStart - s_newColumn,
+                                     y + s_pageStart - s_newPage ));
         }
     }
 }
@@ -70,25 +88,61 @@ static void drawLine()
     if ( abs(s_columnStart - s_columnEnd) > abs(s_pageStart - s_pageEnd) )
     {
         int x = s_columnStart;
-        while (x != s_columnEnd)
+        for(;;)
         {
             int y = s_pageStart + (s_pageEnd - s_pageStart)*(x - s_columnStart)/(s_columnEnd - s_columnStart);
-            sdl_put_pixel(x, y, s_color);
+            gdramPut(x, y, s_color);
+            if (x == s_columnEnd) break;
             x += (s_columnEnd > s_columnStart ? 1: -1);
         }
     }
+    else if (s_pageStart == s_pageEnd)
+    {
+        gdramPut(s_columnStart, s_pageStart, s_color);
+    }
     else
     {
         int y = s_pageStart;
-        while (y != s_pageEnd)
+        for(;;)
         {
             int x = s_columnStart + (s_columnEnd - s_columnStart)*(y - s_pageStart)/(s_pageEnd - s_pageStart);
-            sdl_put_pixel(x, y, s_color);
+            gdramPut(x, y, s_color);
+            if (y == s_pageEnd) break;
             y += (s_pageEnd > s_pageStart ? 1: -1);
         }
     }
 }
 
+static void drawRect(uint8_t fill, uint32_t color, uint32_t fillColor)
+{
+    for (int y = s_pageStart; y <= s_pageEnd; y++)
+    {
+        for (int x = s_columnStart; x <= s_columnEnd; x++)
+        {
+            if ( (y == s_pageStart) || (y == s_pageEnd) ||
+                 (x == s_columnStart) || (x == s_columnEnd) )
+            {
+                gdramPut(x, y, color);
+            }
+            else if (fill)
+            {
+                gdramPut(x, y, fillColor);
+            }
+        }
+    }
+}
+
+/* Restores RGB332 bits from C, B, A components of the command, as sent by ssd1331 driver */
+static int colorBits(int index, uint8_t data)
+{
+    switch (index)
+    {
+        case 0: return (data & 0x30) >> 4;
+        case 1: return (data & 0x70) >> 2;
+        default: return (data & 0x38) << 2;
+    }
+}
+
 static int sdl_ssd1331_detect(uint8_t data)
 {
     if (detected)
@@ -100,8 +154,6 @@ static int sdl_ssd1331_detect(uint8_t data)
 }
 
 static uint8_t s_verticalMode = 1;
-static uint8_t s_leftToRight = 0;
-static uint8_t s_topToBottom = 0;
 
 static void sdl_ssd1331_commands(uint8_t data)
 {
@@ -137,9 +189,8 @@ static void sdl_ssd1331_commands(uint8_t data)
                 case 1: s_pageStart = data; break;
                 case 2: s_columnEnd = data; break;
                 case 3: s_pageEnd = data; break;
-                case 4: s_color |= ((data & 0x30) >> 4); break;
-                case 5: s_color |= ((data & 0x30) >> 1); break;
-                case 6: s_color |= ((data & 0x38) << 2);
+                case 4: case 5: s_color |= colorBits(s_cmdArgIndex - 4, data); break;
+                case 6: s_color |= colorBits(2, data);
                      drawLine();
                      s_commandId = SSD_COMMAND_NONE;
                      break;
@@ -147,6 +198,46 @@ static void sdl_ssd1331_commands(uint8_t data)
                      break;
             }
             break;
+        case 0x22: // DRAW RECTANGLE
+            switch (s_cmdArgIndex)
+            {
+                case 0: s_columnStart = data; s_color = 0; s_fillColor = 0; break;
+                case 1: s_pageStart = data; break;
+                case 2: s_columnEnd = data; break;
+                case 3: s_pageEnd = data; break;
+                case 4: case 5: case 6:
+                     s_color |= colorBits(s_cmdArgIndex - 4, data);
+                     break;
+                case 7: case 8: s_fillColor |= colorBits(s_cmdArgIndex - 7, data); break;
+                case 9: s_fillColor |= colorBits(2, data);
+                     drawRect(s_fillRect, s_color, s_fillColor);
+                     s_commandId = SSD_COMMAND_NONE;
+                     break;
+                default:
+                     break;
+            }
+            break;
+        case 0x25: // CLEAR WINDOW
+            switch (s_cmdArgIndex)
+            {
+                case 0: s_columnStart = data; break;
+                case 1: s_pageStart = data; break;
+                case 2: s_columnEnd = data; break;
+                case 3: s_pageEnd = data;
+                     drawRect(1, 0, 0);
+                     s_commandId = SSD_COMMAND_NONE;
+                     break;
+                default:
+                     break;
+            }
+            break;
+        case 0x26: // FILL ENABLE
+            if (s_cmdArgIndex == 0)
+            {
+                s_fillRect = data & 0x01;
+                s_commandId = SSD_COMMAND_NONE;
+            }
+            break;
         case 0x23: // MOVE BLOCK
             switch (s_cmdArgIndex)
             {
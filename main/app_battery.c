@@ -0,0 +1,186 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "ssd1306.h"
+#include "app_battery.h"
+#include "app_display.h"
+#include "app_power.h"
+#include "app_shed.h"
+#include "app_tasks.h"
+#include "app_wifi.h"
+
+#ifdef CONFIG_BATTERY_GOVERNOR
+static const char *TAG = "app_battery";
+
+#define IP5306_ADDR             0x75
+#define IP5306_REG_READ0        0x70    /* bit 3: input power connected */
+#define IP5306_REG_READ1        0x71    /* bit 3: charging done */
+#define IP5306_REG_LEVEL        0x78    /* bits 7-4: fuel gauge, see battery_percent */
+
+/* Polls in a row at a lower level before the governor steps down, the gauge flickers at a step */
+#define BATTERY_CONFIRM_POLLS   2
+
+static const char *s_level_names[BATTERY_LEVEL_MAX] = {
+    [BATTERY_LEVEL_FULL]     = "full",
+    [BATTERY_LEVEL_LOW]      = "low",
+    [BATTERY_LEVEL_CRITICAL] = "critical",
+};
+
+static const shed_level_t s_shed_floors[BATTERY_LEVEL_MAX] = {
+    [BATTERY_LEVEL_FULL]     = SHED_LEVEL_NONE,
+    [BATTERY_LEVEL_LOW]      = SHED_LEVEL_HALF_DETECT,
+    [BATTERY_LEVEL_CRITICAL] = SHED_LEVEL_LOW_RESOLUTION,
+};
+
+static const int s_max_mhz[BATTERY_LEVEL_MAX] = {
+    [BATTERY_LEVEL_FULL]     = 0,
+    [BATTERY_LEVEL_LOW]      = CONFIG_BATTERY_LOW_MHZ,
+    [BATTERY_LEVEL_CRITICAL] = 80,
+};
+
+static portMUX_TYPE s_battery_mux = portMUX_INITIALIZER_UNLOCKED;
+static battery_status_t s_status;
+
+static uint8_t battery_percent(uint8_t reg)
+{
+    // five steps, as the four LEDs of the power bank show them
+    switch (reg & 0xf0)
+    {
+    case 0x00:
+        return 100;
+    case 0x80:
+        return 75;
+    case 0xc0:
+        return 50;
+    case 0xe0:
+        return 25;
+    default:
+        return 0;
+    }
+}
+
+static esp_err_t battery_read(battery_status_t *status)
+{
+    uint8_t read0, read1, level;
+    esp_err_t err = ssd1306_platform_i2cRead(DISPLAY_I2C_NUM, IP5306_ADDR, IP5306_REG_READ0, &read0, 1);
+    if (err == ESP_OK)
+    {
+        err = ssd1306_platform_i2cRead(DISPLAY_I2C_NUM, IP5306_ADDR, IP5306_REG_READ1, &read1, 1);
+    }
+    if (err == ESP_OK)
+    {
+        err = ssd1306_platform_i2cRead(DISPLAY_I2C_NUM, IP5306_ADDR, IP5306_REG_LEVEL, &level, 1);
+    }
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    status->charging = (read0 & 0x08) != 0;
+    status->full = (read1 & 0x08) != 0;
+    status->percent = battery_percent(level);
+    return ESP_OK;
+}
+
+static battery_level_t battery_target(const battery_status_t *status)
+{
+    if (status->charging || status->percent >= 50)
+    {
+        return BATTERY_LEVEL_FULL;
+    }
+    return status->percent >= 25 ? BATTERY_LEVEL_LOW : BATTERY_LEVEL_CRITICAL;
+}
+
+static void battery_apply(battery_level_t from, battery_level_t to, const battery_status_t *status)
+{
+    ESP_LOGI(TAG, "Battery %d%%%s, %s -> %s", status->percent, status->charging ? " charging" : "",
+            s_level_names[from], s_level_names[to]);
+    app_shed_set_floor(s_shed_floors[to]);
+    esp_err_t err = app_power_set_max_mhz(s_max_mhz[to]);
+    if (err != ESP_OK && err != ESP_ERR_NOT_SUPPORTED)
+    {
+        ESP_LOGW(TAG, "CPU clock not changed (0x%x)", err);
+    }
+    app_wifi_set_power_save(to != BATTERY_LEVEL_FULL);
+}
+
+static void battery_task(void *arg)
+{
+    battery_level_t level = BATTERY_LEVEL_FULL;
+    int lower = 0;
+
+    for (;;)
+    {
+        battery_status_t status = { 0 };
+        if (battery_read(&status) == ESP_OK)
+        {
+            status.valid = true;
+            battery_level_t target = battery_target(&status);
+            // up at once when power comes back, down only once the gauge agrees twice
+            lower = target > level ? lower + 1 : 0;
+            if (target < level || lower >= BATTERY_CONFIRM_POLLS)
+            {
+                battery_apply(level, target, &status);
+                level = target;
+                lower = 0;
+            }
+        }
+        status.level = level;
+        portENTER_CRITICAL(&s_battery_mux);
+        if (!status.valid)
+        {
+            // keeps the last reading, the governor holds its level
+            status = s_status;
+            status.valid = false;
+        }
+        s_status = status;
+        portEXIT_CRITICAL(&s_battery_mux);
+        vTaskDelay(CONFIG_BATTERY_POLL_S * 1000 / portTICK_PERIOD_MS);
+    }
+}
+
+esp_err_t app_battery_init()
+{
+    battery_status_t status = { 0 };
+    // a board without the chip does not get a task polling nothing
+    esp_err_t err = battery_read(&status);
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "No IP5306 (0x%x)", err);
+        return err;
+    }
+    return app_task_create(APP_TASK_BATTERY, &battery_task, NULL, NULL);
+}
+
+void app_battery_get(battery_status_t *status)
+{
+    portENTER_CRITICAL(&s_battery_mux);
+    *status = s_status;
+    portEXIT_CRITICAL(&s_battery_mux);
+}
+
+const char *app_battery_level_name(battery_level_t level)
+{
+    return level < BATTERY_LEVEL_MAX ? s_level_names[level] : "unknown";
+}
+#endif
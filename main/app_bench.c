@@ -0,0 +1,397 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "cJSON.h"
+#include "sdkconfig.h"
+#include "app_bench.h"
+#include "app_image.h"
+#include "app_image_kernel.h"
+#include "app_config.h"
+#include "app_track.h"
+
+static const char *TAG = "app_bench";
+
+#define BENCH_FRAME_SIZE        (CONFIG_BENCH_FRAME_KB * 1024)
+/* the per stage rows, then the frame totals */
+#define BENCH_ROWS              (BENCH_STAGE_MAX + 1)
+
+static const char *s_stage_names[BENCH_STAGE_MAX] = {
+    [BENCH_STAGE_DECODE]    = "decode",
+    [BENCH_STAGE_DETECT]    = "detect",
+    [BENCH_STAGE_ALIGN]     = "align",
+    [BENCH_STAGE_RECOGNIZE] = "recognize",
+    [BENCH_STAGE_OVERLAY]   = "overlay",
+    [BENCH_STAGE_ENCODE]    = "encode",
+};
+
+static const char *s_kernel_names[BENCH_KERNEL_MAX] = {
+    [BENCH_KERNEL_RGB565_TO_BGR]   = "rgb565_to_bgr888",
+    [BENCH_KERNEL_BGR_TO_LUMA]     = "bgr888_to_luma",
+    [BENCH_KERNEL_RESIZE_BILINEAR] = "resize_bilinear",
+    [BENCH_KERNEL_RESIZE_AREA]     = "resize_area",
+    [BENCH_KERNEL_CROP]            = "crop",
+    [BENCH_KERNEL_ROTATE_90]       = "rotate_90",
+    [BENCH_KERNEL_FLIP_H]          = "flip_h",
+};
+
+/* Finds the next complete JPEG at the start of buf, dropping whatever comes before it */
+static bool bench_next_frame(uint8_t *buf, size_t *len, size_t *scan, size_t *frame_len)
+{
+    if (*scan == 0)
+    {
+        size_t soi = 0;
+        while (soi + 1 < *len && !(buf[soi] == 0xFF && buf[soi + 1] == 0xD8))
+        {
+            soi++;
+        }
+        // without a start of image only the last byte is kept, it may be half of one
+        memmove(buf, buf + soi, *len - soi);
+        *len -= soi;
+        if (*len < 2)
+        {
+            return false;
+        }
+        *scan = 2;
+    }
+    // 0xFF never precedes 0xD9 in entropy coded data
+    for (size_t i = *scan; i + 1 < *len; i++)
+    {
+        if (buf[i] == 0xFF && buf[i + 1] == 0xD9)
+        {
+            *frame_len = i + 2;
+            return true;
+        }
+    }
+    *scan = *len > 2 ? *len - 1 : 2;
+    return false;
+}
+
+static int bench_compare(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void bench_stats(uint32_t *samples, uint32_t count, bench_stats_t *stats)
+{
+    uint64_t sum = 0;
+
+    memset(stats, 0, sizeof(*stats));
+    if (count == 0)
+    {
+        return;
+    }
+    qsort(samples, count, sizeof(uint32_t), bench_compare);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        sum += samples[i];
+    }
+    stats->count = count;
+    stats->mean_us = sum / count;
+    stats->p50_us = samples[(count - 1) * 50 / 100];
+    stats->p99_us = samples[(count - 1) * 99 / 100];
+    stats->max_us = samples[count - 1];
+}
+
+static esp_err_t bench_frame(uint8_t *buf, size_t len, uint32_t *samples[BENCH_ROWS], uint32_t counts[BENCH_ROWS], bench_result_t *result)
+{
+    camera_fb_t fb = {
+        .buf = buf,
+        .len = len,
+        .format = PIXFORMAT_JPEG,
+    };
+    int64_t us[BENCH_STAGE_MAX];
+    int faces;
+
+    if (!app_image_jpeg_size(buf, len, &fb.width, &fb.height))
+    {
+        result->skipped++;
+        return ESP_OK;
+    }
+    esp_err_t err = app_pipeline_bench_frame(&fb, us, &faces);
+    if (err == ESP_ERR_INVALID_STATE)
+    {
+        return err;
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGD(TAG, "Frame %u skipped (0x%x)", result->frames + result->skipped, err);
+        result->skipped++;
+        return ESP_OK;
+    }
+
+    uint32_t total = 0;
+    for (int i = 0; i < BENCH_STAGE_MAX; i++)
+    {
+        if (us[i] >= 0)
+        {
+            samples[i][counts[i]++] = us[i];
+            total += us[i];
+        }
+    }
+    samples[BENCH_STAGE_MAX][counts[BENCH_STAGE_MAX]++] = total;
+    result->frames++;
+    result->faces += faces;
+    result->width = fb.width;
+    result->height = fb.height;
+    return ESP_OK;
+}
+
+esp_err_t app_bench_run(bench_read_cb read, void *arg, bench_result_t *result)
+{
+    uint32_t *samples[BENCH_ROWS];
+    uint32_t counts[BENCH_ROWS] = {0};
+    size_t len = 0;
+    size_t scan = 0;
+    size_t frame_len;
+    esp_err_t err = ESP_OK;
+
+    memset(result, 0, sizeof(*result));
+    uint8_t *buf = (uint8_t *)heap_caps_malloc(BENCH_FRAME_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    uint32_t *rows = (uint32_t *)heap_caps_malloc(BENCH_ROWS * CONFIG_BENCH_MAX_FRAMES * sizeof(uint32_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!buf || !rows)
+    {
+        free(buf);
+        free(rows);
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < BENCH_ROWS; i++)
+    {
+        samples[i] = rows + i * CONFIG_BENCH_MAX_FRAMES;
+    }
+
+    // faces are looked for over the whole first frame, like after the stream starts
+    app_track_reset();
+    while (err == ESP_OK)
+    {
+        while (err == ESP_OK && bench_next_frame(buf, &len, &scan, &frame_len))
+        {
+            if (result->frames == CONFIG_BENCH_MAX_FRAMES)
+            {
+                result->truncated = true;
+                break;
+            }
+            err = bench_frame(buf, frame_len, samples, counts, result);
+            memmove(buf, buf + frame_len, len - frame_len);
+            len -= frame_len;
+            scan = 0;
+        }
+        if (err != ESP_OK || result->truncated)
+        {
+            break;
+        }
+        if (len == BENCH_FRAME_SIZE)
+        {
+            ESP_LOGW(TAG, "Frame larger than %u bytes skipped", BENCH_FRAME_SIZE);
+            result->skipped++;
+            len = 0;
+            scan = 0;
+        }
+        int ret = read(arg, buf + len, BENCH_FRAME_SIZE - len);
+        if (ret < 0)
+        {
+            err = ESP_FAIL;
+        }
+        if (ret <= 0)
+        {
+            break;
+        }
+        len += ret;
+    }
+
+    for (int i = 0; i < BENCH_STAGE_MAX; i++)
+    {
+        bench_stats(samples[i], counts[i], &result->stages[i]);
+    }
+    bench_stats(samples[BENCH_STAGE_MAX], counts[BENCH_STAGE_MAX], &result->total);
+    free(rows);
+    free(buf);
+    return err;
+}
+
+/* src and dst are VGA BGR888 buffers, the smaller formats use their start */
+static esp_err_t bench_kernel(bench_kernel_t kernel, uint8_t *src_buf, uint8_t *dst_buf, uint32_t *pixels)
+{
+    image_t src = { .buf = src_buf, .width = 640, .height = 480, .format = IMAGE_BGR888 };
+    image_t dst = { .buf = dst_buf, .width = 640, .height = 480, .format = IMAGE_BGR888 };
+    image_rect_t face = { 220, 140, 200, 200 };
+
+    switch (kernel)
+    {
+    case BENCH_KERNEL_RGB565_TO_BGR:
+        src.format = IMAGE_RGB565;
+        break;
+    case BENCH_KERNEL_BGR_TO_LUMA:
+        dst.format = IMAGE_LUMA;
+        break;
+    case BENCH_KERNEL_RESIZE_BILINEAR:
+        src.format = IMAGE_RGB565;
+        dst.width = 320;
+        dst.height = 240;
+        break;
+    case BENCH_KERNEL_RESIZE_AREA:
+        src.format = IMAGE_RGB565;
+        dst.format = IMAGE_LUMA;
+        dst.width = 128;
+        dst.height = 96;
+        break;
+    case BENCH_KERNEL_CROP:
+        dst.width = 56;
+        dst.height = 56;
+        break;
+    case BENCH_KERNEL_ROTATE_90:
+        src.format = dst.format = IMAGE_RGB565;
+        dst.width = 480;
+        dst.height = 640;
+        break;
+    default:
+        break;
+    }
+    *pixels = dst.width * dst.height;
+
+    switch (kernel)
+    {
+    case BENCH_KERNEL_RGB565_TO_BGR:
+    case BENCH_KERNEL_BGR_TO_LUMA:
+        return app_image_convert(&src, &dst);
+    case BENCH_KERNEL_RESIZE_BILINEAR:
+        return app_image_resize(&src, NULL, &dst, IMAGE_RESIZE_BILINEAR);
+    case BENCH_KERNEL_RESIZE_AREA:
+        return app_image_resize(&src, NULL, &dst, IMAGE_RESIZE_AREA);
+    case BENCH_KERNEL_CROP:
+        return app_image_resize(&src, &face, &dst, IMAGE_RESIZE_BILINEAR);
+    case BENCH_KERNEL_ROTATE_90:
+        return app_image_transform(&src, &dst, IMAGE_ROTATE_90);
+    case BENCH_KERNEL_FLIP_H:
+        return app_image_transform(&src, &dst, IMAGE_FLIP_H);
+    default:
+        return ESP_ERR_INVALID_ARG;
+    }
+}
+
+esp_err_t app_bench_kernels(bench_kernel_result_t results[BENCH_KERNEL_MAX])
+{
+    const size_t frame_size = 640 * 480 * 3;
+    uint32_t samples[CONFIG_BENCH_KERNEL_RUNS];
+    esp_err_t err = ESP_OK;
+
+    memset(results, 0, BENCH_KERNEL_MAX * sizeof(bench_kernel_result_t));
+    // both in PSRAM, where camera frames are
+    uint8_t *src = (uint8_t *)heap_caps_malloc(frame_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    uint8_t *dst = (uint8_t *)heap_caps_malloc(frame_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!src || !dst)
+    {
+        free(src);
+        free(dst);
+        return ESP_ERR_NO_MEM;
+    }
+    // anything but a flat frame, the kernels take no shortcuts on content anyway
+    for (size_t i = 0; i < frame_size; i++)
+    {
+        src[i] = i * 7;
+    }
+
+    for (int k = 0; k < BENCH_KERNEL_MAX && err == ESP_OK; k++)
+    {
+        for (int run = 0; run < CONFIG_BENCH_KERNEL_RUNS && err == ESP_OK; run++)
+        {
+            int64_t start = esp_timer_get_time();
+            err = bench_kernel(k, src, dst, &results[k].pixels);
+            samples[run] = esp_timer_get_time() - start;
+        }
+        bench_stats(samples, CONFIG_BENCH_KERNEL_RUNS, &results[k].stats);
+    }
+    free(dst);
+    free(src);
+    return err;
+}
+
+static void bench_add_stats(cJSON *parent, const char *name, const bench_stats_t *stats)
+{
+    cJSON *stage = cJSON_CreateObject();
+    cJSON_AddItemToObject(parent, name, stage);
+    cJSON_AddNumberToObject(stage, "count", stats->count);
+    cJSON_AddNumberToObject(stage, "mean_us", stats->mean_us);
+    cJSON_AddNumberToObject(stage, "p50_us", stats->p50_us);
+    cJSON_AddNumberToObject(stage, "p99_us", stats->p99_us);
+    cJSON_AddNumberToObject(stage, "max_us", stats->max_us);
+    cJSON_AddNumberToObject(stage, "per_s", stats->mean_us ? 1000000.0 / stats->mean_us : 0);
+}
+
+char *app_bench_to_json(const bench_result_t *result)
+{
+    mtmn_config_t mtmn_config;
+    app_config_get_mtmn(&mtmn_config);
+
+    cJSON *root = cJSON_CreateObject();
+    if (!root)
+    {
+        return NULL;
+    }
+    cJSON_AddNumberToObject(root, "frames", result->frames);
+    cJSON_AddNumberToObject(root, "skipped", result->skipped);
+    cJSON_AddBoolToObject(root, "truncated", result->truncated);
+    cJSON_AddNumberToObject(root, "faces", result->faces);
+    cJSON_AddNumberToObject(root, "width", result->width);
+    cJSON_AddNumberToObject(root, "height", result->height);
+    // the detector settings the run was made with, to tell runs apart
+    cJSON_AddNumberToObject(root, "min_face", mtmn_config.min_face);
+    cJSON_AddNumberToObject(root, "pyramid", mtmn_config.pyramid);
+
+    cJSON *stages = cJSON_CreateObject();
+    cJSON_AddItemToObject(root, "stages", stages);
+    for (int i = 0; i < BENCH_STAGE_MAX; i++)
+    {
+        bench_add_stats(stages, s_stage_names[i], &result->stages[i]);
+    }
+    bench_add_stats(root, "total", &result->total);
+
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return json;
+}
+
+char *app_bench_kernels_to_json(const bench_kernel_result_t results[BENCH_KERNEL_MAX])
+{
+    cJSON *root = cJSON_CreateObject();
+    if (!root)
+    {
+        return NULL;
+    }
+    for (int i = 0; i < BENCH_KERNEL_MAX; i++)
+    {
+        bench_add_stats(root, s_kernel_names[i], &results[i].stats);
+        cJSON *kernel = cJSON_GetObjectItem(root, s_kernel_names[i]);
+        cJSON_AddNumberToObject(kernel, "pixels", results[i].pixels);
+        // output megapixels per second
+        cJSON_AddNumberToObject(kernel, "mpix_s", results[i].stats.mean_us ? (double)results[i].pixels / results[i].stats.mean_us : 0);
+    }
+
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return json;
+}
@@ -0,0 +1,116 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "app_boot.h"
+
+static const char *TAG = "app_boot";
+
+typedef struct {
+    const char *name;
+    int64_t start;
+    int64_t end;    /* 0 until the phase ends */
+} boot_phase_desc_t;
+
+static boot_phase_desc_t s_phases[BOOT_PHASE_MAX] = {
+    [BOOT_PHASE_APP_MAIN]    = { "app_main" },
+    [BOOT_PHASE_POWER]       = { "power" },
+    [BOOT_PHASE_OLED]        = { "oled" },
+    [BOOT_PHASE_DISPLAY]     = { "display" },
+    [BOOT_PHASE_CONFIG]      = { "config" },
+    [BOOT_PHASE_SPEECH]      = { "speech" },
+    [BOOT_PHASE_PIR]         = { "pir" },
+    [BOOT_PHASE_WAKE_WAIT]   = { "wake_wait" },
+    [BOOT_PHASE_WIFI]        = { "wifi" },
+    [BOOT_PHASE_WIFI_IP]     = { "wifi_ip" },
+    [BOOT_PHASE_CAMERA]      = { "camera" },
+    [BOOT_PHASE_HTTPSERVER]  = { "httpserver" },
+    [BOOT_PHASE_FACE_DB]     = { "face_db" },
+    [BOOT_PHASE_FIRST_FRAME] = { "first_frame" },
+    [BOOT_PHASE_CAPTURE]     = { "capture" },
+    [BOOT_PHASE_UPLOAD]      = { "upload" },
+};
+
+static bool s_reported = false;
+
+void app_boot_begin(boot_phase_t phase)
+{
+    s_phases[phase].start = esp_timer_get_time();
+}
+
+void app_boot_end(boot_phase_t phase)
+{
+    s_phases[phase].end = esp_timer_get_time();
+}
+
+void app_boot_mark(boot_phase_t phase)
+{
+    boot_phase_desc_t *p = &s_phases[phase];
+
+    if (p->end)
+    {
+        return;
+    }
+    p->start = p->end = esp_timer_get_time();
+    if (phase == BOOT_PHASE_FIRST_FRAME)
+    {
+        // comes after the boot report, whenever the first viewer connects
+        ESP_LOGI(TAG, "First frame at %lld ms", p->end / 1000);
+    }
+}
+
+const char *app_boot_phase_name(boot_phase_t phase)
+{
+    return s_phases[phase].name;
+}
+
+bool app_boot_get(boot_phase_t phase, int64_t *start_us, int64_t *end_us)
+{
+    const boot_phase_desc_t *p = &s_phases[phase];
+
+    if (!p->end)
+    {
+        return false;
+    }
+    *start_us = p->start;
+    *end_us = p->end;
+    return true;
+}
+
+void app_boot_report()
+{
+    if (s_reported)
+    {
+        return;
+    }
+    s_reported = true;
+    for (int i = 0; i < BOOT_PHASE_MAX; i++)
+    {
+        int64_t start, end;
+
+        if (app_boot_get(i, &start, &end))
+        {
+            ESP_LOGI(TAG, "%-12s at %6lld ms, %6lld ms", s_phases[i].name, start / 1000, (end - start) / 1000);
+        }
+    }
+}
@@ -20,10 +20,122 @@
  * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "cJSON.h"
+#include "nvs.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
 #include "app_camera.h"
+#include "app_config.h"
+#include "app_mem.h"
 
 static const char *TAG = "app_camera";
 
+static const uint16_t s_resolution[][2] = {
+    { 160, 120 },   /* FRAMESIZE_QQVGA */
+    { 128, 160 },   /* FRAMESIZE_QQVGA2 */
+    { 176, 144 },   /* FRAMESIZE_QCIF */
+    { 240, 176 },   /* FRAMESIZE_HQVGA */
+    { 320, 240 },   /* FRAMESIZE_QVGA */
+    { 400, 296 },   /* FRAMESIZE_CIF */
+    { 640, 480 },   /* FRAMESIZE_VGA */
+    { 800, 600 },   /* FRAMESIZE_SVGA */
+    { 1024, 768 },  /* FRAMESIZE_XGA */
+    { 1280, 1024 }, /* FRAMESIZE_SXGA */
+    { 1600, 1200 }, /* FRAMESIZE_UXGA */
+};
+
+void app_camera_get_resolution(framesize_t frame_size, size_t *width, size_t *height)
+{
+    if (frame_size >= sizeof(s_resolution) / sizeof(s_resolution[0]))
+    {
+        frame_size = FRAMESIZE_QVGA;
+    }
+    *width = s_resolution[frame_size][0];
+    *height = s_resolution[frame_size][1];
+}
+
+#define CAMERA_FRAME_SIZES  (sizeof(s_resolution) / sizeof(s_resolution[0]))
+
+static camera_config_t s_config;
+static framesize_t s_frame_size = CAMERA_FRAME_SIZE;
+static int s_quality = 10;
+
+#define CAMERA_NVS_KEY          "camclk"
+#define CAMERA_BLOB_VERSION     1
+
+/* Tuned XCLK per frame size, 0 for XCLK_FREQ */
+typedef struct {
+    uint32_t version;
+    uint32_t xclk_hz[CAMERA_FRAME_SIZES];
+} camera_blob_t;
+
+static camera_blob_t s_clocks;
+
+static uint32_t camera_xclk_for(framesize_t frame_size)
+{
+    return frame_size < CAMERA_FRAME_SIZES && s_clocks.xclk_hz[frame_size] ? s_clocks.xclk_hz[frame_size] : XCLK_FREQ;
+}
+
+static void camera_load_clocks()
+{
+    nvs_handle handle;
+    camera_blob_t blob;
+    size_t len = sizeof(blob);
+
+    if (nvs_open(APP_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
+    {
+        return;
+    }
+    if (nvs_get_blob(handle, CAMERA_NVS_KEY, &blob, &len) == ESP_OK
+    && len == sizeof(blob) && blob.version == CAMERA_BLOB_VERSION)
+    {
+        s_clocks = blob;
+    }
+    nvs_close(handle);
+}
+
+static const struct {
+    pixformat_t format;
+    const char *name;
+} s_formats[] = {
+    { PIXFORMAT_JPEG,      "jpeg" },
+    { PIXFORMAT_GRAYSCALE, "grayscale" },
+    { PIXFORMAT_RGB565,    "rgb565" },
+};
+
+#define CAMERA_FORMATS  (sizeof(s_formats) / sizeof(s_formats[0]))
+
+/* What the driver took from each heap when it started, it allocates its frame buffers itself */
+static size_t s_driver_internal = 0;
+static size_t s_driver_spiram = 0;
+
+static esp_err_t camera_start()
+{
+    size_t internal = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t spiram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+
+    // raw frames are large, the driver only gets more than one buffer for JPEG
+    s_config.fb_count = s_config.pixel_format == PIXFORMAT_JPEG ? CONFIG_CAMERA_FB_COUNT : 1;
+    esp_err_t err = esp_camera_init(&s_config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Camera init failed with error 0x%x", err);
+        return err;
+    }
+    // allocations of other tasks meanwhile count as the driver's too
+    size_t internal_now = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t spiram_now = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    s_driver_internal = internal > internal_now ? internal - internal_now : 0;
+    s_driver_spiram = spiram > spiram_now ? spiram - spiram_now : 0;
+    app_mem_account(APP_MEM_CAMERA, APP_MEM_INTERNAL, s_driver_internal, true);
+    app_mem_account(APP_MEM_CAMERA, APP_MEM_SPIRAM, s_driver_spiram, true);
+    sensor_t *s = esp_camera_sensor_get();
+    s->set_vflip(s, 1);
+    return ESP_OK;
+}
+
 void app_camera_init()
 {
     /* IO13, IO14 is designed for JTAG by default,
@@ -39,37 +151,439 @@ void app_camera_init()
     conf.pin_bit_mask = 1LL << 14;
     gpio_config(&conf);
 
-    camera_config_t config;
-    config.ledc_channel = LEDC_CHANNEL_0;
-    config.ledc_timer = LEDC_TIMER_0;
-    config.pin_d0 = Y2_GPIO_NUM;
-    config.pin_d1 = Y3_GPIO_NUM;
-    config.pin_d2 = Y4_GPIO_NUM;
-    config.pin_d3 = Y5_GPIO_NUM;
-    config.pin_d4 = Y6_GPIO_NUM;
-    config.pin_d5 = Y7_GPIO_NUM;
-    config.pin_d6 = Y8_GPIO_NUM;
-    config.pin_d7 = Y9_GPIO_NUM;
-    config.pin_xclk = XCLK_GPIO_NUM;
-    config.pin_pclk = PCLK_GPIO_NUM;
-    config.pin_vsync = VSYNC_GPIO_NUM;
-    config.pin_href = HREF_GPIO_NUM;
-    config.pin_sscb_sda = SIOD_GPIO_NUM;
-    config.pin_sscb_scl = SIOC_GPIO_NUM;
-    config.pin_reset = RESET_GPIO_NUM;
-    config.pin_pwdn = PWDN_GPIO_NUM;
-    config.xclk_freq_hz = XCLK_FREQ;
-    config.pixel_format = CAMERA_PIXEL_FORMAT;
-    config.frame_size = CAMERA_FRAME_SIZE;
-    config.jpeg_quality = 10;
-    config.fb_count = 2;
+    camera_config_t *config = &s_config;
+    config->ledc_channel = LEDC_CHANNEL_0;
+    config->ledc_timer = LEDC_TIMER_0;
+    config->pin_d0 = Y2_GPIO_NUM;
+    config->pin_d1 = Y3_GPIO_NUM;
+    config->pin_d2 = Y4_GPIO_NUM;
+    config->pin_d3 = Y5_GPIO_NUM;
+    config->pin_d4 = Y6_GPIO_NUM;
+    config->pin_d5 = Y7_GPIO_NUM;
+    config->pin_d6 = Y8_GPIO_NUM;
+    config->pin_d7 = Y9_GPIO_NUM;
+    config->pin_xclk = XCLK_GPIO_NUM;
+    config->pin_pclk = PCLK_GPIO_NUM;
+    config->pin_vsync = VSYNC_GPIO_NUM;
+    config->pin_href = HREF_GPIO_NUM;
+    config->pin_sscb_sda = SIOD_GPIO_NUM;
+    config->pin_sscb_scl = SIOC_GPIO_NUM;
+    config->pin_reset = RESET_GPIO_NUM;
+    config->pin_pwdn = PWDN_GPIO_NUM;
+    camera_load_clocks();
+    config->xclk_freq_hz = camera_xclk_for(CAMERA_FRAME_SIZE);
+    config->pixel_format = CAMERA_PIXEL_FORMAT;
+    config->frame_size = CAMERA_FRAME_SIZE;
+    config->jpeg_quality = s_quality;
 
     // camera init
-    esp_err_t err = esp_camera_init(&config);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Camera init failed with error 0x%x", err);
-        return;
+    camera_start();
+}
+
+framesize_t app_camera_frame_size()
+{
+    return s_frame_size;
+}
+
+pixformat_t app_camera_pixel_format()
+{
+    return s_config.pixel_format;
+}
+
+int app_camera_quality()
+{
+    return s_quality;
+}
+
+void app_camera_get_settings(camera_settings_t *settings)
+{
+    sensor_t *s = esp_camera_sensor_get();
+
+    memset(settings, 0, sizeof(*settings));
+    settings->frame_size = s_frame_size;
+    settings->pixel_format = s_config.pixel_format;
+    settings->quality = s_quality;
+    if (s)
+    {
+        settings->gain_ctrl = s->status.agc;
+        settings->agc_gain = s->status.agc_gain;
+        settings->exposure_ctrl = s->status.aec;
+        settings->aec_value = s->status.aec_value;
     }
+}
+
+bool app_camera_needs_restart(const camera_settings_t *settings)
+{
+    size_t width, height, max_width, max_height;
+
+    // the driver sized its frame buffers for the frame size it was started with, and only sets XCLK up at start
+    app_camera_get_resolution(settings->frame_size, &width, &height);
+    app_camera_get_resolution(s_config.frame_size, &max_width, &max_height);
+    return settings->pixel_format != s_config.pixel_format || width * height > max_width * max_height
+        || camera_xclk_for(settings->frame_size) != s_config.xclk_freq_hz;
+}
+
+/* Starts the driver again with config, or with the old config when that fails */
+static esp_err_t camera_restart(const camera_config_t *config)
+{
+    camera_config_t old = s_config;
+
+    esp_camera_deinit();
+    app_mem_account(APP_MEM_CAMERA, APP_MEM_INTERNAL, s_driver_internal, false);
+    app_mem_account(APP_MEM_CAMERA, APP_MEM_SPIRAM, s_driver_spiram, false);
+    s_driver_internal = 0;
+    s_driver_spiram = 0;
+    s_config = *config;
+    esp_err_t err = camera_start();
+    if (err != ESP_OK)
+    {
+        s_config = old;
+        camera_start();
+    }
+    return err;
+}
+
+esp_err_t app_camera_apply(const camera_settings_t *settings)
+{
+    esp_err_t err = ESP_OK;
+
+    if (app_camera_needs_restart(settings))
+    {
+        camera_config_t config = s_config;
+
+        config.frame_size = settings->frame_size;
+        config.pixel_format = settings->pixel_format;
+        config.jpeg_quality = settings->quality;
+        config.xclk_freq_hz = camera_xclk_for(settings->frame_size);
+        err = camera_restart(&config);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+        ESP_LOGI(TAG, "Camera restarted at frame size %d, format %d, XCLK %d MHz",
+                settings->frame_size, settings->pixel_format, config.xclk_freq_hz / 1000000);
+    }
+
     sensor_t *s = esp_camera_sensor_get();
-    s->set_vflip(s, 1);
+    if (!s)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (s->status.framesize != settings->frame_size)
+    {
+        s->set_framesize(s, settings->frame_size);
+    }
+    s->set_quality(s, settings->quality);
+    s->set_gain_ctrl(s, settings->gain_ctrl);
+    s->set_exposure_ctrl(s, settings->exposure_ctrl);
+    // the manual values only take effect with the automatic control off
+    if (!settings->gain_ctrl)
+    {
+        s->set_agc_gain(s, settings->agc_gain);
+    }
+    if (!settings->exposure_ctrl)
+    {
+        s->set_aec_value(s, settings->aec_value);
+    }
+    s_frame_size = settings->frame_size;
+    s_quality = settings->quality;
+    return ESP_OK;
+}
+
+char *app_camera_to_json()
+{
+    camera_settings_t settings;
+    const char *format = "unknown";
+    cJSON *root = cJSON_CreateObject();
+
+    if (!root)
+    {
+        return NULL;
+    }
+    app_camera_get_settings(&settings);
+    for (int i = 0; i < CAMERA_FORMATS; i++)
+    {
+        if (s_formats[i].format == settings.pixel_format)
+        {
+            format = s_formats[i].name;
+        }
+    }
+    cJSON_AddNumberToObject(root, "framesize", settings.frame_size);
+    cJSON_AddStringToObject(root, "pixformat", format);
+    cJSON_AddNumberToObject(root, "quality", settings.quality);
+    cJSON_AddBoolToObject(root, "gain_ctrl", settings.gain_ctrl);
+    cJSON_AddNumberToObject(root, "agc_gain", settings.agc_gain);
+    cJSON_AddBoolToObject(root, "exposure_ctrl", settings.exposure_ctrl);
+    cJSON_AddNumberToObject(root, "aec_value", settings.aec_value);
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return json;
+}
+
+static bool camera_json_int(cJSON *root, const char *name, int min, int max, int *value)
+{
+    cJSON *item = cJSON_GetObjectItem(root, name);
+    if (!item)
+    {
+        return true;
+    }
+    if (!cJSON_IsNumber(item) || item->valueint < min || item->valueint > max)
+    {
+        return false;
+    }
+    *value = item->valueint;
+    return true;
+}
+
+static bool camera_json_bool(cJSON *root, const char *name, bool *value)
+{
+    cJSON *item = cJSON_GetObjectItem(root, name);
+    if (!item)
+    {
+        return true;
+    }
+    if (!cJSON_IsBool(item))
+    {
+        return false;
+    }
+    *value = cJSON_IsTrue(item);
+    return true;
+}
+
+esp_err_t app_camera_from_json(const char *json, camera_settings_t *settings)
+{
+    cJSON *root = cJSON_Parse(json);
+    int frame_size = settings->frame_size;
+    bool valid;
+
+    if (!root)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    valid = camera_json_int(root, "framesize", FRAMESIZE_QQVGA, FRAMESIZE_UXGA, &frame_size)
+            && camera_json_int(root, "quality", 0, 63, &settings->quality)
+            && camera_json_bool(root, "gain_ctrl", &settings->gain_ctrl)
+            && camera_json_int(root, "agc_gain", 0, 30, &settings->agc_gain)
+            && camera_json_bool(root, "exposure_ctrl", &settings->exposure_ctrl)
+            && camera_json_int(root, "aec_value", 0, 1200, &settings->aec_value);
+    settings->frame_size = (framesize_t)frame_size;
+
+    cJSON *format = cJSON_GetObjectItem(root, "pixformat");
+    if (valid && format)
+    {
+        valid = false;
+        for (int i = 0; i < CAMERA_FORMATS && cJSON_IsString(format); i++)
+        {
+            if (!strcmp(s_formats[i].name, format->valuestring))
+            {
+                settings->pixel_format = s_formats[i].format;
+                valid = true;
+            }
+        }
+    }
+    cJSON_Delete(root);
+    return valid ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t app_camera_recover()
+{
+    camera_settings_t settings;
+    camera_config_t config = s_config;
+
+    // the reset clears the sensor registers, gain and exposure are put back after
+    app_camera_get_settings(&settings);
+    esp_err_t err = camera_restart(&config);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    return app_camera_apply(&settings);
+}
+
+uint32_t app_camera_xclk_hz()
+{
+    return s_config.xclk_freq_hz;
+}
+
+#ifdef CONFIG_CAMERA_TUNE
+/* The LEDC divides the 80 MHz APB clock down, these come out exact or close */
+static const uint32_t s_tune_xclk[CAMERA_TUNE_STEPS] = {
+    8000000, 10000000, 12000000, 16000000, 20000000, 24000000,
+};
+
+/* Frames dropped after a restart, the sensor is still adjusting its exposure */
+#define CAMERA_TUNE_SETTLE      4
+#define CAMERA_TUNE_US          (2 * 1000000)
+/* A faster clock has to gain this much to be worth it, in percent */
+#define CAMERA_TUNE_GAIN        2
+
+/* A DMA overflow loses bytes of the frame, the end of image marker is missing then */
+static bool camera_frame_complete(const camera_fb_t *fb)
+{
+    if (fb->format != PIXFORMAT_JPEG)
+    {
+        return true;
+    }
+    if (fb->len < 4 || fb->buf[0] != 0xFF || fb->buf[1] != 0xD8)
+    {
+        return false;
+    }
+    // the driver may leave some padding after the marker
+    for (size_t i = fb->len - 1; i > 0 && i + 64 > fb->len; i--)
+    {
+        if (fb->buf[i - 1] == 0xFF && fb->buf[i] == 0xD9)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void camera_tune_step(uint32_t xclk_hz, camera_tune_step_t *step)
+{
+    camera_config_t config = s_config;
+    uint64_t bytes = 0;
+
+    memset(step, 0, sizeof(*step));
+    step->xclk_hz = xclk_hz;
+    config.frame_size = s_frame_size;
+    config.jpeg_quality = s_quality;
+    config.xclk_freq_hz = xclk_hz;
+    if (camera_restart(&config) != ESP_OK)
+    {
+        step->lost = 1;
+        return;
+    }
+    for (int i = 0; i < CAMERA_TUNE_SETTLE; i++)
+    {
+        camera_fb_t *fb = esp_camera_fb_get();
+        if (fb)
+        {
+            esp_camera_fb_return(fb);
+        }
+    }
+
+    // stops at the first loss, a capture timeout alone takes seconds
+    int64_t start = esp_timer_get_time();
+    int64_t elapsed = 0;
+    while (elapsed < CAMERA_TUNE_US && !step->lost)
+    {
+        camera_fb_t *fb = esp_camera_fb_get();
+        if (!fb || !camera_frame_complete(fb))
+        {
+            step->lost++;
+        }
+        else
+        {
+            step->frames++;
+            bytes += fb->len;
+        }
+        if (fb)
+        {
+            esp_camera_fb_return(fb);
+        }
+        elapsed = esp_timer_get_time() - start;
+    }
+    step->fps = step->frames * 1000000.0f / elapsed;
+    step->kbps = (uint32_t)(bytes * 8 * 1000 / elapsed);
+    ESP_LOGI(TAG, "XCLK %u MHz: %.1f fps, %d lost, %u kbit/s", xclk_hz / 1000000, step->fps, step->lost, step->kbps);
+}
+
+static esp_err_t camera_save_clocks()
+{
+    nvs_handle handle;
+
+    s_clocks.version = CAMERA_BLOB_VERSION;
+    esp_err_t err = nvs_open(APP_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    err = nvs_set_blob(handle, CAMERA_NVS_KEY, &s_clocks, sizeof(s_clocks));
+    if (err == ESP_OK)
+    {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t app_camera_tune(camera_tune_t *result)
+{
+    camera_settings_t settings;
+    esp_err_t err = ESP_OK;
+
+    app_camera_get_settings(&settings);
+    memset(result, 0, sizeof(*result));
+    result->frame_size = s_frame_size;
+    result->best = -1;
+    for (int i = 0; i < CAMERA_TUNE_STEPS; i++)
+    {
+        camera_tune_step_t *step = &result->step[i];
+        camera_tune_step(s_tune_xclk[i], step);
+        result->steps++;
+        if (!step->lost && step->frames &&
+                (result->best < 0 || step->fps * 100 > result->step[result->best].fps * (100 + CAMERA_TUNE_GAIN)))
+        {
+            result->best = i;
+        }
+    }
+
+    if (result->best >= 0 && s_frame_size < CAMERA_FRAME_SIZES)
+    {
+        s_clocks.xclk_hz[s_frame_size] = result->step[result->best].xclk_hz;
+        err = camera_save_clocks();
+        ESP_LOGI(TAG, "XCLK %u MHz kept for frame size %d", s_clocks.xclk_hz[s_frame_size] / 1000000, s_frame_size);
+    }
+    else
+    {
+        ESP_LOGW(TAG, "No XCLK ran without loss, frame size %d keeps its clock", s_frame_size);
+    }
+
+    // back at the kept clock with the settings from before, the restarts reset the sensor
+    camera_config_t config = s_config;
+    config.xclk_freq_hz = camera_xclk_for(s_frame_size);
+    esp_err_t restart = camera_restart(&config);
+    if (restart == ESP_OK)
+    {
+        restart = app_camera_apply(&settings);
+    }
+    return err == ESP_OK ? restart : err;
+}
+
+char *app_camera_tune_to_json(const camera_tune_t *result)
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON *steps = cJSON_CreateArray();
+    char *json = NULL;
+
+    if (!root || !steps)
+    {
+        cJSON_Delete(steps);
+        goto out;
+    }
+    cJSON_AddNumberToObject(root, "framesize", result->frame_size);
+    cJSON_AddNumberToObject(root, "xclk", result->best >= 0 ? result->step[result->best].xclk_hz : 0);
+    cJSON_AddItemToObject(root, "steps", steps);
+    for (int i = 0; i < result->steps; i++)
+    {
+        const camera_tune_step_t *step = &result->step[i];
+        cJSON *item = cJSON_CreateObject();
+        if (!item)
+        {
+            goto out;
+        }
+        cJSON_AddNumberToObject(item, "xclk", step->xclk_hz);
+        cJSON_AddNumberToObject(item, "frames", step->frames);
+        cJSON_AddNumberToObject(item, "lost", step->lost);
+        cJSON_AddNumberToObject(item, "fps", step->fps);
+        cJSON_AddNumberToObject(item, "kbps", step->kbps);
+        cJSON_AddItemToArray(steps, item);
+    }
+    json = cJSON_PrintUnformatted(root);
+
+out:
+    cJSON_Delete(root);
+    return json;
 }
+#endif
@@ -0,0 +1,168 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "app_camera_profile.h"
+#include "app_rate.h"
+#include "app_pir.h"
+
+static const char *TAG = "app_camera_profile";
+
+#ifdef CONFIG_CAMERA_PROFILES
+#define PROFILE_IDLE_AFTER_US   ((int64_t)CONFIG_CAMERA_IDLE_AFTER_S * 1000000)
+#define PROFILE_IDLE_PERIOD_US  (1000000 / CONFIG_CAMERA_IDLE_FPS)
+#endif
+
+static const char *s_profile_names[CAMERA_PROFILE_MAX] = {
+    [CAMERA_PROFILE_ACTIVE] = "active",
+    [CAMERA_PROFILE_IDLE]   = "idle",
+};
+
+static portMUX_TYPE s_profile_mux = portMUX_INITIALIZER_UNLOCKED;
+static camera_profile_t s_profile = CAMERA_PROFILE_ACTIVE;
+static int64_t s_last_activity = 0;
+#ifdef CONFIG_CAMERA_PROFILES
+static int64_t s_next_frame = 0;
+#endif
+// given on the switch to active, cuts an idle frame period short
+static SemaphoreHandle_t s_wake = NULL;
+
+/* Sets the limit of the current profile, from the PIR task or the detect worker */
+static void profile_apply()
+{
+    // sensor registers are written over SCCB, not from inside the critical section,
+    // the profile is read under the rate lock so that the last switch is the one applied
+    app_rate_lock();
+    portENTER_CRITICAL(&s_profile_mux);
+    camera_profile_t profile = s_profile;
+    portEXIT_CRITICAL(&s_profile_mux);
+    app_rate_set_frame_size_limit(RATE_LIMIT_PROFILE,
+                                  profile == CAMERA_PROFILE_IDLE ? CAMERA_IDLE_FRAME_SIZE : RATE_FRAME_SIZE_MAX);
+    app_rate_unlock();
+    if (profile == CAMERA_PROFILE_ACTIVE && s_wake)
+    {
+        xSemaphoreGive(s_wake);
+    }
+    ESP_LOGI(TAG, "Camera profile %s", s_profile_names[profile]);
+}
+
+/* Returns true when the profile changed */
+static bool profile_activity(int64_t now, bool activity)
+{
+    bool changed = false;
+
+    portENTER_CRITICAL(&s_profile_mux);
+    if (activity)
+    {
+        s_last_activity = now;
+        changed = s_profile != CAMERA_PROFILE_ACTIVE;
+        s_profile = CAMERA_PROFILE_ACTIVE;
+    }
+#ifdef CONFIG_CAMERA_PROFILES
+    else if (s_profile == CAMERA_PROFILE_ACTIVE && now - s_last_activity > PROFILE_IDLE_AFTER_US)
+    {
+        changed = true;
+        s_profile = CAMERA_PROFILE_IDLE;
+        s_next_frame = now;
+    }
+#endif
+    portEXIT_CRITICAL(&s_profile_mux);
+    return changed;
+}
+
+#ifdef CONFIG_CAMERA_PROFILES
+static void profile_pir_event(const pir_event_t *event, void *arg)
+{
+    if (event->level && profile_activity(event->time, true))
+    {
+        profile_apply();
+    }
+}
+#endif
+
+esp_err_t app_camera_profile_init()
+{
+#ifdef CONFIG_CAMERA_PROFILES
+    s_wake = xSemaphoreCreateBinary();
+    if (!s_wake)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    return app_pir_subscribe(profile_pir_event, NULL);
+#else
+    return ESP_OK;
+#endif
+}
+
+void app_camera_profile_reset()
+{
+    portENTER_CRITICAL(&s_profile_mux);
+    bool changed = s_profile != CAMERA_PROFILE_ACTIVE;
+    s_profile = CAMERA_PROFILE_ACTIVE;
+    s_last_activity = esp_timer_get_time();
+    portEXIT_CRITICAL(&s_profile_mux);
+    if (changed)
+    {
+        profile_apply();
+    }
+}
+
+void app_camera_profile_update(bool activity)
+{
+    if (profile_activity(esp_timer_get_time(), activity))
+    {
+        profile_apply();
+    }
+}
+
+void app_camera_profile_throttle()
+{
+#ifdef CONFIG_CAMERA_PROFILES
+    int64_t now = esp_timer_get_time();
+    int64_t wait = 0;
+
+    portENTER_CRITICAL(&s_profile_mux);
+    if (s_profile == CAMERA_PROFILE_IDLE)
+    {
+        wait = s_next_frame - now;
+        s_next_frame = (s_next_frame > now ? s_next_frame : now) + PROFILE_IDLE_PERIOD_US;
+    }
+    portEXIT_CRITICAL(&s_profile_mux);
+    if (wait > 0)
+    {
+        xSemaphoreTake(s_wake, wait / 1000 / portTICK_PERIOD_MS);
+    }
+#endif
+}
+
+camera_profile_t app_camera_profile()
+{
+    return s_profile;
+}
+
+const char *app_camera_profile_name(camera_profile_t profile)
+{
+    return profile < CAMERA_PROFILE_MAX ? s_profile_names[profile] : "unknown";
+}
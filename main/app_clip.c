@@ -0,0 +1,480 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "app_clip.h"
+#include "app_pir.h"
+#include "app_mem.h"
+#include "app_himem.h"
+
+static const char *TAG = "app_clip";
+
+#define CLIP_MAX_FRAMES         256
+#define CLIP_FRAME_US           (1000000 / CONFIG_CLIP_FPS)
+#define CLIP_PRE_US             (CONFIG_CLIP_PRE_S * 1000000LL)
+#define CLIP_POST_US            (CONFIG_CLIP_POST_S * 1000000LL)
+#define CLIP_HOLD_US            (CONFIG_CLIP_HOLD_S * 1000000LL)
+
+/* the small AVI records are collected and written in pieces of this size */
+#define CLIP_OUT_LEN            2048
+/* hdrl list: avih, then a strl list with strh and strf */
+#define CLIP_STRL_LEN           (4 + 8 + 56 + 8 + 40)
+#define CLIP_HDRL_LEN           (4 + 8 + 56 + 8 + CLIP_STRL_LEN)
+
+typedef enum {
+    CLIP_RECORDING,         /* the ring holds the last CONFIG_CLIP_PRE_S */
+    CLIP_POST,              /* triggered, recording until post_end */
+    CLIP_HELD,              /* finished, kept until fetched or hold_end */
+    CLIP_SENDING,
+} clip_state_t;
+
+typedef struct {
+    uint32_t offset;
+    uint32_t len;
+    uint16_t width;
+    uint16_t height;
+    int64_t time;
+} clip_frame_t;
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    clip_write_cb write;
+    void *arg;
+    esp_err_t err;
+} clip_out_t;
+
+#ifdef CONFIG_CLIP_HIMEM
+// the ring is not addressable, offsets are into the himem store from here
+static size_t s_ring_base = 0;
+#else
+static uint8_t *s_ring = NULL;
+#endif
+static size_t s_ring_size = 0;
+static clip_frame_t s_frames[CLIP_MAX_FRAMES];
+static int s_head = 0;              /* oldest frame */
+static int s_count = 0;
+static clip_state_t s_state = CLIP_RECORDING;
+static int64_t s_last_frame = 0;
+static int64_t s_post_end = 0;
+static int64_t s_hold_end = 0;
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static inline clip_frame_t *clip_frame(int i)
+{
+    return &s_frames[(s_head + i) % CLIP_MAX_FRAMES];
+}
+
+/* Moves on from a clip that is over, called with s_mux held */
+static void clip_update_state(int64_t now)
+{
+    if (s_state == CLIP_POST && now >= s_post_end)
+    {
+        s_state = CLIP_HELD;
+        s_hold_end = now + CLIP_HOLD_US;
+    }
+    else if (s_state == CLIP_HELD && now >= s_hold_end)
+    {
+        // nobody fetched it, the frames become the next pre-event part
+        s_state = CLIP_RECORDING;
+    }
+}
+
+/*
+ * Finds room for len bytes after the newest frame, dropping the oldest ones
+ * until it fits. Frames are never split at the end of the ring. Called with s_mux held.
+ */
+static bool clip_reserve(size_t len, uint32_t *offset)
+{
+    if (len > s_ring_size)
+    {
+        return false;
+    }
+    if (s_count == CLIP_MAX_FRAMES)
+    {
+        s_head = (s_head + 1) % CLIP_MAX_FRAMES;
+        s_count--;
+    }
+    while (s_count > 0)
+    {
+        clip_frame_t *first = clip_frame(0);
+        clip_frame_t *last = clip_frame(s_count - 1);
+        uint32_t end = last->offset + last->len;
+        if (last->offset >= first->offset)
+        {
+            if (s_ring_size - end >= len)
+            {
+                *offset = end;
+                return true;
+            }
+            if (first->offset >= len)
+            {
+                *offset = 0;
+                return true;
+            }
+        }
+        else if (first->offset - end >= len)
+        {
+            *offset = end;
+            return true;
+        }
+        s_head = (s_head + 1) % CLIP_MAX_FRAMES;
+        s_count--;
+    }
+    *offset = 0;
+    return true;
+}
+
+void app_clip_add_frame(const camera_fb_t *fb)
+{
+    int64_t now = esp_timer_get_time();
+    uint32_t offset = 0;
+    bool fits = false;
+
+    if (!s_ring_size || fb->format != PIXFORMAT_JPEG || now - s_last_frame < CLIP_FRAME_US)
+    {
+        return;
+    }
+
+    portENTER_CRITICAL(&s_mux);
+    clip_update_state(now);
+    if (s_state == CLIP_RECORDING || s_state == CLIP_POST)
+    {
+        while (s_state == CLIP_RECORDING && s_count > 0 && now - clip_frame(0)->time > CLIP_PRE_US)
+        {
+            s_head = (s_head + 1) % CLIP_MAX_FRAMES;
+            s_count--;
+        }
+        fits = clip_reserve(fb->len, &offset);
+    }
+    portEXIT_CRITICAL(&s_mux);
+    if (!fits)
+    {
+        return;
+    }
+
+    // only this task writes the ring, readers wait for CLIP_HELD
+#ifdef CONFIG_CLIP_HIMEM
+    if (app_himem_write(s_ring_base + offset, fb->buf, fb->len) != ESP_OK)
+    {
+        return;
+    }
+#else
+    memcpy(s_ring + offset, fb->buf, fb->len);
+#endif
+    s_last_frame = now;
+
+    portENTER_CRITICAL(&s_mux);
+    if (s_state == CLIP_RECORDING || s_state == CLIP_POST)
+    {
+        clip_frame_t *frame = &s_frames[(s_head + s_count) % CLIP_MAX_FRAMES];
+        frame->offset = offset;
+        frame->len = fb->len;
+        frame->width = fb->width;
+        frame->height = fb->height;
+        frame->time = now;
+        s_count++;
+    }
+    portEXIT_CRITICAL(&s_mux);
+}
+
+void app_clip_trigger(const char *reason)
+{
+    int64_t now = esp_timer_get_time();
+    bool triggered = false;
+
+    portENTER_CRITICAL(&s_mux);
+    clip_update_state(now);
+    if (s_ring_size && s_state == CLIP_RECORDING)
+    {
+        s_state = CLIP_POST;
+        s_post_end = now + CLIP_POST_US;
+        triggered = true;
+    }
+    portEXIT_CRITICAL(&s_mux);
+
+    if (triggered)
+    {
+        ESP_LOGI(TAG, "Recording a clip, %s", reason);
+    }
+}
+
+static void clip_pir_event(const pir_event_t *event, void *arg)
+{
+    if (event->level)
+    {
+        app_clip_trigger("PIR");
+    }
+}
+
+static void clip_out_flush(clip_out_t *out)
+{
+    if (out->len > 0 && out->err == ESP_OK)
+    {
+        out->err = out->write(out->arg, out->buf, out->len);
+    }
+    out->len = 0;
+}
+
+static void clip_out_put(clip_out_t *out, const void *data, size_t len)
+{
+    if (out->len + len > CLIP_OUT_LEN)
+    {
+        clip_out_flush(out);
+    }
+    if (len >= CLIP_OUT_LEN)
+    {
+        // frames go out straight from the ring
+        if (out->err == ESP_OK)
+        {
+            out->err = out->write(out->arg, data, len);
+        }
+        return;
+    }
+    memcpy(out->buf + out->len, data, len);
+    out->len += len;
+}
+
+static void clip_out_frame(clip_out_t *out, const clip_frame_t *frame)
+{
+#ifdef CONFIG_CLIP_HIMEM
+    // copied out of himem one output piece at a time
+    for (uint32_t done = 0; done < frame->len && out->err == ESP_OK; )
+    {
+        if (out->len == CLIP_OUT_LEN)
+        {
+            clip_out_flush(out);
+        }
+        size_t n = frame->len - done;
+        n = n < CLIP_OUT_LEN - out->len ? n : CLIP_OUT_LEN - out->len;
+        out->err = app_himem_read(s_ring_base + frame->offset + done, out->buf + out->len, n);
+        out->len += n;
+        done += n;
+    }
+#else
+    clip_out_put(out, s_ring + frame->offset, frame->len);
+#endif
+}
+
+static void clip_out_u32(clip_out_t *out, uint32_t v)
+{
+    uint8_t b[4] = { v, v >> 8, v >> 16, v >> 24 };
+    clip_out_put(out, b, 4);
+}
+
+static void clip_out_u16(clip_out_t *out, uint16_t v)
+{
+    uint8_t b[2] = { v, v >> 8 };
+    clip_out_put(out, b, 2);
+}
+
+static void clip_out_fourcc(clip_out_t *out, const char *fourcc)
+{
+    clip_out_put(out, fourcc, 4);
+}
+
+/* RIFF AVI with one MJPEG stream and an idx1 index */
+static void clip_write_avi(clip_out_t *out, int start, int count)
+{
+    uint32_t movi_len = 4;
+    uint32_t max_len = 0;
+    uint16_t width = clip_frame(start)->width;
+    uint16_t height = clip_frame(start)->height;
+    int64_t duration = clip_frame(start + count - 1)->time - clip_frame(start)->time;
+    uint32_t frame_us = count > 1 ? duration / (count - 1) : CLIP_FRAME_US;
+
+    for (int i = start; i < start + count; i++)
+    {
+        uint32_t len = clip_frame(i)->len;
+        movi_len += 8 + len + (len & 1);
+        max_len = len > max_len ? len : max_len;
+    }
+    uint32_t riff_len = 4 + 8 + CLIP_HDRL_LEN + 8 + movi_len + 8 + 16 * count;
+    static const uint8_t pad = 0;
+
+    clip_out_fourcc(out, "RIFF");
+    clip_out_u32(out, riff_len);
+    clip_out_fourcc(out, "AVI ");
+    clip_out_fourcc(out, "LIST");
+    clip_out_u32(out, CLIP_HDRL_LEN);
+    clip_out_fourcc(out, "hdrl");
+
+    clip_out_fourcc(out, "avih");
+    clip_out_u32(out, 56);
+    clip_out_u32(out, frame_us);
+    clip_out_u32(out, (uint64_t)max_len * 1000000 / (frame_us ? frame_us : 1));
+    clip_out_u32(out, 0);
+    clip_out_u32(out, 0x10);            /* AVIF_HASINDEX */
+    clip_out_u32(out, count);
+    clip_out_u32(out, 0);
+    clip_out_u32(out, 1);
+    clip_out_u32(out, max_len);
+    clip_out_u32(out, width);
+    clip_out_u32(out, height);
+    for (int i = 0; i < 4; i++)
+    {
+        clip_out_u32(out, 0);
+    }
+
+    clip_out_fourcc(out, "LIST");
+    clip_out_u32(out, CLIP_STRL_LEN);
+    clip_out_fourcc(out, "strl");
+    clip_out_fourcc(out, "strh");
+    clip_out_u32(out, 56);
+    clip_out_fourcc(out, "vids");
+    clip_out_fourcc(out, "MJPG");
+    clip_out_u32(out, 0);
+    clip_out_u32(out, 0);               /* priority and language */
+    clip_out_u32(out, 0);
+    clip_out_u32(out, frame_us);        /* rate / scale is the frame rate */
+    clip_out_u32(out, 1000000);
+    clip_out_u32(out, 0);
+    clip_out_u32(out, count);
+    clip_out_u32(out, max_len);
+    clip_out_u32(out, 0xFFFFFFFF);
+    clip_out_u32(out, 0);
+    clip_out_u16(out, 0);
+    clip_out_u16(out, 0);
+    clip_out_u16(out, width);
+    clip_out_u16(out, height);
+
+    clip_out_fourcc(out, "strf");
+    clip_out_u32(out, 40);
+    clip_out_u32(out, 40);
+    clip_out_u32(out, width);
+    clip_out_u32(out, height);
+    clip_out_u16(out, 1);
+    clip_out_u16(out, 24);
+    clip_out_fourcc(out, "MJPG");
+    clip_out_u32(out, width * height * 3);
+    for (int i = 0; i < 4; i++)
+    {
+        clip_out_u32(out, 0);
+    }
+
+    clip_out_fourcc(out, "LIST");
+    clip_out_u32(out, movi_len);
+    clip_out_fourcc(out, "movi");
+    for (int i = start; i < start + count && out->err == ESP_OK; i++)
+    {
+        clip_frame_t *frame = clip_frame(i);
+        clip_out_fourcc(out, "00dc");
+        clip_out_u32(out, frame->len);
+        clip_out_frame(out, frame);
+        if (frame->len & 1)
+        {
+            clip_out_put(out, &pad, 1);
+        }
+    }
+
+    // offsets count from the movi fourcc
+    uint32_t offset = 4;
+    clip_out_fourcc(out, "idx1");
+    clip_out_u32(out, 16 * count);
+    for (int i = start; i < start + count && out->err == ESP_OK; i++)
+    {
+        uint32_t len = clip_frame(i)->len;
+        clip_out_fourcc(out, "00dc");
+        clip_out_u32(out, 0x10);        /* AVIIF_KEYFRAME */
+        clip_out_u32(out, offset);
+        clip_out_u32(out, len);
+        offset += 8 + len + (len & 1);
+    }
+    clip_out_flush(out);
+}
+
+esp_err_t app_clip_send(clip_write_cb write, void *arg)
+{
+    int count = 0;
+
+    portENTER_CRITICAL(&s_mux);
+    clip_update_state(esp_timer_get_time());
+    if (s_state == CLIP_HELD && s_count > 0)
+    {
+        s_state = CLIP_SENDING;
+        count = s_count;
+    }
+    portEXIT_CRITICAL(&s_mux);
+    if (count == 0)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    clip_out_t out = {
+        .buf = (uint8_t *)malloc(CLIP_OUT_LEN),
+        .write = write,
+        .arg = arg,
+        .err = ESP_OK,
+    };
+    if (!out.buf)
+    {
+        out.err = ESP_ERR_NO_MEM;
+    }
+    else
+    {
+        clip_write_avi(&out, 0, count);
+        free(out.buf);
+    }
+
+    portENTER_CRITICAL(&s_mux);
+    if (out.err == ESP_OK)
+    {
+        // fetched, start over with an empty ring
+        s_count = 0;
+        s_state = CLIP_RECORDING;
+    }
+    else
+    {
+        s_state = CLIP_HELD;
+    }
+    portEXIT_CRITICAL(&s_mux);
+
+    if (out.err == ESP_OK)
+    {
+        ESP_LOGI(TAG, "Clip of %d frames sent", count);
+    }
+    return out.err;
+}
+
+esp_err_t app_clip_init()
+{
+#ifdef CONFIG_CLIP_HIMEM
+    if (app_himem_reserve(CONFIG_CLIP_HIMEM_KB * 1024, &s_ring_base) != ESP_OK)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    s_ring_size = CONFIG_CLIP_HIMEM_KB * 1024;
+#else
+    s_ring_size = CONFIG_CLIP_BUFFER_KB * 1024;
+    s_ring = (uint8_t *)app_mem_alloc(APP_MEM_CLIP, s_ring_size);
+    if (!s_ring)
+    {
+        s_ring_size = 0;
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+    return app_pir_subscribe(clip_pir_event, NULL);
+}
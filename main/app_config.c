@@ -0,0 +1,525 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "sdkconfig.h"
+#include "cJSON.h"
+#include "app_config.h"
+#include "app_speech_srcif.h"
+#include "app_sleep.h"
+
+static const char *TAG = "app_config";
+
+#define MTMN_NVS_KEY         "mtmn"
+#define MTMN_BLOB_VERSION     1
+#define SPEECH_NVS_KEY       "speech"
+#define SPEECH_BLOB_VERSION   1
+#define NETWORK_NVS_KEY      "wifi"
+#define NETWORK_BLOB_VERSION  1
+
+typedef struct {
+    uint32_t version;
+    mtmn_config_t mtmn;
+} config_blob_t;
+
+typedef struct {
+    uint32_t version;
+    speech_config_t speech;
+} speech_blob_t;
+
+typedef struct {
+    uint32_t version;
+    network_config_t network;
+} network_blob_t;
+
+static SemaphoreHandle_t s_config_lock = NULL;
+static mtmn_config_t s_mtmn;
+static uint32_t s_generation = 0;
+static speech_config_t s_speech;
+static network_config_t s_network;
+
+static bool config_threshold_valid(const threshold_config_t *t)
+{
+    return t->score > 0 && t->score < 1 && t->nms > 0 && t->nms < 1
+        && t->candidate_number > 0 && t->candidate_number <= 100;
+}
+
+static bool config_mtmn_valid(const mtmn_config_t *config)
+{
+    // P-Net works on 12x12 windows, the pyramid must shrink the image
+    return config->min_face >= 12 && config->pyramid > 0 && config->pyramid < 1
+        && config_threshold_valid(&config->p_threshold)
+        && config_threshold_valid(&config->r_threshold)
+        && config_threshold_valid(&config->o_threshold);
+}
+
+static bool config_speech_valid(const speech_config_t *config)
+{
+    return (config->det_mode == 90 || config->det_mode == 95)
+        && strnlen(config->model, sizeof(config->model)) < sizeof(config->model)
+        && app_speech_has_model(config->model);
+}
+
+static bool config_network_valid(const network_config_t *config)
+{
+    size_t password_len = strnlen(config->password, sizeof(config->password));
+
+    return (config->mode == NETWORK_MODE_AP || config->mode == NETWORK_MODE_STA)
+        && strnlen(config->ssid, sizeof(config->ssid)) < sizeof(config->ssid)
+        && password_len < sizeof(config->password)
+        && (password_len == 0 || password_len >= 8)
+        && (config->mode == NETWORK_MODE_AP || config->ssid[0]);
+}
+
+static esp_err_t config_write_blob(const char *key, const void *blob, size_t len)
+{
+    nvs_handle handle;
+
+    esp_err_t err = nvs_open(APP_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    err = nvs_set_blob(handle, key, blob, len);
+    if (err == ESP_OK)
+    {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
+
+static esp_err_t config_save(const mtmn_config_t *config)
+{
+    config_blob_t blob = {
+        .version = MTMN_BLOB_VERSION,
+        .mtmn = *config,
+    };
+    return config_write_blob(MTMN_NVS_KEY, &blob, sizeof(blob));
+}
+
+static void config_load(mtmn_config_t *config)
+{
+    nvs_handle handle;
+    config_blob_t blob;
+    size_t len = sizeof(blob);
+
+    if (nvs_open(APP_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
+    {
+        return;
+    }
+    if (nvs_get_blob(handle, MTMN_NVS_KEY, &blob, &len) == ESP_OK
+    && len == sizeof(blob) && blob.version == MTMN_BLOB_VERSION)
+    {
+        if (config_mtmn_valid(&blob.mtmn))
+        {
+            *config = blob.mtmn;
+            ESP_LOGI(TAG, "MTMN settings loaded, min_face %.0f, pyramid %.2f", config->min_face, config->pyramid);
+        }
+        else
+        {
+            ESP_LOGW(TAG, "Saved MTMN settings are invalid, using defaults");
+        }
+    }
+    nvs_close(handle);
+}
+
+static void config_load_speech(speech_config_t *config)
+{
+    nvs_handle handle;
+    speech_blob_t blob;
+    size_t len = sizeof(blob);
+
+    if (nvs_open(APP_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
+    {
+        return;
+    }
+    if (nvs_get_blob(handle, SPEECH_NVS_KEY, &blob, &len) == ESP_OK
+    && len == sizeof(blob) && blob.version == SPEECH_BLOB_VERSION)
+    {
+        if (config_speech_valid(&blob.speech))
+        {
+            *config = blob.speech;
+        }
+        else
+        {
+            // e.g. the model is no longer linked in
+            ESP_LOGW(TAG, "Saved wake word settings are invalid, using defaults");
+        }
+    }
+    nvs_close(handle);
+}
+
+static void config_load_network(network_config_t *config)
+{
+    nvs_handle handle;
+    network_blob_t blob;
+    size_t len = sizeof(blob);
+
+    if (nvs_open(APP_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
+    {
+        return;
+    }
+    if (nvs_get_blob(handle, NETWORK_NVS_KEY, &blob, &len) == ESP_OK
+    && len == sizeof(blob) && blob.version == NETWORK_BLOB_VERSION)
+    {
+        if (config_network_valid(&blob.network))
+        {
+            *config = blob.network;
+        }
+        else
+        {
+            ESP_LOGW(TAG, "Saved WiFi settings are invalid, using defaults");
+        }
+    }
+    nvs_close(handle);
+}
+
+esp_err_t app_config_init()
+{
+    s_config_lock = xSemaphoreCreateMutex();
+    if (!s_config_lock)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    s_mtmn = mtmn_init_config();
+    config_load(&s_mtmn);
+
+    // the lightest model in the image at the stricter mode, unless saved otherwise
+    const char *model = app_speech_model_name(0);
+    strlcpy(s_speech.model, model ? model : "", sizeof(s_speech.model));
+    s_speech.det_mode = 95;
+    config_load_speech(&s_speech);
+
+#ifdef CONFIG_WIFI_MODE_STA
+    s_network.mode = NETWORK_MODE_STA;
+#else
+    s_network.mode = NETWORK_MODE_AP;
+#endif
+    strlcpy(s_network.ssid, CONFIG_ESP_WIFI_SSID, sizeof(s_network.ssid));
+    strlcpy(s_network.password, CONFIG_ESP_WIFI_PASSWORD, sizeof(s_network.password));
+#ifdef CONFIG_WIFI_HT40
+    s_network.ht40 = true;
+#endif
+    // kept over deep sleep, saves the NVS read on the way back
+    if (!app_sleep_get_network(&s_network))
+    {
+        config_load_network(&s_network);
+    }
+    s_generation++;
+    return ESP_OK;
+}
+
+uint32_t app_config_get_mtmn(mtmn_config_t *config)
+{
+    uint32_t generation;
+
+    xSemaphoreTake(s_config_lock, portMAX_DELAY);
+    *config = s_mtmn;
+    generation = s_generation;
+    xSemaphoreGive(s_config_lock);
+    return generation;
+}
+
+esp_err_t app_config_set_mtmn(const mtmn_config_t *config)
+{
+    if (!config_mtmn_valid(config))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(s_config_lock, portMAX_DELAY);
+    s_mtmn = *config;
+    s_generation++;
+    xSemaphoreGive(s_config_lock);
+
+    esp_err_t err = config_save(config);
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Saving MTMN settings failed (0x%x)", err);
+    }
+    return err;
+}
+
+void app_config_get_speech(speech_config_t *config)
+{
+    xSemaphoreTake(s_config_lock, portMAX_DELAY);
+    *config = s_speech;
+    xSemaphoreGive(s_config_lock);
+}
+
+esp_err_t app_config_set_speech(const speech_config_t *config)
+{
+    if (!config_speech_valid(config))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(s_config_lock, portMAX_DELAY);
+    s_speech = *config;
+    xSemaphoreGive(s_config_lock);
+
+    speech_blob_t blob = {
+        .version = SPEECH_BLOB_VERSION,
+        .speech = *config,
+    };
+    esp_err_t err = config_write_blob(SPEECH_NVS_KEY, &blob, sizeof(blob));
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Saving wake word settings failed (0x%x)", err);
+    }
+    return err;
+}
+
+void app_config_get_network(network_config_t *config)
+{
+    xSemaphoreTake(s_config_lock, portMAX_DELAY);
+    *config = s_network;
+    xSemaphoreGive(s_config_lock);
+}
+
+esp_err_t app_config_set_network(const network_config_t *config)
+{
+    if (!config_network_valid(config))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(s_config_lock, portMAX_DELAY);
+    s_network = *config;
+    xSemaphoreGive(s_config_lock);
+
+    network_blob_t blob = {
+        .version = NETWORK_BLOB_VERSION,
+        .network = *config,
+    };
+    esp_err_t err = config_write_blob(NETWORK_NVS_KEY, &blob, sizeof(blob));
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Saving WiFi settings failed (0x%x)", err);
+    }
+    return err;
+}
+
+static bool config_string_from_json(const cJSON *item, char *buf, size_t len)
+{
+    if (!cJSON_IsString(item) || strlen(item->valuestring) >= len)
+    {
+        return false;
+    }
+    strcpy(buf, item->valuestring);
+    return true;
+}
+
+static cJSON *config_threshold_to_json(const threshold_config_t *t)
+{
+    cJSON *obj = cJSON_CreateObject();
+    cJSON_AddNumberToObject(obj, "score", t->score);
+    cJSON_AddNumberToObject(obj, "nms", t->nms);
+    cJSON_AddNumberToObject(obj, "candidate_number", t->candidate_number);
+    return obj;
+}
+
+static bool config_threshold_from_json(const cJSON *obj, threshold_config_t *t)
+{
+    cJSON *item;
+
+    if (!obj)
+    {
+        return true;
+    }
+    if (!cJSON_IsObject(obj))
+    {
+        return false;
+    }
+    if ((item = cJSON_GetObjectItem(obj, "score")))
+    {
+        if (!cJSON_IsNumber(item))
+            return false;
+        t->score = item->valuedouble;
+    }
+    if ((item = cJSON_GetObjectItem(obj, "nms")))
+    {
+        if (!cJSON_IsNumber(item))
+            return false;
+        t->nms = item->valuedouble;
+    }
+    if ((item = cJSON_GetObjectItem(obj, "candidate_number")))
+    {
+        if (!cJSON_IsNumber(item))
+            return false;
+        t->candidate_number = item->valueint;
+    }
+    return true;
+}
+
+char *app_config_to_json()
+{
+    mtmn_config_t config;
+    speech_config_t speech_config;
+    network_config_t network_config;
+    app_config_get_mtmn(&config);
+    app_config_get_speech(&speech_config);
+    app_config_get_network(&network_config);
+
+    cJSON *root = cJSON_CreateObject();
+    if (!root)
+    {
+        return NULL;
+    }
+    cJSON *mtmn = cJSON_CreateObject();
+    cJSON_AddItemToObject(root, "mtmn", mtmn);
+    cJSON_AddNumberToObject(mtmn, "min_face", config.min_face);
+    cJSON_AddNumberToObject(mtmn, "pyramid", config.pyramid);
+    cJSON_AddItemToObject(mtmn, "p_threshold", config_threshold_to_json(&config.p_threshold));
+    cJSON_AddItemToObject(mtmn, "r_threshold", config_threshold_to_json(&config.r_threshold));
+    cJSON_AddItemToObject(mtmn, "o_threshold", config_threshold_to_json(&config.o_threshold));
+
+    cJSON *speech = cJSON_CreateObject();
+    cJSON_AddItemToObject(root, "speech", speech);
+    cJSON_AddStringToObject(speech, "model", speech_config.model);
+    cJSON_AddNumberToObject(speech, "det_mode", speech_config.det_mode);
+    cJSON *models = cJSON_CreateArray();
+    cJSON_AddItemToObject(speech, "models", models);
+    for (int i = 0; app_speech_model_name(i); i++)
+    {
+        cJSON_AddItemToArray(models, cJSON_CreateString(app_speech_model_name(i)));
+    }
+
+    cJSON *wifi = cJSON_CreateObject();
+    cJSON_AddItemToObject(root, "wifi", wifi);
+    cJSON_AddStringToObject(wifi, "mode", network_config.mode == NETWORK_MODE_STA ? "sta" : "ap");
+    cJSON_AddStringToObject(wifi, "ssid", network_config.ssid);
+    cJSON_AddBoolToObject(wifi, "ht40", network_config.ht40);
+
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return json;
+}
+
+esp_err_t app_config_from_json(const char *json)
+{
+    mtmn_config_t config;
+    speech_config_t speech_config;
+    network_config_t network_config;
+    cJSON *item;
+    bool ok = true;
+
+    cJSON *root = cJSON_Parse(json);
+    if (!root)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    app_config_get_mtmn(&config);
+    cJSON *mtmn = cJSON_GetObjectItem(root, "mtmn");
+    if (mtmn)
+    {
+        ok = cJSON_IsObject(mtmn);
+        if (ok && (item = cJSON_GetObjectItem(mtmn, "min_face")))
+        {
+            ok = cJSON_IsNumber(item);
+            config.min_face = item->valuedouble;
+        }
+        if (ok && (item = cJSON_GetObjectItem(mtmn, "pyramid")))
+        {
+            ok = cJSON_IsNumber(item);
+            config.pyramid = item->valuedouble;
+        }
+        ok = ok && config_threshold_from_json(cJSON_GetObjectItem(mtmn, "p_threshold"), &config.p_threshold);
+        ok = ok && config_threshold_from_json(cJSON_GetObjectItem(mtmn, "r_threshold"), &config.r_threshold);
+        ok = ok && config_threshold_from_json(cJSON_GetObjectItem(mtmn, "o_threshold"), &config.o_threshold);
+        ok = ok && config_mtmn_valid(&config);
+    }
+
+    app_config_get_speech(&speech_config);
+    cJSON *speech = cJSON_GetObjectItem(root, "speech");
+    if (ok && speech)
+    {
+        ok = cJSON_IsObject(speech);
+        if (ok && (item = cJSON_GetObjectItem(speech, "model")))
+        {
+            ok = config_string_from_json(item, speech_config.model, sizeof(speech_config.model));
+        }
+        if (ok && (item = cJSON_GetObjectItem(speech, "det_mode")))
+        {
+            ok = cJSON_IsNumber(item);
+            speech_config.det_mode = item->valueint;
+        }
+        ok = ok && config_speech_valid(&speech_config);
+    }
+
+    app_config_get_network(&network_config);
+    cJSON *wifi = cJSON_GetObjectItem(root, "wifi");
+    if (ok && wifi)
+    {
+        ok = cJSON_IsObject(wifi);
+        if (ok && (item = cJSON_GetObjectItem(wifi, "mode")))
+        {
+            ok = cJSON_IsString(item) && (!strcmp(item->valuestring, "ap") || !strcmp(item->valuestring, "sta"));
+            if (ok)
+            {
+                network_config.mode = strcmp(item->valuestring, "sta") ? NETWORK_MODE_AP : NETWORK_MODE_STA;
+            }
+        }
+        if (ok && (item = cJSON_GetObjectItem(wifi, "ssid")))
+        {
+            ok = config_string_from_json(item, network_config.ssid, sizeof(network_config.ssid));
+        }
+        if (ok && (item = cJSON_GetObjectItem(wifi, "password")))
+        {
+            ok = config_string_from_json(item, network_config.password, sizeof(network_config.password));
+        }
+        if (ok && (item = cJSON_GetObjectItem(wifi, "ht40")))
+        {
+            ok = cJSON_IsBool(item);
+            network_config.ht40 = cJSON_IsTrue(item);
+        }
+        ok = ok && config_network_valid(&network_config);
+    }
+    cJSON_Delete(root);
+
+    // nothing is applied unless every part is valid
+    if (!ok)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = ESP_OK;
+    if (mtmn)
+    {
+        err = app_config_set_mtmn(&config);
+    }
+    if (speech)
+    {
+        esp_err_t speech_err = app_config_set_speech(&speech_config);
+        err = err == ESP_OK ? speech_err : err;
+    }
+    if (wifi)
+    {
+        esp_err_t network_err = app_config_set_network(&network_config);
+        err = err == ESP_OK ? network_err : err;
+    }
+    return err;
+}
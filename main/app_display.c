@@ -0,0 +1,440 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "ssd1306.h"
+#include "app_display.h"
+#include "app_event.h"
+#include "app_tasks.h"
+#include "app_mem.h"
+
+#ifdef CONFIG_APP_DISPLAY
+static const char *TAG = "app_display";
+
+typedef struct {
+    display_done_cb_t done;
+    void *arg;
+} display_waiter_t;
+
+// panel layout, a byte is a column of 8 pixels in a page
+static uint8_t s_frame[DISPLAY_PAGES][DISPLAY_WIDTH];
+static uint8_t s_dirty = 0;
+// pages the panel may not show as in s_panel, sent even if unchanged
+static uint8_t s_resend = (1 << DISPLAY_PAGES) - 1;
+static display_waiter_t s_waiters[DISPLAY_MAX_WAITERS];
+static int s_waiter_count = 0;
+
+static SFontAtlas s_atlas;
+static bool s_atlas_ok = false;
+
+static SemaphoreHandle_t s_lock = NULL;
+static TaskHandle_t s_task = NULL;
+
+// what was sent last, only the display task uses it
+static uint8_t s_panel[DISPLAY_PAGES][DISPLAY_WIDTH];
+
+#ifdef CONFIG_OLED_POWER_SAVE
+typedef enum {
+    DISPLAY_POWER_ON,
+    DISPLAY_POWER_DIM,
+    DISPLAY_POWER_OFF,
+} display_power_t;
+
+/* Contrast of the library init sequence, and the dimmed one */
+#define DISPLAY_CONTRAST        0x7f
+#define DISPLAY_DIM_CONTRAST    0x01
+
+// only the display task changes the power state
+static display_power_t s_power = DISPLAY_POWER_ON;
+static int64_t s_active_us;
+static volatile bool s_wake;
+
+static void display_state_changed(en_fsm_state state, en_fsm_state prev, app_event_type_t event, void *arg)
+{
+    s_wake = true;
+    xTaskNotifyGive(s_task);
+}
+
+/* Call with the panel locked, returns the ticks until the next step */
+static TickType_t display_power_step(bool active)
+{
+    int64_t now = esp_timer_get_time();
+
+    if (active)
+    {
+        s_active_us = now;
+        if (s_power == DISPLAY_POWER_OFF)
+        {
+            // the panel kept its memory, what it shows is still up to date
+            ssd1306_displayOn();
+        }
+        if (s_power != DISPLAY_POWER_ON)
+        {
+            ssd1306_setContrast(DISPLAY_CONTRAST);
+            s_power = DISPLAY_POWER_ON;
+        }
+    }
+    int64_t idle = now - s_active_us;
+    if (s_power == DISPLAY_POWER_ON && idle >= CONFIG_OLED_DIM_S * 1000000LL)
+    {
+        ssd1306_setContrast(DISPLAY_DIM_CONTRAST);
+        s_power = DISPLAY_POWER_DIM;
+    }
+    if (s_power == DISPLAY_POWER_DIM && idle >= CONFIG_OLED_OFF_S * 1000000LL)
+    {
+        ssd1306_displayOff();
+        s_power = DISPLAY_POWER_OFF;
+    }
+    if (s_power == DISPLAY_POWER_OFF)
+    {
+        return portMAX_DELAY;
+    }
+    int64_t left = (s_power == DISPLAY_POWER_ON ? CONFIG_OLED_DIM_S : CONFIG_OLED_OFF_S) * 1000000LL - idle;
+    return left / 1000 / portTICK_PERIOD_MS + 1;
+}
+#endif
+
+static void display_pixel(int x, int y)
+{
+    if (x < 0 || x >= DISPLAY_WIDTH || y < 0 || y >= DISPLAY_HEIGHT)
+    {
+        return;
+    }
+    s_frame[y >> 3][x] |= 1 << (y & 7);
+    s_dirty |= 1 << (y >> 3);
+}
+
+static void display_char(int x, int y, const SCharInfo *info, EFontStyle style, EFontSize size)
+{
+    const uint8_t *glyph = info->glyph;
+    int scale = 1 << size;
+
+    for (int page = 0; page * 8 < info->height; page++)
+    {
+        uint8_t last = 0;
+        for (int col = 0; col < info->width; col++)
+        {
+            uint8_t data = *glyph++;
+            if (style == STYLE_BOLD)
+            {
+                uint8_t column = data;
+                data |= last;
+                last = column;
+            }
+            for (int bit = 0; bit < 8 && page * 8 + bit < info->height; bit++)
+            {
+                if (!(data & (1 << bit)))
+                {
+                    continue;
+                }
+                int row = page * 8 + bit;
+                // lean right, a pixel for every 4 rows above the base line
+                int shift = style == STYLE_ITALIC ? ((info->height - 1 - row) * scale) >> 2 : 0;
+                for (int dy = 0; dy < scale; dy++)
+                {
+                    for (int dx = 0; dx < scale; dx++)
+                    {
+                        display_pixel(x + col * scale + dx + shift, y + row * scale + dy);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// copies the page rows of the char, shifted down when y is not on a page
+static int display_atlas_char(int x, int y, uint16_t unicode)
+{
+    int shift = y & 7;
+    int width = 0;
+
+    for (uint8_t row = 0; row < s_atlas.pages; row++)
+    {
+        const uint8_t *data;
+        width = ssd1306_getAtlasColumns(&s_atlas, unicode, row, &data);
+        int page = (y >> 3) + row;
+        if (!data || page >= DISPLAY_PAGES)
+        {
+            continue;
+        }
+        int cols = x + width > DISPLAY_WIDTH ? DISPLAY_WIDTH - x : width;
+        for (int col = 0; col < cols; col++)
+        {
+            s_frame[page][x + col] |= data[col] << shift;
+        }
+        s_dirty |= 1 << page;
+        if (shift && page + 1 < DISPLAY_PAGES)
+        {
+            for (int col = 0; col < cols; col++)
+            {
+                s_frame[page + 1][x + col] |= data[col] >> (8 - shift);
+            }
+            s_dirty |= 1 << (page + 1);
+        }
+    }
+    return width;
+}
+
+void app_display_clear()
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    memset(s_frame, 0, sizeof(s_frame));
+    s_dirty = (1 << DISPLAY_PAGES) - 1;
+    xSemaphoreGive(s_lock);
+}
+
+void app_display_text(uint8_t x, uint8_t y, const char *text, EFontStyle style, EFontSize size)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int pos = x; *text && pos < DISPLAY_WIDTH; text++)
+    {
+        uint16_t unicode = ssd1306_unicode16FromUtf8(*text);
+        if (unicode == SSD1306_MORE_CHARS_REQUIRED)
+        {
+            continue;
+        }
+        if (s_atlas_ok && style == STYLE_NORMAL && size == FONT_SIZE_2X)
+        {
+            pos += display_atlas_char(pos, y, unicode);
+            continue;
+        }
+        SCharInfo info;
+        ssd1306_getCharBitmap(unicode, &info);
+        display_char(pos, y, &info, style, size);
+        pos += (info.width + info.spacing) << size;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+void app_display_image(const uint8_t image[DISPLAY_PAGES][DISPLAY_WIDTH])
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < DISPLAY_PAGES; i++)
+    {
+        // a still scene leaves most pages as they are, they stay off the bus
+        if (memcmp(s_frame[i], image[i], DISPLAY_WIDTH))
+        {
+            memcpy(s_frame[i], image[i], DISPLAY_WIDTH);
+            s_dirty |= 1 << i;
+        }
+    }
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t app_display_columns(uint8_t page, uint8_t x, const uint8_t *data, size_t len)
+{
+    if (page >= DISPLAY_PAGES || x + len > DISPLAY_WIDTH)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    memcpy(&s_frame[page][x], data, len);
+    s_dirty |= 1 << page;
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+void app_display_printf(uint8_t x, uint8_t y, EFontStyle style, EFontSize size, const char *format, ...)
+{
+    char text[DISPLAY_TEXT_MAX];
+    va_list args;
+
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    app_display_text(x, y, text, style, size);
+}
+
+esp_err_t app_display_flush(display_done_cb_t done, void *arg)
+{
+    esp_err_t res = ESP_OK;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (done && s_waiter_count < DISPLAY_MAX_WAITERS)
+    {
+        s_waiters[s_waiter_count].done = done;
+        s_waiters[s_waiter_count].arg = arg;
+        s_waiter_count++;
+    }
+    else if (done)
+    {
+        res = ESP_ERR_NO_MEM;
+    }
+    xSemaphoreGive(s_lock);
+    xTaskNotifyGive(s_task);
+    return res;
+}
+
+static void display_task(void *arg)
+{
+    uint8_t page[DISPLAY_WIDTH];
+    display_waiter_t waiters[DISPLAY_MAX_WAITERS];
+#ifdef CONFIG_OLED_POWER_SAVE
+    // the splash counts as the first content
+    TickType_t wait = CONFIG_OLED_DIM_S * 1000 / portTICK_PERIOD_MS;
+#else
+    TickType_t wait = portMAX_DELAY;
+#endif
+
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        // callbacks registered until now are done once the dirty pages are out
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        int count = s_waiter_count;
+        memcpy(waiters, s_waiters, count * sizeof(display_waiter_t));
+        s_waiter_count = 0;
+        xSemaphoreGive(s_lock);
+
+        // the library may be loaded with another display, see ssd1306_displayBegin
+        ssd1306_platform_lock();
+        bool sent = false;
+        for (int i = 0; i < DISPLAY_PAGES; i++)
+        {
+            // copied so that drawing goes on while the page is on the bus
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            bool dirty = s_dirty & (1 << i);
+            bool resend = s_resend & (1 << i);
+            if (dirty)
+            {
+                memcpy(page, s_frame[i], sizeof(page));
+                s_dirty &= ~(1 << i);
+                s_resend &= ~(1 << i);
+            }
+            xSemaphoreGive(s_lock);
+            // a clear and the same text again leaves the page as it is on the panel
+            if (dirty && (resend || memcmp(s_panel[i], page, sizeof(page))))
+            {
+                ssd1306_drawBuffer(0, i * 8, DISPLAY_WIDTH, 8, page);
+                memcpy(s_panel[i], page, sizeof(page));
+                sent = true;
+            }
+        }
+#ifdef CONFIG_OLED_POWER_SAVE
+        bool wake = s_wake;
+        s_wake = false;
+        wait = display_power_step(sent || wake);
+#else
+        (void)sent;
+#endif
+        ssd1306_platform_unlock();
+
+        for (int i = 0; i < count; i++)
+        {
+            waiters[i].done(waiters[i].arg);
+        }
+    }
+}
+
+void app_display_run(void (*fn)(void *arg), void *arg)
+{
+    ssd1306_platform_lock();
+    fn(arg);
+    ssd1306_platform_unlock();
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_dirty = (1 << DISPLAY_PAGES) - 1;
+    s_resend = (1 << DISPLAY_PAGES) - 1;
+    xSemaphoreGive(s_lock);
+    xTaskNotifyGive(s_task);
+}
+
+esp_err_t app_display_init()
+{
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // without the atlas 2x text is scaled pixel by pixel
+    uint16_t size = ssd1306_createFontAtlas(NULL, NULL, 0, DISPLAY_ATLAS_FIRST, DISPLAY_ATLAS_COUNT,
+                                            STYLE_NORMAL, FONT_SIZE_2X);
+    uint8_t *buf = size ? (uint8_t *)app_mem_alloc(APP_MEM_FONT_ATLAS, size) : NULL;
+    if (buf)
+    {
+        s_atlas_ok = ssd1306_createFontAtlas(&s_atlas, buf, size, DISPLAY_ATLAS_FIRST, DISPLAY_ATLAS_COUNT,
+                                             STYLE_NORMAL, FONT_SIZE_2X) != 0;
+    }
+    ESP_LOGI(TAG, "Font atlas: %u bytes%s", size, s_atlas_ok ? "" : ", not used");
+#ifdef CONFIG_OLED_POWER_SAVE
+    s_active_us = esp_timer_get_time();
+#endif
+    esp_err_t err = app_task_create(APP_TASK_DISPLAY, &display_task, NULL, &s_task);
+#ifdef CONFIG_OLED_POWER_SAVE
+    if (err == ESP_OK)
+    {
+        err = app_event_subscribe(display_state_changed, NULL);
+    }
+#endif
+    return err;
+}
+#else
+// the display is left out of the pipeline profile, drawing goes nowhere
+esp_err_t app_display_init()
+{
+    return ESP_OK;
+}
+
+void app_display_clear()
+{
+}
+
+void app_display_text(uint8_t x, uint8_t y, const char *text, EFontStyle style, EFontSize size)
+{
+}
+
+void app_display_image(const uint8_t image[DISPLAY_PAGES][DISPLAY_WIDTH])
+{
+}
+
+esp_err_t app_display_columns(uint8_t page, uint8_t x, const uint8_t *data, size_t len)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void app_display_printf(uint8_t x, uint8_t y, EFontStyle style, EFontSize size, const char *format, ...)
+{
+}
+
+esp_err_t app_display_flush(display_done_cb_t done, void *arg)
+{
+    if (done)
+    {
+        done(arg);
+    }
+    return ESP_OK;
+}
+
+void app_display_run(void (*fn)(void *arg), void *arg)
+{
+    // the panel was never set up, it is still off
+}
+#endif
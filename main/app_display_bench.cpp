@@ -0,0 +1,229 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "cJSON.h"
+#include "sdkconfig.h"
+#include "ssd1306.h"
+#include "nano_engine.h"
+#include "app_display.h"
+#include "app_display_bench.h"
+
+static const char *TAG = "app_display_bench";
+
+static const char *s_op_names[DISPLAY_BENCH_MAX] = {
+    "clear_screen",
+    "print_fixed",
+    "print_fixed_2x",
+    "draw_bitmap",
+    "canvas_fill_rect",
+    "canvas_blt",
+    "tiler_refresh",
+};
+
+static const char s_line[] = "0123456789ABCDEFGHIJ";
+static const char s_line_2x[] = "0123456789";
+
+static uint8_t s_bitmap[DISPLAY_PAGES * DISPLAY_WIDTH];
+static NanoCanvas1 s_canvas(DISPLAY_WIDTH, DISPLAY_HEIGHT, s_bitmap);
+static NanoEngine1 s_engine;
+
+typedef struct {
+    display_bench_result_t *result;
+    esp_err_t err;
+} display_bench_job_t;
+
+static bool display_bench_draw_tile()
+{
+    s_engine.canvas.clear();
+    s_engine.canvas.drawRect(4, 4, DISPLAY_WIDTH - 5, DISPLAY_HEIGHT - 5);
+    return true;
+}
+
+static void display_bench_op(display_bench_op_t op)
+{
+    switch (op)
+    {
+    case DISPLAY_BENCH_CLEAR:
+        ssd1306_clearScreen();
+        break;
+    case DISPLAY_BENCH_PRINT:
+        ssd1306_printFixed(0, 0, s_line, STYLE_NORMAL);
+        break;
+    case DISPLAY_BENCH_PRINT_2X:
+        ssd1306_printFixedN(0, 16, s_line_2x, STYLE_NORMAL, FONT_SIZE_2X);
+        break;
+    case DISPLAY_BENCH_BITMAP:
+        ssd1306_drawBitmap(0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT, s_bitmap);
+        break;
+    case DISPLAY_BENCH_CANVAS_FILL:
+        s_canvas.fillRect(8, 4, DISPLAY_WIDTH - 9, DISPLAY_HEIGHT - 5);
+        break;
+    case DISPLAY_BENCH_CANVAS_BLT:
+        s_canvas.blt(0, 0);
+        break;
+    case DISPLAY_BENCH_TILER:
+        s_engine.refresh();
+        s_engine.display();
+        break;
+    default:
+        break;
+    }
+}
+
+static uint32_t display_bench_bytes(display_bench_op_t op)
+{
+    STextSize size;
+
+    switch (op)
+    {
+    case DISPLAY_BENCH_PRINT:
+        ssd1306_measureText(s_line, FONT_SIZE_NORMAL, 0, &size);
+        return size.width * ((size.height + 7) / 8);
+    case DISPLAY_BENCH_PRINT_2X:
+        ssd1306_measureText(s_line_2x, FONT_SIZE_2X, 0, &size);
+        return size.width * ((size.height + 7) / 8);
+    case DISPLAY_BENCH_CANVAS_FILL:
+        return 0;
+    default:
+        return sizeof(s_bitmap);
+    }
+}
+
+static void display_bench_job(void *arg)
+{
+    display_bench_job_t *job = (display_bench_job_t *)arg;
+    display_bench_result_t *result = job->result;
+
+    job->err = ssd1306_platform_i2cBusClock(DISPLAY_I2C_NUM, result->clock_hz);
+    if (job->err != ESP_OK)
+    {
+        return;
+    }
+    for (int i = 0; i < DISPLAY_PAGES * DISPLAY_WIDTH; i++)
+    {
+        s_bitmap[i] = (i & 1) ? 0xAA : 0x55;
+    }
+    s_engine.begin();
+    s_engine.drawCallback(display_bench_draw_tile);
+#ifdef CONFIG_SSD1306_INTF_STATS_ENABLE
+    ssd1306_intfStatsAttach();
+#endif
+
+    for (int op = 0; op < DISPLAY_BENCH_MAX; op++)
+    {
+        display_bench_stats_t *stats = &result->ops[op];
+        uint64_t sum = 0;
+
+        stats->min_us = UINT32_MAX;
+        stats->max_us = 0;
+#ifdef CONFIG_SSD1306_INTF_STATS_ENABLE
+        ssd1306_intfStatsReset();
+#endif
+        for (int i = 0; i < DISPLAY_BENCH_RUNS; i++)
+        {
+            int64_t start = esp_timer_get_time();
+            display_bench_op((display_bench_op_t)op);
+            uint32_t us = esp_timer_get_time() - start;
+            sum += us;
+            if (us < stats->min_us)
+            {
+                stats->min_us = us;
+            }
+            if (us > stats->max_us)
+            {
+                stats->max_us = us;
+            }
+        }
+        stats->mean_us = sum / DISPLAY_BENCH_RUNS;
+        stats->bytes = display_bench_bytes((display_bench_op_t)op);
+#ifdef CONFIG_SSD1306_INTF_STATS_ENABLE
+        ssd1306_intf_stats_t traffic;
+        ssd1306_intfStatsGet(&traffic);
+        stats->bus_bytes = traffic.bytes / DISPLAY_BENCH_RUNS;
+        stats->transactions = traffic.transactions / DISPLAY_BENCH_RUNS;
+#endif
+    }
+#ifdef CONFIG_SSD1306_INTF_STATS_ENABLE
+    ssd1306_intfStatsDetach();
+#endif
+    ssd1306_platform_i2cBusClock(DISPLAY_I2C_NUM, CONFIG_OLED_I2C_CLOCK_HZ);
+}
+
+esp_err_t app_display_bench_run(uint32_t clock_hz, display_bench_result_t *result)
+{
+    display_bench_job_t job = { result, ESP_OK };
+
+    memset(result, 0, sizeof(*result));
+    result->clock_hz = clock_hz;
+    app_display_run(display_bench_job, &job);
+    if (job.err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Clock %u Hz not set: %s", clock_hz, esp_err_to_name(job.err));
+        return job.err;
+    }
+    ESP_LOGI(TAG, "Clock %u Hz: clear %u us, full screen blt %u us", clock_hz,
+             result->ops[DISPLAY_BENCH_CLEAR].mean_us, result->ops[DISPLAY_BENCH_CANVAS_BLT].mean_us);
+    return ESP_OK;
+}
+
+char *app_display_bench_to_json(const display_bench_result_t *results, int count)
+{
+    cJSON *root = cJSON_CreateObject();
+    if (!root)
+    {
+        return NULL;
+    }
+    cJSON_AddStringToObject(root, "transport", "i2c");
+    cJSON_AddNumberToObject(root, "runs", DISPLAY_BENCH_RUNS);
+    cJSON *array = cJSON_CreateArray();
+    cJSON_AddItemToObject(root, "results", array);
+    for (int i = 0; i < count; i++)
+    {
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddItemToArray(array, item);
+        cJSON_AddNumberToObject(item, "clock_hz", results[i].clock_hz);
+        cJSON *ops = cJSON_CreateObject();
+        cJSON_AddItemToObject(item, "ops", ops);
+        for (int op = 0; op < DISPLAY_BENCH_MAX; op++)
+        {
+            const display_bench_stats_t *stats = &results[i].ops[op];
+            cJSON *entry = cJSON_CreateObject();
+            cJSON_AddItemToObject(ops, s_op_names[op], entry);
+            cJSON_AddNumberToObject(entry, "mean_us", stats->mean_us);
+            cJSON_AddNumberToObject(entry, "min_us", stats->min_us);
+            cJSON_AddNumberToObject(entry, "max_us", stats->max_us);
+            cJSON_AddNumberToObject(entry, "bytes", stats->bytes);
+#ifdef CONFIG_SSD1306_INTF_STATS_ENABLE
+            cJSON_AddNumberToObject(entry, "bus_bytes", stats->bus_bytes);
+            cJSON_AddNumberToObject(entry, "transactions", stats->transactions);
+#endif
+            cJSON_AddNumberToObject(entry, "bytes_per_s",
+                                    stats->mean_us ? stats->bytes * 1000000.0 / stats->mean_us : 0);
+        }
+    }
+
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return json;
+}
@@ -0,0 +1,389 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "fr_forward.h"
+#include "app_enroll.h"
+#include "app_face_store.h"
+#include "app_pipeline.h"
+#include "app_main.h"
+#include "app_tasks.h"
+#include "app_mem.h"
+#ifdef CONFIG_ENROLL_UPLOAD
+#include "esp_camera.h"
+#include "app_config.h"
+#include "app_image.h"
+#include "app_track.h"
+#include "app_face_align.h"
+#include "app_face_db.h"
+#endif
+
+static const char *TAG = "app_enroll";
+
+/* Aligned faces waiting for the enrollment task */
+#define ENROLL_QUEUE_LEN    2
+
+static QueueHandle_t s_free_queue = NULL;
+static QueueHandle_t s_face_queue = NULL;
+static QueueHandle_t s_event_queue = NULL;
+static portMUX_TYPE s_status_mux = portMUX_INITIALIZER_UNLOCKED;
+static enroll_event_t s_status = { ENROLL_EVENT_NONE, 0, -1, 0 };
+static int s_submitted = 0;
+
+static void enroll_publish(enroll_event_type_t type, int samples, int id)
+{
+    enroll_event_t event = {
+        .type = type,
+        .samples = samples,
+        .id = id,
+        .time = esp_timer_get_time(),
+    };
+
+    portENTER_CRITICAL(&s_status_mux);
+    s_status = event;
+    portEXIT_CRITICAL(&s_status_mux);
+    xQueueOverwrite(s_event_queue, &event);
+}
+
+static void enroll_task(void *arg)
+{
+    dl_matrix3du_t *face = NULL;
+    dl_matrix3d_t *sum = dl_matrix3d_alloc(1, 1, 1, FACE_ID_SIZE);
+    int samples = 0;
+
+    memset(sum->item, 0, FACE_ID_SIZE * sizeof(fptp_t));
+    while (true)
+    {
+        xQueueReceive(s_face_queue, &face, portMAX_DELAY);
+
+        dl_matrix3d_t *face_id = get_face_id(face);
+        xQueueSend(s_free_queue, &face, portMAX_DELAY);
+        for (int i = 0; i < FACE_ID_SIZE; i++)
+        {
+            sum->item[i] += face_id->item[i];
+        }
+        dl_matrix3d_free(face_id);
+
+        samples++;
+        ESP_LOGD(TAG, "Enrollment: Taken the %d%s sample", samples, number_suffix(samples));
+        if (samples < ENROLL_CONFIRM_TIMES)
+        {
+            enroll_publish(ENROLL_EVENT_SAMPLE, samples, -1);
+            continue;
+        }
+
+        // the store keeps the embedding unit length, the sum needs no averaging
+        int id = app_face_store_add(sum);
+        memset(sum->item, 0, FACE_ID_SIZE * sizeof(fptp_t));
+        samples = 0;
+        if (id >= 0)
+        {
+            ESP_LOGI(TAG, "Enrolled Face ID: %d", id);
+            enroll_publish(ENROLL_EVENT_DONE, ENROLL_CONFIRM_TIMES, id);
+        }
+        else
+        {
+            enroll_publish(ENROLL_EVENT_FAILED, ENROLL_CONFIRM_TIMES, -1);
+        }
+        portENTER_CRITICAL(&s_status_mux);
+        s_submitted = 0;
+        portEXIT_CRITICAL(&s_status_mux);
+        app_event_post(APP_EVENT_ENROLL_DONE);
+    }
+}
+
+bool app_enroll_submit(dl_matrix3du_t *aligned_face)
+{
+    dl_matrix3du_t *face = NULL;
+    bool full;
+
+    portENTER_CRITICAL(&s_status_mux);
+    full = s_submitted >= ENROLL_CONFIRM_TIMES;
+    portEXIT_CRITICAL(&s_status_mux);
+    if (full || xQueueReceive(s_free_queue, &face, 0) != pdTRUE)
+    {
+        return false;
+    }
+
+    memcpy(face->item, aligned_face->item, FACE_WIDTH * FACE_HEIGHT * 3);
+    portENTER_CRITICAL(&s_status_mux);
+    s_submitted++;
+    portEXIT_CRITICAL(&s_status_mux);
+    xQueueSend(s_face_queue, &face, portMAX_DELAY);
+    return true;
+}
+
+void app_enroll_get_status(enroll_event_t *status)
+{
+    portENTER_CRITICAL(&s_status_mux);
+    *status = s_status;
+    portEXIT_CRITICAL(&s_status_mux);
+}
+
+bool app_enroll_get_event(enroll_event_t *event, TickType_t timeout)
+{
+    if (!s_event_queue)
+    {
+        // not initialized before the wake word, check back now and then
+        vTaskDelay(timeout < 1000 / portTICK_PERIOD_MS ? timeout : 1000 / portTICK_PERIOD_MS);
+        return false;
+    }
+    return xQueueReceive(s_event_queue, event, timeout) == pdTRUE;
+}
+
+#ifdef CONFIG_ENROLL_UPLOAD
+/* Uploaded images are decoded at 1/2, 1/4 or 1/8 until they fit */
+#define ENROLL_UPLOAD_PIXELS    (640 * 480)
+/* A name is set once the writer has appended the face */
+#define ENROLL_NAME_WAIT_MS     2000
+
+typedef struct {
+    uint8_t *buf;           /* JPEGs back to back, from app_mem_alloc */
+    size_t len;
+    char name[FACE_NAME_MAX];
+} enroll_upload_t;
+
+static QueueHandle_t s_upload_queue = NULL;
+static track_faces_t s_upload_faces;
+
+/* Length of the JPEG at p up to its end of image marker, 0 when there is none */
+static size_t enroll_jpeg_len(const uint8_t *p, size_t len)
+{
+    size_t i = 2;
+
+    if (len < 4 || p[0] != 0xFF || p[1] != 0xD8)
+    {
+        return 0;
+    }
+    while (i + 1 < len)
+    {
+        if (p[i] != 0xFF)
+        {
+            return 0;
+        }
+        uint8_t marker = p[i + 1];
+        if (marker == 0xFF)
+        {
+            i++;
+            continue;
+        }
+        if (marker == 0xD9)
+        {
+            return i + 2;
+        }
+        if ((marker >= 0xD0 && marker <= 0xD7) || marker == 0x01)
+        {
+            i += 2;
+            continue;
+        }
+        if (i + 3 >= len)
+        {
+            return 0;
+        }
+        i += 2 + (p[i + 2] << 8 | p[i + 3]);
+        if (marker == 0xDA)
+        {
+            // entropy coded data runs up to the next marker that is not a restart or a stuffed 0
+            while (i + 1 < len && !(p[i] == 0xFF && p[i + 1] != 0 && (p[i + 1] < 0xD0 || p[i + 1] > 0xD7)))
+            {
+                i++;
+            }
+        }
+    }
+    return 0;
+}
+
+/* Adds the embedding of the largest face in a JPEG to sum, false when none was found */
+static bool enroll_upload_image(const uint8_t *jpeg, size_t len, dl_matrix3du_t *aligned, dl_matrix3d_t *sum)
+{
+    size_t width, height;
+    int scale = 1;
+
+    if (!app_image_jpeg_size(jpeg, len, &width, &height))
+    {
+        return false;
+    }
+    while (scale < 8 && (width / scale) * (height / scale) > ENROLL_UPLOAD_PIXELS)
+    {
+        scale *= 2;
+    }
+    dl_matrix3du_t *image = app_mem_matrix_alloc(APP_MEM_ENROLL_UPLOAD, width / scale, height / scale, 3);
+    if (!image)
+    {
+        ESP_LOGW(TAG, "No memory for a %ux%u upload", width / scale, height / scale);
+        return false;
+    }
+    camera_fb_t fb = {
+        .buf = (uint8_t *)jpeg,
+        .len = len,
+        .width = width,
+        .height = height,
+        .format = PIXFORMAT_JPEG,
+    };
+    mtmn_config_t config;
+    app_config_get_mtmn(&config);
+    config.min_face = config.min_face / scale < 12 ? 12 : config.min_face / scale;
+
+    bool found = false;
+    if (app_image_decode_scaled(&fb, scale, image) && app_track_face_detect(image, &config, &s_upload_faces) > 0)
+    {
+        box_array_t *boxes = &s_upload_faces.array;
+        int best = 0;
+        for (int i = 1; i < boxes->len; i++)
+        {
+            if (boxes->box[i].box_p[2] - boxes->box[i].box_p[0] > boxes->box[best].box_p[2] - boxes->box[best].box_p[0])
+            {
+                best = i;
+            }
+        }
+#ifdef CONFIG_FACE_ALIGN_FAST
+        found = app_face_align(image, &boxes->landmark[best], aligned) == ESP_OK;
+#else
+        box_array_t one = {
+            .box = &boxes->box[best],
+            .landmark = &boxes->landmark[best],
+            .len = 1,
+        };
+        found = align_face(&one, image, aligned) == ESP_OK;
+#endif
+    }
+    app_mem_matrix_free(APP_MEM_ENROLL_UPLOAD, image);
+    if (found)
+    {
+        dl_matrix3d_t *face_id = get_face_id(aligned);
+        for (int i = 0; i < FACE_ID_SIZE; i++)
+        {
+            sum->item[i] += face_id->item[i];
+        }
+        dl_matrix3d_free(face_id);
+    }
+    return found;
+}
+
+/*
+ * Runs below the pipeline stages, so it only gets the CPU they leave idle.
+ * All images of an upload make one face, written as a single record.
+ */
+static void enroll_upload_task(void *arg)
+{
+    dl_matrix3du_t *aligned = app_mem_matrix_alloc(APP_MEM_FACE_SAMPLE, FACE_WIDTH, FACE_HEIGHT, 3);
+    dl_matrix3d_t *sum = dl_matrix3d_alloc(1, 1, 1, FACE_ID_SIZE);
+    enroll_upload_t upload;
+
+    while (true)
+    {
+        xQueueReceive(s_upload_queue, &upload, portMAX_DELAY);
+        int64_t start = esp_timer_get_time();
+        int images = 0, faces = 0;
+
+        memset(sum->item, 0, FACE_ID_SIZE * sizeof(fptp_t));
+        for (size_t off = 0, n; off < upload.len && (n = enroll_jpeg_len(upload.buf + off, upload.len - off)) > 0; off += n)
+        {
+            images++;
+            if (aligned && sum && enroll_upload_image(upload.buf + off, n, aligned, sum))
+            {
+                faces++;
+                enroll_publish(ENROLL_EVENT_SAMPLE, faces, -1);
+            }
+        }
+        app_mem_free(APP_MEM_ENROLL_UPLOAD, upload.buf, upload.len);
+
+        int id = faces ? app_face_store_add(sum) : -1;
+        ESP_LOGI(TAG, "Upload of %d images, %d faces, face ID %d in %ums", images, faces, id,
+                (uint32_t)((esp_timer_get_time() - start) / 1000));
+        if (id < 0)
+        {
+            enroll_publish(ENROLL_EVENT_FAILED, faces, -1);
+            continue;
+        }
+        for (int waited = 0; upload.name[0] && waited < ENROLL_NAME_WAIT_MS; waited += 50)
+        {
+            if (app_face_store_set_name(id, upload.name) != ESP_ERR_NOT_FOUND)
+            {
+                break;
+            }
+            vTaskDelay(50 / portTICK_PERIOD_MS);
+        }
+        enroll_publish(ENROLL_EVENT_DONE, faces, id);
+    }
+}
+
+esp_err_t app_enroll_upload(uint8_t *buf, size_t len, const char *name)
+{
+    enroll_upload_t upload = {
+        .buf = buf,
+        .len = len,
+    };
+    esp_err_t err = ESP_OK;
+
+    if (!s_upload_queue)
+    {
+        err = ESP_ERR_INVALID_STATE;
+    }
+    else if (enroll_jpeg_len(buf, len) == 0 || (name && strlen(name) >= FACE_NAME_MAX))
+    {
+        err = ESP_ERR_INVALID_ARG;
+    }
+    else
+    {
+        strlcpy(upload.name, name ? name : "", sizeof(upload.name));
+        err = xQueueSend(s_upload_queue, &upload, 0) == pdTRUE ? ESP_OK : ESP_ERR_INVALID_STATE;
+    }
+    if (err != ESP_OK)
+    {
+        app_mem_free(APP_MEM_ENROLL_UPLOAD, buf, len);
+    }
+    return err;
+}
+#endif
+
+esp_err_t app_enroll_init()
+{
+    s_free_queue = xQueueCreate(ENROLL_QUEUE_LEN, sizeof(dl_matrix3du_t *));
+    s_face_queue = xQueueCreate(ENROLL_QUEUE_LEN, sizeof(dl_matrix3du_t *));
+    s_event_queue = xQueueCreate(1, sizeof(enroll_event_t));
+    if (!s_free_queue || !s_face_queue || !s_event_queue)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < ENROLL_QUEUE_LEN; i++)
+    {
+        dl_matrix3du_t *face = app_mem_matrix_alloc(APP_MEM_FACE_SAMPLE, FACE_WIDTH, FACE_HEIGHT, 3);
+        if (!face)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+        xQueueSend(s_free_queue, &face, portMAX_DELAY);
+    }
+#ifdef CONFIG_ENROLL_UPLOAD
+    s_upload_queue = xQueueCreate(1, sizeof(enroll_upload_t));
+    if (!s_upload_queue || app_task_create(APP_TASK_ENROLL_UPLOAD, &enroll_upload_task, NULL, NULL) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Uploads cannot be enrolled");
+    }
+#endif
+    return app_task_create(APP_TASK_ENROLL, &enroll_task, NULL, NULL);
+}
@@ -0,0 +1,295 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "app_event.h"
+#include "app_tasks.h"
+#include "app_face_db.h"
+#include "app_face_store.h"
+
+static const char *TAG = "app_event";
+
+#define EVENT_QUEUE_LEN     16
+
+typedef struct {
+    app_state_cb callback;
+    void *arg;
+} event_subscriber_t;
+
+static QueueHandle_t s_event_queue = NULL;
+static EventGroupHandle_t s_state_bits = NULL;
+static volatile en_fsm_state s_state = WAIT_FOR_WAKEUP;
+static event_subscriber_t s_subscribers[APP_EVENT_MAX_SUBSCRIBERS];
+static int s_subscriber_count = 0;
+static portMUX_TYPE s_subscriber_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *s_state_names[APP_STATE_MAX] = {
+    [WAIT_FOR_WAKEUP]   = "wait_for_wakeup",
+    [WAIT_FOR_CONNECT]  = "wait_for_connect",
+    [START_DETECT]      = "detect",
+    [START_RECOGNITION] = "recognition",
+    [START_ENROLL]      = "enroll",
+    [START_DELETE]      = "delete",
+};
+
+/* Dwell times of the states left so far, the current one is added on reading */
+static app_state_stats_t s_state_stats[APP_STATE_MAX];
+static uint32_t s_transitions[APP_STATE_MAX][APP_STATE_MAX];
+static int64_t s_entered = 0;
+static portMUX_TYPE s_stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/* Enters the new state together with its time, readers see both or neither */
+static void event_account(en_fsm_state prev, en_fsm_state state, int64_t now)
+{
+    int64_t dwell = now - s_entered;
+
+    portENTER_CRITICAL(&s_stats_mux);
+    s_state_stats[prev].total_us += dwell;
+    s_state_stats[prev].last_us = dwell;
+    if (dwell > s_state_stats[prev].max_us)
+    {
+        s_state_stats[prev].max_us = dwell;
+    }
+    s_state_stats[state].entries++;
+    s_transitions[prev][state]++;
+    s_entered = now;
+    s_state = state;
+    portEXIT_CRITICAL(&s_stats_mux);
+}
+
+static en_fsm_state event_streaming_state()
+{
+#ifdef CONFIG_APP_RECOGNITION
+    return app_face_db_count() > 0 ? START_RECOGNITION : START_DETECT;
+#else
+    return START_DETECT;
+#endif
+}
+
+static en_fsm_state event_next_state(en_fsm_state state, app_event_type_t type)
+{
+#ifdef CONFIG_APP_RECOGNITION
+    bool streaming = state == START_DETECT || state == START_RECOGNITION;
+#endif
+
+    switch (type)
+    {
+#ifdef CONFIG_HEADLESS
+    // the pipeline runs from the wakeup on, viewers come and go
+    case APP_EVENT_WAKEUP:
+        return state == WAIT_FOR_WAKEUP ? event_streaming_state() : state;
+    case APP_EVENT_VIEWER_FIRST:
+    case APP_EVENT_VIEWER_LAST:
+        return state;
+#else
+    case APP_EVENT_WAKEUP:
+        return state == WAIT_FOR_WAKEUP ? WAIT_FOR_CONNECT : state;
+    case APP_EVENT_VIEWER_FIRST:
+        return state == WAIT_FOR_CONNECT ? event_streaming_state() : state;
+    case APP_EVENT_VIEWER_LAST:
+#if defined(CONFIG_APP_SPEECH) || defined(CONFIG_PIR_WAKEUP)
+        return WAIT_FOR_WAKEUP;
+#else
+        // nothing would wake the board again
+        return WAIT_FOR_CONNECT;
+#endif
+#endif
+#ifdef CONFIG_APP_ENROLLMENT
+    case APP_EVENT_ENROLL:
+        return streaming ? START_ENROLL : state;
+    case APP_EVENT_ENROLL_DONE:
+        return state == START_ENROLL ? event_streaming_state() : state;
+#endif
+#ifdef CONFIG_APP_RECOGNITION
+    case APP_EVENT_DELETE:
+        return streaming ? START_DELETE : state;
+#endif
+    default:
+        return state;
+    }
+}
+
+static void event_update_bits(en_fsm_state state)
+{
+    if (state == WAIT_FOR_WAKEUP)
+    {
+        xEventGroupClearBits(s_state_bits, STATE_WAKEUP_BIT);
+        xEventGroupSetBits(s_state_bits, STATE_LISTEN_BIT);
+    }
+    else if (state == WAIT_FOR_CONNECT)
+    {
+        xEventGroupClearBits(s_state_bits, STATE_LISTEN_BIT);
+        xEventGroupSetBits(s_state_bits, STATE_WAKEUP_BIT);
+    }
+    else
+    {
+        xEventGroupSetBits(s_state_bits, STATE_WAKEUP_BIT);
+#ifdef CONFIG_SPEECH_CONTINUOUS
+        // voice commands are taken while streaming
+        xEventGroupSetBits(s_state_bits, STATE_LISTEN_BIT);
+#else
+        xEventGroupClearBits(s_state_bits, STATE_LISTEN_BIT);
+#endif
+    }
+}
+
+static void event_enter(en_fsm_state state, app_event_type_t type)
+{
+    event_subscriber_t subscribers[APP_EVENT_MAX_SUBSCRIBERS];
+    en_fsm_state prev = s_state;
+    int64_t now = esp_timer_get_time();
+
+    ESP_LOGI(TAG, "State %s -> %s on event %d after %u ms", app_event_state_name(prev), app_event_state_name(state),
+             type, (uint32_t)((now - s_entered) / 1000));
+    event_account(prev, state, now);
+    event_update_bits(state);
+
+    portENTER_CRITICAL(&s_subscriber_mux);
+    int count = s_subscriber_count;
+    memcpy(subscribers, s_subscribers, count * sizeof(event_subscriber_t));
+    portEXIT_CRITICAL(&s_subscriber_mux);
+
+    for (int i = 0; i < count; i++)
+    {
+        subscribers[i].callback(state, prev, type, subscribers[i].arg);
+    }
+}
+
+static void event_task(void *arg)
+{
+    app_event_type_t type;
+
+    while (true)
+    {
+        xQueueReceive(s_event_queue, &type, portMAX_DELAY);
+        en_fsm_state next = event_next_state(s_state, type);
+        if (next == s_state)
+        {
+            ESP_LOGD(TAG, "Event %d ignored in state %d", type, s_state);
+            continue;
+        }
+        event_enter(next, type);
+
+        // the deletion is done right here, subscribers still see START_DELETE go by
+        if (next == START_DELETE)
+        {
+            int left = app_face_store_remove_oldest();
+            ESP_LOGW(TAG, "%d ID Left", left);
+            event_enter(left > 0 ? START_RECOGNITION : START_DETECT, type);
+        }
+    }
+}
+
+void app_event_post(app_event_type_t type)
+{
+    if (xQueueSend(s_event_queue, &type, 0) != pdTRUE)
+    {
+        ESP_LOGW(TAG, "Event queue full, event %d dropped", type);
+    }
+}
+
+void IRAM_ATTR app_event_post_from_isr(app_event_type_t type, BaseType_t *woken)
+{
+    xQueueSendFromISR(s_event_queue, &type, woken);
+}
+
+esp_err_t app_event_subscribe(app_state_cb callback, void *arg)
+{
+    esp_err_t err = ESP_OK;
+
+    portENTER_CRITICAL(&s_subscriber_mux);
+    if (s_subscriber_count < APP_EVENT_MAX_SUBSCRIBERS)
+    {
+        s_subscribers[s_subscriber_count].callback = callback;
+        s_subscribers[s_subscriber_count].arg = arg;
+        s_subscriber_count++;
+    }
+    else
+    {
+        err = ESP_ERR_NO_MEM;
+    }
+    portEXIT_CRITICAL(&s_subscriber_mux);
+    return err;
+}
+
+en_fsm_state app_event_state()
+{
+    return s_state;
+}
+
+const char *app_event_state_name(en_fsm_state state)
+{
+    return state < APP_STATE_MAX ? s_state_names[state] : "unknown";
+}
+
+void app_event_get_state_stats(en_fsm_state state, app_state_stats_t *stats)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_stats_mux);
+    *stats = s_state_stats[state];
+    if (state == s_state)
+    {
+        // the visit in progress counts, its length is not final yet
+        stats->total_us += now - s_entered;
+        stats->max_us = now - s_entered > stats->max_us ? now - s_entered : stats->max_us;
+    }
+    portEXIT_CRITICAL(&s_stats_mux);
+}
+
+uint32_t app_event_transitions(en_fsm_state from, en_fsm_state to)
+{
+    return s_transitions[from][to];
+}
+
+int64_t app_event_state_since()
+{
+    portENTER_CRITICAL(&s_stats_mux);
+    int64_t entered = s_entered;
+    portEXIT_CRITICAL(&s_stats_mux);
+    return entered;
+}
+
+EventBits_t app_state_wait(EventBits_t bits, TickType_t timeout)
+{
+    return xEventGroupWaitBits(s_state_bits, bits, pdFALSE, pdFALSE, timeout);
+}
+
+esp_err_t app_event_init()
+{
+    s_event_queue = xQueueCreate(EVENT_QUEUE_LEN, sizeof(app_event_type_t));
+    s_state_bits = xEventGroupCreate();
+    if (!s_event_queue || !s_state_bits)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    s_state = WAIT_FOR_WAKEUP;
+    s_entered = esp_timer_get_time();
+    s_state_stats[WAIT_FOR_WAKEUP].entries = 1;
+    event_update_bits(s_state);
+    return app_task_create(APP_TASK_EVENT, &event_task, NULL, NULL);
+}
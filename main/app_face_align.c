@@ -0,0 +1,162 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include <math.h>
+#include "esp_heap_caps.h"
+#include "fr_forward.h"
+#include "app_face_align.h"
+#include "app_image_kernel.h"
+
+#ifdef CONFIG_FACE_ALIGN_FAST
+#define FACE_ALIGN_POINTS       5
+
+/* Largest copy of the face region, bigger regions are reduced on the way in */
+#define FACE_ALIGN_CROP_PIXELS  (FACE_WIDTH * FACE_HEIGHT * 2)
+
+/*
+ * Landmarks of a frontal face on a 56x56 crop: eyes, nose, mouth corners.
+ * Scaled to FACE_WIDTH x FACE_HEIGHT.
+ */
+static const float s_reference[FACE_ALIGN_POINTS * 2] = {
+    19.15f, 25.85f,
+    36.77f, 25.75f,
+    28.01f, 35.87f,
+    20.77f, 46.18f,
+    35.36f, 46.10f,
+};
+
+/*
+ * Least squares fit of scale, rotation and shift from the reference to the
+ * landmarks: src = [a -b; b a] * ref + t. Rows of m are x and y.
+ */
+static bool face_similarity(const landmark_t *landmark, float m[6])
+{
+    const float *p = landmark->landmark_p;
+    float rx = 0, ry = 0, sx = 0, sy = 0;
+
+    for (int i = 0; i < FACE_ALIGN_POINTS; i++)
+    {
+        rx += s_reference[2 * i] * FACE_WIDTH / 56;
+        ry += s_reference[2 * i + 1] * FACE_HEIGHT / 56;
+        sx += p[2 * i];
+        sy += p[2 * i + 1];
+    }
+    rx /= FACE_ALIGN_POINTS;
+    ry /= FACE_ALIGN_POINTS;
+    sx /= FACE_ALIGN_POINTS;
+    sy /= FACE_ALIGN_POINTS;
+
+    float dot = 0, cross = 0, norm = 0;
+    for (int i = 0; i < FACE_ALIGN_POINTS; i++)
+    {
+        float qx = s_reference[2 * i] * FACE_WIDTH / 56 - rx;
+        float qy = s_reference[2 * i + 1] * FACE_HEIGHT / 56 - ry;
+        float px = p[2 * i] - sx;
+        float py = p[2 * i + 1] - sy;
+        dot += qx * px + qy * py;
+        cross += qx * py - qy * px;
+        norm += qx * qx + qy * qy;
+    }
+    float a = dot / norm;
+    float b = cross / norm;
+    if (a * a + b * b < 1e-4f)
+    {
+        return false;
+    }
+    m[0] = a;
+    m[1] = -b;
+    m[2] = sx - a * rx + b * ry;
+    m[3] = b;
+    m[4] = a;
+    m[5] = sy - b * rx - a * ry;
+    return true;
+}
+
+esp_err_t app_face_align(dl_matrix3du_t *image, const landmark_t *landmark, dl_matrix3du_t *aligned)
+{
+    float m[6];
+
+    if (!face_similarity(landmark, m))
+    {
+        return ESP_FAIL;
+    }
+
+    // the part of the image under the aligned face, with a pixel to spare for the blend
+    float x0 = INFINITY, y0 = INFINITY, x1 = -INFINITY, y1 = -INFINITY;
+    for (int i = 0; i < 4; i++)
+    {
+        float u = i & 1 ? aligned->w : 0;
+        float v = i & 2 ? aligned->h : 0;
+        float x = m[0] * u + m[1] * v + m[2];
+        float y = m[3] * u + m[4] * v + m[5];
+        x0 = fminf(x0, x);
+        y0 = fminf(y0, y);
+        x1 = fmaxf(x1, x);
+        y1 = fmaxf(y1, y);
+    }
+    image_rect_t rect;
+    rect.x = x0 < 1 ? 0 : (int)x0 - 1;
+    rect.y = y0 < 1 ? 0 : (int)y0 - 1;
+    rect.width = (x1 + 2 > image->w ? image->w : (int)x1 + 2) - rect.x;
+    rect.height = (y1 + 2 > image->h ? image->h : (int)y1 + 2) - rect.y;
+    if (rect.width < 2 || rect.height < 2)
+    {
+        return ESP_FAIL;
+    }
+
+    // faces much larger than the output are reduced, by area, while they are copied
+    float k = 1;
+    if (rect.width * rect.height > FACE_ALIGN_CROP_PIXELS)
+    {
+        k = sqrtf((float)FACE_ALIGN_CROP_PIXELS / (rect.width * rect.height));
+    }
+    image_t crop = {
+        .width = rect.width * k < 2 ? 2 : (int)(rect.width * k),
+        .height = rect.height * k < 2 ? 2 : (int)(rect.height * k),
+        .stride = 0,
+        .format = IMAGE_BGR888,
+    };
+    crop.buf = (uint8_t *)heap_caps_malloc(crop.width * crop.height * 3, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!crop.buf)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    image_t src, dst;
+    app_image_from_matrix(image, &src);
+    app_image_from_matrix(aligned, &dst);
+    esp_err_t err = app_image_resize(&src, &rect, &crop, IMAGE_RESIZE_AREA);
+    if (err == ESP_OK)
+    {
+        // image positions to crop positions, then to 16.16
+        float kx = (float)crop.width / rect.width;
+        float ky = (float)crop.height / rect.height;
+        int32_t fixed[6] = {
+            (int32_t)(m[0] * kx * 65536), (int32_t)(m[1] * kx * 65536), (int32_t)((m[2] - rect.x) * kx * 65536),
+            (int32_t)(m[3] * ky * 65536), (int32_t)(m[4] * ky * 65536), (int32_t)((m[5] - rect.y) * ky * 65536),
+        };
+        err = app_image_warp(&crop, fixed, &dst);
+    }
+    free(crop.buf);
+    return err;
+}
+#endif
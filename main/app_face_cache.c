@@ -0,0 +1,138 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "fr_forward.h"
+#include "app_face_cache.h"
+#include "app_face_db.h"
+#include "app_pipeline.h"
+#include "app_image.h"
+
+#define FACE_CACHE_SIZE         PIPELINE_MAX_FACES
+#define FACE_CACHE_IOU          0.5f
+#define FACE_CACHE_LOST_US      (500 * 1000)
+#define FACE_CACHE_REFRESH_US   (CONFIG_FACE_CACHE_REFRESH_MS * 1000LL)
+
+/* matches this close to the threshold are refreshed sooner */
+#define FACE_CACHE_MARGIN       0.05f
+
+static const char *TAG = "app_face_cache";
+
+typedef struct {
+    box_t box;
+    int id;
+    float similarity;
+    int64_t recognized;
+    int64_t seen;
+    bool used;
+} face_cache_entry_t;
+
+static face_cache_entry_t s_entries[FACE_CACHE_SIZE];
+static uint32_t s_generation = 0;
+
+static face_cache_entry_t *face_cache_find(const box_t *box, int64_t now)
+{
+    face_cache_entry_t *best = NULL;
+    float best_iou = FACE_CACHE_IOU;
+
+    for (int i = 0; i < FACE_CACHE_SIZE; i++)
+    {
+        face_cache_entry_t *e = &s_entries[i];
+        if (!e->used || now - e->seen > FACE_CACHE_LOST_US)
+            continue;
+
+        float iou = app_image_box_iou(&e->box, box);
+        if (iou >= best_iou)
+        {
+            best = e;
+            best_iou = iou;
+        }
+    }
+    return best;
+}
+
+void app_face_cache_reset()
+{
+    memset(s_entries, 0, sizeof(s_entries));
+    s_generation = app_face_db_generation();
+}
+
+bool app_face_cache_lookup(const box_t *box, int *id, float *similarity)
+{
+    if (FACE_CACHE_REFRESH_US == 0)
+        return false;
+
+    // enrolled or deleted IDs invalidate every result
+    if (s_generation != app_face_db_generation())
+    {
+        ESP_LOGD(TAG, "Face database changed");
+        app_face_cache_reset();
+        return false;
+    }
+
+    int64_t now = esp_timer_get_time();
+    face_cache_entry_t *e = face_cache_find(box, now);
+    if (!e)
+        return false;
+
+    e->box = *box;
+    e->seen = now;
+    *id = e->id;
+    *similarity = e->similarity;
+
+    int64_t refresh = FACE_CACHE_REFRESH_US;
+    if (e->similarity > FACE_REC_THRESHOLD - FACE_CACHE_MARGIN
+            && e->similarity < FACE_REC_THRESHOLD + FACE_CACHE_MARGIN)
+        refresh /= 2;
+    return now - e->recognized <= refresh;
+}
+
+void app_face_cache_store(const box_t *box, int id, float similarity)
+{
+    if (FACE_CACHE_REFRESH_US == 0)
+        return;
+
+    int64_t now = esp_timer_get_time();
+    face_cache_entry_t *e = face_cache_find(box, now);
+    if (!e)
+    {
+        // take a free entry, or the one not seen for the longest time
+        e = &s_entries[0];
+        for (int i = 0; i < FACE_CACHE_SIZE && e->used; i++)
+        {
+            if (!s_entries[i].used || s_entries[i].seen < e->seen)
+                e = &s_entries[i];
+        }
+    }
+
+    if (e->used && e->id != id)
+    {
+        ESP_LOGD(TAG, "Face ID %d -> %d (%.3f)", e->id, id, similarity);
+    }
+    e->box = *box;
+    e->id = id;
+    e->similarity = similarity;
+    e->recognized = now;
+    e->seen = now;
+    e->used = true;
+}
@@ -0,0 +1,607 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include <math.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "app_face_db.h"
+#include "app_mem.h"
+
+static const char *TAG = "app_face_db";
+
+/*
+ * Embeddings are kept unit length and quantized, int8 with a per vector scale
+ * for the stored faces and int16 for the query, so a match is one int32 dot product.
+ */
+#define FACE_DB_Q8      127
+#define FACE_DB_Q16     32767
+
+static SemaphoreHandle_t s_db_lock = NULL;
+static face_entry_t *s_entries = NULL;  /* no holes */
+static int s_capacity = 0;
+static int s_count = 0;
+static int s_named = 0;
+static volatile uint32_t s_generation = 0;
+
+/* id -> entry index, open addressing with linear probing, at most half full */
+#define FACE_DB_SLOT_EMPTY      -1
+static int32_t *s_slots = NULL;
+static uint32_t s_slot_mask = 0;
+
+static float face_db_max_abs(const fptp_t *v, float *norm)
+{
+    float max = 0;
+    float sum = 0;
+
+    for (int i = 0; i < FACE_ID_SIZE; i++)
+    {
+        float a = fabsf(v[i]);
+        max = a > max ? a : max;
+        sum += v[i] * v[i];
+    }
+    *norm = sqrtf(sum);
+    return max;
+}
+
+static float face_db_quantize8(const fptp_t *v, int8_t *q)
+{
+    float norm;
+    float max = face_db_max_abs(v, &norm);
+
+    if (max == 0 || norm == 0)
+    {
+        memset(q, 0, FACE_ID_SIZE);
+        return 0;
+    }
+    float k = FACE_DB_Q8 / max;
+    for (int i = 0; i < FACE_ID_SIZE; i++)
+    {
+        q[i] = (int8_t)lrintf(v[i] * k);
+    }
+    return 1 / (k * norm);
+}
+
+float app_face_db_quantize(dl_matrix3d_t *face_id, int8_t *q)
+{
+    return face_db_quantize8(face_id->item, q);
+}
+
+static float face_db_quantize16(const fptp_t *v, int16_t *q)
+{
+    float norm;
+    float max = face_db_max_abs(v, &norm);
+
+    if (max == 0 || norm == 0)
+    {
+        memset(q, 0, FACE_ID_SIZE * sizeof(int16_t));
+        return 0;
+    }
+    float k = FACE_DB_Q16 / max;
+    for (int i = 0; i < FACE_ID_SIZE; i++)
+    {
+        q[i] = (int16_t)lrintf(v[i] * k);
+    }
+    return 1 / (k * norm);
+}
+
+static inline int32_t face_db_dot(const int16_t *a, const int8_t *b)
+{
+    int32_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+
+    // four independent accumulators keep the MAC pipeline busy
+    for (int i = 0; i < FACE_ID_SIZE; i += 4)
+    {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    return s0 + s1 + s2 + s3;
+}
+
+#ifdef CONFIG_FACE_DB_INDEX
+/*
+ * Coarse index: the entries are clustered around a few centroids kept in
+ * internal RAM. A match compares the query with every centroid first and then
+ * only with the entries of the closest clusters, entries added since the
+ * last rebuild join the cluster of their nearest centroid.
+ */
+#define FACE_DB_CLUSTERS        CONFIG_FACE_DB_INDEX_CLUSTERS
+#define FACE_DB_PROBE           CONFIG_FACE_DB_INDEX_PROBE
+/* below this a linear pass is about as fast */
+#define FACE_DB_INDEX_MIN       (FACE_DB_CLUSTERS * 16)
+#define FACE_DB_KMEANS_ROUNDS   4
+#define FACE_DB_UNASSIGNED      0xFF
+
+static int8_t *s_centroids = NULL;      /* FACE_DB_CLUSTERS x FACE_ID_SIZE */
+static float s_centroid_scale[FACE_DB_CLUSTERS];
+static uint8_t *s_clusters = NULL;      /* cluster of each entry */
+static bool s_indexed = false;
+static int s_indexed_count = 0;         /* entries when the centroids were built */
+
+static inline int32_t face_db_dot8(const int8_t *a, const int8_t *b)
+{
+    int32_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+
+    for (int i = 0; i < FACE_ID_SIZE; i += 4)
+    {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    return s0 + s1 + s2 + s3;
+}
+
+static uint8_t face_db_nearest(const int8_t *vec, const int8_t *centroids, const float *scales)
+{
+    uint8_t best = 0;
+    float best_similarity = -INFINITY;
+
+    // the entry scale is the same for every centroid and left out
+    for (int c = 0; c < FACE_DB_CLUSTERS; c++)
+    {
+        float similarity = face_db_dot8(vec, centroids + c * FACE_ID_SIZE) * scales[c];
+        if (similarity > best_similarity)
+        {
+            best = c;
+            best_similarity = similarity;
+        }
+    }
+    return best;
+}
+
+/* Clusters to search for a query, every bit set while there is no index */
+static uint64_t face_db_probe(const int16_t *query)
+{
+    float similarity[FACE_DB_CLUSTERS];
+    uint64_t probe = 0;
+
+    if (!s_indexed || s_count < FACE_DB_INDEX_MIN)
+    {
+        return ~0ULL;
+    }
+    for (int c = 0; c < FACE_DB_CLUSTERS; c++)
+    {
+        similarity[c] = face_db_dot(query, s_centroids + c * FACE_ID_SIZE) * s_centroid_scale[c];
+    }
+    for (int p = 0; p < FACE_DB_PROBE && p < FACE_DB_CLUSTERS; p++)
+    {
+        int best = -1;
+        for (int c = 0; c < FACE_DB_CLUSTERS; c++)
+        {
+            if (!(probe & (1ULL << c)) && (best < 0 || similarity[c] > similarity[best]))
+            {
+                best = c;
+            }
+        }
+        probe |= 1ULL << best;
+    }
+    return probe;
+}
+#endif
+
+static inline uint32_t face_db_hash(int id)
+{
+    return ((uint32_t)id * 2654435761u) & s_slot_mask;
+}
+
+/* Returns the slot holding id, or the empty slot where it would go */
+static uint32_t face_db_slot(int id)
+{
+    uint32_t slot = face_db_hash(id);
+    while (s_slots[slot] != FACE_DB_SLOT_EMPTY && s_entries[s_slots[slot]].id != id)
+    {
+        slot = (slot + 1) & s_slot_mask;
+    }
+    return slot;
+}
+
+static int face_db_find(int id)
+{
+    return s_slots[face_db_slot(id)];
+}
+
+static void face_db_unlink(uint32_t slot)
+{
+    // shift the following entries of the probe run back into the hole
+    uint32_t next = slot;
+    s_slots[slot] = FACE_DB_SLOT_EMPTY;
+    while (true)
+    {
+        next = (next + 1) & s_slot_mask;
+        if (s_slots[next] == FACE_DB_SLOT_EMPTY)
+        {
+            return;
+        }
+        uint32_t home = face_db_hash(s_entries[s_slots[next]].id);
+        // stays when its home lies cyclically in (slot, next]
+        if (slot <= next ? (slot < home && home <= next) : (slot < home || home <= next))
+        {
+            continue;
+        }
+        s_slots[slot] = s_slots[next];
+        s_slots[next] = FACE_DB_SLOT_EMPTY;
+        slot = next;
+    }
+}
+
+esp_err_t app_face_db_init(int capacity)
+{
+    s_db_lock = xSemaphoreCreateMutex();
+    s_entries = (face_entry_t *)app_mem_alloc(APP_MEM_FACE_DB, capacity * sizeof(face_entry_t));
+    if (!s_db_lock || !s_entries)
+    {
+        ESP_LOGE(TAG, "No memory for %d faces", capacity);
+        return ESP_ERR_NO_MEM;
+    }
+    uint32_t slots = 1;
+    while (slots < 2 * capacity)
+    {
+        slots <<= 1;
+    }
+    s_slots = (int32_t *)app_mem_alloc(APP_MEM_FACE_DB, slots * sizeof(int32_t));
+    if (!s_slots)
+    {
+        ESP_LOGE(TAG, "No memory for the index of %d faces", capacity);
+        return ESP_ERR_NO_MEM;
+    }
+    memset(s_slots, 0xFF, slots * sizeof(int32_t));
+    s_slot_mask = slots - 1;
+#ifdef CONFIG_FACE_DB_INDEX
+    s_centroids = (int8_t *)app_mem_alloc(APP_MEM_FACE_INDEX, FACE_DB_CLUSTERS * FACE_ID_SIZE);
+    s_clusters = (uint8_t *)app_mem_alloc(APP_MEM_FACE_DB, capacity);
+    if (!s_centroids || !s_clusters)
+    {
+        ESP_LOGE(TAG, "No memory for the face index");
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+    s_capacity = capacity;
+    s_count = 0;
+    return ESP_OK;
+}
+
+int app_face_db_count()
+{
+    return s_count;
+}
+
+int app_face_db_named()
+{
+    return s_named;
+}
+
+uint32_t app_face_db_generation()
+{
+    return s_generation;
+}
+
+esp_err_t app_face_db_add(const face_entry_t *entry)
+{
+    esp_err_t res = ESP_OK;
+
+    xSemaphoreTake(s_db_lock, portMAX_DELAY);
+    uint32_t slot = face_db_slot(entry->id);
+    int i = s_slots[slot];
+    if (i < 0)
+    {
+        if (s_count == s_capacity)
+        {
+            res = ESP_ERR_NO_MEM;
+            goto out;
+        }
+        i = s_count++;
+        s_slots[slot] = i;
+    }
+    else if (s_entries[i].name)
+    {
+        s_named--;
+    }
+    s_entries[i] = *entry;
+    s_named += entry->name != NULL;
+#ifdef CONFIG_FACE_DB_INDEX
+    s_clusters[i] = s_indexed ? face_db_nearest(entry->vec, s_centroids, s_centroid_scale) : FACE_DB_UNASSIGNED;
+#endif
+    s_generation++;
+
+out:
+    xSemaphoreGive(s_db_lock);
+    return res;
+}
+
+esp_err_t app_face_db_relocate(int id, const int8_t *vec, const char *name)
+{
+    esp_err_t res = ESP_OK;
+
+    xSemaphoreTake(s_db_lock, portMAX_DELAY);
+    int i = face_db_find(id);
+    if (i < 0)
+    {
+        res = ESP_ERR_NOT_FOUND;
+    }
+    else
+    {
+        s_named += (name != NULL) - (s_entries[i].name != NULL);
+        s_entries[i].vec = vec;
+        s_entries[i].name = name;
+    }
+    xSemaphoreGive(s_db_lock);
+    return res;
+}
+
+esp_err_t app_face_db_remove(int id)
+{
+    esp_err_t res = ESP_OK;
+
+    xSemaphoreTake(s_db_lock, portMAX_DELAY);
+    uint32_t slot = face_db_slot(id);
+    int i = s_slots[slot];
+    if (i < 0)
+    {
+        res = ESP_ERR_NOT_FOUND;
+    }
+    else
+    {
+        face_db_unlink(slot);
+        s_named -= s_entries[i].name != NULL;
+        if (i != --s_count)
+        {
+            // move the last entry into the hole, the list stays contiguous
+            s_entries[i] = s_entries[s_count];
+            s_slots[face_db_slot(s_entries[i].id)] = i;
+#ifdef CONFIG_FACE_DB_INDEX
+            s_clusters[i] = s_clusters[s_count];
+#endif
+        }
+    }
+    if (res == ESP_OK)
+        s_generation++;
+    xSemaphoreGive(s_db_lock);
+    return res;
+}
+
+void app_face_db_clear()
+{
+    xSemaphoreTake(s_db_lock, portMAX_DELAY);
+    s_count = 0;
+    s_named = 0;
+    memset(s_slots, 0xFF, (s_slot_mask + 1) * sizeof(int32_t));
+#ifdef CONFIG_FACE_DB_INDEX
+    s_indexed = false;
+#endif
+    s_generation++;
+    xSemaphoreGive(s_db_lock);
+}
+
+esp_err_t app_face_db_set_name(int id, const char *name)
+{
+    esp_err_t res = ESP_OK;
+
+    xSemaphoreTake(s_db_lock, portMAX_DELAY);
+    int i = face_db_find(id);
+    if (i < 0)
+    {
+        res = ESP_ERR_NOT_FOUND;
+    }
+    else
+    {
+        s_named += (name != NULL) - (s_entries[i].name != NULL);
+        s_entries[i].name = name;
+    }
+    xSemaphoreGive(s_db_lock);
+    return res;
+}
+
+esp_err_t app_face_db_get_name(int id, char *name, size_t len)
+{
+    esp_err_t res = ESP_OK;
+
+    xSemaphoreTake(s_db_lock, portMAX_DELAY);
+    int i = face_db_find(id);
+    if (i < 0)
+    {
+        res = ESP_ERR_NOT_FOUND;
+    }
+    else if (len)
+    {
+        strlcpy(name, s_entries[i].name ? s_entries[i].name : "", len);
+    }
+    xSemaphoreGive(s_db_lock);
+    return res;
+}
+
+esp_err_t app_face_db_get(int id, face_entry_t *entry)
+{
+    esp_err_t res = ESP_OK;
+
+    xSemaphoreTake(s_db_lock, portMAX_DELAY);
+    int i = face_db_find(id);
+    if (i < 0)
+    {
+        res = ESP_ERR_NOT_FOUND;
+    }
+    else
+    {
+        *entry = s_entries[i];
+    }
+    xSemaphoreGive(s_db_lock);
+    return res;
+}
+
+int app_face_db_match(dl_matrix3d_t *face_id, face_match_t *matches, int k)
+{
+    int16_t query[FACE_ID_SIZE];
+    int n = 0;
+
+    if (k <= 0)
+    {
+        return 0;
+    }
+    float query_scale = face_db_quantize16(face_id->item, query);
+
+    xSemaphoreTake(s_db_lock, portMAX_DELAY);
+#ifdef CONFIG_FACE_DB_INDEX
+    uint64_t probe = face_db_probe(query);
+#endif
+    for (int i = 0; i < s_count; i++)
+    {
+#ifdef CONFIG_FACE_DB_INDEX
+        if (s_clusters[i] != FACE_DB_UNASSIGNED && !(probe & (1ULL << s_clusters[i])))
+        {
+            continue;
+        }
+#endif
+        float similarity = face_db_dot(query, s_entries[i].vec) * query_scale * s_entries[i].scale;
+
+        // insertion into the short sorted top-k list
+        if (n == k && similarity <= matches[n - 1].similarity)
+        {
+            continue;
+        }
+        int j = n < k ? n++ : n - 1;
+        while (j > 0 && matches[j - 1].similarity < similarity)
+        {
+            matches[j] = matches[j - 1];
+            j--;
+        }
+        matches[j].id = s_entries[i].id;
+        matches[j].similarity = similarity;
+    }
+    xSemaphoreGive(s_db_lock);
+    return n;
+}
+
+int app_face_db_snapshot(face_entry_t *entries, int max)
+{
+    xSemaphoreTake(s_db_lock, portMAX_DELAY);
+    int n = s_count < max ? s_count : max;
+    memcpy(entries, s_entries, n * sizeof(face_entry_t));
+    xSemaphoreGive(s_db_lock);
+    return n;
+}
+
+void app_face_db_reindex()
+{
+#ifdef CONFIG_FACE_DB_INDEX
+    int count = s_count;
+
+    if (count < FACE_DB_INDEX_MIN)
+    {
+        return;
+    }
+    // rebuilt once the gallery changed size by a quarter
+    if (s_indexed && count * 4 < s_indexed_count * 5 && count * 4 > s_indexed_count * 3)
+    {
+        return;
+    }
+
+    int64_t start = esp_timer_get_time();
+    face_entry_t *entries = (face_entry_t *)heap_caps_malloc(count * sizeof(face_entry_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    float *sums = (float *)heap_caps_malloc(FACE_DB_CLUSTERS * FACE_ID_SIZE * sizeof(float), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    int8_t *centroids = (int8_t *)heap_caps_malloc(FACE_DB_CLUSTERS * FACE_ID_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    uint8_t *assign = (uint8_t *)heap_caps_malloc(count, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    float scales[FACE_DB_CLUSTERS];
+    int sizes[FACE_DB_CLUSTERS];
+
+    if (!entries || !sums || !centroids || !assign)
+    {
+        ESP_LOGW(TAG, "No memory to index %d faces", count);
+        goto out;
+    }
+    count = app_face_db_snapshot(entries, count);
+    if (count < FACE_DB_INDEX_MIN)
+    {
+        goto out;
+    }
+
+    // spherical k-means on the unit vectors, seeded with evenly spread entries
+    for (int c = 0; c < FACE_DB_CLUSTERS; c++)
+    {
+        memcpy(centroids + c * FACE_ID_SIZE, entries[c * count / FACE_DB_CLUSTERS].vec, FACE_ID_SIZE);
+        scales[c] = entries[c * count / FACE_DB_CLUSTERS].scale;
+    }
+    for (int round = 0; round < FACE_DB_KMEANS_ROUNDS; round++)
+    {
+        memset(sums, 0, FACE_DB_CLUSTERS * FACE_ID_SIZE * sizeof(float));
+        memset(sizes, 0, sizeof(sizes));
+        for (int i = 0; i < count; i++)
+        {
+            assign[i] = face_db_nearest(entries[i].vec, centroids, scales);
+            float *sum = sums + assign[i] * FACE_ID_SIZE;
+            for (int d = 0; d < FACE_ID_SIZE; d++)
+            {
+                sum[d] += entries[i].vec[d] * entries[i].scale;
+            }
+            sizes[assign[i]]++;
+        }
+        for (int c = 0; c < FACE_DB_CLUSTERS; c++)
+        {
+            // an empty cluster keeps its centroid
+            if (sizes[c])
+            {
+                scales[c] = face_db_quantize8(sums + c * FACE_ID_SIZE, centroids + c * FACE_ID_SIZE);
+            }
+        }
+        vTaskDelay(1);
+    }
+    for (int i = 0; i < count; i++)
+    {
+        assign[i] = face_db_nearest(entries[i].vec, centroids, scales);
+    }
+
+    xSemaphoreTake(s_db_lock, portMAX_DELAY);
+    memcpy(s_centroids, centroids, FACE_DB_CLUSTERS * FACE_ID_SIZE);
+    memcpy(s_centroid_scale, scales, sizeof(scales));
+    memset(s_clusters, FACE_DB_UNASSIGNED, s_count);
+    for (int j = 0; j < count; j++)
+    {
+        int i = face_db_find(entries[j].id);
+        if (i >= 0)
+        {
+            s_clusters[i] = assign[j];
+        }
+    }
+    // entries added while the centroids were built
+    for (int i = 0; i < s_count; i++)
+    {
+        if (s_clusters[i] == FACE_DB_UNASSIGNED)
+        {
+            s_clusters[i] = face_db_nearest(s_entries[i].vec, s_centroids, s_centroid_scale);
+        }
+    }
+    s_indexed = true;
+    s_indexed_count = s_count;
+    xSemaphoreGive(s_db_lock);
+    ESP_LOGI(TAG, "Indexed %d faces into %d clusters in %ums", count, FACE_DB_CLUSTERS,
+            (uint32_t)((esp_timer_get_time() - start) / 1000));
+
+out:
+    free(entries);
+    free(sums);
+    free(centroids);
+    free(assign);
+#endif
+}
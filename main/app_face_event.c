@@ -0,0 +1,112 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "lwip/sockets.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "app_face_event.h"
+#include "app_face_db.h"
+
+static const char *TAG = "app_face_event";
+
+#define FACE_EVENT_LEN      512
+
+static int s_sock = -1;
+static struct sockaddr_in s_dest;
+static uint32_t s_seq = 0;
+static int s_last_count = 0;
+
+void app_face_event_publish(const frame_desc_t *frame)
+{
+    char buf[FACE_EVENT_LEN];
+
+    if (s_sock < 0 || frame->err != ESP_OK || (frame->face_count == 0 && s_last_count == 0))
+    {
+        return;
+    }
+    s_last_count = frame->face_count;
+
+    // {"seq":1,"frame":42,"time":123456,"width":320,"height":240,"faces":[{"id":2,"name":"x","similarity":0.81,"box":[..]}]}
+    int n = snprintf(buf, sizeof(buf), "{\"seq\":%u,\"frame\":%u,\"time\":%u,\"width\":%u,\"height\":%u,\"faces\":[",
+            s_seq++, frame->seq, (uint32_t)(frame->fr_sensor / 1000), frame->width, frame->height);
+    for (int i = 0; i < frame->face_count && n < sizeof(buf); i++)
+    {
+        const box_t *box = &frame->face_boxes[i];
+        char name[FACE_NAME_MAX] = "";
+#ifdef CONFIG_APP_RECOGNITION
+        if (frame->face_ids[i] >= 0)
+        {
+            app_face_db_get_name(frame->face_ids[i], name, sizeof(name));
+        }
+#endif
+        // names are free text, keep them from breaking the JSON
+        for (char *c = name; *c; c++)
+        {
+            if (*c == '"' || *c == '\\' || (unsigned char)*c < 0x20)
+            {
+                *c = '_';
+            }
+        }
+        n += snprintf(buf + n, sizeof(buf) - n, "%s{\"id\":%d,\"name\":\"%s\",\"similarity\":%.3f,\"box\":[%d,%d,%d,%d]}",
+                i ? "," : "", frame->face_ids[i], name, frame->face_similarity[i],
+                (int)box->box_p[0], (int)box->box_p[1], (int)box->box_p[2], (int)box->box_p[3]);
+    }
+    if (n < sizeof(buf))
+    {
+        n += snprintf(buf + n, sizeof(buf) - n, "]}");
+    }
+    if (n >= sizeof(buf))
+    {
+        ESP_LOGW(TAG, "Face event truncated");
+        return;
+    }
+    // best effort, a lost event is followed by the next frame's
+    sendto(s_sock, buf, n, MSG_DONTWAIT, (struct sockaddr *)&s_dest, sizeof(s_dest));
+}
+
+esp_err_t app_face_event_init()
+{
+    memset(&s_dest, 0, sizeof(s_dest));
+    s_dest.sin_family = AF_INET;
+    s_dest.sin_port = htons(CONFIG_FACE_EVENT_PORT);
+    if (strlen(CONFIG_FACE_EVENT_HOST) == 0)
+    {
+        s_dest.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+    }
+    else if (!inet_aton(CONFIG_FACE_EVENT_HOST, &s_dest.sin_addr))
+    {
+        ESP_LOGE(TAG, "Invalid face event host %s", CONFIG_FACE_EVENT_HOST);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (s_sock < 0)
+    {
+        return ESP_FAIL;
+    }
+    int broadcast = 1;
+    setsockopt(s_sock, SOL_SOCKET, SO_BROADCAST, &broadcast, sizeof(broadcast));
+    ESP_LOGI(TAG, "Face events go to %s:%d", inet_ntoa(s_dest.sin_addr), CONFIG_FACE_EVENT_PORT);
+    return ESP_OK;
+}
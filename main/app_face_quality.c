@@ -0,0 +1,195 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include <math.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "fr_forward.h"
+#include "app_face_quality.h"
+#include "app_pipeline.h"
+#include "app_image.h"
+#include "app_mem.h"
+
+static const char *TAG = "app_face_quality";
+
+#define FACE_QUALITY_TRACKS     PIPELINE_MAX_FACES
+#define FACE_QUALITY_IOU        0.3f
+#define FACE_QUALITY_LOST_US    (500 * 1000)
+#define FACE_QUALITY_WINDOW_US  (CONFIG_FACE_QUALITY_WINDOW_MS * 1000LL)
+
+/* Laplacian variance of a face in focus at about half the score */
+#define FACE_QUALITY_SHARPNESS  100.0f
+
+typedef struct {
+    box_t box;
+    int64_t start;              /* first face of the window */
+    int64_t seen;
+    float best_score;           /* -1 for an empty window */
+    dl_matrix3du_t *best;
+    bool used;
+} face_track_t;
+
+static face_track_t s_tracks[FACE_QUALITY_TRACKS];
+
+static float face_sharpness(const dl_matrix3du_t *face)
+{
+    int w = face->w;
+    double sum = 0, sum2 = 0;
+    int n = 0;
+
+    // green alone, it is the same byte in BGR and RGB
+    for (int y = 1; y < face->h - 1; y++)
+    {
+        const uint8_t *p = face->item + (y * w + 1) * 3 + 1;
+        for (int x = 1; x < w - 1; x++, p += 3)
+        {
+            int l = 4 * p[0] - p[-3] - p[3] - p[-w * 3] - p[w * 3];
+            sum += l;
+            sum2 += l * l;
+            n++;
+        }
+    }
+    if (n == 0)
+    {
+        return 0;
+    }
+    float mean = sum / n;
+    float var = sum2 / n - mean * mean;
+    return var / (var + FACE_QUALITY_SHARPNESS);
+}
+
+/* 1 for a frontal, level face: the nose as far from either eye and both eyes at one height */
+static float face_frontal(const landmark_t *landmark)
+{
+    const float *p = landmark->landmark_p;
+    float eye_dx = p[2] - p[0], eye_dy = p[3] - p[1];
+    float eyes = sqrtf(eye_dx * eye_dx + eye_dy * eye_dy);
+    if (eyes < 1)
+    {
+        return 0;
+    }
+
+    float left = hypotf(p[4] - p[0], p[5] - p[1]);
+    float right = hypotf(p[4] - p[2], p[5] - p[3]);
+    float asymmetry = fabsf(left - right) / (left + right);
+    float roll = fabsf(eye_dy) / eyes;
+    float frontal = 1 - 2 * asymmetry - roll;
+    return frontal < 0 ? 0 : frontal;
+}
+
+float app_face_quality_score(const dl_matrix3du_t *aligned_face, const box_t *box, const landmark_t *landmark)
+{
+    // a face smaller than twice the aligned size is scaled up for recognition
+    float size = (box->box_p[2] - box->box_p[0]) / (2 * FACE_WIDTH);
+    size = size > 1 ? 1 : (size < 0 ? 0 : size);
+
+    return face_sharpness(aligned_face) * size * face_frontal(landmark);
+}
+
+static face_track_t *face_track_find(const box_t *box, int64_t now)
+{
+    face_track_t *best = NULL;
+    float best_iou = FACE_QUALITY_IOU;
+
+    for (int i = 0; i < FACE_QUALITY_TRACKS; i++)
+    {
+        face_track_t *t = &s_tracks[i];
+        if (!t->used || now - t->seen > FACE_QUALITY_LOST_US)
+        {
+            continue;
+        }
+        float iou = app_image_box_iou(&t->box, box);
+        if (iou >= best_iou)
+        {
+            best = t;
+            best_iou = iou;
+        }
+    }
+    if (best)
+    {
+        return best;
+    }
+
+    // a new face takes a free track, or the one not seen for the longest time
+    best = &s_tracks[0];
+    for (int i = 0; i < FACE_QUALITY_TRACKS && best->used; i++)
+    {
+        if (!s_tracks[i].used || s_tracks[i].seen < best->seen)
+        {
+            best = &s_tracks[i];
+        }
+    }
+    best->used = true;
+    best->start = now;
+    best->best_score = -1;
+    return best;
+}
+
+dl_matrix3du_t *app_face_quality_select(const box_t *box, float score, const dl_matrix3du_t *aligned_face)
+{
+    int64_t now = esp_timer_get_time();
+    face_track_t *t = face_track_find(box, now);
+
+    t->box = *box;
+    t->seen = now;
+    if (score > t->best_score)
+    {
+        memcpy(t->best->item, aligned_face->item, FACE_WIDTH * FACE_HEIGHT * 3);
+        t->best_score = score;
+    }
+    if (now - t->start < FACE_QUALITY_WINDOW_US)
+    {
+        return NULL;
+    }
+
+    float best_score = t->best_score;
+    t->start = now;
+    t->best_score = -1;
+    if (best_score * 100 < CONFIG_FACE_QUALITY_MIN)
+    {
+        ESP_LOGD(TAG, "Best face scored %.2f, skipped", best_score);
+        return NULL;
+    }
+    ESP_LOGD(TAG, "Best face scored %.2f", best_score);
+    return t->best;
+}
+
+void app_face_quality_reset()
+{
+    for (int i = 0; i < FACE_QUALITY_TRACKS; i++)
+    {
+        s_tracks[i].used = false;
+    }
+}
+
+esp_err_t app_face_quality_init()
+{
+    for (int i = 0; i < FACE_QUALITY_TRACKS; i++)
+    {
+        s_tracks[i].best = app_mem_matrix_alloc(APP_MEM_FACE_SAMPLE, FACE_WIDTH, FACE_HEIGHT, 3);
+        if (!s_tracks[i].best)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,1478 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <stddef.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_partition.h"
+#include "cJSON.h"
+#include "fr_flash.h"
+#include "app_face_store.h"
+#include "app_face_db.h"
+#include "app_pipeline.h"
+#include "app_tasks.h"
+#include "app_boot.h"
+#include "app_mem.h"
+
+static const char *TAG = "app_face_store";
+
+/*
+ * The partition is split into two banks. The active bank is an append-only
+ * log of add, name and delete records, read in place through a flash mapping.
+ * When it fills up the live faces are copied into the other bank, which then
+ * becomes active with a higher sequence number. A freshly compacted bank is
+ * the compact index: one add record per face, followed by its name if it has one.
+ *
+ * A record is written header first with its magic left erased, then its
+ * payload, and the magic last, so a record cut short by a reset is skipped
+ * on the next scan by its length.
+ *
+ * Every record carries the change number it was made with, which a compaction
+ * keeps. The bank header holds the change up to which removed faces and old
+ * names were compacted away, a delta from before it cannot be built anymore.
+ */
+#define FACE_STORE_BANK_MAGIC       0x32534657  /* "WFS2" */
+/* Written by firmware before the change numbers, converted by a compaction */
+#define FACE_STORE_BANK_MAGIC_V1    0x31534657  /* "WFS1" */
+#define FACE_STORE_RECORD_MAGIC     0x52434657  /* "WFCR" */
+#define FACE_STORE_ERASED           0xFFFFFFFF
+
+#define FACE_STORE_ADD              1
+#define FACE_STORE_DELETE           2
+#define FACE_STORE_NAME             3
+
+#define FACE_STORE_QUEUE_LEN        4
+/* Idle time after which a bank with more dead than live records is compacted */
+#define FACE_STORE_IDLE_MS          10000
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t base;          /* changes up to it are compacted away */
+    uint32_t reserved;
+} face_bank_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t op;
+    uint16_t len;           /* payload bytes after the record */
+    int32_t id;
+    float scale;
+    uint32_t change;
+} face_record_t;
+
+/* Records of a WFS1 bank end before the change number */
+#define FACE_STORE_RECORD_V1_LEN    offsetof(face_record_t, change)
+
+typedef struct {
+    face_record_t record;
+    union {
+        int8_t vec[FACE_ID_SIZE];
+        char name[FACE_NAME_MAX];
+    };
+} face_store_op_t;
+
+#define FACE_STORE_ADD_LEN      (sizeof(face_record_t) + FACE_ID_SIZE)
+#define FACE_STORE_NAME_LEN     (sizeof(face_record_t) + FACE_NAME_MAX)
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t vec_len;
+    uint16_t name_len;
+    uint16_t reserved;
+    uint32_t count;
+} face_export_header_t;
+
+typedef struct {
+    int32_t id;
+    float scale;
+    int8_t vec[FACE_ID_SIZE];
+    char name[FACE_NAME_MAX];
+} face_export_face_t;
+
+/*
+ * An import builds a compacted bank from the export, like face_store_compact
+ * does from the database, and switches to it at the end.
+ */
+typedef struct {
+    face_export_header_t header;
+    face_export_face_t face;
+    bool header_done;
+    size_t got;             /* bytes of the header, then of the face being read */
+    uint32_t faces;         /* faces written so far */
+    uint32_t change;        /* last change number given to a record */
+    int bank;
+    uint8_t *sector;        /* next sector of the bank, written once it is full */
+    size_t fill;
+    size_t offset;          /* of the sector in the bank */
+} face_import_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t vec_len;
+    uint16_t name_len;
+    uint16_t reserved;
+    uint32_t since;
+    uint32_t last;
+    uint32_t count;
+} face_delta_header_t;
+
+typedef struct {
+    uint32_t change;
+    uint16_t op;
+    uint16_t len;
+    int32_t id;
+    float scale;
+} face_delta_change_t;
+
+typedef struct {
+    face_delta_header_t header;
+    face_delta_change_t change;
+    uint8_t payload[FACE_ID_SIZE];
+    int part;               /* 0 header, 1 change, 2 payload */
+    size_t got;
+    uint32_t changes;       /* changes applied so far */
+    face_store_op_t op;
+} face_apply_t;
+
+static const esp_partition_t *s_partition = NULL;
+static const uint8_t *s_map = NULL;
+static spi_flash_mmap_handle_t s_map_handle;
+static size_t s_bank_size = 0;
+static int s_bank = 0;
+static uint32_t s_seq = 0;
+static size_t s_tail = 0;           /* append offset in the active bank */
+static size_t s_dead = 0;           /* bytes of removed faces and delete records */
+static uint32_t s_change = 0;       /* last change number handed out */
+static uint32_t s_base = 0;
+static uint32_t s_dead_change = 0;  /* last change that left dead records behind */
+static int s_next_id = 0;
+static int s_pending = 0;           /* adds queued but not written yet */
+static QueueHandle_t s_op_queue = NULL;
+static portMUX_TYPE s_id_mux = portMUX_INITIALIZER_UNLOCKED;
+/* Held by whoever writes the partition or reads faces out of it */
+static SemaphoreHandle_t s_write_lock = NULL;
+static bool s_importing = false;
+static face_import_t s_import;
+static face_apply_t *s_apply = NULL;
+
+static inline size_t face_store_bank_offset(int bank)
+{
+    return bank * s_bank_size;
+}
+
+static const face_bank_t *face_store_bank(int bank)
+{
+    return (const face_bank_t *)(s_map + face_store_bank_offset(bank));
+}
+
+static esp_err_t face_store_erase_bank(int bank)
+{
+    // one sector at a time, the caches of both cores are off during an erase
+    for (size_t off = 0; off < s_bank_size; off += SPI_FLASH_SEC_SIZE)
+    {
+        esp_err_t err = esp_partition_erase_range(s_partition, face_store_bank_offset(bank) + off, SPI_FLASH_SEC_SIZE);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+        vTaskDelay(1);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t face_store_write_bank_header(int bank, uint32_t seq, uint32_t change_base)
+{
+    face_bank_t header = {
+        .magic = FACE_STORE_BANK_MAGIC,
+        .seq = seq,
+        .base = change_base,
+        .reserved = FACE_STORE_ERASED,
+    };
+    size_t base = face_store_bank_offset(bank);
+
+    esp_err_t err = esp_partition_write(s_partition, base + sizeof(uint32_t),
+            (const uint8_t *)&header + sizeof(uint32_t), sizeof(header) - sizeof(uint32_t));
+    if (err == ESP_OK)
+    {
+        err = esp_partition_write(s_partition, base, &header.magic, sizeof(uint32_t));
+    }
+    return err;
+}
+
+/* Appends a record to the active bank with the next change number, the flash cache is flushed by the write */
+static esp_err_t face_store_append(face_record_t *record, const int8_t *payload, size_t *offset)
+{
+    size_t base = face_store_bank_offset(s_bank);
+    size_t len = sizeof(face_record_t) + record->len;
+    esp_err_t err;
+
+    if (s_tail + len > s_bank_size)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    record->change = ++s_change;
+    // the header goes first, so the scan knows the length of a record cut short
+    err = esp_partition_write(s_partition, base + s_tail + sizeof(uint32_t),
+            (const uint8_t *)record + sizeof(uint32_t), sizeof(face_record_t) - sizeof(uint32_t));
+    if (err == ESP_OK && record->len)
+    {
+        err = esp_partition_write(s_partition, base + s_tail + sizeof(face_record_t), payload, record->len);
+    }
+    if (err == ESP_OK)
+    {
+        uint32_t magic = FACE_STORE_RECORD_MAGIC;
+        err = esp_partition_write(s_partition, base + s_tail, &magic, sizeof(magic));
+    }
+    if (offset)
+    {
+        *offset = s_tail;
+    }
+    // a failed record stays unmarked and is skipped by the scan, nothing is written over it
+    if (err != ESP_OK)
+    {
+        s_dead += len;
+    }
+    s_tail += len;
+    return err;
+}
+
+/* Accounts for the records of a face that is going away */
+static void face_store_kill(int id)
+{
+    char name[FACE_NAME_MAX];
+
+    if (app_face_db_get_name(id, name, sizeof(name)) == ESP_OK)
+    {
+        s_dead += FACE_STORE_ADD_LEN + (name[0] ? FACE_STORE_NAME_LEN : 0);
+        app_face_db_remove(id);
+    }
+}
+
+static void face_store_set_name(int id, const char *name)
+{
+    char old[FACE_NAME_MAX];
+
+    if (app_face_db_get_name(id, old, sizeof(old)) != ESP_OK)
+    {
+        s_dead += FACE_STORE_NAME_LEN;
+        return;
+    }
+    // every name record but the last one of a face is dead
+    if (old[0])
+    {
+        s_dead += FACE_STORE_NAME_LEN;
+    }
+    if (!name[0])
+    {
+        s_dead += FACE_STORE_NAME_LEN;
+    }
+    app_face_db_set_name(id, name[0] ? name : NULL);
+}
+
+/* Returns the record at *off and steps over it, NULL at the end of the log */
+static const face_record_t *face_store_next(int bank, size_t *off, size_t record_len)
+{
+    const face_record_t *record = (const face_record_t *)(s_map + face_store_bank_offset(bank) + *off);
+
+    if (*off + record_len > s_bank_size || (record->op == 0xFFFF && record->magic == FACE_STORE_ERASED))
+    {
+        return NULL;
+    }
+    size_t len = record_len + (record->len <= FACE_ID_SIZE ? record->len : 0);
+    if (*off + len > s_bank_size)
+    {
+        return NULL;
+    }
+    *off += len;
+    return record;
+}
+
+/* Reads a bank with records of record_len bytes, the change numbers are left out for WFS1 */
+static void face_store_scan(int bank, size_t record_len)
+{
+    const face_record_t *record;
+    size_t off = sizeof(face_bank_t);
+    size_t prev = off;
+
+    app_face_db_clear();
+    s_dead = 0;
+    s_base = record_len == sizeof(face_record_t) ? face_store_bank(bank)->base : 0;
+    s_change = s_change > s_base ? s_change : s_base;
+    s_dead_change = s_base;
+    for (; (record = face_store_next(bank, &off, record_len)) != NULL; prev = off)
+    {
+        const uint8_t *payload = (const uint8_t *)record + record_len;
+        size_t len = off - prev;
+        size_t dead = s_dead;
+        if (record->magic == FACE_STORE_RECORD_MAGIC)
+        {
+            if (record->op == FACE_STORE_ADD && record->len == FACE_ID_SIZE)
+            {
+                face_entry_t entry = {
+                    .id = record->id,
+                    .scale = record->scale,
+                    .vec = (const int8_t *)payload,
+                };
+                if (app_face_db_add(&entry) != ESP_OK)
+                {
+                    ESP_LOGW(TAG, "Face ID %d does not fit the database", record->id);
+                }
+            }
+            else if (record->op == FACE_STORE_NAME && record->len == FACE_NAME_MAX)
+            {
+                face_store_set_name(record->id, (const char *)payload);
+            }
+            else if (record->op == FACE_STORE_DELETE)
+            {
+                face_store_kill(record->id);
+                s_dead += len;
+            }
+            s_next_id = record->id >= s_next_id ? record->id + 1 : s_next_id;
+            if (record_len == sizeof(face_record_t))
+            {
+                s_change = record->change > s_change ? record->change : s_change;
+                s_dead_change = s_dead != dead ? record->change : s_dead_change;
+            }
+        }
+        else
+        {
+            s_dead += len;
+        }
+    }
+    s_tail = off;
+}
+
+/* Change number of the record in front of a payload in the active bank */
+static inline uint32_t face_store_payload_change(const void *payload)
+{
+    return ((const face_record_t *)payload - 1)->change;
+}
+
+/* legacy is set for a WFS1 active bank, whose records get new change numbers */
+static esp_err_t face_store_compact_bank(bool legacy)
+{
+    int bank = !s_bank;
+    size_t base = face_store_bank_offset(bank);
+    size_t off = sizeof(face_bank_t);
+    int count = app_face_db_count();
+    uint32_t change_base = s_dead_change > s_base ? s_dead_change : s_base;
+    uint32_t change = s_change;
+    esp_err_t err;
+
+    face_entry_t *entries = (face_entry_t *)heap_caps_malloc(count * sizeof(face_entry_t) + 1, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!entries)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    count = app_face_db_snapshot(entries, count);
+
+    int64_t start = esp_timer_get_time();
+    err = face_store_erase_bank(bank);
+    for (int i = 0; i < count && err == ESP_OK; i++)
+    {
+        face_record_t record = {
+            .magic = FACE_STORE_RECORD_MAGIC,
+            .op = FACE_STORE_ADD,
+            .len = FACE_ID_SIZE,
+            .id = entries[i].id,
+            .scale = entries[i].scale,
+            .change = legacy ? ++change : face_store_payload_change(entries[i].vec),
+        };
+        err = esp_partition_write(s_partition, base + off + sizeof(face_record_t), entries[i].vec, FACE_ID_SIZE);
+        if (err == ESP_OK)
+        {
+            err = esp_partition_write(s_partition, base + off, &record, sizeof(record));
+        }
+        off += FACE_STORE_ADD_LEN;
+        if (entries[i].name && err == ESP_OK)
+        {
+            char name[FACE_NAME_MAX] = {0};
+            strlcpy(name, entries[i].name, sizeof(name));
+            record.op = FACE_STORE_NAME;
+            record.len = FACE_NAME_MAX;
+            record.scale = 0;
+            record.change = legacy ? ++change : face_store_payload_change(entries[i].name);
+            err = esp_partition_write(s_partition, base + off + sizeof(face_record_t), name, FACE_NAME_MAX);
+            if (err == ESP_OK)
+            {
+                err = esp_partition_write(s_partition, base + off, &record, sizeof(record));
+            }
+            off += FACE_STORE_NAME_LEN;
+        }
+    }
+    if (err == ESP_OK)
+    {
+        err = face_store_write_bank_header(bank, s_seq + 1, change_base);
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Compaction failed (0x%x)", err);
+        free(entries);
+        return err;
+    }
+
+    // the vectors are identical, only the entries move to the new bank
+    off = sizeof(face_bank_t);
+    for (int i = 0; i < count; i++)
+    {
+        const int8_t *vec = (const int8_t *)(s_map + base + off + sizeof(face_record_t));
+        const char *name = NULL;
+        off += FACE_STORE_ADD_LEN;
+        if (entries[i].name)
+        {
+            name = (const char *)(s_map + base + off + sizeof(face_record_t));
+            off += FACE_STORE_NAME_LEN;
+        }
+        // faces removed meanwhile stay removed, their delete record follows
+        app_face_db_relocate(entries[i].id, vec, name);
+    }
+    free(entries);
+
+    int old = s_bank;
+    s_bank = bank;
+    s_seq++;
+    s_tail = off;
+    s_dead = 0;
+    s_change = change;
+    s_base = change_base;
+    // invalidate the old bank, it is erased fully before it is used again
+    esp_partition_erase_range(s_partition, face_store_bank_offset(old), SPI_FLASH_SEC_SIZE);
+    ESP_LOGI(TAG, "Compacted %d faces into bank %d in %ums", count, s_bank,
+            (uint32_t)((esp_timer_get_time() - start) / 1000));
+    return ESP_OK;
+}
+
+static esp_err_t face_store_compact()
+{
+    return face_store_compact_bank(false);
+}
+
+/* Whether a compaction of that many faces and names fits a bank */
+static bool face_store_fits(int faces, int named)
+{
+    return faces <= CONFIG_FACE_DB_CAPACITY &&
+            sizeof(face_bank_t) + faces * FACE_STORE_ADD_LEN + named * FACE_STORE_NAME_LEN <= s_bank_size;
+}
+
+/* Appends a queued or synced change and applies it to the database */
+static esp_err_t face_store_write_op(face_store_op_t *op)
+{
+    size_t len = sizeof(face_record_t) + op->record.len;
+    int faces = app_face_db_count();
+    int named = app_face_db_named();
+    char old[FACE_NAME_MAX];
+    bool known = app_face_db_get_name(op->record.id, old, sizeof(old)) == ESP_OK;
+
+    // a name set since the face was queued may have taken its room
+    if ((op->record.op == FACE_STORE_ADD && !known && !face_store_fits(faces + 1, named)) ||
+            (op->record.op == FACE_STORE_NAME && known && !old[0] && op->name[0] && !face_store_fits(faces, named + 1)))
+    {
+        ESP_LOGE(TAG, "No room for face ID %d", op->record.id);
+        return ESP_ERR_NO_MEM;
+    }
+    if (s_tail + len > s_bank_size)
+    {
+        face_store_compact();
+    }
+
+    size_t dead = s_dead;
+    size_t offset = 0;
+    esp_err_t err = face_store_append(&op->record, op->vec, &offset);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Saving face ID %d failed (0x%x)", op->record.id, err);
+    }
+    else if (op->record.op == FACE_STORE_ADD)
+    {
+        face_entry_t entry = {
+            .id = op->record.id,
+            .scale = op->record.scale,
+            .vec = (const int8_t *)(s_map + face_store_bank_offset(s_bank) + offset + sizeof(face_record_t)),
+            .name = NULL,
+        };
+        app_face_db_add(&entry);
+    }
+    else if (op->record.op == FACE_STORE_NAME)
+    {
+        face_store_set_name(op->record.id, (const char *)(s_map + face_store_bank_offset(s_bank) + offset + sizeof(face_record_t)));
+    }
+    else
+    {
+        // the face left the database when the removal was queued
+        s_dead += FACE_STORE_ADD_LEN + len;
+    }
+    if (s_dead != dead)
+    {
+        s_dead_change = op->record.change;
+    }
+    return err;
+}
+
+static void face_store_task(void *arg)
+{
+    face_store_op_t *op = NULL;
+
+    while (true)
+    {
+        if (xQueueReceive(s_op_queue, &op, FACE_STORE_IDLE_MS / portTICK_PERIOD_MS) != pdTRUE)
+        {
+            xSemaphoreTake(s_write_lock, portMAX_DELAY);
+            if (s_dead > s_bank_size / 2)
+            {
+                face_store_compact();
+            }
+            app_face_db_reindex();
+            xSemaphoreGive(s_write_lock);
+            continue;
+        }
+
+        xSemaphoreTake(s_write_lock, portMAX_DELAY);
+        face_store_write_op(op);
+        if (op->record.op == FACE_STORE_ADD)
+        {
+            portENTER_CRITICAL(&s_id_mux);
+            s_pending--;
+            portEXIT_CRITICAL(&s_id_mux);
+        }
+        xSemaphoreGive(s_write_lock);
+        free(op);
+    }
+}
+
+static esp_err_t face_store_queue(uint16_t op_code, int id, dl_matrix3d_t *face_id, const char *name)
+{
+    face_store_op_t *op = (face_store_op_t *)heap_caps_calloc(1, sizeof(face_store_op_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!op)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    op->record.magic = FACE_STORE_RECORD_MAGIC;
+    op->record.op = op_code;
+    op->record.len = face_id ? FACE_ID_SIZE : (name ? FACE_NAME_MAX : 0);
+    op->record.id = id;
+    op->record.scale = face_id ? app_face_db_quantize(face_id, op->vec) : 0;
+    if (name)
+    {
+        strlcpy(op->name, name, FACE_NAME_MAX);
+    }
+    if (xQueueSend(s_op_queue, &op, portMAX_DELAY) != pdTRUE)
+    {
+        free(op);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+int app_face_store_capacity()
+{
+    // names take room only once they are set, a compaction has to fit them all
+    int capacity = (int)(s_bank_size - sizeof(face_bank_t) - app_face_db_named() * FACE_STORE_NAME_LEN) / (int)FACE_STORE_ADD_LEN;
+    return capacity < CONFIG_FACE_DB_CAPACITY ? capacity : CONFIG_FACE_DB_CAPACITY;
+}
+
+int app_face_store_add(dl_matrix3d_t *face_id)
+{
+    int capacity = app_face_store_capacity();
+    int id = -1;
+
+    portENTER_CRITICAL(&s_id_mux);
+    bool importing = s_importing;
+    if (!importing && app_face_db_count() + s_pending < capacity)
+    {
+        id = s_next_id++;
+        s_pending++;
+    }
+    portEXIT_CRITICAL(&s_id_mux);
+
+    if (id < 0)
+    {
+        ESP_LOGW(TAG, importing ? "Faces are being imported" : "Face store is full");
+        return -1;
+    }
+    if (face_store_queue(FACE_STORE_ADD, id, face_id, NULL) != ESP_OK)
+    {
+        portENTER_CRITICAL(&s_id_mux);
+        s_pending--;
+        portEXIT_CRITICAL(&s_id_mux);
+        return -1;
+    }
+    return id;
+}
+
+esp_err_t app_face_store_remove(int id)
+{
+    if (s_importing)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = app_face_db_remove(id);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    return face_store_queue(FACE_STORE_DELETE, id, NULL, NULL);
+}
+
+esp_err_t app_face_store_set_name(int id, const char *name)
+{
+    if (strlen(name) >= FACE_NAME_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_importing)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    char old[FACE_NAME_MAX];
+    if (app_face_db_get_name(id, old, sizeof(old)) != ESP_OK)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    // checked again by the writer, faces queued meanwhile count as well
+    if (name[0] && !old[0] && !face_store_fits(app_face_db_count() + s_pending, app_face_db_named() + 1))
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    return face_store_queue(FACE_STORE_NAME, id, NULL, name);
+}
+
+char *app_face_store_to_json()
+{
+    int count = app_face_db_count();
+    face_entry_t *entries = (face_entry_t *)heap_caps_malloc(count * sizeof(face_entry_t) + 1, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    cJSON *root = cJSON_CreateObject();
+    cJSON *faces = cJSON_CreateArray();
+    char *json = NULL;
+
+    if (!entries || !root || !faces)
+    {
+        cJSON_Delete(faces);
+        goto out;
+    }
+    cJSON_AddNumberToObject(root, "capacity", app_face_store_capacity());
+    cJSON_AddItemToObject(root, "faces", faces);
+    count = app_face_db_snapshot(entries, count);
+    for (int i = 0; i < count; i++)
+    {
+        cJSON *face = cJSON_CreateObject();
+        if (!face)
+        {
+            goto out;
+        }
+        cJSON_AddNumberToObject(face, "id", entries[i].id);
+        cJSON_AddStringToObject(face, "name", entries[i].name ? entries[i].name : "");
+        cJSON_AddItemToArray(faces, face);
+    }
+    json = cJSON_PrintUnformatted(root);
+
+out:
+    cJSON_Delete(root);
+    free(entries);
+    return json;
+}
+
+esp_err_t app_face_store_from_json(const char *json)
+{
+    cJSON *root = cJSON_Parse(json);
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+
+    if (!root)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    cJSON *id = cJSON_GetObjectItem(root, "id");
+    cJSON *name = cJSON_GetObjectItem(root, "name");
+    cJSON *remove = cJSON_GetObjectItem(root, "delete");
+    if (!cJSON_IsNumber(id))
+    {
+        goto out;
+    }
+    if (cJSON_IsTrue(remove))
+    {
+        err = app_face_store_remove(id->valueint);
+    }
+    else if (cJSON_IsString(name))
+    {
+        err = app_face_store_set_name(id->valueint, name->valuestring);
+    }
+
+out:
+    cJSON_Delete(root);
+    return err;
+}
+
+esp_err_t app_face_store_export(face_store_write_cb write, void *arg)
+{
+    face_export_face_t face;
+
+    if (!s_write_lock)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // no compaction or import may move the vectors while they are read
+    xSemaphoreTake(s_write_lock, portMAX_DELAY);
+    int count = app_face_db_count();
+    face_entry_t *entries = (face_entry_t *)heap_caps_malloc(count * sizeof(face_entry_t) + 1, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!entries)
+    {
+        xSemaphoreGive(s_write_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    count = app_face_db_snapshot(entries, count);
+
+    face_export_header_t header = {
+        .magic = FACE_EXPORT_MAGIC,
+        .version = FACE_EXPORT_VERSION,
+        .vec_len = FACE_ID_SIZE,
+        .name_len = FACE_NAME_MAX,
+        .count = count,
+    };
+    esp_err_t err = write(arg, (const char *)&header, sizeof(header));
+    for (int i = 0; i < count && err == ESP_OK; i++)
+    {
+        face.id = entries[i].id;
+        face.scale = entries[i].scale;
+        memcpy(face.vec, entries[i].vec, FACE_ID_SIZE);
+        memset(face.name, 0, FACE_NAME_MAX);
+        if (entries[i].name)
+        {
+            strlcpy(face.name, entries[i].name, FACE_NAME_MAX);
+        }
+        err = write(arg, (const char *)&face, sizeof(face));
+    }
+    free(entries);
+    xSemaphoreGive(s_write_lock);
+    return err;
+}
+
+static bool face_store_sector_blank(int bank, size_t offset)
+{
+    const uint32_t *words = (const uint32_t *)(s_map + face_store_bank_offset(bank) + offset);
+
+    for (int i = 0; i < SPI_FLASH_SEC_SIZE / sizeof(uint32_t); i++)
+    {
+        if (words[i] != FACE_STORE_ERASED)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Writes the sector buffer in one piece, the sector is only erased when it has to be */
+static esp_err_t face_import_flush()
+{
+    size_t base = face_store_bank_offset(s_import.bank) + s_import.offset;
+    esp_err_t err = ESP_OK;
+
+    if (!s_import.fill)
+    {
+        return ESP_OK;
+    }
+    if (s_import.offset >= s_bank_size)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (!face_store_sector_blank(s_import.bank, s_import.offset))
+    {
+        err = esp_partition_erase_range(s_partition, base, SPI_FLASH_SEC_SIZE);
+    }
+    if (err == ESP_OK)
+    {
+        err = esp_partition_write(s_partition, base, s_import.sector, SPI_FLASH_SEC_SIZE);
+    }
+    memset(s_import.sector, 0xFF, SPI_FLASH_SEC_SIZE);
+    s_import.fill = 0;
+    s_import.offset += SPI_FLASH_SEC_SIZE;
+    return err;
+}
+
+static esp_err_t face_import_emit(const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+
+    if (s_import.offset + s_import.fill + len > s_bank_size)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    while (len > 0)
+    {
+        size_t n = SPI_FLASH_SEC_SIZE - s_import.fill;
+        n = n < len ? n : len;
+        memcpy(s_import.sector + s_import.fill, p, n);
+        s_import.fill += n;
+        p += n;
+        len -= n;
+        if (s_import.fill == SPI_FLASH_SEC_SIZE)
+        {
+            esp_err_t err = face_import_flush();
+            if (err != ESP_OK)
+            {
+                return err;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+/* Same records as a compaction writes, the bank header comes last */
+static esp_err_t face_import_add(face_export_face_t *face)
+{
+    face_record_t record = {
+        .magic = FACE_STORE_RECORD_MAGIC,
+        .op = FACE_STORE_ADD,
+        .len = FACE_ID_SIZE,
+        .id = face->id,
+        .scale = face->scale,
+        .change = ++s_import.change,
+    };
+
+    if (face->id < 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = face_import_emit(&record, sizeof(record));
+    if (err == ESP_OK)
+    {
+        err = face_import_emit(face->vec, FACE_ID_SIZE);
+    }
+    face->name[FACE_NAME_MAX - 1] = 0;
+    if (err == ESP_OK && face->name[0])
+    {
+        record.op = FACE_STORE_NAME;
+        record.len = FACE_NAME_MAX;
+        record.scale = 0;
+        record.change = ++s_import.change;
+        err = face_import_emit(&record, sizeof(record));
+        if (err == ESP_OK)
+        {
+            err = face_import_emit(face->name, FACE_NAME_MAX);
+        }
+    }
+    return err;
+}
+
+static esp_err_t face_import_check_header(const face_export_header_t *header)
+{
+    if (header->magic != FACE_EXPORT_MAGIC)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (header->version != FACE_EXPORT_VERSION)
+    {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    // exported by a firmware with another model or name length
+    if (header->vec_len != FACE_ID_SIZE || header->name_len != FACE_NAME_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // the names are checked as they are written
+    if (!face_store_fits(header->count, 0))
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
+
+/* Keeps the store to an import or a delta until face_store_release */
+static esp_err_t face_store_take()
+{
+    if (!s_write_lock)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_write_lock, portMAX_DELAY);
+    portENTER_CRITICAL(&s_id_mux);
+    bool busy = s_pending > 0;
+    s_importing = !busy;
+    portEXIT_CRITICAL(&s_id_mux);
+    if (busy)
+    {
+        xSemaphoreGive(s_write_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    return ESP_OK;
+}
+
+static void face_store_release()
+{
+    portENTER_CRITICAL(&s_id_mux);
+    s_importing = false;
+    portEXIT_CRITICAL(&s_id_mux);
+    xSemaphoreGive(s_write_lock);
+}
+
+esp_err_t app_face_store_import_begin()
+{
+    esp_err_t err = face_store_take();
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    memset(&s_import, 0, sizeof(s_import));
+    s_import.bank = !s_bank;
+    s_import.change = s_change;
+    s_import.sector = (uint8_t *)app_mem_alloc(APP_MEM_FACE_IMPORT, SPI_FLASH_SEC_SIZE);
+    if (!s_import.sector)
+    {
+        app_face_store_import_end(false);
+        return ESP_ERR_NO_MEM;
+    }
+    // the bank header stays erased until the import is complete
+    memset(s_import.sector, 0xFF, SPI_FLASH_SEC_SIZE);
+    s_import.fill = sizeof(face_bank_t);
+    return ESP_OK;
+}
+
+esp_err_t app_face_store_import_write(const uint8_t *data, size_t len)
+{
+    while (len > 0)
+    {
+        uint8_t *dst = s_import.header_done ? (uint8_t *)&s_import.face : (uint8_t *)&s_import.header;
+        size_t want = s_import.header_done ? sizeof(s_import.face) : sizeof(s_import.header);
+        if (s_import.header_done && s_import.faces == s_import.header.count)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        size_t n = want - s_import.got < len ? want - s_import.got : len;
+        memcpy(dst + s_import.got, data, n);
+        s_import.got += n;
+        data += n;
+        len -= n;
+        if (s_import.got < want)
+        {
+            break;
+        }
+
+        esp_err_t err;
+        s_import.got = 0;
+        if (!s_import.header_done)
+        {
+            err = face_import_check_header(&s_import.header);
+            s_import.header_done = true;
+        }
+        else
+        {
+            err = face_import_add(&s_import.face);
+            s_import.faces++;
+        }
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t app_face_store_import_end(bool commit)
+{
+    esp_err_t err = ESP_OK;
+    int64_t start = esp_timer_get_time();
+
+    if (commit && (!s_import.header_done || s_import.got || s_import.faces != s_import.header.count))
+    {
+        ESP_LOGE(TAG, "Import ended after %u of %u faces", s_import.faces, s_import.header.count);
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    if (commit && err == ESP_OK)
+    {
+        err = face_import_flush();
+        // the sectors past the faces take the records appended later
+        for (size_t off = s_import.offset; off < s_bank_size && err == ESP_OK; off += SPI_FLASH_SEC_SIZE)
+        {
+            if (!face_store_sector_blank(s_import.bank, off))
+            {
+                err = esp_partition_erase_range(s_partition, face_store_bank_offset(s_import.bank) + off, SPI_FLASH_SEC_SIZE);
+                vTaskDelay(1);
+            }
+        }
+        if (err == ESP_OK)
+        {
+            // all changes so far were replaced, peers have to import as well
+            err = face_store_write_bank_header(s_import.bank, s_seq + 1, s_change);
+        }
+        if (err == ESP_OK)
+        {
+            int old = s_bank;
+            s_bank = s_import.bank;
+            s_seq++;
+            face_store_scan(s_bank, sizeof(face_record_t));
+            // invalidate the old bank, it is erased fully before it is used again
+            esp_partition_erase_range(s_partition, face_store_bank_offset(old), SPI_FLASH_SEC_SIZE);
+            app_face_db_reindex();
+            ESP_LOGI(TAG, "Imported %u faces into bank %d in %ums", s_import.faces, s_bank,
+                    (uint32_t)((esp_timer_get_time() - start) / 1000));
+        }
+        else
+        {
+            ESP_LOGE(TAG, "Import failed (0x%x)", err);
+        }
+    }
+
+    if (s_import.sector)
+    {
+        app_mem_free(APP_MEM_FACE_IMPORT, s_import.sector, SPI_FLASH_SEC_SIZE);
+    }
+    memset(&s_import, 0, sizeof(s_import));
+    face_store_release();
+    return err;
+}
+
+uint32_t app_face_store_last_change()
+{
+    return s_change;
+}
+
+esp_err_t app_face_store_changes(uint32_t since, face_store_write_cb write, void *arg)
+{
+    const face_record_t *record;
+    size_t off = sizeof(face_bank_t);
+
+    if (!s_write_lock)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // the log is read twice, to count the changes first
+    xSemaphoreTake(s_write_lock, portMAX_DELAY);
+    if (since < s_base || since > s_change)
+    {
+        xSemaphoreGive(s_write_lock);
+        return ESP_ERR_NOT_FOUND;
+    }
+    face_delta_header_t header = {
+        .magic = FACE_DELTA_MAGIC,
+        .version = FACE_DELTA_VERSION,
+        .vec_len = FACE_ID_SIZE,
+        .name_len = FACE_NAME_MAX,
+        .since = since,
+        .last = s_change,
+    };
+    while ((record = face_store_next(s_bank, &off, sizeof(face_record_t))) != NULL)
+    {
+        header.count += record->magic == FACE_STORE_RECORD_MAGIC && record->change > since;
+    }
+
+    esp_err_t err = write(arg, (const char *)&header, sizeof(header));
+    off = sizeof(face_bank_t);
+    while (err == ESP_OK && (record = face_store_next(s_bank, &off, sizeof(face_record_t))) != NULL)
+    {
+        if (record->magic != FACE_STORE_RECORD_MAGIC || record->change <= since)
+        {
+            continue;
+        }
+        face_delta_change_t change = {
+            .change = record->change,
+            .op = record->op,
+            .len = record->len,
+            .id = record->id,
+            .scale = record->scale,
+        };
+        err = write(arg, (const char *)&change, sizeof(change));
+        if (err == ESP_OK && record->len)
+        {
+            err = write(arg, (const char *)(record + 1), record->len);
+        }
+    }
+    xSemaphoreGive(s_write_lock);
+    return err;
+}
+
+static esp_err_t face_apply_check_header(const face_delta_header_t *header)
+{
+    if (header->magic != FACE_DELTA_MAGIC)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (header->version != FACE_DELTA_VERSION)
+    {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    if (header->vec_len != FACE_ID_SIZE || header->name_len != FACE_NAME_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t face_apply_check_change(const face_delta_change_t *change)
+{
+    if (change->id < 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    switch (change->op)
+    {
+    case FACE_STORE_ADD:
+        return change->len == FACE_ID_SIZE ? ESP_OK : ESP_ERR_INVALID_ARG;
+    case FACE_STORE_DELETE:
+        return change->len == 0 ? ESP_OK : ESP_ERR_INVALID_ARG;
+    case FACE_STORE_NAME:
+        return change->len == FACE_NAME_MAX ? ESP_OK : ESP_ERR_INVALID_ARG;
+    default:
+        return ESP_ERR_INVALID_ARG;
+    }
+}
+
+/* Writes a change of a peer as a change of this store, unless the store has it already */
+static esp_err_t face_apply_change(const face_delta_change_t *change, uint8_t *payload)
+{
+    face_store_op_t *op = &s_apply->op;
+    face_entry_t entry;
+    bool found = app_face_db_get(change->id, &entry) == ESP_OK;
+    esp_err_t err;
+
+    memset(op, 0, sizeof(*op));
+    op->record.magic = FACE_STORE_RECORD_MAGIC;
+    op->record.id = change->id;
+    switch (change->op)
+    {
+    case FACE_STORE_ADD:
+        if (found && entry.scale == change->scale && !memcmp(entry.vec, payload, FACE_ID_SIZE))
+        {
+            return ESP_OK;
+        }
+        if (found)
+        {
+            // enrolled again elsewhere, the old vector goes like a removed face
+            app_face_db_remove(change->id);
+            op->record.op = FACE_STORE_DELETE;
+            err = face_store_write_op(op);
+            if (err != ESP_OK)
+            {
+                return err;
+            }
+            memset(op, 0, sizeof(*op));
+            op->record.magic = FACE_STORE_RECORD_MAGIC;
+            op->record.id = change->id;
+        }
+        else if (app_face_db_count() >= app_face_store_capacity())
+        {
+            return ESP_ERR_NO_MEM;
+        }
+        op->record.op = FACE_STORE_ADD;
+        op->record.len = FACE_ID_SIZE;
+        op->record.scale = change->scale;
+        memcpy(op->vec, payload, FACE_ID_SIZE);
+        err = face_store_write_op(op);
+        portENTER_CRITICAL(&s_id_mux);
+        s_next_id = change->id >= s_next_id ? change->id + 1 : s_next_id;
+        portEXIT_CRITICAL(&s_id_mux);
+        return err;
+    case FACE_STORE_DELETE:
+        if (!found)
+        {
+            return ESP_OK;
+        }
+        app_face_db_remove(change->id);
+        op->record.op = FACE_STORE_DELETE;
+        return face_store_write_op(op);
+    default:
+        payload[FACE_NAME_MAX - 1] = 0;
+        // a name of a face removed since, or never seen here, has nothing to name
+        if (!found || !strcmp(entry.name ? entry.name : "", (const char *)payload))
+        {
+            return ESP_OK;
+        }
+        op->record.op = FACE_STORE_NAME;
+        op->record.len = FACE_NAME_MAX;
+        strlcpy(op->name, (const char *)payload, FACE_NAME_MAX);
+        return face_store_write_op(op);
+    }
+}
+
+esp_err_t app_face_store_apply_begin()
+{
+    esp_err_t err = face_store_take();
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    s_apply = (face_apply_t *)heap_caps_calloc(1, sizeof(face_apply_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!s_apply)
+    {
+        face_store_release();
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t app_face_store_apply_write(const uint8_t *data, size_t len)
+{
+    while (len > 0)
+    {
+        uint8_t *dst;
+        size_t want;
+        switch (s_apply->part)
+        {
+        case 0:
+            dst = (uint8_t *)&s_apply->header;
+            want = sizeof(s_apply->header);
+            break;
+        case 1:
+            if (s_apply->changes == s_apply->header.count)
+            {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            dst = (uint8_t *)&s_apply->change;
+            want = sizeof(s_apply->change);
+            break;
+        default:
+            dst = s_apply->payload;
+            want = s_apply->change.len;
+            break;
+        }
+
+        size_t n = want - s_apply->got < len ? want - s_apply->got : len;
+        memcpy(dst + s_apply->got, data, n);
+        s_apply->got += n;
+        data += n;
+        len -= n;
+        if (s_apply->got < want)
+        {
+            break;
+        }
+
+        esp_err_t err;
+        s_apply->got = 0;
+        if (s_apply->part == 0)
+        {
+            err = face_apply_check_header(&s_apply->header);
+            s_apply->part = 1;
+        }
+        else if (s_apply->part == 1 && s_apply->change.len)
+        {
+            err = face_apply_check_change(&s_apply->change);
+            s_apply->part = 2;
+        }
+        else
+        {
+            // a removal has no payload, it is applied right after its change
+            err = s_apply->part == 1 ? face_apply_check_change(&s_apply->change) : ESP_OK;
+            if (err == ESP_OK)
+            {
+                err = face_apply_change(&s_apply->change, s_apply->payload);
+            }
+            s_apply->changes++;
+            s_apply->part = 1;
+        }
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t app_face_store_apply_end(bool complete)
+{
+    esp_err_t err = ESP_OK;
+
+    if (complete && (s_apply->part != 1 || s_apply->got || s_apply->changes != s_apply->header.count))
+    {
+        ESP_LOGE(TAG, "Delta ended after %u of %u changes", s_apply->changes, s_apply->header.count);
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    else if (s_apply->changes)
+    {
+        ESP_LOGI(TAG, "Applied %u changes up to %u, last change %u", s_apply->changes, s_apply->header.last, s_change);
+    }
+    app_face_db_reindex();
+    free(s_apply);
+    s_apply = NULL;
+    face_store_release();
+    return err;
+}
+
+static int face_store_oldest()
+{
+    int count = app_face_db_count();
+    face_entry_t *entries = (face_entry_t *)heap_caps_malloc(count * sizeof(face_entry_t) + 1, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    int oldest = -1;
+
+    if (!entries)
+    {
+        return -1;
+    }
+    count = app_face_db_snapshot(entries, count);
+    for (int i = 0; i < count; i++)
+    {
+        if (oldest < 0 || entries[i].id < oldest)
+        {
+            oldest = entries[i].id;
+        }
+    }
+    free(entries);
+    return oldest;
+}
+
+int app_face_store_remove_oldest()
+{
+    int oldest = face_store_oldest();
+
+    if (oldest >= 0)
+    {
+        app_face_store_remove(oldest);
+    }
+    return app_face_db_count();
+}
+
+static esp_err_t face_store_format()
+{
+    esp_err_t err = face_store_erase_bank(1);
+    if (err == ESP_OK)
+    {
+        err = face_store_erase_bank(0);
+    }
+    if (err == ESP_OK)
+    {
+        err = face_store_write_bank_header(0, 0, 0);
+    }
+    s_bank = 0;
+    s_seq = 0;
+    s_tail = sizeof(face_bank_t);
+    s_dead = 0;
+    s_change = 0;
+    s_base = 0;
+    return err;
+}
+
+/* Converts the faces saved by read/enroll_face_id_to_flash into log records */
+static esp_err_t face_store_migrate()
+{
+    face_id_list list = {0};
+    int8_t *vec = (int8_t *)malloc(FACE_ID_SIZE);
+
+    if (!vec)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    face_id_init(&list, FACE_ID_SAVE_NUMBER, ENROLL_CONFIRM_TIMES);
+    read_face_id_from_flash(&list);
+
+    // the old faces only exist in RAM until they are written back
+    esp_err_t err = face_store_format();
+    for (int i = 0; i < list.count && err == ESP_OK; i++)
+    {
+        int slot = (list.head + i) % list.size;
+        face_record_t record = {
+            .op = FACE_STORE_ADD,
+            .len = FACE_ID_SIZE,
+            .id = s_next_id++,
+            .scale = app_face_db_quantize(list.id_list[slot], vec),
+        };
+        err = face_store_append(&record, vec, NULL);
+    }
+    if (list.count)
+    {
+        ESP_LOGI(TAG, "Converted %d faces from the esp-face format", list.count);
+    }
+
+    for (int i = 0; i < list.size; i++)
+    {
+        if (list.id_list[i])
+        {
+            dl_matrix3d_free(list.id_list[i]);
+        }
+    }
+    free(list.id_list);
+    free(vec);
+    return err;
+}
+
+esp_err_t app_face_store_init()
+{
+    app_boot_begin(BOOT_PHASE_FACE_DB);
+    s_partition = esp_partition_find_first((esp_partition_type_t)FR_FLASH_TYPE,
+            (esp_partition_subtype_t)FR_FLASH_SUBTYPE, FR_FLASH_PARTITION_NAME);
+    if (!s_partition)
+    {
+        ESP_LOGE(TAG, "No %s partition", FR_FLASH_PARTITION_NAME);
+        return ESP_ERR_NOT_FOUND;
+    }
+    s_bank_size = (s_partition->size / 2) & ~(SPI_FLASH_SEC_SIZE - 1);
+
+    esp_err_t err = esp_partition_mmap(s_partition, 0, s_partition->size, SPI_FLASH_MMAP_DATA,
+            (const void **)&s_map, &s_map_handle);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Mapping %s failed (0x%x)", FR_FLASH_PARTITION_NAME, err);
+        return err;
+    }
+
+    const face_bank_t *bank0 = face_store_bank(0);
+    const face_bank_t *bank1 = face_store_bank(1);
+    bool valid0 = bank0->magic == FACE_STORE_BANK_MAGIC || bank0->magic == FACE_STORE_BANK_MAGIC_V1;
+    bool valid1 = bank1->magic == FACE_STORE_BANK_MAGIC || bank1->magic == FACE_STORE_BANK_MAGIC_V1;
+    if (!valid0 && !valid1)
+    {
+        err = face_store_migrate();
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Formatting %s failed (0x%x)", FR_FLASH_PARTITION_NAME, err);
+            return err;
+        }
+    }
+    else
+    {
+        // sequence numbers only grow, a compaction cut short leaves the older bank valid
+        s_bank = (valid1 && (!valid0 || bank1->seq > bank0->seq)) ? 1 : 0;
+        s_seq = face_store_bank(s_bank)->seq;
+    }
+    if (face_store_bank(s_bank)->magic == FACE_STORE_BANK_MAGIC_V1)
+    {
+        face_store_scan(s_bank, FACE_STORE_RECORD_V1_LEN);
+        // the records grew, a full WFS1 bank may hold a few faces more than fit now
+        for (int id; app_face_db_count() > app_face_store_capacity() && (id = face_store_oldest()) >= 0; )
+        {
+            ESP_LOGW(TAG, "Face ID %d does not fit the store anymore", id);
+            app_face_db_remove(id);
+        }
+        err = face_store_compact_bank(true);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+        ESP_LOGI(TAG, "Numbered the changes of %d faces", app_face_db_count());
+    }
+    face_store_scan(s_bank, sizeof(face_record_t));
+    ESP_LOGI(TAG, "%d faces in bank %d, %u of %u bytes used, last change %u", app_face_db_count(), s_bank, s_tail, s_bank_size, s_change);
+    app_boot_end(BOOT_PHASE_FACE_DB);
+
+    s_op_queue = xQueueCreate(FACE_STORE_QUEUE_LEN, sizeof(face_store_op_t *));
+    s_write_lock = xSemaphoreCreateMutex();
+    if (!s_op_queue || !s_write_lock)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    return app_task_create(APP_TASK_FACE_STORE, &face_store_task, NULL, NULL);
+}
@@ -0,0 +1,231 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "app_frame_pool.h"
+#include "app_jpeg.h"
+#include "app_mem.h"
+
+static const char *TAG = "app_frame_pool";
+
+/*
+ * Sensor JPEGs at quality 10 are about a tenth of the raw size,
+ * the overlay re-encode at quality 90 stays well below a quarter.
+ */
+#define FRAME_POOL_JPG_RATIO    4
+
+static QueueHandle_t s_matrix_queue = NULL;
+static QueueHandle_t s_jpg_queue = NULL;
+static size_t s_width = 0;
+static size_t s_height = 0;
+static int s_count = 0;
+
+static size_t jpg_write_cb(void *arg, size_t index, const void *data, size_t len)
+{
+    frame_jpg_t *jpg = (frame_jpg_t *)arg;
+
+    if (index + len > jpg->size)
+    {
+        return 0;
+    }
+    memcpy(jpg->buf + index, data, len);
+    jpg->len = index + len;
+    return len;
+}
+
+static esp_err_t frame_pool_alloc(int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        dl_matrix3du_t *matrix = app_mem_matrix_alloc(APP_MEM_FRAME, s_width, s_height, 3);
+        frame_jpg_t *jpg = (frame_jpg_t *)calloc(1, sizeof(frame_jpg_t));
+        if (!matrix || !jpg)
+        {
+            ESP_LOGE(TAG, "Pool allocation failed at %d/%d", i, count);
+            app_mem_matrix_free(APP_MEM_FRAME, matrix);
+            free(jpg);
+            return ESP_ERR_NO_MEM;
+        }
+        jpg->size = s_width * s_height * 3 / FRAME_POOL_JPG_RATIO;
+        jpg->buf = (uint8_t *)app_mem_alloc(APP_MEM_FRAME_JPEG, jpg->size);
+        if (!jpg->buf)
+        {
+            ESP_LOGE(TAG, "Pool allocation failed at %d/%d", i, count);
+            app_mem_matrix_free(APP_MEM_FRAME, matrix);
+            free(jpg);
+            return ESP_ERR_NO_MEM;
+        }
+        xQueueSend(s_matrix_queue, &matrix, portMAX_DELAY);
+        xQueueSend(s_jpg_queue, &jpg, portMAX_DELAY);
+    }
+    ESP_LOGI(TAG, "%d frames of %ux%u preallocated", count, s_width, s_height);
+    return ESP_OK;
+}
+
+static void frame_pool_free()
+{
+    dl_matrix3du_t *matrix = NULL;
+    frame_jpg_t *jpg = NULL;
+
+    while (xQueueReceive(s_matrix_queue, &matrix, 0) == pdTRUE)
+    {
+        app_mem_matrix_free(APP_MEM_FRAME, matrix);
+    }
+    while (xQueueReceive(s_jpg_queue, &jpg, 0) == pdTRUE)
+    {
+        app_mem_free(APP_MEM_FRAME_JPEG, jpg->buf, jpg->size);
+        free(jpg);
+    }
+}
+
+esp_err_t app_frame_pool_init(framesize_t frame_size, int count)
+{
+    app_camera_get_resolution(frame_size, &s_width, &s_height);
+
+    s_count = count;
+    s_matrix_queue = xQueueCreate(count, sizeof(dl_matrix3du_t *));
+    s_jpg_queue = xQueueCreate(count, sizeof(frame_jpg_t *));
+    if (!s_matrix_queue || !s_jpg_queue)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    return frame_pool_alloc(count);
+}
+
+esp_err_t app_frame_pool_resize(framesize_t frame_size)
+{
+    size_t width, height;
+
+    app_camera_get_resolution(frame_size, &width, &height);
+    if (width * height <= s_width * s_height)
+    {
+        return ESP_OK;
+    }
+    if (uxQueueMessagesWaiting(s_matrix_queue) != s_count || uxQueueMessagesWaiting(s_jpg_queue) != s_count)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    size_t old_width = s_width;
+    size_t old_height = s_height;
+    frame_pool_free();
+    s_width = width;
+    s_height = height;
+    esp_err_t err = frame_pool_alloc(s_count);
+    if (err != ESP_OK)
+    {
+        // go back to the old size, which was allocated before
+        frame_pool_free();
+        s_width = old_width;
+        s_height = old_height;
+        if (frame_pool_alloc(s_count) != ESP_OK)
+        {
+            // keep the frames there are, so the pool stays whole for the next resize
+            s_count = uxQueueMessagesWaiting(s_matrix_queue);
+            ESP_LOGE(TAG, "Pool shrunk to %d frames of %ux%u", s_count, s_width, s_height);
+        }
+    }
+    return err;
+}
+
+dl_matrix3du_t *app_frame_pool_acquire(TickType_t timeout)
+{
+    dl_matrix3du_t *matrix = NULL;
+    if (xQueueReceive(s_matrix_queue, &matrix, timeout) != pdTRUE)
+    {
+        return NULL;
+    }
+    return matrix;
+}
+
+void app_frame_pool_release(dl_matrix3du_t *matrix)
+{
+    if (matrix)
+    {
+        xQueueSend(s_matrix_queue, &matrix, portMAX_DELAY);
+    }
+}
+
+bool app_frame_pool_fit(dl_matrix3du_t *matrix, size_t width, size_t height)
+{
+    if (width * height > s_width * s_height)
+    {
+        return false;
+    }
+    matrix->w = width;
+    matrix->h = height;
+    matrix->stride = width * matrix->c;
+    return true;
+}
+
+frame_jpg_t *app_frame_pool_acquire_jpg(TickType_t timeout)
+{
+    frame_jpg_t *jpg = NULL;
+    if (xQueueReceive(s_jpg_queue, &jpg, timeout) != pdTRUE)
+    {
+        return NULL;
+    }
+    jpg->len = 0;
+    return jpg;
+}
+
+void app_frame_pool_release_jpg(frame_jpg_t *jpg)
+{
+    if (jpg)
+    {
+        xQueueSend(s_jpg_queue, &jpg, portMAX_DELAY);
+    }
+}
+
+bool app_frame_pool_encode(dl_matrix3du_t *matrix, uint8_t quality, frame_jpg_t *jpg)
+{
+    jpg->len = 0;
+#ifdef CONFIG_JPEG_FAST_ENCODER
+    if (app_jpeg_encode(matrix, quality, jpg))
+    {
+        return true;
+    }
+    jpg->len = 0;
+#endif
+    return fmt2jpg_cb(matrix->item, matrix->w * matrix->h * 3, matrix->w, matrix->h,
+                      PIXFORMAT_RGB888, quality, jpg_write_cb, jpg);
+}
+
+bool app_frame_pool_encode_faces(dl_matrix3du_t *matrix, uint8_t quality, const box_t *boxes, int count, frame_jpg_t *jpg)
+{
+#ifdef CONFIG_JPEG_ROI
+    jpg->len = 0;
+    if (app_jpeg_encode_roi(matrix, quality, CONFIG_JPEG_ROI_BACKGROUND_QUALITY, boxes, count, jpg))
+    {
+        return true;
+    }
+#endif
+    return app_frame_pool_encode(matrix, quality, jpg);
+}
+
+bool app_frame_pool_encode_fb(camera_fb_t *fb, uint8_t quality, frame_jpg_t *jpg)
+{
+    jpg->len = 0;
+    return fmt2jpg_cb(fb->buf, fb->len, fb->width, fb->height, fb->format, quality, jpg_write_cb, jpg);
+}
@@ -0,0 +1,232 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "cJSON.h"
+#include "sdkconfig.h"
+#include "app_frame_source.h"
+#include "app_pipeline.h"
+#include "app_image.h"
+#include "app_mem.h"
+
+static const char *TAG = "app_frame_source";
+
+/* JPEGs indexed in a corpus, the rest of the upload is ignored */
+#define CORPUS_MAX_FRAMES       256
+
+static const char *s_names[FRAME_SOURCE_MAX] = {
+    [FRAME_SOURCE_CAMERA]   = "camera",
+    [FRAME_SOURCE_COLORBAR] = "colorbar",
+    [FRAME_SOURCE_CORPUS]   = "corpus",
+};
+
+typedef struct {
+    uint32_t offset;
+    uint32_t len;
+    uint16_t width;
+    uint16_t height;
+} corpus_frame_t;
+
+static volatile frame_source_t s_source = FRAME_SOURCE_CAMERA;
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static uint8_t *s_corpus = NULL;
+static size_t s_corpus_len = 0;
+static corpus_frame_t s_index[CORPUS_MAX_FRAMES];
+static int s_frames = 0;
+static int s_next = 0;
+static int64_t s_next_us = 0;
+// each frame in flight gets a descriptor of its own, they may show the same JPEG
+static camera_fb_t s_fbs[PIPELINE_DEPTH];
+static uint32_t s_fbs_out = 0;
+
+static camera_fb_t *corpus_get()
+{
+    camera_fb_t *fb = NULL;
+
+#if CONFIG_FRAME_SOURCE_CORPUS_FPS > 0
+    int64_t now = esp_timer_get_time();
+    if (s_next_us > now)
+    {
+        vTaskDelay((s_next_us - now) / 1000 / portTICK_PERIOD_MS + 1);
+    }
+    // a late frame does not make the next ones come sooner
+    s_next_us = (s_next_us > now ? s_next_us : now) + 1000000 / CONFIG_FRAME_SOURCE_CORPUS_FPS;
+#endif
+    portENTER_CRITICAL(&s_mux);
+    for (int i = 0; i < PIPELINE_DEPTH; i++)
+    {
+        if (!(s_fbs_out & (1u << i)))
+        {
+            s_fbs_out |= (1u << i);
+            fb = &s_fbs[i];
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_mux);
+    if (!fb)
+    {
+        return NULL;
+    }
+    const corpus_frame_t *frame = &s_index[s_next];
+    s_next = (s_next + 1) % s_frames;
+    fb->buf = s_corpus + frame->offset;
+    fb->len = frame->len;
+    fb->width = frame->width;
+    fb->height = frame->height;
+    fb->format = PIXFORMAT_JPEG;
+    return fb;
+}
+
+camera_fb_t *app_frame_source_get()
+{
+    // a corpus is only replaced while it is not selected
+    return s_source == FRAME_SOURCE_CORPUS ? corpus_get() : esp_camera_fb_get();
+}
+
+void app_frame_source_return(camera_fb_t *fb)
+{
+    if (fb >= s_fbs && fb < s_fbs + PIPELINE_DEPTH)
+    {
+        portENTER_CRITICAL(&s_mux);
+        s_fbs_out &= ~(1u << (fb - s_fbs));
+        portEXIT_CRITICAL(&s_mux);
+        return;
+    }
+    esp_camera_fb_return(fb);
+}
+
+frame_source_t app_frame_source()
+{
+    return s_source;
+}
+
+const char *app_frame_source_name(frame_source_t source)
+{
+    return source < FRAME_SOURCE_MAX ? s_names[source] : "unknown";
+}
+
+esp_err_t app_frame_source_select(frame_source_t source)
+{
+    if (source >= FRAME_SOURCE_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (source == FRAME_SOURCE_CORPUS && s_frames == 0)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    sensor_t *s = esp_camera_sensor_get();
+    if (s)
+    {
+        s->set_colorbar(s, source == FRAME_SOURCE_COLORBAR);
+    }
+    // every run over the corpus starts with its first frame
+    s_next = 0;
+    s_next_us = 0;
+    s_source = source;
+    ESP_LOGI(TAG, "Frames from %s", s_names[source]);
+    return ESP_OK;
+}
+
+esp_err_t app_frame_source_load(uint8_t *buf, size_t len)
+{
+    size_t pos = 0;
+    int frames = 0;
+
+    portENTER_CRITICAL(&s_mux);
+    bool busy = s_source == FRAME_SOURCE_CORPUS || s_fbs_out;
+    portEXIT_CRITICAL(&s_mux);
+    if (busy)
+    {
+        app_mem_free(APP_MEM_FRAME_CORPUS, buf, len);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // anything between the images is skipped, as by app_bench_run
+    while (pos + 4 <= len && frames < CORPUS_MAX_FRAMES)
+    {
+        if (buf[pos] != 0xFF || buf[pos + 1] != 0xD8)
+        {
+            pos++;
+            continue;
+        }
+        size_t end = pos + 2;
+        // 0xFF never precedes 0xD9 in entropy coded data
+        while (end + 1 < len && !(buf[end] == 0xFF && buf[end + 1] == 0xD9))
+        {
+            end++;
+        }
+        if (end + 1 >= len)
+        {
+            break;
+        }
+        end += 2;
+        size_t width, height;
+        if (app_image_jpeg_size(buf + pos, end - pos, &width, &height))
+        {
+            s_index[frames].offset = pos;
+            s_index[frames].len = end - pos;
+            s_index[frames].width = width;
+            s_index[frames].height = height;
+            frames++;
+        }
+        pos = end;
+    }
+
+    if (s_corpus)
+    {
+        app_mem_free(APP_MEM_FRAME_CORPUS, s_corpus, s_corpus_len);
+    }
+    s_corpus = frames ? buf : NULL;
+    s_corpus_len = frames ? len : 0;
+    s_frames = frames;
+    if (!frames)
+    {
+        app_mem_free(APP_MEM_FRAME_CORPUS, buf, len);
+        return ESP_ERR_NOT_FOUND;
+    }
+    ESP_LOGI(TAG, "Corpus of %d frames, %uKB", frames, len / 1024);
+    return ESP_OK;
+}
+
+char *app_frame_source_to_json()
+{
+    cJSON *root = cJSON_CreateObject();
+
+    if (!root)
+    {
+        return NULL;
+    }
+    cJSON_AddStringToObject(root, "source", app_frame_source_name(s_source));
+    cJSON_AddNumberToObject(root, "corpus_frames", s_frames);
+    cJSON_AddNumberToObject(root, "corpus_kb", s_corpus_len / 1024);
+#if CONFIG_FRAME_SOURCE_CORPUS_FPS > 0
+    cJSON_AddNumberToObject(root, "corpus_fps", CONFIG_FRAME_SOURCE_CORPUS_FPS);
+#endif
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return json;
+}
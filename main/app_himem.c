@@ -0,0 +1,197 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp32/himem.h"
+#include "sdkconfig.h"
+#include "app_himem.h"
+
+static const char *TAG = "app_himem";
+
+/* Blocks mapped at once, the rest of the bank switching window is left to others */
+#define HIMEM_SLOTS             4
+#define HIMEM_NONE              ((size_t)-1)
+
+typedef struct {
+    size_t block;               /* himem block mapped here, HIMEM_NONE if none */
+    uint8_t *ptr;
+    uint32_t used;              /* access count at the last use */
+} himem_slot_t;
+
+static esp_himem_handle_t s_mem = NULL;
+static esp_himem_rangehandle_t s_range = NULL;
+static himem_slot_t s_slots[HIMEM_SLOTS];
+static SemaphoreHandle_t s_lock = NULL;
+static size_t s_size = 0;
+static size_t s_reserved = 0;
+static uint32_t s_clock = 0;
+static uint32_t s_hits = 0;
+static uint32_t s_misses = 0;
+
+static esp_err_t himem_init()
+{
+    size_t size = esp_himem_get_free_size() / ESP_HIMEM_BLKSZ * ESP_HIMEM_BLKSZ;
+
+    if (size == 0)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = esp_himem_alloc(size, &s_mem);
+    if (err == ESP_OK)
+    {
+        err = esp_himem_alloc_map_range(HIMEM_SLOTS * ESP_HIMEM_BLKSZ, &s_range);
+    }
+    if (err == ESP_OK)
+    {
+        s_lock = xSemaphoreCreateMutex();
+        err = s_lock ? ESP_OK : ESP_ERR_NO_MEM;
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "No himem store (0x%x)", err);
+        if (s_range)
+        {
+            esp_himem_free_map_range(s_range);
+            s_range = NULL;
+        }
+        if (s_mem)
+        {
+            esp_himem_free(s_mem);
+            s_mem = NULL;
+        }
+        return err;
+    }
+    for (int i = 0; i < HIMEM_SLOTS; i++)
+    {
+        s_slots[i].block = HIMEM_NONE;
+    }
+    s_size = size;
+    ESP_LOGI(TAG, "%uKB of himem, %u blocks mapped at a time", size / 1024, HIMEM_SLOTS);
+    return ESP_OK;
+}
+
+esp_err_t app_himem_reserve(size_t size, size_t *offset)
+{
+    if (!s_mem && himem_init() != ESP_OK)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    if (size > s_size - s_reserved)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    *offset = s_reserved;
+    s_reserved += size;
+    return ESP_OK;
+}
+
+/* Maps block into a slot, evicting the least recently used one. Called with s_lock held. */
+static uint8_t *himem_map(size_t block)
+{
+    himem_slot_t *slot = &s_slots[0];
+
+    s_clock++;
+    for (int i = 0; i < HIMEM_SLOTS; i++)
+    {
+        if (s_slots[i].block == block)
+        {
+            s_hits++;
+            s_slots[i].used = s_clock;
+            return s_slots[i].ptr;
+        }
+        if (s_slots[i].block == HIMEM_NONE || (slot->block != HIMEM_NONE && s_slots[i].used < slot->used))
+        {
+            slot = &s_slots[i];
+        }
+    }
+    s_misses++;
+    if (slot->block != HIMEM_NONE)
+    {
+        esp_himem_unmap(s_range, slot->ptr, ESP_HIMEM_BLKSZ);
+        slot->block = HIMEM_NONE;
+    }
+    void *ptr;
+    if (esp_himem_map(s_mem, s_range, block * ESP_HIMEM_BLKSZ, (slot - s_slots) * ESP_HIMEM_BLKSZ,
+            ESP_HIMEM_BLKSZ, 0, &ptr) != ESP_OK)
+    {
+        return NULL;
+    }
+    slot->block = block;
+    slot->ptr = (uint8_t *)ptr;
+    slot->used = s_clock;
+    return slot->ptr;
+}
+
+static esp_err_t himem_copy(size_t offset, uint8_t *data, size_t len, bool write)
+{
+    esp_err_t err = ESP_OK;
+
+    if (!s_mem || offset + len > s_size)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    while (len > 0)
+    {
+        size_t in_block = offset % ESP_HIMEM_BLKSZ;
+        size_t n = ESP_HIMEM_BLKSZ - in_block < len ? ESP_HIMEM_BLKSZ - in_block : len;
+        uint8_t *ptr = himem_map(offset / ESP_HIMEM_BLKSZ);
+        if (!ptr)
+        {
+            err = ESP_FAIL;
+            break;
+        }
+        if (write)
+        {
+            memcpy(ptr + in_block, data, n);
+        }
+        else
+        {
+            memcpy(data, ptr + in_block, n);
+        }
+        offset += n;
+        data += n;
+        len -= n;
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t app_himem_write(size_t offset, const void *data, size_t len)
+{
+    return himem_copy(offset, (uint8_t *)data, len, true);
+}
+
+esp_err_t app_himem_read(size_t offset, void *data, size_t len)
+{
+    return himem_copy(offset, (uint8_t *)data, len, false);
+}
+
+void app_himem_get_stats(himem_stats_t *stats)
+{
+    stats->size = s_size;
+    stats->reserved = s_reserved;
+    stats->hits = s_hits;
+    stats->misses = s_misses;
+}
@@ -22,339 +22,1208 @@
 
 #include "app_httpserver.h"
 #include "esp_log.h"
-#include "image_util.h"
-#include "fb_gfx.h"
 #include "app_main.h"
+#include "app_pipeline.h"
+#include "app_stream.h"
+#include "app_config.h"
+#include "app_metrics.h"
+#include "app_face_store.h"
+#include "app_speech_capture.h"
+#include "app_tasks.h"
+#include "app_snapshot.h"
+#include "app_rtsp.h"
+#include "app_face_event.h"
+#include "app_ws.h"
+#include "app_www.h"
+#include "app_soak.h"
+#include "app_clip.h"
+#include "app_bench.h"
+#include "app_frame_source.h"
+#include "app_ota.h"
+#include "app_display_bench.h"
+#include "app_tracer.h"
+#include "app_profiler.h"
+#include "app_mem.h"
+#include "app_offload.h"
+#include "app_rtclog.h"
+#include "app_enroll.h"
+#include "app_face_db.h"
+#include "app_perf.h"
 
 static const char *TAG = "app_httpserver";
 
-#define FACE_COLOR_WHITE  0x00FFFFFF
-#define FACE_COLOR_BLACK  0x00000000
-#define FACE_COLOR_RED    0x000000FF
-#define FACE_COLOR_GREEN  0x0000FF00
-#define FACE_COLOR_BLUE   0x00FF0000
-#define FACE_COLOR_YELLOW (FACE_COLOR_RED | FACE_COLOR_GREEN)
-#define FACE_COLOR_CYAN   (FACE_COLOR_BLUE | FACE_COLOR_GREEN)
-#define FACE_COLOR_PURPLE (FACE_COLOR_BLUE | FACE_COLOR_RED)
+static void oneshot_timer_callback(void* arg);
+
+esp_err_t facenet_stream_handler(httpd_req_t *req)
+{
+    esp_err_t res = app_stream_add_client(req);
+    if (res == ESP_ERR_INVALID_STATE)
+    {
+        return httpd_resp_send_404(req);
+    }
+    if (res != ESP_OK)
+    {
+        ESP_LOGW(TAG, "No viewer slot left (%d)", app_stream_client_count());
+        return httpd_resp_send_500(req);
+    }
+    // the viewer task owns the socket from here on
+    return ESP_OK;
+}
+
+httpd_uri_t _face_stream_handler = {
+    .uri       = "/face_stream",
+    .method    = HTTP_GET,
+    .handler   = facenet_stream_handler,
+    .user_ctx  = NULL
+};
+
+static esp_err_t face_crops_handler(httpd_req_t *req)
+{
+    esp_err_t res = app_stream_add_crop_client(req);
+    if (res == ESP_ERR_INVALID_STATE)
+    {
+        return httpd_resp_send_404(req);
+    }
+    if (res != ESP_OK)
+    {
+        ESP_LOGW(TAG, "No viewer slot left (%d)", app_stream_client_count());
+        return httpd_resp_send_500(req);
+    }
+    return ESP_OK;
+}
+
+httpd_uri_t _face_crops_handler = {
+    .uri       = "/face_crops",
+    .method    = HTTP_GET,
+    .handler   = face_crops_handler,
+    .user_ctx  = NULL
+};
+
+static esp_err_t capture_write(void *arg, const uint8_t *jpg, size_t len, const char *tag)
+{
+    httpd_req_t *req = (httpd_req_t *)arg;
+    char match[32];
+
+    httpd_resp_set_hdr(req, "ETag", tag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", match, sizeof(match)) == ESP_OK && !strcmp(match, tag))
+    {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+    httpd_resp_set_type(req, "image/jpeg");
+    return httpd_resp_send(req, (const char *)jpg, len);
+}
+
+#ifdef CONFIG_EVENT_CLIP
+static esp_err_t clip_write(void *arg, const uint8_t *data, size_t len)
+{
+    return httpd_resp_send_chunk((httpd_req_t *)arg, (const char *)data, len);
+}
+
+static esp_err_t clip_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "video/x-msvideo");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"clip.avi\"");
+    esp_err_t err = app_clip_send(clip_write, req);
+    if (err == ESP_ERR_NOT_FOUND)
+    {
+        return httpd_resp_send_404(req);
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Clip not sent (0x%x)", err);
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+httpd_uri_t _clip_handler = {
+    .uri       = "/clip",
+    .method    = HTTP_GET,
+    .handler   = clip_handler,
+    .user_ctx  = NULL
+};
+#endif
+
+static esp_err_t capture_handler(httpd_req_t *req)
+{
+    TRACE_BEGIN(TRACE_HTTPD, httpd_req_to_sockfd(req));
+    esp_err_t err = app_snapshot_get(capture_write, req);
+    TRACE_END(TRACE_HTTPD, httpd_req_to_sockfd(req));
+    if (err == ESP_ERR_TIMEOUT || err == ESP_ERR_NO_MEM || err == ESP_FAIL)
+    {
+        ESP_LOGW(TAG, "No snapshot (0x%x)", err);
+        return httpd_resp_send_500(req);
+    }
+    return err;
+}
+
+httpd_uri_t _capture_handler = {
+    .uri       = "/capture",
+    .method    = HTTP_GET,
+    .handler   = capture_handler,
+    .user_ctx  = NULL
+};
+
+static esp_err_t status_handler(httpd_req_t *req)
+{
+    TRACE_BEGIN(TRACE_HTTPD, httpd_req_to_sockfd(req));
+    char *json = app_stream_status_to_json();
+    TRACE_END(TRACE_HTTPD, httpd_req_to_sockfd(req));
+    if (!json)
+    {
+        return httpd_resp_send_500(req);
+    }
+    httpd_resp_set_type(req, HTTPD_TYPE_JSON);
+    esp_err_t res = httpd_resp_send(req, json, strlen(json));
+    free(json);
+    return res;
+}
+
+httpd_uri_t _status_handler = {
+    .uri       = "/status",
+    .method    = HTTP_GET,
+    .handler   = status_handler,
+    .user_ctx  = NULL
+};
+
+#define HTTPD_BODY_MAX     1024
+
+#ifdef CONFIG_RTSP_SERVER
+#define HTTPD_RTSP_SOCKETS     RTSP_SOCKETS
+#else
+#define HTTPD_RTSP_SOCKETS     0
+#endif
+#ifdef CONFIG_FACE_EVENTS
+#define HTTPD_EVENT_SOCKETS    1
+#else
+#define HTTPD_EVENT_SOCKETS    0
+#endif
+#ifdef CONFIG_WS_CONTROL
+#define HTTPD_WS_SOCKETS       WS_SOCKETS
+#else
+#define HTTPD_WS_SOCKETS       0
+#endif
+#ifdef CONFIG_OFFLOAD_INFERENCE
+#define HTTPD_OFFLOAD_SOCKETS  1
+#else
+#define HTTPD_OFFLOAD_SOCKETS  0
+#endif
+#define HTTPD_OTHER_SOCKETS    (HTTPD_RTSP_SOCKETS + HTTPD_EVENT_SOCKETS + HTTPD_WS_SOCKETS + HTTPD_OFFLOAD_SOCKETS)
+
+// the server keeps three sockets of its own
+#if STREAM_MAX_CLIENTS + STREAM_CONTROL_SOCKETS + HTTPD_OTHER_SOCKETS > CONFIG_LWIP_MAX_SOCKETS - 3
+#error "CONFIG_LWIP_MAX_SOCKETS is too small for CONFIG_MAX_STA_CONN viewers"
+#endif
+
+static esp_err_t config_get_handler(httpd_req_t *req)
+{
+    char *json = app_config_to_json();
+    if (!json)
+    {
+        return httpd_resp_send_500(req);
+    }
+    httpd_resp_set_type(req, HTTPD_TYPE_JSON);
+    esp_err_t res = httpd_resp_send(req, json, strlen(json));
+    free(json);
+    return res;
+}
+
+static esp_err_t recv_body(httpd_req_t *req, char *buf)
+{
+    size_t len = 0;
+
+    if (req->content_len > HTTPD_BODY_MAX)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Body too large");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    while (len < req->content_len)
+    {
+        int ret = httpd_req_recv(req, buf + len, req->content_len - len);
+        if (ret <= 0)
+        {
+            return ESP_FAIL;
+        }
+        len += ret;
+    }
+    buf[len] = 0;
+    return ESP_OK;
+}
+
+static esp_err_t config_post_handler(httpd_req_t *req)
+{
+    char buf[HTTPD_BODY_MAX + 1];
+
+    esp_err_t err = recv_body(req, buf);
+    if (err != ESP_OK)
+    {
+        return err == ESP_ERR_INVALID_SIZE ? ESP_OK : err;
+    }
+
+    err = app_config_from_json(buf);
+    if (err == ESP_ERR_INVALID_ARG)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid configuration");
+    }
+    if (err != ESP_OK)
+    {
+        // applied, but it will not survive a reboot
+        ESP_LOGW(TAG, "Configuration not saved (0x%x)", err);
+    }
+    return config_get_handler(req);
+}
+
+httpd_uri_t _config_get_handler = {
+    .uri       = "/config",
+    .method    = HTTP_GET,
+    .handler   = config_get_handler,
+    .user_ctx  = NULL
+};
+
+httpd_uri_t _config_post_handler = {
+    .uri       = "/config",
+    .method    = HTTP_POST,
+    .handler   = config_post_handler,
+    .user_ctx  = NULL
+};
+
+static esp_err_t camera_get_handler(httpd_req_t *req)
+{
+    char *json = app_camera_to_json();
+    if (!json)
+    {
+        return httpd_resp_send_500(req);
+    }
+    httpd_resp_set_type(req, HTTPD_TYPE_JSON);
+    esp_err_t res = httpd_resp_send(req, json, strlen(json));
+    free(json);
+    return res;
+}
+
+static esp_err_t camera_post_handler(httpd_req_t *req)
+{
+    char buf[HTTPD_BODY_MAX + 1];
+    camera_settings_t settings;
+
+    esp_err_t err = recv_body(req, buf);
+    if (err != ESP_OK)
+    {
+        return err == ESP_ERR_INVALID_SIZE ? ESP_OK : err;
+    }
+
+    app_camera_get_settings(&settings);
+    if (app_camera_from_json(buf, &settings) != ESP_OK)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid camera settings");
+    }
+    if (app_pipeline_set_camera(&settings) != ESP_OK)
+    {
+        return httpd_resp_send_500(req);
+    }
+    return camera_get_handler(req);
+}
+
+httpd_uri_t _camera_get_handler = {
+    .uri       = "/camera",
+    .method    = HTTP_GET,
+    .handler   = camera_get_handler,
+    .user_ctx  = NULL
+};
+
+httpd_uri_t _camera_post_handler = {
+    .uri       = "/camera",
+    .method    = HTTP_POST,
+    .handler   = camera_post_handler,
+    .user_ctx  = NULL
+};
+
+#ifdef CONFIG_CAMERA_TUNE
+/* Tries each XCLK at the current frame size and keeps the best, the stream pauses meanwhile */
+static esp_err_t camera_tune_handler(httpd_req_t *req)
+{
+    camera_tune_t result;
+
+    esp_err_t err = app_pipeline_tune_camera(&result);
+    char *json = result.steps ? app_camera_tune_to_json(&result) : NULL;
+    if (!json)
+    {
+        return httpd_resp_send_500(req);
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Camera tune ended with 0x%x", err);
+    }
+    httpd_resp_set_type(req, HTTPD_TYPE_JSON);
+    esp_err_t res = httpd_resp_send(req, json, strlen(json));
+    free(json);
+    return res;
+}
+
+httpd_uri_t _camera_tune_handler = {
+    .uri       = "/camera/tune",
+    .method    = HTTP_POST,
+    .handler   = camera_tune_handler,
+    .user_ctx  = NULL
+};
+#endif
+
+#ifdef CONFIG_APP_RECOGNITION
+static esp_err_t faces_get_handler(httpd_req_t *req)
+{
+    char *json = app_face_store_to_json();
+    if (!json)
+    {
+        return httpd_resp_send_500(req);
+    }
+    httpd_resp_set_type(req, HTTPD_TYPE_JSON);
+    esp_err_t res = httpd_resp_send(req, json, strlen(json));
+    free(json);
+    return res;
+}
+
+static esp_err_t faces_post_handler(httpd_req_t *req)
+{
+    char buf[HTTPD_BODY_MAX + 1];
+
+    esp_err_t err = recv_body(req, buf);
+    if (err != ESP_OK)
+    {
+        return err == ESP_ERR_INVALID_SIZE ? ESP_OK : err;
+    }
+
+    err = app_face_store_from_json(buf);
+    if (err == ESP_ERR_INVALID_ARG)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid face");
+    }
+    if (err == ESP_ERR_NOT_FOUND)
+    {
+        return httpd_resp_send_404(req);
+    }
+    if (err != ESP_OK)
+    {
+        return httpd_resp_send_500(req);
+    }
+    // the change is queued, the list may still show the old state
+    return faces_get_handler(req);
+}
+
+httpd_uri_t _faces_get_handler = {
+    .uri       = "/faces",
+    .method    = HTTP_GET,
+    .handler   = faces_get_handler,
+    .user_ctx  = NULL
+};
+
+httpd_uri_t _faces_post_handler = {
+    .uri       = "/faces",
+    .method    = HTTP_POST,
+    .handler   = faces_post_handler,
+    .user_ctx  = NULL
+};
+#endif
+
+static esp_err_t metrics_write(void *arg, const char *buf, size_t len)
+{
+    return httpd_resp_send_chunk((httpd_req_t *)arg, buf, len);
+}
+
+#ifdef CONFIG_APP_RECOGNITION
+static esp_err_t faces_export_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=faces.bin");
+    esp_err_t res = app_face_store_export(metrics_write, req);
+    if (res == ESP_OK)
+    {
+        res = httpd_resp_send_chunk(req, NULL, 0);
+    }
+    return res;
+}
+
+static esp_err_t faces_import_handler(httpd_req_t *req)
+{
+    char buf[1024];
+    size_t left = req->content_len;
+
+    esp_err_t err = app_face_store_import_begin();
+    if (err == ESP_ERR_INVALID_STATE)
+    {
+        httpd_resp_set_status(req, "409 Conflict");
+        return httpd_resp_send(req, NULL, 0);
+    }
+    if (err != ESP_OK)
+    {
+        return httpd_resp_send_500(req);
+    }
+    // written to flash as it arrives, the export is never held in RAM
+    while (left > 0 && err == ESP_OK)
+    {
+        int ret = httpd_req_recv(req, buf, left < sizeof(buf) ? left : sizeof(buf));
+        if (ret <= 0)
+        {
+            app_face_store_import_end(false);
+            return ESP_FAIL;
+        }
+        left -= ret;
+        err = app_face_store_import_write((const uint8_t *)buf, ret);
+    }
+    esp_err_t end = app_face_store_import_end(err == ESP_OK);
+    err = err == ESP_OK ? end : err;
+    if (err == ESP_ERR_INVALID_ARG || err == ESP_ERR_INVALID_VERSION || err == ESP_ERR_INVALID_SIZE)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid face export");
+    }
+    if (err != ESP_OK)
+    {
+        return httpd_resp_send_500(req);
+    }
+    return faces_get_handler(req);
+}
+
+httpd_uri_t _faces_export_handler = {
+    .uri       = "/faces/export",
+    .method    = HTTP_GET,
+    .handler   = faces_export_handler,
+    .user_ctx  = NULL
+};
+
+httpd_uri_t _faces_import_handler = {
+    .uri       = "/faces/import",
+    .method    = HTTP_POST,
+    .handler   = faces_import_handler,
+    .user_ctx  = NULL
+};
+
+static esp_err_t faces_changes_get_handler(httpd_req_t *req)
+{
+    char query[32], value[12], last[12];
+    uint32_t since = 0;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK
+    && httpd_query_key_value(query, "since", value, sizeof(value)) == ESP_OK)
+    {
+        since = strtoul(value, NULL, 10);
+    }
+    snprintf(last, sizeof(last), "%u", app_face_store_last_change());
+    httpd_resp_set_hdr(req, "X-Face-Change", last);
+    httpd_resp_set_type(req, "application/octet-stream");
+    esp_err_t res = app_face_store_changes(since, metrics_write, req);
+    if (res == ESP_ERR_NOT_FOUND)
+    {
+        // the peer has to start over from /faces/export
+        httpd_resp_set_status(req, "410 Gone");
+        return httpd_resp_send(req, NULL, 0);
+    }
+    if (res == ESP_OK)
+    {
+        res = httpd_resp_send_chunk(req, NULL, 0);
+    }
+    return res;
+}
+
+static esp_err_t faces_changes_post_handler(httpd_req_t *req)
+{
+    char buf[1024];
+    size_t left = req->content_len;
+
+    esp_err_t err = app_face_store_apply_begin();
+    if (err == ESP_ERR_INVALID_STATE)
+    {
+        httpd_resp_set_status(req, "409 Conflict");
+        return httpd_resp_send(req, NULL, 0);
+    }
+    if (err != ESP_OK)
+    {
+        return httpd_resp_send_500(req);
+    }
+    while (left > 0 && err == ESP_OK)
+    {
+        int ret = httpd_req_recv(req, buf, left < sizeof(buf) ? left : sizeof(buf));
+        if (ret <= 0)
+        {
+            app_face_store_apply_end(false);
+            return ESP_FAIL;
+        }
+        left -= ret;
+        err = app_face_store_apply_write((const uint8_t *)buf, ret);
+    }
+    esp_err_t end = app_face_store_apply_end(err == ESP_OK);
+    err = err == ESP_OK ? end : err;
+    if (err == ESP_ERR_INVALID_ARG || err == ESP_ERR_INVALID_VERSION || err == ESP_ERR_INVALID_SIZE)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid face delta");
+    }
+    if (err != ESP_OK)
+    {
+        return httpd_resp_send_500(req);
+    }
+    return faces_get_handler(req);
+}
+
+httpd_uri_t _faces_changes_get_handler = {
+    .uri       = "/faces/changes",
+    .method    = HTTP_GET,
+    .handler   = faces_changes_get_handler,
+    .user_ctx  = NULL
+};
+
+httpd_uri_t _faces_changes_post_handler = {
+    .uri       = "/faces/changes",
+    .method    = HTTP_POST,
+    .handler   = faces_changes_post_handler,
+    .user_ctx  = NULL
+};
+#endif
+
+#ifdef CONFIG_ENROLL_UPLOAD
+/* One or more JPEGs back to back, enrolled as one face, ?name= names it */
+static esp_err_t enroll_upload_handler(httpd_req_t *req)
+{
+    char query[64], name[FACE_NAME_MAX] = "";
+    size_t len = req->content_len;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK
+    && httpd_query_key_value(query, "name", name, sizeof(name)) == ESP_ERR_HTTPD_RESULT_TRUNC)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Name too long");
+    }
+    if (len == 0 || len > CONFIG_ENROLL_UPLOAD_MAX_KB * 1024)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Body too large");
+    }
+    uint8_t *buf = (uint8_t *)app_mem_alloc(APP_MEM_ENROLL_UPLOAD, len);
+    if (!buf)
+    {
+        return httpd_resp_send_500(req);
+    }
+    for (size_t got = 0; got < len; )
+    {
+        int ret = httpd_req_recv(req, (char *)buf + got, len - got);
+        if (ret <= 0)
+        {
+            app_mem_free(APP_MEM_ENROLL_UPLOAD, buf, len);
+            return ESP_FAIL;
+        }
+        got += ret;
+    }
+
+    // the enrollment task owns the buffer now, the face shows up in /faces when it is done
+    esp_err_t err = app_enroll_upload(buf, len, name);
+    if (err == ESP_ERR_INVALID_STATE)
+    {
+        httpd_resp_set_status(req, "409 Conflict");
+        return httpd_resp_send(req, NULL, 0);
+    }
+    if (err != ESP_OK)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JPEG");
+    }
+    httpd_resp_set_status(req, "202 Accepted");
+    return httpd_resp_send(req, NULL, 0);
+}
+
+httpd_uri_t _enroll_upload_handler = {
+    .uri       = "/enroll",
+    .method    = HTTP_POST,
+    .handler   = enroll_upload_handler,
+    .user_ctx  = NULL
+};
+#endif
+
+static esp_err_t metrics_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    TRACE_BEGIN(TRACE_HTTPD, httpd_req_to_sockfd(req));
+    esp_err_t res = app_metrics_write(metrics_write, req);
+    TRACE_END(TRACE_HTTPD, httpd_req_to_sockfd(req));
+    if (res == ESP_OK)
+    {
+        res = httpd_resp_send_chunk(req, NULL, 0);
+    }
+    return res;
+}
+
+static esp_err_t memory_handler(httpd_req_t *req)
+{
+    char *json = app_mem_to_json();
+    if (!json)
+    {
+        return httpd_resp_send_500(req);
+    }
+    httpd_resp_set_type(req, HTTPD_TYPE_JSON);
+    esp_err_t res = httpd_resp_send(req, json, strlen(json));
+    free(json);
+    return res;
+}
+
+httpd_uri_t _memory_handler = {
+    .uri       = "/memory",
+    .method    = HTTP_GET,
+    .handler   = memory_handler,
+    .user_ctx  = NULL
+};
 
-#define ENROLL_CONFIRM_TIMES    3
-#define FACE_ID_SAVE_NUMBER     10
+httpd_uri_t _metrics_handler = {
+    .uri       = "/metrics",
+    .method    = HTTP_GET,
+    .handler   = metrics_handler,
+    .user_ctx  = NULL
+};
 
-#define PART_BOUNDARY "123456789000000000000987654321"
-static const char* _STREAM_CONTENT_TYPE = "multipart/x-mixed-replace;boundary=" PART_BOUNDARY;
-static const char* _STREAM_BOUNDARY = "\r\n--" PART_BOUNDARY "\r\n";
-static const char* _STREAM_PART = "Content-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n";
+#if defined(CONFIG_SPEECH_CAPTURE) || defined(CONFIG_PIPELINE_BENCH) || defined(CONFIG_PERF_SUITE)
+typedef struct {
+    httpd_req_t *req;
+    size_t left;
+} request_body_t;
 
-face_id_list st_face_list = {0};
+static int request_body_read(void *arg, void *buf, size_t len)
+{
+    request_body_t *body = (request_body_t *)arg;
 
-dl_matrix3du_t *aligned_face = NULL;
+    if (body->left == 0)
+    {
+        return 0;
+    }
+    int ret = httpd_req_recv(body->req, buf, len < body->left ? len : body->left);
+    if (ret <= 0)
+    {
+        return -1;
+    }
+    body->left -= ret;
+    return ret;
+}
+#endif
 
-static void oneshot_timer_callback(void* arg);
+#ifdef CONFIG_SPEECH_CAPTURE
+#define SPEECH_CAPTURE_MAX_S    60
 
-const char *number_suffix(int32_t number)
+static esp_err_t speech_capture_handler(httpd_req_t *req)
 {
-    uint8_t n = number % 10;
+    char query[32];
+    char value[8];
+    int seconds = 10;
+    uint8_t buf[1024];
 
-    if (n == 0)
-        return "zero";
-    else if (n == 1)
-        return "st";
-    else if (n == 2)
-        return "nd";
-    else if (n == 3)
-        return "rd";
-    else
-        return "th";
-}
-
-static void rgb_print(dl_matrix3du_t *image_matrix, uint32_t color, const char * str){
-    fb_data_t fb;
-    fb.width = image_matrix->w;
-    fb.height = image_matrix->h;
-    fb.data = image_matrix->item;
-    fb.bytes_per_pixel = 3;
-    fb.format = FB_BGR888;
-    fb_gfx_print(&fb, (fb.width - (strlen(str) * 14)) / 2, 10, color, str);
-}
-
-static int rgb_printf(dl_matrix3du_t *image_matrix, uint32_t color, const char *format, ...)
-{
-    char loc_buf[64];
-    char * temp = loc_buf;
-    int len;
-    va_list arg;
-    va_list copy;
-    va_start(arg, format);
-    va_copy(copy, arg);
-    len = vsnprintf(loc_buf, sizeof(loc_buf), format, arg);
-    va_end(copy);
-    if(len >= sizeof(loc_buf)){
-        temp = (char*)malloc(len+1);
-        if(temp == NULL) {
-            return 0;
-        }
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK
+    && httpd_query_key_value(query, "seconds", value, sizeof(value)) == ESP_OK)
+    {
+        seconds = atoi(value);
     }
-    vsnprintf(temp, len+1, format, arg);
-    va_end(arg);
-    rgb_print(image_matrix, color, temp);
-    if(len > 64){
-        free(temp);
-    }
-    return len;
-}
-
-static void draw_face_boxes(dl_matrix3du_t *image_matrix, box_array_t *boxes){
-    int x, y, w, h, i;
-    uint32_t color = FACE_COLOR_YELLOW;
-    fb_data_t fb;
-    fb.width = image_matrix->w;
-    fb.height = image_matrix->h;
-    fb.data = image_matrix->item;
-    fb.bytes_per_pixel = 3;
-    fb.format = FB_BGR888;
-    for (i = 0; i < boxes->len; i++){
-        // rectangle box
-        x = (int)boxes->box[i].box_p[0];
-        y = (int)boxes->box[i].box_p[1];
-        w = (int)boxes->box[i].box_p[2] - x + 1;
-        h = (int)boxes->box[i].box_p[3] - y + 1;
-        fb_gfx_drawFastHLine(&fb, x, y, w, color);
-        fb_gfx_drawFastHLine(&fb, x, y+h-1, w, color);
-        fb_gfx_drawFastVLine(&fb, x, y, h, color);
-        fb_gfx_drawFastVLine(&fb, x+w-1, y, h, color);
-#if 0
-        // landmark
-        int x0, y0, j;
-        for (j = 0; j < 10; j+=2) {
-            x0 = (int)boxes->landmark[i].landmark_p[j];
-            y0 = (int)boxes->landmark[i].landmark_p[j+1];
-            fb_gfx_fillRect(&fb, x0, y0, 3, 3, color);
+    if (seconds < 1 || seconds > SPEECH_CAPTURE_MAX_S)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "seconds out of range");
+    }
+    if (app_speech_capture_start() != ESP_OK)
+    {
+        return httpd_resp_send_500(req);
+    }
+
+    // the server serves nothing else until the capture is done
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "X-Audio-Format", "s16le; rate=16000; channels=1");
+    size_t left = seconds * 16000 * sizeof(int16_t);
+    esp_err_t res = ESP_OK;
+    while (left > 0 && res == ESP_OK)
+    {
+        // nothing comes while the recorder is paused for streaming
+        size_t len = app_speech_capture_read(buf, left < sizeof(buf) ? left : sizeof(buf), 1000 / portTICK_PERIOD_MS);
+        if (len == 0)
+        {
+            break;
         }
-#endif
+        res = httpd_resp_send_chunk(req, (const char *)buf, len);
+        left -= len;
+    }
+    app_speech_capture_stop();
+    if (res == ESP_OK)
+    {
+        res = httpd_resp_send_chunk(req, NULL, 0);
     }
+    return res;
 }
 
-esp_err_t facenet_stream_handler(httpd_req_t *req)
+httpd_uri_t _speech_capture_handler = {
+    .uri       = "/speech/capture",
+    .method    = HTTP_GET,
+    .handler   = speech_capture_handler,
+    .user_ctx  = NULL
+};
+
+static esp_err_t speech_replay_handler(httpd_req_t *req)
 {
-    esp_err_t res = ESP_OK;
-    if (g_state != WAIT_FOR_CONNECT)
+    speech_replay_t result;
+    request_body_t body = { .req = req, .left = req->content_len };
+
+    // the body is raw PCM of any length, it goes to the model as it arrives
+    esp_err_t err = app_speech_replay(request_body_read, &body, &result);
+    if (err == ESP_ERR_NO_MEM)
+    {
+        return httpd_resp_send_500(req);
+    }
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    char *json = app_speech_replay_to_json(&result);
+    if (!json)
+    {
+        return httpd_resp_send_500(req);
+    }
+    httpd_resp_set_type(req, HTTPD_TYPE_JSON);
+    esp_err_t res = httpd_resp_send(req, json, strlen(json));
+    free(json);
+    return res;
+}
+
+httpd_uri_t _speech_replay_handler = {
+    .uri       = "/speech/replay",
+    .method    = HTTP_POST,
+    .handler   = speech_replay_handler,
+    .user_ctx  = NULL
+};
+#endif
+
+#ifdef CONFIG_PIPELINE_BENCH
+static esp_err_t bench_handler(httpd_req_t *req)
+{
+    bench_result_t result;
+    request_body_t body = { .req = req, .left = req->content_len };
+
+    // frames are replayed as they arrive, the recording can be larger than the memory
+    esp_err_t err = app_bench_run(request_body_read, &body, &result);
+    if (err == ESP_ERR_INVALID_STATE)
+    {
+        httpd_resp_set_status(req, "409 Conflict");
+        return httpd_resp_send(req, NULL, 0);
+    }
+    if (err == ESP_ERR_NO_MEM)
+    {
+        return httpd_resp_send_500(req);
+    }
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    char *json = app_bench_to_json(&result);
+    if (!json)
     {
-        res = httpd_resp_send_404(req);
-        return res;
+        return httpd_resp_send_500(req);
     }
-    g_state = START_DETECT;
+    httpd_resp_set_type(req, HTTPD_TYPE_JSON);
+    esp_err_t res = httpd_resp_send(req, json, strlen(json));
+    free(json);
+    return res;
+}
+
+httpd_uri_t _bench_handler = {
+    .uri       = "/bench",
+    .method    = HTTP_POST,
+    .handler   = bench_handler,
+    .user_ctx  = NULL
+};
+
+static esp_err_t bench_kernels_handler(httpd_req_t *req)
+{
+    bench_kernel_result_t results[BENCH_KERNEL_MAX];
 
-    camera_fb_t * fb = NULL;
-    size_t _jpg_buf_len = 0;
-    uint8_t * _jpg_buf = NULL;
-    char * part_buf[64];
-    dl_matrix3du_t *image_matrix = NULL;
+    if (app_bench_kernels(results) != ESP_OK)
+    {
+        return httpd_resp_send_500(req);
+    }
+    char *json = app_bench_kernels_to_json(results);
+    if (!json)
+    {
+        return httpd_resp_send_500(req);
+    }
+    httpd_resp_set_type(req, HTTPD_TYPE_JSON);
+    esp_err_t res = httpd_resp_send(req, json, strlen(json));
+    free(json);
+    return res;
+}
 
-    int face_id = -1;
+httpd_uri_t _bench_kernels_handler = {
+    .uri       = "/bench/kernels",
+    .method    = HTTP_GET,
+    .handler   = bench_kernels_handler,
+    .user_ctx  = NULL
+};
+#endif
 
-    int64_t fr_start = 0;
-    int64_t fr_ready = 0;
-    int64_t fr_face = 0;
-    int64_t fr_recognize = 0;
-    int64_t fr_encode = 0;
+#ifdef CONFIG_DELTA_OTA
+static esp_err_t ota_get_handler(httpd_req_t *req)
+{
+    char *json = app_ota_to_json();
+    if (!json)
+    {
+        return httpd_resp_send_500(req);
+    }
+    httpd_resp_set_type(req, HTTPD_TYPE_JSON);
+    esp_err_t res = httpd_resp_send(req, json, strlen(json));
+    free(json);
+    return res;
+}
 
-    mtmn_config_t mtmn_config = mtmn_init_config();
+/* The body is the URL of the patch, progress shows on GET /ota */
+static esp_err_t ota_post_handler(httpd_req_t *req)
+{
+    char buf[HTTPD_BODY_MAX + 1];
 
-    static int64_t last_frame = 0;
-    if(!last_frame) {
-        last_frame = esp_timer_get_time();
+    esp_err_t err = recv_body(req, buf);
+    if (err != ESP_OK)
+    {
+        return err == ESP_ERR_INVALID_SIZE ? ESP_OK : err;
+    }
+    buf[strcspn(buf, "\r\n")] = 0;
+    err = app_ota_start(buf);
+    if (err == ESP_ERR_INVALID_STATE)
+    {
+        httpd_resp_set_status(req, "409 Conflict");
+        return httpd_resp_send(req, NULL, 0);
     }
+    if (err == ESP_ERR_NOT_SUPPORTED)
+    {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No second app slot");
+    }
+    if (err != ESP_OK)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid URL");
+    }
+    httpd_resp_set_status(req, "202 Accepted");
+    return ota_get_handler(req);
+}
+
+httpd_uri_t _ota_get_handler = {
+    .uri       = "/ota",
+    .method    = HTTP_GET,
+    .handler   = ota_get_handler,
+    .user_ctx  = NULL
+};
+
+httpd_uri_t _ota_post_handler = {
+    .uri       = "/ota",
+    .method    = HTTP_POST,
+    .handler   = ota_post_handler,
+    .user_ctx  = NULL
+};
+#endif
 
-    res = httpd_resp_set_type(req, _STREAM_CONTENT_TYPE);
-    if(res != ESP_OK){
-        return res;
+#ifdef CONFIG_FRAME_SOURCE
+static esp_err_t source_get_handler(httpd_req_t *req)
+{
+    char *json = app_frame_source_to_json();
+    if (!json)
+    {
+        return httpd_resp_send_500(req);
     }
+    httpd_resp_set_type(req, HTTPD_TYPE_JSON);
+    esp_err_t res = httpd_resp_send(req, json, strlen(json));
+    free(json);
+    return res;
+}
 
-    ESP_LOGI(TAG, "Get count %d\n", st_face_list.count);
+/* ?name=camera, colorbar or corpus */
+static esp_err_t source_post_handler(httpd_req_t *req)
+{
+    char query[32];
+    char name[16];
+    int source = FRAME_SOURCE_MAX;
 
-    while(true)
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK
+    && httpd_query_key_value(query, "name", name, sizeof(name)) == ESP_OK)
     {
-        // update fsm state
-        if (g_is_enrolling)
+        for (source = 0; source < FRAME_SOURCE_MAX; source++)
         {
-            g_state = START_ENROLL;
+            if (!strcmp(name, app_frame_source_name(source)))
+            {
+                break;
+            }
         }
-        else if (g_is_deleting)
+    }
+    if (source == FRAME_SOURCE_MAX)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown source");
+    }
+    if (app_frame_source_select(source) != ESP_OK)
+    {
+        httpd_resp_set_status(req, "409 Conflict");
+        return httpd_resp_send(req, NULL, 0);
+    }
+    return source_get_handler(req);
+}
+
+/* Concatenated JPEGs or a saved /stream response, kept in PSRAM */
+static esp_err_t source_corpus_handler(httpd_req_t *req)
+{
+    size_t len = req->content_len;
+
+    if (len == 0 || len > CONFIG_FRAME_SOURCE_CORPUS_KB * 1024)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Body too large");
+    }
+    uint8_t *buf = (uint8_t *)app_mem_alloc(APP_MEM_FRAME_CORPUS, len);
+    if (!buf)
+    {
+        return httpd_resp_send_500(req);
+    }
+    for (size_t got = 0; got < len; )
+    {
+        int ret = httpd_req_recv(req, (char *)buf + got, len - got);
+        if (ret <= 0)
         {
-            g_is_deleting = 0;
-            g_state = START_DELETE;
+            app_mem_free(APP_MEM_FRAME_CORPUS, buf, len);
+            return ESP_FAIL;
         }
-        else if (g_state != START_ENROLL)
+        got += ret;
+    }
+
+    esp_err_t err = app_frame_source_load(buf, len);
+    if (err == ESP_ERR_INVALID_STATE)
+    {
+        httpd_resp_set_status(req, "409 Conflict");
+        return httpd_resp_send(req, NULL, 0);
+    }
+    if (err != ESP_OK)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "No JPEG found");
+    }
+    return source_get_handler(req);
+}
+
+httpd_uri_t _source_get_handler = {
+    .uri       = "/source",
+    .method    = HTTP_GET,
+    .handler   = source_get_handler,
+    .user_ctx  = NULL
+};
+
+httpd_uri_t _source_post_handler = {
+    .uri       = "/source",
+    .method    = HTTP_POST,
+    .handler   = source_post_handler,
+    .user_ctx  = NULL
+};
+
+httpd_uri_t _source_corpus_handler = {
+    .uri       = "/source/corpus",
+    .method    = HTTP_POST,
+    .handler   = source_corpus_handler,
+    .user_ctx  = NULL
+};
+#endif
+
+#ifdef CONFIG_DISPLAY_BENCH
+static esp_err_t display_bench_handler(httpd_req_t *req)
+{
+    static const uint32_t clocks[] = { 400000, 1000000 };
+    display_bench_result_t results[sizeof(clocks) / sizeof(clocks[0])];
+    int count = 0;
+    char query[32];
+    char value[12];
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK
+    && httpd_query_key_value(query, "clock", value, sizeof(value)) == ESP_OK)
+    {
+        uint32_t clock = strtoul(value, NULL, 10);
+        if (clock < 100000 || clock > 1000000)
         {
-            if (st_face_list.count == 0)
-                g_state = START_DETECT;
-            else
-                g_state = START_RECOGNITION;
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "clock out of range");
         }
-        
-        ESP_LOGD(TAG, "State: %d, head:%d, tail:%d, count:%d", g_state, st_face_list.head, st_face_list.tail, st_face_list.count);
-        // exec event
-        if (g_state == START_DELETE)
+        if (app_display_bench_run(clock, &results[count]) == ESP_OK)
         {
-            uint8_t left = delete_face_id_in_flash(&st_face_list);
-            ESP_LOGW(TAG, "%d ID Left", left);
-            g_state = START_DETECT;
-            continue;
+            count++;
         }
-
-        // Detection Start
-        fb = esp_camera_fb_get();
-        if (!fb)
+    }
+    else
+    {
+        for (int i = 0; i < sizeof(clocks) / sizeof(clocks[0]); i++)
         {
-            ESP_LOGE(TAG, "Camera capture failed");
-            res = ESP_FAIL;
-            break;
+            if (app_display_bench_run(clocks[i], &results[count]) == ESP_OK)
+            {
+                count++;
+            }
         }
+    }
+    if (count == 0)
+    {
+        return httpd_resp_send_500(req);
+    }
 
-        fr_start = esp_timer_get_time();
-        fr_ready = fr_start;
-        fr_face = fr_start;
-        fr_encode = fr_start;
-        fr_recognize = fr_start;
-        image_matrix = dl_matrix3du_alloc(1, fb->width, fb->height, 3);
-        if (!image_matrix)
-        {
-            ESP_LOGE(TAG, "dl_matrix3du_alloc failed");
-            res = ESP_FAIL;
-            break;
-        }
+    char *json = app_display_bench_to_json(results, count);
+    if (!json)
+    {
+        return httpd_resp_send_500(req);
+    }
+    httpd_resp_set_type(req, HTTPD_TYPE_JSON);
+    esp_err_t res = httpd_resp_send(req, json, strlen(json));
+    free(json);
+    return res;
+}
 
-        if(!fmt2rgb888(fb->buf, fb->len, fb->format, image_matrix->item))
-        {
-            ESP_LOGW(TAG, "fmt2rgb888 failed");
-            //res = ESP_FAIL;
-            //dl_matrix3du_free(image_matrix);
-            //break;
-        }
+httpd_uri_t _display_bench_handler = {
+    .uri       = "/display/bench",
+    .method    = HTTP_POST,
+    .handler   = display_bench_handler,
+    .user_ctx  = NULL
+};
+#endif
 
-        fr_ready = esp_timer_get_time();
-        box_array_t *net_boxes = face_detect(image_matrix, &mtmn_config);
-        fr_face = esp_timer_get_time();
-        // Detection End
+#ifdef CONFIG_PERF_SUITE
+/* The body is optional audio for the wake word part, as for /speech/replay */
+static esp_err_t perf_handler(httpd_req_t *req)
+{
+    perf_result_t result;
+    request_body_t body = { .req = req, .left = req->content_len };
 
-        fr_recognize = fr_face;
-        if (net_boxes)
-        {
-            if ((g_state == START_ENROLL || g_state == START_RECOGNITION)
-            && (align_face(net_boxes, image_matrix, aligned_face) == ESP_OK))
-            {
-                if (g_state == START_ENROLL)
-                {
-                    rgb_print(image_matrix, FACE_COLOR_YELLOW, "START ENROLLING");
-                    ESP_LOGD(TAG, "START ENROLLING");
-
-                    int left_sample_face = enroll_face_id_to_flash(&st_face_list, aligned_face);
-                    ESP_LOGD(TAG, "Face ID %d Enrollment: Taken the %d%s sample",
-                            st_face_list.tail,
-                            ENROLL_CONFIRM_TIMES - left_sample_face,
-                            number_suffix(ENROLL_CONFIRM_TIMES - left_sample_face));
-                    // gpio_set_level(GPIO_LED_RED, 0);
-                    rgb_printf(image_matrix, FACE_COLOR_CYAN, "\nThe %u%s sample",
-                            ENROLL_CONFIRM_TIMES - left_sample_face,
-                            number_suffix(ENROLL_CONFIRM_TIMES - left_sample_face));
-
-                    if (left_sample_face == 0)
-                    {
-                        ESP_LOGI(TAG, "Enrolled Face ID: %d", st_face_list.tail);
-                        rgb_printf(image_matrix, FACE_COLOR_CYAN, "\n\nEnrolled Face ID: %d", st_face_list.tail);
-                        g_is_enrolling = 0;
-                        g_state = START_RECOGNITION;
-                    }
-                }
-                else
-                {
-                    face_id = recognize_face(&st_face_list, aligned_face);
-
-                    if (face_id >= 0)
-                    {
-                        // gpio_set_level(GPIO_LED_RED, 1);
-                        rgb_printf(image_matrix, FACE_COLOR_GREEN, "Hello ID %u", face_id);
-                    }
-                    else
-                    {
-                        rgb_print(image_matrix, FACE_COLOR_RED, "\nWHO?");
-                    }
-                }
-            }
+    // a failed part shows in the report, the caller decides what it means
+    app_perf_run(body.left ? request_body_read : NULL, &body, &result);
+    char *json = app_perf_to_json(&result);
+    if (!json)
+    {
+        return httpd_resp_send_500(req);
+    }
+    httpd_resp_set_type(req, HTTPD_TYPE_JSON);
+    esp_err_t res = httpd_resp_send(req, json, strlen(json));
+    free(json);
+    return res;
+}
 
-            draw_face_boxes(image_matrix, net_boxes);
-            free(net_boxes->box);
-            free(net_boxes->landmark);
-            free(net_boxes);
+httpd_uri_t _perf_handler = {
+    .uri       = "/perf",
+    .method    = HTTP_POST,
+    .handler   = perf_handler,
+    .user_ctx  = NULL
+};
+#endif
 
-            fr_recognize = esp_timer_get_time();
-            if(!fmt2jpg(image_matrix->item, fb->width*fb->height*3, fb->width, fb->height, PIXFORMAT_RGB888, 90, &_jpg_buf, &_jpg_buf_len))
-            {
-                ESP_LOGE(TAG, "fmt2jpg failed");
-                dl_matrix3du_free(image_matrix);
-                res = ESP_FAIL;
-            }
-            esp_camera_fb_return(fb);
-            fb = NULL;
-        }
-        else
+#ifdef CONFIG_SOAK_TEST
+static esp_err_t soak_handler(httpd_req_t *req)
+{
+    char *json = app_soak_to_json();
+    if (!json)
+    {
+        return httpd_resp_send_500(req);
+    }
+    httpd_resp_set_type(req, HTTPD_TYPE_JSON);
+    esp_err_t res = httpd_resp_send(req, json, strlen(json));
+    free(json);
+    return res;
+}
+
+httpd_uri_t _soak_handler = {
+    .uri       = "/soak",
+    .method    = HTTP_GET,
+    .handler   = soak_handler,
+    .user_ctx  = NULL
+};
+#endif
+
+#ifdef CONFIG_TRACE
+static esp_err_t trace_handler(httpd_req_t *req)
+{
+    char query[16];
+    char value[4];
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK
+    && httpd_query_key_value(query, "on", value, sizeof(value)) == ESP_OK)
+    {
+        bool on = atoi(value) != 0;
+        if (app_tracer_enable(on) != ESP_OK)
         {
-            _jpg_buf = fb->buf;
-            _jpg_buf_len = fb->len;
+            return httpd_resp_send_500(req);
         }
-        dl_matrix3du_free(image_matrix);
-        fr_encode = esp_timer_get_time();
+        const char *json = on ? "{\"tracing\":true}" : "{\"tracing\":false}";
+        httpd_resp_set_type(req, HTTPD_TYPE_JSON);
+        return httpd_resp_send(req, json, strlen(json));
+    }
 
+    httpd_resp_set_type(req, HTTPD_TYPE_JSON);
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=trace.json");
+    esp_err_t res = app_tracer_write_json(metrics_write, req);
+    if (res == ESP_OK)
+    {
+        res = httpd_resp_send_chunk(req, NULL, 0);
+    }
+    return res;
+}
 
-        if(res == ESP_OK){
-            size_t hlen = snprintf((char *)part_buf, 64, _STREAM_PART, _jpg_buf_len);
-            res = httpd_resp_send_chunk(req, (const char *)part_buf, hlen);
-        }
-        if(res == ESP_OK){
-            res = httpd_resp_send_chunk(req, (const char *)_jpg_buf, _jpg_buf_len);
-        }
-        if(res == ESP_OK){
-            res = httpd_resp_send_chunk(req, _STREAM_BOUNDARY, strlen(_STREAM_BOUNDARY));
-        }
-        if(fb){
-            esp_camera_fb_return(fb);
-            fb = NULL;
-            _jpg_buf = NULL;
-        } else if(_jpg_buf){
-            free(_jpg_buf);
-            _jpg_buf = NULL;
-        }
-        if(res != ESP_OK){
-            break;
-        }
-        int64_t fr_end = esp_timer_get_time();
+httpd_uri_t _trace_handler = {
+    .uri       = "/trace",
+    .method    = HTTP_GET,
+    .handler   = trace_handler,
+    .user_ctx  = NULL
+};
+#endif
 
-        int64_t ready_time = (fr_ready - fr_start)/1000;
-        int64_t face_time = (fr_face - fr_ready)/1000;
-        int64_t recognize_time = (fr_recognize - fr_face)/1000;
-        int64_t encode_time = (fr_encode - fr_recognize)/1000;
-        int64_t process_time = (fr_encode - fr_start)/1000;
+#ifdef CONFIG_PROFILER
+static esp_err_t profile_handler(httpd_req_t *req)
+{
+    profiler_stats_t stats;
+    uint32_t seconds = 10;
+    char query[32];
+    char value[12];
+    char samples[12];
+    char dropped[12];
 
-        int64_t frame_time = fr_end - last_frame;
-        last_frame = fr_end;
-        frame_time /= 1000;
-        ESP_LOGD(TAG, "MJPG: %uKB %ums (%.1ffps), %u+%u+%u+%u=%u",
-                (uint32_t)(_jpg_buf_len/1024),
-                (uint32_t)frame_time, 1000.0 / (uint32_t)frame_time,
-                (uint32_t)ready_time, (uint32_t)face_time, (uint32_t)recognize_time, (uint32_t)encode_time, (uint32_t)process_time);
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK
+    && httpd_query_key_value(query, "seconds", value, sizeof(value)) == ESP_OK)
+    {
+        seconds = strtoul(value, NULL, 10);
+    }
+    esp_err_t err = app_profiler_run(seconds, &stats);
+    if (err == ESP_ERR_INVALID_ARG)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "seconds out of range");
+    }
+    if (err != ESP_OK)
+    {
+        return httpd_resp_send_500(req);
     }
 
-    last_frame = 0;
-    g_state = WAIT_FOR_WAKEUP;
-    return ESP_OK;
+    snprintf(samples, sizeof(samples), "%u", stats.samples);
+    snprintf(dropped, sizeof(dropped), "%u", stats.dropped);
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "X-Profile-Samples", samples);
+    httpd_resp_set_hdr(req, "X-Profile-Dropped", dropped);
+    esp_err_t res = app_profiler_write_folded(metrics_write, req);
+    if (res == ESP_OK)
+    {
+        res = httpd_resp_send_chunk(req, NULL, 0);
+    }
+    return res;
 }
 
-httpd_uri_t _face_stream_handler = {
-    .uri       = "/face_stream",
+httpd_uri_t _profile_handler = {
+    .uri       = "/profile",
     .method    = HTTP_GET,
-    .handler   = facenet_stream_handler,
+    .handler   = profile_handler,
+    .user_ctx  = NULL
+};
+#endif
+
+#ifdef CONFIG_RTC_LOG
+static esp_err_t rtclog_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, HTTPD_TYPE_JSON);
+    esp_err_t res = app_rtclog_write_json(metrics_write, req);
+    if (res == ESP_OK)
+    {
+        res = httpd_resp_send_chunk(req, NULL, 0);
+    }
+    return res;
+}
+
+httpd_uri_t _rtclog_handler = {
+    .uri       = "/rtclog",
+    .method    = HTTP_GET,
+    .handler   = rtclog_handler,
     .user_ctx  = NULL
 };
+#endif
 
 httpd_handle_t camera_httpd = NULL;
 
@@ -367,27 +1236,34 @@ esp_timer_handle_t oneshot_timer;
 
 static void oneshot_timer_callback(void* arg)
 {
-    if(g_state != START_ENROLL)
-        g_is_enrolling = 1;
+    app_event_post(APP_EVENT_ENROLL);
 }
 
 
 static void IRAM_ATTR gpio_isr_handler(void* arg)
 {
+    TRACE_INSTANT(TRACE_BUTTON_ISR, 0);
     esp_err_t err = esp_timer_start_once(oneshot_timer, 500000);
     if(err == ESP_ERR_INVALID_STATE)
     {
+        BaseType_t woken = pdFALSE;
         ESP_ERROR_CHECK(esp_timer_stop(oneshot_timer));
-        g_is_enrolling = 0;
-        g_is_deleting = 1;
+        app_event_post_from_isr(APP_EVENT_DELETE, &woken);
+        if (woken)
+            portYIELD_FROM_ISR();
         // gpio_set_level(GPIO_LED_WHITE, 0);
     }
 }
 
 void app_httpserver_init ()
 {
+    const app_task_desc_t *task = app_task_desc(APP_TASK_HTTPD);
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-    config.stack_size = 4096 * 2;
+    config.stack_size = task->stack_size;
+    config.task_priority = task->priority;
+    config.core_id = task->core;
+    config.max_uri_handlers = 35 + WWW_MAX_FILES;
+    config.max_open_sockets = STREAM_MAX_CLIENTS + STREAM_CONTROL_SOCKETS;
 
     ESP_ERROR_CHECK(esp_timer_create(&oneshot_timer_args, &oneshot_timer));
 
@@ -399,13 +1275,117 @@ void app_httpserver_init ()
     gpio_config(&io_conf);
     gpio_isr_handler_add(GPIO_BUTTON, gpio_isr_handler, NULL);
 
-    face_id_init(&st_face_list, FACE_ID_SAVE_NUMBER, ENROLL_CONFIRM_TIMES);
-    aligned_face = dl_matrix3du_alloc(1, FACE_WIDTH, FACE_HEIGHT, 3);
-    read_face_id_from_flash(&st_face_list);
+    app_pipeline_init();
+    ESP_ERROR_CHECK(app_snapshot_init());
+#ifdef CONFIG_EVENT_CLIP
+    if (app_clip_init() != ESP_OK)
+    {
+        ESP_LOGE(TAG, "No memory for event clips");
+    }
+#endif
 
     if (httpd_start(&camera_httpd, &config) == ESP_OK)
     {
+        app_mem_account(APP_MEM_TASK_STACK, APP_MEM_INTERNAL, config.stack_size, true);
+        app_stream_init(camera_httpd);
         httpd_register_uri_handler(camera_httpd, &_face_stream_handler);
+#ifdef CONFIG_FACE_CROPS
+        httpd_register_uri_handler(camera_httpd, &_face_crops_handler);
+#endif
+        httpd_register_uri_handler(camera_httpd, &_status_handler);
+        httpd_register_uri_handler(camera_httpd, &_capture_handler);
+#ifdef CONFIG_EVENT_CLIP
+        httpd_register_uri_handler(camera_httpd, &_clip_handler);
+#endif
+        httpd_register_uri_handler(camera_httpd, &_config_get_handler);
+        httpd_register_uri_handler(camera_httpd, &_config_post_handler);
+        httpd_register_uri_handler(camera_httpd, &_metrics_handler);
+        httpd_register_uri_handler(camera_httpd, &_memory_handler);
+#ifdef CONFIG_APP_RECOGNITION
+        httpd_register_uri_handler(camera_httpd, &_faces_get_handler);
+        httpd_register_uri_handler(camera_httpd, &_faces_post_handler);
+        httpd_register_uri_handler(camera_httpd, &_faces_export_handler);
+        httpd_register_uri_handler(camera_httpd, &_faces_import_handler);
+        httpd_register_uri_handler(camera_httpd, &_faces_changes_get_handler);
+        httpd_register_uri_handler(camera_httpd, &_faces_changes_post_handler);
+#endif
+#ifdef CONFIG_ENROLL_UPLOAD
+        httpd_register_uri_handler(camera_httpd, &_enroll_upload_handler);
+#endif
+        httpd_register_uri_handler(camera_httpd, &_camera_get_handler);
+        httpd_register_uri_handler(camera_httpd, &_camera_post_handler);
+#ifdef CONFIG_CAMERA_TUNE
+        httpd_register_uri_handler(camera_httpd, &_camera_tune_handler);
+#endif
+#ifdef CONFIG_SPEECH_CAPTURE
+        httpd_register_uri_handler(camera_httpd, &_speech_capture_handler);
+        httpd_register_uri_handler(camera_httpd, &_speech_replay_handler);
+#endif
+#ifdef CONFIG_PIPELINE_BENCH
+        httpd_register_uri_handler(camera_httpd, &_bench_handler);
+        httpd_register_uri_handler(camera_httpd, &_bench_kernels_handler);
+#endif
+#ifdef CONFIG_DELTA_OTA
+        httpd_register_uri_handler(camera_httpd, &_ota_get_handler);
+        httpd_register_uri_handler(camera_httpd, &_ota_post_handler);
+#endif
+#ifdef CONFIG_FRAME_SOURCE
+        httpd_register_uri_handler(camera_httpd, &_source_get_handler);
+        httpd_register_uri_handler(camera_httpd, &_source_post_handler);
+        httpd_register_uri_handler(camera_httpd, &_source_corpus_handler);
+#endif
+#ifdef CONFIG_DISPLAY_BENCH
+        httpd_register_uri_handler(camera_httpd, &_display_bench_handler);
+#endif
+#ifdef CONFIG_PERF_SUITE
+        httpd_register_uri_handler(camera_httpd, &_perf_handler);
+#endif
+#ifdef CONFIG_TRACE
+        httpd_register_uri_handler(camera_httpd, &_trace_handler);
+#endif
+#ifdef CONFIG_PROFILER
+        httpd_register_uri_handler(camera_httpd, &_profile_handler);
+#endif
+#ifdef CONFIG_RTC_LOG
+        httpd_register_uri_handler(camera_httpd, &_rtclog_handler);
+#endif
+#ifdef CONFIG_WEB_UI
+        app_www_init(camera_httpd);
+#endif
+#ifdef CONFIG_SOAK_TEST
+        if (app_soak_init() == ESP_OK)
+        {
+            httpd_register_uri_handler(camera_httpd, &_soak_handler);
+        }
+        else
+        {
+            ESP_LOGE(TAG, "Soak test not started");
+        }
+#endif
+    }
+#ifdef CONFIG_FACE_EVENTS
+    if (app_face_event_init() != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Face events not sent");
+    }
+#endif
+#ifdef CONFIG_OFFLOAD_INFERENCE
+    if (app_offload_init() != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Inference offload not started");
+    }
+#endif
+#ifdef CONFIG_RTSP_SERVER
+    if (app_rtsp_init() != ESP_OK)
+    {
+        ESP_LOGE(TAG, "RTSP server not started");
     }
+#endif
+#ifdef CONFIG_WS_CONTROL
+    if (app_ws_init() != ESP_OK)
+    {
+        ESP_LOGE(TAG, "WebSocket server not started");
+    }
+#endif
 }
 
@@ -0,0 +1,692 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_jpg_decode.h"
+#include "img_converters.h"
+#include "app_image.h"
+#ifdef CONFIG_JPEG_DECODE_DUAL_CORE
+#include "rom/tjpgd.h"
+#include "app_tasks.h"
+#endif
+
+static const char *TAG = "app_image";
+
+/* Rows of output per row of MCUs, 16 for 4:2:0 frames at 1/1 */
+#define IMAGE_MCU_ROWS(scale)   (16 / (scale))
+
+typedef struct {
+    const uint8_t *src;
+    size_t len;
+    dl_matrix3du_t *image_matrix;
+    uint8_t *strip;             /* NULL to write blocks straight into the matrix */
+    int strip_rows;             /* the strip holds this many matrix rows */
+    int strip_y;                /* matrix row of the first strip row */
+    int strip_h;                /* rows filled so far, 0 when the strip is empty */
+} image_decoder_t;
+
+static size_t image_jpg_read(void *arg, size_t index, uint8_t *buf, size_t len)
+{
+    image_decoder_t *dec = (image_decoder_t *)arg;
+
+    if (index >= dec->len)
+    {
+        return 0;
+    }
+    if (index + len > dec->len)
+    {
+        len = dec->len - index;
+    }
+    if (buf)
+    {
+        memcpy(buf, dec->src + index, len);
+    }
+    return len;
+}
+
+// a finished row of MCUs goes into the matrix in one piece
+static void image_strip_flush(image_decoder_t *dec)
+{
+    dl_matrix3du_t *m = dec->image_matrix;
+
+    if (dec->strip_h)
+    {
+        memcpy(m->item + dec->strip_y * m->w * 3, dec->strip, dec->strip_h * m->w * 3);
+        dec->strip_h = 0;
+    }
+}
+
+static bool image_rgb_write(void *arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data)
+{
+    image_decoder_t *dec = (image_decoder_t *)arg;
+    dl_matrix3du_t *m = dec->image_matrix;
+    uint8_t *out = m->item;
+    int out_y = y;
+
+    if (!data)
+    {
+        // start and end of the image
+        return true;
+    }
+    if (x + w > m->w || y + h > m->h)
+    {
+        return false;
+    }
+    if (dec->strip && h <= dec->strip_rows)
+    {
+        // blocks come left to right, a new row of MCUs starts a new strip
+        if (dec->strip_h && y != dec->strip_y)
+        {
+            image_strip_flush(dec);
+        }
+        dec->strip_y = y;
+        dec->strip_h = h > dec->strip_h ? h : dec->strip_h;
+        out = dec->strip;
+        out_y = 0;
+    }
+
+    // the decoder outputs RGB, the detector and fb_gfx expect BGR
+    for (int iy = 0; iy < h; iy++)
+    {
+        uint8_t *o = out + ((out_y + iy) * m->w + x) * 3;
+        for (int ix = 0; ix < w * 3; ix += 3)
+        {
+            o[ix] = data[ix + 2];
+            o[ix + 1] = data[ix + 1];
+            o[ix + 2] = data[ix];
+        }
+        data += w * 3;
+    }
+    return true;
+}
+
+/* Samples every scale-th pixel of every scale-th row, only those rows are read from PSRAM */
+static void image_gray_scaled(camera_fb_t *fb, int scale, dl_matrix3du_t *m)
+{
+    for (int y = 0; y < m->h; y++)
+    {
+        const uint8_t *src = fb->buf + y * scale * fb->width;
+        uint8_t *o = m->item + y * m->w * 3;
+        for (int x = 0; x < m->w; x++)
+        {
+            uint8_t luma = src[x * scale];
+            o[0] = luma;
+            o[1] = luma;
+            o[2] = luma;
+            o += 3;
+        }
+    }
+}
+
+/*
+ * Converts and downscales in one pass, no RGB888 frame is made at full size.
+ * Each output pixel is the mean of the 2x2 pixels at the top left of its block,
+ * so two rows in every scale are read from PSRAM. The sensor sends the high
+ * byte first, channels come out in BGR order as from fmt2rgb888.
+ */
+static void image_rgb565_scaled(camera_fb_t *fb, int scale, dl_matrix3du_t *m)
+{
+    size_t stride = fb->width * 2;
+    int taps = scale > 1 ? 2 : 1;
+    int shift = scale > 1 ? 2 : 0;
+
+    for (int y = 0; y < m->h; y++)
+    {
+        const uint8_t *row = fb->buf + y * scale * stride;
+        uint8_t *o = m->item + y * m->w * 3;
+        for (int x = 0; x < m->w; x++)
+        {
+            int b = 0, g = 0, r = 0;
+            for (int dy = 0; dy < taps; dy++)
+            {
+                const uint8_t *p = row + dy * stride + x * scale * 2;
+                for (int dx = 0; dx < taps; dx++, p += 2)
+                {
+                    b += (p[1] & 0x1F) << 3;
+                    g += (p[0] & 0x07) << 5 | (p[1] & 0xE0) >> 3;
+                    r += p[0] & 0xF8;
+                }
+            }
+            o[0] = b >> shift;
+            o[1] = g >> shift;
+            o[2] = r >> shift;
+            o += 3;
+        }
+    }
+}
+
+bool app_image_can_scale(pixformat_t format)
+{
+    return format == PIXFORMAT_JPEG || format == PIXFORMAT_GRAYSCALE || format == PIXFORMAT_RGB565;
+}
+
+size_t app_image_strip_len(size_t width, int scale)
+{
+    return (width / scale) * 3 * IMAGE_MCU_ROWS(scale);
+}
+
+bool app_image_decode_scaled(camera_fb_t *fb, int scale, dl_matrix3du_t *image_matrix)
+{
+    return app_image_decode_strips(fb, scale, image_matrix, NULL, 0);
+}
+
+bool app_image_decode_strips(camera_fb_t *fb, int scale, dl_matrix3du_t *image_matrix, uint8_t *strip, size_t strip_len)
+{
+    jpg_scale_t jpg_scale;
+
+    if (scale == 1)
+    {
+        jpg_scale = JPG_SCALE_NONE;
+    }
+    else if (scale == 2)
+    {
+        jpg_scale = JPG_SCALE_2X;
+    }
+    else if (scale == 4)
+    {
+        jpg_scale = JPG_SCALE_4X;
+    }
+    else if (scale == 8)
+    {
+        jpg_scale = JPG_SCALE_8X;
+    }
+    else
+    {
+        ESP_LOGE(TAG, "Unsupported scale 1/%d", scale);
+        return false;
+    }
+
+    if (!app_image_can_scale(fb->format))
+    {
+        if (scale == 1)
+        {
+            return fmt2rgb888(fb->buf, fb->len, fb->format, image_matrix->item);
+        }
+        ESP_LOGE(TAG, "Scaled decode needs a JPEG, grayscale or RGB565 frame");
+        return false;
+    }
+
+    if (image_matrix->w != fb->width / scale || image_matrix->h != fb->height / scale)
+    {
+        ESP_LOGE(TAG, "Matrix %dx%d does not match %ux%u at 1/%d",
+                image_matrix->w, image_matrix->h, fb->width, fb->height, scale);
+        return false;
+    }
+
+    if (fb->format == PIXFORMAT_GRAYSCALE)
+    {
+        // the detector takes three channels, luma is copied into each
+        image_gray_scaled(fb, scale, image_matrix);
+        return true;
+    }
+    if (fb->format == PIXFORMAT_RGB565)
+    {
+        image_rgb565_scaled(fb, scale, image_matrix);
+        return true;
+    }
+
+    image_decoder_t dec = {
+        .src = fb->buf,
+        .len = fb->len,
+        .image_matrix = image_matrix,
+    };
+    if (strip && strip_len >= app_image_strip_len(fb->width, scale))
+    {
+        dec.strip = strip;
+        dec.strip_rows = strip_len / (image_matrix->w * 3);
+    }
+    bool ok = esp_jpg_decode(fb->len, jpg_scale, image_jpg_read, image_rgb_write, &dec) == ESP_OK;
+    image_strip_flush(&dec);
+    return ok;
+}
+
+#ifdef CONFIG_JPEG_DECODE_DUAL_CORE
+/* Work area tjpgd takes for the tables of a baseline frame, as in esp_jpg_decode */
+#define IMAGE_BAND_WORK         3100
+
+typedef struct {
+    size_t head_len;            /* bytes up to the entropy coded data */
+    size_t height_at;           /* offset of the frame height in the SOF segment */
+    uint16_t width;
+    uint16_t height;
+    uint8_t mcu_width;
+    uint8_t mcu_height;
+    uint16_t restart;           /* MCUs per restart interval, 0 without markers */
+} image_jpeg_info_t;
+
+/* A run of MCU rows, read by tjpgd as a frame of its own */
+typedef struct {
+    const uint8_t *src;
+    size_t head_len;
+    size_t height_at;
+    const uint8_t *data;        /* entropy coded data of the band, no marker at either end */
+    size_t data_len;
+    uint8_t rst_base;           /* restart intervals before the band, mod 8 */
+    uint16_t height;
+    uint16_t y;                 /* matrix row of the first band row */
+    size_t pos;
+    dl_matrix3du_t *matrix;
+    bool ok;
+    uint8_t work[IMAGE_BAND_WORK];
+} image_band_t;
+
+static image_band_t s_bands[2];
+static QueueHandle_t s_band_queue = NULL;
+static SemaphoreHandle_t s_band_done = NULL;
+// the bench may decode while the detect task does, only one of them gets the helper
+static SemaphoreHandle_t s_band_lock = NULL;
+static bool s_band_warned = false;
+
+static bool image_jpeg_parse(const uint8_t *buf, size_t len, image_jpeg_info_t *info)
+{
+    size_t i = 2;
+
+    memset(info, 0, sizeof(*info));
+    if (len < 4 || buf[0] != 0xFF || buf[1] != 0xD8)
+    {
+        return false;
+    }
+    while (i + 4 <= len && buf[i] == 0xFF)
+    {
+        uint8_t marker = buf[i + 1];
+        if (marker == 0xFF)
+        {
+            i++;
+            continue;
+        }
+        size_t seg_len = (buf[i + 2] << 8) | buf[i + 3];
+        const uint8_t *seg = buf + i + 4;
+        if (i + 2 + seg_len > len)
+        {
+            return false;
+        }
+        if (marker == 0xC0 && seg_len >= 11)
+        {
+            info->height_at = i + 5;
+            info->height = (seg[1] << 8) | seg[2];
+            info->width = (seg[3] << 8) | seg[4];
+            // the first component is luma, its sampling sets the MCU size
+            info->mcu_width = 8 * (seg[7] >> 4);
+            info->mcu_height = 8 * (seg[7] & 0x0F);
+        }
+        else if (marker == 0xDD && seg_len >= 4)
+        {
+            info->restart = (seg[0] << 8) | seg[1];
+        }
+        else if (marker == 0xDA)
+        {
+            info->head_len = i + 2 + seg_len;
+            return info->height_at && info->mcu_width && info->mcu_height;
+        }
+        i += 2 + seg_len;
+    }
+    return false;
+}
+
+/* The n-th restart marker of the entropy coded data, counted from 1, NULL past the end of the scan */
+static const uint8_t *image_find_restart(const uint8_t *p, const uint8_t *end, size_t n)
+{
+    while (p + 1 < end)
+    {
+        p = (const uint8_t *)memchr(p, 0xFF, end - p - 1);
+        if (!p)
+        {
+            return NULL;
+        }
+        if ((p[1] & 0xF8) == 0xD0 && --n == 0)
+        {
+            return p;
+        }
+        if (p[1] == 0xD9)
+        {
+            return NULL;
+        }
+        // a fill byte may come before the marker byte
+        p += p[1] == 0xFF ? 1 : 2;
+    }
+    return NULL;
+}
+
+static UINT image_band_read(JDEC *jd, BYTE *buf, UINT len)
+{
+    image_band_t *band = (image_band_t *)jd->device;
+    size_t total = band->head_len + band->data_len;
+    size_t pos = band->pos;
+
+    if (pos >= total)
+    {
+        return 0;
+    }
+    if (len > total - pos)
+    {
+        len = total - pos;
+    }
+    band->pos += len;
+    if (!buf)
+    {
+        return len;
+    }
+
+    size_t n = 0;
+    if (pos < band->head_len)
+    {
+        n = band->head_len - pos < len ? band->head_len - pos : len;
+        memcpy(buf, band->src + pos, n);
+        // the band is only as high as its rows
+        if (band->height_at >= pos && band->height_at < pos + n)
+        {
+            buf[band->height_at - pos] = band->height >> 8;
+        }
+        if (band->height_at + 1 >= pos && band->height_at + 1 < pos + n)
+        {
+            buf[band->height_at + 1 - pos] = band->height & 0xFF;
+        }
+    }
+    if (n < len)
+    {
+        size_t d = pos + n - band->head_len;
+        memcpy(buf + n, band->data + d, len - n);
+        // tjpgd expects the markers of the band to count from RST0
+        for (size_t k = d; band->rst_base && k < d + len - n; k++)
+        {
+            if (k > 0 && band->data[k - 1] == 0xFF && (band->data[k] & 0xF8) == 0xD0)
+            {
+                buf[n + k - d] = 0xD0 | ((band->data[k] - band->rst_base) & 7);
+            }
+        }
+    }
+    return len;
+}
+
+static UINT image_band_write(JDEC *jd, void *bitmap, JRECT *rect)
+{
+    image_band_t *band = (image_band_t *)jd->device;
+    dl_matrix3du_t *m = band->matrix;
+    const uint8_t *data = (const uint8_t *)bitmap;
+    int w = rect->right - rect->left + 1;
+
+    if (rect->right >= m->w || band->y + rect->bottom >= m->h)
+    {
+        return 0;
+    }
+    // the decoder outputs RGB, the detector and fb_gfx expect BGR
+    for (int y = rect->top; y <= rect->bottom; y++)
+    {
+        uint8_t *o = m->item + ((band->y + y) * m->w + rect->left) * 3;
+        for (int ix = 0; ix < w * 3; ix += 3)
+        {
+            o[ix] = data[ix + 2];
+            o[ix + 1] = data[ix + 1];
+            o[ix + 2] = data[ix];
+        }
+        data += w * 3;
+    }
+    return 1;
+}
+
+static bool image_band_decode(image_band_t *band)
+{
+    JDEC jd;
+
+    band->pos = 0;
+    JRESULT res = jd_prepare(&jd, image_band_read, band->work, sizeof(band->work), band);
+    if (res == JDR_OK)
+    {
+        res = jd_decomp(&jd, image_band_write, 0);
+    }
+    return res == JDR_OK;
+}
+
+static void image_band_task(void *arg)
+{
+    image_band_t *band = NULL;
+
+    while (true)
+    {
+        xQueueReceive(s_band_queue, &band, portMAX_DELAY);
+        band->ok = image_band_decode(band);
+        xSemaphoreGive(s_band_done);
+    }
+}
+
+static void image_band_warn(const char *reason)
+{
+    if (!s_band_warned)
+    {
+        ESP_LOGW(TAG, "Sensor JPEG %s, decoding on one core", reason);
+        s_band_warned = true;
+    }
+}
+
+/*
+ * Cuts the frame at the row of MCUs nearest the middle that also starts a
+ * restart interval. The lower band is decoded by the helper task while the
+ * caller decodes the upper one, both straight into the matrix.
+ */
+static bool image_decode_bands(camera_fb_t *fb, dl_matrix3du_t *m)
+{
+    image_jpeg_info_t info;
+
+    if (!image_jpeg_parse(fb->buf, fb->len, &info) || info.width != m->w || info.height != m->h)
+    {
+        return false;
+    }
+    if (!info.restart)
+    {
+        image_band_warn("has no restart markers");
+        return false;
+    }
+    int mcus_x = (info.width + info.mcu_width - 1) / info.mcu_width;
+    int rows = (info.height + info.mcu_height - 1) / info.mcu_height;
+    int cut = 0;
+    for (int d = 0; d < rows && !cut; d++)
+    {
+        // the middle row first, then one above, one below and so on
+        int r = rows / 2 + ((d & 1) ? -(d + 1) / 2 : d / 2);
+        if (r > 0 && r < rows && (r * mcus_x) % info.restart == 0)
+        {
+            cut = r;
+        }
+    }
+    if (!cut)
+    {
+        image_band_warn("has no restart marker between rows");
+        return false;
+    }
+    const uint8_t *end = fb->buf + fb->len;
+    const uint8_t *marker = image_find_restart(fb->buf + info.head_len, end, cut * mcus_x / info.restart);
+    if (!marker)
+    {
+        return false;
+    }
+
+    image_band_t *upper = &s_bands[0];
+    image_band_t *lower = &s_bands[1];
+    for (int i = 0; i < 2; i++)
+    {
+        s_bands[i].src = fb->buf;
+        s_bands[i].head_len = info.head_len;
+        s_bands[i].height_at = info.height_at;
+        s_bands[i].matrix = m;
+    }
+    upper->data = fb->buf + info.head_len;
+    upper->data_len = marker - upper->data;
+    upper->rst_base = 0;
+    upper->y = 0;
+    upper->height = cut * info.mcu_height;
+    lower->data = marker + 2;
+    lower->data_len = end - lower->data;
+    lower->rst_base = (cut * mcus_x / info.restart) & 7;
+    lower->y = upper->height;
+    lower->height = info.height - upper->height;
+
+    xQueueSend(s_band_queue, &lower, portMAX_DELAY);
+    upper->ok = image_band_decode(upper);
+    xSemaphoreTake(s_band_done, portMAX_DELAY);
+    return upper->ok && lower->ok;
+}
+#endif
+
+bool app_image_decode_full(camera_fb_t *fb, dl_matrix3du_t *image_matrix)
+{
+#ifdef CONFIG_JPEG_DECODE_DUAL_CORE
+    if (fb->format == PIXFORMAT_JPEG && s_band_queue && xSemaphoreTake(s_band_lock, 0) == pdTRUE)
+    {
+        bool ok = image_decode_bands(fb, image_matrix);
+        xSemaphoreGive(s_band_lock);
+        if (ok)
+        {
+            return true;
+        }
+    }
+#endif
+    return fmt2rgb888(fb->buf, fb->len, fb->format, image_matrix->item);
+}
+
+void app_image_scale_boxes(box_array_t *boxes, int scale)
+{
+    if (scale == 1)
+    {
+        return;
+    }
+
+    for (int i = 0; i < boxes->len; i++)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            boxes->box[i].box_p[j] *= scale;
+        }
+        if (boxes->landmark)
+        {
+            for (int j = 0; j < 10; j++)
+            {
+                boxes->landmark[i].landmark_p[j] *= scale;
+            }
+        }
+    }
+}
+
+void app_image_crop(const dl_matrix3du_t *src, int scale, const box_t *box, dl_matrix3du_t *dst)
+{
+    int w = (box->box_p[2] - box->box_p[0]) / scale;
+    int h = (box->box_p[3] - box->box_p[1]) / scale;
+    int side = (w > h ? w : h) * 3 / 2;
+    side = side < 1 ? 1 : side;
+    side = side > src->w ? src->w : side;
+    side = side > src->h ? src->h : side;
+
+    int x0 = (box->box_p[0] + box->box_p[2]) / 2 / scale - side / 2;
+    int y0 = (box->box_p[1] + box->box_p[3]) / 2 / scale - side / 2;
+    x0 = x0 < 0 ? 0 : (x0 + side > src->w ? src->w - side : x0);
+    y0 = y0 < 0 ? 0 : (y0 + side > src->h ? src->h - side : y0);
+
+    // nearest neighbour in 16.16 steps
+    uint32_t step_x = ((uint32_t)side << 16) / dst->w;
+    uint32_t step_y = ((uint32_t)side << 16) / dst->h;
+    for (int y = 0; y < dst->h; y++)
+    {
+        const uint8_t *row = src->item + (y0 + ((y * step_y) >> 16)) * src->w * 3;
+        uint8_t *out = dst->item + y * dst->w * 3;
+        uint32_t sx = 0;
+        for (int x = 0; x < dst->w; x++, sx += step_x)
+        {
+            const uint8_t *p = row + (x0 + (sx >> 16)) * 3;
+            out[x * 3] = p[0];
+            out[x * 3 + 1] = p[1];
+            out[x * 3 + 2] = p[2];
+        }
+    }
+}
+
+float app_image_box_iou(const box_t *a, const box_t *b)
+{
+    float x0 = a->box_p[0] > b->box_p[0] ? a->box_p[0] : b->box_p[0];
+    float y0 = a->box_p[1] > b->box_p[1] ? a->box_p[1] : b->box_p[1];
+    float x1 = a->box_p[2] < b->box_p[2] ? a->box_p[2] : b->box_p[2];
+    float y1 = a->box_p[3] < b->box_p[3] ? a->box_p[3] : b->box_p[3];
+
+    if (x1 <= x0 || y1 <= y0)
+    {
+        return 0;
+    }
+
+    float inter = (x1 - x0) * (y1 - y0);
+    float area_a = (a->box_p[2] - a->box_p[0]) * (a->box_p[3] - a->box_p[1]);
+    float area_b = (b->box_p[2] - b->box_p[0]) * (b->box_p[3] - b->box_p[1]);
+    return inter / (area_a + area_b - inter);
+}
+
+bool app_image_jpeg_size(const uint8_t *buf, size_t len, size_t *width, size_t *height)
+{
+    size_t i = 2;
+
+    if (len < 4 || buf[0] != 0xFF || buf[1] != 0xD8)
+    {
+        return false;
+    }
+    while (i + 4 <= len && buf[i] == 0xFF)
+    {
+        uint8_t marker = buf[i + 1];
+        if (marker == 0xFF)
+        {
+            i++;
+            continue;
+        }
+        size_t seg_len = (buf[i + 2] << 8) | buf[i + 3];
+        // any start of frame but DHT, JPG and DAC
+        if ((marker & 0xF0) == 0xC0 && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+        {
+            if (seg_len < 7 || i + 9 > len)
+            {
+                return false;
+            }
+            *height = (buf[i + 5] << 8) | buf[i + 6];
+            *width = (buf[i + 7] << 8) | buf[i + 8];
+            return true;
+        }
+        if (marker == 0xDA)
+        {
+            return false;
+        }
+        i += 2 + seg_len;
+    }
+    return false;
+}
+
+esp_err_t app_image_init()
+{
+#ifdef CONFIG_JPEG_DECODE_DUAL_CORE
+    s_band_queue = xQueueCreate(1, sizeof(image_band_t *));
+    s_band_done = xSemaphoreCreateBinary();
+    s_band_lock = xSemaphoreCreateMutex();
+    if (!s_band_queue || !s_band_done || !s_band_lock)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    return app_task_create(APP_TASK_JPEG_DECODE, &image_band_task, NULL, NULL);
+#else
+    return ESP_OK;
+#endif
+}
@@ -0,0 +1,558 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "app_image_kernel.h"
+
+/* Line buffers are read one pixel past the last column, the weight of that pixel is 0 */
+#define LINE_PAD    3
+
+static inline int image_stride(const image_t *image)
+{
+    return image->stride ? image->stride : image->width * app_image_bpp(image->format);
+}
+
+static inline uint8_t *image_row(const image_t *image, int y)
+{
+    return image->buf + y * image_stride(image);
+}
+
+static uint8_t *image_line_alloc(size_t size)
+{
+    // lines are read many times per output row, keep them out of PSRAM
+    return (uint8_t *)heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+}
+
+static inline void rgb565_to_bgr(const uint8_t *p, uint8_t *o)
+{
+    o[0] = (p[1] & 0x1F) << 3;
+    o[1] = (p[0] & 0x07) << 5 | (p[1] & 0xE0) >> 3;
+    o[2] = p[0] & 0xF8;
+}
+
+static inline void bgr_to_rgb565(const uint8_t *p, uint8_t *o)
+{
+    o[0] = (p[2] & 0xF8) | p[1] >> 5;
+    o[1] = (p[1] & 0x1C) << 3 | p[0] >> 3;
+}
+
+static inline uint8_t bgr_to_luma(const uint8_t *p)
+{
+    // BT.601 weights
+    return (29 * p[0] + 150 * p[1] + 77 * p[2]) >> 8;
+}
+
+/*
+ * Row converters, unrolled by four pixels. The LX6 has no SIMD, the gain is
+ * in fewer loop branches and loads scheduled ahead of the stores.
+ */
+static void row_to_bgr(const uint8_t *src, image_format_t format, int count, uint8_t *out)
+{
+    int i = 0;
+
+    switch (format)
+    {
+    case IMAGE_BGR888:
+        memcpy(out, src, count * 3);
+        break;
+    case IMAGE_RGB565:
+        for (; i + 4 <= count; i += 4, src += 8, out += 12)
+        {
+            rgb565_to_bgr(src, out);
+            rgb565_to_bgr(src + 2, out + 3);
+            rgb565_to_bgr(src + 4, out + 6);
+            rgb565_to_bgr(src + 6, out + 9);
+        }
+        for (; i < count; i++, src += 2, out += 3)
+        {
+            rgb565_to_bgr(src, out);
+        }
+        break;
+    case IMAGE_LUMA:
+        for (; i + 4 <= count; i += 4, src += 4, out += 12)
+        {
+            out[0] = out[1] = out[2] = src[0];
+            out[3] = out[4] = out[5] = src[1];
+            out[6] = out[7] = out[8] = src[2];
+            out[9] = out[10] = out[11] = src[3];
+        }
+        for (; i < count; i++, src++, out += 3)
+        {
+            out[0] = out[1] = out[2] = src[0];
+        }
+        break;
+    }
+}
+
+static void row_from_bgr(const uint8_t *in, int count, image_format_t format, uint8_t *dst)
+{
+    int i = 0;
+
+    switch (format)
+    {
+    case IMAGE_BGR888:
+        memcpy(dst, in, count * 3);
+        break;
+    case IMAGE_RGB565:
+        for (; i + 4 <= count; i += 4, in += 12, dst += 8)
+        {
+            bgr_to_rgb565(in, dst);
+            bgr_to_rgb565(in + 3, dst + 2);
+            bgr_to_rgb565(in + 6, dst + 4);
+            bgr_to_rgb565(in + 9, dst + 6);
+        }
+        for (; i < count; i++, in += 3, dst += 2)
+        {
+            bgr_to_rgb565(in, dst);
+        }
+        break;
+    case IMAGE_LUMA:
+        for (; i + 4 <= count; i += 4, in += 12, dst += 4)
+        {
+            dst[0] = bgr_to_luma(in);
+            dst[1] = bgr_to_luma(in + 3);
+            dst[2] = bgr_to_luma(in + 6);
+            dst[3] = bgr_to_luma(in + 9);
+        }
+        for (; i < count; i++, in += 3, dst++)
+        {
+            dst[0] = bgr_to_luma(in);
+        }
+        break;
+    }
+}
+
+/* Converts count pixels of a source row, starting at column x, into a BGR888 line */
+static inline void image_load_row(const image_t *src, int x, int y, int count, uint8_t *line)
+{
+    row_to_bgr(image_row(src, y) + x * app_image_bpp(src->format), src->format, count, line);
+}
+
+int app_image_bpp(image_format_t format)
+{
+    return format == IMAGE_BGR888 ? 3 : (format == IMAGE_RGB565 ? 2 : 1);
+}
+
+bool app_image_from_fb(const camera_fb_t *fb, image_t *image)
+{
+    image->buf = fb->buf;
+    image->width = fb->width;
+    image->height = fb->height;
+    image->stride = 0;
+    if (fb->format == PIXFORMAT_RGB565)
+    {
+        image->format = IMAGE_RGB565;
+    }
+    else if (fb->format == PIXFORMAT_GRAYSCALE)
+    {
+        image->format = IMAGE_LUMA;
+    }
+    else if (fb->format == PIXFORMAT_RGB888)
+    {
+        // the sensor has no RGB888 of its own, fmt2rgb888 output is BGR
+        image->format = IMAGE_BGR888;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+void app_image_from_matrix(dl_matrix3du_t *matrix, image_t *image)
+{
+    image->buf = matrix->item;
+    image->width = matrix->w;
+    image->height = matrix->h;
+    image->stride = matrix->w * 3;
+    image->format = IMAGE_BGR888;
+}
+
+esp_err_t app_image_convert(const image_t *src, image_t *dst)
+{
+    uint8_t *line = NULL;
+
+    if (src->width != dst->width || src->height != dst->height)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // to or from BGR888 needs no line in between
+    if (src->format != IMAGE_BGR888 && dst->format != IMAGE_BGR888)
+    {
+        line = image_line_alloc(src->width * 3);
+        if (!line)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    for (int y = 0; y < src->height; y++)
+    {
+        if (src->format == dst->format)
+        {
+            memcpy(image_row(dst, y), image_row(src, y), src->width * app_image_bpp(src->format));
+        }
+        else if (src->format == IMAGE_BGR888)
+        {
+            row_from_bgr(image_row(src, y), src->width, dst->format, image_row(dst, y));
+        }
+        else if (dst->format == IMAGE_BGR888)
+        {
+            row_to_bgr(image_row(src, y), src->format, src->width, image_row(dst, y));
+        }
+        else
+        {
+            row_to_bgr(image_row(src, y), src->format, src->width, line);
+            row_from_bgr(line, src->width, dst->format, image_row(dst, y));
+        }
+    }
+    free(line);
+    return ESP_OK;
+}
+
+/* Crop without scaling, rows are converted straight into dst */
+static esp_err_t resize_copy(const image_t *src, const image_rect_t *r, image_t *dst)
+{
+    image_t from = *src;
+    from.buf = image_row(src, r->y) + r->x * app_image_bpp(src->format);
+    from.width = r->width;
+    from.height = r->height;
+    from.stride = image_stride(src);
+    return app_image_convert(&from, dst);
+}
+
+/*
+ * Pixel centers are mapped onto the source, each output pixel blends the
+ * two nearest rows and the two nearest columns with 8 bit weights.
+ */
+static esp_err_t resize_bilinear(const image_t *src, const image_rect_t *r, image_t *dst)
+{
+    int line_len = r->width * 3 + LINE_PAD;
+    // the column table goes first, it is the only part that needs alignment
+    uint16_t *x_offset = (uint16_t *)image_line_alloc(dst->width * sizeof(uint16_t) + dst->width + line_len * 3 + dst->width * 3);
+    if (!x_offset)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    uint8_t *x_weight = (uint8_t *)(x_offset + dst->width);
+    uint8_t *lines[2] = { x_weight + dst->width, x_weight + dst->width + line_len };
+    uint8_t *blend = lines[1] + line_len;
+    uint8_t *out = blend + line_len;
+    int loaded[2] = { -1, -1 };
+
+    memset(lines[0] + line_len - LINE_PAD, 0, LINE_PAD);
+    memset(lines[1] + line_len - LINE_PAD, 0, LINE_PAD);
+    memset(blend + line_len - LINE_PAD, 0, LINE_PAD);
+
+    // the columns are the same for every row
+    int32_t step_x = ((int32_t)r->width << 16) / dst->width;
+    int32_t sx = step_x / 2 - 0x8000;
+    for (int x = 0; x < dst->width; x++, sx += step_x)
+    {
+        int32_t pos = sx < 0 ? 0 : sx;
+        int x0 = pos >> 16;
+        if (x0 >= r->width - 1)
+        {
+            x_offset[x] = (r->width - 1) * 3;
+            x_weight[x] = 0;
+        }
+        else
+        {
+            x_offset[x] = x0 * 3;
+            x_weight[x] = (pos >> 8) & 0xFF;
+        }
+    }
+
+    int32_t step_y = ((int32_t)r->height << 16) / dst->height;
+    int32_t sy = step_y / 2 - 0x8000;
+    for (int y = 0; y < dst->height; y++, sy += step_y)
+    {
+        int32_t pos = sy < 0 ? 0 : sy;
+        int y0 = pos >> 16;
+        int y1 = y0 + 1 < r->height ? y0 + 1 : y0;
+        int fy = y1 == y0 ? 0 : (pos >> 8) & 0xFF;
+
+        // rows move down, the lower row of the last output row is often the upper one now
+        if (loaded[1] == y0)
+        {
+            uint8_t *t = lines[0];
+            lines[0] = lines[1];
+            lines[1] = t;
+            loaded[0] = y0;
+            loaded[1] = -1;
+        }
+        if (loaded[0] != y0)
+        {
+            image_load_row(src, r->x, r->y + y0, r->width, lines[0]);
+            loaded[0] = y0;
+        }
+
+        const uint8_t *v = lines[0];
+        if (fy)
+        {
+            if (loaded[1] != y1)
+            {
+                image_load_row(src, r->x, r->y + y1, r->width, lines[1]);
+                loaded[1] = y1;
+            }
+            const uint8_t *a = lines[0];
+            const uint8_t *b = lines[1];
+            int wa = 256 - fy;
+            int i = 0;
+            for (; i + 4 <= r->width * 3; i += 4)
+            {
+                blend[i] = (a[i] * wa + b[i] * fy) >> 8;
+                blend[i + 1] = (a[i + 1] * wa + b[i + 1] * fy) >> 8;
+                blend[i + 2] = (a[i + 2] * wa + b[i + 2] * fy) >> 8;
+                blend[i + 3] = (a[i + 3] * wa + b[i + 3] * fy) >> 8;
+            }
+            for (; i < r->width * 3; i++)
+            {
+                blend[i] = (a[i] * wa + b[i] * fy) >> 8;
+            }
+            v = blend;
+        }
+
+        // straight into dst when it is BGR888 already
+        uint8_t *o = dst->format == IMAGE_BGR888 ? image_row(dst, y) : out;
+        for (int x = 0; x < dst->width; x++, o += 3)
+        {
+            const uint8_t *p = v + x_offset[x];
+            int fx = x_weight[x];
+            int wp = 256 - fx;
+            o[0] = (p[0] * wp + p[3] * fx) >> 8;
+            o[1] = (p[1] * wp + p[4] * fx) >> 8;
+            o[2] = (p[2] * wp + p[5] * fx) >> 8;
+        }
+        if (dst->format != IMAGE_BGR888)
+        {
+            row_from_bgr(out, dst->width, dst->format, image_row(dst, y));
+        }
+    }
+    free(x_offset);
+    return ESP_OK;
+}
+
+/*
+ * Each output pixel is the mean of the whole source pixels under it. Rows are
+ * summed into a line of 32 bit counters, then columns are summed and scaled
+ * by a fixed point reciprocal of the pixel count.
+ */
+static esp_err_t resize_area(const image_t *src, const image_rect_t *r, image_t *dst)
+{
+    int row_len = r->width * 3;
+    // counters and column table first, they need alignment
+    uint32_t *sum = (uint32_t *)image_line_alloc(row_len * sizeof(uint32_t) + (dst->width + 1) * sizeof(uint16_t) + row_len + dst->width * 3);
+    if (!sum)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    uint16_t *x_start = (uint16_t *)(sum + row_len);
+    uint8_t *line = (uint8_t *)(x_start + dst->width + 1);
+    uint8_t *out = line + row_len;
+
+    for (int x = 0; x <= dst->width; x++)
+    {
+        x_start[x] = x * r->width / dst->width;
+    }
+
+    for (int y = 0; y < dst->height; y++)
+    {
+        int y0 = y * r->height / dst->height;
+        int y1 = (y + 1) * r->height / dst->height;
+
+        memset(sum, 0, row_len * sizeof(uint32_t));
+        for (int sy = y0; sy < y1; sy++)
+        {
+            image_load_row(src, r->x, r->y + sy, r->width, line);
+            int i = 0;
+            for (; i + 4 <= row_len; i += 4)
+            {
+                sum[i] += line[i];
+                sum[i + 1] += line[i + 1];
+                sum[i + 2] += line[i + 2];
+                sum[i + 3] += line[i + 3];
+            }
+            for (; i < row_len; i++)
+            {
+                sum[i] += line[i];
+            }
+        }
+
+        uint8_t *o = dst->format == IMAGE_BGR888 ? image_row(dst, y) : out;
+        for (int x = 0; x < dst->width; x++, o += 3)
+        {
+            uint32_t b = 0, g = 0, rd = 0;
+            for (int sx = x_start[x]; sx < x_start[x + 1]; sx++)
+            {
+                b += sum[sx * 3];
+                g += sum[sx * 3 + 1];
+                rd += sum[sx * 3 + 2];
+            }
+            uint32_t n = (x_start[x + 1] - x_start[x]) * (y1 - y0);
+            uint32_t inv = (0x10000 + n / 2) / n;
+            o[0] = (b * inv + 0x8000) >> 16;
+            o[1] = (g * inv + 0x8000) >> 16;
+            o[2] = (rd * inv + 0x8000) >> 16;
+        }
+        if (dst->format != IMAGE_BGR888)
+        {
+            row_from_bgr(out, dst->width, dst->format, image_row(dst, y));
+        }
+    }
+    free(sum);
+    return ESP_OK;
+}
+
+esp_err_t app_image_resize(const image_t *src, const image_rect_t *rect, image_t *dst, image_resize_t mode)
+{
+    image_rect_t whole = { 0, 0, src->width, src->height };
+    const image_rect_t *r = rect ? rect : &whole;
+
+    if (r->x < 0 || r->y < 0 || r->width <= 0 || r->height <= 0
+    || r->x + r->width > src->width || r->y + r->height > src->height
+    || dst->width <= 0 || dst->height <= 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (r->width == dst->width && r->height == dst->height)
+    {
+        return resize_copy(src, r, dst);
+    }
+    if (mode == IMAGE_RESIZE_AREA && r->width >= dst->width && r->height >= dst->height)
+    {
+        return resize_area(src, r, dst);
+    }
+    return resize_bilinear(src, r, dst);
+}
+
+esp_err_t app_image_transform(const image_t *src, image_t *dst, image_transform_t transform)
+{
+    int bpp = app_image_bpp(src->format);
+    bool quarter = transform == IMAGE_ROTATE_90 || transform == IMAGE_ROTATE_270;
+    int width = quarter ? src->height : src->width;
+    int height = quarter ? src->width : src->height;
+
+    if (src->format != dst->format || dst->width != width || dst->height != height)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // source rows are read in order, quarter turns write a column of dst per row
+    for (int y = 0; y < src->height; y++)
+    {
+        const uint8_t *s = image_row(src, y);
+        uint8_t *d;
+        int step;
+
+        switch (transform)
+        {
+        case IMAGE_FLIP_V:
+            memcpy(image_row(dst, src->height - 1 - y), s, src->width * bpp);
+            continue;
+        case IMAGE_FLIP_H:
+            d = image_row(dst, y) + (src->width - 1) * bpp;
+            step = -bpp;
+            break;
+        case IMAGE_ROTATE_180:
+            d = image_row(dst, src->height - 1 - y) + (src->width - 1) * bpp;
+            step = -bpp;
+            break;
+        case IMAGE_ROTATE_90:
+            // source column x lands on dst row x, source row y on dst column height - 1 - y
+            d = image_row(dst, 0) + (src->height - 1 - y) * bpp;
+            step = image_stride(dst);
+            break;
+        case IMAGE_ROTATE_270:
+            d = image_row(dst, src->width - 1) + y * bpp;
+            step = -image_stride(dst);
+            break;
+        default:
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        switch (bpp)
+        {
+        case 1:
+            for (int x = 0; x < src->width; x++, s++, d += step)
+            {
+                d[0] = s[0];
+            }
+            break;
+        case 2:
+            for (int x = 0; x < src->width; x++, s += 2, d += step)
+            {
+                d[0] = s[0];
+                d[1] = s[1];
+            }
+            break;
+        default:
+            for (int x = 0; x < src->width; x++, s += 3, d += step)
+            {
+                d[0] = s[0];
+                d[1] = s[1];
+                d[2] = s[2];
+            }
+            break;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t app_image_warp(const image_t *src, const int32_t m[6], image_t *dst)
+{
+    if (src->format != IMAGE_BGR888 || dst->format != IMAGE_BGR888 || src->width < 2 || src->height < 2)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // the last pixel pair starts one before the edge, its weight reaches the edge pixel
+    int32_t max_x = (int32_t)(src->width - 1) << 16;
+    int32_t max_y = (int32_t)(src->height - 1) << 16;
+    int src_stride = image_stride(src);
+
+    for (int y = 0; y < dst->height; y++)
+    {
+        // centers of dst pixels, less half a pixel to index src, stepped by the first column of m
+        int32_t sx = m[0] / 2 + m[1] * y + m[1] / 2 + m[2] - 0x8000;
+        int32_t sy = m[3] / 2 + m[4] * y + m[4] / 2 + m[5] - 0x8000;
+        uint8_t *out = image_row(dst, y);
+
+        for (int x = 0; x < dst->width; x++, sx += m[0], sy += m[3], out += 3)
+        {
+            int32_t px = sx < 0 ? 0 : (sx >= max_x ? max_x - 1 : sx);
+            int32_t py = sy < 0 ? 0 : (sy >= max_y ? max_y - 1 : sy);
+            int fx = (px >> 8) & 0xFF;
+            int fy = (py >> 8) & 0xFF;
+            const uint8_t *a = src->buf + (py >> 16) * src_stride + (px >> 16) * 3;
+            const uint8_t *b = a + src_stride;
+
+            for (int c = 0; c < 3; c++)
+            {
+                int top = a[c] * (256 - fx) + a[c + 3] * fx;
+                int bottom = b[c] * (256 - fx) + b[c + 3] * fx;
+                out[c] = (top * (256 - fy) + bottom * fy) >> 16;
+            }
+        }
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,724 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "app_jpeg.h"
+#include "app_tasks.h"
+#include "app_mem.h"
+
+static const char *TAG = "app_jpeg";
+
+// the overlay quality steps of app_rate
+#define JPEG_QUALITY_CACHE      4
+#define JPEG_MCU_WIDTH          16
+#define JPEG_MCU_HEIGHT         8
+
+const uint8_t app_jpeg_natural[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10,
+    17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+/* Tables of ITU T.81 Annex K, quantization in natural order */
+static const uint8_t s_luma_qt[64] = {
+    16, 11, 10, 16,  24,  40,  51,  61,
+    12, 12, 14, 19,  26,  58,  60,  55,
+    14, 13, 16, 24,  40,  57,  69,  56,
+    14, 17, 22, 29,  51,  87,  80,  62,
+    18, 22, 37, 56,  68, 109, 103,  77,
+    24, 35, 55, 64,  81, 104, 113,  92,
+    49, 64, 78, 87, 103, 121, 120, 101,
+    72, 92, 95, 98, 112, 100, 103,  99,
+};
+
+static const uint8_t s_chroma_qt[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99,
+    18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99,
+    47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+};
+
+static const uint8_t s_dc_luma_counts[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+static const uint8_t s_dc_chroma_counts[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+static const uint8_t s_dc_vals[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+static const uint8_t s_ac_luma_counts[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D };
+static const uint8_t s_ac_luma_vals[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+    0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+    0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+    0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+    0xF9, 0xFA,
+};
+
+static const uint8_t s_ac_chroma_counts[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+static const uint8_t s_ac_chroma_vals[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+    0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+    0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+    0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+    0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+    0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+    0xF9, 0xFA,
+};
+
+typedef struct {
+    uint8_t quality;            /* 0 for an unused entry */
+    uint8_t qt[2][64];          /* zigzag order for the DQT segment */
+    float scale[2][64];         /* natural order, undoes the AAN output scaling and quantizes */
+} jpeg_quality_t;
+
+// MCUs at full quality, the others requantized from the background tables
+typedef struct {
+    int count;
+    int x1[JPEG_ROI_MAX], y1[JPEG_ROI_MAX], x2[JPEG_ROI_MAX], y2[JPEG_ROI_MAX];
+    const jpeg_quality_t *bg;
+    float step[2][64];          /* natural order, background step in steps of the frame tables */
+} jpeg_roi_t;
+
+// one MCU row of samples per encoder, in internal RAM
+typedef struct {
+    jpeg_writer_t w;
+    uint8_t *y;
+    uint8_t *cb;
+    uint8_t *cr;
+    size_t strip_size;          /* allocated width */
+    int strip_width;            /* width of the frame in MCUs, times 16 */
+    const dl_matrix3du_t *matrix;
+    const jpeg_quality_t *quality;
+    const jpeg_roi_t *roi;      /* NULL to encode every MCU at quality */
+    int row_start;
+    int row_end;
+    int rows;
+    bool restart;               /* every MCU row is a restart interval */
+    bool ok;
+} jpeg_enc_t;
+
+static jpeg_huff_code_t s_dc_luma, s_ac_luma, s_dc_chroma, s_ac_chroma;
+static bool s_codes_ready = false;
+static jpeg_quality_t s_qualities[JPEG_QUALITY_CACHE];
+static int s_quality_next = 0;
+static jpeg_enc_t s_enc[2];
+static jpeg_roi_t s_roi;
+
+#ifdef CONFIG_JPEG_ENCODE_DUAL_CORE
+static QueueHandle_t s_job_queue = NULL;
+static SemaphoreHandle_t s_job_done = NULL;
+// the lower half is encoded here, then appended
+static uint8_t *s_half_buf = NULL;
+static size_t s_half_size = 0;
+#endif
+
+bool app_jpeg_huff_codes(jpeg_huff_code_t *t, const uint8_t *counts, const uint8_t *vals)
+{
+    uint32_t code = 0;
+    int k = 0;
+
+    memset(t->size, 0, sizeof(t->size));
+    for (int l = 1; l <= 16; l++)
+    {
+        for (int n = 0; n < counts[l - 1]; n++, k++, code++)
+        {
+            t->code[vals[k]] = code;
+            t->size[vals[k]] = l;
+        }
+        if (code > (1u << l))
+        {
+            return false;
+        }
+        code <<= 1;
+    }
+    return true;
+}
+
+void app_jpeg_flush_bits(jpeg_writer_t *w)
+{
+    if (w->bits > 0)
+    {
+        app_jpeg_put_bits(w, 0x7F, 8 - w->bits);
+    }
+}
+
+static inline int jpeg_bit_length(int v)
+{
+    int s = 0;
+
+    for (v = v < 0 ? -v : v; v; v >>= 1)
+    {
+        s++;
+    }
+    return s;
+}
+
+bool app_jpeg_encode_block(jpeg_writer_t *w, const jpeg_huff_code_t *dc, const jpeg_huff_code_t *ac, int *pred, const int16_t *zz)
+{
+    int diff = zz[0] - *pred;
+    int s = jpeg_bit_length(diff);
+    int run = 0;
+
+    *pred = zz[0];
+    if (s > 11 || !dc->size[s])
+    {
+        return false;
+    }
+    app_jpeg_put_bits(w, dc->code[s], dc->size[s]);
+    if (s)
+    {
+        app_jpeg_put_bits(w, diff < 0 ? diff - 1 : diff, s);
+    }
+    for (int k = 1; k < 64; k++)
+    {
+        int v = zz[k];
+        if (v == 0)
+        {
+            run++;
+            continue;
+        }
+        for (; run > 15; run -= 16)
+        {
+            if (!ac->size[0xF0])
+            {
+                return false;
+            }
+            app_jpeg_put_bits(w, ac->code[0xF0], ac->size[0xF0]);
+        }
+        s = jpeg_bit_length(v);
+        int sym = (run << 4) | s;
+        if (s > 10 || !ac->size[sym])
+        {
+            return false;
+        }
+        app_jpeg_put_bits(w, ac->code[sym], ac->size[sym]);
+        app_jpeg_put_bits(w, v < 0 ? v - 1 : v, s);
+        run = 0;
+    }
+    if (run > 0)
+    {
+        if (!ac->size[0x00])
+        {
+            return false;
+        }
+        app_jpeg_put_bits(w, ac->code[0x00], ac->size[0x00]);
+    }
+    return true;
+}
+
+static void jpeg_codes_init()
+{
+    app_jpeg_huff_codes(&s_dc_luma, s_dc_luma_counts, s_dc_vals);
+    app_jpeg_huff_codes(&s_ac_luma, s_ac_luma_counts, s_ac_luma_vals);
+    app_jpeg_huff_codes(&s_dc_chroma, s_dc_chroma_counts, s_dc_vals);
+    app_jpeg_huff_codes(&s_ac_chroma, s_ac_chroma_counts, s_ac_chroma_vals);
+    s_codes_ready = true;
+}
+
+/* Tables of quality, from the cache or built in a slot other than keep's */
+static const jpeg_quality_t *jpeg_get_quality(uint8_t quality, const jpeg_quality_t *keep)
+{
+    // AAN leaves coefficient (u, v) scaled by 8 * a[u] * a[v]
+    static const float aan[8] = {
+        1.0f, 1.387039845f, 1.306562965f, 1.175875602f, 1.0f, 0.785694958f, 0.541196100f, 0.275899379f,
+    };
+
+    quality = quality < 1 ? 1 : (quality > 100 ? 100 : quality);
+    for (int i = 0; i < JPEG_QUALITY_CACHE; i++)
+    {
+        if (s_qualities[i].quality == quality)
+        {
+            return &s_qualities[i];
+        }
+    }
+
+    if (&s_qualities[s_quality_next] == keep)
+    {
+        s_quality_next = (s_quality_next + 1) % JPEG_QUALITY_CACHE;
+    }
+    jpeg_quality_t *q = &s_qualities[s_quality_next];
+    s_quality_next = (s_quality_next + 1) % JPEG_QUALITY_CACHE;
+    // libjpeg's quality scaling, so frames look the same as from fmt2jpg
+    int factor = quality < 50 ? 5000 / quality : 200 - quality * 2;
+    for (int t = 0; t < 2; t++)
+    {
+        const uint8_t *base = t ? s_chroma_qt : s_luma_qt;
+        for (int k = 0; k < 64; k++)
+        {
+            int nat = app_jpeg_natural[k];
+            int v = (base[nat] * factor + 50) / 100;
+            v = v < 1 ? 1 : (v > 255 ? 255 : v);
+            q->qt[t][k] = v;
+            q->scale[t][nat] = 1.0f / (v * aan[nat >> 3] * aan[nat & 7] * 8);
+        }
+    }
+    q->quality = quality;
+    return q;
+}
+
+#define AAN_MUL(x, c)   (((x) * (c)) >> 8)
+#define AAN_0_382683433 98
+#define AAN_0_541196100 139
+#define AAN_0_707106781 181
+#define AAN_1_306562965 334
+
+/* Separable AAN forward DCT on 8 bit fixed point constants, one row or column */
+static inline void jpeg_fdct_1d(int32_t *d, int step)
+{
+    int32_t t0 = d[0] + d[7 * step], t7 = d[0] - d[7 * step];
+    int32_t t1 = d[step] + d[6 * step], t6 = d[step] - d[6 * step];
+    int32_t t2 = d[2 * step] + d[5 * step], t5 = d[2 * step] - d[5 * step];
+    int32_t t3 = d[3 * step] + d[4 * step], t4 = d[3 * step] - d[4 * step];
+
+    int32_t t10 = t0 + t3, t13 = t0 - t3;
+    int32_t t11 = t1 + t2, t12 = t1 - t2;
+    d[0] = t10 + t11;
+    d[4 * step] = t10 - t11;
+    int32_t z1 = AAN_MUL(t12 + t13, AAN_0_707106781);
+    d[2 * step] = t13 + z1;
+    d[6 * step] = t13 - z1;
+
+    t10 = t4 + t5;
+    t11 = t5 + t6;
+    t12 = t6 + t7;
+    int32_t z5 = AAN_MUL(t10 - t12, AAN_0_382683433);
+    int32_t z2 = AAN_MUL(t10, AAN_0_541196100) + z5;
+    int32_t z4 = AAN_MUL(t12, AAN_1_306562965) + z5;
+    int32_t z3 = AAN_MUL(t11, AAN_0_707106781);
+    int32_t z11 = t7 + z3, z13 = t7 - z3;
+    d[5 * step] = z13 + z2;
+    d[3 * step] = z13 - z2;
+    d[step] = z11 + z4;
+    d[7 * step] = z11 - z4;
+}
+
+static inline int16_t jpeg_round(float v)
+{
+    return v < 0 ? (int16_t)(v - 0.5f) : (int16_t)(v + 0.5f);
+}
+
+/* step is NULL at full quality, else scale is the background one and step maps it to the frame tables */
+static void jpeg_fdct(const uint8_t *src, int stride, const float *scale, const float *step, int16_t *zz)
+{
+    int32_t d[64];
+
+    for (int y = 0; y < 8; y++)
+    {
+        for (int x = 0; x < 8; x++)
+        {
+            d[y * 8 + x] = src[y * stride + x] - 128;
+        }
+        jpeg_fdct_1d(d + y * 8, 1);
+    }
+    for (int x = 0; x < 8; x++)
+    {
+        jpeg_fdct_1d(d + x, 8);
+    }
+    for (int k = 0; k < 64; k++)
+    {
+        int nat = app_jpeg_natural[k];
+        zz[k] = jpeg_round(d[nat] * scale[nat]);
+        if (step && zz[k])
+        {
+            zz[k] = jpeg_round(zz[k] * step[nat]);
+        }
+    }
+}
+
+/* Converts the pixels of one MCU row, edges are repeated into the padding */
+static void jpeg_load_row(jpeg_enc_t *e, int row)
+{
+    const dl_matrix3du_t *m = e->matrix;
+    int width = m->w;
+    int strip_width = e->strip_width;
+
+    for (int j = 0; j < JPEG_MCU_HEIGHT; j++)
+    {
+        int sy = row * JPEG_MCU_HEIGHT + j < m->h ? row * JPEG_MCU_HEIGHT + j : m->h - 1;
+        const uint8_t *src = m->item + sy * width * 3;
+        uint8_t *y = e->y + j * strip_width;
+        uint8_t *cb = e->cb + j * strip_width / 2;
+        uint8_t *cr = e->cr + j * strip_width / 2;
+        for (int x = 0; x < strip_width; x += 2)
+        {
+            // frames from fmt2rgb888 are BGR
+            const uint8_t *p0 = src + (x < width ? x : width - 1) * 3;
+            const uint8_t *p1 = src + (x + 1 < width ? x + 1 : width - 1) * 3;
+            int32_t b0 = p0[0], g0 = p0[1], r0 = p0[2];
+            int32_t b1 = p1[0], g1 = p1[1], r1 = p1[2];
+            y[x] = (19595 * r0 + 38470 * g0 + 7471 * b0 + 32768) >> 16;
+            y[x + 1] = (19595 * r1 + 38470 * g1 + 7471 * b1 + 32768) >> 16;
+            // 4:2:2, chroma of the pixel pair
+            int32_t rs = r0 + r1, gs = g0 + g1, bs = b0 + b1;
+            int32_t u = (-11059 * rs - 21709 * gs + 32768 * bs + (128 << 17) + (1 << 16)) >> 17;
+            int32_t v = (32768 * rs - 27439 * gs - 5329 * bs + (128 << 17) + (1 << 16)) >> 17;
+            cb[x / 2] = u > 255 ? 255 : u;
+            cr[x / 2] = v > 255 ? 255 : v;
+        }
+    }
+}
+
+static bool jpeg_in_roi(const jpeg_roi_t *roi, int mcu_x, int mcu_y)
+{
+    for (int i = 0; i < roi->count; i++)
+    {
+        if (mcu_x >= roi->x1[i] && mcu_x <= roi->x2[i] && mcu_y >= roi->y1[i] && mcu_y <= roi->y2[i])
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void jpeg_encode_rows(jpeg_enc_t *e)
+{
+    const jpeg_quality_t *q = e->quality;
+    int strip_width = e->strip_width;
+    int pred[3] = {0};
+    int16_t zz[64];
+
+    e->ok = true;
+    for (int row = e->row_start; row < e->row_end && e->ok; row++)
+    {
+        jpeg_load_row(e, row);
+        for (int x = 0; x < strip_width && e->ok; x += JPEG_MCU_WIDTH)
+        {
+            const jpeg_quality_t *mq = q;
+            const float *step[2] = { NULL, NULL };
+            if (e->roi && !jpeg_in_roi(e->roi, x / JPEG_MCU_WIDTH, row))
+            {
+                mq = e->roi->bg;
+                step[0] = e->roi->step[0];
+                step[1] = e->roi->step[1];
+            }
+            jpeg_fdct(e->y + x, strip_width, mq->scale[0], step[0], zz);
+            e->ok &= app_jpeg_encode_block(&e->w, &s_dc_luma, &s_ac_luma, &pred[0], zz);
+            jpeg_fdct(e->y + x + 8, strip_width, mq->scale[0], step[0], zz);
+            e->ok &= app_jpeg_encode_block(&e->w, &s_dc_luma, &s_ac_luma, &pred[0], zz);
+            jpeg_fdct(e->cb + x / 2, strip_width / 2, mq->scale[1], step[1], zz);
+            e->ok &= app_jpeg_encode_block(&e->w, &s_dc_chroma, &s_ac_chroma, &pred[1], zz);
+            jpeg_fdct(e->cr + x / 2, strip_width / 2, mq->scale[1], step[1], zz);
+            e->ok &= app_jpeg_encode_block(&e->w, &s_dc_chroma, &s_ac_chroma, &pred[2], zz);
+        }
+        if (e->restart && row + 1 < e->rows)
+        {
+            app_jpeg_flush_bits(&e->w);
+            app_jpeg_put_byte(&e->w, 0xFF);
+            app_jpeg_put_byte(&e->w, 0xD0 + (row & 7));
+            memset(pred, 0, sizeof(pred));
+        }
+    }
+    if (e->row_end == e->rows)
+    {
+        app_jpeg_flush_bits(&e->w);
+    }
+    e->ok &= !e->w.overflow;
+}
+
+static bool jpeg_alloc_strip(jpeg_enc_t *e, size_t strip_width)
+{
+    e->strip_width = strip_width;
+    if (strip_width <= e->strip_size)
+    {
+        return true;
+    }
+    app_mem_free(APP_MEM_JPEG_STRIP, e->y, e->strip_size * JPEG_MCU_HEIGHT * 2);
+    e->strip_size = 0;
+    // luma and both chroma planes in one block
+    e->y = (uint8_t *)app_mem_alloc(APP_MEM_JPEG_STRIP, strip_width * JPEG_MCU_HEIGHT * 2);
+    if (!e->y)
+    {
+        return false;
+    }
+    e->cb = e->y + strip_width * JPEG_MCU_HEIGHT;
+    e->cr = e->cb + strip_width * JPEG_MCU_HEIGHT / 2;
+    e->strip_size = strip_width;
+    return true;
+}
+
+static void jpeg_write_header(jpeg_writer_t *w, int width, int height, const jpeg_quality_t *q, int restart_interval)
+{
+    static const uint8_t jfif[] = {
+        0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00, 0x01, 0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00,
+    };
+    struct {
+        uint8_t id;
+        const uint8_t *counts;
+        const uint8_t *vals;
+        int count;
+    } tables[4] = {
+        { 0x00, s_dc_luma_counts, s_dc_vals, sizeof(s_dc_vals) },
+        { 0x10, s_ac_luma_counts, s_ac_luma_vals, sizeof(s_ac_luma_vals) },
+        { 0x01, s_dc_chroma_counts, s_dc_vals, sizeof(s_dc_vals) },
+        { 0x11, s_ac_chroma_counts, s_ac_chroma_vals, sizeof(s_ac_chroma_vals) },
+    };
+
+    for (int i = 0; i < sizeof(jfif); i++)
+    {
+        app_jpeg_put_byte(w, jfif[i]);
+    }
+
+    app_jpeg_put_byte(w, 0xFF);
+    app_jpeg_put_byte(w, 0xDB);
+    app_jpeg_put_byte(w, 0x00);
+    app_jpeg_put_byte(w, 2 + 2 * 65);
+    for (int t = 0; t < 2; t++)
+    {
+        app_jpeg_put_byte(w, t);
+        for (int k = 0; k < 64; k++)
+        {
+            app_jpeg_put_byte(w, q->qt[t][k]);
+        }
+    }
+
+    // Y at 2x1, Cb and Cr at 1x1
+    const uint8_t sof[] = {
+        0xFF, 0xC0, 0x00, 0x11, 0x08, height >> 8, height, width >> 8, width, 0x03,
+        0x01, 0x21, 0x00, 0x02, 0x11, 0x01, 0x03, 0x11, 0x01,
+    };
+    for (int i = 0; i < sizeof(sof); i++)
+    {
+        app_jpeg_put_byte(w, sof[i]);
+    }
+
+    int dht_len = 2;
+    for (int t = 0; t < 4; t++)
+    {
+        dht_len += 17 + tables[t].count;
+    }
+    app_jpeg_put_byte(w, 0xFF);
+    app_jpeg_put_byte(w, 0xC4);
+    app_jpeg_put_byte(w, dht_len >> 8);
+    app_jpeg_put_byte(w, dht_len);
+    for (int t = 0; t < 4; t++)
+    {
+        app_jpeg_put_byte(w, tables[t].id);
+        for (int i = 0; i < 16; i++)
+        {
+            app_jpeg_put_byte(w, tables[t].counts[i]);
+        }
+        for (int i = 0; i < tables[t].count; i++)
+        {
+            app_jpeg_put_byte(w, tables[t].vals[i]);
+        }
+    }
+
+    if (restart_interval)
+    {
+        const uint8_t dri[] = { 0xFF, 0xDD, 0x00, 0x04, restart_interval >> 8, restart_interval };
+        for (int i = 0; i < sizeof(dri); i++)
+        {
+            app_jpeg_put_byte(w, dri[i]);
+        }
+    }
+
+    static const uint8_t sos[] = {
+        0xFF, 0xDA, 0x00, 0x0C, 0x03, 0x01, 0x00, 0x02, 0x11, 0x03, 0x11, 0x00, 0x3F, 0x00,
+    };
+    for (int i = 0; i < sizeof(sos); i++)
+    {
+        app_jpeg_put_byte(w, sos[i]);
+    }
+}
+
+#ifdef CONFIG_JPEG_ENCODE_DUAL_CORE
+static void jpeg_task(void *arg)
+{
+    jpeg_enc_t *e = NULL;
+
+    while (true)
+    {
+        xQueueReceive(s_job_queue, &e, portMAX_DELAY);
+        jpeg_encode_rows(e);
+        xSemaphoreGive(s_job_done);
+    }
+}
+#endif
+
+/* Fills s_roi, returns NULL when every MCU is encoded at q */
+static const jpeg_roi_t *jpeg_set_roi(const dl_matrix3du_t *matrix, const jpeg_quality_t *q, uint8_t bg_quality,
+                                      const box_t *boxes, int count)
+{
+    if (count <= 0 || bg_quality >= q->quality)
+    {
+        return NULL;
+    }
+    jpeg_roi_t *roi = &s_roi;
+    int mcus_x = (matrix->w + JPEG_MCU_WIDTH - 1) / JPEG_MCU_WIDTH;
+    int rows = (matrix->h + JPEG_MCU_HEIGHT - 1) / JPEG_MCU_HEIGHT;
+    roi->count = count < JPEG_ROI_MAX ? count : JPEG_ROI_MAX;
+    for (int i = 0; i < roi->count; i++)
+    {
+        // one MCU of margin, blocks cut by the box edge keep their detail
+        int x1 = (int)boxes[i].box_p[0] / JPEG_MCU_WIDTH - 1;
+        int y1 = (int)boxes[i].box_p[1] / JPEG_MCU_HEIGHT - 1;
+        int x2 = (int)boxes[i].box_p[2] / JPEG_MCU_WIDTH + 1;
+        int y2 = (int)boxes[i].box_p[3] / JPEG_MCU_HEIGHT + 1;
+        roi->x1[i] = x1 < 0 ? 0 : x1;
+        roi->y1[i] = y1 < 0 ? 0 : y1;
+        roi->x2[i] = x2 < mcus_x ? x2 : mcus_x - 1;
+        roi->y2[i] = y2 < rows ? y2 : rows - 1;
+    }
+    // q may sit in the slot up next, a new background quality goes into another one
+    roi->bg = jpeg_get_quality(bg_quality, q);
+    for (int t = 0; t < 2; t++)
+    {
+        for (int k = 0; k < 64; k++)
+        {
+            roi->step[t][app_jpeg_natural[k]] = (float)roi->bg->qt[t][k] / q->qt[t][k];
+        }
+    }
+    return roi;
+}
+
+bool app_jpeg_encode(const dl_matrix3du_t *matrix, uint8_t quality, frame_jpg_t *jpg)
+{
+    return app_jpeg_encode_roi(matrix, quality, quality, NULL, 0, jpg);
+}
+
+bool app_jpeg_encode_roi(const dl_matrix3du_t *matrix, uint8_t quality, uint8_t bg_quality,
+                         const box_t *boxes, int count, frame_jpg_t *jpg)
+{
+    int mcus_x = (matrix->w + JPEG_MCU_WIDTH - 1) / JPEG_MCU_WIDTH;
+    int rows = (matrix->h + JPEG_MCU_HEIGHT - 1) / JPEG_MCU_HEIGHT;
+    size_t strip_width = mcus_x * JPEG_MCU_WIDTH;
+    jpeg_enc_t *e = &s_enc[0];
+    bool split = false;
+
+    if (!s_codes_ready)
+    {
+        jpeg_codes_init();
+    }
+    const jpeg_quality_t *q = jpeg_get_quality(quality, NULL);
+    const jpeg_roi_t *roi = jpeg_set_roi(matrix, q, bg_quality, boxes, count);
+#ifdef CONFIG_JPEG_ENCODE_DUAL_CORE
+    split = s_job_queue && rows >= 2;
+    if (split && jpg->size > s_half_size)
+    {
+        app_mem_free(APP_MEM_JPEG_HALF, s_half_buf, s_half_size);
+        s_half_size = 0;
+        s_half_buf = (uint8_t *)app_mem_alloc(APP_MEM_JPEG_HALF, jpg->size);
+        if (s_half_buf)
+        {
+            s_half_size = jpg->size;
+        }
+    }
+    split &= s_half_buf && jpeg_alloc_strip(&s_enc[1], strip_width);
+#endif
+    if (!jpeg_alloc_strip(e, strip_width))
+    {
+        ESP_LOGW(TAG, "No memory for a %u pixel strip", strip_width);
+        return false;
+    }
+
+    e->w = (jpeg_writer_t) { .buf = jpg->buf, .size = jpg->size };
+    // with two encoders every MCU row is a restart interval, so the halves can be joined
+    jpeg_write_header(&e->w, matrix->w, matrix->h, q, split ? mcus_x : 0);
+    e->matrix = matrix;
+    e->quality = q;
+    e->roi = roi;
+    e->rows = rows;
+    e->restart = split;
+    e->row_start = 0;
+    e->row_end = split ? rows / 2 : rows;
+
+#ifdef CONFIG_JPEG_ENCODE_DUAL_CORE
+    jpeg_enc_t *lower = &s_enc[1];
+    if (split)
+    {
+        lower->w = (jpeg_writer_t) { .buf = s_half_buf, .size = s_half_size };
+        lower->matrix = matrix;
+        lower->quality = q;
+        lower->roi = roi;
+        lower->rows = rows;
+        lower->restart = true;
+        lower->row_start = e->row_end;
+        lower->row_end = rows;
+        xQueueSend(s_job_queue, &lower, portMAX_DELAY);
+    }
+#endif
+    jpeg_encode_rows(e);
+#ifdef CONFIG_JPEG_ENCODE_DUAL_CORE
+    if (split)
+    {
+        xSemaphoreTake(s_job_done, portMAX_DELAY);
+        if (lower->ok && e->w.len + lower->w.len <= e->w.size)
+        {
+            memcpy(e->w.buf + e->w.len, lower->w.buf, lower->w.len);
+            e->w.len += lower->w.len;
+        }
+        else
+        {
+            e->ok = false;
+        }
+    }
+#endif
+    app_jpeg_put_byte(&e->w, 0xFF);
+    app_jpeg_put_byte(&e->w, 0xD9);
+    if (!e->ok || e->w.overflow)
+    {
+        return false;
+    }
+    jpg->len = e->w.len;
+    return true;
+}
+
+esp_err_t app_jpeg_init()
+{
+    if (!s_codes_ready)
+    {
+        jpeg_codes_init();
+    }
+#ifdef CONFIG_JPEG_ENCODE_DUAL_CORE
+    s_job_queue = xQueueCreate(1, sizeof(jpeg_enc_t *));
+    s_job_done = xSemaphoreCreateBinary();
+    if (!s_job_queue || !s_job_done)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    return app_task_create(APP_TASK_JPEG, &jpeg_task, NULL, NULL);
+#else
+    return ESP_OK;
+#endif
+}
@@ -0,0 +1,215 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/ledc.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "app_led.h"
+#include "app_main.h"
+#include "app_event.h"
+#include "app_tracer.h"
+
+#ifdef CONFIG_STATUS_LEDS
+static const char *TAG = "app_led";
+
+/* The camera clock takes timer 0 and channel 0 */
+#define LED_TIMER           LEDC_TIMER_1
+#define LED_FREQ_HZ         5000
+#define LED_DUTY_MAX        ((1 << LEDC_TIMER_13_BIT) - 1)
+
+typedef struct {
+    uint16_t on_ms;         /* 0 keeps the LED off */
+    uint16_t off_ms;        /* 0 keeps it on, otherwise it blinks */
+    uint16_t fade_ms;       /* ramp of each edge, run by the LEDC */
+    uint8_t repeat;         /* blinks before it stays off, 0 blinks on */
+} led_pattern_t;
+
+typedef struct {
+    led_pattern_t red;
+    led_pattern_t white;
+} led_state_t;
+
+#define LED_OFF             { 0, 0, 0, 0 }
+#define LED_ON              { 1, 0, 0, 0 }
+
+static const led_state_t s_states[APP_STATE_MAX] = {
+    [WAIT_FOR_WAKEUP]   = { LED_ON, LED_OFF },
+    [WAIT_FOR_CONNECT]  = { { 1000, 1000, 100, 0 }, LED_OFF },
+    [START_DETECT]      = { LED_OFF, LED_ON },
+    [START_RECOGNITION] = { LED_OFF, LED_ON },
+    [START_ENROLL]      = { LED_ON, LED_ON },
+    [START_DELETE]      = { { 200, 100, 0, 3 }, LED_ON },
+};
+
+/* Other states show the white LED */
+static const led_state_t s_default = { LED_OFF, LED_ON };
+
+typedef struct {
+    ledc_channel_t channel;
+    esp_timer_handle_t timer;
+    led_pattern_t next;     /* set by a state change, under s_led_mux */
+    bool restart;
+    // the rest only in led_step, from the esp_timer task
+    led_pattern_t pattern;
+    bool on;
+    uint8_t blinks;
+} led_channel_t;
+
+static led_channel_t s_red = { .channel = LEDC_CHANNEL_1 };
+static led_channel_t s_white = { .channel = LEDC_CHANNEL_2 };
+static portMUX_TYPE s_led_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void led_duty(led_channel_t *led, bool on, uint16_t fade_ms)
+{
+    uint32_t duty = on ? LED_DUTY_MAX : 0;
+    if (fade_ms)
+    {
+        ledc_set_fade_time_and_start(LEDC_HIGH_SPEED_MODE, led->channel, duty, fade_ms, LEDC_FADE_NO_WAIT);
+    }
+    else
+    {
+        ledc_set_duty(LEDC_HIGH_SPEED_MODE, led->channel, duty);
+        ledc_update_duty(LEDC_HIGH_SPEED_MODE, led->channel);
+    }
+}
+
+/* Takes a new pattern or moves to the next edge, hardware is only touched here */
+static void led_step(void *arg)
+{
+    led_channel_t *led = (led_channel_t *)arg;
+    const led_pattern_t *p = &led->pattern;
+    bool restart;
+
+    portENTER_CRITICAL(&s_led_mux);
+    restart = led->restart;
+    if (restart)
+    {
+        led->pattern = led->next;
+        led->restart = false;
+    }
+    portEXIT_CRITICAL(&s_led_mux);
+    if (restart)
+    {
+        led->on = false;
+        led->blinks = 0;
+    }
+
+    bool blinking = p->on_ms && p->off_ms && (!p->repeat || led->blinks < p->repeat);
+    bool on = blinking ? !led->on : p->on_ms && !p->off_ms;
+    if (restart || on != led->on)
+    {
+        led_duty(led, on, p->fade_ms);
+    }
+    led->on = on;
+    if (blinking)
+    {
+        if (!on)
+        {
+            led->blinks++;
+        }
+        esp_timer_start_once(led->timer, (on ? p->on_ms : p->off_ms) * 1000ULL);
+    }
+}
+
+static void led_program(led_channel_t *led, const led_pattern_t *pattern)
+{
+    portENTER_CRITICAL(&s_led_mux);
+    led->next = *pattern;
+    led->restart = true;
+    portEXIT_CRITICAL(&s_led_mux);
+    // the timer task applies it at once, a running blink edge is cut short
+    esp_timer_stop(led->timer);
+    while (esp_timer_start_once(led->timer, 1) == ESP_ERR_INVALID_STATE)
+    {
+        esp_timer_stop(led->timer);
+    }
+}
+
+static void led_state_changed(en_fsm_state state, en_fsm_state prev, app_event_type_t event, void *arg)
+{
+    const led_state_t *leds = state < APP_STATE_MAX ? &s_states[state] : &s_default;
+
+    // states missing from the table are all zero
+    if (!leds->red.on_ms && !leds->white.on_ms)
+    {
+        leds = &s_default;
+    }
+    TRACE_INSTANT(TRACE_LED, state);
+    led_program(&s_red, &leds->red);
+    led_program(&s_white, &leds->white);
+}
+
+static esp_err_t led_channel_init(led_channel_t *led, int gpio, const char *name)
+{
+    ledc_channel_config_t channel = {
+        .gpio_num = gpio,
+        .speed_mode = LEDC_HIGH_SPEED_MODE,
+        .channel = led->channel,
+        .intr_type = LEDC_INTR_DISABLE,
+        .timer_sel = LED_TIMER,
+        .duty = 0,
+    };
+    esp_timer_create_args_t args = {
+        .callback = led_step,
+        .arg = led,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = name,
+    };
+    esp_err_t err = ledc_channel_config(&channel);
+    if (err == ESP_OK)
+    {
+        err = esp_timer_create(&args, &led->timer);
+    }
+    return err;
+}
+
+esp_err_t app_led_init()
+{
+    ledc_timer_config_t timer = {
+        .speed_mode = LEDC_HIGH_SPEED_MODE,
+        .duty_resolution = LEDC_TIMER_13_BIT,
+        .timer_num = LED_TIMER,
+        .freq_hz = LED_FREQ_HZ,
+    };
+    esp_err_t err = ledc_timer_config(&timer);
+    if (err == ESP_OK)
+    {
+        err = led_channel_init(&s_red, GPIO_LED_RED, "led_red");
+    }
+    if (err == ESP_OK)
+    {
+        err = led_channel_init(&s_white, GPIO_LED_WHITE, "led_white");
+    }
+    if (err == ESP_OK)
+    {
+        err = ledc_fade_func_install(0);
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "LEDC setup failed (0x%x)", err);
+        return err;
+    }
+    led_state_changed(app_event_state(), app_event_state(), APP_EVENT_MAX, NULL);
+    return app_event_subscribe(led_state_changed, NULL);
+}
+#endif
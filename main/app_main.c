@@ -20,73 +20,29 @@
  * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#include <stdio.h>
+#include <stdarg.h>
 #include "app_main.h"
 #include "esp_partition.h"
 #include "ssd1306.h"
 #include "driver/i2c.h"
-void gpio_led_init()
-{
-    gpio_config_t gpio_conf;
-    gpio_conf.mode = GPIO_MODE_OUTPUT;
-    gpio_conf.pull_up_en = GPIO_PULLUP_ENABLE;
-    gpio_conf.intr_type = GPIO_INTR_DISABLE;
-    gpio_conf.pin_bit_mask = 1LL << GPIO_LED_RED;
-    gpio_config(&gpio_conf);
-    gpio_conf.pin_bit_mask = 1LL << GPIO_LED_WHITE;
-    gpio_config(&gpio_conf);
-
-}
-
-void led_task(void *arg)
-{
-    while (1) {
-        switch (g_state) {
-        case WAIT_FOR_WAKEUP:
-            gpio_set_level(GPIO_LED_RED, 1);
-            gpio_set_level(GPIO_LED_WHITE, 0);
-            break;
-
-        case WAIT_FOR_CONNECT:
-            gpio_set_level(GPIO_LED_WHITE, 0);
-            gpio_set_level(GPIO_LED_RED, 1);
-            vTaskDelay(1000 / portTICK_PERIOD_MS);
-            gpio_set_level(GPIO_LED_RED, 0);
-            break;
-
-        case START_DETECT:
-        case START_RECOGNITION:
-            gpio_set_level(GPIO_LED_WHITE, 1);
-            gpio_set_level(GPIO_LED_RED, 0);
-            break;
-
-        case START_ENROLL:
-            gpio_set_level(GPIO_LED_WHITE, 1);
-            gpio_set_level(GPIO_LED_RED, 1);
-            break;
-
-        case START_DELETE:
-            gpio_set_level(GPIO_LED_WHITE, 1);
-            for (int i = 0; i < 3; i++) {
-                gpio_set_level(GPIO_LED_RED, 1);
-                vTaskDelay(200 / portTICK_PERIOD_MS);
-                gpio_set_level(GPIO_LED_RED, 0);
-                vTaskDelay(100 / portTICK_PERIOD_MS);
-            }
-            break;
-
-        default:
-            gpio_set_level(GPIO_LED_WHITE, 1);
-            gpio_set_level(GPIO_LED_RED, 0);
-            break;
-        }
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
-    }
-}
-
-en_fsm_state g_state = WAIT_FOR_WAKEUP;
-int g_is_enrolling = 0;
-int g_is_deleting = 0;
-
+#include "app_enroll.h"
+#include "app_pipeline.h"
+#include "app_config.h"
+#include "app_pir.h"
+#include "app_power.h"
+#include "app_tasks.h"
+#include "app_display.h"
+#include "app_preview.h"
+#include "app_boot.h"
+#include "app_sleep.h"
+#include "app_tracer.h"
+#include "app_timelapse.h"
+#include "app_rtclog.h"
+#include "app_battery.h"
+#include "app_led.h"
+#include "esp_timer.h"
+// draws the splash directly, before the display task owns the panel
 void mssd1306_init()
 {
     ssd1306_setFixedFont(ssd1306xled_font6x8);
@@ -99,25 +55,22 @@ void mssd1306_init()
     ssd1306_flipHorizontal(1);
     ssd1306_flipVertical(1);
     ssd1306_clearScreen();
-    ssd1306_printFixedN(64 / 2 - 8, 28, "esp-who", STYLE_ITALIC, FONT_SIZE_2X);
+    STextSize size;
+    ssd1306_measureText("esp-who", FONT_SIZE_2X, 0, &size);
+    ssd1306_printFixedN((ssd1306_displayWidth() - size.width) / 2, 28, "esp-who", STYLE_ITALIC, FONT_SIZE_2X);
     vTaskDelay(30 / portTICK_PERIOD_MS);
 }
 
 
-#define I2C_MASTER_NUM I2C_NUM_1    /*!< I2C port number for master dev */
+#define I2C_MASTER_NUM DISPLAY_I2C_NUM    /*!< I2C port number for master dev */
 
+// the bus is installed by the OLED, the IP5306 shares it
 int8_t user_i2c_write(uint8_t dev_id, uint8_t reg_addr, uint8_t *reg_data, uint16_t len)
 {
-    int ret; /* Return 0 for Success, non-zero for failure */
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, dev_id << 1 | I2C_MASTER_WRITE, true);
-    i2c_master_write_byte(cmd, reg_addr, true);
-    i2c_master_write(cmd, reg_data, len, true);
-    i2c_master_stop(cmd);
-    ret = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, 1000 / portTICK_RATE_MS);
-    i2c_cmd_link_delete(cmd);
-    return ret;
+    esp_err_t ret = ssd1306_platform_i2cBusInit(I2C_MASTER_NUM, CONFIG_OLED_I2C_SDA, CONFIG_OLED_I2C_SCL, CONFIG_OLED_I2C_CLOCK_HZ);
+    if (ret != ESP_OK)
+        return ret;
+    return ssd1306_platform_i2cWrite(I2C_MASTER_NUM, dev_id, reg_addr, reg_data, len);
 }
 
 #define IP5306_ADDR 0X75
@@ -129,11 +82,12 @@ bool setPowerBoostKeepOn(int en)
         data = 0x35; // 0x37 is default reg value
     int ret = user_i2c_write(IP5306_ADDR, IP5306_REG_SYS_CTL0, &data, 1);
 
-    ssd1306_clearScreen();
+    app_display_clear();
     if (ret == ESP_OK)
-        ssd1306_printFixedN(0, 20, "IP5306 keepON PASS", STYLE_NORMAL, FONT_SIZE_2X);
+        app_display_text(0, 20, "IP5306 keepON PASS", STYLE_NORMAL, FONT_SIZE_2X);
     else
-        ssd1306_printFixedN(0, 20, "IP5306 keepON FAIL", STYLE_NORMAL, FONT_SIZE_2X);
+        app_display_text(0, 20, "IP5306 keepON FAIL", STYLE_NORMAL, FONT_SIZE_2X);
+    app_display_flush(NULL, NULL);
 
     ESP_LOGI("IP5306", "setPowerBoostKeepOn %d\n", ret);
     vTaskDelay(2000 / portTICK_PERIOD_MS);
@@ -141,49 +95,223 @@ bool setPowerBoostKeepOn(int en)
 }
 
 
-void pir_task(void *p)
+#ifdef CONFIG_APP_DISPLAY
+// the PIR and enrollment tasks share the display, the display task sends it
+static void oled_show(uint8_t x, const char *line, EFontStyle style)
+{
+    app_display_clear();
+    if (line)
+        app_display_text(x, 20, line, style, FONT_SIZE_2X);
+    app_display_flush(NULL, NULL);
+}
+
+static void oled_showf(uint8_t x, EFontStyle style, const char *format, ...)
+{
+    char line[DISPLAY_TEXT_MAX];
+    va_list args;
+
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    oled_show(x, line, style);
+}
+
+static void pir_show(const pir_event_t *event, void *arg)
+{
+    if (event->level) {
+        ESP_LOGI("PIR", "pir tirgger \n");
+        oled_show(10, "pir tirgger", STYLE_ITALIC);
+    } else {
+        oled_show(0, NULL, STYLE_NORMAL);
+    }
+}
+#endif
+
+#ifdef CONFIG_PIR_WAKEUP
+static void pir_wakeup(const pir_event_t *event, void *arg)
 {
-    gpio_config_t gpio_conf;
-    gpio_conf.mode = GPIO_MODE_INPUT;
-    gpio_conf.pull_up_en = GPIO_PULLUP_DISABLE;
-    gpio_conf.intr_type = GPIO_INTR_DISABLE;
-    gpio_conf.pin_bit_mask = 1LL << GPIO_PIR;
-    gpio_config(&gpio_conf);
-
-    int prev = 0;
+    // ignored unless waiting for the wake word
+    if (event->level)
+        app_event_post(APP_EVENT_WAKEUP);
+}
+#endif
+
+#if defined(CONFIG_APP_ENROLLMENT) && defined(CONFIG_APP_DISPLAY)
+// enrollment runs in its own task, show its progress here
+void enroll_display_task(void *p)
+{
+    enroll_event_t event;
     while ((1)) {
-        int level =  gpio_get_level(GPIO_PIR);
-        if (prev != level) {
-            if (level) {
-                ESP_LOGI("PIR", "pir tirgger \n");
-                ssd1306_clearScreen();
-                ssd1306_printFixedN(10, 20, "pir tirgger", STYLE_ITALIC, FONT_SIZE_2X);
-            } else {
-                ssd1306_clearScreen();
-            }
-            prev = level;
+        if (!app_enroll_get_event(&event, portMAX_DELAY))
+            continue;
+        if (event.type == ENROLL_EVENT_SAMPLE) {
+            oled_showf(0, STYLE_NORMAL, "sample %d/%d", event.samples, ENROLL_CONFIRM_TIMES);
+        } else if (event.type == ENROLL_EVENT_DONE) {
+            oled_showf(0, STYLE_NORMAL, "ID %d saved", event.id);
+        } else {
+            oled_show(0, "enroll failed", STYLE_NORMAL);
         }
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
     }
 }
+#endif
+
+static bool s_wifi_started;
+
+// called once from the main task, or from the warm start only after it is done
+static void wifi_start()
+{
+    if (s_wifi_started)
+        return;
+    app_boot_begin(BOOT_PHASE_WIFI);
+    app_wifi_init();
+    app_boot_end(BOOT_PHASE_WIFI);
+    s_wifi_started = true;
+}
+
+static void camera_start()
+{
+    camera_settings_t settings;
+
+    app_boot_begin(BOOT_PHASE_CAMERA);
+    app_camera_init();
+    // set over HTTP before the last deep sleep
+    if (app_sleep_get_camera(&settings) && app_camera_apply(&settings) != ESP_OK)
+        ESP_LOGW("esp-eye", "Camera settings not restored");
+    app_boot_end(BOOT_PHASE_CAMERA);
+}
+
+#ifdef CONFIG_WARM_START
+static TaskHandle_t s_main_task;
+
+// brings up the camera, the face IDs and the HTTP server while the wake word model listens
+static void warm_start_task(void *arg)
+{
+    int64_t start = esp_timer_get_time();
+    camera_start();
+    app_boot_begin(BOOT_PHASE_HTTPSERVER);
+    app_httpserver_init();
+    app_boot_end(BOOT_PHASE_HTTPSERVER);
+#ifdef CONFIG_WARM_START_WIFI
+    wifi_start();
+#endif
+    ESP_LOGI("esp-eye", "Warm start done in %lld ms", (esp_timer_get_time() - start) / 1000);
+    xTaskNotifyGive(s_main_task);
+    app_task_exit(APP_TASK_WARM_START);
+}
+#endif
 
 void app_main()
 {
+    app_boot_mark(BOOT_PHASE_APP_MAIN);
+#ifdef CONFIG_TIMELAPSE
+    // takes a shot and sleeps again, unless the button woke the board
+    app_timelapse_run();
+#endif
+#ifdef CONFIG_RTC_LOG
+    // before anything can fail, the records of the last boot are taken over first
+    if (app_rtclog_init() != ESP_OK)
+        ESP_LOGW("esp-eye", "No state changes in the RTC log");
+#endif
+    // the button or the PIR woke the board from deep sleep, no need to wait for the wake word
+    bool resumed = app_sleep_check();
+#ifndef CONFIG_APP_SPEECH
+    // nothing listens for the wake word, start as if woken
+    resumed = true;
+#endif
+    ESP_ERROR_CHECK(app_event_init());
+    app_boot_begin(BOOT_PHASE_POWER);
+    if (app_power_init() != ESP_OK)
+        ESP_LOGW("esp-eye", "Running at full clock");
+    app_boot_end(BOOT_PHASE_POWER);
+    app_task_stats_init();
+
+#ifdef CONFIG_APP_DISPLAY
+    app_boot_begin(BOOT_PHASE_OLED);
     mssd1306_init();
+    app_boot_end(BOOT_PHASE_OLED);
+#endif
+    app_boot_begin(BOOT_PHASE_DISPLAY);
+    ESP_ERROR_CHECK(app_display_init());
+#ifdef CONFIG_PREVIEW_PANEL
+    if (app_preview_init() != ESP_OK)
+        ESP_LOGW("esp-eye", "No camera preview");
+#endif
+    app_boot_end(BOOT_PHASE_DISPLAY);
+#ifdef CONFIG_BATTERY_GOVERNOR
+    // the display installed the bus the IP5306 shares
+    if (app_battery_init() != ESP_OK)
+        ESP_LOGW("esp-eye", "No battery governor");
+#endif
+#ifdef CONFIG_STATUS_LEDS
+    if (app_led_init() != ESP_OK)
+        ESP_LOGW("esp-eye", "No status LEDs");
+#endif
 
-    app_speech_wakeup_init();
+    // the wake word model is picked from the settings in NVS
+    app_boot_begin(BOOT_PHASE_CONFIG);
+    app_wifi_prepare();
+    ESP_ERROR_CHECK(app_config_init());
+    app_boot_end(BOOT_PHASE_CONFIG);
+    if (resumed) {
+        // association runs in the background while the camera starts
+        app_event_post(APP_EVENT_WAKEUP);
+        wifi_start();
+    }
 
-    xTaskCreatePinnedToCore(&pir_task, "blink_task", 2048, NULL, 5, NULL, 0);
+#ifdef CONFIG_WARM_START
+    s_main_task = xTaskGetCurrentTaskHandle();
+    app_task_create(APP_TASK_WARM_START, &warm_start_task, NULL, NULL);
+#endif
 
-    g_state = WAIT_FOR_WAKEUP;
+#ifdef CONFIG_APP_SPEECH
+    if (!resumed) {
+        app_boot_begin(BOOT_PHASE_SPEECH);
+        app_speech_wakeup_init();
+        app_boot_end(BOOT_PHASE_SPEECH);
+    }
+#endif
+
+    app_boot_begin(BOOT_PHASE_PIR);
+    ESP_ERROR_CHECK(app_pir_init());
+#ifdef CONFIG_APP_DISPLAY
+    app_pir_subscribe(pir_show, NULL);
+#endif
+#ifdef CONFIG_PIR_WAKEUP
+    app_pir_subscribe(pir_wakeup, NULL);
+#endif
+    app_boot_end(BOOT_PHASE_PIR);
+    if (app_sleep_init() != ESP_OK)
+        ESP_LOGW("esp-eye", "No deep sleep");
+#if defined(CONFIG_APP_ENROLLMENT) && defined(CONFIG_APP_DISPLAY)
+    app_task_create(APP_TASK_ENROLL_DISPLAY, &enroll_display_task, NULL, NULL);
+#endif
 
     vTaskDelay(30 / portTICK_PERIOD_MS);
+#ifdef CONFIG_APP_SPEECH
     ESP_LOGI("esp-eye", "Please say 'Hi LeXin' to the board");
+#endif
     ESP_LOGI("esp-eye", "Version "VERSION);
-    while (g_state == WAIT_FOR_WAKEUP)
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
-    app_wifi_init();
-    app_camera_init();
+    app_boot_begin(BOOT_PHASE_WAKE_WAIT);
+    app_state_wait(STATE_WAKEUP_BIT, portMAX_DELAY);
+    app_boot_end(BOOT_PHASE_WAKE_WAIT);
+#ifdef CONFIG_WARM_START
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    wifi_start();
+#else
+    wifi_start();
+    camera_start();
+    app_boot_begin(BOOT_PHASE_HTTPSERVER);
     app_httpserver_init();
+    app_boot_end(BOOT_PHASE_HTTPSERVER);
+#endif
+#ifdef CONFIG_APP_SPEECH
+    if (resumed) {
+        // only needed once the board is idle again
+        app_boot_begin(BOOT_PHASE_SPEECH);
+        app_speech_wakeup_init();
+        app_boot_end(BOOT_PHASE_SPEECH);
+    }
+#endif
     ESP_LOGI("esp-eye", "Version "VERSION" success");
+    app_boot_report();
 }
@@ -0,0 +1,312 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "cJSON.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "soc/soc_memory_layout.h"
+#include "sdkconfig.h"
+#include "app_mem.h"
+#include "app_rtclog.h"
+
+static const char *TAG = "app_mem";
+
+#ifdef CONFIG_DETECT_INPUT_INTERNAL
+#define DETECT_INPUT_REGION     APP_MEM_INTERNAL
+#else
+#define DETECT_INPUT_REGION     APP_MEM_SPIRAM
+#endif
+
+#define MEM_INTERNAL_RESERVE    (CONFIG_MEM_INTERNAL_RESERVE_KB * 1024)
+
+static const app_mem_desc_t s_buffers[APP_MEM_MAX] = {
+    [APP_MEM_ALIGNED_FACE]    = { "aligned_face",   APP_MEM_INTERNAL,       APP_MEM_TAG_RECOGNIZE },
+    [APP_MEM_OVERLAY_MASK]    = { "overlay_mask",   APP_MEM_INTERNAL,       APP_MEM_TAG_PIPELINE },
+    [APP_MEM_JPEG_STRIP]      = { "jpeg_strip",     APP_MEM_INTERNAL,       APP_MEM_TAG_PIPELINE },
+    [APP_MEM_MOTION]          = { "motion",         APP_MEM_INTERNAL,       APP_MEM_TAG_DETECT },
+    [APP_MEM_DETECT_INPUT]    = { "detect_input",   DETECT_INPUT_REGION,    APP_MEM_TAG_DETECT },
+    [APP_MEM_DECODE_STRIP]    = { "decode_strip",   APP_MEM_INTERNAL,       APP_MEM_TAG_DETECT },
+    [APP_MEM_TRACK_ROI]       = { "track_roi",      APP_MEM_SPIRAM,         APP_MEM_TAG_DETECT },
+    [APP_MEM_FACE_SAMPLE]     = { "face_sample",    APP_MEM_SPIRAM,         APP_MEM_TAG_RECOGNIZE },
+    [APP_MEM_FRAME]           = { "frame",          APP_MEM_SPIRAM,         APP_MEM_TAG_PIPELINE },
+    [APP_MEM_FRAME_JPEG]      = { "frame_jpeg",     APP_MEM_SPIRAM,         APP_MEM_TAG_PIPELINE },
+    [APP_MEM_JPEG_HALF]       = { "jpeg_half",      APP_MEM_SPIRAM,         APP_MEM_TAG_PIPELINE },
+    [APP_MEM_OVERLAY_TEXT]    = { "overlay_text",   APP_MEM_SPIRAM,         APP_MEM_TAG_PIPELINE },
+    [APP_MEM_FACE_CROP]       = { "face_crop",      APP_MEM_SPIRAM,         APP_MEM_TAG_RECOGNIZE },
+    [APP_MEM_FONT_ATLAS]      = { "font_atlas",     APP_MEM_INTERNAL,       APP_MEM_TAG_DISPLAY },
+    [APP_MEM_PREVIEW_FRAME]   = { "preview_frame",  APP_MEM_SPIRAM,         APP_MEM_TAG_DISPLAY },
+    [APP_MEM_PREVIEW_STRIP]   = { "preview_strip",  APP_MEM_INTERNAL,       APP_MEM_TAG_DISPLAY },
+    [APP_MEM_TRACE]           = { "trace",          APP_MEM_INTERNAL,       APP_MEM_TAG_DEBUG },
+    [APP_MEM_FACE_DB]         = { "face_db",        APP_MEM_SPIRAM,         APP_MEM_TAG_FACE_DB },
+    [APP_MEM_FACE_INDEX]      = { "face_index",     APP_MEM_INTERNAL,       APP_MEM_TAG_FACE_DB },
+    [APP_MEM_FACE_IMPORT]     = { "face_import",    APP_MEM_INTERNAL,       APP_MEM_TAG_FACE_DB },
+    [APP_MEM_AUDIO_RING]      = { "audio_ring",     APP_MEM_INTERNAL,       APP_MEM_TAG_AUDIO },
+    [APP_MEM_AUDIO_DMA]       = { "audio_dma",      APP_MEM_INTERNAL,       APP_MEM_TAG_AUDIO },
+    [APP_MEM_CLIP]            = { "clip",           APP_MEM_SPIRAM,         APP_MEM_TAG_PIPELINE },
+    [APP_MEM_CAMERA]          = { "camera",         APP_MEM_SPIRAM,         APP_MEM_TAG_CAMERA },
+    [APP_MEM_TASK_STACK]      = { "task_stack",     APP_MEM_INTERNAL,       APP_MEM_TAG_TASKS },
+    [APP_MEM_OFFLOAD]         = { "offload",        APP_MEM_SPIRAM,         APP_MEM_TAG_DETECT },
+    [APP_MEM_RTCLOG]          = { "rtclog",         APP_MEM_SPIRAM,         APP_MEM_TAG_DEBUG },
+    [APP_MEM_ENROLL_UPLOAD]   = { "enroll_upload",  APP_MEM_SPIRAM,         APP_MEM_TAG_RECOGNIZE },
+    [APP_MEM_FRAME_CORPUS]    = { "frame_corpus",   APP_MEM_SPIRAM,         APP_MEM_TAG_DEBUG },
+    [APP_MEM_OTA]             = { "ota",            APP_MEM_INTERNAL,       APP_MEM_TAG_TASKS },
+    [APP_MEM_OTA_INFLATE]     = { "ota_inflate",    APP_MEM_SPIRAM,         APP_MEM_TAG_TASKS },
+};
+
+static const char *s_tag_names[APP_MEM_TAG_MAX] = {
+    [APP_MEM_TAG_CAMERA]      = "camera",
+    [APP_MEM_TAG_PIPELINE]    = "pipeline",
+    [APP_MEM_TAG_DETECT]      = "detect",
+    [APP_MEM_TAG_RECOGNIZE]   = "recognize",
+    [APP_MEM_TAG_FACE_DB]     = "face_db",
+    [APP_MEM_TAG_AUDIO]       = "audio",
+    [APP_MEM_TAG_DISPLAY]     = "display",
+    [APP_MEM_TAG_TASKS]       = "tasks",
+    [APP_MEM_TAG_DEBUG]       = "debug",
+};
+
+static app_mem_usage_t s_usage[APP_MEM_MAX];
+static app_mem_usage_t s_tag_usage[APP_MEM_TAG_MAX];
+static portMUX_TYPE s_usage_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void *mem_alloc_in(app_mem_region_t region, size_t size)
+{
+    if (region == APP_MEM_SPIRAM)
+    {
+        return heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    }
+    // WiFi, lwIP and the socket buffers only ever come from internal RAM
+    if (heap_caps_get_free_size(MALLOC_CAP_INTERNAL) < size + MEM_INTERNAL_RESERVE)
+    {
+        return NULL;
+    }
+    return heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+}
+
+static void mem_usage_add(app_mem_usage_t *usage, app_mem_region_t region, size_t size, bool add)
+{
+    size_t *bytes = region == APP_MEM_INTERNAL ? &usage->internal : &usage->spiram;
+    size_t *peak = region == APP_MEM_INTERNAL ? &usage->peak_internal : &usage->peak_spiram;
+
+    *bytes = add ? *bytes + size : *bytes - size;
+    if (*bytes > *peak)
+    {
+        *peak = *bytes;
+    }
+    if (add)
+    {
+        usage->allocs++;
+    }
+    else
+    {
+        usage->frees++;
+    }
+}
+
+void app_mem_account(app_mem_id_t id, app_mem_region_t region, size_t size, bool add)
+{
+    portENTER_CRITICAL(&s_usage_mux);
+    mem_usage_add(&s_usage[id], region, size, add);
+    mem_usage_add(&s_tag_usage[s_buffers[id].tag], region, size, add);
+    portEXIT_CRITICAL(&s_usage_mux);
+}
+
+const app_mem_desc_t *app_mem_desc(app_mem_id_t id)
+{
+    return &s_buffers[id];
+}
+
+const char *app_mem_tag_name(app_mem_tag_t tag)
+{
+    return s_tag_names[tag];
+}
+
+void app_mem_get_usage(app_mem_id_t id, app_mem_usage_t *usage)
+{
+    portENTER_CRITICAL(&s_usage_mux);
+    *usage = s_usage[id];
+    portEXIT_CRITICAL(&s_usage_mux);
+}
+
+void app_mem_get_tag_usage(app_mem_tag_t tag, app_mem_usage_t *usage)
+{
+    portENTER_CRITICAL(&s_usage_mux);
+    *usage = s_tag_usage[tag];
+    portEXIT_CRITICAL(&s_usage_mux);
+}
+
+void *app_mem_alloc(app_mem_id_t id, size_t size)
+{
+    const app_mem_desc_t *desc = &s_buffers[id];
+    app_mem_region_t region = desc->region;
+
+    void *ptr = mem_alloc_in(region, size);
+    if (!ptr)
+    {
+        region = region == APP_MEM_INTERNAL ? APP_MEM_SPIRAM : APP_MEM_INTERNAL;
+        ptr = mem_alloc_in(region, size);
+        if (ptr)
+        {
+            portENTER_CRITICAL(&s_usage_mux);
+            s_usage[id].fallbacks++;
+            s_tag_usage[desc->tag].fallbacks++;
+            portEXIT_CRITICAL(&s_usage_mux);
+            ESP_LOGW(TAG, "%s: no room for %u bytes in %s RAM", desc->name, size,
+                     desc->region == APP_MEM_INTERNAL ? "internal" : "PSRAM");
+        }
+    }
+    if (!ptr)
+    {
+#ifdef CONFIG_RTC_LOG
+        app_rtclog_event(RTCLOG_ALLOC_FAIL, 0, id, size);
+#endif
+        return NULL;
+    }
+    app_mem_account(id, region, size, true);
+    ESP_LOGI(TAG, "%s: %u bytes in %s", desc->name, size, region == APP_MEM_INTERNAL ? "internal RAM" : "PSRAM");
+    return ptr;
+}
+
+void app_mem_free(app_mem_id_t id, void *ptr, size_t size)
+{
+    if (!ptr)
+    {
+        return;
+    }
+    app_mem_account(id, esp_ptr_external_ram(ptr) ? APP_MEM_SPIRAM : APP_MEM_INTERNAL, size, false);
+    heap_caps_free(ptr);
+}
+
+dl_matrix3du_t *app_mem_matrix_alloc(app_mem_id_t id, int w, int h, int c)
+{
+    dl_matrix3du_t *matrix = (dl_matrix3du_t *)calloc(1, sizeof(dl_matrix3du_t));
+    if (!matrix)
+    {
+        return NULL;
+    }
+    matrix->item = (uc_t *)app_mem_alloc(id, w * h * c);
+    if (!matrix->item)
+    {
+        free(matrix);
+        return NULL;
+    }
+    matrix->w = w;
+    matrix->h = h;
+    matrix->c = c;
+    matrix->n = 1;
+    matrix->stride = w * c;
+    return matrix;
+}
+
+void app_mem_matrix_free(app_mem_id_t id, dl_matrix3du_t *matrix)
+{
+    if (!matrix)
+    {
+        return;
+    }
+    app_mem_free(id, matrix->item, matrix->w * matrix->h * matrix->c);
+    free(matrix);
+}
+
+static cJSON *mem_usage_to_json(const app_mem_usage_t *usage)
+{
+    cJSON *item = cJSON_CreateObject();
+    if (!item)
+    {
+        return NULL;
+    }
+    cJSON_AddNumberToObject(item, "internal", usage->internal);
+    cJSON_AddNumberToObject(item, "spiram", usage->spiram);
+    cJSON_AddNumberToObject(item, "peak_internal", usage->peak_internal);
+    cJSON_AddNumberToObject(item, "peak_spiram", usage->peak_spiram);
+    cJSON_AddNumberToObject(item, "allocs", usage->allocs);
+    cJSON_AddNumberToObject(item, "frees", usage->frees);
+    cJSON_AddNumberToObject(item, "fallbacks", usage->fallbacks);
+    return item;
+}
+
+static cJSON *mem_heap_to_json(uint32_t caps, size_t tracked)
+{
+    multi_heap_info_t info;
+    cJSON *item = cJSON_CreateObject();
+    if (!item)
+    {
+        return NULL;
+    }
+    heap_caps_get_info(&info, caps);
+    cJSON_AddNumberToObject(item, "allocated", info.total_allocated_bytes);
+    cJSON_AddNumberToObject(item, "free", info.total_free_bytes);
+    cJSON_AddNumberToObject(item, "min_free", info.minimum_free_bytes);
+    cJSON_AddNumberToObject(item, "largest", info.largest_free_block);
+    // WiFi, lwIP, FreeRTOS objects and whatever else did not go through app_mem
+    cJSON_AddNumberToObject(item, "untracked", (double)info.total_allocated_bytes - tracked);
+    return item;
+}
+
+char *app_mem_to_json()
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON *heaps = cJSON_CreateObject();
+    cJSON *tags = cJSON_CreateObject();
+    cJSON *buffers = cJSON_CreateObject();
+    app_mem_usage_t usage;
+    size_t internal = 0;
+    size_t spiram = 0;
+    char *json = NULL;
+
+    if (!root || !heaps || !tags || !buffers)
+    {
+        cJSON_Delete(heaps);
+        cJSON_Delete(tags);
+        cJSON_Delete(buffers);
+        goto out;
+    }
+    cJSON_AddItemToObject(root, "heaps", heaps);
+    cJSON_AddItemToObject(root, "tags", tags);
+    cJSON_AddItemToObject(root, "buffers", buffers);
+
+    for (int i = 0; i < APP_MEM_TAG_MAX; i++)
+    {
+        app_mem_get_tag_usage(i, &usage);
+        internal += usage.internal;
+        spiram += usage.spiram;
+        cJSON_AddItemToObject(tags, s_tag_names[i], mem_usage_to_json(&usage));
+    }
+    for (int i = 0; i < APP_MEM_MAX; i++)
+    {
+        app_mem_get_usage(i, &usage);
+        cJSON *item = mem_usage_to_json(&usage);
+        if (item)
+        {
+            cJSON_AddStringToObject(item, "tag", s_tag_names[s_buffers[i].tag]);
+        }
+        cJSON_AddItemToObject(buffers, s_buffers[i].name, item);
+    }
+    cJSON_AddItemToObject(heaps, "internal", mem_heap_to_json(MALLOC_CAP_INTERNAL, internal));
+    cJSON_AddItemToObject(heaps, "spiram", mem_heap_to_json(MALLOC_CAP_SPIRAM, spiram));
+    json = cJSON_PrintUnformatted(root);
+
+out:
+    cJSON_Delete(root);
+    return json;
+}
@@ -0,0 +1,431 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "app_metrics.h"
+#include "app_pipeline.h"
+#include "app_stream.h"
+#include "app_speech_srcif.h"
+#include "app_mem.h"
+#include "app_boot.h"
+#include "app_shed.h"
+#include "app_event.h"
+#include "app_battery.h"
+#include "app_himem.h"
+
+#define METRICS_BUCKETS     (METRIC_BUCKETS - 1)
+#define METRICS_LINE_LEN    1024
+
+typedef struct {
+    const char *name;
+    const char *help;
+    uint32_t count[METRICS_BUCKETS + 1];   /* the last bucket is +Inf */
+    uint32_t sum_ms;
+} metric_histogram_t;
+
+/* Upper bounds in milliseconds */
+static const uint32_t s_bounds[METRICS_BUCKETS] = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000 };
+
+static metric_histogram_t s_histograms[METRIC_MAX] = {
+    [METRIC_CAPTURE_WAIT] = { "who_capture_wait_ms", "Time from capture until detection starts" },
+    [METRIC_DECODE]       = { "who_decode_ms", "JPEG decode for the detector" },
+    [METRIC_DETECT]       = { "who_detect_ms", "Face detection" },
+    [METRIC_RECOGNIZE]    = { "who_recognize_ms", "Face alignment, recognition and overlays" },
+    [METRIC_ENCODE]       = { "who_encode_ms", "JPEG encode of frames with overlays" },
+    [METRIC_SEND]         = { "who_send_ms", "Sending one frame to one viewer" },
+    [METRIC_LATENCY]      = { "who_latency_ms", "Time from the end of the sensor frame until it is handed to viewers" },
+    [METRIC_FRAME]        = { "who_frame_interval_ms", "Interval between streamed frames" },
+    [METRIC_SPEECH_DETECT] = { "who_speech_detect_ms", "Wake word model on one audio chunk" },
+    [METRIC_WAKE_LATENCY] = { "who_speech_wake_latency_ms", "Time from the end of a word until it was recognized" },
+    [METRIC_THUMBNAIL]    = { "who_oled_thumbnail_ms", "Dithering the OLED thumbnail, without the I2C transfer" },
+    [METRIC_CAPTURE_RECOVERY] = { "who_capture_recovery_ms", "Failed capture until the camera driver was started again" },
+};
+
+void IRAM_ATTR app_metrics_observe(metric_id_t id, int64_t us)
+{
+    metric_histogram_t *h = &s_histograms[id];
+    uint32_t ms = us > 0 ? us / 1000 : 0;
+    int i = 0;
+
+    while (i < METRICS_BUCKETS && ms > s_bounds[i])
+    {
+        i++;
+    }
+    __atomic_fetch_add(&h->count[i], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sum_ms, ms, __ATOMIC_RELAXED);
+}
+
+void app_metrics_snapshot(metric_id_t id, metric_snapshot_t *snapshot)
+{
+    for (int i = 0; i < METRIC_BUCKETS; i++)
+    {
+        snapshot->count[i] = __atomic_load_n(&s_histograms[id].count[i], __ATOMIC_RELAXED);
+    }
+}
+
+uint32_t app_metrics_percentile(const metric_snapshot_t *from, const metric_snapshot_t *to, int pct)
+{
+    uint32_t total = 0;
+    uint32_t below = 0;
+
+    for (int i = 0; i < METRIC_BUCKETS; i++)
+    {
+        total += to->count[i] - from->count[i];
+    }
+    if (total == 0)
+    {
+        return 0;
+    }
+    float rank = total * pct / 100.0f;
+    for (int i = 0; i < METRICS_BUCKETS; i++)
+    {
+        uint32_t n = to->count[i] - from->count[i];
+        if (n && below + n >= rank)
+        {
+            uint32_t lower = i ? s_bounds[i - 1] : 0;
+            return (lower + (s_bounds[i] - lower) * (rank - below) / n) * 1000;
+        }
+        below += n;
+    }
+    return s_bounds[METRICS_BUCKETS - 1] * 1000;
+}
+
+static esp_err_t metrics_write_histogram(metric_histogram_t *h, char *buf, metrics_write_cb write, void *arg)
+{
+    uint32_t total = 0;
+    int n = snprintf(buf, METRICS_LINE_LEN, "# HELP %s %s\n# TYPE %s histogram\n", h->name, h->help, h->name);
+
+    for (int i = 0; i <= METRICS_BUCKETS && n < METRICS_LINE_LEN; i++)
+    {
+        total += __atomic_load_n(&h->count[i], __ATOMIC_RELAXED);
+        if (i < METRICS_BUCKETS)
+        {
+            n += snprintf(buf + n, METRICS_LINE_LEN - n, "%s_bucket{le=\"%u\"} %u\n", h->name, s_bounds[i], total);
+        }
+        else
+        {
+            n += snprintf(buf + n, METRICS_LINE_LEN - n, "%s_bucket{le=\"+Inf\"} %u\n", h->name, total);
+        }
+    }
+    if (n < METRICS_LINE_LEN)
+    {
+        n += snprintf(buf + n, METRICS_LINE_LEN - n, "%s_sum %u\n%s_count %u\n",
+                h->name, __atomic_load_n(&h->sum_ms, __ATOMIC_RELAXED), h->name, total);
+    }
+    return write(arg, buf, n < METRICS_LINE_LEN ? n : METRICS_LINE_LEN - 1);
+}
+
+esp_err_t app_metrics_write(metrics_write_cb write, void *arg)
+{
+    char buf[METRICS_LINE_LEN];
+    esp_err_t res = ESP_OK;
+    pipeline_depths_t depths;
+    speech_stats_t speech;
+
+    for (int i = 0; i < METRIC_MAX && res == ESP_OK; i++)
+    {
+        res = metrics_write_histogram(&s_histograms[i], buf, write, arg);
+    }
+    if (res != ESP_OK)
+    {
+        return res;
+    }
+
+    app_pipeline_get_depths(&depths);
+    int n = snprintf(buf, sizeof(buf),
+            "# TYPE who_queue_depth gauge\n"
+            "who_queue_depth{queue=\"free\"} %d\n"
+            "who_queue_depth{queue=\"detect\"} %d\n"
+            "who_queue_depth{queue=\"encode\"} %d\n"
+            "who_queue_depth{queue=\"send\"} %d\n"
+            "# TYPE who_heap_free_bytes gauge\n"
+            "who_heap_free_bytes{heap=\"internal\"} %u\n"
+            "who_heap_free_bytes{heap=\"spiram\"} %u\n"
+            "# TYPE who_heap_min_free_bytes gauge\n"
+            "who_heap_min_free_bytes{heap=\"internal\"} %u\n"
+            "who_heap_min_free_bytes{heap=\"spiram\"} %u\n"
+            "# TYPE who_heap_largest_free_block_bytes gauge\n"
+            "who_heap_largest_free_block_bytes{heap=\"internal\"} %u\n"
+            "who_heap_largest_free_block_bytes{heap=\"spiram\"} %u\n"
+            "# TYPE who_stream_viewers gauge\n"
+            "who_stream_viewers %d\n"
+            "# TYPE who_stream_dropped_frames_total counter\n"
+            "who_stream_dropped_frames_total %u\n"
+            "# TYPE who_camera_stale_frames_total counter\n"
+            "who_camera_stale_frames_total %u\n"
+            "# TYPE who_uptime_seconds counter\n"
+            "who_uptime_seconds %u\n",
+            depths.free, depths.detect, depths.encode, depths.send,
+            heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+            heap_caps_get_free_size(MALLOC_CAP_SPIRAM),
+            heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL),
+            heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM),
+            heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL),
+            heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM),
+            app_stream_client_count(),
+            app_stream_dropped_frames(),
+            app_pipeline_stale_frames(),
+            (uint32_t)(esp_timer_get_time() / 1000000));
+    res = write(arg, buf, n < sizeof(buf) ? n : sizeof(buf) - 1);
+    if (res != ESP_OK)
+    {
+        return res;
+    }
+
+    app_speech_get_stats(&speech);
+    n = snprintf(buf, sizeof(buf),
+            "# TYPE who_speech_i2s_overruns_total counter\n"
+            "who_speech_i2s_overruns_total %u\n"
+            "# TYPE who_speech_ring_overruns_total counter\n"
+            "who_speech_ring_overruns_total %u\n"
+            "# TYPE who_speech_ring_high_water_chunks gauge\n"
+            "who_speech_ring_high_water_chunks %u\n"
+            "# TYPE who_speech_ring_chunks gauge\n"
+            "who_speech_ring_chunks %u\n"
+            "# TYPE who_speech_chunks_total counter\n"
+            "who_speech_chunks_total{result=\"detected\"} %u\n"
+            "who_speech_chunks_total{result=\"silent\"} %u\n"
+            "who_speech_chunks_total{result=\"late\"} %u\n"
+            "# HELP who_speech_model_info Wake word model, detection mode and chunk size\n"
+            "# TYPE who_speech_model_info gauge\n"
+            "who_speech_model_info{model=\"%s\",det_mode=\"%d\",chunk_ms=\"%u\"} 1\n"
+            "# HELP who_speech_cpu_percent Mean model time per chunk over the audio it covers\n"
+            "# TYPE who_speech_cpu_percent gauge\n"
+            "who_speech_cpu_percent %u\n",
+            speech.i2s_overruns, speech.ring_overruns, speech.ring_high_water, speech.ring_chunks,
+            speech.detected, speech.silent, speech.late,
+            speech.model ? speech.model : "", speech.det_mode, speech.chunk_us / 1000,
+            speech.chunk_us ? speech.detect_us * 100 / speech.chunk_us : 0);
+    res = write(arg, buf, n < sizeof(buf) ? n : sizeof(buf) - 1);
+
+    // current bytes first, then the peaks, each metric's lines stay together
+    for (int peak = 0; peak < 2 && res == ESP_OK; peak++)
+    {
+        const char *metric = peak ? "who_buffer_peak_bytes" : "who_buffer_bytes";
+
+        n = snprintf(buf, sizeof(buf), "# TYPE %s gauge\n", metric);
+        for (int i = 0; i < APP_MEM_MAX && res == ESP_OK; i++)
+        {
+            app_mem_usage_t usage;
+            const app_mem_desc_t *desc = app_mem_desc(i);
+            const char *tag = app_mem_tag_name(desc->tag);
+
+            app_mem_get_usage(i, &usage);
+            n += snprintf(buf + n, sizeof(buf) - n,
+                    "%s{buffer=\"%s\",tag=\"%s\",heap=\"internal\"} %u\n"
+                    "%s{buffer=\"%s\",tag=\"%s\",heap=\"spiram\"} %u\n",
+                    metric, desc->name, tag, peak ? usage.peak_internal : usage.internal,
+                    metric, desc->name, tag, peak ? usage.peak_spiram : usage.spiram);
+            res = write(arg, buf, n < sizeof(buf) ? n : sizeof(buf) - 1);
+            n = 0;
+        }
+    }
+    if (res != ESP_OK)
+    {
+        return res;
+    }
+
+    n = snprintf(buf, sizeof(buf), "# TYPE who_pipeline_dropped_frames_total counter\n");
+    for (int i = FRAME_DROP_NONE + 1; i < FRAME_DROP_MAX; i++)
+    {
+        n += snprintf(buf + n, sizeof(buf) - n, "who_pipeline_dropped_frames_total{reason=\"%s\"} %u\n",
+                app_pipeline_drop_name(i), app_pipeline_dropped_frames(i));
+    }
+    res = write(arg, buf, n < sizeof(buf) ? n : sizeof(buf) - 1);
+    if (res != ESP_OK)
+    {
+        return res;
+    }
+
+    n = snprintf(buf, sizeof(buf),
+            "# HELP who_shed_level Load shedding level, 0 is full load\n"
+            "# TYPE who_shed_level gauge\n"
+            "who_shed_level{level=\"%s\"} %d\n"
+            "# TYPE who_shed_steps_total counter\n"
+            "who_shed_steps_total{direction=\"shed\"} %u\n"
+            "who_shed_steps_total{direction=\"recover\"} %u\n",
+            app_shed_level_name(app_shed_level()), app_shed_level(),
+            app_shed_steps(true), app_shed_steps(false));
+    res = write(arg, buf, n < sizeof(buf) ? n : sizeof(buf) - 1);
+    if (res != ESP_OK)
+    {
+        return res;
+    }
+
+#ifdef CONFIG_CLIP_HIMEM
+    himem_stats_t himem;
+    app_himem_get_stats(&himem);
+    n = snprintf(buf, sizeof(buf),
+            "# HELP who_himem_bytes PSRAM above 4 MB taken by the himem store\n"
+            "# TYPE who_himem_bytes gauge\n"
+            "who_himem_bytes{use=\"total\"} %u\n"
+            "who_himem_bytes{use=\"reserved\"} %u\n"
+            "# TYPE who_himem_block_accesses_total counter\n"
+            "who_himem_block_accesses_total{result=\"hit\"} %u\n"
+            "who_himem_block_accesses_total{result=\"remap\"} %u\n",
+            himem.size, himem.reserved, himem.hits, himem.misses);
+    res = write(arg, buf, n < sizeof(buf) ? n : sizeof(buf) - 1);
+    if (res != ESP_OK)
+    {
+        return res;
+    }
+#endif
+
+    en_fsm_state current = app_event_state();
+    n = snprintf(buf, sizeof(buf),
+            "# HELP who_state Current state of the state machine\n"
+            "# TYPE who_state gauge\n");
+    for (int i = 0; i < APP_STATE_MAX; i++)
+    {
+        n += snprintf(buf + n, sizeof(buf) - n, "who_state{state=\"%s\"} %d\n", app_event_state_name(i), i == current);
+    }
+    n += snprintf(buf + n, sizeof(buf) - n,
+            "# HELP who_state_dwell_ms_total Time spent in a state, including the current visit\n"
+            "# TYPE who_state_dwell_ms_total counter\n");
+    for (int i = 0; i < APP_STATE_MAX; i++)
+    {
+        app_state_stats_t stats;
+
+        app_event_get_state_stats(i, &stats);
+        n += snprintf(buf + n, sizeof(buf) - n, "who_state_dwell_ms_total{state=\"%s\"} %lld\n",
+                app_event_state_name(i), stats.total_us / 1000);
+    }
+    res = write(arg, buf, n < sizeof(buf) ? n : sizeof(buf) - 1);
+    if (res != ESP_OK)
+    {
+        return res;
+    }
+
+    n = snprintf(buf, sizeof(buf),
+            "# TYPE who_state_entries_total counter\n");
+    for (int i = 0; i < APP_STATE_MAX; i++)
+    {
+        app_state_stats_t stats;
+
+        app_event_get_state_stats(i, &stats);
+        n += snprintf(buf + n, sizeof(buf) - n, "who_state_entries_total{state=\"%s\"} %u\n",
+                app_event_state_name(i), stats.entries);
+    }
+    n += snprintf(buf + n, sizeof(buf) - n,
+            "# HELP who_state_dwell_max_ms Longest visit of a state\n"
+            "# TYPE who_state_dwell_max_ms gauge\n");
+    for (int i = 0; i < APP_STATE_MAX; i++)
+    {
+        app_state_stats_t stats;
+
+        app_event_get_state_stats(i, &stats);
+        n += snprintf(buf + n, sizeof(buf) - n, "who_state_dwell_max_ms{state=\"%s\"} %lld\n",
+                app_event_state_name(i), stats.max_us / 1000);
+    }
+    res = write(arg, buf, n < sizeof(buf) ? n : sizeof(buf) - 1);
+    if (res != ESP_OK)
+    {
+        return res;
+    }
+
+    // one line per transition seen, most of the pairs never happen
+    n = snprintf(buf, sizeof(buf), "# TYPE who_state_transitions_total counter\n");
+    for (int from = 0; from < APP_STATE_MAX && res == ESP_OK; from++)
+    {
+        for (int to = 0; to < APP_STATE_MAX; to++)
+        {
+            uint32_t count = app_event_transitions(from, to);
+            if (count)
+            {
+                n += snprintf(buf + n, sizeof(buf) - n, "who_state_transitions_total{from=\"%s\",to=\"%s\"} %u\n",
+                        app_event_state_name(from), app_event_state_name(to), count);
+            }
+        }
+        // an empty chunk would end the response
+        if (n > 0)
+        {
+            res = write(arg, buf, n < sizeof(buf) ? n : sizeof(buf) - 1);
+            n = 0;
+        }
+    }
+    if (res != ESP_OK)
+    {
+        return res;
+    }
+
+#ifdef CONFIG_BATTERY_GOVERNOR
+    battery_status_t battery;
+
+    app_battery_get(&battery);
+    if (battery.valid)
+    {
+        n = snprintf(buf, sizeof(buf),
+                "# HELP who_battery_percent IP5306 fuel gauge, in steps of 25\n"
+                "# TYPE who_battery_percent gauge\n"
+                "who_battery_percent %u\n"
+                "# TYPE who_battery_charging gauge\n"
+                "who_battery_charging %d\n"
+                "# HELP who_battery_governor Battery governor level, 0 is full power\n"
+                "# TYPE who_battery_governor gauge\n"
+                "who_battery_governor{level=\"%s\"} %d\n",
+                battery.percent, battery.charging,
+                app_battery_level_name(battery.level), battery.level);
+        res = write(arg, buf, n < sizeof(buf) ? n : sizeof(buf) - 1);
+        if (res != ESP_OK)
+        {
+            return res;
+        }
+    }
+#endif
+
+    n = snprintf(buf, sizeof(buf),
+            "# HELP who_boot_phase_start_ms Time from timer start until a boot phase began\n"
+            "# TYPE who_boot_phase_start_ms gauge\n");
+    for (int i = 0; i < BOOT_PHASE_MAX; i++)
+    {
+        int64_t start, end;
+
+        if (app_boot_get(i, &start, &end))
+        {
+            n += snprintf(buf + n, sizeof(buf) - n, "who_boot_phase_start_ms{phase=\"%s\"} %u\n",
+                    app_boot_phase_name(i), (uint32_t)(start / 1000));
+        }
+    }
+    res = write(arg, buf, n < sizeof(buf) ? n : sizeof(buf) - 1);
+    if (res != ESP_OK)
+    {
+        return res;
+    }
+
+    n = snprintf(buf, sizeof(buf),
+            "# HELP who_boot_phase_ms Duration of a boot phase, phases may overlap\n"
+            "# TYPE who_boot_phase_ms gauge\n");
+    for (int i = 0; i < BOOT_PHASE_MAX; i++)
+    {
+        int64_t start, end;
+
+        if (app_boot_get(i, &start, &end))
+        {
+            n += snprintf(buf + n, sizeof(buf) - n, "who_boot_phase_ms{phase=\"%s\"} %u\n",
+                    app_boot_phase_name(i), (uint32_t)((end - start) / 1000));
+        }
+    }
+    return write(arg, buf, n < sizeof(buf) ? n : sizeof(buf) - 1);
+}
@@ -0,0 +1,163 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "driver/gpio.h"
+#include "dl_lib_matrix3d.h"
+#include "app_motion.h"
+#include "app_image.h"
+#include "app_main.h"
+#include "app_pir.h"
+#include "app_mem.h"
+
+static const char *TAG = "app_motion";
+
+#define MOTION_SCALE        8
+#define MOTION_BLOCKS       (MOTION_GRID_W * MOTION_GRID_H)
+
+static dl_matrix3du_t *s_luma_matrix = NULL;
+static size_t s_luma_pixels = 0;
+static uint8_t s_blocks[MOTION_BLOCKS];
+static bool s_has_blocks = false;
+static int s_hold = 0;
+#ifdef CONFIG_MOTION_USE_PIR
+static volatile bool s_pir_triggered = false;
+static bool s_pir_subscribed = false;
+
+static void motion_pir_event(const pir_event_t *event, void *arg)
+{
+    if (event->level)
+    {
+        s_pir_triggered = true;
+    }
+}
+#endif
+
+static void motion_blocks(dl_matrix3du_t *m, uint8_t *blocks)
+{
+    uint32_t sum[MOTION_BLOCKS] = {0};
+    uint32_t count[MOTION_BLOCKS] = {0};
+    const uint8_t *p = m->item;
+
+    for (int y = 0; y < m->h; y++)
+    {
+        int by = y * MOTION_GRID_H / m->h;
+        for (int x = 0; x < m->w; x++, p += 3)
+        {
+            int b = by * MOTION_GRID_W + x * MOTION_GRID_W / m->w;
+            // BGR888 to luma, BT.601 weights
+            sum[b] += (p[0] * 29 + p[1] * 150 + p[2] * 77) >> 8;
+            count[b]++;
+        }
+    }
+    for (int b = 0; b < MOTION_BLOCKS; b++)
+    {
+        blocks[b] = count[b] ? sum[b] / count[b] : 0;
+    }
+}
+
+bool app_motion_detect(camera_fb_t *fb)
+{
+    uint8_t blocks[MOTION_BLOCKS];
+    int changed = 0;
+    size_t w = fb->width / MOTION_SCALE;
+    size_t h = fb->height / MOTION_SCALE;
+
+#ifdef CONFIG_MOTION_USE_PIR
+    // a pulse shorter than a frame still counts
+    if (s_pir_triggered || app_pir_active())
+    {
+        s_pir_triggered = false;
+        s_hold = MOTION_HOLD_FRAMES;
+    }
+#endif
+
+    if (!s_luma_matrix || w * h > s_luma_pixels || w < MOTION_GRID_W || h < MOTION_GRID_H)
+    {
+        return true;
+    }
+    s_luma_matrix->w = w;
+    s_luma_matrix->h = h;
+    s_luma_matrix->stride = w * 3;
+    if (!app_image_decode_scaled(fb, MOTION_SCALE, s_luma_matrix))
+    {
+        s_has_blocks = false;
+        return true;
+    }
+
+    motion_blocks(s_luma_matrix, blocks);
+    if (s_has_blocks)
+    {
+        for (int b = 0; b < MOTION_BLOCKS; b++)
+        {
+            if (abs(blocks[b] - s_blocks[b]) > CONFIG_MOTION_THRESHOLD)
+            {
+                changed++;
+            }
+        }
+        if (changed >= CONFIG_MOTION_BLOCKS)
+        {
+            ESP_LOGD(TAG, "Motion in %d blocks", changed);
+            s_hold = MOTION_HOLD_FRAMES;
+        }
+    }
+    else
+    {
+        s_hold = MOTION_HOLD_FRAMES;
+    }
+    memcpy(s_blocks, blocks, sizeof(s_blocks));
+    s_has_blocks = true;
+
+    if (s_hold > 0)
+    {
+        s_hold--;
+        return true;
+    }
+    return false;
+}
+
+esp_err_t app_motion_init(framesize_t frame_size)
+{
+    size_t width, height;
+
+    app_camera_get_resolution(frame_size, &width, &height);
+    if (s_luma_matrix)
+    {
+        app_mem_matrix_free(APP_MEM_MOTION, s_luma_matrix);
+    }
+    s_luma_matrix = app_mem_matrix_alloc(APP_MEM_MOTION, width / MOTION_SCALE, height / MOTION_SCALE, 3);
+    if (!s_luma_matrix)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    s_luma_pixels = (width / MOTION_SCALE) * (height / MOTION_SCALE);
+    s_has_blocks = false;
+    s_hold = MOTION_HOLD_FRAMES;
+#ifdef CONFIG_MOTION_USE_PIR
+    if (!s_pir_subscribed)
+    {
+        s_pir_subscribed = app_pir_subscribe(motion_pir_event, NULL) == ESP_OK;
+    }
+#endif
+    return ESP_OK;
+}
@@ -0,0 +1,396 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "app_offload.h"
+#include "app_tasks.h"
+#include "app_mem.h"
+
+#ifdef CONFIG_OFFLOAD_INFERENCE
+static const char *TAG = "app_offload";
+
+#define OFFLOAD_BUF_LEN         (CONFIG_OFFLOAD_FRAME_KB * 1024)
+#define OFFLOAD_RECONNECT_MS    5000
+/* An answer slower than this is taken as a lost connection */
+#define OFFLOAD_TIMEOUT_MS      1000
+/* Answers in a row within the limits before detection moves to the server */
+#define OFFLOAD_GOOD_ANSWERS    5
+#define OFFLOAD_HEADER_LEN      12
+#define OFFLOAD_FACE_LEN        11
+
+typedef struct {
+    uint16_t width;         /* of the frame the faces were found in, 0 before the first answer */
+    uint16_t height;
+    int count;
+    int ids[PIPELINE_MAX_FACES];
+    float similarity[PIPELINE_MAX_FACES];
+    box_t boxes[PIPELINE_MAX_FACES];
+    int64_t time;
+} offload_faces_t;
+
+static struct sockaddr_in s_addr;
+static uint8_t *s_buf = NULL;
+static size_t s_len = 0;
+static uint32_t s_seq = 0;
+static uint16_t s_width = 0;
+static uint16_t s_height = 0;
+static SemaphoreHandle_t s_ready = NULL;
+static bool s_busy = false;             /* a frame is in s_buf or on its way */
+static int64_t s_last_submit = 0;
+static offload_faces_t s_faces;
+static offload_stats_t s_stats;
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static uint8_t *offload_put16(uint8_t *p, uint16_t v)
+{
+    *p++ = v >> 8;
+    *p++ = v;
+    return p;
+}
+
+static uint8_t *offload_put32(uint8_t *p, uint32_t v)
+{
+    p = offload_put16(p, v >> 16);
+    return offload_put16(p, v);
+}
+
+static int16_t offload_get16(const uint8_t *p)
+{
+    return (int16_t)((p[0] << 8) | p[1]);
+}
+
+static bool offload_send(int sock, const uint8_t *buf, size_t len)
+{
+    while (len > 0)
+    {
+        int n = send(sock, buf, len, 0);
+        if (n <= 0)
+        {
+            return false;
+        }
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool offload_recv(int sock, uint8_t *buf, size_t len)
+{
+    while (len > 0)
+    {
+        int n = recv(sock, buf, len, 0);
+        if (n <= 0)
+        {
+            return false;
+        }
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+static int offload_connect()
+{
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0)
+    {
+        return -1;
+    }
+    struct timeval timeout = {
+        .tv_sec = OFFLOAD_TIMEOUT_MS / 1000,
+        .tv_usec = (OFFLOAD_TIMEOUT_MS % 1000) * 1000,
+    };
+    int nodelay = 1;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    if (connect(sock, (struct sockaddr *)&s_addr, sizeof(s_addr)) != 0)
+    {
+        close(sock);
+        return -1;
+    }
+    ESP_LOGI(TAG, "Connected to %s:%d", CONFIG_OFFLOAD_HOST, CONFIG_OFFLOAD_PORT);
+    return sock;
+}
+
+/* Takes detection back to the device, called when the link got worse or broke */
+static void offload_fall_back(const char *reason)
+{
+    portENTER_CRITICAL(&s_mux);
+    bool active = s_stats.active;
+    s_stats.active = false;
+    if (active)
+    {
+        s_stats.fallbacks++;
+    }
+    portEXIT_CRITICAL(&s_mux);
+    if (active)
+    {
+        ESP_LOGW(TAG, "Detecting on the device again, %s", reason);
+    }
+}
+
+/* Reads the answer to the frame just sent, the faces are kept for the frames that follow */
+static bool offload_recv_faces(int sock, uint32_t seq, uint16_t width, uint16_t height)
+{
+    uint8_t header[5];
+    uint8_t face[OFFLOAD_FACE_LEN];
+    offload_faces_t faces = {
+        .width = width,
+        .height = height,
+    };
+
+    if (!offload_recv(sock, header, sizeof(header)))
+    {
+        return false;
+    }
+    uint32_t answer = (header[0] << 24) | (header[1] << 16) | (header[2] << 8) | header[3];
+    if (answer != seq)
+    {
+        ESP_LOGE(TAG, "Answer to frame %u while waiting for %u", answer, seq);
+        return false;
+    }
+    for (int i = 0; i < header[4]; i++)
+    {
+        if (!offload_recv(sock, face, sizeof(face)))
+        {
+            return false;
+        }
+        // faces beyond what a frame holds are read and dropped
+        if (faces.count == PIPELINE_MAX_FACES)
+        {
+            continue;
+        }
+        faces.ids[faces.count] = offload_get16(face);
+        faces.similarity[faces.count] = face[2] / 100.0f;
+        for (int j = 0; j < 4; j++)
+        {
+            faces.boxes[faces.count].box_p[j] = offload_get16(face + 3 + 2 * j);
+        }
+        faces.count++;
+    }
+    faces.time = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_mux);
+    s_faces = faces;
+    portEXIT_CRITICAL(&s_mux);
+    return true;
+}
+
+/* Sends the submitted frame and waits for its answer, false once the connection is unusable */
+static bool offload_exchange(int sock, int *good)
+{
+    uint8_t header[OFFLOAD_HEADER_LEN];
+
+    xSemaphoreTake(s_ready, portMAX_DELAY);
+    uint8_t *p = offload_put32(header, s_seq);
+    p = offload_put16(p, s_width);
+    p = offload_put16(p, s_height);
+    offload_put32(p, s_len);
+
+    int64_t start = esp_timer_get_time();
+    bool ok = offload_send(sock, header, sizeof(header)) && offload_send(sock, s_buf, s_len);
+    int64_t sent = esp_timer_get_time();
+    ok = ok && offload_recv_faces(sock, s_seq, s_width, s_height);
+    int64_t done = esp_timer_get_time();
+    size_t len = s_len;
+
+    portENTER_CRITICAL(&s_mux);
+    s_busy = false;
+    if (ok)
+    {
+        uint32_t rtt_ms = (done - start) / 1000;
+        uint32_t kbps = sent > start ? len * 8 * 1000LL / (sent - start) : 0;
+        // means over about 8 frames, the first answer sets them
+        s_stats.rtt_ms = s_stats.answered ? s_stats.rtt_ms + ((int32_t)(rtt_ms - s_stats.rtt_ms) >> 3) : rtt_ms;
+        s_stats.kbps = s_stats.answered ? s_stats.kbps + ((int32_t)(kbps - s_stats.kbps) >> 3) : kbps;
+        s_stats.sent++;
+        s_stats.answered++;
+    }
+    bool fast = s_stats.rtt_ms <= CONFIG_OFFLOAD_MAX_RTT_MS && s_stats.kbps >= CONFIG_OFFLOAD_MIN_KBPS;
+    bool activated = false;
+    *good = ok && fast ? *good + 1 : 0;
+    if (!s_stats.active && *good >= OFFLOAD_GOOD_ANSWERS)
+    {
+        s_stats.active = true;
+        activated = true;
+    }
+    portEXIT_CRITICAL(&s_mux);
+
+    if (activated)
+    {
+        ESP_LOGI(TAG, "Detecting on the server, %u ms round trip at %u kbit/s", s_stats.rtt_ms, s_stats.kbps);
+    }
+    else if (ok && !fast)
+    {
+        offload_fall_back("the link is too slow");
+    }
+    return ok;
+}
+
+static void offload_task(void *arg)
+{
+    while (true)
+    {
+        int sock = offload_connect();
+        if (sock >= 0)
+        {
+            int good = 0;
+
+            portENTER_CRITICAL(&s_mux);
+            s_stats.connected = true;
+            s_stats.answered = 0;
+            portEXIT_CRITICAL(&s_mux);
+            while (offload_exchange(sock, &good))
+            {
+            }
+            close(sock);
+            portENTER_CRITICAL(&s_mux);
+            s_stats.connected = false;
+            portEXIT_CRITICAL(&s_mux);
+            offload_fall_back("the server did not answer");
+        }
+        vTaskDelay(OFFLOAD_RECONNECT_MS / portTICK_PERIOD_MS);
+    }
+}
+
+esp_err_t app_offload_init()
+{
+    memset(&s_addr, 0, sizeof(s_addr));
+    s_addr.sin_family = AF_INET;
+    s_addr.sin_port = htons(CONFIG_OFFLOAD_PORT);
+    if (!inet_aton(CONFIG_OFFLOAD_HOST, &s_addr.sin_addr))
+    {
+        ESP_LOGE(TAG, "Invalid inference server address %s", CONFIG_OFFLOAD_HOST);
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_ready = xSemaphoreCreateBinary();
+    s_buf = (uint8_t *)app_mem_alloc(APP_MEM_OFFLOAD, OFFLOAD_BUF_LEN);
+    if (!s_ready || !s_buf)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    return app_task_create(APP_TASK_OFFLOAD, &offload_task, NULL, NULL);
+}
+
+bool app_offload_active()
+{
+    return s_stats.active;
+}
+
+void app_offload_submit(const camera_fb_t *fb, uint32_t seq)
+{
+    int64_t now = esp_timer_get_time();
+
+    if (!s_buf || fb->format != PIXFORMAT_JPEG || fb->len > OFFLOAD_BUF_LEN)
+    {
+        return;
+    }
+    // two detect workers may offer frames at the same time
+    portENTER_CRITICAL(&s_mux);
+    bool take = s_stats.connected && !s_busy
+            && (s_stats.active || now - s_last_submit >= CONFIG_OFFLOAD_PROBE_MS * 1000LL);
+    if (take)
+    {
+        s_busy = true;
+        s_last_submit = now;
+    }
+    portEXIT_CRITICAL(&s_mux);
+    if (!take)
+    {
+        return;
+    }
+
+    memcpy(s_buf, fb->buf, fb->len);
+    s_len = fb->len;
+    s_seq = seq;
+    s_width = fb->width;
+    s_height = fb->height;
+    xSemaphoreGive(s_ready);
+}
+
+void app_offload_get_faces(frame_desc_t *frame)
+{
+    offload_faces_t faces;
+
+    portENTER_CRITICAL(&s_mux);
+    faces = s_faces;
+    portEXIT_CRITICAL(&s_mux);
+
+    frame->face_count = 0;
+    if (!faces.width || !faces.height || esp_timer_get_time() - faces.time > CONFIG_OFFLOAD_MAX_AGE_MS * 1000LL)
+    {
+        return;
+    }
+    // the rate controller may have changed the frame size since
+    float sx = (float)frame->width / faces.width;
+    float sy = (float)frame->height / faces.height;
+    for (int i = 0; i < faces.count; i++)
+    {
+        frame->face_boxes[i].box_p[0] = faces.boxes[i].box_p[0] * sx;
+        frame->face_boxes[i].box_p[1] = faces.boxes[i].box_p[1] * sy;
+        frame->face_boxes[i].box_p[2] = faces.boxes[i].box_p[2] * sx;
+        frame->face_boxes[i].box_p[3] = faces.boxes[i].box_p[3] * sy;
+        frame->face_ids[i] = faces.ids[i];
+        frame->face_similarity[i] = faces.similarity[i];
+    }
+    memset(frame->face_landmarks, 0, faces.count * sizeof(landmark_t));
+    frame->face_count = faces.count;
+    frame->face_id = faces.count ? faces.ids[0] : -1;
+}
+
+void app_offload_get_stats(offload_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_mux);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_mux);
+}
+#else
+esp_err_t app_offload_init()
+{
+    return ESP_OK;
+}
+
+bool app_offload_active()
+{
+    return false;
+}
+
+void app_offload_submit(const camera_fb_t *fb, uint32_t seq)
+{
+}
+
+void app_offload_get_faces(frame_desc_t *frame)
+{
+}
+
+void app_offload_get_stats(offload_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+#endif
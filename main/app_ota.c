@@ -0,0 +1,497 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_partition.h"
+#include "esp_ota_ops.h"
+#include "esp_spi_flash.h"
+#include "esp_http_client.h"
+#include "mbedtls/sha256.h"
+#include "rom/miniz.h"
+#include "cJSON.h"
+#include "sdkconfig.h"
+#include "app_ota.h"
+#include "app_tasks.h"
+#include "app_mem.h"
+
+static const char *TAG = "app_ota";
+
+#define OTA_MAGIC               "WHOD"
+#define OTA_HEADER_LEN          (4 + 4 + 32 + 4 + 32)
+#define OTA_RECORD_LEN          12
+#define OTA_SECTOR              SPI_FLASH_SEC_SIZE
+/* patch bytes per read from the server */
+#define OTA_READ_LEN            1024
+#define OTA_RESTART_MS          2000
+
+typedef enum {
+    PATCH_HEADER,
+    PATCH_RECORD,
+    PATCH_DIFF,
+    PATCH_EXTRA,
+    PATCH_END,              /* the new image is complete */
+} patch_part_t;
+
+/* Kept in internal RAM, flash reads and writes go to and from its buffers */
+typedef struct {
+    const esp_partition_t *old;
+    const esp_partition_t *target;
+    patch_part_t part;
+    uint8_t head[OTA_HEADER_LEN];   /* header or record being collected */
+    size_t head_len;
+    uint32_t old_size;
+    uint32_t new_size;
+    uint8_t new_sha[32];
+    uint32_t diff_left;
+    uint32_t extra_left;
+    int32_t seek;
+    int64_t old_pos;
+    uint32_t old_start;             /* of old_buf, old_len bytes */
+    uint32_t old_len;
+    uint8_t old_buf[OTA_SECTOR];
+    uint8_t sector[OTA_SECTOR];     /* new image bytes not written yet */
+    size_t sector_len;
+    uint32_t written;
+    mbedtls_sha256_context sha;
+} ota_patch_t;
+
+typedef struct {
+    tinfl_decompressor inflator;
+    uint8_t dict[TINFL_LZ_DICT_SIZE];
+} ota_inflate_t;
+
+static ota_status_t s_status = { .state = OTA_IDLE };
+static portMUX_TYPE s_status_mux = portMUX_INITIALIZER_UNLOCKED;
+static char s_url[OTA_URL_MAX];
+
+static inline uint32_t ota_u32(const uint8_t *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void ota_set_state(ota_state_t state, esp_err_t err)
+{
+    portENTER_CRITICAL(&s_status_mux);
+    s_status.state = state;
+    s_status.err = err;
+    portEXIT_CRITICAL(&s_status_mux);
+}
+
+/* SHA-256 of the first len bytes of a partition */
+static esp_err_t ota_partition_sha(const esp_partition_t *partition, uint32_t len, uint8_t *buf, uint8_t sha[32])
+{
+    mbedtls_sha256_context ctx;
+    esp_err_t err = ESP_OK;
+
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts_ret(&ctx, 0);
+    for (uint32_t pos = 0; pos < len && err == ESP_OK; pos += OTA_SECTOR)
+    {
+        uint32_t n = len - pos < OTA_SECTOR ? len - pos : OTA_SECTOR;
+        err = esp_partition_read(partition, pos, buf, n);
+        mbedtls_sha256_update_ret(&ctx, buf, n);
+    }
+    mbedtls_sha256_finish_ret(&ctx, sha);
+    mbedtls_sha256_free(&ctx);
+    return err;
+}
+
+static esp_err_t ota_header(ota_patch_t *p)
+{
+    uint8_t sha[32];
+
+    if (memcmp(p->head, OTA_MAGIC, 4))
+    {
+        ESP_LOGE(TAG, "Not a delta patch");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    p->old_size = ota_u32(p->head + 4);
+    p->new_size = ota_u32(p->head + 40);
+    memcpy(p->new_sha, p->head + 44, 32);
+    if (p->old_size > p->old->size || p->new_size > p->target->size || p->new_size == 0)
+    {
+        ESP_LOGE(TAG, "Images of %u and %u bytes do not fit the slots", p->old_size, p->new_size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    // the patch only applies to the image it was made from
+    esp_err_t err = ota_partition_sha(p->old, p->old_size, p->old_buf, sha);
+    if (err == ESP_OK && memcmp(sha, p->head + 8, 32))
+    {
+        ESP_LOGE(TAG, "Patch made for another image");
+        err = ESP_ERR_INVALID_VERSION;
+    }
+    p->old_len = 0;
+    portENTER_CRITICAL(&s_status_mux);
+    s_status.image_size = p->new_size;
+    portEXIT_CRITICAL(&s_status_mux);
+    return err;
+}
+
+static esp_err_t ota_record(ota_patch_t *p)
+{
+    p->diff_left = ota_u32(p->head);
+    p->extra_left = ota_u32(p->head + 4);
+    p->seek = (int32_t)ota_u32(p->head + 8);
+    if ((uint64_t)p->written + p->sector_len + p->diff_left + p->extra_left > p->new_size)
+    {
+        ESP_LOGE(TAG, "Record past the end of the new image");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
+
+/* Erases and writes one sector, the pipeline gets the CPU back after each one */
+static esp_err_t ota_flush(ota_patch_t *p)
+{
+    esp_err_t err = esp_partition_erase_range(p->target, p->written, OTA_SECTOR);
+    if (err == ESP_OK)
+    {
+        err = esp_partition_write(p->target, p->written, p->sector, p->sector_len);
+    }
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    mbedtls_sha256_update_ret(&p->sha, p->sector, p->sector_len);
+    p->written += p->sector_len;
+    p->sector_len = 0;
+    portENTER_CRITICAL(&s_status_mux);
+    s_status.written = p->written;
+    portEXIT_CRITICAL(&s_status_mux);
+    vTaskDelay(1);
+    return ESP_OK;
+}
+
+static esp_err_t ota_put(ota_patch_t *p, uint8_t byte)
+{
+    p->sector[p->sector_len++] = byte;
+    return p->sector_len == OTA_SECTOR ? ota_flush(p) : ESP_OK;
+}
+
+/* The old byte at old_pos, bytes outside the old image count as 0 as in bspatch */
+static esp_err_t ota_old(ota_patch_t *p, uint8_t *byte)
+{
+    if (p->old_pos < 0 || p->old_pos >= p->old_size)
+    {
+        *byte = 0;
+        return ESP_OK;
+    }
+    if (p->old_pos < p->old_start || p->old_pos >= p->old_start + p->old_len)
+    {
+        p->old_start = p->old_pos & ~(OTA_SECTOR - 1);
+        p->old_len = p->old_size - p->old_start < OTA_SECTOR ? p->old_size - p->old_start : OTA_SECTOR;
+        esp_err_t err = esp_partition_read(p->old, p->old_start, p->old_buf, p->old_len);
+        if (err != ESP_OK)
+        {
+            p->old_len = 0;
+            return err;
+        }
+    }
+    *byte = p->old_buf[p->old_pos - p->old_start];
+    return ESP_OK;
+}
+
+/* The part after a record, or the end once the new image is complete */
+static patch_part_t ota_next(ota_patch_t *p)
+{
+    if (p->diff_left)
+    {
+        return PATCH_DIFF;
+    }
+    if (p->extra_left)
+    {
+        return PATCH_EXTRA;
+    }
+    p->old_pos += p->seek;
+    p->seek = 0;
+    return p->written + p->sector_len == p->new_size ? PATCH_END : PATCH_RECORD;
+}
+
+/* Applies inflated patch bytes as they come */
+static esp_err_t ota_feed(ota_patch_t *p, const uint8_t *data, size_t len)
+{
+    esp_err_t err = ESP_OK;
+
+    while (len > 0 && err == ESP_OK)
+    {
+        switch (p->part)
+        {
+        case PATCH_HEADER:
+        case PATCH_RECORD:
+        {
+            size_t total = p->part == PATCH_HEADER ? OTA_HEADER_LEN : OTA_RECORD_LEN;
+            size_t n = total - p->head_len < len ? total - p->head_len : len;
+            memcpy(p->head + p->head_len, data, n);
+            p->head_len += n;
+            data += n;
+            len -= n;
+            if (p->head_len == total)
+            {
+                p->head_len = 0;
+                err = p->part == PATCH_HEADER ? ota_header(p) : ota_record(p);
+                p->part = p->part == PATCH_HEADER ? PATCH_RECORD : ota_next(p);
+            }
+            break;
+        }
+        case PATCH_DIFF:
+            for (; len > 0 && p->diff_left > 0 && err == ESP_OK; len--, p->diff_left--)
+            {
+                uint8_t old;
+                err = ota_old(p, &old);
+                if (err == ESP_OK)
+                {
+                    err = ota_put(p, old + *data++);
+                }
+                p->old_pos++;
+            }
+            p->part = ota_next(p);
+            break;
+        case PATCH_EXTRA:
+            for (; len > 0 && p->extra_left > 0 && err == ESP_OK; len--, p->extra_left--)
+            {
+                err = ota_put(p, *data++);
+            }
+            p->part = ota_next(p);
+            break;
+        case PATCH_END:
+            // anything after the new image is ignored
+            len = 0;
+            break;
+        }
+    }
+    return err;
+}
+
+static esp_err_t ota_finish(ota_patch_t *p)
+{
+    uint8_t sha[32];
+
+    if (p->part != PATCH_END)
+    {
+        ESP_LOGE(TAG, "Patch ended after %u of %u bytes", p->written + p->sector_len, p->new_size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    esp_err_t err = p->sector_len ? ota_flush(p) : ESP_OK;
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    ota_set_state(OTA_VERIFYING, ESP_OK);
+    mbedtls_sha256_finish_ret(&p->sha, sha);
+    if (memcmp(sha, p->new_sha, 32))
+    {
+        ESP_LOGE(TAG, "New image does not match its SHA-256");
+        return ESP_ERR_INVALID_CRC;
+    }
+    // checks the image headers and its own digest before it becomes the boot image
+    return esp_ota_set_boot_partition(p->target);
+}
+
+static esp_err_t ota_download(ota_patch_t *p, ota_inflate_t *inflate)
+{
+    uint8_t in[OTA_READ_LEN];
+    size_t dict_ofs = 0;
+    tinfl_status status = TINFL_STATUS_NEEDS_MORE_INPUT;
+    esp_http_client_config_t config = {
+        .url = s_url,
+        .timeout_ms = 10000,
+    };
+
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (!client)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = esp_http_client_open(client, 0);
+    if (err == ESP_OK)
+    {
+        int length = esp_http_client_fetch_headers(client);
+        int code = esp_http_client_get_status_code(client);
+        if (code != 200)
+        {
+            ESP_LOGE(TAG, "Server answered %d", code);
+            err = ESP_ERR_NOT_FOUND;
+        }
+        portENTER_CRITICAL(&s_status_mux);
+        s_status.patch_size = length > 0 ? length : 0;
+        portEXIT_CRITICAL(&s_status_mux);
+    }
+
+    tinfl_init(&inflate->inflator);
+    while (err == ESP_OK && status != TINFL_STATUS_DONE)
+    {
+        int n = esp_http_client_read(client, (char *)in, sizeof(in));
+        if (n <= 0)
+        {
+            err = n < 0 ? ESP_FAIL : ESP_ERR_INVALID_SIZE;
+            break;
+        }
+        portENTER_CRITICAL(&s_status_mux);
+        s_status.received += n;
+        portEXIT_CRITICAL(&s_status_mux);
+
+        size_t in_pos = 0;
+        do
+        {
+            size_t in_bytes = n - in_pos;
+            size_t out_bytes = TINFL_LZ_DICT_SIZE - dict_ofs;
+            // the dictionary is also the output, it wraps around
+            status = tinfl_decompress(&inflate->inflator, in + in_pos, &in_bytes, inflate->dict,
+                    inflate->dict + dict_ofs, &out_bytes, TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT);
+            in_pos += in_bytes;
+            err = ota_feed(p, inflate->dict + dict_ofs, out_bytes);
+            dict_ofs = (dict_ofs + out_bytes) & (TINFL_LZ_DICT_SIZE - 1);
+        } while (err == ESP_OK && status == TINFL_STATUS_HAS_MORE_OUTPUT);
+        if (status < 0)
+        {
+            ESP_LOGE(TAG, "Patch is not a zlib stream (%d)", status);
+            err = ESP_ERR_INVALID_RESPONSE;
+        }
+    }
+    esp_http_client_cleanup(client);
+    return err;
+}
+
+/*
+ * Runs below the pipeline stages, detection goes on while the patch is
+ * applied. Flash is written a sector at a time so the caches are off for
+ * one erase and one write at once.
+ */
+static void ota_task(void *arg)
+{
+    ota_patch_t *p = (ota_patch_t *)app_mem_alloc(APP_MEM_OTA, sizeof(ota_patch_t));
+    ota_inflate_t *inflate = (ota_inflate_t *)app_mem_alloc(APP_MEM_OTA_INFLATE, sizeof(ota_inflate_t));
+    esp_err_t err = ESP_ERR_NO_MEM;
+    int64_t start = esp_timer_get_time();
+
+    if (p && inflate)
+    {
+        memset(p, 0, sizeof(*p));
+        p->old = esp_ota_get_running_partition();
+        p->target = esp_ota_get_next_update_partition(NULL);
+        p->part = PATCH_HEADER;
+        mbedtls_sha256_init(&p->sha);
+        mbedtls_sha256_starts_ret(&p->sha, 0);
+        ESP_LOGI(TAG, "Patching %s into %s from %s", p->old->label, p->target->label, s_url);
+        err = ota_download(p, inflate);
+        if (err == ESP_OK)
+        {
+            err = ota_finish(p);
+        }
+        mbedtls_sha256_free(&p->sha);
+    }
+    if (p)
+    {
+        app_mem_free(APP_MEM_OTA, p, sizeof(ota_patch_t));
+    }
+    if (inflate)
+    {
+        app_mem_free(APP_MEM_OTA_INFLATE, inflate, sizeof(ota_inflate_t));
+    }
+
+    if (err == ESP_OK)
+    {
+        ota_set_state(OTA_DONE, ESP_OK);
+        ESP_LOGI(TAG, "Update of %u patch bytes applied in %ums, restarting", s_status.received,
+                (uint32_t)((esp_timer_get_time() - start) / 1000));
+        vTaskDelay(OTA_RESTART_MS / portTICK_PERIOD_MS);
+        esp_restart();
+    }
+    ESP_LOGE(TAG, "Update failed (0x%x)", err);
+    ota_set_state(OTA_FAILED, err);
+    app_task_exit(APP_TASK_OTA);
+}
+
+esp_err_t app_ota_start(const char *url)
+{
+    if (strlen(url) >= OTA_URL_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!esp_ota_get_next_update_partition(NULL))
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    portENTER_CRITICAL(&s_status_mux);
+    bool busy = s_status.state == OTA_DOWNLOADING || s_status.state == OTA_VERIFYING || s_status.state == OTA_DONE;
+    if (!busy)
+    {
+        memset(&s_status, 0, sizeof(s_status));
+        s_status.state = OTA_DOWNLOADING;
+    }
+    portEXIT_CRITICAL(&s_status_mux);
+    if (busy)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    strlcpy(s_url, url, sizeof(s_url));
+    esp_err_t err = app_task_create(APP_TASK_OTA, &ota_task, NULL, NULL);
+    if (err != ESP_OK)
+    {
+        ota_set_state(OTA_FAILED, err);
+    }
+    return err;
+}
+
+void app_ota_get_status(ota_status_t *status)
+{
+    portENTER_CRITICAL(&s_status_mux);
+    *status = s_status;
+    portEXIT_CRITICAL(&s_status_mux);
+}
+
+char *app_ota_to_json()
+{
+    static const char *states[] = {
+        [OTA_IDLE]        = "idle",
+        [OTA_DOWNLOADING] = "downloading",
+        [OTA_VERIFYING]   = "verifying",
+        [OTA_DONE]        = "done",
+        [OTA_FAILED]      = "failed",
+    };
+    ota_status_t status;
+    cJSON *root = cJSON_CreateObject();
+
+    if (!root)
+    {
+        return NULL;
+    }
+    app_ota_get_status(&status);
+    cJSON_AddStringToObject(root, "state", states[status.state]);
+    cJSON_AddStringToObject(root, "running", esp_ota_get_running_partition()->label);
+    cJSON_AddNumberToObject(root, "received", status.received);
+    cJSON_AddNumberToObject(root, "patch_size", status.patch_size);
+    cJSON_AddNumberToObject(root, "written", status.written);
+    cJSON_AddNumberToObject(root, "image_size", status.image_size);
+    if (status.state == OTA_FAILED)
+    {
+        cJSON_AddStringToObject(root, "error", esp_err_to_name(status.err));
+    }
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return json;
+}
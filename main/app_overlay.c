@@ -0,0 +1,969 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "esp_log.h"
+#include "fb_gfx.h"
+#include "app_overlay.h"
+#include "app_jpeg.h"
+#include "app_mem.h"
+
+static const char *TAG = "app_overlay";
+
+// fb_gfx font metrics, also assumed by rgb_print in app_pipeline.c
+#define OVERLAY_FONT_ADVANCE    14
+#define OVERLAY_LINE_HEIGHT     24
+// glyphs hang up to a line below the text origin
+#define OVERLAY_TEXT_ROWS       ((4 + 1) * OVERLAY_LINE_HEIGHT)
+#define OVERLAY_MASK_BYTES      (16 * 1024)
+
+#define JPEG_MAX_BLOCKS         6
+
+typedef struct {
+    uint8_t look_len[256];      /* codes of up to 8 bits by their first byte, 0 when longer */
+    uint8_t look_sym[256];
+    int32_t maxcode[17];        /* -1 when there are no codes of that length */
+    uint16_t mincode[17];
+    uint16_t valptr[17];
+    uint8_t vals[256];
+    jpeg_huff_code_t enc;
+    bool defined;
+} huff_table_t;
+
+typedef struct {
+    uint8_t id;
+    uint8_t h;
+    uint8_t v;
+    uint8_t tq;
+    uint8_t td;
+    uint8_t ta;
+} jpeg_component_t;
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint16_t restart_interval;
+    uint8_t count;
+    uint8_t hmax;
+    uint8_t vmax;
+    int mcus_x;
+    int mcus_y;
+    jpeg_component_t comp[3];   /* in scan order */
+    uint16_t qt[4][64];         /* zigzag order like the coefficients */
+    bool qt_defined[4];
+    huff_table_t dc[2];
+    huff_table_t ac[2];
+    size_t header_len;          /* everything up to the entropy coded data */
+} jpeg_t;
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    uint32_t acc;               /* next bits, MSB first */
+    int bits;
+    bool marker;                /* p is at a marker, zeros are fed from there */
+} bit_reader_t;
+
+// the overlay with its text rendered into bit masks
+typedef struct {
+    overlay_op_t ops[OVERLAY_MAX_OPS];
+    uint32_t mask_offset[OVERLAY_MAX_OPS];
+    uint8_t ycc[OVERLAY_MAX_OPS][3];
+    int count;
+} overlay_layer_t;
+
+// only the encode stage composes, one frame at a time
+static jpeg_t s_jpeg;
+static overlay_layer_t s_layer;
+static float s_dct[8][8];       /* orthonormal DCT-II basis, [x][u] */
+static bool s_dct_ready = false;
+static uint8_t *s_scratch = NULL;
+static size_t s_scratch_width = 0;
+static uint8_t *s_mask = NULL;
+
+void app_overlay_reset(overlay_t *overlay, size_t width, size_t height)
+{
+    overlay->width = width;
+    overlay->height = height;
+    overlay->count = 0;
+    overlay->text_count = 0;
+}
+
+void app_overlay_fill_rect(overlay_t *overlay, int x, int y, int w, int h, uint32_t color)
+{
+    if (x < 0)
+    {
+        w += x;
+        x = 0;
+    }
+    if (y < 0)
+    {
+        h += y;
+        y = 0;
+    }
+    if (x + w > overlay->width)
+    {
+        w = overlay->width - x;
+    }
+    if (y + h > overlay->height)
+    {
+        h = overlay->height - y;
+    }
+    if (w <= 0 || h <= 0 || overlay->count == OVERLAY_MAX_OPS)
+    {
+        return;
+    }
+    overlay->ops[overlay->count++] = (overlay_op_t) {
+        .x = x, .y = y, .w = w, .h = h, .color = color, .text = -1,
+    };
+}
+
+void app_overlay_print(overlay_t *overlay, int x, int y, uint32_t color, const char *str)
+{
+    if (overlay->count == OVERLAY_MAX_OPS || overlay->text_count == OVERLAY_MAX_TEXTS)
+    {
+        return;
+    }
+    strlcpy(overlay->texts[overlay->text_count], str, OVERLAY_TEXT_MAX);
+    overlay->ops[overlay->count++] = (overlay_op_t) {
+        .x = x < 0 ? 0 : x, .y = y < 0 ? 0 : y, .color = color, .text = overlay->text_count++,
+    };
+}
+
+void app_overlay_draw(const overlay_t *overlay, dl_matrix3du_t *image_matrix)
+{
+    fb_data_t fb;
+    fb.width = image_matrix->w;
+    fb.height = image_matrix->h;
+    fb.data = image_matrix->item;
+    fb.bytes_per_pixel = 3;
+    fb.format = FB_BGR888;
+
+    for (int i = 0; i < overlay->count; i++)
+    {
+        const overlay_op_t *op = &overlay->ops[i];
+        if (op->text < 0)
+        {
+            fb_gfx_fillRect(&fb, op->x, op->y, op->w, op->h, op->color);
+        }
+        else
+        {
+            fb_gfx_print(&fb, op->x, op->y, op->color, overlay->texts[op->text]);
+        }
+    }
+}
+
+static bool overlay_render_text(const overlay_t *overlay, int i, uint32_t *mask_used)
+{
+    overlay_op_t *op = &s_layer.ops[i];
+    const char *str = overlay->texts[op->text];
+    int width = overlay->width;
+    int lines = 1;
+
+    // count lines the way fb_gfx_print wraps them
+    for (int xc = op->x, j = 0; str[j]; j++)
+    {
+        if (str[j] == '\n')
+        {
+            lines++;
+            xc = op->x;
+            continue;
+        }
+        if (xc > width - OVERLAY_FONT_ADVANCE)
+        {
+            lines++;
+            xc = op->x;
+        }
+        xc += OVERLAY_FONT_ADVANCE;
+    }
+    int rows = (lines + 1) * OVERLAY_LINE_HEIGHT;
+    if (rows > OVERLAY_TEXT_ROWS)
+    {
+        return false;
+    }
+    if (width > s_scratch_width)
+    {
+        app_mem_free(APP_MEM_OVERLAY_TEXT, s_scratch, s_scratch_width * OVERLAY_TEXT_ROWS * 3);
+        s_scratch_width = 0;
+        s_scratch = (uint8_t *)app_mem_alloc(APP_MEM_OVERLAY_TEXT, width * OVERLAY_TEXT_ROWS * 3);
+        if (!s_scratch)
+        {
+            return false;
+        }
+        s_scratch_width = width;
+    }
+
+    memset(s_scratch, 0, width * rows * 3);
+    fb_data_t fb;
+    fb.width = width;
+    fb.height = rows;
+    fb.data = s_scratch;
+    fb.bytes_per_pixel = 3;
+    fb.format = FB_BGR888;
+    fb_gfx_print(&fb, op->x, 0, 0x00FFFFFF, str);
+
+    // bounding box of the glyphs, clipped to the frame
+    int x0 = width, y0 = rows, x1 = -1, y1 = -1;
+    int max_rows = overlay->height - op->y < rows ? overlay->height - op->y : rows;
+    for (int y = 0; y < max_rows; y++)
+    {
+        const uint8_t *row = s_scratch + y * width * 3;
+        for (int x = 0; x < width; x++)
+        {
+            if (row[x * 3])
+            {
+                x0 = x < x0 ? x : x0;
+                x1 = x > x1 ? x : x1;
+                y0 = y < y0 ? y : y0;
+                y1 = y;
+            }
+        }
+    }
+    if (x1 < 0)
+    {
+        op->w = op->h = 0;
+        return true;
+    }
+
+    uint32_t bits = (x1 - x0 + 1) * (y1 - y0 + 1);
+    if (*mask_used + bits > OVERLAY_MASK_BYTES * 8)
+    {
+        return false;
+    }
+    s_layer.mask_offset[i] = *mask_used;
+    for (int y = y0; y <= y1; y++)
+    {
+        for (int x = x0; x <= x1; x++, (*mask_used)++)
+        {
+            if (s_scratch[(y * width + x) * 3])
+            {
+                s_mask[*mask_used >> 3] |= 1 << (*mask_used & 7);
+            }
+            else
+            {
+                s_mask[*mask_used >> 3] &= ~(1 << (*mask_used & 7));
+            }
+        }
+    }
+    op->x = x0;
+    op->y += y0;
+    op->w = x1 - x0 + 1;
+    op->h = y1 - y0 + 1;
+    return true;
+}
+
+static inline uint8_t overlay_clamp(float v)
+{
+    int i = lroundf(v);
+    return i < 0 ? 0 : (i > 255 ? 255 : i);
+}
+
+static bool overlay_layer_init(const overlay_t *overlay)
+{
+    uint32_t mask_used = 0;
+
+    if (!s_mask)
+    {
+        s_mask = (uint8_t *)app_mem_alloc(APP_MEM_OVERLAY_MASK, OVERLAY_MASK_BYTES);
+        if (!s_mask)
+        {
+            return false;
+        }
+    }
+    s_layer.count = overlay->count;
+    memcpy(s_layer.ops, overlay->ops, overlay->count * sizeof(overlay_op_t));
+    for (int i = 0; i < s_layer.count; i++)
+    {
+        if (s_layer.ops[i].text >= 0 && !overlay_render_text(overlay, i, &mask_used))
+        {
+            return false;
+        }
+        uint32_t c = s_layer.ops[i].color;
+        float r = c & 0xFF, g = (c >> 8) & 0xFF, b = (c >> 16) & 0xFF;
+        s_layer.ycc[i][0] = overlay_clamp(0.299f * r + 0.587f * g + 0.114f * b);
+        s_layer.ycc[i][1] = overlay_clamp(128 - 0.168736f * r - 0.331264f * g + 0.5f * b);
+        s_layer.ycc[i][2] = overlay_clamp(128 + 0.5f * r - 0.418688f * g - 0.081312f * b);
+    }
+    return true;
+}
+
+/* 1 + index of the topmost op drawing the pixel, 0 for none */
+static int overlay_op_at(int x, int y)
+{
+    for (int i = s_layer.count - 1; i >= 0; i--)
+    {
+        const overlay_op_t *op = &s_layer.ops[i];
+        if (x < op->x || y < op->y || x >= op->x + op->w || y >= op->y + op->h)
+        {
+            continue;
+        }
+        if (op->text < 0)
+        {
+            return i + 1;
+        }
+        uint32_t bit = s_layer.mask_offset[i] + (y - op->y) * op->w + (x - op->x);
+        if (s_mask[bit >> 3] & (1 << (bit & 7)))
+        {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static bool overlay_touches(int x, int y, int w, int h)
+{
+    for (int i = 0; i < s_layer.count; i++)
+    {
+        const overlay_op_t *op = &s_layer.ops[i];
+        if (op->x < x + w && x < op->x + op->w && op->y < y + h && y < op->y + op->h)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline uint16_t jpeg_be16(const uint8_t *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static bool huff_build(huff_table_t *t, const uint8_t *counts, const uint8_t *vals)
+{
+    uint32_t code = 0;
+    int k = 0;
+
+    memset(t->look_len, 0, sizeof(t->look_len));
+    memset(t->enc.size, 0, sizeof(t->enc.size));
+    for (int l = 1; l <= 16; l++)
+    {
+        t->valptr[l] = k;
+        t->mincode[l] = code;
+        // an oversubscribed table would run the codes past the lookup tables
+        if (code + counts[l - 1] > (1u << l))
+        {
+            return false;
+        }
+        for (int n = 0; n < counts[l - 1]; n++, k++, code++)
+        {
+            uint8_t sym = vals[k];
+            t->vals[k] = sym;
+            t->enc.code[sym] = code;
+            t->enc.size[sym] = l;
+            if (l <= 8)
+            {
+                int shift = 8 - l;
+                for (int j = 0; j < (1 << shift); j++)
+                {
+                    t->look_len[(code << shift) | j] = l;
+                    t->look_sym[(code << shift) | j] = sym;
+                }
+            }
+        }
+        t->maxcode[l] = counts[l - 1] ? (int32_t)code - 1 : -1;
+        code <<= 1;
+    }
+    t->defined = true;
+    return true;
+}
+
+static esp_err_t jpeg_parse(const uint8_t *buf, size_t len, jpeg_t *jpeg)
+{
+    size_t i = 2;
+    int frame_count = 0;
+    jpeg_component_t frame_comp[3];
+
+    jpeg->restart_interval = 0;
+    memset(jpeg->qt_defined, 0, sizeof(jpeg->qt_defined));
+    for (int t = 0; t < 2; t++)
+    {
+        jpeg->dc[t].defined = jpeg->ac[t].defined = false;
+    }
+    if (len < 4 || buf[0] != 0xFF || buf[1] != 0xD8)
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    while (i + 4 <= len)
+    {
+        if (buf[i] != 0xFF)
+        {
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        uint8_t marker = buf[i + 1];
+        if (marker == 0xFF)
+        {
+            i++;
+            continue;
+        }
+        size_t seg_len = jpeg_be16(buf + i + 2);
+        const uint8_t *seg = buf + i + 4;
+        if (seg_len < 2 || i + 2 + seg_len > len)
+        {
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        seg_len -= 2;
+
+        if (marker == 0xC0)
+        {
+            if (seg_len < 6 || seg[0] != 8)
+            {
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+            jpeg->height = jpeg_be16(seg + 1);
+            jpeg->width = jpeg_be16(seg + 3);
+            frame_count = seg[5];
+            if ((frame_count != 1 && frame_count != 3) || seg_len < 6 + frame_count * 3)
+            {
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+            for (int c = 0; c < frame_count; c++)
+            {
+                frame_comp[c].id = seg[6 + c * 3];
+                frame_comp[c].h = seg[7 + c * 3] >> 4;
+                frame_comp[c].v = seg[7 + c * 3] & 0x0F;
+                frame_comp[c].tq = seg[8 + c * 3] & 0x03;
+            }
+        }
+        else if ((marker & 0xF0) == 0xC0 && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+        {
+            // progressive, lossless and arithmetic coded frames
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        else if (marker == 0xC4)
+        {
+            for (size_t j = 0; j + 17 <= seg_len;)
+            {
+                uint8_t tc = seg[j] >> 4, th = seg[j] & 0x0F;
+                const uint8_t *counts = seg + j + 1;
+                int total = 0;
+                for (int l = 0; l < 16; l++)
+                {
+                    total += counts[l];
+                }
+                if (tc > 1 || th > 1 || total > 256 || j + 17 + total > seg_len)
+                {
+                    return ESP_ERR_NOT_SUPPORTED;
+                }
+                if (!huff_build(tc ? &jpeg->ac[th] : &jpeg->dc[th], counts, counts + 16))
+                {
+                    return ESP_ERR_NOT_SUPPORTED;
+                }
+                j += 17 + total;
+            }
+        }
+        else if (marker == 0xDB)
+        {
+            for (size_t j = 0; j + 65 <= seg_len; j += 65)
+            {
+                // 16 bit tables only come with 12 bit samples
+                if ((seg[j] >> 4) != 0)
+                {
+                    return ESP_ERR_NOT_SUPPORTED;
+                }
+                uint8_t tq = seg[j] & 0x03;
+                for (int k = 0; k < 64; k++)
+                {
+                    jpeg->qt[tq][k] = seg[j + 1 + k];
+                }
+                jpeg->qt_defined[tq] = true;
+            }
+        }
+        else if (marker == 0xDD && seg_len >= 2)
+        {
+            jpeg->restart_interval = jpeg_be16(seg);
+        }
+        else if (marker == 0xDA)
+        {
+            // one interleaved baseline scan with every component
+            if (frame_count == 0 || seg_len < 1 || seg[0] != frame_count || seg_len < 1 + frame_count * 2 + 3)
+            {
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+            const uint8_t *spectral = seg + 1 + frame_count * 2;
+            if (spectral[0] != 0 || spectral[1] != 63 || spectral[2] != 0)
+            {
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+            jpeg->count = frame_count;
+            for (int c = 0; c < frame_count; c++)
+            {
+                int f = 0;
+                while (f < frame_count && frame_comp[f].id != seg[1 + c * 2])
+                {
+                    f++;
+                }
+                if (f == frame_count)
+                {
+                    return ESP_ERR_NOT_SUPPORTED;
+                }
+                jpeg->comp[c] = frame_comp[f];
+                jpeg->comp[c].td = seg[2 + c * 2] >> 4;
+                jpeg->comp[c].ta = seg[2 + c * 2] & 0x0F;
+                if (jpeg->comp[c].td > 1 || jpeg->comp[c].ta > 1 || !jpeg->dc[jpeg->comp[c].td].defined
+                || !jpeg->ac[jpeg->comp[c].ta].defined || !jpeg->qt_defined[jpeg->comp[c].tq])
+                {
+                    return ESP_ERR_NOT_SUPPORTED;
+                }
+            }
+            jpeg->header_len = i + 4 + seg_len;
+            break;
+        }
+        i += 2 + seg_len + 2;
+    }
+    if (jpeg->header_len == 0 || jpeg->width == 0 || jpeg->height == 0)
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    if (jpeg->count == 1)
+    {
+        // a single component scan has one block per MCU whatever its sampling
+        jpeg->comp[0].h = jpeg->comp[0].v = 1;
+    }
+    else if (jpeg->comp[0].h < 1 || jpeg->comp[0].h > 2 || jpeg->comp[0].v < 1 || jpeg->comp[0].v > 2
+    || jpeg->comp[1].h != 1 || jpeg->comp[1].v != 1 || jpeg->comp[2].h != 1 || jpeg->comp[2].v != 1)
+    {
+        // luma first, chroma subsampled by at most two
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    jpeg->hmax = jpeg->comp[0].h;
+    jpeg->vmax = jpeg->comp[0].v;
+    jpeg->mcus_x = (jpeg->width + 8 * jpeg->hmax - 1) / (8 * jpeg->hmax);
+    jpeg->mcus_y = (jpeg->height + 8 * jpeg->vmax - 1) / (8 * jpeg->vmax);
+    return ESP_OK;
+}
+
+static void reader_fill(bit_reader_t *r)
+{
+    while (r->bits <= 24)
+    {
+        uint32_t b = 0;
+        if (!r->marker && r->p < r->end)
+        {
+            b = *r->p;
+            if (b != 0xFF)
+            {
+                r->p++;
+            }
+            else if (r->p + 1 < r->end && r->p[1] == 0x00)
+            {
+                r->p += 2;
+            }
+            else
+            {
+                r->marker = true;
+                b = 0;
+            }
+        }
+        r->acc |= b << (24 - r->bits);
+        r->bits += 8;
+    }
+}
+
+static inline uint32_t reader_bits(bit_reader_t *r, int n)
+{
+    if (r->bits < n)
+    {
+        reader_fill(r);
+    }
+    uint32_t v = r->acc >> (32 - n);
+    r->acc <<= n;
+    r->bits -= n;
+    return v;
+}
+
+static int huff_decode(bit_reader_t *r, const huff_table_t *t)
+{
+    if (r->bits < 16)
+    {
+        reader_fill(r);
+    }
+    uint32_t peek = r->acc >> 24;
+    int len = t->look_len[peek];
+    if (len)
+    {
+        r->acc <<= len;
+        r->bits -= len;
+        return t->look_sym[peek];
+    }
+    for (int l = 9; l <= 16; l++)
+    {
+        int32_t code = r->acc >> (32 - l);
+        if (code <= t->maxcode[l])
+        {
+            r->acc <<= l;
+            r->bits -= l;
+            return t->vals[t->valptr[l] + code - t->mincode[l]];
+        }
+    }
+    return -1;
+}
+
+/* Skips to the data after the next restart marker */
+static bool reader_restart(bit_reader_t *r)
+{
+    const uint8_t *p = r->p;
+
+    while (p + 1 < r->end && !(p[0] == 0xFF && p[1] >= 0xD0 && p[1] <= 0xD7))
+    {
+        p++;
+    }
+    if (p + 1 >= r->end)
+    {
+        return false;
+    }
+    r->p = p + 2;
+    r->acc = 0;
+    r->bits = 0;
+    r->marker = false;
+    return true;
+}
+
+static inline int jpeg_extend(int v, int s)
+{
+    return v < (1 << (s - 1)) ? v - (1 << s) + 1 : v;
+}
+
+static bool block_decode(bit_reader_t *r, const huff_table_t *dc, const huff_table_t *ac, int *pred, int16_t *zz)
+{
+    memset(zz, 0, 64 * sizeof(int16_t));
+    int s = huff_decode(r, dc);
+    if (s < 0 || s > 11)
+    {
+        return false;
+    }
+    *pred += s ? jpeg_extend(reader_bits(r, s), s) : 0;
+    zz[0] = *pred;
+    for (int k = 1; k < 64;)
+    {
+        int rs = huff_decode(r, ac);
+        if (rs < 0)
+        {
+            return false;
+        }
+        s = rs & 0x0F;
+        if (s == 0)
+        {
+            if (rs != 0xF0)
+            {
+                break;
+            }
+            k += 16;
+            continue;
+        }
+        k += rs >> 4;
+        if (k > 63)
+        {
+            return false;
+        }
+        zz[k++] = jpeg_extend(reader_bits(r, s), s);
+    }
+    return true;
+}
+
+static void dct_init()
+{
+    for (int x = 0; x < 8; x++)
+    {
+        for (int u = 0; u < 8; u++)
+        {
+            float c = u == 0 ? sqrtf(0.125f) : 0.5f;
+            s_dct[x][u] = c * cosf((2 * x + 1) * u * (float)M_PI / 16);
+        }
+    }
+    s_dct_ready = true;
+}
+
+static void block_idct(const int16_t *zz, const uint16_t *qt, uint8_t *px)
+{
+    float coef[8][8] = {0};
+    float tmp[8][8];
+
+    for (int k = 0; k < 64; k++)
+    {
+        coef[app_jpeg_natural[k] >> 3][app_jpeg_natural[k] & 7] = zz[k] * qt[k];
+    }
+    for (int y = 0; y < 8; y++)
+    {
+        for (int u = 0; u < 8; u++)
+        {
+            float sum = 0;
+            for (int v = 0; v < 8; v++)
+            {
+                sum += s_dct[y][v] * coef[v][u];
+            }
+            tmp[y][u] = sum;
+        }
+    }
+    for (int y = 0; y < 8; y++)
+    {
+        for (int x = 0; x < 8; x++)
+        {
+            float sum = 128;
+            for (int u = 0; u < 8; u++)
+            {
+                sum += tmp[y][u] * s_dct[x][u];
+            }
+            int v = lroundf(sum);
+            px[y * 8 + x] = v < 0 ? 0 : (v > 255 ? 255 : v);
+        }
+    }
+}
+
+static void block_fdct(const uint8_t *px, const uint16_t *qt, int16_t *zz)
+{
+    float tmp[8][8];
+    float coef[8][8];
+
+    for (int v = 0; v < 8; v++)
+    {
+        for (int x = 0; x < 8; x++)
+        {
+            float sum = 0;
+            for (int y = 0; y < 8; y++)
+            {
+                sum += s_dct[y][v] * (px[y * 8 + x] - 128);
+            }
+            tmp[v][x] = sum;
+        }
+    }
+    for (int v = 0; v < 8; v++)
+    {
+        for (int u = 0; u < 8; u++)
+        {
+            float sum = 0;
+            for (int x = 0; x < 8; x++)
+            {
+                sum += tmp[v][x] * s_dct[x][u];
+            }
+            coef[v][u] = sum;
+        }
+    }
+    for (int k = 0; k < 64; k++)
+    {
+        zz[k] = lroundf(coef[app_jpeg_natural[k] >> 3][app_jpeg_natural[k] & 7] / qt[k]);
+    }
+}
+
+/* Draws the overlay into the blocks of one MCU */
+static void overlay_mcu(const jpeg_t *jpeg, int mcu, int16_t blocks[][64])
+{
+    uint8_t cover[16 * 16];
+    int mcu_w = 8 * jpeg->hmax, mcu_h = 8 * jpeg->vmax;
+    int x0 = (mcu % jpeg->mcus_x) * mcu_w, y0 = (mcu / jpeg->mcus_x) * mcu_h;
+    bool any = false;
+
+    for (int y = 0; y < mcu_h; y++)
+    {
+        for (int x = 0; x < mcu_w; x++)
+        {
+            cover[y * mcu_w + x] = overlay_op_at(x0 + x, y0 + y);
+            any |= cover[y * mcu_w + x] != 0;
+        }
+    }
+    if (!any)
+    {
+        return;
+    }
+
+    int b = 0;
+    for (int c = 0; c < jpeg->count; c++)
+    {
+        const jpeg_component_t *comp = &jpeg->comp[c];
+        // luma pixels per sample of this component
+        int sx = jpeg->hmax / comp->h, sy = jpeg->vmax / comp->v;
+        for (int by = 0; by < comp->v; by++)
+        {
+            for (int bx = 0; bx < comp->h; bx++, b++)
+            {
+                uint8_t ops[64];
+                bool touched = false;
+                for (int j = 0; j < 8; j++)
+                {
+                    for (int i = 0; i < 8; i++)
+                    {
+                        const uint8_t *src = cover + ((by * 8 + j) * sy) * mcu_w + (bx * 8 + i) * sx;
+                        uint8_t op = 0;
+                        // a chroma sample takes the color of any pixel drawn on
+                        for (int yy = 0; yy < sy && !op; yy++)
+                        {
+                            for (int xx = 0; xx < sx && !op; xx++)
+                            {
+                                op = src[yy * mcu_w + xx];
+                            }
+                        }
+                        ops[j * 8 + i] = op;
+                        touched |= op != 0;
+                    }
+                }
+                if (!touched)
+                {
+                    continue;
+                }
+                uint8_t px[64];
+                block_idct(blocks[b], jpeg->qt[comp->tq], px);
+                for (int k = 0; k < 64; k++)
+                {
+                    if (ops[k])
+                    {
+                        px[k] = s_layer.ycc[ops[k] - 1][jpeg->count == 1 ? 0 : c];
+                    }
+                }
+                block_fdct(px, jpeg->qt[comp->tq], blocks[b]);
+            }
+        }
+    }
+}
+
+static bool overlay_touches_mcus(const jpeg_t *jpeg, int start, int end)
+{
+    int mcu_w = 8 * jpeg->hmax, mcu_h = 8 * jpeg->vmax;
+
+    for (int mcu = start; mcu < end; mcu++)
+    {
+        if (overlay_touches((mcu % jpeg->mcus_x) * mcu_w, (mcu / jpeg->mcus_x) * mcu_h, mcu_w, mcu_h))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+esp_err_t app_overlay_compose(const uint8_t *src, size_t src_len, const overlay_t *overlay, frame_jpg_t *jpg)
+{
+    jpeg_t *jpeg = &s_jpeg;
+    int16_t blocks[JPEG_MAX_BLOCKS][64];
+
+    jpeg->header_len = 0;
+    esp_err_t err = jpeg_parse(src, src_len, jpeg);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    if (jpeg->width != overlay->width || jpeg->height != overlay->height)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (jpeg->header_len + 2 > jpg->size)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    if (!s_dct_ready)
+    {
+        dct_init();
+    }
+    if (!overlay_layer_init(overlay))
+    {
+        ESP_LOGD(TAG, "Overlay text does not fit the mask");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    memcpy(jpg->buf, src, jpeg->header_len);
+    jpeg_writer_t w = { .buf = jpg->buf, .len = jpeg->header_len, .size = jpg->size };
+    bit_reader_t r = { .p = src + jpeg->header_len, .end = src + src_len };
+    int total = jpeg->mcus_x * jpeg->mcus_y;
+    int interval = jpeg->restart_interval ? jpeg->restart_interval : total;
+
+    for (int start = 0, n = 0; start < total; start += interval, n++)
+    {
+        int end = start + interval < total ? start + interval : total;
+        bool last = end == total;
+
+        if (jpeg->restart_interval && !overlay_touches_mcus(jpeg, start, end))
+        {
+            // nothing drawn here, copy up to and with the restart marker
+            const uint8_t *p = r.p;
+            while (p + 1 < r.end && !(p[0] == 0xFF && p[1] != 0x00 && p[1] != 0xFF))
+            {
+                p++;
+            }
+            if (p + 1 >= r.end)
+            {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            size_t len = last ? p - r.p : p + 2 - r.p;
+            if (w.len + len > w.size)
+            {
+                return ESP_ERR_NO_MEM;
+            }
+            memcpy(w.buf + w.len, r.p, len);
+            w.len += len;
+            r.p = p + 2;
+            continue;
+        }
+
+        // the DC predictors restart with every interval
+        int pred_in[3] = {0}, pred_out[3] = {0};
+        for (int mcu = start; mcu < end; mcu++)
+        {
+            int b = 0;
+            for (int c = 0; c < jpeg->count; c++)
+            {
+                const jpeg_component_t *comp = &jpeg->comp[c];
+                for (int k = 0; k < comp->h * comp->v; k++, b++)
+                {
+                    if (!block_decode(&r, &jpeg->dc[comp->td], &jpeg->ac[comp->ta], &pred_in[c], blocks[b]))
+                    {
+                        return ESP_ERR_INVALID_SIZE;
+                    }
+                }
+            }
+            overlay_mcu(jpeg, mcu, blocks);
+            b = 0;
+            for (int c = 0; c < jpeg->count; c++)
+            {
+                const jpeg_component_t *comp = &jpeg->comp[c];
+                for (int k = 0; k < comp->h * comp->v; k++, b++)
+                {
+                    // tables tuned by the sensor may lack codes the new coefficients need
+                    if (!app_jpeg_encode_block(&w, &jpeg->dc[comp->td].enc, &jpeg->ac[comp->ta].enc, &pred_out[c], blocks[b]))
+                    {
+                        return ESP_ERR_NOT_SUPPORTED;
+                    }
+                }
+            }
+            if (w.overflow)
+            {
+                return ESP_ERR_NO_MEM;
+            }
+        }
+        app_jpeg_flush_bits(&w);
+        if (!last)
+        {
+            app_jpeg_put_byte(&w, 0xFF);
+            app_jpeg_put_byte(&w, 0xD0 + (n & 7));
+            if (!reader_restart(&r))
+            {
+                return ESP_ERR_INVALID_SIZE;
+            }
+        }
+    }
+    app_jpeg_put_byte(&w, 0xFF);
+    app_jpeg_put_byte(&w, 0xD9);
+    if (w.overflow)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    jpg->len = w.len;
+    return ESP_OK;
+}
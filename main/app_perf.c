@@ -0,0 +1,360 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "cJSON.h"
+#include "sdkconfig.h"
+#include "app_perf.h"
+#include "app_metrics.h"
+#include "app_event.h"
+#include "app_stream.h"
+#include "app_mem.h"
+#include "app_boot.h"
+
+static const char *TAG = "app_perf";
+
+/* Shows the suite's viewer in the logs and on /status, next to the soak test's 9999 */
+#define PERF_SINK_FD        9998
+
+/* Time the board gets to wake up before the pipeline part fails */
+#define PERF_WAKE_MS        5000
+
+static const struct {
+    const char *name;
+    metric_id_t metric;
+} s_stages[PERF_STAGE_MAX] = {
+    [PERF_STAGE_CAPTURE_WAIT] = { "capture_wait", METRIC_CAPTURE_WAIT },
+    [PERF_STAGE_DECODE]       = { "decode",       METRIC_DECODE },
+    [PERF_STAGE_DETECT]       = { "detect",       METRIC_DETECT },
+    [PERF_STAGE_RECOGNIZE]    = { "recognize",    METRIC_RECOGNIZE },
+    [PERF_STAGE_ENCODE]       = { "encode",       METRIC_ENCODE },
+    [PERF_STAGE_SEND]         = { "send",         METRIC_SEND },
+    [PERF_STAGE_LATENCY]      = { "latency",      METRIC_LATENCY },
+    [PERF_STAGE_FRAME]        = { "frame",        METRIC_FRAME },
+};
+
+static const struct {
+    const char *name;
+    uint32_t caps;
+} s_heaps[PERF_HEAP_MAX] = {
+    [PERF_HEAP_INTERNAL] = { "internal", MALLOC_CAP_INTERNAL },
+    [PERF_HEAP_DMA]      = { "dma",      MALLOC_CAP_DMA },
+    [PERF_HEAP_SPIRAM]   = { "spiram",   MALLOC_CAP_SPIRAM },
+};
+
+static volatile uint32_t s_frames = 0;
+static volatile uint32_t s_bytes = 0;
+static volatile bool s_sink_open = false;
+
+static esp_err_t perf_sink_send(void *arg, frame_desc_t *frame)
+{
+    s_frames++;
+    s_bytes += frame->jpg_buf_len;
+    return ESP_OK;
+}
+
+static void perf_sink_close(void *arg)
+{
+    s_sink_open = false;
+}
+
+static const stream_sink_t s_sink = {
+    .name = "perf",
+    .send = perf_sink_send,
+    .close = perf_sink_close,
+    .arg = NULL,
+};
+
+static esp_err_t perf_sink_add()
+{
+    int64_t deadline = esp_timer_get_time() + PERF_WAKE_MS * 1000LL;
+
+    s_sink_open = true;
+    esp_err_t err = app_stream_add_sink(&s_sink, PERF_SINK_FD);
+    if (err == ESP_ERR_INVALID_STATE)
+    {
+        // the first viewer is refused until the wakeup went through
+        app_event_post(APP_EVENT_WAKEUP);
+        while (err == ESP_ERR_INVALID_STATE && esp_timer_get_time() < deadline)
+        {
+            vTaskDelay(100 / portTICK_PERIOD_MS);
+            err = app_stream_add_sink(&s_sink, PERF_SINK_FD);
+        }
+    }
+    if (err != ESP_OK)
+    {
+        s_sink_open = false;
+    }
+    return err;
+}
+
+static void perf_sink_remove()
+{
+    app_stream_remove_sink(&s_sink);
+    // the viewer task lets go of the sink before the next run may add it again
+    for (int i = 0; i < 100 && s_sink_open; i++)
+    {
+        vTaskDelay(10 / portTICK_PERIOD_MS);
+    }
+}
+
+static void perf_pipeline(perf_pipeline_t *p)
+{
+    frame_source_t previous = app_frame_source();
+    metric_snapshot_t before[PERF_STAGE_MAX];
+    uint32_t dropped[FRAME_DROP_MAX];
+
+    memset(p, 0, sizeof(*p));
+    p->source = FRAME_SOURCE_CORPUS;
+    if (app_frame_source_select(FRAME_SOURCE_CORPUS) != ESP_OK)
+    {
+        p->source = FRAME_SOURCE_COLORBAR;
+        app_frame_source_select(FRAME_SOURCE_COLORBAR);
+    }
+    p->err = perf_sink_add();
+    if (p->err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Pipeline not started: %s", esp_err_to_name(p->err));
+        goto out;
+    }
+
+    // the frame pools fill and the sensor settles before anything counts
+    vTaskDelay(CONFIG_PERF_WARMUP_S * 1000 / portTICK_PERIOD_MS);
+    for (int i = 0; i < PERF_STAGE_MAX; i++)
+    {
+        app_metrics_snapshot(s_stages[i].metric, &before[i]);
+    }
+    for (int i = 0; i < FRAME_DROP_MAX; i++)
+    {
+        dropped[i] = app_pipeline_dropped_frames(i);
+    }
+    uint32_t frames = s_frames;
+    uint32_t bytes = s_bytes;
+    int64_t start = esp_timer_get_time();
+
+    vTaskDelay(CONFIG_PERF_PIPELINE_S * 1000 / portTICK_PERIOD_MS);
+
+    p->duration_ms = (esp_timer_get_time() - start) / 1000;
+    p->frames = s_frames - frames;
+    p->bytes = s_bytes - bytes;
+    for (int i = 0; i < FRAME_DROP_MAX; i++)
+    {
+        p->dropped[i] = app_pipeline_dropped_frames(i) - dropped[i];
+    }
+    for (int i = 0; i < PERF_STAGE_MAX; i++)
+    {
+        metric_snapshot_t after;
+
+        app_metrics_snapshot(s_stages[i].metric, &after);
+        for (int b = 0; b < METRIC_BUCKETS; b++)
+        {
+            p->stages[i].count += after.count[b] - before[i].count[b];
+        }
+        p->stages[i].p50_us = app_metrics_percentile(&before[i], &after, 50);
+        p->stages[i].p99_us = app_metrics_percentile(&before[i], &after, 99);
+    }
+    perf_sink_remove();
+    ESP_LOGI(TAG, "Pipeline on %s: %u frames in %u ms", app_frame_source_name(p->source),
+             p->frames, p->duration_ms);
+
+out:
+    app_frame_source_select(previous);
+}
+
+esp_err_t app_perf_run(perf_read_cb read, void *arg, perf_result_t *result)
+{
+    int64_t start = esp_timer_get_time();
+
+    memset(result, 0, sizeof(*result));
+
+    // first, the audio is still waiting in the request body
+#ifdef CONFIG_SPEECH_CAPTURE
+    if (read)
+    {
+        esp_err_t err = app_speech_replay(read, arg, &result->speech);
+        result->has_speech = err == ESP_OK;
+        if (err != ESP_OK)
+        {
+            ESP_LOGW(TAG, "Speech replay failed: %s", esp_err_to_name(err));
+        }
+    }
+#endif
+
+    perf_pipeline(&result->pipeline);
+
+    // the pipeline is stopped again, unless other viewers are left
+#ifdef CONFIG_DISPLAY_BENCH
+    result->has_display = app_display_bench_run(CONFIG_OLED_I2C_CLOCK_HZ, &result->display) == ESP_OK;
+#endif
+
+    for (int i = 0; i < PERF_HEAP_MAX; i++)
+    {
+        result->heaps[i].free = heap_caps_get_free_size(s_heaps[i].caps);
+        result->heaps[i].min_free = heap_caps_get_minimum_free_size(s_heaps[i].caps);
+        result->heaps[i].largest = heap_caps_get_largest_free_block(s_heaps[i].caps);
+    }
+    result->elapsed_ms = (esp_timer_get_time() - start) / 1000;
+    return result->pipeline.err;
+}
+
+/* Takes the JSON another module formats, so that its part reads the same as its own endpoint */
+static void perf_add_json(cJSON *root, const char *name, char *json)
+{
+    cJSON *item = json ? cJSON_Parse(json) : NULL;
+
+    free(json);
+    if (item)
+    {
+        cJSON_AddItemToObject(root, name, item);
+    }
+}
+
+static cJSON *perf_pipeline_to_json(const perf_pipeline_t *p)
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON *dropped = cJSON_CreateObject();
+    cJSON *stages = cJSON_CreateObject();
+
+    if (!root || !dropped || !stages)
+    {
+        cJSON_Delete(root);
+        cJSON_Delete(dropped);
+        cJSON_Delete(stages);
+        return NULL;
+    }
+    cJSON_AddStringToObject(root, "source", app_frame_source_name(p->source));
+    if (p->err != ESP_OK)
+    {
+        cJSON_AddStringToObject(root, "error", esp_err_to_name(p->err));
+        cJSON_Delete(dropped);
+        cJSON_Delete(stages);
+        return root;
+    }
+    cJSON_AddNumberToObject(root, "duration_ms", p->duration_ms);
+    cJSON_AddNumberToObject(root, "frames", p->frames);
+    cJSON_AddNumberToObject(root, "fps", p->duration_ms ? p->frames * 1000.0 / p->duration_ms : 0);
+    cJSON_AddNumberToObject(root, "bytes_per_frame", p->frames ? p->bytes / p->frames : 0);
+    cJSON_AddItemToObject(root, "dropped", dropped);
+    for (int i = FRAME_DROP_NONE + 1; i < FRAME_DROP_MAX; i++)
+    {
+        cJSON_AddNumberToObject(dropped, app_pipeline_drop_name(i), p->dropped[i]);
+    }
+    cJSON_AddItemToObject(root, "stages", stages);
+    for (int i = 0; i < PERF_STAGE_MAX; i++)
+    {
+        cJSON *stage = cJSON_CreateObject();
+        if (!stage)
+        {
+            break;
+        }
+        cJSON_AddNumberToObject(stage, "count", p->stages[i].count);
+        cJSON_AddNumberToObject(stage, "p50_us", p->stages[i].p50_us);
+        cJSON_AddNumberToObject(stage, "p99_us", p->stages[i].p99_us);
+        cJSON_AddItemToObject(stages, s_stages[i].name, stage);
+    }
+    return root;
+}
+
+char *app_perf_to_json(const perf_result_t *result)
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON *heaps = cJSON_CreateObject();
+    cJSON *buffers = cJSON_CreateObject();
+    cJSON *boot = cJSON_CreateObject();
+    char *json = NULL;
+
+    if (!root || !heaps || !buffers || !boot)
+    {
+        cJSON_Delete(heaps);
+        cJSON_Delete(buffers);
+        cJSON_Delete(boot);
+        goto out;
+    }
+    cJSON_AddStringToObject(root, "idf", esp_get_idf_version());
+    cJSON_AddNumberToObject(root, "pipeline_s", CONFIG_PERF_PIPELINE_S);
+    cJSON_AddNumberToObject(root, "elapsed_ms", result->elapsed_ms);
+
+    cJSON *pipeline = perf_pipeline_to_json(&result->pipeline);
+    if (pipeline)
+    {
+        cJSON_AddItemToObject(root, "pipeline", pipeline);
+    }
+    if (result->has_speech)
+    {
+        perf_add_json(root, "speech", app_speech_replay_to_json(&result->speech));
+    }
+    if (result->has_display)
+    {
+        perf_add_json(root, "display", app_display_bench_to_json(&result->display, 1));
+    }
+
+    cJSON_AddItemToObject(root, "heaps", heaps);
+    for (int i = 0; i < PERF_HEAP_MAX; i++)
+    {
+        cJSON *heap = cJSON_CreateObject();
+        if (!heap)
+        {
+            break;
+        }
+        cJSON_AddNumberToObject(heap, "free", result->heaps[i].free);
+        cJSON_AddNumberToObject(heap, "min_free", result->heaps[i].min_free);
+        cJSON_AddNumberToObject(heap, "largest", result->heaps[i].largest);
+        cJSON_AddItemToObject(heaps, s_heaps[i].name, heap);
+    }
+
+    // highest since boot, which includes the suite
+    cJSON_AddItemToObject(root, "buffer_peaks", buffers);
+    for (int i = 0; i < APP_MEM_TAG_MAX; i++)
+    {
+        app_mem_usage_t usage;
+
+        app_mem_get_tag_usage(i, &usage);
+        cJSON_AddNumberToObject(buffers, app_mem_tag_name(i), usage.peak_internal + usage.peak_spiram);
+    }
+
+    cJSON_AddItemToObject(root, "boot", boot);
+    for (int i = 0; i < BOOT_PHASE_MAX; i++)
+    {
+        int64_t start, end;
+        cJSON *phase;
+
+        if (!app_boot_get(i, &start, &end) || !(phase = cJSON_CreateObject()))
+        {
+            continue;
+        }
+        cJSON_AddNumberToObject(phase, "start_ms", (uint32_t)(start / 1000));
+        cJSON_AddNumberToObject(phase, "ms", (uint32_t)((end - start) / 1000));
+        cJSON_AddItemToObject(boot, app_boot_phase_name(i), phase);
+    }
+    json = cJSON_PrintUnformatted(root);
+
+out:
+    cJSON_Delete(root);
+    return json;
+}
@@ -0,0 +1,1840 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "image_util.h"
+#include "fb_gfx.h"
+#include "app_pipeline.h"
+#include "app_main.h"
+#include "app_power.h"
+#include "app_tasks.h"
+#include "app_image.h"
+#include "app_rate.h"
+#include "app_shed.h"
+#include "app_track.h"
+#include "app_config.h"
+#include "app_motion.h"
+#include "app_metrics.h"
+#include "app_jpeg.h"
+#include "app_face_db.h"
+#include "app_face_store.h"
+#include "app_enroll.h"
+#include "app_face_cache.h"
+#include "app_face_quality.h"
+#include "app_clip.h"
+#include "app_preview.h"
+#include "app_thumbnail.h"
+#include "app_mem.h"
+#include "app_boot.h"
+#include "app_tracer.h"
+#include "app_offload.h"
+#include "app_window.h"
+#include "app_face_align.h"
+#include "app_frame_source.h"
+#include "app_camera_profile.h"
+#include "app_face_event.h"
+#include "app_ws.h"
+
+static const char *TAG = "app_pipeline";
+
+#define FACE_COLOR_WHITE  0x00FFFFFF
+#define FACE_COLOR_BLACK  0x00000000
+#define FACE_COLOR_RED    0x000000FF
+#define FACE_COLOR_GREEN  0x0000FF00
+#define FACE_COLOR_BLUE   0x00FF0000
+#define FACE_COLOR_YELLOW (FACE_COLOR_RED | FACE_COLOR_GREEN)
+#define FACE_COLOR_CYAN   (FACE_COLOR_BLUE | FACE_COLOR_GREEN)
+#define FACE_COLOR_PURPLE (FACE_COLOR_BLUE | FACE_COLOR_RED)
+
+#define PIPELINE_RUN_BIT        BIT0
+
+#ifdef CONFIG_APP_RECOGNITION
+// one aligned face buffer per recognized box
+static dl_matrix3du_t *s_aligned_faces[PIPELINE_MAX_FACES];
+
+typedef struct {
+    dl_matrix3du_t *aligned_face;
+    int id;
+    float similarity;
+} recognize_job_t;
+
+#ifdef CONFIG_FACE_RECOGNIZE_DUAL_CORE
+static QueueHandle_t s_recognize_queue = NULL;
+static SemaphoreHandle_t s_recognize_done = NULL;
+#endif
+#endif
+
+
+static frame_desc_t s_frames[PIPELINE_DEPTH];
+
+static QueueHandle_t s_free_queue = NULL;
+static QueueHandle_t s_encode_queue = NULL;
+static QueueHandle_t s_send_queue = NULL;
+static EventGroupHandle_t s_pipeline_event_group = NULL;
+
+static int64_t s_last_frame = 0;
+// frames not sent, by reason
+static uint32_t s_drops[FRAME_DROP_MAX];
+
+/*
+ * The detect stage is split in two: workers decode the frames and look for
+ * faces, the faces stage recognizes, crops and draws them. One worker runs
+ * both in its own task. With CONFIG_DETECT_DUAL_WORKER a worker on each core
+ * takes every other frame, and the faces stage takes them back in the same
+ * turns, so frames reach the encode stage in capture order.
+ */
+typedef struct {
+    QueueHandle_t in;
+    QueueHandle_t out;
+    // given by the faces stage once it is done with the input and the faces
+    SemaphoreHandle_t idle;
+    // detector input at 1/pipeline_detect_scale resolution, NULL when detecting on the full frame
+    dl_matrix3du_t *matrix;
+    uint8_t *strip;             /* s_strip_len bytes the JPEG is decoded into, NULL without */
+    track_faces_t faces;
+    mtmn_config_t mtmn_config;
+    mtmn_config_t detect_config;
+    uint32_t config_generation;
+    int config_scale;
+    // what was found on the last frame
+    bool pass;                  /* nothing to do for the faces stage */
+    bool draw_overlay;
+    bool compose;
+    int scale;
+    box_array_t *net_boxes;
+    dl_matrix3du_t *detect_input;
+} detect_worker_t;
+
+static detect_worker_t s_workers[PIPELINE_DETECT_WORKERS];
+static size_t s_detect_pixels = 0;
+static size_t s_strip_len = 0;
+#if PIPELINE_DETECT_WORKERS > 1
+static SemaphoreHandle_t s_motion_lock = NULL;
+#endif
+
+// serializes starting, stopping and reconfiguring the pipeline
+static SemaphoreHandle_t s_control_lock = NULL;
+
+// frames are encoded for viewers, otherwise only faces are looked for
+static volatile bool s_video = true;
+// overlays go into the frame the detect stage works on
+static bool s_draw_overlay = PIPELINE_DRAW_OVERLAY;
+// set while the overlay of a frame is recorded instead of drawn
+static overlay_t *s_overlay = NULL;
+// faces are cut out for /face_crops viewers
+static volatile bool s_face_crops = false;
+
+#ifdef CONFIG_FACE_CROPS
+#define CROP_PIXELS_SIZE        (PIPELINE_DEPTH * PIPELINE_MAX_FACES * FACE_CROP_SIZE * FACE_CROP_SIZE * 3)
+#define CROP_JPEGS_SIZE         (PIPELINE_DEPTH * PIPELINE_MAX_FACES * FACE_CROP_JPEG_MAX)
+
+// per frame and face, resampled by the detect stage and encoded by the encode stage
+static uint8_t *s_crop_pixels = NULL;
+static uint8_t *s_crop_jpegs = NULL;
+#endif
+
+/* Downscale of the detector input for frames width pixels wide */
+static int pipeline_detect_scale(size_t width)
+{
+#if CONFIG_DETECT_DOWNSCALE > 0
+    return CONFIG_DETECT_DOWNSCALE;
+#else
+    int scale = 1;
+    // the JPEG decoder only scales by powers of two
+    while (scale < 8 && width / scale > CONFIG_DETECT_WIDTH)
+    {
+        scale *= 2;
+    }
+    return scale;
+#endif
+}
+
+const char *number_suffix(int32_t number)
+{
+    uint8_t n = number % 10;
+
+    if (n == 0)
+        return "zero";
+    else if (n == 1)
+        return "st";
+    else if (n == 2)
+        return "nd";
+    else if (n == 3)
+        return "rd";
+    else
+        return "th";
+}
+
+static void rgb_print(dl_matrix3du_t *image_matrix, uint32_t color, const char * str){
+    if (!s_draw_overlay)
+        return;
+    if (s_overlay) {
+        app_overlay_print(s_overlay, (s_overlay->width - (strlen(str) * 14)) / 2, 10, color, str);
+        return;
+    }
+    fb_data_t fb;
+    fb.width = image_matrix->w;
+    fb.height = image_matrix->h;
+    fb.data = image_matrix->item;
+    fb.bytes_per_pixel = 3;
+    fb.format = FB_BGR888;
+    fb_gfx_print(&fb, (fb.width - (strlen(str) * 14)) / 2, 10, color, str);
+}
+
+// called for every frame with faces, so the text stays on the stack, the overlay keeps no more anyway
+static int rgb_printf(dl_matrix3du_t *image_matrix, uint32_t color, const char *format, ...)
+{
+    char text[OVERLAY_TEXT_MAX];
+    int len;
+    va_list arg;
+    va_start(arg, format);
+    len = vsnprintf(text, sizeof(text), format, arg);
+    va_end(arg);
+    rgb_print(image_matrix, color, text);
+    return len;
+}
+
+static void rgb_print_at(dl_matrix3du_t *image_matrix, int x, int y, uint32_t color, const char *str)
+{
+    if (!s_draw_overlay)
+        return;
+    if (s_overlay)
+    {
+        app_overlay_print(s_overlay, x, y, color, str);
+        return;
+    }
+    fb_data_t fb;
+    fb.width = image_matrix->w;
+    fb.height = image_matrix->h;
+    fb.data = image_matrix->item;
+    fb.bytes_per_pixel = 3;
+    fb.format = FB_BGR888;
+    fb_gfx_print(&fb, x < 0 ? 0 : x, y < 0 ? 0 : y, color, str);
+}
+
+static void draw_face_boxes(dl_matrix3du_t *image_matrix, box_array_t *boxes){
+    int x, y, w, h, i;
+    uint32_t color = FACE_COLOR_YELLOW;
+    if (!s_draw_overlay)
+        return;
+    if (s_overlay) {
+        for (i = 0; i < boxes->len; i++){
+            x = (int)boxes->box[i].box_p[0];
+            y = (int)boxes->box[i].box_p[1];
+            w = (int)boxes->box[i].box_p[2] - x + 1;
+            h = (int)boxes->box[i].box_p[3] - y + 1;
+            app_overlay_fill_rect(s_overlay, x, y, w, 1, color);
+            app_overlay_fill_rect(s_overlay, x, y+h-1, w, 1, color);
+            app_overlay_fill_rect(s_overlay, x, y, 1, h, color);
+            app_overlay_fill_rect(s_overlay, x+w-1, y, 1, h, color);
+        }
+        return;
+    }
+    fb_data_t fb;
+    fb.width = image_matrix->w;
+    fb.height = image_matrix->h;
+    fb.data = image_matrix->item;
+    fb.bytes_per_pixel = 3;
+    fb.format = FB_BGR888;
+    for (i = 0; i < boxes->len; i++){
+        // rectangle box
+        x = (int)boxes->box[i].box_p[0];
+        y = (int)boxes->box[i].box_p[1];
+        w = (int)boxes->box[i].box_p[2] - x + 1;
+        h = (int)boxes->box[i].box_p[3] - y + 1;
+        fb_gfx_drawFastHLine(&fb, x, y, w, color);
+        fb_gfx_drawFastHLine(&fb, x, y+h-1, w, color);
+        fb_gfx_drawFastVLine(&fb, x, y, h, color);
+        fb_gfx_drawFastVLine(&fb, x+w-1, y, h, color);
+#if 0
+        // landmark
+        int x0, y0, j;
+        for (j = 0; j < 10; j+=2) {
+            x0 = (int)boxes->landmark[i].landmark_p[j];
+            y0 = (int)boxes->landmark[i].landmark_p[j+1];
+            fb_gfx_fillRect(&fb, x0, y0, 3, 3, color);
+        }
+#endif
+    }
+}
+
+static inline bool pipeline_running()
+{
+    return (xEventGroupGetBits(s_pipeline_event_group) & PIPELINE_RUN_BIT) != 0;
+}
+
+static void frame_reset(frame_desc_t *frame)
+{
+    memset(frame, 0, sizeof(frame_desc_t));
+    frame->face_id = -1;
+    frame->enrolled_id = -1;
+    for (int i = 0; i < PIPELINE_MAX_FACES; i++)
+    {
+        frame->face_ids[i] = -1;
+    }
+}
+
+#ifdef CONFIG_FRAME_SOURCE
+static inline camera_fb_t *source_fb_get()
+{
+    return app_frame_source_get();
+}
+
+static inline void source_fb_return(camera_fb_t *fb)
+{
+    app_frame_source_return(fb);
+}
+#else
+static inline camera_fb_t *source_fb_get()
+{
+    return esp_camera_fb_get();
+}
+
+static inline void source_fb_return(camera_fb_t *fb)
+{
+    esp_camera_fb_return(fb);
+}
+#endif
+
+static void frame_release(frame_desc_t *frame)
+{
+    if (frame->drop == FRAME_DROP_NONE && frame->err != ESP_OK)
+    {
+        frame->drop = FRAME_DROP_ERROR;
+    }
+    if (frame->drop != FRAME_DROP_NONE)
+    {
+        // viewer tasks, the hub and the control path all hand frames back
+        __atomic_fetch_add(&s_drops[frame->drop], 1, __ATOMIC_RELAXED);
+    }
+    if (frame->jpg)
+    {
+        app_frame_pool_release_jpg(frame->jpg);
+    }
+    else if (frame->jpg_buf && (!frame->fb || frame->jpg_buf != frame->fb->buf))
+    {
+        free(frame->jpg_buf);
+    }
+    if (frame->fb)
+    {
+        source_fb_return(frame->fb);
+    }
+    app_frame_pool_release(frame->image_matrix);
+    frame_reset(frame);
+    xQueueSend(s_free_queue, &frame, portMAX_DELAY);
+}
+
+static void frame_set_faces(frame_desc_t *frame, box_array_t *boxes)
+{
+    frame->face_count = boxes->len < PIPELINE_MAX_FACES ? boxes->len : PIPELINE_MAX_FACES;
+    memcpy(frame->face_boxes, boxes->box, frame->face_count * sizeof(box_t));
+    if (boxes->landmark)
+    {
+        memcpy(frame->face_landmarks, boxes->landmark, frame->face_count * sizeof(landmark_t));
+    }
+}
+
+#ifdef CONFIG_FACE_CROPS
+static dl_matrix3du_t frame_crop_matrix(frame_desc_t *frame, int i)
+{
+    size_t slot = (frame - s_frames) * PIPELINE_MAX_FACES + i;
+    dl_matrix3du_t crop = {
+        .w = FACE_CROP_SIZE,
+        .h = FACE_CROP_SIZE,
+        .c = 3,
+        .n = 1,
+        .stride = FACE_CROP_SIZE * 3,
+        .item = s_crop_pixels + slot * FACE_CROP_SIZE * FACE_CROP_SIZE * 3,
+    };
+    return crop;
+}
+
+/* Cuts the faces out of src, a decode of the frame at 1/scale, before overlays go into it */
+static void frame_crop_faces(frame_desc_t *frame, dl_matrix3du_t *src, int scale)
+{
+    for (int i = 0; i < frame->face_count; i++)
+    {
+        dl_matrix3du_t crop = frame_crop_matrix(frame, i);
+        app_image_crop(src, scale, &frame->face_boxes[i], &crop);
+    }
+    frame->crop_count = frame->face_count;
+}
+
+static void frame_encode_crops(frame_desc_t *frame)
+{
+    for (int i = 0; i < frame->crop_count; i++)
+    {
+        dl_matrix3du_t crop = frame_crop_matrix(frame, i);
+        frame_jpg_t *jpg = &frame->face_crops[i];
+        jpg->buf = s_crop_jpegs + ((frame - s_frames) * PIPELINE_MAX_FACES + i) * FACE_CROP_JPEG_MAX;
+        jpg->size = FACE_CROP_JPEG_MAX;
+        if (!app_frame_pool_encode(&crop, CONFIG_FACE_CROP_QUALITY, jpg))
+        {
+            jpg->len = 0;
+        }
+    }
+}
+#endif
+
+#ifdef CONFIG_APP_RECOGNITION
+static void recognize_aligned(recognize_job_t *job)
+{
+    face_match_t matches[FACE_DB_TOP_K];
+    dl_matrix3d_t *face_id = get_face_id(job->aligned_face);
+    int n = app_face_db_match(face_id, matches, FACE_DB_TOP_K);
+    dl_matrix3d_free(face_id);
+
+    job->id = -1;
+    job->similarity = 0;
+    if (n > 0)
+    {
+        ESP_LOGD(TAG, "Best match ID %d (%.3f), %d candidates", matches[0].id, matches[0].similarity, n);
+        job->similarity = matches[0].similarity;
+        if (matches[0].similarity >= FACE_REC_THRESHOLD)
+            job->id = matches[0].id;
+    }
+}
+
+#ifdef CONFIG_FACE_RECOGNIZE_DUAL_CORE
+static void recognize_task(void *arg)
+{
+    recognize_job_t *job = NULL;
+
+    while (true)
+    {
+        xQueueReceive(s_recognize_queue, &job, portMAX_DELAY);
+        TRACE_BEGIN(TRACE_RECOGNIZE, job->id);
+        recognize_aligned(job);
+        TRACE_END(TRACE_RECOGNIZE, job->id);
+        xSemaphoreGive(s_recognize_done);
+    }
+}
+#endif
+
+static bool align_box(box_array_t *net_boxes, int i, dl_matrix3du_t *image_matrix, dl_matrix3du_t *aligned_face)
+{
+#ifdef CONFIG_FACE_ALIGN_FAST
+    return app_face_align(image_matrix, &net_boxes->landmark[i], aligned_face) == ESP_OK;
+#else
+    // align_face works on the first box of the list it is given
+    box_array_t one = {
+        .box = &net_boxes->box[i],
+        .landmark = &net_boxes->landmark[i],
+        .len = 1,
+    };
+    return align_face(&one, image_matrix, aligned_face) == ESP_OK;
+#endif
+}
+
+/* Greets a single face or labels each box with its recognized ID */
+static void draw_face_labels(frame_desc_t *frame, box_array_t *net_boxes, int count)
+{
+    dl_matrix3du_t *image_matrix = frame->image_matrix;
+
+    if (count == 1)
+    {
+        char name[FACE_NAME_MAX] = "";
+        if (frame->face_id >= 0 && app_face_db_get_name(frame->face_id, name, sizeof(name)) == ESP_OK && name[0])
+        {
+            rgb_printf(image_matrix, FACE_COLOR_GREEN, "Hello %s", name);
+        }
+        else if (frame->face_id >= 0)
+        {
+            rgb_printf(image_matrix, FACE_COLOR_GREEN, "Hello ID %u", frame->face_id);
+        }
+        else
+        {
+            rgb_print(image_matrix, FACE_COLOR_RED, "\nWHO?");
+        }
+        return;
+    }
+
+    // several faces, label each box
+    for (int i = 0; i < count; i++)
+    {
+        char label[FACE_NAME_MAX] = "";
+        int x = (int)net_boxes->box[i].box_p[0];
+        int y = (int)net_boxes->box[i].box_p[1] + 2;
+        if (frame->face_ids[i] >= 0)
+        {
+            if (app_face_db_get_name(frame->face_ids[i], label, sizeof(label)) != ESP_OK || !label[0])
+                snprintf(label, sizeof(label), "ID %d", frame->face_ids[i]);
+            rgb_print_at(image_matrix, x + 2, y, FACE_COLOR_GREEN, label);
+        }
+        else
+        {
+            rgb_print_at(image_matrix, x + 2, y, FACE_COLOR_RED, "WHO?");
+        }
+    }
+}
+
+static void recognize_faces(frame_desc_t *frame, box_array_t *net_boxes)
+{
+    dl_matrix3du_t *image_matrix = frame->image_matrix;
+    int count = net_boxes->len < CONFIG_FACE_RECOGNIZE_MAX ? net_boxes->len : CONFIG_FACE_RECOGNIZE_MAX;
+    bool aligned[PIPELINE_MAX_FACES] = {0};
+    recognize_job_t jobs[PIPELINE_MAX_FACES];
+#ifdef CONFIG_FACE_RECOGNIZE_DUAL_CORE
+    int offloaded = 0;
+#endif
+
+    for (int i = 0; i < count; i++)
+    {
+        // a face seen at the same place a moment ago keeps its ID
+        if (app_face_cache_lookup(&net_boxes->box[i], &frame->face_ids[i], &frame->face_similarity[i]))
+            continue;
+        aligned[i] = align_box(net_boxes, i, image_matrix, s_aligned_faces[i]);
+        jobs[i].aligned_face = s_aligned_faces[i];
+#ifdef CONFIG_FACE_QUALITY
+        // only the best face of a short window is worth an embedding
+        if (aligned[i])
+        {
+            float score = app_face_quality_score(s_aligned_faces[i], &net_boxes->box[i], &net_boxes->landmark[i]);
+            jobs[i].aligned_face = app_face_quality_select(&net_boxes->box[i], score, s_aligned_faces[i]);
+            aligned[i] = jobs[i].aligned_face != NULL;
+        }
+#endif
+    }
+
+#ifdef CONFIG_FACE_RECOGNIZE_DUAL_CORE
+    // every other face goes to the other core
+    for (int i = 1; i < count; i += 2)
+    {
+        if (aligned[i])
+        {
+            recognize_job_t *job = &jobs[i];
+            xQueueSend(s_recognize_queue, &job, portMAX_DELAY);
+            offloaded++;
+        }
+    }
+#endif
+    for (int i = 0; i < count; i++)
+    {
+#ifdef CONFIG_FACE_RECOGNIZE_DUAL_CORE
+        if (i % 2)
+            continue;
+#endif
+        if (aligned[i])
+            recognize_aligned(&jobs[i]);
+    }
+#ifdef CONFIG_FACE_RECOGNIZE_DUAL_CORE
+    while (offloaded--)
+    {
+        xSemaphoreTake(s_recognize_done, portMAX_DELAY);
+    }
+#endif
+    for (int i = 0; i < count; i++)
+    {
+        if (aligned[i])
+        {
+            frame->face_ids[i] = jobs[i].id;
+            frame->face_similarity[i] = jobs[i].similarity;
+            app_face_cache_store(&net_boxes->box[i], jobs[i].id, jobs[i].similarity);
+        }
+    }
+    frame->face_id = frame->face_ids[0];
+    draw_face_labels(frame, net_boxes, count);
+}
+
+static void recognize_frame(frame_desc_t *frame, box_array_t *net_boxes)
+{
+#ifdef CONFIG_APP_ENROLLMENT
+    dl_matrix3du_t *image_matrix = frame->image_matrix;
+    enroll_event_t status;
+
+    app_enroll_get_status(&status);
+    if (status.type == ENROLL_EVENT_SAMPLE && frame->state == START_ENROLL)
+    {
+        rgb_printf(image_matrix, FACE_COLOR_CYAN, "\nThe %u%s sample",
+                status.samples, number_suffix(status.samples));
+        frame->enroll_samples = status.samples;
+    }
+    else if (status.type == ENROLL_EVENT_DONE && esp_timer_get_time() - status.time < ENROLL_SHOW_US)
+    {
+        rgb_printf(image_matrix, FACE_COLOR_CYAN, "\n\nEnrolled Face ID: %d", status.id);
+        frame->enrolled_id = status.id;
+    }
+#endif
+
+    if (frame->state == START_RECOGNITION)
+    {
+        recognize_faces(frame, net_boxes);
+    }
+#ifdef CONFIG_APP_ENROLLMENT
+    else if (frame->state == START_ENROLL && align_box(net_boxes, 0, image_matrix, s_aligned_faces[0]))
+    {
+        rgb_print(image_matrix, FACE_COLOR_YELLOW, "START ENROLLING");
+        ESP_LOGD(TAG, "START ENROLLING");
+
+        dl_matrix3du_t *sample = s_aligned_faces[0];
+#ifdef CONFIG_FACE_QUALITY
+        // every sample is the best face of its window
+        float score = app_face_quality_score(sample, &net_boxes->box[0], &net_boxes->landmark[0]);
+        sample = app_face_quality_select(&net_boxes->box[0], score, sample);
+#endif
+        // the embedding is computed by the enrollment task, the frame goes on right away
+        if (sample && !app_enroll_submit(sample))
+        {
+            ESP_LOGD(TAG, "Enrollment busy, sample skipped");
+        }
+    }
+#endif
+}
+#endif
+
+/* A frame handed out faster than this was already waiting in the driver queue */
+#define CAPTURE_QUEUED_US       2000
+
+static volatile uint32_t s_stale_frames = 0;
+// every frame taken from the driver, skipped ones included
+static uint32_t s_sequence = 0;
+
+static camera_fb_t *capture_frame(int64_t *sensor_time)
+{
+    camera_fb_t *fb = NULL;
+#ifdef CONFIG_CAMERA_LATEST_FRAME
+    // the driver hands out the oldest buffer, skip to the one being filled
+    int tries = CONFIG_CAMERA_FB_COUNT;
+#else
+    int tries = 1;
+#endif
+#ifdef CONFIG_FRAME_SOURCE
+    if (app_frame_source() == FRAME_SOURCE_CORPUS)
+    {
+        // every corpus frame is handed out at once, none of them is stale
+        tries = 1;
+    }
+#endif
+
+    for (int i = 0; i < tries; i++)
+    {
+        int64_t start = esp_timer_get_time();
+        camera_fb_t *next = source_fb_get();
+        int64_t end = esp_timer_get_time();
+        if (!next)
+        {
+            break;
+        }
+        s_sequence++;
+        if (fb)
+        {
+            source_fb_return(fb);
+            s_stale_frames++;
+        }
+        fb = next;
+        // a frame waited for ended at VSYNC just before it was handed out,
+        // one already waiting ended before it was asked for
+        bool queued = end - start <= CAPTURE_QUEUED_US;
+        *sensor_time = queued ? start : end;
+        if (!queued)
+        {
+            break;
+        }
+    }
+    return fb;
+}
+
+#ifdef CONFIG_CAPTURE_RECOVERY
+/* Longest wait for the viewers and the stages to hand their frames back */
+#define CAPTURE_DRAIN_US        (2000 * 1000)
+
+static int s_capture_failures = 0;
+
+/* Restarts the driver, frame is the failed one, held by the capture task */
+static void capture_recover(frame_desc_t *frame, int64_t failed)
+{
+    frame_desc_t *frames[PIPELINE_DEPTH];
+    int count = 1;
+
+    // a stop or a camera change holds the lock and restarts the driver anyway
+    if (xSemaphoreTake(s_control_lock, 0) != pdTRUE)
+    {
+        return;
+    }
+    // the driver frees its buffers on deinit, every one must be back first
+    frames[0] = frame;
+    while (count < PIPELINE_DEPTH && esp_timer_get_time() - failed < CAPTURE_DRAIN_US)
+    {
+        if (xQueueReceive(s_free_queue, &frames[count], 100 / portTICK_PERIOD_MS) == pdTRUE)
+        {
+            count++;
+        }
+    }
+    if (count == PIPELINE_DEPTH)
+    {
+        esp_err_t err = app_camera_recover();
+        int64_t time = esp_timer_get_time() - failed;
+        if (err == ESP_OK)
+        {
+            s_capture_failures = 0;
+            app_metrics_observe(METRIC_CAPTURE_RECOVERY, time);
+            ESP_LOGW(TAG, "Camera recovered in %ums", (uint32_t)(time / 1000));
+        }
+        else
+        {
+            ESP_LOGE(TAG, "Camera recovery failed (0x%x)", err);
+        }
+    }
+    else
+    {
+        ESP_LOGW(TAG, "Camera recovery postponed, %d frames still in flight", PIPELINE_DEPTH - count);
+    }
+    for (int i = 1; i < count; i++)
+    {
+        xQueueSend(s_free_queue, &frames[i], portMAX_DELAY);
+    }
+    xSemaphoreGive(s_control_lock);
+}
+#endif
+
+static void capture_task(void *arg)
+{
+    frame_desc_t *frame = NULL;
+    int next = 0;
+
+    while (true)
+    {
+        xEventGroupWaitBits(s_pipeline_event_group, PIPELINE_RUN_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+        if (xQueueReceive(s_free_queue, &frame, 100 / portTICK_PERIOD_MS) != pdTRUE)
+        {
+            continue;
+        }
+#ifdef CONFIG_CAMERA_PROFILES
+        // idle watch takes a few frames per second
+        app_camera_profile_throttle();
+#endif
+        if (!pipeline_running())
+        {
+            xQueueSend(s_free_queue, &frame, portMAX_DELAY);
+            continue;
+        }
+
+        TRACE_BEGIN(TRACE_CAPTURE, 0);
+        frame->fb = capture_frame(&frame->fr_sensor);
+        frame->seq = s_sequence;
+        frame->fr_capture = esp_timer_get_time();
+        TRACE_END(TRACE_CAPTURE, frame->seq);
+        if (!frame->fb)
+        {
+            ESP_LOGE(TAG, "Camera capture failed");
+            frame->err = ESP_FAIL;
+            // passed on for the turns, but not to the viewers, they would hang up
+            frame->drop = FRAME_DROP_ERROR;
+#ifdef CONFIG_CAPTURE_RECOVERY
+            if (++s_capture_failures >= CONFIG_CAPTURE_RECOVERY_FAILS)
+            {
+                capture_recover(frame, frame->fr_capture);
+            }
+#endif
+        }
+        else
+        {
+#ifdef CONFIG_CAPTURE_RECOVERY
+            s_capture_failures = 0;
+#endif
+            frame->width = frame->fb->width;
+            frame->height = frame->fb->height;
+#ifdef CONFIG_EVENT_CLIP
+            app_clip_add_frame(frame->fb);
+#endif
+#ifdef CONFIG_PREVIEW_PANEL
+            app_preview_add_frame(frame->fb);
+#endif
+        }
+        // workers take turns, the faces stage takes the frames back in the same turns
+        xQueueSend(s_workers[next].in, &frame, portMAX_DELAY);
+        TRACE_COUNTER(TRACE_DETECT_QUEUE, uxQueueMessagesWaiting(s_workers[next].in));
+        next = (next + 1) % PIPELINE_DETECT_WORKERS;
+    }
+}
+
+static void pipeline_detect_config(const mtmn_config_t *config, int scale, mtmn_config_t *detect_config)
+{
+    *detect_config = *config;
+    // the smallest face is smaller on the downscaled image, P-Net needs at least 12 pixels
+    detect_config->min_face = config->min_face / scale;
+    if (detect_config->min_face < 12)
+    {
+        detect_config->min_face = 12;
+    }
+}
+
+static bool frame_decode_full(frame_desc_t *frame)
+{
+    frame->image_matrix = app_frame_pool_acquire(portMAX_DELAY);
+    if (!app_frame_pool_fit(frame->image_matrix, frame->width, frame->height))
+    {
+        ESP_LOGE(TAG, "Frame %ux%u does not fit the pool", frame->width, frame->height);
+        frame->err = ESP_FAIL;
+        return false;
+    }
+
+    if (!app_image_decode_full(frame->fb, frame->image_matrix))
+    {
+        ESP_LOGW(TAG, "Frame decode failed");
+    }
+    return true;
+}
+
+#if PIPELINE_DETECT_WORKERS > 1
+static int worker_detect(detect_worker_t *worker, dl_matrix3du_t *image_matrix, mtmn_config_t *config)
+{
+    // the tracker follows faces from one frame to the next, a worker only sees every other one
+    return app_track_face_detect(image_matrix, config, &worker->faces);
+}
+#else
+static int worker_detect(detect_worker_t *worker, dl_matrix3du_t *image_matrix, mtmn_config_t *config)
+{
+    return app_track_detect(image_matrix, config, &worker->faces);
+}
+#endif
+
+#ifdef CONFIG_MOTION_GATE
+static bool worker_motion(frame_desc_t *frame)
+{
+#if PIPELINE_DETECT_WORKERS > 1
+    // the gate compares with the last frame it saw, any recent one does
+    xSemaphoreTake(s_motion_lock, portMAX_DELAY);
+    bool motion = app_motion_detect(frame->fb);
+    xSemaphoreGive(s_motion_lock);
+    return motion;
+#else
+    return app_motion_detect(frame->fb);
+#endif
+}
+#endif
+
+/* Decodes the frame and looks for faces, false when it goes to the encode stage as it is */
+static bool detect_frame(detect_worker_t *worker, frame_desc_t *frame)
+{
+    mtmn_config_t *mtmn_config = &worker->mtmn_config;
+
+    worker->net_boxes = NULL;
+    worker->detect_input = NULL;
+    frame->video = s_video;
+    if (frame->err != ESP_OK || !pipeline_running())
+    {
+        return false;
+    }
+
+    // pick up settings changed over /config
+    uint32_t generation = app_config_get_mtmn(mtmn_config);
+    int scale = pipeline_detect_scale(frame->width);
+    if (generation != worker->config_generation || scale != worker->config_scale)
+    {
+        worker->config_generation = generation;
+        worker->config_scale = scale;
+        pipeline_detect_config(mtmn_config, scale, &worker->detect_config);
+    }
+    worker->scale = scale;
+
+    frame->fr_start = esp_timer_get_time();
+    // the whole frame is handled in the state it was picked up in
+    frame->state = app_event_state();
+    if (frame->state == START_RECOGNITION && app_shed_skip_recognition())
+    {
+        // faces are still detected and drawn, just not told apart
+        frame->state = START_DETECT;
+    }
+    worker->draw_overlay = PIPELINE_DRAW_OVERLAY && frame->video;
+#ifdef CONFIG_OVERLAY_COMPOSE
+    // only the blocks under the overlay are encoded again, no full frame is needed for it
+    worker->compose = worker->draw_overlay && frame->fb->format == PIXFORMAT_JPEG;
+#else
+    worker->compose = false;
+#endif
+
+#ifdef CONFIG_MOTION_GATE
+    // enrollment wants every sample, otherwise a still scene has nothing new to detect
+    bool still = frame->state != START_ENROLL && !worker_motion(frame);
+#ifdef CONFIG_CAMERA_PROFILES
+    app_camera_profile_update(!still);
+#endif
+    if (still)
+    {
+#ifdef CONFIG_MOTION_DROP_STATIC
+        frame->drop = FRAME_DROP_STILL;
+#endif
+        frame->fr_ready = frame->fr_face = frame->fr_recognize = esp_timer_get_time();
+        return false;
+    }
+#endif
+    // shed frames go by like still ones, enrollment still gets every sample
+    if (frame->state != START_ENROLL && app_shed_skip_detection())
+    {
+        frame->fr_ready = frame->fr_face = frame->fr_recognize = esp_timer_get_time();
+        return false;
+    }
+#ifdef CONFIG_OFFLOAD_INFERENCE
+    // enrollment needs the aligned face, so it stays on the device
+    if (frame->state != START_ENROLL && frame->fb->format == PIXFORMAT_JPEG)
+    {
+        app_offload_submit(frame->fb, frame->seq);
+        if (app_offload_active())
+        {
+            app_offload_get_faces(frame);
+            frame->fr_ready = frame->fr_face = frame->fr_recognize = esp_timer_get_time();
+            return false;
+        }
+    }
+#endif
+
+#ifdef CONFIG_SENSOR_WINDOW
+    // the tracked faces are somewhere else in a frame read out through a new window
+    if (app_window_moved(frame->seq))
+    {
+        app_track_reset();
+    }
+#endif
+
+    dl_matrix3du_t *matrix = worker->matrix;
+    size_t detect_width = frame->width / scale;
+    size_t detect_height = frame->height / scale;
+    if (matrix && scale > 1 && app_image_can_scale(frame->fb->format) && detect_width * detect_height <= s_detect_pixels)
+    {
+        // the frame size may have been lowered by the rate controller
+        matrix->w = detect_width;
+        matrix->h = detect_height;
+        matrix->stride = detect_width * 3;
+
+        // detect on a downscaled decode, most frames have no face to draw
+        if (!app_image_decode_strips(frame->fb, scale, matrix, worker->strip, s_strip_len))
+        {
+            ESP_LOGW(TAG, "Scaled decode failed");
+        }
+        frame->fr_ready = esp_timer_get_time();
+        worker->detect_input = matrix;
+        if (worker_detect(worker, matrix, &worker->detect_config) > 0)
+        {
+            worker->net_boxes = &worker->faces.array;
+            app_image_scale_boxes(worker->net_boxes, scale);
+        }
+        // without overlays the full frame is only needed to align faces for recognition
+        if (worker->net_boxes && ((worker->draw_overlay && !worker->compose) || frame->state == START_ENROLL || frame->state == START_RECOGNITION))
+        {
+            if (!frame_decode_full(frame))
+            {
+                return false;
+            }
+        }
+        frame->fr_face = esp_timer_get_time();
+    }
+    else
+    {
+        if (!frame_decode_full(frame))
+        {
+            return false;
+        }
+        frame->fr_ready = esp_timer_get_time();
+        worker->detect_input = frame->image_matrix;
+        if (worker_detect(worker, frame->image_matrix, mtmn_config) > 0)
+        {
+            worker->net_boxes = &worker->faces.array;
+        }
+        frame->fr_face = esp_timer_get_time();
+    }
+    return true;
+}
+
+/*
+ * Hands a frame to the encode stage. Its faces go out first, so they do not
+ * wait for the encode and send, and still go out when the video falls behind.
+ */
+static void frame_to_encode(frame_desc_t *frame)
+{
+    if (frame->drop == FRAME_DROP_NONE)
+    {
+#ifdef CONFIG_FACE_EVENTS
+        app_face_event_publish(frame);
+#endif
+#ifdef CONFIG_WS_CONTROL
+        app_ws_publish_faces(frame);
+#endif
+    }
+    xQueueSend(s_encode_queue, &frame, portMAX_DELAY);
+}
+
+/* Recognizes, crops and draws the faces a worker found and hands the frame to the encode stage */
+static void detect_faces(detect_worker_t *worker, frame_desc_t *frame)
+{
+    box_array_t *net_boxes = worker->net_boxes;
+    bool compose = worker->compose;
+
+    TRACE_BEGIN(TRACE_FACES, frame->seq);
+    s_draw_overlay = worker->draw_overlay;
+#ifdef CONFIG_OLED_THUMBNAIL
+    // before overlays go into the image
+    app_thumbnail_draw(worker->detect_input, frame->width, frame->height, net_boxes);
+#endif
+    frame->fr_recognize = frame->fr_face;
+#ifdef CONFIG_SENSOR_WINDOW
+    app_window_update(frame->seq, net_boxes, frame->width, frame->height);
+#endif
+    bool has_faces = net_boxes != NULL;
+    if (net_boxes)
+    {
+#ifdef CONFIG_CAMERA_PROFILES
+        // a face standing still keeps the camera active
+        app_camera_profile_update(true);
+#endif
+        frame_set_faces(frame, net_boxes);
+#ifdef CONFIG_FACE_CROPS
+        if (s_face_crops && s_crop_pixels)
+        {
+            // without a full decode the faces come from the detector input
+            frame_crop_faces(frame, frame->image_matrix ? frame->image_matrix : worker->matrix, frame->image_matrix ? 1 : worker->scale);
+        }
+#endif
+        if (compose)
+        {
+            frame->compose = true;
+            app_overlay_reset(&frame->overlay, frame->width, frame->height);
+            s_overlay = &frame->overlay;
+        }
+        else if (s_draw_overlay)
+        {
+            // the sensor frame is not forwarded, give it back to the driver early
+            source_fb_return(frame->fb);
+            frame->fb = NULL;
+        }
+
+#ifdef CONFIG_APP_RECOGNITION
+        recognize_frame(frame, net_boxes);
+#endif
+#ifdef CONFIG_EVENT_CLIP
+        if (frame->state == START_RECOGNITION)
+        {
+            app_clip_trigger("face");
+        }
+#endif
+
+        draw_face_boxes(frame->image_matrix, net_boxes);
+        s_overlay = NULL;
+
+        frame->fr_recognize = esp_timer_get_time();
+    }
+    if (frame->image_matrix && (!has_faces || !s_draw_overlay || compose))
+    {
+        app_frame_pool_release(frame->image_matrix);
+        frame->image_matrix = NULL;
+    }
+    TRACE_END(TRACE_FACES, frame->seq);
+    frame_to_encode(frame);
+}
+
+static void detect_task(void *arg)
+{
+    detect_worker_t *worker = (detect_worker_t *)arg;
+    frame_desc_t *frame = NULL;
+
+    while (true)
+    {
+        xQueueReceive(worker->in, &frame, portMAX_DELAY);
+#if PIPELINE_DETECT_WORKERS > 1
+        // the faces stage may still use the input and the faces of the last frame
+        xSemaphoreTake(worker->idle, portMAX_DELAY);
+        TRACE_BEGIN(TRACE_DETECT, frame->seq);
+        worker->pass = !detect_frame(worker, frame);
+        TRACE_END(TRACE_DETECT, frame->seq);
+        xQueueSend(worker->out, &frame, portMAX_DELAY);
+#else
+        TRACE_BEGIN(TRACE_DETECT, frame->seq);
+        bool detected = detect_frame(worker, frame);
+        TRACE_END(TRACE_DETECT, frame->seq);
+        if (detected)
+        {
+            detect_faces(worker, frame);
+        }
+        else
+        {
+            frame_to_encode(frame);
+        }
+#endif
+    }
+}
+
+#if PIPELINE_DETECT_WORKERS > 1
+/* Takes the frames back from the workers in the turns capture handed them out */
+static void faces_task(void *arg)
+{
+    frame_desc_t *frame = NULL;
+    int next = 0;
+
+    while (true)
+    {
+        detect_worker_t *worker = &s_workers[next];
+        next = (next + 1) % PIPELINE_DETECT_WORKERS;
+
+        xQueueReceive(worker->out, &frame, portMAX_DELAY);
+        if (worker->pass)
+        {
+            frame_to_encode(frame);
+        }
+        else
+        {
+            detect_faces(worker, frame);
+        }
+        xSemaphoreGive(worker->idle);
+    }
+}
+#endif
+
+/*
+ * Splices the overlay into the sensor JPEG. Otherwise the frame is decoded and
+ * the overlay drawn into it for a full encode, or sent without overlay when
+ * even that fails.
+ */
+static bool frame_compose(frame_desc_t *frame)
+{
+    frame->jpg = app_frame_pool_acquire_jpg(portMAX_DELAY);
+    esp_err_t err = app_overlay_compose(frame->fb->buf, frame->fb->len, &frame->overlay, frame->jpg);
+    if (err == ESP_OK)
+    {
+        frame->jpg_buf = frame->jpg->buf;
+        frame->jpg_buf_len = frame->jpg->len;
+        source_fb_return(frame->fb);
+        frame->fb = NULL;
+        return true;
+    }
+    ESP_LOGD(TAG, "Overlay not spliced: %s", esp_err_to_name(err));
+    app_frame_pool_release_jpg(frame->jpg);
+    frame->jpg = NULL;
+
+    if (frame_decode_full(frame))
+    {
+        app_overlay_draw(&frame->overlay, frame->image_matrix);
+    }
+    else
+    {
+        frame->err = ESP_OK;
+        app_frame_pool_release(frame->image_matrix);
+        frame->image_matrix = NULL;
+    }
+    return false;
+}
+
+static void encode_task(void *arg)
+{
+    frame_desc_t *frame = NULL;
+
+    while (true)
+    {
+        xQueueReceive(s_encode_queue, &frame, portMAX_DELAY);
+        TRACE_COUNTER(TRACE_ENCODE_QUEUE, uxQueueMessagesWaiting(s_encode_queue));
+        TRACE_BEGIN(TRACE_ENCODE, frame->seq);
+        if (frame->err == ESP_OK && pipeline_running())
+        {
+#ifdef CONFIG_FACE_CROPS
+            frame_encode_crops(frame);
+#endif
+            if (frame->compose && frame_compose(frame))
+            {
+                // the overlay went straight into the sensor JPEG
+            }
+            else if (frame->image_matrix)
+            {
+                frame->jpg = app_frame_pool_acquire_jpg(portMAX_DELAY);
+                uint8_t quality = app_rate_overlay_quality();
+                if (app_frame_pool_encode_faces(frame->image_matrix, quality, frame->face_boxes, frame->face_count, frame->jpg))
+                {
+                    frame->jpg_buf = frame->jpg->buf;
+                    frame->jpg_buf_len = frame->jpg->len;
+                }
+                else
+                {
+                    // pooled buffer too small for this frame, fall back to a heap buffer
+                    ESP_LOGW(TAG, "JPEG exceeds %u bytes, using heap", frame->jpg->size);
+                    app_frame_pool_release_jpg(frame->jpg);
+                    frame->jpg = NULL;
+                    if(!fmt2jpg(frame->image_matrix->item, frame->width*frame->height*3, frame->width, frame->height,
+                                PIXFORMAT_RGB888, quality, &frame->jpg_buf, &frame->jpg_buf_len))
+                    {
+                        ESP_LOGE(TAG, "fmt2jpg failed");
+                        frame->err = ESP_FAIL;
+                    }
+                }
+                app_frame_pool_release(frame->image_matrix);
+                frame->image_matrix = NULL;
+            }
+            else if (frame->fb->format != PIXFORMAT_JPEG)
+            {
+                // raw sensor frames are still streamed as JPEG, only the faces are wanted without video
+                if (!frame->video)
+                {
+                    frame->fr_encode = esp_timer_get_time();
+                    TRACE_END(TRACE_ENCODE, frame->seq);
+                    xQueueSend(s_send_queue, &frame, portMAX_DELAY);
+                    continue;
+                }
+                frame->jpg = app_frame_pool_acquire_jpg(portMAX_DELAY);
+                if (app_frame_pool_encode_fb(frame->fb, app_rate_overlay_quality(), frame->jpg))
+                {
+                    frame->jpg_buf = frame->jpg->buf;
+                    frame->jpg_buf_len = frame->jpg->len;
+                }
+                else
+                {
+                    ESP_LOGE(TAG, "Encoding the raw frame failed");
+                    frame->err = ESP_FAIL;
+                }
+            }
+            else
+            {
+                frame->jpg_buf = frame->fb->buf;
+                frame->jpg_buf_len = frame->fb->len;
+            }
+            frame->fr_encode = esp_timer_get_time();
+        }
+        TRACE_END(TRACE_ENCODE, frame->seq);
+        xQueueSend(s_send_queue, &frame, portMAX_DELAY);
+    }
+}
+
+frame_desc_t *app_pipeline_get_frame(TickType_t timeout)
+{
+    frame_desc_t *frame = NULL;
+    if (xQueueReceive(s_send_queue, &frame, timeout) != pdTRUE)
+    {
+        return NULL;
+    }
+    return frame;
+}
+
+void app_pipeline_return_frame(frame_desc_t *frame)
+{
+    frame_release(frame);
+}
+
+size_t app_pipeline_format_faces(frame_desc_t *frame, char *buf, size_t len)
+{
+    size_t n = 0;
+
+    if (PIPELINE_DRAW_OVERLAY)
+    {
+        return 0;
+    }
+
+    n += snprintf(buf + n, len - n, "X-Frame-Size: %ux%u\r\nX-Face-Count: %d\r\nX-Face-Id: %d",
+            frame->width, frame->height, frame->face_count, frame->face_ids[0]);
+    // one ID per box, -1 when not recognized
+    for (int i = 1; i < frame->face_count && n < len; i++)
+    {
+        n += snprintf(buf + n, len - n, ",%d", frame->face_ids[i]);
+    }
+    if (n < len)
+    {
+        n += snprintf(buf + n, len - n, "\r\n");
+    }
+    if (frame->enroll_samples > 0 && n < len)
+    {
+        n += snprintf(buf + n, len - n, "X-Face-Enroll: %d/%d\r\n", frame->enroll_samples, ENROLL_CONFIRM_TIMES);
+    }
+    if (frame->enrolled_id >= 0 && n < len)
+    {
+        n += snprintf(buf + n, len - n, "X-Face-Enrolled: %d\r\n", frame->enrolled_id);
+    }
+    if (frame->face_count == 0 || n >= len)
+    {
+        return n < len ? n : len - 1;
+    }
+
+    // x0,y0,x1,y1 per face, faces separated by ';'
+    n += snprintf(buf + n, len - n, "X-Face-Boxes: ");
+    for (int i = 0; i < frame->face_count && n < len; i++)
+    {
+        box_t *box = &frame->face_boxes[i];
+        n += snprintf(buf + n, len - n, "%s%d,%d,%d,%d", i ? ";" : "",
+                (int)box->box_p[0], (int)box->box_p[1], (int)box->box_p[2], (int)box->box_p[3]);
+    }
+    // five x,y points per face: left eye, right eye, nose, left and right mouth corner
+    if (n < len)
+    {
+        n += snprintf(buf + n, len - n, "\r\nX-Face-Landmarks: ");
+    }
+    for (int i = 0; i < frame->face_count && n < len; i++)
+    {
+        landmark_t *landmark = &frame->face_landmarks[i];
+        n += snprintf(buf + n, len - n, "%s", i ? ";" : "");
+        for (int j = 0; j < 10 && n < len; j++)
+        {
+            n += snprintf(buf + n, len - n, "%s%d", j ? "," : "", (int)landmark->landmark_p[j]);
+        }
+    }
+    if (n < len)
+    {
+        n += snprintf(buf + n, len - n, "\r\n");
+    }
+    return n < len ? n : len - 1;
+}
+
+void app_pipeline_log_frame(frame_desc_t *frame)
+{
+    int64_t fr_end = frame->fr_sent;
+
+    int64_t ready_time = (frame->fr_ready - frame->fr_start)/1000;
+    int64_t face_time = (frame->fr_face - frame->fr_ready)/1000;
+    int64_t recognize_time = (frame->fr_recognize - frame->fr_face)/1000;
+    int64_t encode_time = (frame->fr_encode - frame->fr_recognize)/1000;
+    int64_t process_time = (frame->fr_encode - frame->fr_start)/1000;
+
+    int64_t frame_time = fr_end - s_last_frame;
+    s_last_frame = fr_end;
+
+    app_metrics_observe(METRIC_CAPTURE_WAIT, frame->fr_start - frame->fr_capture);
+    app_metrics_observe(METRIC_DECODE, frame->fr_ready - frame->fr_start);
+    app_metrics_observe(METRIC_DETECT, frame->fr_face - frame->fr_ready);
+    app_metrics_observe(METRIC_RECOGNIZE, frame->fr_recognize - frame->fr_face);
+    app_metrics_observe(METRIC_ENCODE, frame->fr_encode - frame->fr_recognize);
+    app_metrics_observe(METRIC_LATENCY, frame->fr_sent - frame->fr_sensor);
+    app_metrics_observe(METRIC_FRAME, frame_time);
+    app_boot_mark(BOOT_PHASE_FIRST_FRAME);
+
+    frame_time /= 1000;
+    if (frame_time == 0)
+        frame_time = 1;
+    ESP_LOGD(TAG, "MJPG: %uKB %ums (%.1ffps), %u+%u+%u+%u=%u",
+            (uint32_t)(frame->jpg_buf_len/1024),
+            (uint32_t)frame_time, 1000.0 / (uint32_t)frame_time,
+            (uint32_t)ready_time, (uint32_t)face_time, (uint32_t)recognize_time, (uint32_t)encode_time, (uint32_t)process_time);
+    // time spent in each stage, including the wait in front of it
+    ESP_LOGD(TAG, "Stages: capture->detect %ums, detect %ums, encode %ums, send %ums, latency %ums",
+            (uint32_t)((frame->fr_start - frame->fr_capture)/1000),
+            (uint32_t)((frame->fr_recognize - frame->fr_start)/1000),
+            (uint32_t)((frame->fr_encode - frame->fr_recognize)/1000),
+            (uint32_t)((frame->fr_sent - frame->fr_encode)/1000),
+            (uint32_t)((frame->fr_sent - frame->fr_sensor)/1000));
+}
+
+void app_pipeline_frame_time(const frame_desc_t *frame, struct timeval *tv)
+{
+    struct timeval now;
+
+    // only as good as the system clock, which runs from boot until someone sets it
+    gettimeofday(&now, NULL);
+    int64_t us = (int64_t)now.tv_sec * 1000000 + now.tv_usec - (esp_timer_get_time() - frame->fr_sensor);
+    tv->tv_sec = us / 1000000;
+    tv->tv_usec = us % 1000000;
+}
+
+uint32_t app_pipeline_stale_frames()
+{
+    return s_stale_frames;
+}
+
+uint32_t app_pipeline_dropped_frames(frame_drop_t reason)
+{
+    return __atomic_load_n(&s_drops[reason], __ATOMIC_RELAXED);
+}
+
+const char *app_pipeline_drop_name(frame_drop_t reason)
+{
+    static const char *names[FRAME_DROP_MAX] = {
+        [FRAME_DROP_NONE]    = "none",
+        [FRAME_DROP_STILL]   = "still",
+        [FRAME_DROP_ERROR]   = "error",
+        [FRAME_DROP_STOPPED] = "stopped",
+    };
+    return names[reason];
+}
+
+void app_pipeline_get_depths(pipeline_depths_t *depths)
+{
+    depths->free = uxQueueMessagesWaiting(s_free_queue);
+    depths->detect = 0;
+    for (int i = 0; i < PIPELINE_DETECT_WORKERS; i++)
+    {
+        depths->detect += uxQueueMessagesWaiting(s_workers[i].in);
+    }
+    depths->encode = uxQueueMessagesWaiting(s_encode_queue);
+    depths->send = uxQueueMessagesWaiting(s_send_queue);
+}
+
+static void pipeline_start()
+{
+    app_power_acquire(POWER_LOCK_PIPELINE);
+    s_last_frame = esp_timer_get_time();
+    app_track_reset();
+    app_face_cache_reset();
+    app_shed_reset();
+#ifdef CONFIG_CAMERA_PROFILES
+    app_camera_profile_reset();
+#endif
+#ifdef CONFIG_FACE_QUALITY
+    app_face_quality_reset();
+#endif
+    xEventGroupSetBits(s_pipeline_event_group, PIPELINE_RUN_BIT);
+}
+
+static void pipeline_stop()
+{
+    frame_desc_t *frame = NULL;
+
+    xEventGroupClearBits(s_pipeline_event_group, PIPELINE_RUN_BIT);
+
+    // stages pass stale frames through untouched, drain them until all are free again
+    while (uxQueueMessagesWaiting(s_free_queue) < PIPELINE_DEPTH)
+    {
+        if (xQueueReceive(s_send_queue, &frame, 100 / portTICK_PERIOD_MS) == pdTRUE)
+        {
+            if (frame->drop == FRAME_DROP_NONE && frame->err == ESP_OK)
+            {
+                frame->drop = FRAME_DROP_STOPPED;
+            }
+            frame_release(frame);
+        }
+    }
+    s_last_frame = 0;
+    app_power_release(POWER_LOCK_PIPELINE);
+}
+
+esp_err_t app_pipeline_start()
+{
+    xSemaphoreTake(s_control_lock, portMAX_DELAY);
+    pipeline_start();
+    xSemaphoreGive(s_control_lock);
+    return ESP_OK;
+}
+
+void app_pipeline_stop()
+{
+    xSemaphoreTake(s_control_lock, portMAX_DELAY);
+    pipeline_stop();
+    xSemaphoreGive(s_control_lock);
+}
+
+void app_pipeline_set_video(bool enabled)
+{
+    s_video = enabled;
+}
+
+void app_pipeline_set_face_crops(bool enabled)
+{
+    s_face_crops = enabled;
+}
+
+esp_err_t app_pipeline_capture_still(camera_fb_t **fb)
+{
+    esp_err_t err = ESP_OK;
+
+    xSemaphoreTake(s_control_lock, portMAX_DELAY);
+    if (pipeline_running())
+    {
+        err = ESP_ERR_INVALID_STATE;
+    }
+    else
+    {
+        int64_t sensor_time;
+        *fb = capture_frame(&sensor_time);
+        err = *fb ? ESP_OK : ESP_FAIL;
+    }
+    xSemaphoreGive(s_control_lock);
+    return err;
+}
+
+#ifdef CONFIG_PIPELINE_BENCH
+// replayed frames go through the stage functions one at a time, with the pipeline stopped
+static frame_desc_t s_bench_frame;
+
+static inline int64_t bench_lap(int64_t *start)
+{
+    int64_t now = esp_timer_get_time();
+    int64_t us = now - *start;
+    *start = now;
+    return us;
+}
+
+/* The detect and encode stages with video on, holding the control lock */
+static esp_err_t pipeline_bench_frame(frame_desc_t *frame, int64_t us[BENCH_STAGE_MAX], int *faces)
+{
+    camera_fb_t *fb = frame->fb;
+    mtmn_config_t mtmn_config;
+    mtmn_config_t detect_config;
+    box_array_t *net_boxes = NULL;
+    int64_t start = esp_timer_get_time();
+
+    app_config_get_mtmn(&mtmn_config);
+    int scale = pipeline_detect_scale(frame->width);
+    pipeline_detect_config(&mtmn_config, scale, &detect_config);
+    s_draw_overlay = PIPELINE_DRAW_OVERLAY;
+#ifdef CONFIG_OVERLAY_COMPOSE
+    bool compose = s_draw_overlay && fb->format == PIXFORMAT_JPEG;
+#else
+    bool compose = false;
+#endif
+
+    size_t detect_width = frame->width / scale;
+    size_t detect_height = frame->height / scale;
+    dl_matrix3du_t *matrix = s_workers[0].matrix;
+    track_faces_t *found = &s_workers[0].faces;
+    if (matrix && scale > 1 && app_image_can_scale(fb->format) && detect_width * detect_height <= s_detect_pixels)
+    {
+        matrix->w = detect_width;
+        matrix->h = detect_height;
+        matrix->stride = detect_width * 3;
+        if (!app_image_decode_strips(fb, scale, matrix, s_workers[0].strip, s_strip_len))
+        {
+            return ESP_FAIL;
+        }
+        us[BENCH_STAGE_DECODE] = bench_lap(&start);
+        if (app_track_detect(matrix, &detect_config, found) > 0)
+        {
+            net_boxes = &found->array;
+            app_image_scale_boxes(net_boxes, scale);
+        }
+        us[BENCH_STAGE_DETECT] = bench_lap(&start);
+        // every face is recognized, that takes the full frame
+        if (net_boxes)
+        {
+            if (!frame_decode_full(frame))
+            {
+                return ESP_FAIL;
+            }
+            us[BENCH_STAGE_DECODE] += bench_lap(&start);
+        }
+    }
+    else
+    {
+        if (!frame_decode_full(frame))
+        {
+            return ESP_FAIL;
+        }
+        us[BENCH_STAGE_DECODE] = bench_lap(&start);
+        if (app_track_detect(frame->image_matrix, &mtmn_config, found) > 0)
+        {
+            net_boxes = &found->array;
+        }
+        us[BENCH_STAGE_DETECT] = bench_lap(&start);
+    }
+    if (!net_boxes)
+    {
+        // the sensor JPEG would be forwarded untouched
+        return ESP_OK;
+    }
+
+    *faces = net_boxes->len;
+    frame_set_faces(frame, net_boxes);
+#ifdef CONFIG_APP_RECOGNITION
+    int count = net_boxes->len < CONFIG_FACE_RECOGNIZE_MAX ? net_boxes->len : CONFIG_FACE_RECOGNIZE_MAX;
+    bool aligned[PIPELINE_MAX_FACES];
+    recognize_job_t jobs[PIPELINE_MAX_FACES];
+    for (int i = 0; i < count; i++)
+    {
+        aligned[i] = align_box(net_boxes, i, frame->image_matrix, s_aligned_faces[i]);
+        jobs[i].aligned_face = s_aligned_faces[i];
+    }
+    us[BENCH_STAGE_ALIGN] = bench_lap(&start);
+    for (int i = 0; i < count; i++)
+    {
+        if (aligned[i])
+        {
+            recognize_aligned(&jobs[i]);
+            frame->face_ids[i] = jobs[i].id;
+        }
+    }
+    frame->face_id = frame->face_ids[0];
+    us[BENCH_STAGE_RECOGNIZE] = bench_lap(&start);
+#endif
+
+    if (compose)
+    {
+        app_overlay_reset(&frame->overlay, frame->width, frame->height);
+        s_overlay = &frame->overlay;
+    }
+#ifdef CONFIG_APP_RECOGNITION
+    draw_face_labels(frame, net_boxes, count);
+#endif
+    draw_face_boxes(frame->image_matrix, net_boxes);
+    s_overlay = NULL;
+    us[BENCH_STAGE_OVERLAY] = bench_lap(&start);
+
+    frame->jpg = app_frame_pool_acquire_jpg(portMAX_DELAY);
+    bool encoded = compose && app_overlay_compose(fb->buf, fb->len, &frame->overlay, frame->jpg) == ESP_OK;
+    if (!encoded)
+    {
+        if (compose)
+        {
+            app_overlay_draw(&frame->overlay, frame->image_matrix);
+        }
+        encoded = app_frame_pool_encode_faces(frame->image_matrix, app_rate_overlay_quality(),
+                                              frame->face_boxes, frame->face_count, frame->jpg);
+    }
+    us[BENCH_STAGE_ENCODE] = bench_lap(&start);
+    app_frame_pool_release_jpg(frame->jpg);
+    frame->jpg = NULL;
+    return encoded ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t app_pipeline_bench_frame(camera_fb_t *fb, int64_t us[BENCH_STAGE_MAX], int *faces)
+{
+    frame_desc_t *frame = &s_bench_frame;
+    esp_err_t err;
+
+    for (int i = 0; i < BENCH_STAGE_MAX; i++)
+    {
+        us[i] = -1;
+    }
+    *faces = 0;
+
+    xSemaphoreTake(s_control_lock, portMAX_DELAY);
+    if (pipeline_running())
+    {
+        xSemaphoreGive(s_control_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    frame_reset(frame);
+    frame->fb = fb;
+    frame->width = fb->width;
+    frame->height = fb->height;
+    frame->video = true;
+    err = pipeline_bench_frame(frame, us, faces);
+    app_frame_pool_release(frame->image_matrix);
+    xSemaphoreGive(s_control_lock);
+    return err;
+}
+#endif
+
+/* Sizes the detector input and the motion gate for frames of up to frame_size */
+static void pipeline_alloc_buffers(framesize_t frame_size)
+{
+    size_t width, height;
+    size_t pixels = 0;
+    size_t alloc_width = 0, alloc_height = 0;
+    size_t strip_len = 0;
+
+    // a smaller frame can take a smaller scale and need a larger input
+    for (int size = 0; size <= frame_size; size++)
+    {
+        app_camera_get_resolution(size, &width, &height);
+        int scale = pipeline_detect_scale(width);
+        if (scale > 1 && (width / scale) * (height / scale) > pixels)
+        {
+            alloc_width = width / scale;
+            alloc_height = height / scale;
+            pixels = alloc_width * alloc_height;
+        }
+        if (scale > 1 && app_image_strip_len(width, scale) > strip_len)
+        {
+            strip_len = app_image_strip_len(width, scale);
+        }
+    }
+    if (pixels > s_detect_pixels)
+    {
+        bool allocated = true;
+        s_detect_pixels = 0;
+        for (int i = 0; i < PIPELINE_DETECT_WORKERS; i++)
+        {
+            detect_worker_t *worker = &s_workers[i];
+            if (worker->matrix)
+            {
+                app_mem_matrix_free(APP_MEM_DETECT_INPUT, worker->matrix);
+            }
+            worker->matrix = app_mem_matrix_alloc(APP_MEM_DETECT_INPUT, alloc_width, alloc_height, 3);
+            allocated = allocated && worker->matrix;
+        }
+        if (!allocated)
+        {
+            // workers detect alike, all of them at full resolution then
+            for (int i = 0; i < PIPELINE_DETECT_WORKERS; i++)
+            {
+                if (s_workers[i].matrix)
+                {
+                    app_mem_matrix_free(APP_MEM_DETECT_INPUT, s_workers[i].matrix);
+                    s_workers[i].matrix = NULL;
+                }
+            }
+            ESP_LOGW(TAG, "No memory for the scaled detector input, detecting at full resolution");
+        }
+        else
+        {
+            s_detect_pixels = pixels;
+        }
+    }
+#ifndef CONFIG_DETECT_INPUT_INTERNAL
+    // a few KB of internal RAM keep the decoder's scattered block writes out of PSRAM
+    if (s_detect_pixels && strip_len > s_strip_len)
+    {
+        for (int i = 0; i < PIPELINE_DETECT_WORKERS; i++)
+        {
+            detect_worker_t *worker = &s_workers[i];
+            if (worker->strip)
+            {
+                app_mem_free(APP_MEM_DECODE_STRIP, worker->strip, s_strip_len);
+            }
+            worker->strip = (uint8_t *)app_mem_alloc(APP_MEM_DECODE_STRIP, strip_len);
+        }
+        s_strip_len = strip_len;
+    }
+#endif
+
+#ifdef CONFIG_MOTION_GATE
+    if (app_motion_init(frame_size) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "No memory for the motion gate, detecting on every frame");
+    }
+#endif
+}
+
+esp_err_t app_pipeline_set_camera(const camera_settings_t *settings)
+{
+    camera_settings_t current;
+    esp_err_t err;
+
+    app_camera_get_settings(&current);
+    if (settings->frame_size == current.frame_size && settings->pixel_format == current.pixel_format)
+    {
+        // gain, exposure and quality go straight to the sensor
+        return app_camera_apply(settings);
+    }
+
+    xSemaphoreTake(s_control_lock, portMAX_DELAY);
+    bool running = pipeline_running();
+    // every frame buffer is back with the driver and every matrix in its pool once stopped
+    if (running)
+    {
+        pipeline_stop();
+    }
+    err = app_frame_pool_resize(settings->frame_size);
+    if (err == ESP_OK)
+    {
+        err = app_camera_apply(settings);
+    }
+    if (err == ESP_OK)
+    {
+        pipeline_alloc_buffers(settings->frame_size);
+    }
+    else
+    {
+        ESP_LOGE(TAG, "Camera settings not applied (0x%x)", err);
+    }
+    if (running)
+    {
+        app_rate_init();
+        pipeline_start();
+    }
+    xSemaphoreGive(s_control_lock);
+    return err;
+}
+
+#ifdef CONFIG_CAMERA_TUNE
+esp_err_t app_pipeline_tune_camera(camera_tune_t *result)
+{
+    xSemaphoreTake(s_control_lock, portMAX_DELAY);
+    bool running = pipeline_running();
+    if (running)
+    {
+        pipeline_stop();
+    }
+    // the frame size stays, so do the pools
+    esp_err_t err = app_camera_tune(result);
+    if (running)
+    {
+        app_rate_init();
+        pipeline_start();
+    }
+    xSemaphoreGive(s_control_lock);
+    return err;
+}
+#endif
+
+void app_pipeline_init()
+{
+#ifdef CONFIG_APP_RECOGNITION
+    for (int i = 0; i < CONFIG_FACE_RECOGNIZE_MAX; i++)
+    {
+        s_aligned_faces[i] = app_mem_matrix_alloc(APP_MEM_ALIGNED_FACE, FACE_WIDTH, FACE_HEIGHT, 3);
+    }
+    ESP_ERROR_CHECK(app_face_db_init(CONFIG_FACE_DB_CAPACITY));
+    ESP_ERROR_CHECK(app_face_store_init());
+#endif
+#ifdef CONFIG_APP_ENROLLMENT
+    ESP_ERROR_CHECK(app_enroll_init());
+#endif
+#ifdef CONFIG_CAMERA_PROFILES
+    ESP_ERROR_CHECK(app_camera_profile_init());
+#endif
+#ifdef CONFIG_FACE_QUALITY
+    ESP_ERROR_CHECK(app_face_quality_init());
+#endif
+
+    ESP_ERROR_CHECK(app_frame_pool_init(CAMERA_FRAME_SIZE, PIPELINE_DEPTH));
+    ESP_ERROR_CHECK(app_jpeg_init());
+    ESP_ERROR_CHECK(app_image_init());
+    s_control_lock = xSemaphoreCreateMutex();
+
+    pipeline_alloc_buffers(CAMERA_FRAME_SIZE);
+#ifdef CONFIG_FACE_CROPS
+    s_crop_pixels = (uint8_t *)app_mem_alloc(APP_MEM_FACE_CROP, CROP_PIXELS_SIZE);
+    s_crop_jpegs = (uint8_t *)app_mem_alloc(APP_MEM_FACE_CROP, CROP_JPEGS_SIZE);
+    if (!s_crop_pixels || !s_crop_jpegs)
+    {
+        ESP_LOGE(TAG, "No memory for face crops");
+        app_mem_free(APP_MEM_FACE_CROP, s_crop_pixels, CROP_PIXELS_SIZE);
+        app_mem_free(APP_MEM_FACE_CROP, s_crop_jpegs, CROP_JPEGS_SIZE);
+        s_crop_pixels = NULL;
+        s_crop_jpegs = NULL;
+    }
+#endif
+
+    s_pipeline_event_group = xEventGroupCreate();
+    s_free_queue = xQueueCreate(PIPELINE_DEPTH, sizeof(frame_desc_t *));
+    for (int i = 0; i < PIPELINE_DETECT_WORKERS; i++)
+    {
+        s_workers[i].in = xQueueCreate(PIPELINE_DEPTH, sizeof(frame_desc_t *));
+#if PIPELINE_DETECT_WORKERS > 1
+        s_workers[i].out = xQueueCreate(PIPELINE_DEPTH, sizeof(frame_desc_t *));
+        s_workers[i].idle = xSemaphoreCreateBinary();
+        xSemaphoreGive(s_workers[i].idle);
+#endif
+    }
+#if PIPELINE_DETECT_WORKERS > 1
+    s_motion_lock = xSemaphoreCreateMutex();
+#endif
+    s_encode_queue = xQueueCreate(PIPELINE_DEPTH, sizeof(frame_desc_t *));
+    s_send_queue = xQueueCreate(PIPELINE_DEPTH, sizeof(frame_desc_t *));
+
+    for (int i = 0; i < PIPELINE_DEPTH; i++)
+    {
+        frame_desc_t *frame = &s_frames[i];
+        frame_reset(frame);
+        xQueueSend(s_free_queue, &frame, portMAX_DELAY);
+    }
+
+#ifdef CONFIG_FACE_RECOGNIZE_DUAL_CORE
+    s_recognize_queue = xQueueCreate(PIPELINE_MAX_FACES, sizeof(recognize_job_t *));
+    s_recognize_done = xSemaphoreCreateCounting(PIPELINE_MAX_FACES, 0);
+    app_task_create(APP_TASK_RECOGNIZE, &recognize_task, NULL, NULL);
+#endif
+    app_task_create(APP_TASK_CAPTURE, &capture_task, NULL, NULL);
+    app_task_create(APP_TASK_DETECT, &detect_task, &s_workers[0], NULL);
+#if PIPELINE_DETECT_WORKERS > 1
+    app_task_create(APP_TASK_DETECT_2, &detect_task, &s_workers[1], NULL);
+    app_task_create(APP_TASK_FACES, &faces_task, NULL, NULL);
+#endif
+    app_task_create(APP_TASK_ENCODE, &encode_task, NULL, NULL);
+}
@@ -0,0 +1,153 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "driver/gpio.h"
+#include "soc/gpio_struct.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "app_pir.h"
+#include "app_main.h"
+#include "app_tasks.h"
+#include "app_tracer.h"
+
+static const char *TAG = "app_pir";
+
+/* Edges waiting for the subscribers, a burst beyond this keeps only the first ones */
+#define PIR_QUEUE_LEN       8
+
+typedef struct {
+    pir_callback_t callback;
+    void *arg;
+} pir_subscriber_t;
+
+static QueueHandle_t s_pir_queue = NULL;
+static pir_subscriber_t s_subscribers[PIR_MAX_SUBSCRIBERS];
+static int s_subscriber_count = 0;
+static portMUX_TYPE s_subscriber_mux = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool s_level = false;
+
+static void IRAM_ATTR pir_isr_handler(void *arg)
+{
+    BaseType_t woken = pdFALSE;
+    pir_event_t event = {
+        .level = (GPIO.in >> GPIO_PIR) & 1,   // gpio_get_level is not in IRAM
+        .time = esp_timer_get_time(),
+    };
+
+    // both edges interrupt, a bounce may repeat the level just seen
+    if (event.level == s_level)
+    {
+        return;
+    }
+    s_level = event.level;
+    TRACE_INSTANT(TRACE_PIR_ISR, event.level);
+    xQueueSendFromISR(s_pir_queue, &event, &woken);
+    if (woken)
+    {
+        portYIELD_FROM_ISR();
+    }
+}
+
+static void pir_task(void *arg)
+{
+    pir_event_t event;
+    pir_subscriber_t subscribers[PIR_MAX_SUBSCRIBERS];
+
+    while (true)
+    {
+        xQueueReceive(s_pir_queue, &event, portMAX_DELAY);
+        ESP_LOGD(TAG, "PIR %s after %lld us", event.level ? "on" : "off", esp_timer_get_time() - event.time);
+
+        portENTER_CRITICAL(&s_subscriber_mux);
+        int count = s_subscriber_count;
+        memcpy(subscribers, s_subscribers, count * sizeof(pir_subscriber_t));
+        portEXIT_CRITICAL(&s_subscriber_mux);
+
+        TRACE_BEGIN(TRACE_PIR, event.level);
+        for (int i = 0; i < count; i++)
+        {
+            subscribers[i].callback(&event, subscribers[i].arg);
+        }
+        TRACE_END(TRACE_PIR, count);
+    }
+}
+
+esp_err_t app_pir_subscribe(pir_callback_t callback, void *arg)
+{
+    esp_err_t err = ESP_OK;
+
+    portENTER_CRITICAL(&s_subscriber_mux);
+    if (s_subscriber_count < PIR_MAX_SUBSCRIBERS)
+    {
+        s_subscribers[s_subscriber_count].callback = callback;
+        s_subscribers[s_subscriber_count].arg = arg;
+        s_subscriber_count++;
+    }
+    else
+    {
+        err = ESP_ERR_NO_MEM;
+    }
+    portEXIT_CRITICAL(&s_subscriber_mux);
+    return err;
+}
+
+bool app_pir_active()
+{
+    return s_level;
+}
+
+esp_err_t app_pir_init()
+{
+    gpio_config_t gpio_conf = {
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .intr_type = GPIO_INTR_ANYEDGE,
+        .pin_bit_mask = 1LL << GPIO_PIR,
+    };
+
+    s_pir_queue = xQueueCreate(PIR_QUEUE_LEN, sizeof(pir_event_t));
+    if (!s_pir_queue)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = gpio_config(&gpio_conf);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    // the camera driver installs the same service, whoever comes first wins
+    err = gpio_install_isr_service(ESP_INTR_FLAG_LEVEL1 | ESP_INTR_FLAG_IRAM);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE)
+    {
+        return err;
+    }
+    s_level = gpio_get_level(GPIO_PIR);
+    err = app_task_create(APP_TASK_PIR, &pir_task, NULL, NULL);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    return gpio_isr_handler_add(GPIO_PIR, pir_isr_handler, NULL);
+}
@@ -0,0 +1,146 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "sdkconfig.h"
+#include "app_power.h"
+
+#ifdef CONFIG_POWER_SAVE
+static const char *TAG = "app_power";
+
+/* Every lock id takes up to two PM locks */
+#define POWER_PM_LOCKS      2
+
+static esp_pm_lock_handle_t s_locks[POWER_LOCK_MAX][POWER_PM_LOCKS];
+static bool s_held[POWER_LOCK_MAX];
+static esp_pm_config_esp32_t s_config;
+static portMUX_TYPE s_power_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static bool power_set_held(power_lock_id_t id, bool held)
+{
+    bool changed;
+
+    portENTER_CRITICAL(&s_power_mux);
+    changed = s_held[id] != held;
+    s_held[id] = held;
+    portEXIT_CRITICAL(&s_power_mux);
+    return changed;
+}
+
+static esp_err_t power_create_locks()
+{
+    // the camera and I2S DMA both stop in light sleep, the I2S clock is not scaled
+    esp_err_t err = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "pipeline", &s_locks[POWER_LOCK_PIPELINE][0]);
+    if (err == ESP_OK)
+    {
+        err = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "pipeline", &s_locks[POWER_LOCK_PIPELINE][1]);
+    }
+    if (err == ESP_OK)
+    {
+        err = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "audio", &s_locks[POWER_LOCK_AUDIO][0]);
+    }
+    return err;
+}
+#endif
+
+esp_err_t app_power_init()
+{
+#ifdef CONFIG_POWER_SAVE
+    esp_err_t err;
+    esp_pm_config_esp32_t config = {
+        .max_freq_mhz = CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_POWER_SAVE_MIN_MHZ,
+#ifdef CONFIG_POWER_SAVE_LIGHT_SLEEP
+        .light_sleep_enable = true,
+#endif
+    };
+    s_config = config;
+
+    err = power_create_locks();
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    err = esp_pm_configure(&config);
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Power management not configured (0x%x)", err);
+        return err;
+    }
+    ESP_LOGI(TAG, "CPU at %d to %d MHz, light sleep %s", config.min_freq_mhz, config.max_freq_mhz,
+            config.light_sleep_enable ? "on" : "off");
+#endif
+    return ESP_OK;
+}
+
+void app_power_acquire(power_lock_id_t id)
+{
+#ifdef CONFIG_POWER_SAVE
+    if (power_set_held(id, true))
+    {
+        for (int i = 0; i < POWER_PM_LOCKS && s_locks[id][i]; i++)
+        {
+            esp_pm_lock_acquire(s_locks[id][i]);
+        }
+    }
+#endif
+}
+
+void app_power_release(power_lock_id_t id)
+{
+#ifdef CONFIG_POWER_SAVE
+    if (power_set_held(id, false))
+    {
+        for (int i = 0; i < POWER_PM_LOCKS && s_locks[id][i]; i++)
+        {
+            esp_pm_lock_release(s_locks[id][i]);
+        }
+    }
+#endif
+}
+
+esp_err_t app_power_set_max_mhz(int mhz)
+{
+#ifdef CONFIG_POWER_SAVE
+    esp_pm_config_esp32_t config = s_config;
+
+    if (!config.max_freq_mhz)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // the locks hold whatever the maximum is, so the pipeline runs at the cap
+    if (mhz > 0 && mhz < config.max_freq_mhz)
+    {
+        config.max_freq_mhz = mhz < config.min_freq_mhz ? config.min_freq_mhz : mhz;
+    }
+    esp_err_t err = esp_pm_configure(&config);
+    if (err == ESP_OK)
+    {
+        ESP_LOGI(TAG, "CPU at %d to %d MHz", config.min_freq_mhz, config.max_freq_mhz);
+    }
+    return err;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
@@ -0,0 +1,301 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_jpg_decode.h"
+#include "sdkconfig.h"
+#include "ssd1306.h"
+#include "ssd1306_display.h"
+#include "app_preview.h"
+#include "app_tasks.h"
+#include "app_mem.h"
+
+static const char *TAG = "app_preview";
+
+#define PREVIEW_FRAME_SIZE      (CONFIG_PREVIEW_FRAME_KB * 1024)
+
+#if defined(CONFIG_PREVIEW_ILI9341)
+#define PREVIEW_PANEL_INIT      ili9341_240x320_spi_init
+#elif defined(CONFIG_PREVIEW_ST7735)
+#define PREVIEW_PANEL_INIT      st7735_128x160_spi_init
+#else
+#define PREVIEW_PANEL_INIT      ssd1351_128x128_spi_init
+#endif
+
+/* Part of a scaled frame shown on the panel, centred on both */
+typedef struct {
+    const uint8_t *src;
+    size_t len;
+    uint16_t out_w;
+    uint16_t out_h;
+    uint16_t crop_x;            /* in the scaled frame */
+    uint16_t crop_y;
+    lcdint_t panel_x;
+    lcdint_t panel_y;
+    uint16_t strip_y;           /* scaled frame row of the first row in the strip */
+    uint16_t strip_rows;
+} preview_view_t;
+
+static ssd1306_display_t s_panel;
+static lcduint_t s_panel_w;
+static lcduint_t s_panel_h;
+
+static uint8_t *s_frame = NULL;
+static camera_fb_t s_fb;            /* describes the copy in s_frame */
+static uint8_t *s_strip = NULL;     /* PREVIEW_STRIP_ROWS rows as wide as the panel */
+static volatile bool s_busy = false;
+static int64_t s_next_us = 0;
+static TaskHandle_t s_task = NULL;
+
+static int preview_scale(const camera_fb_t *fb)
+{
+    int scale = 1;
+#ifdef CONFIG_PREVIEW_FIT
+    while (scale < 8 && (fb->width / scale > s_panel_w || fb->height / scale > s_panel_h))
+    {
+        scale *= 2;
+    }
+#endif
+    return scale;
+}
+
+static void preview_view(preview_view_t *view, const camera_fb_t *fb, int scale)
+{
+    uint16_t width = fb->width / scale;
+    uint16_t height = fb->height / scale;
+
+    view->src = fb->buf;
+    view->len = fb->len;
+    view->out_w = width < s_panel_w ? width : s_panel_w;
+    view->out_h = height < s_panel_h ? height : s_panel_h;
+    view->crop_x = (width - view->out_w) / 2;
+    view->crop_y = (height - view->out_h) / 2;
+    view->panel_x = (s_panel_w - view->out_w) / 2;
+    view->panel_y = (s_panel_h - view->out_h) / 2;
+    view->strip_y = 0;
+    view->strip_rows = 0;
+}
+
+/* Sends the rows of the strip that are shown, with one window for all of them */
+static void preview_flush(preview_view_t *view)
+{
+    int first = view->strip_y > view->crop_y ? view->strip_y : view->crop_y;
+    int end = view->strip_y + view->strip_rows;
+    if (end > view->crop_y + view->out_h)
+    {
+        end = view->crop_y + view->out_h;
+    }
+    if (end > first)
+    {
+        // the OLED gets the library between strips
+        ssd1306_displayBegin(&s_panel);
+        ssd1306_drawBufferFast16(view->panel_x, view->panel_y + first - view->crop_y, view->out_w, end - first,
+                                 s_strip + (first - view->strip_y) * view->out_w * 2);
+        ssd1306_displayEnd(&s_panel);
+    }
+    view->strip_rows = 0;
+}
+
+static size_t preview_jpg_read(void *arg, size_t index, uint8_t *buf, size_t len)
+{
+    preview_view_t *view = (preview_view_t *)arg;
+
+    if (index >= view->len)
+    {
+        return 0;
+    }
+    if (index + len > view->len)
+    {
+        len = view->len - index;
+    }
+    if (buf)
+    {
+        memcpy(buf, view->src + index, len);
+    }
+    return len;
+}
+
+/* Blocks of an MCU row arrive left to right, the strip goes out when the next row starts */
+static bool preview_jpg_write(void *arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data)
+{
+    preview_view_t *view = (preview_view_t *)arg;
+
+    if (!data)
+    {
+        // start and end of the image
+        return true;
+    }
+    if (h > PREVIEW_STRIP_ROWS)
+    {
+        return false;
+    }
+    if (view->strip_rows && y != view->strip_y)
+    {
+        preview_flush(view);
+    }
+    view->strip_y = y;
+    view->strip_rows = h;
+
+    int first = x > view->crop_x ? x : view->crop_x;
+    int end = x + w < view->crop_x + view->out_w ? x + w : view->crop_x + view->out_w;
+    for (int row = 0; row < h; row++)
+    {
+        const uint8_t *src = data + (row * w + first - x) * 3;
+        uint8_t *dst = s_strip + (row * view->out_w + first - view->crop_x) * 2;
+        for (int i = first; i < end; i++)
+        {
+            // the decoder outputs RGB, the panel takes RGB565 high byte first
+            uint16_t color = ((src[0] & 0xF8) << 8) | ((src[1] & 0xFC) << 3) | (src[2] >> 3);
+            dst[0] = color >> 8;
+            dst[1] = color;
+            src += 3;
+            dst += 2;
+        }
+    }
+    return true;
+}
+
+/* Sensor RGB565 is high byte first already, rows are only sampled */
+static void preview_draw_rgb565(preview_view_t *view, int scale)
+{
+    for (int o = 0; o < view->out_h; o++)
+    {
+        const uint8_t *src = s_fb.buf + ((view->crop_y + o) * scale * s_fb.width + view->crop_x * scale) * 2;
+        uint8_t *dst = s_strip + view->strip_rows * view->out_w * 2;
+        if (scale == 1)
+        {
+            memcpy(dst, src, view->out_w * 2);
+        }
+        else
+        {
+            for (int i = 0; i < view->out_w; i++)
+            {
+                dst[0] = src[0];
+                dst[1] = src[1];
+                dst += 2;
+                src += scale * 2;
+            }
+        }
+        if (view->strip_rows == 0)
+        {
+            view->strip_y = view->crop_y + o;
+        }
+        if (++view->strip_rows == PREVIEW_STRIP_ROWS)
+        {
+            preview_flush(view);
+        }
+    }
+    if (view->strip_rows)
+    {
+        preview_flush(view);
+    }
+}
+
+static void preview_task(void *arg)
+{
+    static const jpg_scale_t jpg_scales[] = { JPG_SCALE_NONE, JPG_SCALE_2X, 0, JPG_SCALE_4X, 0, 0, 0, JPG_SCALE_8X };
+    preview_view_t view;
+
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        int scale = preview_scale(&s_fb);
+        preview_view(&view, &s_fb, scale);
+        if (s_fb.format == PIXFORMAT_JPEG)
+        {
+            if (esp_jpg_decode(s_fb.len, jpg_scales[scale - 1], preview_jpg_read, preview_jpg_write, &view) != ESP_OK)
+            {
+                ESP_LOGD(TAG, "Frame not decoded");
+            }
+            if (view.strip_rows)
+            {
+                preview_flush(&view);
+            }
+        }
+        else
+        {
+            preview_draw_rgb565(&view, scale);
+        }
+        s_busy = false;
+    }
+}
+
+void app_preview_add_frame(const camera_fb_t *fb)
+{
+    if (!s_task || s_busy)
+    {
+        return;
+    }
+    if (fb->format != PIXFORMAT_JPEG && fb->format != PIXFORMAT_RGB565)
+    {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    if (now < s_next_us || fb->len > PREVIEW_FRAME_SIZE)
+    {
+        return;
+    }
+    s_next_us = now + 1000000 / CONFIG_PREVIEW_FPS;
+
+    memcpy(s_frame, fb->buf, fb->len);
+    s_fb = *fb;
+    s_fb.buf = s_frame;
+    s_busy = true;
+    xTaskNotifyGive(s_task);
+}
+
+esp_err_t app_preview_init()
+{
+    if (CONFIG_PREVIEW_SPI_SCLK < 0 || CONFIG_PREVIEW_SPI_MOSI < 0 ||
+        CONFIG_PREVIEW_SPI_CS < 0 || CONFIG_PREVIEW_SPI_DC < 0)
+    {
+        ESP_LOGE(TAG, "Preview pins are not set");
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_frame = (uint8_t *)app_mem_alloc(APP_MEM_PREVIEW_FRAME, PREVIEW_FRAME_SIZE);
+    if (!s_frame)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // the OLED stays the display of the global api
+    ssd1306_displayBegin(&s_panel);
+    ssd1306_platform_spiSetPins(CONFIG_PREVIEW_SPI_SCLK, CONFIG_PREVIEW_SPI_MOSI);
+    PREVIEW_PANEL_INIT(CONFIG_PREVIEW_SPI_RST, CONFIG_PREVIEW_SPI_CS, CONFIG_PREVIEW_SPI_DC);
+    ssd1306_setMode(LCD_MODE_NORMAL);
+    ssd1306_clearScreen8();
+    s_panel_w = ssd1306_displayWidth();
+    s_panel_h = ssd1306_displayHeight();
+    ssd1306_displayEnd(&s_panel);
+
+    s_strip = (uint8_t *)app_mem_alloc(APP_MEM_PREVIEW_STRIP, s_panel_w * PREVIEW_STRIP_ROWS * 2);
+    if (!s_strip)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Preview on %ux%u panel", s_panel_w, s_panel_h);
+    return app_task_create(APP_TASK_PREVIEW, &preview_task, NULL, &s_task);
+}
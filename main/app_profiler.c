@@ -0,0 +1,216 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/xtensa_context.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_freertos_hooks.h"
+#include "sdkconfig.h"
+#include "app_profiler.h"
+
+#ifdef CONFIG_PROFILER
+static const char *TAG = "app_profiler";
+
+#define PROFILER_SLOTS      CONFIG_PROFILE_SLOTS
+#define PROFILER_MAX_TASKS  32
+/* Slots tried after the hashed one before a sample is dropped */
+#define PROFILER_PROBES     8
+#define PROFILER_LINE_LEN   1024
+#define PROFILER_MAX_SECONDS    60
+
+typedef struct {
+    uint32_t pc;
+    uint32_t caller;
+    uint32_t task;          /* index in s_tasks plus one, 0 for a free slot */
+    uint32_t count;
+} profiler_slot_t;
+
+typedef struct {
+    TaskHandle_t handle;
+    char name[configMAX_TASK_NAME_LEN];
+} profiler_task_t;
+
+/* Internal RAM, the tick still interrupts while flash operations disable the cache */
+static profiler_slot_t *s_slots = NULL;
+static profiler_task_t s_tasks[PROFILER_MAX_TASKS];
+static int s_task_count = 0;
+static profiler_stats_t s_stats;
+static bool s_running = false;
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/* Names are copied at the first sample, tasks may be deleted before the profile is read */
+static uint32_t IRAM_ATTR profiler_task(TaskHandle_t handle)
+{
+    for (int i = 0; i < s_task_count; i++)
+    {
+        if (s_tasks[i].handle == handle)
+        {
+            return i + 1;
+        }
+    }
+    if (s_task_count == PROFILER_MAX_TASKS)
+    {
+        return 0;
+    }
+    profiler_task_t *task = &s_tasks[s_task_count];
+    const char *name = pcTaskGetTaskName(handle);
+    int i = 0;
+    while (i < configMAX_TASK_NAME_LEN - 1 && name[i])
+    {
+        task->name[i] = name[i];
+        i++;
+    }
+    task->name[i] = '\0';
+    task->handle = handle;
+    return ++s_task_count;
+}
+
+static void IRAM_ATTR profiler_tick(void)
+{
+    TaskHandle_t handle = xTaskGetCurrentTaskHandle();
+    // the interrupt entry saved the context of the task at its top of stack, the first member of the TCB
+    const XtExcFrame *frame = *(XtExcFrame **)handle;
+    uint32_t pc = frame->pc;
+    // windowed calls keep the window increment in the top bits of the return address
+    uint32_t caller = frame->a0 ? (frame->a0 & 0x3fffffff) | 0x40000000 : 0;
+
+    portENTER_CRITICAL_ISR(&s_mux);
+    s_stats.samples++;
+    uint32_t task = profiler_task(handle);
+    uint32_t hash = (pc ^ (caller * 31) ^ (task * 0x9e3779b1)) % PROFILER_SLOTS;
+    bool counted = false;
+    for (int i = 0; task && i <= PROFILER_PROBES && !counted; i++)
+    {
+        profiler_slot_t *slot = &s_slots[(hash + i) % PROFILER_SLOTS];
+        if (!slot->task)
+        {
+            slot->pc = pc;
+            slot->caller = caller;
+            slot->task = task;
+            s_stats.stacks++;
+        }
+        if (slot->pc == pc && slot->caller == caller && slot->task == task)
+        {
+            slot->count++;
+            counted = true;
+        }
+    }
+    if (!counted)
+    {
+        s_stats.dropped++;
+    }
+    portEXIT_CRITICAL_ISR(&s_mux);
+}
+
+esp_err_t app_profiler_run(uint32_t seconds, profiler_stats_t *stats)
+{
+    esp_err_t err = ESP_OK;
+
+    if (seconds < 1 || seconds > PROFILER_MAX_SECONDS)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&s_mux);
+    bool busy = s_running;
+    s_running = true;
+    portEXIT_CRITICAL(&s_mux);
+    if (busy)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (!s_slots)
+    {
+        s_slots = heap_caps_malloc(PROFILER_SLOTS * sizeof(profiler_slot_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    if (!s_slots)
+    {
+        err = ESP_ERR_NO_MEM;
+        goto out;
+    }
+    memset(s_slots, 0, PROFILER_SLOTS * sizeof(profiler_slot_t));
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_task_count = 0;
+
+    ESP_LOGI(TAG, "Sampling both cores at %d Hz for %us", CONFIG_FREERTOS_HZ, seconds);
+    for (int core = 0; core < portNUM_PROCESSORS && err == ESP_OK; core++)
+    {
+        err = esp_register_freertos_tick_hook_for_cpu(profiler_tick, core);
+    }
+    if (err == ESP_OK)
+    {
+        vTaskDelay(seconds * 1000 / portTICK_PERIOD_MS);
+    }
+    for (int core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        esp_deregister_freertos_tick_hook_for_cpu(profiler_tick, core);
+    }
+
+    portENTER_CRITICAL(&s_mux);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_mux);
+    ESP_LOGI(TAG, "%u samples in %u stacks, %u dropped", stats->samples, stats->stacks, stats->dropped);
+out:
+    s_running = false;
+    return err;
+}
+
+esp_err_t app_profiler_write_folded(profiler_write_cb write, void *arg)
+{
+    char buf[PROFILER_LINE_LEN];
+    esp_err_t res = ESP_OK;
+    int n = 0;
+
+    for (int i = 0; s_slots && i < PROFILER_SLOTS && res == ESP_OK; i++)
+    {
+        const profiler_slot_t *slot = &s_slots[i];
+        if (!slot->task)
+        {
+            continue;
+        }
+        // the longest line needs less than a tenth of the buffer
+        if (n > PROFILER_LINE_LEN * 9 / 10)
+        {
+            res = write(arg, buf, n);
+            n = 0;
+        }
+        const char *name = s_tasks[slot->task - 1].name;
+        if (slot->caller)
+        {
+            n += snprintf(buf + n, sizeof(buf) - n, "%s;0x%08x;0x%08x %u\n", name, slot->caller, slot->pc, slot->count);
+        }
+        else
+        {
+            n += snprintf(buf + n, sizeof(buf) - n, "%s;0x%08x %u\n", name, slot->pc, slot->count);
+        }
+    }
+    if (res == ESP_OK && n > 0)
+    {
+        res = write(arg, buf, n);
+    }
+    return res;
+}
+#endif
@@ -0,0 +1,225 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_camera.h"
+#include "app_rate.h"
+
+static const char *TAG = "app_rate";
+
+/* Consecutive frames over or under budget before a step is taken */
+#define RATE_DEGRADE_FRAMES     5
+#define RATE_UPGRADE_FRAMES     30
+
+typedef struct {
+    framesize_t frame_size;
+    uint8_t sensor_quality;
+    uint8_t overlay_quality;
+} rate_level_t;
+
+/*
+ * Quality goes first, the frame size is only lowered once quality is used up.
+ * Frame size and sensor quality never go above what the camera is set to.
+ */
+static const rate_level_t s_levels[] = {
+    { FRAMESIZE_UXGA,    RATE_SENSOR_QUALITY_BEST, RATE_OVERLAY_QUALITY_BEST },
+    { FRAMESIZE_UXGA,    15, 80 },
+    { FRAMESIZE_UXGA,    20, 70 },
+    { FRAMESIZE_HQVGA,   20, 70 },
+    { FRAMESIZE_QQVGA,   25, 60 },
+};
+
+#define RATE_LEVELS     (sizeof(s_levels) / sizeof(s_levels[0]))
+
+static portMUX_TYPE s_rate_mux = portMUX_INITIALIZER_UNLOCKED;
+/* Held while the limits change and a level is written to the sensor, SCCB blocks */
+static SemaphoreHandle_t s_apply_lock = NULL;
+static int s_level = 0;
+static int s_over = 0;
+static int s_under = 0;
+static int64_t s_send_avg = 0;      /* us */
+static int64_t s_process_avg = 0;   /* us */
+static int64_t s_bytes_avg = 0;
+static uint8_t s_overlay_quality = RATE_OVERLAY_QUALITY_BEST;
+static framesize_t s_frame_size_limit[RATE_LIMIT_MAX] = {
+    [RATE_LIMIT_SHED]       = RATE_FRAME_SIZE_MAX,
+    [RATE_LIMIT_PROFILE]    = RATE_FRAME_SIZE_MAX,
+};
+
+static framesize_t rate_smaller_frame_size(framesize_t a, framesize_t b)
+{
+    size_t a_width, a_height, b_width, b_height;
+
+    app_camera_get_resolution(a, &a_width, &a_height);
+    app_camera_get_resolution(b, &b_width, &b_height);
+    return a_width * a_height > b_width * b_height ? b : a;
+}
+
+static framesize_t rate_frame_size(const rate_level_t *level)
+{
+    // never go above the size the camera and frame pool are set up for, nor the limit
+    framesize_t frame_size = rate_smaller_frame_size(level->frame_size, app_camera_frame_size());
+    for (int i = 0; i < RATE_LIMIT_MAX; i++)
+    {
+        frame_size = rate_smaller_frame_size(frame_size, s_frame_size_limit[i]);
+    }
+    return frame_size;
+}
+
+static int rate_sensor_quality(const rate_level_t *level)
+{
+    return level->sensor_quality > app_camera_quality() ? level->sensor_quality : app_camera_quality();
+}
+
+void app_rate_lock()
+{
+    if (!s_apply_lock)
+    {
+        // the limits may be set before the first stream, by whichever task comes first
+        SemaphoreHandle_t lock = xSemaphoreCreateRecursiveMutex();
+        configASSERT(lock);
+        portENTER_CRITICAL(&s_rate_mux);
+        if (!s_apply_lock)
+        {
+            s_apply_lock = lock;
+            lock = NULL;
+        }
+        portEXIT_CRITICAL(&s_rate_mux);
+        if (lock)
+        {
+            vSemaphoreDelete(lock);
+        }
+    }
+    xSemaphoreTakeRecursive(s_apply_lock, portMAX_DELAY);
+}
+
+void app_rate_unlock()
+{
+    xSemaphoreGiveRecursive(s_apply_lock);
+}
+
+/* Writes the current level to the sensor, call with the apply lock held */
+static void rate_apply()
+{
+    portENTER_CRITICAL(&s_rate_mux);
+    int index = s_level;
+    portEXIT_CRITICAL(&s_rate_mux);
+
+    const rate_level_t *level = &s_levels[index];
+    sensor_t *s = esp_camera_sensor_get();
+
+    if (s)
+    {
+        framesize_t frame_size = rate_frame_size(level);
+        if (s->status.framesize != frame_size)
+        {
+            s->set_framesize(s, frame_size);
+        }
+        s->set_quality(s, rate_sensor_quality(level));
+    }
+    s_overlay_quality = level->overlay_quality;
+    ESP_LOGI(TAG, "Level %d: frame size %d, quality %u/%u, send %ums, process %ums",
+            index, level->frame_size, level->sensor_quality, level->overlay_quality,
+            (uint32_t)(s_send_avg / 1000), (uint32_t)(s_process_avg / 1000));
+}
+
+void app_rate_update(frame_desc_t *frame, int64_t send_us)
+{
+#ifdef CONFIG_STREAM_ADAPTIVE
+    const int64_t period_us = 1000000 / CONFIG_STREAM_TARGET_FPS;
+    int step = 0;
+
+    portENTER_CRITICAL(&s_rate_mux);
+    // moving averages over about 8 frames
+    s_send_avg += (send_us - s_send_avg) / 8;
+    s_process_avg += ((frame->fr_encode - frame->fr_start) - s_process_avg) / 8;
+    s_bytes_avg += ((int64_t)frame->jpg_buf_len - s_bytes_avg) / 8;
+
+    bool over = s_send_avg > period_us || s_process_avg > period_us;
+    bool under = s_send_avg < period_us / 2 && s_process_avg < period_us / 2;
+    if (CONFIG_STREAM_TARGET_KBPS > 0)
+    {
+        int64_t kbps = s_bytes_avg * 8 * CONFIG_STREAM_TARGET_FPS / 1000;
+        over = over || kbps > CONFIG_STREAM_TARGET_KBPS;
+        under = under && kbps < CONFIG_STREAM_TARGET_KBPS / 2;
+    }
+
+    s_over = over ? s_over + 1 : 0;
+    s_under = under ? s_under + 1 : 0;
+    if (s_over >= RATE_DEGRADE_FRAMES && s_level < RATE_LEVELS - 1)
+    {
+        step = 1;
+    }
+    else if (s_under >= RATE_UPGRADE_FRAMES && s_level > 0)
+    {
+        step = -1;
+    }
+    if (step)
+    {
+        s_level += step;
+        s_over = 0;
+        s_under = 0;
+    }
+    portEXIT_CRITICAL(&s_rate_mux);
+
+    // sensor registers are written over SCCB, not from inside the critical section,
+    // the level is read again under the lock so that the last step is the one applied
+    if (step)
+    {
+        app_rate_lock();
+        rate_apply();
+        app_rate_unlock();
+    }
+#endif
+}
+
+void app_rate_set_frame_size_limit(rate_limit_t owner, framesize_t frame_size)
+{
+    app_rate_lock();
+    if (frame_size != s_frame_size_limit[owner])
+    {
+        s_frame_size_limit[owner] = frame_size;
+        rate_apply();
+    }
+    app_rate_unlock();
+}
+
+uint8_t app_rate_overlay_quality()
+{
+    return s_overlay_quality;
+}
+
+void app_rate_init()
+{
+    app_rate_lock();
+    portENTER_CRITICAL(&s_rate_mux);
+    s_level = 0;
+    s_over = 0;
+    s_under = 0;
+    s_send_avg = 0;
+    s_process_avg = 0;
+    s_bytes_avg = 0;
+    portEXIT_CRITICAL(&s_rate_mux);
+    rate_apply();
+    app_rate_unlock();
+}
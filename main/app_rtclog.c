@@ -0,0 +1,288 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "app_rtclog.h"
+#include "app_event.h"
+#include "app_mem.h"
+
+#ifdef CONFIG_RTC_LOG
+static const char *TAG = "app_rtclog";
+
+/* RTC slow memory has no initial value, the magic tells a log from noise */
+#define RTCLOG_MAGIC        0x474c5452  /* "RTLG" */
+#define RTCLOG_EVENTS       CONFIG_RTC_LOG_EVENTS
+#define RTCLOG_FRAMES       CONFIG_RTC_LOG_FRAMES
+#define RTCLOG_LINE_LEN     512
+/* Stalls logged closer together than this are left out, the first one says enough */
+#define RTCLOG_STALL_GAP_US 1000000
+
+typedef struct {
+    uint32_t time;          /* ms since boot */
+    uint8_t type;
+    uint8_t arg;
+    uint8_t core;
+    uint8_t reserved;
+    uint32_t a;
+    uint32_t b;
+} rtclog_event_t;
+
+/* Stage times in ms, each including the wait in front of the stage */
+typedef struct {
+    uint32_t seq;
+    uint32_t time;          /* ms since boot the frame was sent */
+    uint16_t capture;
+    uint16_t detect;
+    uint16_t recognize;
+    uint16_t encode;
+    uint16_t send;
+    uint8_t faces;
+    uint8_t drop;
+} rtclog_frame_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t boot;          /* boots since the log was started */
+    uint32_t reset_reason;  /* of the boot the records are of */
+    uint32_t events;        /* recorded, the ring index is this modulo RTCLOG_EVENTS */
+    uint32_t frames;
+    rtclog_event_t event[RTCLOG_EVENTS];
+    rtclog_frame_t frame[RTCLOG_FRAMES];
+} rtclog_t;
+
+static RTC_NOINIT_ATTR rtclog_t s_log;
+/* Copy of the records of the last boot, NULL when there were none */
+static rtclog_t *s_last = NULL;
+static portMUX_TYPE s_log_mux = portMUX_INITIALIZER_UNLOCKED;
+static int64_t s_last_stall = -RTCLOG_STALL_GAP_US;
+
+static const char *s_type_names[RTCLOG_MAX] = {
+    [RTCLOG_BOOT]       = "boot",
+    [RTCLOG_STATE]      = "state",
+    [RTCLOG_STALL]      = "stall",
+    [RTCLOG_ALLOC_FAIL] = "alloc_fail",
+};
+
+static const char *s_reset_names[] = {
+    [ESP_RST_UNKNOWN]   = "unknown",
+    [ESP_RST_POWERON]   = "poweron",
+    [ESP_RST_EXT]       = "ext",
+    [ESP_RST_SW]        = "sw",
+    [ESP_RST_PANIC]     = "panic",
+    [ESP_RST_INT_WDT]   = "int_wdt",
+    [ESP_RST_TASK_WDT]  = "task_wdt",
+    [ESP_RST_WDT]       = "wdt",
+    [ESP_RST_DEEPSLEEP] = "deepsleep",
+    [ESP_RST_BROWNOUT]  = "brownout",
+    [ESP_RST_SDIO]      = "sdio",
+};
+
+static const char *rtclog_reset_name(uint32_t reason)
+{
+    return reason < sizeof(s_reset_names) / sizeof(s_reset_names[0]) ? s_reset_names[reason] : "unknown";
+}
+
+static void rtclog_state_changed(en_fsm_state state, en_fsm_state prev, app_event_type_t event, void *arg)
+{
+    app_rtclog_event(RTCLOG_STATE, event, state, prev);
+}
+
+esp_err_t app_rtclog_init()
+{
+    esp_reset_reason_t reason = esp_reset_reason();
+    uint32_t boot = 0;
+
+    // after a power cycle the memory holds whatever it came up with
+    if (s_log.magic == RTCLOG_MAGIC && reason != ESP_RST_POWERON)
+    {
+        s_last = (rtclog_t *)app_mem_alloc(APP_MEM_RTCLOG, sizeof(rtclog_t));
+        if (s_last)
+        {
+            memcpy(s_last, &s_log, sizeof(rtclog_t));
+        }
+        boot = s_log.boot + 1;
+        ESP_LOGI(TAG, "Boot %u after %s, %u events and %u frames of the last boot kept",
+                boot, rtclog_reset_name(reason), s_log.events, s_log.frames);
+    }
+    memset(&s_log, 0, sizeof(s_log));
+    s_log.boot = boot;
+    s_log.reset_reason = reason;
+    s_log.magic = RTCLOG_MAGIC;
+    app_rtclog_event(RTCLOG_BOOT, 0, reason, 0);
+    return app_event_subscribe(rtclog_state_changed, NULL);
+}
+
+void app_rtclog_event(rtclog_type_t type, uint8_t arg, uint32_t a, uint32_t b)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_log_mux);
+    if (type == RTCLOG_STALL && now - s_last_stall < RTCLOG_STALL_GAP_US)
+    {
+        portEXIT_CRITICAL(&s_log_mux);
+        return;
+    }
+    s_last_stall = type == RTCLOG_STALL ? now : s_last_stall;
+    rtclog_event_t *event = &s_log.event[s_log.events++ % RTCLOG_EVENTS];
+    portEXIT_CRITICAL(&s_log_mux);
+
+    event->time = (uint32_t)(now / 1000);
+    event->type = type;
+    event->arg = arg;
+    event->core = xPortGetCoreID();
+    event->a = a;
+    event->b = b;
+}
+
+static inline uint16_t rtclog_ms(int64_t from, int64_t to)
+{
+    int64_t ms = (to - from) / 1000;
+    return ms < 0 ? 0 : (ms > UINT16_MAX ? UINT16_MAX : ms);
+}
+
+void app_rtclog_frame(const frame_desc_t *frame)
+{
+    portENTER_CRITICAL(&s_log_mux);
+    rtclog_frame_t *record = &s_log.frame[s_log.frames++ % RTCLOG_FRAMES];
+    portEXIT_CRITICAL(&s_log_mux);
+
+    record->seq = frame->seq;
+    record->time = (uint32_t)(frame->fr_sent / 1000);
+    record->capture = rtclog_ms(frame->fr_capture, frame->fr_start);
+    record->detect = rtclog_ms(frame->fr_start, frame->fr_face);
+    record->recognize = rtclog_ms(frame->fr_face, frame->fr_recognize);
+    record->encode = rtclog_ms(frame->fr_recognize, frame->fr_encode);
+    record->send = rtclog_ms(frame->fr_encode, frame->fr_sent);
+    record->faces = frame->face_count;
+    record->drop = frame->drop;
+}
+
+static int rtclog_write_event(const rtclog_event_t *event, char *buf, int size)
+{
+    const char *type = event->type < RTCLOG_MAX ? s_type_names[event->type] : "unknown";
+    int n = snprintf(buf, size, "{\"t\":%u,\"type\":\"%s\",\"core\":%u", event->time, type, event->core);
+
+    switch (event->type)
+    {
+    case RTCLOG_BOOT:
+        n += snprintf(buf + n, size - n, ",\"reason\":\"%s\"}", rtclog_reset_name(event->a));
+        break;
+    case RTCLOG_STATE:
+        n += snprintf(buf + n, size - n, ",\"state\":\"%s\",\"prev\":\"%s\",\"event\":%u}",
+                app_event_state_name(event->a), app_event_state_name(event->b), event->arg);
+        break;
+    case RTCLOG_STALL:
+        n += snprintf(buf + n, size - n, ",\"stage\":%u,\"ms\":%u}", event->a, event->b);
+        break;
+    case RTCLOG_ALLOC_FAIL:
+        n += snprintf(buf + n, size - n, ",\"buffer\":\"%s\",\"bytes\":%u}",
+                event->a < APP_MEM_MAX ? app_mem_desc(event->a)->name : "unknown", event->b);
+        break;
+    default:
+        n += snprintf(buf + n, size - n, ",\"a\":%u,\"b\":%u}", event->a, event->b);
+        break;
+    }
+    return n;
+}
+
+static int rtclog_write_frame(const rtclog_frame_t *frame, char *buf, int size)
+{
+    return snprintf(buf, size, "{\"seq\":%u,\"t\":%u,\"capture\":%u,\"detect\":%u,\"recognize\":%u,"
+            "\"encode\":%u,\"send\":%u,\"faces\":%u,\"drop\":%u}",
+            frame->seq, frame->time, frame->capture, frame->detect, frame->recognize,
+            frame->encode, frame->send, frame->faces, frame->drop);
+}
+
+/* Writes one log, the records of this boot may change meanwhile and are copied one by one */
+static esp_err_t rtclog_write_log(const rtclog_t *log, rtclog_write_cb write, void *arg)
+{
+    char buf[RTCLOG_LINE_LEN];
+    rtclog_event_t event;
+    rtclog_frame_t frame;
+    uint32_t events = log->events;
+    uint32_t frames = log->frames;
+    uint32_t first = events > RTCLOG_EVENTS ? events - RTCLOG_EVENTS : 0;
+    esp_err_t res = ESP_OK;
+
+    int n = snprintf(buf, sizeof(buf), "{\"boot\":%u,\"reset_reason\":\"%s\",\"events_lost\":%u,\"events\":[",
+            log->boot, rtclog_reset_name(log->reset_reason), first);
+    for (uint32_t i = first; i != events && res == ESP_OK; i++)
+    {
+        // the longest record needs less than a quarter of the buffer
+        if (n > RTCLOG_LINE_LEN * 3 / 4)
+        {
+            res = write(arg, buf, n);
+            n = 0;
+        }
+        event = log->event[i % RTCLOG_EVENTS];
+        n += snprintf(buf + n, sizeof(buf) - n, i != first ? ",\n" : "\n");
+        n += rtclog_write_event(&event, buf + n, sizeof(buf) - n);
+    }
+    n += snprintf(buf + n, sizeof(buf) - n, "],\"frames\":[");
+    first = frames > RTCLOG_FRAMES ? frames - RTCLOG_FRAMES : 0;
+    for (uint32_t i = first; i != frames && res == ESP_OK; i++)
+    {
+        if (n > RTCLOG_LINE_LEN * 3 / 4)
+        {
+            res = write(arg, buf, n);
+            n = 0;
+        }
+        frame = log->frame[i % RTCLOG_FRAMES];
+        n += snprintf(buf + n, sizeof(buf) - n, i != first ? ",\n" : "\n");
+        n += rtclog_write_frame(&frame, buf + n, sizeof(buf) - n);
+    }
+    if (res == ESP_OK)
+    {
+        n += snprintf(buf + n, sizeof(buf) - n, "]}");
+        res = write(arg, buf, n);
+    }
+    return res;
+}
+
+esp_err_t app_rtclog_write_json(rtclog_write_cb write, void *arg)
+{
+    esp_err_t res = write(arg, "{\"last\":", 8);
+
+    if (res == ESP_OK)
+    {
+        res = s_last ? rtclog_write_log(s_last, write, arg) : write(arg, "null", 4);
+    }
+    if (res == ESP_OK)
+    {
+        res = write(arg, ",\"current\":", 11);
+    }
+    if (res == ESP_OK)
+    {
+        res = rtclog_write_log(&s_log, write, arg);
+    }
+    if (res == ESP_OK)
+    {
+        res = write(arg, "}\n", 2);
+    }
+    return res;
+}
+#endif
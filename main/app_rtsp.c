@@ -0,0 +1,522 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "sdkconfig.h"
+#include "app_rtsp.h"
+#include "app_stream.h"
+#include "app_tasks.h"
+
+static const char *TAG = "app_rtsp";
+
+#define RTSP_REQUEST_MAX        1024
+#define RTSP_RESPONSE_MAX       768
+#define RTSP_SESSION_TIMEOUT_S  60
+// longer than a viewer waits on a blocked send
+#define RTSP_CLOSE_WAIT_MS      7000
+
+#define RTP_HEADER_LEN          12
+#define RTP_JPEG_HEADER_LEN     8
+#define RTP_RESTART_HEADER_LEN  4
+#define RTP_QUANT_HEADER_LEN    4
+#define RTP_PAYLOAD_JPEG        26
+#define RTP_CLOCK_KHZ           90
+#define RTP_SEND_RETRIES        5
+
+typedef struct {
+    const uint8_t *scan;        /* entropy coded data after SOS */
+    size_t scan_len;
+    const uint8_t *qt[2];       /* 8 bit luma and chroma tables */
+    uint16_t width;
+    uint16_t height;
+    uint16_t restart_interval;
+    uint8_t type;               /* 0 for 4:2:2, 1 for 4:2:0 */
+} rtp_jpeg_t;
+
+typedef struct {
+    int sock;
+    struct sockaddr_in peer;
+    uint16_t seq;
+    uint32_t ssrc;
+    uint8_t *packet;
+    bool playing;
+    stream_sink_t sink;
+    SemaphoreHandle_t closed;   /* given once the viewer task is done with the sink */
+} rtp_session_t;
+
+static rtp_session_t s_session;
+
+static inline uint16_t rtp_be16(const uint8_t *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static bool rtp_parse_jpeg(const uint8_t *buf, size_t len, rtp_jpeg_t *jpeg)
+{
+    size_t i = 2;
+
+    memset(jpeg, 0, sizeof(*jpeg));
+    if (len < 4 || buf[0] != 0xFF || buf[1] != 0xD8)
+    {
+        return false;
+    }
+    while (i + 4 <= len)
+    {
+        if (buf[i] != 0xFF)
+        {
+            return false;
+        }
+        uint8_t marker = buf[i + 1];
+        size_t seg_len = rtp_be16(buf + i + 2);
+        const uint8_t *seg = buf + i + 4;
+        if (seg_len < 2 || i + 2 + seg_len > len)
+        {
+            return false;
+        }
+        seg_len -= 2;
+
+        if (marker == 0xDB)
+        {
+            for (size_t j = 0; j + 65 <= seg_len; j += 65)
+            {
+                // 16 bit tables are not carried by RFC 2435 with 8 bit precision
+                if ((seg[j] >> 4) != 0)
+                {
+                    return false;
+                }
+                if ((seg[j] & 0x0F) < 2)
+                {
+                    jpeg->qt[seg[j] & 0x0F] = seg + j + 1;
+                }
+            }
+        }
+        else if (marker == 0xC0)
+        {
+            if (seg_len < 15 || seg[5] != 3)
+            {
+                return false;
+            }
+            jpeg->height = rtp_be16(seg + 1);
+            jpeg->width = rtp_be16(seg + 3);
+            // sampling factors of Y, the chroma components are 1x1
+            if (seg[7] == 0x21)
+            {
+                jpeg->type = 0;
+            }
+            else if (seg[7] == 0x22)
+            {
+                jpeg->type = 1;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        else if (marker == 0xDD && seg_len >= 2)
+        {
+            jpeg->restart_interval = rtp_be16(seg);
+        }
+        else if (marker == 0xDA)
+        {
+            jpeg->scan = seg + seg_len;
+            jpeg->scan_len = buf + len - jpeg->scan;
+            // the sensor pads its buffers after EOI
+            while (jpeg->scan_len >= 2
+            && !(jpeg->scan[jpeg->scan_len - 2] == 0xFF && jpeg->scan[jpeg->scan_len - 1] == 0xD9))
+            {
+                jpeg->scan_len--;
+            }
+            if (jpeg->scan_len >= 2)
+            {
+                jpeg->scan_len -= 2;
+            }
+            break;
+        }
+        i += 2 + seg_len + 2;
+    }
+    return jpeg->scan && jpeg->scan_len > 0 && jpeg->qt[0] && jpeg->qt[1]
+        && jpeg->width > 0 && jpeg->width <= 2040 && jpeg->height > 0 && jpeg->height <= 2040;
+}
+
+static esp_err_t rtp_send_packet(rtp_session_t *session, size_t len)
+{
+    for (int i = 0; i < RTP_SEND_RETRIES; i++)
+    {
+        if (sendto(session->sock, session->packet, len, 0, (struct sockaddr *)&session->peer, sizeof(session->peer)) == len)
+        {
+            return ESP_OK;
+        }
+        if (errno != ENOMEM && errno != EAGAIN)
+        {
+            return ESP_FAIL;
+        }
+        // out of pbufs, wait for the WiFi driver to drain the queue
+        vTaskDelay(1);
+    }
+    return ESP_ERR_TIMEOUT;
+}
+
+static esp_err_t rtp_send_frame(void *arg, frame_desc_t *frame)
+{
+    rtp_session_t *session = (rtp_session_t *)arg;
+    rtp_jpeg_t jpeg;
+
+    if (frame->err != ESP_OK)
+    {
+        return frame->err;
+    }
+    if (!rtp_parse_jpeg(frame->jpg_buf, frame->jpg_buf_len, &jpeg))
+    {
+        // e.g. grayscale, which RFC 2435 has no type for
+        ESP_LOGD(TAG, "Frame not sent, JPEG layout not supported");
+        return ESP_OK;
+    }
+
+    uint32_t timestamp = (uint32_t)(frame->fr_sensor * RTP_CLOCK_KHZ / 1000);
+    uint8_t type = jpeg.type | (jpeg.restart_interval ? 64 : 0);
+    size_t offset = 0;
+
+    while (offset < jpeg.scan_len)
+    {
+        uint8_t *p = session->packet;
+
+        p[0] = 0x80;
+        p[1] = RTP_PAYLOAD_JPEG;
+        p[2] = session->seq >> 8;
+        p[3] = session->seq;
+        p[4] = timestamp >> 24;
+        p[5] = timestamp >> 16;
+        p[6] = timestamp >> 8;
+        p[7] = timestamp;
+        p[8] = session->ssrc >> 24;
+        p[9] = session->ssrc >> 16;
+        p[10] = session->ssrc >> 8;
+        p[11] = session->ssrc;
+        p += RTP_HEADER_LEN;
+
+        p[0] = 0;
+        p[1] = offset >> 16;
+        p[2] = offset >> 8;
+        p[3] = offset;
+        p[4] = type;
+        p[5] = 255;     // quantization tables in band
+        p[6] = jpeg.width / 8;
+        p[7] = jpeg.height / 8;
+        p += RTP_JPEG_HEADER_LEN;
+
+        if (jpeg.restart_interval)
+        {
+            p[0] = jpeg.restart_interval >> 8;
+            p[1] = jpeg.restart_interval;
+            // F and L set with count 0x3FFF: packets are not aligned to restart
+            // intervals, the receiver reassembles the whole frame (RFC 2435 3.1.7)
+            p[2] = 0xFF;
+            p[3] = 0xFF;
+            p += RTP_RESTART_HEADER_LEN;
+        }
+        if (offset == 0)
+        {
+            p[0] = 0;
+            p[1] = 0;
+            p[2] = 0;
+            p[3] = 128;
+            memcpy(p + RTP_QUANT_HEADER_LEN, jpeg.qt[0], 64);
+            memcpy(p + RTP_QUANT_HEADER_LEN + 64, jpeg.qt[1], 64);
+            p += RTP_QUANT_HEADER_LEN + 128;
+        }
+
+        size_t room = CONFIG_RTP_MTU - (p - session->packet);
+        size_t chunk = jpeg.scan_len - offset < room ? jpeg.scan_len - offset : room;
+        memcpy(p, jpeg.scan + offset, chunk);
+        offset += chunk;
+        if (offset == jpeg.scan_len)
+        {
+            session->packet[1] |= 0x80;
+        }
+        session->seq++;
+
+        esp_err_t err = rtp_send_packet(session, p + chunk - session->packet);
+        if (err == ESP_ERR_TIMEOUT)
+        {
+            // the rest of this frame is lost anyway, the client resyncs on the next one
+            return ESP_OK;
+        }
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+static void rtp_close(void *arg)
+{
+    rtp_session_t *session = (rtp_session_t *)arg;
+
+    xSemaphoreGive(session->closed);
+}
+
+static void rtsp_teardown(rtp_session_t *session)
+{
+    if (session->playing)
+    {
+        app_stream_remove_sink(&session->sink);
+        if (xSemaphoreTake(session->closed, RTSP_CLOSE_WAIT_MS / portTICK_PERIOD_MS) != pdTRUE)
+        {
+            // the viewer task still holds the socket, leak it rather than reuse it
+            ESP_LOGE(TAG, "RTP viewer did not stop");
+            session->sock = -1;
+        }
+        session->playing = false;
+    }
+    if (session->sock >= 0)
+    {
+        close(session->sock);
+        session->sock = -1;
+    }
+}
+
+static int rtsp_header_int(const char *req, const char *name)
+{
+    const char *p = strstr(req, name);
+    return p ? atoi(p + strlen(name)) : -1;
+}
+
+static int rtsp_setup(rtp_session_t *session, int conn, const char *req, char *res, size_t res_len, int cseq)
+{
+    const char *transport = strstr(req, "\nTransport:");
+    const char *ports = transport ? strstr(transport, "client_port=") : NULL;
+    int rtp_port = ports ? atoi(ports + strlen("client_port=")) : 0;
+
+    if (!ports || strstr(transport, "RTP/AVP/TCP") || rtp_port <= 0 || rtp_port > 65534)
+    {
+        return snprintf(res, res_len, "RTSP/1.0 461 Unsupported Transport\r\nCSeq: %d\r\n\r\n", cseq);
+    }
+
+    rtsp_teardown(session);
+    struct sockaddr_in local;
+    socklen_t addr_len = sizeof(local);
+    socklen_t peer_len = sizeof(session->peer);
+    getpeername(conn, (struct sockaddr *)&session->peer, &peer_len);
+    session->peer.sin_port = htons(rtp_port);
+
+    session->sock = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (session->sock < 0 || bind(session->sock, (struct sockaddr *)&local, sizeof(local)) != 0
+    || getsockname(session->sock, (struct sockaddr *)&local, &addr_len) != 0)
+    {
+        rtsp_teardown(session);
+        return snprintf(res, res_len, "RTSP/1.0 500 Internal Server Error\r\nCSeq: %d\r\n\r\n", cseq);
+    }
+    session->ssrc = esp_random();
+    session->seq = esp_random();
+
+    int server_port = ntohs(local.sin_port);
+    return snprintf(res, res_len,
+            "RTSP/1.0 200 OK\r\nCSeq: %d\r\n"
+            "Transport: RTP/AVP;unicast;client_port=%d-%d;server_port=%d-%d;ssrc=%08X\r\n"
+            "Session: %08X;timeout=%d\r\n\r\n",
+            cseq, rtp_port, rtp_port + 1, server_port, server_port + 1, session->ssrc,
+            session->ssrc, RTSP_SESSION_TIMEOUT_S);
+}
+
+static int rtsp_play(rtp_session_t *session, char *res, size_t res_len, int cseq)
+{
+    if (session->sock < 0)
+    {
+        return snprintf(res, res_len, "RTSP/1.0 455 Method Not Valid in This State\r\nCSeq: %d\r\n\r\n", cseq);
+    }
+    if (!session->playing)
+    {
+        xSemaphoreTake(session->closed, 0);
+        esp_err_t err = app_stream_add_sink(&session->sink, session->sock);
+        if (err == ESP_ERR_INVALID_STATE)
+        {
+            // not woken up yet, same as /face_stream
+            return snprintf(res, res_len, "RTSP/1.0 455 Method Not Valid in This State\r\nCSeq: %d\r\n\r\n", cseq);
+        }
+        if (err != ESP_OK)
+        {
+            return snprintf(res, res_len, "RTSP/1.0 453 Not Enough Bandwidth\r\nCSeq: %d\r\n\r\n", cseq);
+        }
+        session->playing = true;
+    }
+    return snprintf(res, res_len, "RTSP/1.0 200 OK\r\nCSeq: %d\r\nSession: %08X\r\nRange: npt=0.000-\r\n\r\n",
+            cseq, session->ssrc);
+}
+
+static int rtsp_handle(rtp_session_t *session, int conn, const char *req, char *res, size_t res_len)
+{
+    int cseq = rtsp_header_int(req, "\nCSeq:");
+
+    if (!strncmp(req, "OPTIONS ", 8) || !strncmp(req, "GET_PARAMETER ", 14))
+    {
+        return snprintf(res, res_len, "RTSP/1.0 200 OK\r\nCSeq: %d\r\n"
+                "Public: OPTIONS, DESCRIBE, SETUP, PLAY, TEARDOWN, GET_PARAMETER\r\n\r\n", cseq);
+    }
+    if (!strncmp(req, "DESCRIBE ", 9))
+    {
+        char sdp[256];
+        char url[128];
+        struct sockaddr_in local;
+        socklen_t addr_len = sizeof(local);
+
+        getsockname(conn, (struct sockaddr *)&local, &addr_len);
+        url[0] = 0;
+        sscanf(req + 9, "%127s", url);
+        if (strlen(url) > 0 && url[strlen(url) - 1] == '/')
+        {
+            url[strlen(url) - 1] = 0;
+        }
+        int sdp_len = snprintf(sdp, sizeof(sdp),
+                "v=0\r\no=- %u 1 IN IP4 %s\r\ns=esp-eye\r\nc=IN IP4 0.0.0.0\r\nt=0 0\r\n"
+                "m=video 0 RTP/AVP %d\r\na=control:*\r\n",
+                esp_random(), inet_ntoa(local.sin_addr), RTP_PAYLOAD_JPEG);
+        return snprintf(res, res_len, "RTSP/1.0 200 OK\r\nCSeq: %d\r\nContent-Base: %s/\r\n"
+                "Content-Type: application/sdp\r\nContent-Length: %d\r\n\r\n%s",
+                cseq, url, sdp_len, sdp);
+    }
+    if (!strncmp(req, "SETUP ", 6))
+    {
+        return rtsp_setup(session, conn, req, res, res_len, cseq);
+    }
+    if (!strncmp(req, "PLAY ", 5))
+    {
+        return rtsp_play(session, res, res_len, cseq);
+    }
+    if (!strncmp(req, "TEARDOWN ", 9))
+    {
+        rtsp_teardown(session);
+        return snprintf(res, res_len, "RTSP/1.0 200 OK\r\nCSeq: %d\r\n\r\n", cseq);
+    }
+    return snprintf(res, res_len, "RTSP/1.0 501 Not Implemented\r\nCSeq: %d\r\n\r\n", cseq);
+}
+
+static void rtsp_serve(rtp_session_t *session, int conn)
+{
+    char req[RTSP_REQUEST_MAX + 1];
+    char res[RTSP_RESPONSE_MAX];
+    size_t len = 0;
+
+    struct timeval tv = { .tv_sec = RTSP_SESSION_TIMEOUT_S, .tv_usec = 0 };
+    setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    while (true)
+    {
+        char *end = NULL;
+        req[len] = 0;
+        while (!(end = strstr(req, "\r\n\r\n")))
+        {
+            if (len == RTSP_REQUEST_MAX)
+            {
+                return;
+            }
+            int ret = recv(conn, req + len, RTSP_REQUEST_MAX - len, 0);
+            if (ret <= 0)
+            {
+                return;
+            }
+            len += ret;
+            req[len] = 0;
+        }
+        end += 4;
+
+        // no method this server knows takes a body, skip whatever was sent
+        int body = rtsp_header_int(req, "\nContent-Length:");
+        size_t used = end - req + (body > 0 ? body : 0);
+        end[-2] = 0;
+        int res_len = rtsp_handle(session, conn, req, res, sizeof(res));
+        if (res_len > 0 && send(conn, res, res_len < sizeof(res) ? res_len : sizeof(res) - 1, 0) < 0)
+        {
+            return;
+        }
+        if (used >= len)
+        {
+            len = 0;
+        }
+        else
+        {
+            memmove(req, req + used, len - used);
+            len -= used;
+        }
+    }
+}
+
+static void rtsp_task(void *arg)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CONFIG_RTSP_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, 1) != 0)
+    {
+        ESP_LOGE(TAG, "Could not listen on port %d", CONFIG_RTSP_PORT);
+        if (listener >= 0)
+        {
+            close(listener);
+        }
+        app_task_exit(APP_TASK_RTSP);
+    }
+    ESP_LOGI(TAG, "Listening on port %d", CONFIG_RTSP_PORT);
+
+    while (true)
+    {
+        int conn = accept(listener, NULL, NULL);
+        if (conn < 0)
+        {
+            vTaskDelay(100 / portTICK_PERIOD_MS);
+            continue;
+        }
+        rtsp_serve(&s_session, conn);
+        rtsp_teardown(&s_session);
+        close(conn);
+    }
+}
+
+esp_err_t app_rtsp_init()
+{
+    s_session.sock = -1;
+    s_session.packet = malloc(CONFIG_RTP_MTU);
+    s_session.closed = xSemaphoreCreateBinary();
+    if (!s_session.packet || !s_session.closed)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    s_session.sink.name = "rtp";
+    s_session.sink.send = rtp_send_frame;
+    s_session.sink.close = rtp_close;
+    s_session.sink.arg = &s_session;
+    return app_task_create(APP_TASK_RTSP, &rtsp_task, NULL, NULL);
+}
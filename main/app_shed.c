@@ -0,0 +1,275 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "app_shed.h"
+#include "app_rate.h"
+#include "app_rtclog.h"
+
+static const char *TAG = "app_shed";
+
+/* Updates in a row over budget before a step is taken, or well under it before one is undone */
+#define SHED_STEP_FRAMES        5
+#define SHED_RECOVER_FRAMES     30
+/* A single frame this many times over budget is a stall, the step is taken at once */
+#define SHED_STALL_FACTOR       4
+/* Frame size limit of the last level */
+#define SHED_FRAME_SIZE         FRAMESIZE_QVGA
+
+static const char *s_level_names[SHED_LEVEL_MAX] = {
+    [SHED_LEVEL_NONE]           = "none",
+    [SHED_LEVEL_NO_RECOGNITION] = "no_recognition",
+    [SHED_LEVEL_HALF_DETECT]    = "half_detect",
+    [SHED_LEVEL_LOW_RESOLUTION] = "low_resolution",
+};
+
+#ifdef CONFIG_LOAD_SHEDDING
+static const char *s_stage_names[SHED_STAGE_MAX] = {
+    [SHED_STAGE_DETECT]    = "detect",
+    [SHED_STAGE_RECOGNIZE] = "recognize",
+    [SHED_STAGE_ENCODE]    = "encode",
+    [SHED_STAGE_SEND]      = "send",
+};
+
+static const int64_t s_budgets[SHED_STAGE_MAX] = {
+    [SHED_STAGE_DETECT]    = CONFIG_SHED_DETECT_MS * 1000,
+    [SHED_STAGE_RECOGNIZE] = CONFIG_SHED_RECOGNIZE_MS * 1000,
+    [SHED_STAGE_ENCODE]    = CONFIG_SHED_ENCODE_MS * 1000,
+    [SHED_STAGE_SEND]      = CONFIG_SHED_SEND_MS * 1000,
+};
+#endif
+
+static portMUX_TYPE s_shed_mux = portMUX_INITIALIZER_UNLOCKED;
+static shed_level_t s_level = SHED_LEVEL_NONE;
+static shed_level_t s_floor = SHED_LEVEL_NONE;
+static int64_t s_avg[SHED_STAGE_MAX];   /* us */
+static int s_over = 0;
+static int s_under = 0;
+static uint32_t s_steps_up = 0;
+static uint32_t s_steps_down = 0;
+static uint32_t s_detect_count = 0;
+
+/*
+ * Sets the limit of the current level. The hub, the viewer tasks and the battery
+ * task all change the level, it is read under the rate lock so that transitions
+ * reach the sensor in order and do not interleave with the rate controller.
+ */
+static void shed_apply()
+{
+    app_rate_lock();
+    portENTER_CRITICAL(&s_shed_mux);
+    bool low = s_level >= SHED_LEVEL_LOW_RESOLUTION;
+    portEXIT_CRITICAL(&s_shed_mux);
+    app_rate_set_frame_size_limit(RATE_LIMIT_SHED, low ? SHED_FRAME_SIZE : RATE_FRAME_SIZE_MAX);
+    app_rate_unlock();
+}
+
+#ifdef CONFIG_LOAD_SHEDDING
+/* Call inside s_shed_mux, returns the stage furthest over budget or SHED_STAGE_MAX */
+static shed_stage_t shed_check()
+{
+    shed_stage_t worst = SHED_STAGE_MAX;
+    int64_t worst_excess = 0;
+    bool under = true;
+
+    for (int i = 0; i < SHED_STAGE_MAX; i++)
+    {
+        int64_t excess = s_avg[i] - s_budgets[i];
+        if (excess > worst_excess)
+        {
+            worst = i;
+            worst_excess = excess;
+        }
+        under = under && s_avg[i] < s_budgets[i] / 2;
+    }
+    s_over = worst != SHED_STAGE_MAX ? s_over + 1 : 0;
+    s_under = under ? s_under + 1 : 0;
+    return worst;
+}
+
+static void shed_observe(const int64_t *us)
+{
+    shed_stage_t stage = SHED_STAGE_MAX;
+    shed_level_t from, to;
+    bool stall = false;
+
+    portENTER_CRITICAL(&s_shed_mux);
+    // moving averages over about 8 updates, stages without a new time keep theirs
+    for (int i = 0; i < SHED_STAGE_MAX; i++)
+    {
+        if (us[i] < 0)
+        {
+            continue;
+        }
+        s_avg[i] += (us[i] - s_avg[i]) / 8;
+        if (us[i] > s_budgets[i] * SHED_STALL_FACTOR)
+        {
+            stall = true;
+            stage = i;
+        }
+    }
+    shed_stage_t worst = shed_check();
+    if (!stall)
+    {
+        stage = worst;
+    }
+
+    from = s_level;
+    if ((stall || s_over >= SHED_STEP_FRAMES) && s_level < SHED_LEVEL_MAX - 1)
+    {
+        s_level++;
+        s_steps_up++;
+    }
+    else if (s_under >= SHED_RECOVER_FRAMES && s_level > s_floor)
+    {
+        s_level--;
+        s_steps_down++;
+    }
+    to = s_level;
+    if (to != from)
+    {
+        s_over = 0;
+        s_under = 0;
+    }
+    int64_t avg = stage != SHED_STAGE_MAX ? s_avg[stage] : 0;
+    int64_t last = stage != SHED_STAGE_MAX ? us[stage] : 0;
+    portEXIT_CRITICAL(&s_shed_mux);
+
+#ifdef CONFIG_RTC_LOG
+    if (stall)
+    {
+        app_rtclog_event(RTCLOG_STALL, 0, stage, (uint32_t)(last / 1000));
+    }
+#endif
+    if (to == from)
+    {
+        return;
+    }
+    // sensor registers are written over SCCB, not from inside the critical section
+    shed_apply();
+    if (to > from)
+    {
+        ESP_LOGW(TAG, "Shed %s -> %s: %s %s at %ums, average %ums, budget %ums",
+                s_level_names[from], s_level_names[to], s_stage_names[stage], stall ? "stalled" : "over budget",
+                (uint32_t)(last / 1000), (uint32_t)(avg / 1000), (uint32_t)(s_budgets[stage] / 1000));
+    }
+    else
+    {
+        ESP_LOGI(TAG, "Recovered %s -> %s, all stages under half their budget",
+                s_level_names[from], s_level_names[to]);
+    }
+}
+#endif
+
+void app_shed_update(frame_desc_t *frame)
+{
+#ifdef CONFIG_LOAD_SHEDDING
+    int64_t us[SHED_STAGE_MAX] = {
+        [SHED_STAGE_DETECT]    = frame->fr_face - frame->fr_capture,
+        [SHED_STAGE_RECOGNIZE] = frame->fr_recognize - frame->fr_face,
+        [SHED_STAGE_ENCODE]    = frame->fr_encode - frame->fr_recognize,
+        [SHED_STAGE_SEND]      = -1,
+    };
+    shed_observe(us);
+#endif
+}
+
+void app_shed_update_send(int64_t send_us)
+{
+#ifdef CONFIG_LOAD_SHEDDING
+    int64_t us[SHED_STAGE_MAX] = { -1, -1, -1, send_us };
+    shed_observe(us);
+#endif
+}
+
+bool app_shed_skip_recognition()
+{
+    return s_level >= SHED_LEVEL_NO_RECOGNITION;
+}
+
+bool app_shed_skip_detection()
+{
+    // only the detect task gets here
+    return s_level >= SHED_LEVEL_HALF_DETECT && (++s_detect_count & 1);
+}
+
+void app_shed_set_floor(shed_level_t floor)
+{
+    portENTER_CRITICAL(&s_shed_mux);
+    shed_level_t from = s_level;
+    s_floor = floor;
+    // raised at once, lowered by the monitor as the stages recover
+    if (s_level < floor)
+    {
+        s_level = floor;
+        s_over = 0;
+        s_under = 0;
+    }
+#ifndef CONFIG_LOAD_SHEDDING
+    // without the monitor nobody else would step it down
+    s_level = floor;
+#endif
+    shed_level_t to = s_level;
+    portEXIT_CRITICAL(&s_shed_mux);
+
+    if (to != from)
+    {
+        shed_apply();
+        ESP_LOGI(TAG, "Floor %s, level %s -> %s", s_level_names[floor], s_level_names[from], s_level_names[to]);
+    }
+}
+
+shed_level_t app_shed_level()
+{
+    return s_level;
+}
+
+const char *app_shed_level_name(shed_level_t level)
+{
+    return level < SHED_LEVEL_MAX ? s_level_names[level] : "unknown";
+}
+
+uint32_t app_shed_steps(bool up)
+{
+    return up ? s_steps_up : s_steps_down;
+}
+
+void app_shed_reset()
+{
+    portENTER_CRITICAL(&s_shed_mux);
+    shed_level_t from = s_level;
+    shed_level_t to = s_floor;
+    s_level = to;
+    s_over = 0;
+    s_under = 0;
+    for (int i = 0; i < SHED_STAGE_MAX; i++)
+    {
+        s_avg[i] = 0;
+    }
+    portEXIT_CRITICAL(&s_shed_mux);
+
+    if (to != from)
+    {
+        shed_apply();
+    }
+}
@@ -0,0 +1,203 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "driver/rtc_io.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "sdkconfig.h"
+#include "ssd1306.h"
+#include "app_sleep.h"
+#include "app_main.h"
+#include "app_display.h"
+#include "app_event.h"
+#include "app_pir.h"
+#include "app_stream.h"
+#include "app_tasks.h"
+
+#ifdef CONFIG_DEEP_SLEEP
+static const char *TAG = "app_sleep";
+
+/* RTC memory is loaded from the image on a cold boot, so the magic is only there after sleeping */
+#define SLEEP_CACHE_MAGIC   0x534c5031
+
+typedef struct {
+    uint32_t magic;
+    bool camera_valid;              /* the camera was running when the chip went to sleep */
+    camera_settings_t camera;
+    network_config_t network;
+} sleep_cache_t;
+
+static RTC_DATA_ATTR sleep_cache_t s_cache;
+static bool s_resumed = false;
+static volatile bool s_activity = false;
+
+static void sleep_arm()
+{
+    // GPIO0 has a pull-up on the board, the RTC one keeps it high with the digital pads off
+    rtc_gpio_pullup_en(GPIO_BUTTON);
+    esp_sleep_enable_ext0_wakeup(GPIO_BUTTON, 0);
+    if (rtc_gpio_is_valid_gpio(GPIO_PIR))
+    {
+        esp_sleep_enable_ext1_wakeup(1ULL << GPIO_PIR, ESP_EXT1_WAKEUP_ANY_HIGH);
+    }
+    else if (CONFIG_DEEP_SLEEP_PIR_POLL_MS > 0)
+    {
+        esp_sleep_enable_timer_wakeup(CONFIG_DEEP_SLEEP_PIR_POLL_MS * 1000ULL);
+    }
+}
+
+static void sleep_display_off(void *arg)
+{
+    ssd1306_displayOff();
+}
+
+static void sleep_start()
+{
+    ESP_LOGI(TAG, "Idle for %d s, going to deep sleep", CONFIG_DEEP_SLEEP_IDLE_S);
+    s_cache.camera_valid = esp_camera_sensor_get() != NULL;
+    if (s_cache.camera_valid)
+    {
+        app_camera_get_settings(&s_cache.camera);
+    }
+    app_config_get_network(&s_cache.network);
+    s_cache.magic = SLEEP_CACHE_MAGIC;
+
+    // the panel is powered from the 3.3 V rail, it would light up all the sleep long
+    app_display_run(sleep_display_off, NULL);
+    esp_wifi_stop();
+    sleep_arm();
+    esp_deep_sleep_start();
+}
+
+// a wakeup or a short PIR pulse between two checks counts too
+static void sleep_state_changed(en_fsm_state state, en_fsm_state prev, app_event_type_t event, void *arg)
+{
+    s_activity = true;
+}
+
+static void sleep_pir_changed(const pir_event_t *event, void *arg)
+{
+    s_activity = true;
+}
+
+static void sleep_task(void *arg)
+{
+    const int64_t idle_us = CONFIG_DEEP_SLEEP_IDLE_S * 1000000LL;
+    int64_t last_activity = esp_timer_get_time();
+
+    while (true)
+    {
+        vTaskDelay(1000 / portTICK_PERIOD_MS);
+
+        en_fsm_state state = app_event_state();
+        int64_t now = esp_timer_get_time();
+        if (s_activity || app_pir_active() || app_stream_client_count() > 0
+        || state == START_ENROLL || state == START_DELETE)
+        {
+            s_activity = false;
+            last_activity = now;
+        }
+        else if (now - last_activity >= idle_us)
+        {
+            sleep_start();
+        }
+    }
+}
+#endif
+
+bool app_sleep_check()
+{
+#ifdef CONFIG_DEEP_SLEEP
+    esp_sleep_wakeup_cause_t cause = esp_sleep_get_wakeup_cause();
+
+    if (cause == ESP_SLEEP_WAKEUP_TIMER)
+    {
+        // GPIO_PIR cannot wake the chip, so it is looked at here, before anything starts
+        gpio_set_direction(GPIO_PIR, GPIO_MODE_INPUT);
+        if (!gpio_get_level(GPIO_PIR))
+        {
+            sleep_arm();
+            esp_deep_sleep_start();
+        }
+    }
+    else if (cause != ESP_SLEEP_WAKEUP_EXT0 && cause != ESP_SLEEP_WAKEUP_EXT1)
+    {
+        return false;
+    }
+    s_resumed = s_cache.magic == SLEEP_CACHE_MAGIC;
+    ESP_LOGI(TAG, "Woken up by the %s", cause == ESP_SLEEP_WAKEUP_EXT0 ? "button" : "PIR");
+    return s_resumed;
+#else
+    return false;
+#endif
+}
+
+esp_err_t app_sleep_init()
+{
+#ifdef CONFIG_DEEP_SLEEP
+    esp_err_t err = app_event_subscribe(sleep_state_changed, NULL);
+    if (err == ESP_OK)
+    {
+        err = app_pir_subscribe(sleep_pir_changed, NULL);
+    }
+    if (err == ESP_OK)
+    {
+        err = app_task_create(APP_TASK_SLEEP, &sleep_task, NULL, NULL);
+    }
+    if (!rtc_gpio_is_valid_gpio(GPIO_PIR) && CONFIG_DEEP_SLEEP_PIR_POLL_MS == 0)
+    {
+        ESP_LOGW(TAG, "GPIO %d is no RTC GPIO, only the button wakes up from deep sleep", GPIO_PIR);
+    }
+    return err;
+#else
+    return ESP_OK;
+#endif
+}
+
+bool app_sleep_get_network(network_config_t *config)
+{
+#ifdef CONFIG_DEEP_SLEEP
+    if (s_resumed)
+    {
+        *config = s_cache.network;
+        return true;
+    }
+#endif
+    return false;
+}
+
+bool app_sleep_get_camera(camera_settings_t *settings)
+{
+#ifdef CONFIG_DEEP_SLEEP
+    if (s_resumed && s_cache.camera_valid)
+    {
+        *settings = s_cache.camera;
+        return true;
+    }
+#endif
+    return false;
+}
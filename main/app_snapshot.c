@@ -0,0 +1,158 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "img_converters.h"
+#include "app_snapshot.h"
+#include "app_rate.h"
+
+static const char *TAG = "app_snapshot";
+
+#define SNAPSHOT_MAX_AGE_US     (CONFIG_CAPTURE_MAX_AGE_MS * 1000LL)
+#define SNAPSHOT_WAIT_MS        1000
+#define SNAPSHOT_TAG_LEN        24
+
+static SemaphoreHandle_t s_lock = NULL;
+static SemaphoreHandle_t s_updated = NULL;   // given after every refresh from the stream
+static uint8_t *s_buf = NULL;
+static size_t s_size = 0;
+static size_t s_len = 0;
+static int64_t s_time = 0;
+static uint32_t s_seq = 0;
+static uint32_t s_boot_id = 0;               // keeps tags from an earlier boot from matching
+
+static bool snapshot_fresh()
+{
+    return s_len > 0 && esp_timer_get_time() - s_time < SNAPSHOT_MAX_AGE_US;
+}
+
+static bool snapshot_store(const uint8_t *jpg, size_t len, int64_t time)
+{
+    if (len > s_size)
+    {
+        uint8_t *buf = heap_caps_realloc(s_buf, len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!buf)
+        {
+            ESP_LOGW(TAG, "No memory for a %u byte snapshot", len);
+            return false;
+        }
+        s_buf = buf;
+        s_size = len;
+    }
+    memcpy(s_buf, jpg, len);
+    s_len = len;
+    s_time = time;
+    s_seq++;
+    return true;
+}
+
+void app_snapshot_update(const frame_desc_t *frame)
+{
+    if (frame->err != ESP_OK || xSemaphoreTake(s_lock, 0) != pdTRUE)
+    {
+        return;
+    }
+    bool stored = !snapshot_fresh() && snapshot_store(frame->jpg_buf, frame->jpg_buf_len, frame->fr_capture);
+    xSemaphoreGive(s_lock);
+    if (stored)
+    {
+        xSemaphoreGive(s_updated);
+    }
+}
+
+static esp_err_t snapshot_capture()
+{
+    camera_fb_t *fb = NULL;
+    esp_err_t err = app_pipeline_capture_still(&fb);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    int64_t time = esp_timer_get_time();
+    if (fb->format == PIXFORMAT_JPEG)
+    {
+        err = snapshot_store(fb->buf, fb->len, time) ? ESP_OK : ESP_ERR_NO_MEM;
+    }
+    else
+    {
+        uint8_t *jpg = NULL;
+        size_t len = 0;
+        if (fmt2jpg(fb->buf, fb->len, fb->width, fb->height, fb->format, app_rate_overlay_quality(), &jpg, &len))
+        {
+            err = snapshot_store(jpg, len, time) ? ESP_OK : ESP_ERR_NO_MEM;
+            free(jpg);
+        }
+        else
+        {
+            err = ESP_FAIL;
+        }
+    }
+    esp_camera_fb_return(fb);
+    return err;
+}
+
+esp_err_t app_snapshot_get(snapshot_write_cb write, void *arg)
+{
+    char tag[SNAPSHOT_TAG_LEN];
+    esp_err_t err = ESP_OK;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (!snapshot_fresh())
+    {
+        err = snapshot_capture();
+        if (err == ESP_ERR_INVALID_STATE)
+        {
+            // streaming, the hub stores the next frame it hands out
+            xSemaphoreTake(s_updated, 0);
+            xSemaphoreGive(s_lock);
+            xSemaphoreTake(s_updated, SNAPSHOT_WAIT_MS / portTICK_PERIOD_MS);
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            err = s_len > 0 ? ESP_OK : ESP_ERR_TIMEOUT;
+        }
+    }
+    if (err == ESP_OK)
+    {
+        snprintf(tag, sizeof(tag), "\"%08x-%u\"", s_boot_id, s_seq);
+        err = write(arg, s_buf, s_len, tag);
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t app_snapshot_init()
+{
+    s_lock = xSemaphoreCreateMutex();
+    s_updated = xSemaphoreCreateBinary();
+    if (!s_lock || !s_updated)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    s_boot_id = esp_random();
+    return ESP_OK;
+}
@@ -0,0 +1,294 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "cJSON.h"
+#include "sdkconfig.h"
+#include "app_soak.h"
+#include "app_event.h"
+#include "app_stream.h"
+#include "app_tasks.h"
+
+static const char *TAG = "app_soak";
+
+/* Samples in a row below the limit before the test fails, a busy scene can slow a few frames */
+#define SOAK_FAIL_SAMPLES   3
+
+/* Shows the built-in viewer in the logs and on /status, no socket gets a number this high */
+#define SOAK_SINK_FD        9999
+
+typedef enum {
+    SOAK_HEAP_INTERNAL,
+    SOAK_HEAP_DMA,
+    SOAK_HEAP_SPIRAM,
+    SOAK_HEAP_MAX,
+} soak_heap_t;
+
+static const struct {
+    const char *name;
+    uint32_t caps;
+} s_heaps[SOAK_HEAP_MAX] = {
+    [SOAK_HEAP_INTERNAL] = { "internal", MALLOC_CAP_INTERNAL },
+    [SOAK_HEAP_DMA]      = { "dma",      MALLOC_CAP_DMA },
+    [SOAK_HEAP_SPIRAM]   = { "spiram",   MALLOC_CAP_SPIRAM },
+};
+
+typedef struct {
+    int64_t time;
+    float fps;
+    uint32_t free[SOAK_HEAP_MAX];
+    uint32_t largest[SOAK_HEAP_MAX];
+} soak_sample_t;
+
+static SemaphoreHandle_t s_lock = NULL;
+static soak_sample_t s_samples[CONFIG_SOAK_WINDOW];
+static int s_count = 0;             /* samples taken */
+static soak_sample_t s_baseline;
+static bool s_has_baseline = false;
+static int s_below = 0;             /* samples in a row below the limit */
+static char s_failure[96] = "";     /* why the test failed, empty while it passes */
+
+static volatile uint32_t s_frames = 0;
+static volatile bool s_sink_open = false;
+
+static esp_err_t soak_sink_send(void *arg, frame_desc_t *frame)
+{
+    s_frames++;
+    return ESP_OK;
+}
+
+static void soak_sink_close(void *arg)
+{
+    s_sink_open = false;
+}
+
+static const stream_sink_t s_sink = {
+    .name = "soak",
+    .send = soak_sink_send,
+    .close = soak_sink_close,
+    .arg = NULL,
+};
+
+static const soak_sample_t *soak_sample(int age)
+{
+    return &s_samples[(s_count - 1 - age) % CONFIG_SOAK_WINDOW];
+}
+
+static float soak_value(const soak_sample_t *sample, soak_heap_t heap, bool largest)
+{
+    return largest ? sample->largest[heap] : sample->free[heap];
+}
+
+/* Least squares slope of a heap value over the samples in the window, bytes per hour */
+static float soak_trend(soak_heap_t heap, bool largest)
+{
+    int n = s_count < CONFIG_SOAK_WINDOW ? s_count : CONFIG_SOAK_WINDOW;
+    float mean_h = 0, mean_v = 0, cov = 0, var = 0;
+
+    if (n < 2)
+    {
+        return 0;
+    }
+    int64_t t0 = soak_sample(n - 1)->time;
+    for (int i = 0; i < n; i++)
+    {
+        mean_h += (soak_sample(i)->time - t0) / 3.6e9f;
+        mean_v += soak_value(soak_sample(i), heap, largest);
+    }
+    mean_h /= n;
+    mean_v /= n;
+    for (int i = 0; i < n; i++)
+    {
+        float dh = (soak_sample(i)->time - t0) / 3.6e9f - mean_h;
+        cov += dh * (soak_value(soak_sample(i), heap, largest) - mean_v);
+        var += dh * dh;
+    }
+    return var > 0 ? cov / var : 0;
+}
+
+static void soak_check(const soak_sample_t *sample)
+{
+    const float keep = (100 - CONFIG_SOAK_MAX_LOSS_PCT) / 100.0f;
+    char reason[sizeof(s_failure)] = "";
+
+    for (int i = 0; i < SOAK_HEAP_MAX && !reason[0]; i++)
+    {
+        if (sample->largest[i] < s_baseline.largest[i] * keep)
+        {
+            snprintf(reason, sizeof(reason), "largest %s block %u bytes, %u at baseline",
+                    s_heaps[i].name, sample->largest[i], s_baseline.largest[i]);
+        }
+    }
+    if (!reason[0] && sample->fps < s_baseline.fps * keep)
+    {
+        snprintf(reason, sizeof(reason), "%.1f fps, %.1f at baseline", sample->fps, s_baseline.fps);
+    }
+    if (!reason[0])
+    {
+        s_below = 0;
+        return;
+    }
+    // the first failure is kept, the run goes on for the trends
+    if (++s_below >= SOAK_FAIL_SAMPLES && !s_failure[0])
+    {
+        strlcpy(s_failure, reason, sizeof(s_failure));
+        ESP_LOGE(TAG, "Soak test failed: %s", s_failure);
+    }
+}
+
+static void soak_take_sample(soak_sample_t *sample)
+{
+    for (int i = 0; i < SOAK_HEAP_MAX; i++)
+    {
+        sample->free[i] = heap_caps_get_free_size(s_heaps[i].caps);
+        sample->largest[i] = heap_caps_get_largest_free_block(s_heaps[i].caps);
+    }
+}
+
+static void soak_task(void *arg)
+{
+    const int64_t period = CONFIG_SOAK_SAMPLE_S * 1000000LL;
+    int64_t start = esp_timer_get_time();
+    int64_t last = start;
+    uint32_t last_frames = 0;
+    soak_sample_t sample;
+
+    app_event_post(APP_EVENT_WAKEUP);
+    while (true)
+    {
+        if (!s_sink_open)
+        {
+            // refused until the wakeup went through, and after app_stream_stop
+            s_sink_open = true;
+            if (app_stream_add_sink(&s_sink, SOAK_SINK_FD) != ESP_OK)
+            {
+                s_sink_open = false;
+            }
+        }
+        vTaskDelay(1000 / portTICK_PERIOD_MS);
+
+        int64_t now = esp_timer_get_time();
+        if (now - last < period)
+        {
+            continue;
+        }
+        uint32_t frames = s_frames;
+        sample.time = now;
+        sample.fps = (frames - last_frames) * 1e6f / (now - last);
+        soak_take_sample(&sample);
+        last = now;
+        last_frames = frames;
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_samples[s_count % CONFIG_SOAK_WINDOW] = sample;
+        s_count++;
+        if (s_has_baseline)
+        {
+            soak_check(&sample);
+        }
+        else if (now - start >= CONFIG_SOAK_WARMUP_S * 1000000LL)
+        {
+            // pools and caches are filled by now, later losses are fragmentation or leaks
+            s_baseline = sample;
+            s_has_baseline = true;
+        }
+        ESP_LOGI(TAG, "%u s: %.1f fps, largest block internal %u (%+.0f/h) dma %u (%+.0f/h) spiram %u (%+.0f/h)%s",
+                (uint32_t)((now - start) / 1000000), sample.fps,
+                sample.largest[SOAK_HEAP_INTERNAL], soak_trend(SOAK_HEAP_INTERNAL, true),
+                sample.largest[SOAK_HEAP_DMA], soak_trend(SOAK_HEAP_DMA, true),
+                sample.largest[SOAK_HEAP_SPIRAM], soak_trend(SOAK_HEAP_SPIRAM, true),
+                s_failure[0] ? ", FAILED" : "");
+        xSemaphoreGive(s_lock);
+    }
+}
+
+esp_err_t app_soak_init()
+{
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    return app_task_create(APP_TASK_SOAK, &soak_task, NULL, NULL);
+}
+
+char *app_soak_to_json()
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON *heaps = cJSON_CreateArray();
+    char *json = NULL;
+
+    if (!root || !heaps)
+    {
+        cJSON_Delete(heaps);
+        goto out;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    cJSON_AddStringToObject(root, "result", s_failure[0] ? "fail" : s_has_baseline ? "pass" : "warmup");
+    if (s_failure[0])
+    {
+        cJSON_AddStringToObject(root, "reason", s_failure);
+    }
+    cJSON_AddNumberToObject(root, "samples", s_count);
+    cJSON_AddNumberToObject(root, "sample_s", CONFIG_SOAK_SAMPLE_S);
+    cJSON_AddItemToObject(root, "heaps", heaps);
+    if (s_count > 0)
+    {
+        const soak_sample_t *last = soak_sample(0);
+        cJSON_AddNumberToObject(root, "fps", last->fps);
+        if (s_has_baseline)
+        {
+            cJSON_AddNumberToObject(root, "baseline_fps", s_baseline.fps);
+        }
+        for (int i = 0; i < SOAK_HEAP_MAX; i++)
+        {
+            cJSON *heap = cJSON_CreateObject();
+            if (!heap)
+            {
+                break;
+            }
+            cJSON_AddStringToObject(heap, "heap", s_heaps[i].name);
+            cJSON_AddNumberToObject(heap, "free", last->free[i]);
+            cJSON_AddNumberToObject(heap, "largest", last->largest[i]);
+            cJSON_AddNumberToObject(heap, "min_free", heap_caps_get_minimum_free_size(s_heaps[i].caps));
+            if (s_has_baseline)
+            {
+                cJSON_AddNumberToObject(heap, "baseline_free", s_baseline.free[i]);
+                cJSON_AddNumberToObject(heap, "baseline_largest", s_baseline.largest[i]);
+            }
+            cJSON_AddNumberToObject(heap, "free_per_hour", soak_trend(i, false));
+            cJSON_AddNumberToObject(heap, "largest_per_hour", soak_trend(i, true));
+            cJSON_AddItemToArray(heaps, heap);
+        }
+    }
+    xSemaphoreGive(s_lock);
+    json = cJSON_PrintUnformatted(root);
+
+out:
+    cJSON_Delete(root);
+    return json;
+}
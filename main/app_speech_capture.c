@@ -0,0 +1,219 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/ringbuf.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "cJSON.h"
+#include "app_speech_capture.h"
+#include "app_speech_srcif.h"
+
+static const char *TAG = "app_speech_capture";
+
+/* Half a second of audio, the HTTP client has to keep up */
+#define CAPTURE_BUF_LEN     (16 * 1024)
+
+static RingbufHandle_t s_capture = NULL;
+static volatile bool s_capturing = false;
+static uint32_t s_dropped = 0;
+
+void app_speech_capture_feed(const int16_t *samples, size_t count)
+{
+    if (!s_capturing)
+    {
+        return;
+    }
+    if (xRingbufferSend(s_capture, samples, count * sizeof(int16_t), 0) != pdTRUE)
+    {
+        s_dropped += count * sizeof(int16_t);
+    }
+}
+
+esp_err_t app_speech_capture_start()
+{
+    size_t len;
+    void *data;
+
+    if (s_capturing)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // created once and kept, the model task may still be sending when a capture stops
+    if (!s_capture)
+    {
+        s_capture = xRingbufferCreate(CAPTURE_BUF_LEN, RINGBUF_TYPE_BYTEBUF);
+        if (!s_capture)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    // audio left over from the previous capture
+    while ((data = xRingbufferReceive(s_capture, &len, 0)))
+    {
+        vRingbufferReturnItem(s_capture, data);
+    }
+    s_dropped = 0;
+    s_capturing = true;
+    ESP_LOGI(TAG, "Capture started");
+    return ESP_OK;
+}
+
+size_t app_speech_capture_read(void *buf, size_t len, TickType_t timeout)
+{
+    size_t got = 0;
+
+    void *data = xRingbufferReceiveUpTo(s_capture, &got, timeout, len);
+    if (!data)
+    {
+        return 0;
+    }
+    memcpy(buf, data, got);
+    vRingbufferReturnItem(s_capture, data);
+    return got;
+}
+
+void app_speech_capture_stop()
+{
+    s_capturing = false;
+    ESP_LOGI(TAG, "Capture stopped, %u bytes dropped", s_dropped);
+}
+
+uint32_t app_speech_capture_dropped()
+{
+    return s_dropped;
+}
+
+static int replay_read_chunk(speech_replay_read_cb read, void *arg, uint8_t *buf, size_t len)
+{
+    size_t got = 0;
+
+    while (got < len)
+    {
+        int ret = read(arg, buf + got, len - got);
+        if (ret < 0)
+        {
+            return ret;
+        }
+        if (ret == 0)
+        {
+            break;
+        }
+        got += ret;
+    }
+    return got;
+}
+
+esp_err_t app_speech_replay(speech_replay_read_cb read, void *arg, speech_replay_t *result)
+{
+    int det_mode;
+    const esp_sr_iface_t *model = app_speech_get_model(&det_mode);
+
+    memset(result, 0, sizeof(*result));
+    // separate from the instance listening for the wake word
+    model_iface_data_t *data = model->create(det_mode == 90 ? DET_MODE_90 : DET_MODE_95);
+    if (!data)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    result->chunk_samples = model->get_samp_chunksize(data);
+    size_t len = result->chunk_samples * sizeof(int16_t);
+    int16_t *chunk = heap_caps_malloc(len, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!chunk)
+    {
+        model->destroy(data);
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = ESP_OK;
+    while (true)
+    {
+        int got = replay_read_chunk(read, arg, (uint8_t *)chunk, len);
+        if (got < 0)
+        {
+            err = ESP_FAIL;
+            break;
+        }
+        if (got < len)
+        {
+            break;
+        }
+
+        int64_t start = esp_timer_get_time();
+        int r = model->detect(data, chunk);
+        result->detect_us += esp_timer_get_time() - start;
+        result->chunks++;
+        if (r)
+        {
+            if (result->detection_count < SPEECH_REPLAY_MAX_DETECTIONS)
+            {
+                speech_detection_t *d = &result->detections[result->detection_count];
+                d->word = r;
+                d->at_ms = result->chunks * result->chunk_samples / 16;
+            }
+            result->detection_count++;
+        }
+    }
+
+    free(chunk);
+    model->destroy(data);
+    return err;
+}
+
+char *app_speech_replay_to_json(const speech_replay_t *result)
+{
+    speech_stats_t stats;
+    app_speech_get_stats(&stats);
+
+    cJSON *root = cJSON_CreateObject();
+    if (!root)
+    {
+        return NULL;
+    }
+    uint32_t audio_ms = result->chunks * result->chunk_samples / 16;
+    cJSON_AddStringToObject(root, "model", stats.model);
+    cJSON_AddNumberToObject(root, "det_mode", stats.det_mode);
+    cJSON_AddNumberToObject(root, "chunks", result->chunks);
+    cJSON_AddNumberToObject(root, "chunk_samples", result->chunk_samples);
+    cJSON_AddNumberToObject(root, "audio_ms", audio_ms);
+    cJSON_AddNumberToObject(root, "detect_ms", result->detect_us / 1000);
+    cJSON_AddNumberToObject(root, "chunks_per_s",
+            result->detect_us ? (double)result->chunks * 1000000 / result->detect_us : 0);
+    // above 1 the model keeps up with live audio
+    cJSON_AddNumberToObject(root, "realtime_factor",
+            result->detect_us ? (double)audio_ms * 1000 / result->detect_us : 0);
+    cJSON_AddNumberToObject(root, "detection_count", result->detection_count);
+    cJSON *detections = cJSON_CreateArray();
+    cJSON_AddItemToObject(root, "detections", detections);
+    for (int i = 0; i < result->detection_count && i < SPEECH_REPLAY_MAX_DETECTIONS; i++)
+    {
+        cJSON *d = cJSON_CreateObject();
+        cJSON_AddNumberToObject(d, "word", result->detections[i].word);
+        cJSON_AddNumberToObject(d, "at_ms", result->detections[i].at_ms);
+        cJSON_AddItemToArray(detections, d);
+    }
+
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return json;
+}
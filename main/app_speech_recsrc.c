@@ -5,6 +5,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/event_groups.h"
 #include "esp_system.h"
 #include "esp_spi_flash.h"
 #include "xtensa/core-macros.h"
@@ -14,6 +15,17 @@
 #include "esp_log.h"
 #include "esp_spiffs.h"
 #include "app_main.h"
+#include "app_power.h"
+#include "esp_timer.h"
+#include "app_tracer.h"
+#include "app_mem.h"
+
+#define I2S_DMA_BUF_COUNT   3
+#define I2S_DMA_BUF_LEN     300     /* frames */
+// the DMA buffers hold this much audio, a later read has lost some
+#define I2S_DMA_US          (I2S_DMA_BUF_COUNT * I2S_DMA_BUF_LEN * 1000 / 16)
+
+static uint32_t s_i2s_overruns;
 
 static void i2s_init(void)
 {
@@ -23,8 +35,8 @@ static void i2s_init(void)
         .channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT,   //must be the same as DSP configuration
         .bits_per_sample = 32,                          //must be the same as DSP configuration
         .communication_format = I2S_COMM_FORMAT_I2S,
-        .dma_buf_count = 3,
-        .dma_buf_len = 300,
+        .dma_buf_count = I2S_DMA_BUF_COUNT,
+        .dma_buf_len = I2S_DMA_BUF_LEN,
         .intr_alloc_flags = ESP_INTR_FLAG_LEVEL2,
     };
     i2s_pin_config_t pin_config = {
@@ -38,34 +50,80 @@ static void i2s_init(void)
     i2s_zero_dma_buffer(1);
 }
 
+/*
+ * Mixes the two 32 bit slots of each I2S frame down to one 16 bit sample,
+ * (left + right) >> 13. Unrolled by four so the loads of the next frames
+ * overlap the adds and shifts of the current ones.
+ */
+static void downmix(const int32_t *in, int16_t *out, int frames)
+{
+    int n = frames & ~3;
+
+    for (int x = 0; x < n; x += 4) {
+        int32_t a = in[0] + in[1];
+        int32_t b = in[2] + in[3];
+        int32_t c = in[4] + in[5];
+        int32_t d = in[6] + in[7];
+        out[0] = a >> 13;
+        out[1] = b >> 13;
+        out[2] = c >> 13;
+        out[3] = d >> 13;
+        in += 8;
+        out += 4;
+    }
+    for (int x = n; x < frames; x++) {
+        *out++ = (in[0] + in[1]) >> 13;
+        in += 2;
+    }
+}
+
 void recsrcTask(void *arg)
 {
+    app_power_acquire(POWER_LOCK_AUDIO);
     i2s_init();
 
     src_cfg_t *cfg=(src_cfg_t*)arg;
-    size_t samp_len = cfg->item_size*2*sizeof(int)/sizeof(int16_t);
+    int frames = cfg->item_size / sizeof(int16_t);
+    size_t samp_len = frames * 2 * sizeof(int32_t);
 
-    int *samp=malloc(samp_len);
+    // DMA data is read into samp and mixed down straight into the ring
+    int32_t *samp = app_mem_alloc(APP_MEM_AUDIO_DMA, samp_len);
+    assert(samp);
 
     size_t read_len = 0;
+    int64_t last_read = esp_timer_get_time();
 
     while(1) {
-        if (g_state != WAIT_FOR_WAKEUP)
-        {
-            vTaskDelay(1000 / portTICK_PERIOD_MS);
-            continue;
+        if (!(app_state_wait(STATE_LISTEN_BIT, 0) & STATE_LISTEN_BIT)) {
+            // the clock stops while nobody listens, stale DMA audio is dropped on resume
+            i2s_stop(1);
+            app_power_release(POWER_LOCK_AUDIO);
+            app_state_wait(STATE_LISTEN_BIT, portMAX_DELAY);
+            app_power_acquire(POWER_LOCK_AUDIO);
+            i2s_zero_dma_buffer(1);
+            i2s_start(1);
+            last_read = esp_timer_get_time();
         }
 
+        // keep reading while the ring is full, or the DMA buffers overflow
         i2s_read(1, samp, samp_len, &read_len, portMAX_DELAY);
-        for (int x=0; x<cfg->item_size/4; x++) {
-            int s1 = ((samp[x * 4] + samp[x * 4 + 1]) >> 13) & 0x0000FFFF;
-            int s2 = ((samp[x * 4 + 2] + samp[x * 4 + 3]) << 3) & 0xFFFF0000;
-            samp[x] = s1 | s2;
+        int64_t now = esp_timer_get_time();
+        if (now - last_read > I2S_DMA_US)
+            s_i2s_overruns++;
+        last_read = now;
+        TRACE_BEGIN(TRACE_REC, read_len);
+        int16_t *chunk = app_speech_ring_write_begin(cfg->ring);
+        if (chunk) {
+            downmix(samp, chunk, read_len / (2 * sizeof(int32_t)));
+            app_speech_ring_write_end(cfg->ring);
         }
-
-        xQueueSend(*cfg->queue, samp, portMAX_DELAY);
+        TRACE_END(TRACE_REC, chunk != NULL);
     }
 
     vTaskDelete(NULL);
 }
 
+uint32_t app_speech_i2s_overruns()
+{
+    return s_i2s_overruns;
+}
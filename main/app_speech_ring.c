@@ -0,0 +1,130 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "app_speech_ring.h"
+#include "app_mem.h"
+
+static const char *TAG = "app_speech_ring";
+
+esp_err_t app_speech_ring_init(speech_ring_t *ring, size_t chunk, size_t chunks)
+{
+    size_t len = chunk * chunks * sizeof(int16_t);
+
+    // PSRAM when internal RAM is short
+    ring->buf = (int16_t *)app_mem_alloc(APP_MEM_AUDIO_RING, len);
+    ring->stamps = (uint32_t *)app_mem_alloc(APP_MEM_AUDIO_RING, chunks * sizeof(uint32_t));
+    if (!ring->buf || !ring->stamps)
+    {
+        ESP_LOGE(TAG, "No memory for %u bytes of audio", len);
+        app_mem_free(APP_MEM_AUDIO_RING, ring->buf, len);
+        app_mem_free(APP_MEM_AUDIO_RING, ring->stamps, chunks * sizeof(uint32_t));
+        return ESP_ERR_NO_MEM;
+    }
+    memset(ring->stamps, 0, chunks * sizeof(uint32_t));
+    ring->size = chunk * chunks;
+    ring->chunk = chunk;
+    ring->chunks = chunks;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->overruns = 0;
+    ring->high_water = 0;
+    ring->reader = NULL;
+    return ESP_OK;
+}
+
+/*
+ * The counters wrap at twice the slots, so a full ring and an empty one
+ * differ and a slot is always the counter modulo the slots.
+ */
+static inline uint32_t speech_ring_advance(const speech_ring_t *ring, uint32_t count)
+{
+    return count + 1 < 2 * ring->chunks ? count + 1 : 0;
+}
+
+int16_t *app_speech_ring_write_begin(speech_ring_t *ring)
+{
+    if (app_speech_ring_used(ring) == ring->chunks)
+    {
+        ring->overruns++;
+        return NULL;
+    }
+    return ring->buf + ring->head % ring->chunks * ring->chunk;
+}
+
+void app_speech_ring_write_end(speech_ring_t *ring)
+{
+    ring->stamps[ring->head % ring->chunks] = (uint32_t)esp_timer_get_time();
+
+    // the samples must be visible to the other core before the new head
+    __sync_synchronize();
+    ring->head = speech_ring_advance(ring, ring->head);
+
+    uint32_t used = app_speech_ring_used(ring);
+    if (used > ring->high_water)
+    {
+        ring->high_water = used;
+    }
+
+    TaskHandle_t reader = ring->reader;
+    if (reader)
+    {
+        xTaskNotifyGive(reader);
+    }
+}
+
+const int16_t *app_speech_ring_read_begin(speech_ring_t *ring, TickType_t timeout)
+{
+    ring->reader = xTaskGetCurrentTaskHandle();
+    while (ring->head == ring->tail)
+    {
+        if (!ulTaskNotifyTake(pdTRUE, timeout))
+        {
+            return NULL;
+        }
+    }
+    __sync_synchronize();
+    return ring->buf + ring->tail % ring->chunks * ring->chunk;
+}
+
+void app_speech_ring_read_end(speech_ring_t *ring)
+{
+    // the slot is only handed out again once the reader is done with it
+    __sync_synchronize();
+    ring->tail = speech_ring_advance(ring, ring->tail);
+}
+
+uint32_t app_speech_ring_read_stamp(const speech_ring_t *ring)
+{
+    return ring->stamps[ring->tail % ring->chunks];
+}
+
+uint32_t app_speech_ring_used(const speech_ring_t *ring)
+{
+    uint32_t head = ring->head;
+    uint32_t tail = ring->tail;
+
+    return head >= tail ? head - tail : head + 2 * ring->chunks - tail;
+}
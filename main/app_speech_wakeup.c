@@ -15,46 +15,224 @@
 #include "esp_sr_iface.h"
 #include "esp_sr_models.h"
 #include "app_main.h"
+#include "app_pipeline.h"
+#include "app_stream.h"
+#include "app_metrics.h"
+#include "esp_timer.h"
 
-#define SR_MODEL esp_sr_wakenet3_quantized
+#include "app_config.h"
+#include "app_speech_capture.h"
+#include "app_tasks.h"
+#include "app_tracer.h"
+
+#ifdef CONFIG_APP_SPEECH
+typedef struct {
+    const char *name;
+    const esp_sr_iface_t *iface;
+} speech_model_t;
+
+// models linked into the image, lightest first, app_config picks the first by default
+static const speech_model_t s_models[] = {
+    { "wakenet3_quantized", &esp_sr_wakenet3_quantized },
+};
 
 static src_cfg_t srcif;
-static const esp_sr_iface_t *model = &SR_MODEL;
+static const esp_sr_iface_t *model;
 static model_iface_data_t *model_data;
+static const char *s_model_name;
+static int s_det_mode;
+static uint32_t s_chunk_us;
+static uint32_t s_detect_us;     // mean detect time << 4
+
+static speech_ring_t sndRing;
+static uint32_t s_chunks_detected;
+static uint32_t s_chunks_silent;
+static uint32_t s_chunks_late;
+
+#ifdef CONFIG_SPEECH_CONTINUOUS
+// audio waiting beyond this is dropped unheard rather than acted on late
+#define SPEECH_MAX_BACKLOG_MS   300
+#endif
+
+#ifdef CONFIG_SPEECH_VAD
+// mean magnitude below which a chunk is never taken for voice
+#define VAD_MIN_LEVEL   48
+
+static int32_t s_vad_floor = VAD_MIN_LEVEL << 4;   // noise level, mean magnitude << 4
+static int s_vad_hangover;                          // chunks in the hangover window
+static int s_vad_hold;                              // chunks still detected after the last voiced one
+
+/*
+ * Cheap energy and zero crossing check ahead of the model. A chunk is voiced
+ * when it is well above the tracked noise floor, or a little above it while
+ * crossing zero often, as fricatives do. Inference keeps running for the
+ * hangover window after the last voiced chunk so no part of a word is lost.
+ */
+static bool vad_should_detect(const int16_t *buf, int n)
+{
+    int32_t level = 0;
+    int crossings = 0;
+    int16_t prev = buf[0];
+
+    for (int i = 0; i < n; i++) {
+        level += abs(buf[i]);
+        crossings += (buf[i] ^ prev) < 0;
+        prev = buf[i];
+    }
+    level /= n;
+
+    int32_t floor = s_vad_floor >> 4;
+    bool voiced = level > VAD_MIN_LEVEL
+                  && (level > floor * 3 || (level > floor * 3 / 2 && crossings > n / 4));
 
-QueueHandle_t sndQueue;
+    // the floor follows silence quickly and loud chunks slowly, so steady noise is learnt
+    s_vad_floor += voiced ? (level - floor) >> 4 : level - floor;
+    if (s_vad_floor < VAD_MIN_LEVEL << 4)
+        s_vad_floor = VAD_MIN_LEVEL << 4;
+
+    if (voiced)
+        s_vad_hold = s_vad_hangover;
+    else if (s_vad_hold > 0)
+        s_vad_hold--;
+    else {
+        s_chunks_silent++;
+        return false;
+    }
+    return true;
+}
+#endif
 
 static void event_wakeup_detected(int r)
 {
-    assert(g_state == WAIT_FOR_WAKEUP);
     printf("%s DETECTED.\n", model->get_word_name(model_data, r));
-    g_state = WAIT_FOR_CONNECT;
+    app_event_post(APP_EVENT_WAKEUP);
 }
 
-void nnTask(void *arg)
+#ifdef CONFIG_SPEECH_CONTINUOUS
+// words heard while streaming, mapped to the same events as the button
+static void event_command_detected(int r)
 {
-    int audio_chunksize = model->get_samp_chunksize(model_data);
-    int16_t *buffer=malloc(audio_chunksize*sizeof(int16_t));
-    assert(buffer);
+    printf("%s DETECTED while streaming.\n", model->get_word_name(model_data, r));
+    if (r == CONFIG_SPEECH_WORD_ENROLL) {
+        app_event_post(APP_EVENT_ENROLL);
+    } else if (r == CONFIG_SPEECH_WORD_DELETE) {
+        app_event_post(APP_EVENT_DELETE);
+    } else if (r == CONFIG_SPEECH_WORD_STOP) {
+        app_stream_stop();
+    }
+}
+#endif
 
+void nnTask(void *arg)
+{
     while(1) {
-        xQueueReceive(sndQueue, buffer, portMAX_DELAY);
+        // the model reads the chunk where the recorder put it
+        int16_t *buffer = (int16_t *)app_speech_ring_read_begin(&sndRing, portMAX_DELAY);
+        if (!buffer) {
+            continue;
+        }
+        TRACE_COUNTER(TRACE_AUDIO_QUEUE, app_speech_ring_used(&sndRing));
+#ifdef CONFIG_SPEECH_CAPTURE
+        app_speech_capture_feed(buffer, sndRing.chunk);
+#endif
 
-        int r=model->detect(model_data, buffer);
+#ifdef CONFIG_SPEECH_CONTINUOUS
+        // behind the live audio while the stream keeps the core busy, catch up first
+        if (app_speech_ring_used(&sndRing) * sndRing.chunk > SPEECH_MAX_BACKLOG_MS * 16) {
+            s_chunks_late++;
+            app_speech_ring_read_end(&sndRing);
+            continue;
+        }
+#endif
+
+        // audio left over from before a wakeup is dropped
+        int r = 0;
+        if ((app_state_wait(STATE_LISTEN_BIT, 0) & STATE_LISTEN_BIT)
+#ifdef CONFIG_SPEECH_VAD
+            && vad_should_detect(buffer, sndRing.chunk)
+#endif
+           ) {
+            int64_t start = esp_timer_get_time();
+            TRACE_BEGIN(TRACE_NN, 0);
+            r = model->detect(model_data, buffer);
+            TRACE_END(TRACE_NN, r);
+            int64_t detect_us = esp_timer_get_time() - start;
+            app_metrics_observe(METRIC_SPEECH_DETECT, detect_us);
+            s_detect_us += detect_us - (s_detect_us >> 4);
+            s_chunks_detected++;
+        }
+        // from the end of the chunk that completed the word until it was recognized
+        uint32_t stamp = app_speech_ring_read_stamp(&sndRing);
+        app_speech_ring_read_end(&sndRing);
+        if (r)
+            app_metrics_observe(METRIC_WAKE_LATENCY, (uint32_t)esp_timer_get_time() - stamp);
         if (r) 
         {
+#ifdef CONFIG_SPEECH_CONTINUOUS
+            if (app_event_state() != WAIT_FOR_WAKEUP) {
+                event_command_detected(r);
+                continue;
+            }
+#endif
             event_wakeup_detected(r);
         }
     }
 
-    free(buffer);
     vTaskDelete(NULL);
 }
 
+void app_speech_get_stats(speech_stats_t *stats)
+{
+    stats->i2s_overruns = app_speech_i2s_overruns();
+    stats->ring_overruns = sndRing.overruns;
+    stats->ring_high_water = sndRing.high_water;
+    stats->ring_chunks = sndRing.size / sndRing.chunk;
+    stats->detected = s_chunks_detected;
+    stats->silent = s_chunks_silent;
+    stats->late = s_chunks_late;
+    stats->detect_us = s_detect_us >> 4;
+    stats->chunk_us = s_chunk_us;
+    stats->model = s_model_name;
+    stats->det_mode = s_det_mode;
+}
+
+const char *app_speech_model_name(int i)
+{
+    if (i < 0 || i >= sizeof(s_models) / sizeof(s_models[0]))
+        return NULL;
+    return s_models[i].name;
+}
+
+const esp_sr_iface_t *app_speech_get_model(int *det_mode)
+{
+    *det_mode = s_det_mode;
+    return model;
+}
+
+bool app_speech_has_model(const char *name)
+{
+    for (int i = 0; app_speech_model_name(i); i++) {
+        if (!strcmp(s_models[i].name, name))
+            return true;
+    }
+    return false;
+}
+
 void app_speech_wakeup_init()
 {
-    //Initialize NN model
-    model_data=model->create(DET_MODE_95);
+    //Initialize NN model, as saved in NVS
+    speech_config_t config;
+    app_config_get_speech(&config);
+    model = s_models[0].iface;
+    s_model_name = s_models[0].name;
+    for (int i = 0; app_speech_model_name(i); i++) {
+        if (!strcmp(s_models[i].name, config.model)) {
+            model = s_models[i].iface;
+            s_model_name = s_models[i].name;
+        }
+    }
+    s_det_mode = config.det_mode;
+    model_data=model->create(s_det_mode == 90 ? DET_MODE_90 : DET_MODE_95);
 
     wake_word_info_t* word_list = malloc(sizeof(wake_word_info_t));
     esp_err_t ret = model->get_word_list(model_data, word_list);
@@ -63,13 +241,47 @@ void app_speech_wakeup_init()
     free(word_list);    
 
     int audio_chunksize=model->get_samp_chunksize(model_data);
+    s_chunk_us = audio_chunksize * 1000 / 16;
+    printf("WakeNet %s, mode %d, %d samples (%u ms) per chunk\n",
+           s_model_name, s_det_mode, audio_chunksize, s_chunk_us / 1000);
 
-    //Initialize sound source
-    sndQueue=xQueueCreate(2, (audio_chunksize*sizeof(int16_t)));
-    srcif.queue=&sndQueue;
+    //Initialize sound source, CONFIG_SPEECH_RING_MS of audio rounded up to whole chunks
+    int chunks = (CONFIG_SPEECH_RING_MS * 16 + audio_chunksize - 1) / audio_chunksize;
+    ESP_ERROR_CHECK(app_speech_ring_init(&sndRing, audio_chunksize, chunks < 2 ? 2 : chunks));
+    srcif.ring=&sndRing;
     srcif.item_size=audio_chunksize*sizeof(int16_t);
+#ifdef CONFIG_SPEECH_VAD
+    s_vad_hangover = (CONFIG_SPEECH_VAD_HANGOVER_MS * 16 + audio_chunksize - 1) / audio_chunksize;
+#endif
+
+    app_task_create(APP_TASK_SPEECH_REC, &recsrcTask, (void*)&srcif, NULL);
+
+    app_task_create(APP_TASK_SPEECH_NN, &nnTask, NULL, NULL);
+}
+#else
+// the wake word is left out of the pipeline profile, no model is linked in
+void app_speech_get_stats(speech_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
 
-    xTaskCreatePinnedToCore(&recsrcTask, "rec", 3*1024, (void*)&srcif, 5, NULL, 1);
+const char *app_speech_model_name(int i)
+{
+    return NULL;
+}
 
-    xTaskCreatePinnedToCore(&nnTask, "nn", 2*1024, NULL, 5, NULL, 1);
+const esp_sr_iface_t *app_speech_get_model(int *det_mode)
+{
+    *det_mode = 0;
+    return NULL;
+}
+
+bool app_speech_has_model(const char *name)
+{
+    return false;
+}
+
+void app_speech_wakeup_init()
+{
 }
+#endif
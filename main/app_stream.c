@@ -0,0 +1,626 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "cJSON.h"
+#include "app_stream.h"
+#include "app_main.h"
+#include "app_tasks.h"
+#include "app_rate.h"
+#include "app_shed.h"
+#include "app_metrics.h"
+#include "app_face_db.h"
+#include "app_snapshot.h"
+#include "app_tracer.h"
+#include "app_offload.h"
+#include "app_rtclog.h"
+
+static const char *TAG = "app_stream";
+
+#define PART_BOUNDARY "123456789000000000000987654321"
+static const char* _STREAM_RESPONSE = "HTTP/1.1 200 OK\r\n"
+                                      "Content-Type: multipart/x-mixed-replace;boundary=" PART_BOUNDARY "\r\n"
+                                      "Transfer-Encoding: identity\r\n"
+                                      "\r\n";
+static const char* _STREAM_BOUNDARY = "\r\n--" PART_BOUNDARY "\r\n";
+static const char* _STREAM_PART = "Content-Type: image/jpeg\r\nContent-Length: %u\r\n%s\r\n";
+
+#define STREAM_PART_LEN         512
+#define STREAM_SEND_TIMEOUT_S   5
+
+typedef struct {
+    int fd;
+    bool active;                    /* cleared when the session closes or a send fails */
+    bool session_open;              /* cleared by the server once it closed the socket */
+    QueueHandle_t queue;            /* latest frame for this viewer, older ones are dropped */
+    uint32_t dropped;
+    const stream_sink_t *sink;      /* NULL for MJPEG viewers on an HTTP socket */
+    bool crops;                     /* gets the faces of frames, not the frames */
+} stream_client_t;
+
+static httpd_handle_t s_server = NULL;
+static stream_client_t s_clients[STREAM_MAX_CLIENTS];
+static int s_client_count = 0;
+static int s_crop_count = 0;
+static uint32_t s_dropped = 0;
+static SemaphoreHandle_t s_client_lock = NULL;
+static portMUX_TYPE s_ref_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void stream_frame_ref(frame_desc_t *frame)
+{
+    portENTER_CRITICAL(&s_ref_mux);
+    frame->refs++;
+    portEXIT_CRITICAL(&s_ref_mux);
+}
+
+static void stream_frame_unref(frame_desc_t *frame)
+{
+    int refs;
+
+    portENTER_CRITICAL(&s_ref_mux);
+    refs = --frame->refs;
+    portEXIT_CRITICAL(&s_ref_mux);
+
+    if (refs == 0)
+    {
+        app_pipeline_return_frame(frame);
+    }
+}
+
+/*
+ * Writes all buffers with as few socket calls as lwIP allows, so the end of
+ * one buffer shares a TCP segment with the start of the next.
+ */
+static esp_err_t stream_sendv(stream_client_t *client, struct iovec *iov, int iovcnt)
+{
+    while (iovcnt > 0)
+    {
+        if (!client->active)
+        {
+            return ESP_FAIL;
+        }
+        int ret = writev(client->fd, iov, iovcnt);
+        if (ret < 0)
+        {
+            return ESP_FAIL;
+        }
+        while (iovcnt > 0 && ret >= iov->iov_len)
+        {
+            ret -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + ret;
+            iov->iov_len -= ret;
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t stream_send(stream_client_t *client, const char *buf, size_t len)
+{
+    struct iovec iov = { .iov_base = (void *)buf, .iov_len = len };
+
+    return stream_sendv(client, &iov, 1);
+}
+
+/* Lines every part of a frame starts with, to line parts up with each other and with the sensor */
+static size_t stream_frame_headers(const frame_desc_t *frame, char *buf, size_t len)
+{
+    struct timeval tv;
+
+    app_pipeline_frame_time(frame, &tv);
+    int n = snprintf(buf, len, "X-Timestamp: %ld.%06ld\r\nX-Seq: %u\r\n", (long)tv.tv_sec, (long)tv.tv_usec, frame->seq);
+    return n < len ? n : len - 1;
+}
+
+static esp_err_t stream_send_frame(stream_client_t *client, frame_desc_t *frame)
+{
+    char part_buf[STREAM_PART_LEN];
+    char face_buf[STREAM_PART_LEN - 64];
+
+    if (frame->err != ESP_OK)
+    {
+        return frame->err;
+    }
+    size_t n = stream_frame_headers(frame, face_buf, sizeof(face_buf));
+    app_pipeline_format_faces(frame, face_buf + n, sizeof(face_buf) - n);
+    size_t hlen = snprintf(part_buf, sizeof(part_buf), _STREAM_PART, frame->jpg_buf_len, face_buf);
+
+    // part header, JPEG and boundary go out in one write
+    struct iovec iov[3] = {
+        { .iov_base = part_buf, .iov_len = hlen < sizeof(part_buf) ? hlen : sizeof(part_buf) - 1 },
+        { .iov_base = frame->jpg_buf, .iov_len = frame->jpg_buf_len },
+        { .iov_base = (void *)_STREAM_BOUNDARY, .iov_len = strlen(_STREAM_BOUNDARY) },
+    };
+    return stream_sendv(client, iov, 3);
+}
+
+/* One part per face, the box locates it in the frame */
+static esp_err_t stream_send_crops(stream_client_t *client, frame_desc_t *frame)
+{
+    char part_buf[STREAM_PART_LEN];
+    char face_buf[STREAM_PART_LEN - 64];
+    size_t n = stream_frame_headers(frame, face_buf, sizeof(face_buf));
+
+    for (int i = 0; i < frame->crop_count; i++)
+    {
+        frame_jpg_t *jpg = &frame->face_crops[i];
+        if (jpg->len == 0)
+        {
+            continue;
+        }
+        box_t *box = &frame->face_boxes[i];
+        snprintf(face_buf + n, sizeof(face_buf) - n, "X-Frame-Size: %ux%u\r\nX-Face-Id: %d\r\nX-Face-Box: %d,%d,%d,%d\r\n",
+                frame->width, frame->height, frame->face_ids[i],
+                (int)box->box_p[0], (int)box->box_p[1], (int)box->box_p[2], (int)box->box_p[3]);
+        size_t hlen = snprintf(part_buf, sizeof(part_buf), _STREAM_PART, jpg->len, face_buf);
+
+        struct iovec iov[3] = {
+            { .iov_base = part_buf, .iov_len = hlen < sizeof(part_buf) ? hlen : sizeof(part_buf) - 1 },
+            { .iov_base = jpg->buf, .iov_len = jpg->len },
+            { .iov_base = (void *)_STREAM_BOUNDARY, .iov_len = strlen(_STREAM_BOUNDARY) },
+        };
+        esp_err_t res = stream_sendv(client, iov, 3);
+        if (res != ESP_OK)
+        {
+            return res;
+        }
+    }
+    return ESP_OK;
+}
+
+/*
+ * Frames are only encoded while someone watches them, faces are only cut out
+ * for crop viewers. Called with the client lock held.
+ */
+static void stream_update_outputs()
+{
+    int frame_viewers = s_client_count - s_crop_count;
+
+#ifdef CONFIG_HEADLESS
+    app_pipeline_set_video(frame_viewers > 0);
+#else
+    // without viewers the pipeline is stopped, the next viewer decides again
+    app_pipeline_set_video(frame_viewers > 0 || s_client_count == 0);
+#endif
+    app_pipeline_set_face_crops(s_crop_count > 0);
+}
+
+static void stream_client_task(void *arg)
+{
+    stream_client_t *client = (stream_client_t *)arg;
+    frame_desc_t *frame = NULL;
+
+    while (client->active)
+    {
+        if (xQueueReceive(client->queue, &frame, 1000 / portTICK_PERIOD_MS) != pdTRUE)
+        {
+            continue;
+        }
+
+        int64_t fr_send = esp_timer_get_time();
+        esp_err_t res;
+        TRACE_BEGIN(TRACE_SEND, client->fd);
+        if (client->sink)
+        {
+            res = client->sink->send(client->sink->arg, frame);
+        }
+        else
+        {
+            res = client->crops ? stream_send_crops(client, frame) : stream_send_frame(client, frame);
+        }
+        int64_t send_time = esp_timer_get_time() - fr_send;
+        TRACE_END(TRACE_SEND, client->fd);
+        ESP_LOGD(TAG, "Viewer %d: %uKB sent in %ums", client->fd,
+                (uint32_t)(frame->jpg_buf_len/1024), (uint32_t)(send_time/1000));
+        // crops are too small to tell anything about the link
+        if (res == ESP_OK && !client->crops)
+        {
+            app_metrics_observe(METRIC_SEND, send_time);
+            app_rate_update(frame, send_time);
+            app_shed_update_send(send_time);
+        }
+        stream_frame_unref(frame);
+        if (res != ESP_OK)
+        {
+            client->active = false;
+        }
+    }
+
+    xSemaphoreTake(s_client_lock, portMAX_DELAY);
+    while (xQueueReceive(client->queue, &frame, 0) == pdTRUE)
+    {
+        stream_frame_unref(frame);
+    }
+    ESP_LOGI(TAG, "Viewer %d left, %u frames dropped", client->fd, client->dropped);
+    if (client->sink)
+    {
+        client->sink->close(client->sink->arg);
+    }
+    else if (client->session_open)
+    {
+        httpd_sess_trigger_close(s_server, client->fd);
+    }
+    client->fd = -1;
+    client->sink = NULL;
+    bool last = --s_client_count == 0;
+    if (client->crops)
+    {
+        s_crop_count--;
+        client->crops = false;
+    }
+    stream_update_outputs();
+    xSemaphoreGive(s_client_lock);
+
+    // the hub may be waiting on the lock with a frame, stop without holding it
+    if (last)
+    {
+#ifndef CONFIG_HEADLESS
+        app_pipeline_stop();
+#endif
+        app_event_post(APP_EVENT_VIEWER_LAST);
+    }
+
+    app_task_exit(APP_TASK_VIEWER);
+}
+
+static void stream_hub_task(void *arg)
+{
+    frame_desc_t *frame = NULL;
+    frame_desc_t *stale = NULL;
+
+    while (true)
+    {
+        frame = app_pipeline_get_frame(100 / portTICK_PERIOD_MS);
+        if (!frame)
+        {
+            continue;
+        }
+        if (frame->drop != FRAME_DROP_NONE)
+        {
+            app_pipeline_return_frame(frame);
+            continue;
+        }
+        frame->fr_sent = esp_timer_get_time();
+        if (frame->err == ESP_OK)
+        {
+            app_shed_update(frame);
+#ifdef CONFIG_RTC_LOG
+            app_rtclog_frame(frame);
+#endif
+        }
+        if (!frame->video && frame->crop_count == 0)
+        {
+            // faces only, the hub is the last stage
+            app_pipeline_return_frame(frame);
+            continue;
+        }
+        if (frame->video && frame->err == ESP_OK)
+        {
+            app_pipeline_log_frame(frame);
+            app_snapshot_update(frame);
+        }
+
+        // the hub holds a reference until every viewer got the frame
+        frame->refs = 1;
+        xSemaphoreTake(s_client_lock, portMAX_DELAY);
+        for (int i = 0; i < STREAM_MAX_CLIENTS; i++)
+        {
+            stream_client_t *client = &s_clients[i];
+            if (client->fd < 0 || !client->active)
+            {
+                continue;
+            }
+            // crop viewers only get frames with faces, the others only encoded frames
+            if (client->crops ? frame->crop_count == 0 : !frame->video)
+            {
+                continue;
+            }
+            // a slow viewer only ever sees the newest frame
+            if (xQueueReceive(client->queue, &stale, 0) == pdTRUE)
+            {
+                client->dropped++;
+                s_dropped++;
+                stream_frame_unref(stale);
+            }
+            stream_frame_ref(frame);
+            if (xQueueSend(client->queue, &frame, 0) != pdTRUE)
+            {
+                client->dropped++;
+                s_dropped++;
+                stream_frame_unref(frame);
+            }
+        }
+        xSemaphoreGive(s_client_lock);
+        stream_frame_unref(frame);
+    }
+}
+
+static void stream_session_free(void *ctx)
+{
+    stream_client_t *client = (stream_client_t *)ctx;
+
+    // called by the server when the socket closes, the viewer task cleans up
+    client->session_open = false;
+    client->active = false;
+}
+
+/* Finds a free slot, called with the client lock held */
+static esp_err_t stream_claim(stream_client_t **client)
+{
+#ifdef CONFIG_HEADLESS
+    if (app_event_state() == WAIT_FOR_WAKEUP)
+#else
+    if (s_client_count == 0 && app_event_state() != WAIT_FOR_CONNECT)
+#endif
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++)
+    {
+        if (s_clients[i].fd < 0)
+        {
+            *client = &s_clients[i];
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+/* Counts a viewer whose task runs, called with the client lock held */
+static void stream_joined(stream_client_t *client)
+{
+    ESP_LOGI(TAG, "Viewer %d joined", client->fd);
+
+    bool first = s_client_count++ == 0;
+    if (client->crops)
+    {
+        s_crop_count++;
+    }
+    stream_update_outputs();
+    if (first)
+    {
+        app_event_post(APP_EVENT_VIEWER_FIRST);
+        ESP_LOGI(TAG, "Get count %d", app_face_db_count());
+        app_rate_init();
+#ifndef CONFIG_HEADLESS
+        app_pipeline_start();
+#endif
+    }
+}
+
+static esp_err_t stream_add_http(httpd_req_t *req, bool crops)
+{
+    stream_client_t *client = NULL;
+
+    xSemaphoreTake(s_client_lock, portMAX_DELAY);
+    esp_err_t res = stream_claim(&client);
+    if (res != ESP_OK)
+    {
+        goto out;
+    }
+
+    client->fd = httpd_req_to_sockfd(req);
+    struct timeval tv = { .tv_sec = STREAM_SEND_TIMEOUT_S, .tv_usec = 0 };
+    setsockopt(client->fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    // a frame ends in a short boundary write, Nagle would hold it back for the ACK
+    int nodelay = 1;
+    setsockopt(client->fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    client->active = true;
+    client->session_open = true;
+    client->dropped = 0;
+    client->crops = crops;
+    if (stream_send(client, _STREAM_RESPONSE, strlen(_STREAM_RESPONSE)) != ESP_OK
+    || app_task_create(APP_TASK_VIEWER, &stream_client_task, client, NULL) != ESP_OK)
+    {
+        client->active = false;
+        client->fd = -1;
+        client->crops = false;
+        res = ESP_FAIL;
+        goto out;
+    }
+
+    req->sess_ctx = client;
+    req->free_ctx = stream_session_free;
+    stream_joined(client);
+
+out:
+    xSemaphoreGive(s_client_lock);
+    return res;
+}
+
+esp_err_t app_stream_add_client(httpd_req_t *req)
+{
+    return stream_add_http(req, false);
+}
+
+esp_err_t app_stream_add_crop_client(httpd_req_t *req)
+{
+    return stream_add_http(req, true);
+}
+
+esp_err_t app_stream_add_sink(const stream_sink_t *sink, int fd)
+{
+    stream_client_t *client = NULL;
+
+    xSemaphoreTake(s_client_lock, portMAX_DELAY);
+    esp_err_t res = stream_claim(&client);
+    if (res != ESP_OK)
+    {
+        goto out;
+    }
+
+    client->fd = fd;
+    client->sink = sink;
+    client->active = true;
+    client->session_open = false;
+    client->dropped = 0;
+    if (app_task_create(APP_TASK_VIEWER, &stream_client_task, client, NULL) != ESP_OK)
+    {
+        client->active = false;
+        client->fd = -1;
+        client->sink = NULL;
+        res = ESP_FAIL;
+        goto out;
+    }
+    stream_joined(client);
+
+out:
+    xSemaphoreGive(s_client_lock);
+    return res;
+}
+
+void app_stream_remove_sink(const stream_sink_t *sink)
+{
+    xSemaphoreTake(s_client_lock, portMAX_DELAY);
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++)
+    {
+        if (s_clients[i].sink == sink)
+        {
+            s_clients[i].active = false;
+        }
+    }
+    xSemaphoreGive(s_client_lock);
+}
+
+int app_stream_client_count()
+{
+    return s_client_count;
+}
+
+void app_stream_stop()
+{
+    xSemaphoreTake(s_client_lock, portMAX_DELAY);
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++)
+    {
+        s_clients[i].active = false;
+    }
+    xSemaphoreGive(s_client_lock);
+}
+
+char *app_stream_status_to_json()
+{
+    cJSON *root = cJSON_CreateObject();
+    if (!root)
+    {
+        return NULL;
+    }
+    cJSON_AddStringToObject(root, "state", app_event_state_name(app_event_state()));
+    cJSON_AddNumberToObject(root, "uptime", (double)(esp_timer_get_time() / 1000000));
+    cJSON_AddNumberToObject(root, "faces", app_face_db_count());
+    cJSON_AddNumberToObject(root, "heap_internal", heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+    cJSON_AddNumberToObject(root, "heap_spiram", heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+    cJSON_AddNumberToObject(root, "stale_frames", app_pipeline_stale_frames());
+    cJSON_AddStringToObject(root, "shed", app_shed_level_name(app_shed_level()));
+#ifdef CONFIG_OFFLOAD_INFERENCE
+    offload_stats_t offload;
+    app_offload_get_stats(&offload);
+    cJSON *remote = cJSON_CreateObject();
+    cJSON_AddItemToObject(root, "offload", remote);
+    cJSON_AddBoolToObject(remote, "connected", offload.connected);
+    cJSON_AddBoolToObject(remote, "active", offload.active);
+    cJSON_AddNumberToObject(remote, "rtt_ms", offload.rtt_ms);
+    cJSON_AddNumberToObject(remote, "kbps", offload.kbps);
+    cJSON_AddNumberToObject(remote, "fallbacks", offload.fallbacks);
+#endif
+
+    cJSON *viewers = cJSON_CreateArray();
+    cJSON_AddItemToObject(root, "viewers", viewers);
+    xSemaphoreTake(s_client_lock, portMAX_DELAY);
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++)
+    {
+        if (s_clients[i].fd < 0)
+        {
+            continue;
+        }
+        cJSON *viewer = cJSON_CreateObject();
+        cJSON_AddNumberToObject(viewer, "fd", s_clients[i].fd);
+        cJSON_AddStringToObject(viewer, "transport", s_clients[i].sink ? s_clients[i].sink->name : (s_clients[i].crops ? "crops" : "mjpeg"));
+        cJSON_AddBoolToObject(viewer, "active", s_clients[i].active);
+        cJSON_AddNumberToObject(viewer, "dropped", s_clients[i].dropped);
+        cJSON_AddItemToArray(viewers, viewer);
+    }
+    xSemaphoreGive(s_client_lock);
+
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return json;
+}
+
+uint32_t app_stream_dropped_frames()
+{
+    return s_dropped;
+}
+
+#ifdef CONFIG_HEADLESS
+static void stream_start_headless()
+{
+    xSemaphoreTake(s_client_lock, portMAX_DELAY);
+    stream_update_outputs();
+    xSemaphoreGive(s_client_lock);
+    app_rate_init();
+    app_pipeline_start();
+}
+
+static void stream_state_changed(en_fsm_state state, en_fsm_state prev, app_event_type_t event, void *arg)
+{
+    // woken up, faces are looked for whether anyone watches or not
+    if (prev == WAIT_FOR_WAKEUP && state != WAIT_FOR_WAKEUP)
+    {
+        stream_start_headless();
+    }
+}
+#endif
+
+void app_stream_init(httpd_handle_t server)
+{
+    s_server = server;
+    s_client_lock = xSemaphoreCreateMutex();
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++)
+    {
+        s_clients[i].fd = -1;
+        s_clients[i].active = false;
+        s_clients[i].sink = NULL;
+        s_clients[i].crops = false;
+        s_clients[i].queue = xQueueCreate(1, sizeof(frame_desc_t *));
+    }
+    app_task_create(APP_TASK_STREAM_HUB, &stream_hub_task, NULL, NULL);
+#ifdef CONFIG_HEADLESS
+    app_pipeline_set_video(false);
+    app_event_subscribe(stream_state_changed, NULL);
+    // started after the wakeup, as without WARM_START or after deep sleep
+    if (app_event_state() != WAIT_FOR_WAKEUP)
+    {
+        stream_start_headless();
+    }
+#endif
+}
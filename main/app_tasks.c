@@ -0,0 +1,134 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "app_tasks.h"
+#include "app_pipeline.h"
+#include "app_mem.h"
+
+static const char *TAG = "app_tasks";
+
+/*
+ * Face detection owns PIPELINE_DETECT_CORE while streaming, everything that
+ * handles frames or sockets shares PIPELINE_ENCODE_CORE with the WiFi stack.
+ * Before the wake word the detect core is idle, so the speech tasks run there
+ * unless they keep listening during the stream.
+ */
+#ifdef CONFIG_SPEECH_CONTINUOUS
+// recorder only copies DMA data, inference gets the cycles the stream tasks leave
+#define SPEECH_CORE             PIPELINE_ENCODE_CORE
+#define SPEECH_NN_PRIORITY      1
+#else
+#define SPEECH_CORE             PIPELINE_DETECT_CORE
+#define SPEECH_NN_PRIORITY      5
+#endif
+
+static const app_task_desc_t s_tasks[APP_TASK_MAX] = {
+    [APP_TASK_EVENT]          = { "event",          3 * 1024,   10, PIPELINE_ENCODE_CORE },
+    [APP_TASK_WARM_START]     = { "warm_start",     4 * 1024,   4,  PIPELINE_ENCODE_CORE },
+    [APP_TASK_PIR]            = { "pir",            3 * 1024,   5,  PIPELINE_ENCODE_CORE },
+    [APP_TASK_ENROLL_DISPLAY] = { "enroll_display", 2 * 1024,   5,  PIPELINE_ENCODE_CORE },
+    [APP_TASK_DISPLAY]        = { "display",        3 * 1024,   1,  PIPELINE_ENCODE_CORE },
+    [APP_TASK_PREVIEW]        = { "preview",        4 * 1024,   1,  PIPELINE_ENCODE_CORE },
+    [APP_TASK_SPEECH_REC]     = { "rec",            3 * 1024,   5,  SPEECH_CORE },
+    [APP_TASK_SPEECH_NN]      = { "nn",             2 * 1024,   SPEECH_NN_PRIORITY, SPEECH_CORE },
+    [APP_TASK_CAPTURE]        = { "capture",        3 * 1024,   5,  PIPELINE_ENCODE_CORE },
+    [APP_TASK_DETECT]         = { "detect",         8 * 1024,   5,  PIPELINE_DETECT_CORE },
+    [APP_TASK_DETECT_2]       = { "detect2",        8 * 1024,   4,  PIPELINE_ENCODE_CORE },
+    [APP_TASK_FACES]          = { "faces",          8 * 1024,   5,  PIPELINE_DETECT_CORE },
+    [APP_TASK_RECOGNIZE]      = { "recognize",      8 * 1024,   5,  PIPELINE_ENCODE_CORE },
+    [APP_TASK_ENCODE]         = { "encode",         6 * 1024,   5,  PIPELINE_ENCODE_CORE },
+    [APP_TASK_JPEG]           = { "jpeg",           3 * 1024,   5,  PIPELINE_DETECT_CORE },
+    [APP_TASK_JPEG_DECODE]    = { "jpeg_decode",    3 * 1024,   5,  PIPELINE_ENCODE_CORE },
+    [APP_TASK_STREAM_HUB]     = { "stream_hub",     3 * 1024,   5,  PIPELINE_ENCODE_CORE },
+    [APP_TASK_VIEWER]         = { "viewer",         4 * 1024,   5,  PIPELINE_ENCODE_CORE },
+    [APP_TASK_HTTPD]          = { "httpd",          8 * 1024,   5,  PIPELINE_ENCODE_CORE },
+    [APP_TASK_RTSP]           = { "rtsp",           4 * 1024,   5,  PIPELINE_ENCODE_CORE },
+    [APP_TASK_WS]             = { "ws",             4 * 1024,   5,  PIPELINE_ENCODE_CORE },
+    [APP_TASK_ENROLL]         = { "enroll",         6 * 1024,   2,  PIPELINE_ENCODE_CORE },
+    [APP_TASK_ENROLL_UPLOAD]  = { "enroll_upload",  8 * 1024,   1,  PIPELINE_ENCODE_CORE },
+    [APP_TASK_FACE_STORE]     = { "face_store",     4 * 1024,   2,  PIPELINE_ENCODE_CORE },
+    [APP_TASK_STATS]          = { "task_stats",     3 * 1024,   1,  PIPELINE_ENCODE_CORE },
+    [APP_TASK_SLEEP]          = { "sleep",          3 * 1024,   1,  PIPELINE_ENCODE_CORE },
+    [APP_TASK_SOAK]           = { "soak",           3 * 1024,   2,  PIPELINE_ENCODE_CORE },
+    [APP_TASK_OFFLOAD]        = { "offload",        4 * 1024,   4,  PIPELINE_ENCODE_CORE },
+    [APP_TASK_BATTERY]        = { "battery",        3 * 1024,   1,  PIPELINE_ENCODE_CORE },
+    [APP_TASK_OTA]            = { "ota",            6 * 1024,   1,  PIPELINE_ENCODE_CORE },
+};
+
+const app_task_desc_t *app_task_desc(app_task_id_t id)
+{
+    return &s_tasks[id];
+}
+
+esp_err_t app_task_create(app_task_id_t id, TaskFunction_t fn, void *arg, TaskHandle_t *handle)
+{
+    const app_task_desc_t *desc = &s_tasks[id];
+
+    if (xTaskCreatePinnedToCore(fn, desc->name, desc->stack_size, arg, desc->priority, handle, desc->core) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Could not start task %s", desc->name);
+        return ESP_ERR_NO_MEM;
+    }
+    app_mem_account(APP_MEM_TASK_STACK, APP_MEM_INTERNAL, desc->stack_size, true);
+    return ESP_OK;
+}
+
+void app_task_exit(app_task_id_t id)
+{
+    app_mem_account(APP_MEM_TASK_STACK, APP_MEM_INTERNAL, s_tasks[id].stack_size, false);
+    vTaskDelete(NULL);
+}
+
+#ifdef CONFIG_TASK_STATS
+// one vTaskGetRunTimeStats line per task
+#define TASK_STATS_LINE_LEN     40
+
+static void task_stats_task(void *arg)
+{
+    while (1)
+    {
+        vTaskDelay(CONFIG_TASK_STATS_PERIOD_S * 1000 / portTICK_PERIOD_MS);
+
+        // a few spare lines for tasks started while the buffer is filled
+        size_t len = (uxTaskGetNumberOfTasks() + 4) * TASK_STATS_LINE_LEN;
+        char *buf = malloc(len);
+        if (buf == NULL)
+        {
+            continue;
+        }
+        vTaskGetRunTimeStats(buf);
+        ESP_LOGI(TAG, "Run time since boot\nTask\t\tTicks\t\tShare\n%s", buf);
+        free(buf);
+    }
+}
+#endif
+
+void app_task_stats_init()
+{
+#ifdef CONFIG_TASK_STATS
+    app_task_create(APP_TASK_STATS, &task_stats_task, NULL, NULL);
+#endif
+}
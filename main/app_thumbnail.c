@@ -0,0 +1,143 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "app_thumbnail.h"
+#include "app_display.h"
+#include "app_metrics.h"
+
+static const char *TAG = "app_thumbnail";
+
+// only touched by the detect task
+static uint8_t s_image[DISPLAY_PAGES][DISPLAY_WIDTH];
+// quantization error carried to this row and the next, a column of margin on each side
+static int16_t s_error[2][DISPLAY_WIDTH + 2];
+static uint16_t s_columns[DISPLAY_WIDTH];
+static int64_t s_next_us = 0;
+
+static void thumbnail_pixel(int x, int y, bool on)
+{
+    if (x < 0 || x >= DISPLAY_WIDTH || y < 0 || y >= DISPLAY_HEIGHT)
+    {
+        return;
+    }
+    if (on)
+    {
+        s_image[y >> 3][x] |= 1 << (y & 7);
+    }
+    else
+    {
+        s_image[y >> 3][x] &= ~(1 << (y & 7));
+    }
+}
+
+static void thumbnail_rect(int x0, int y0, int x1, int y1, bool on)
+{
+    for (int x = x0; x <= x1; x++)
+    {
+        thumbnail_pixel(x, y0, on);
+        thumbnail_pixel(x, y1, on);
+    }
+    for (int y = y0 + 1; y < y1; y++)
+    {
+        thumbnail_pixel(x0, y, on);
+        thumbnail_pixel(x1, y, on);
+    }
+}
+
+/* Floyd-Steinberg in one pass, top to bottom, sampling the image as it goes */
+static void thumbnail_dither(const dl_matrix3du_t *image, int left, int top, int out_w, int out_h)
+{
+    for (int x = 0; x < out_w; x++)
+    {
+        s_columns[x] = x * image->w / out_w * 3;
+    }
+    memset(s_error, 0, sizeof(s_error));
+
+    for (int y = 0; y < out_h; y++)
+    {
+        int16_t *cur = s_error[y & 1] + 1;
+        int16_t *next = s_error[(y + 1) & 1] + 1;
+        memset(next - 1, 0, sizeof(s_error[0]));
+
+        const uint8_t *row = image->item + (y * image->h / out_h) * image->stride;
+        for (int x = 0; x < out_w; x++)
+        {
+            const uint8_t *px = row + s_columns[x];
+            int value = ((px[0] * 29 + px[1] * 150 + px[2] * 77) >> 8) + cur[x];
+            int error = value;
+            if (value >= 128)
+            {
+                s_image[(top + y) >> 3][left + x] |= 1 << ((top + y) & 7);
+                error = value - 255;
+            }
+            cur[x + 1] += (error * 7) >> 4;
+            next[x - 1] += (error * 3) >> 4;
+            next[x] += (error * 5) >> 4;
+            next[x + 1] += error >> 4;
+        }
+    }
+}
+
+void app_thumbnail_draw(const dl_matrix3du_t *image, size_t frame_width, size_t frame_height,
+                        const box_array_t *boxes)
+{
+    int64_t start = esp_timer_get_time();
+    if (!image || start < s_next_us)
+    {
+        return;
+    }
+    s_next_us = start + 1000000 / CONFIG_OLED_THUMBNAIL_FPS;
+
+    // the aspect of the frame is kept, the thumbnail is centred on the panel
+    int out_w = image->w * DISPLAY_HEIGHT / image->h;
+    int out_h = DISPLAY_HEIGHT;
+    if (out_w > DISPLAY_WIDTH)
+    {
+        out_w = DISPLAY_WIDTH;
+        out_h = image->h * DISPLAY_WIDTH / image->w;
+    }
+    int left = (DISPLAY_WIDTH - out_w) / 2;
+    int top = (DISPLAY_HEIGHT - out_h) / 2;
+
+    memset(s_image, 0, sizeof(s_image));
+    thumbnail_dither(image, left, top, out_w, out_h);
+
+    for (int i = 0; boxes && i < boxes->len; i++)
+    {
+        const fptp_t *box = boxes->box[i].box_p;
+        int x0 = left + (int)box[0] * out_w / (int)frame_width;
+        int y0 = top + (int)box[1] * out_h / (int)frame_height;
+        int x1 = left + (int)box[2] * out_w / (int)frame_width;
+        int y1 = top + (int)box[3] * out_h / (int)frame_height;
+        // lit outside, dark inside, so that it shows on any background
+        thumbnail_rect(x0, y0, x1, y1, true);
+        thumbnail_rect(x0 + 1, y0 + 1, x1 - 1, y1 - 1, false);
+    }
+
+    app_display_image((const uint8_t (*)[DISPLAY_WIDTH])s_image);
+    app_display_flush(NULL, NULL);
+    app_metrics_observe(METRIC_THUMBNAIL, esp_timer_get_time() - start);
+    ESP_LOGV(TAG, "%dx%d from %dx%d", out_w, out_h, image->w, image->h);
+}
@@ -0,0 +1,233 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "driver/rtc_io.h"
+#include "esp_attr.h"
+#include "esp_clk.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "lwip/sockets.h"
+#include "sdkconfig.h"
+#include "app_timelapse.h"
+#include "app_main.h"
+#include "app_boot.h"
+#include "app_camera.h"
+#include "app_config.h"
+#include "app_event.h"
+
+#ifdef CONFIG_TIMELAPSE
+static const char *TAG = "app_timelapse";
+
+/* RTC memory is loaded from the image on a cold boot, so the magic is only there after sleeping */
+#define TIMELAPSE_MAGIC         0x544c5031
+#define TIMELAPSE_INTERVAL_US   (CONFIG_TIMELAPSE_INTERVAL_S * 1000000ULL)
+/* Shortest sleep after a shot that took longer than the interval */
+#define TIMELAPSE_MIN_SLEEP_US  1000000ULL
+#define TIMELAPSE_TIMEOUT_MS    3000
+
+typedef struct {
+    uint32_t magic;
+    uint32_t shots;
+    uint32_t failures;      /* shots that did not reach the server */
+    uint64_t next_wake;     /* RTC time the timer wakes the chip at */
+    uint64_t last_awake_us; /* of the last shot, from the timer wakeup until sleep */
+    uint64_t awake_us;      /* sums over all shots since the cold boot */
+    uint64_t sleep_us;
+} timelapse_state_t;
+
+static RTC_DATA_ATTR timelapse_state_t s_state;
+
+static bool timelapse_send(int sock, const void *buf, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+
+    while (len > 0)
+    {
+        int n = send(sock, p, len, 0);
+        if (n <= 0)
+        {
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+// auto exposure and white balance need a few frames after the sensor starts
+static camera_fb_t *timelapse_capture()
+{
+    for (int i = 0; i < CONFIG_TIMELAPSE_SETTLE_FRAMES; i++)
+    {
+        camera_fb_t *fb = esp_camera_fb_get();
+        if (fb)
+        {
+            esp_camera_fb_return(fb);
+        }
+    }
+    return esp_camera_fb_get();
+}
+
+/* POSTs the JPEG to CONFIG_TIMELAPSE_HOST, ESP_OK once the server answered with 2xx */
+static esp_err_t timelapse_upload(const camera_fb_t *fb)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CONFIG_TIMELAPSE_PORT),
+    };
+    struct timeval timeout = {
+        .tv_sec = TIMELAPSE_TIMEOUT_MS / 1000,
+    };
+    char buf[256];
+
+    if (!inet_aton(CONFIG_TIMELAPSE_HOST, &addr.sin_addr))
+    {
+        ESP_LOGE(TAG, "Invalid upload address %s", CONFIG_TIMELAPSE_HOST);
+        return ESP_ERR_INVALID_ARG;
+    }
+    // joining went on while the sensor started and settled
+    EventBits_t bits = xEventGroupWaitBits(g_wifi_event_group, WIFI_CONNECTED_BIT, pdFALSE, pdTRUE,
+                                           CONFIG_TIMELAPSE_WIFI_TIMEOUT_MS / portTICK_PERIOD_MS);
+    if (!(bits & WIFI_CONNECTED_BIT))
+    {
+        ESP_LOGE(TAG, "No network after %d ms", CONFIG_TIMELAPSE_WIFI_TIMEOUT_MS);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0)
+    {
+        return ESP_FAIL;
+    }
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    esp_err_t err = ESP_FAIL;
+    int len = snprintf(buf, sizeof(buf), "POST %s HTTP/1.1\r\nHost: %s\r\nContent-Type: image/jpeg\r\n"
+                       "Content-Length: %u\r\nX-Timelapse-Shot: %u\r\nX-Timelapse-Awake-Ms: %llu\r\nConnection: close\r\n\r\n",
+                       CONFIG_TIMELAPSE_PATH, CONFIG_TIMELAPSE_HOST, fb->len, s_state.shots, s_state.last_awake_us / 1000);
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0
+    && timelapse_send(sock, buf, len) && timelapse_send(sock, fb->buf, fb->len))
+    {
+        // only the status line matters, "HTTP/1.1 200"
+        len = recv(sock, buf, sizeof(buf) - 1, 0);
+        if (len >= 12 && buf[9] == '2')
+        {
+            err = ESP_OK;
+        }
+        else
+        {
+            ESP_LOGE(TAG, "Upload not accepted: %.*s", len > 12 ? 12 : (len > 0 ? len : 0), buf);
+        }
+    }
+    close(sock);
+    return err;
+}
+
+static void timelapse_sleep(uint64_t wake)
+{
+    esp_wifi_stop();
+
+    // the next shot is due an interval after this wakeup, not after this sleep
+    uint64_t now = esp_clk_rtc_time();
+    uint64_t awake = now - wake;
+    uint64_t sleep = awake + TIMELAPSE_MIN_SLEEP_US < TIMELAPSE_INTERVAL_US ? TIMELAPSE_INTERVAL_US - awake : TIMELAPSE_MIN_SLEEP_US;
+    s_state.last_awake_us = awake;
+    s_state.awake_us += awake;
+    s_state.sleep_us += sleep;
+    s_state.next_wake = now + sleep;
+    ESP_LOGI(TAG, "Shot %u awake %llu ms, duty cycle %.3f%% over %u shots, %u failed",
+             s_state.shots, awake / 1000, s_state.awake_us * 100.0 / (s_state.awake_us + s_state.sleep_us),
+             s_state.shots, s_state.failures);
+
+    // GPIO0 has a pull-up on the board, the RTC one keeps it high with the digital pads off
+    rtc_gpio_pullup_en(GPIO_BUTTON);
+    esp_sleep_enable_ext0_wakeup(GPIO_BUTTON, 0);
+    esp_sleep_enable_timer_wakeup(sleep);
+    esp_deep_sleep_start();
+}
+#endif
+
+void app_timelapse_run()
+{
+#ifdef CONFIG_TIMELAPSE
+    esp_sleep_wakeup_cause_t cause = esp_sleep_get_wakeup_cause();
+    uint64_t wake;
+
+    if (cause == ESP_SLEEP_WAKEUP_EXT0 || cause == ESP_SLEEP_WAKEUP_EXT1)
+    {
+        ESP_LOGI(TAG, "Woken up by the %s, starting as usual", cause == ESP_SLEEP_WAKEUP_EXT0 ? "button" : "PIR");
+        return;
+    }
+    if (cause == ESP_SLEEP_WAKEUP_TIMER && s_state.magic == TIMELAPSE_MAGIC)
+    {
+        wake = s_state.next_wake;
+    }
+    else
+    {
+        // the bootloader is not counted on a cold boot
+        memset(&s_state, 0, sizeof(s_state));
+        s_state.magic = TIMELAPSE_MAGIC;
+        wake = esp_clk_rtc_time() - esp_timer_get_time();
+    }
+
+    // no display, wake word, PIR or HTTP server, only what the shot needs
+    ESP_ERROR_CHECK(app_event_init());
+    app_boot_begin(BOOT_PHASE_CONFIG);
+    app_wifi_prepare();
+    ESP_ERROR_CHECK(app_config_init());
+    app_boot_end(BOOT_PHASE_CONFIG);
+    app_boot_begin(BOOT_PHASE_WIFI);
+    app_wifi_init();
+    app_boot_end(BOOT_PHASE_WIFI);
+    app_boot_begin(BOOT_PHASE_CAMERA);
+    app_camera_init();
+    app_boot_end(BOOT_PHASE_CAMERA);
+
+    app_boot_begin(BOOT_PHASE_CAPTURE);
+    camera_fb_t *fb = timelapse_capture();
+    app_boot_end(BOOT_PHASE_CAPTURE);
+    app_boot_begin(BOOT_PHASE_UPLOAD);
+    esp_err_t err = fb ? timelapse_upload(fb) : ESP_FAIL;
+    app_boot_end(BOOT_PHASE_UPLOAD);
+    if (fb)
+    {
+        esp_camera_fb_return(fb);
+    }
+    else
+    {
+        ESP_LOGE(TAG, "No frame from the camera");
+    }
+    if (err != ESP_OK)
+    {
+        s_state.failures++;
+    }
+    s_state.shots++;
+    app_boot_report();
+    timelapse_sleep(wake);
+#endif
+}
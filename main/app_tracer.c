@@ -0,0 +1,216 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "app_tracer.h"
+#include "app_mem.h"
+#ifdef CONFIG_SYSVIEW_ENABLE
+#include "SEGGER_SYSVIEW.h"
+#endif
+
+#ifdef CONFIG_TRACE
+static const char *TAG = "app_tracer";
+
+#define TRACER_EVENTS       CONFIG_TRACE_EVENTS
+#define TRACER_LINE_LEN     1024
+/* Tasks named in one export, the events of the others show on unnamed tracks */
+#define TRACER_MAX_TASKS    32
+
+typedef struct {
+    uint32_t time;          /* esp_timer, wraps after 71 minutes */
+    uint32_t task;          /* handle of the running task, 0 in an ISR */
+    uint32_t arg;
+    uint16_t id;
+    uint8_t phase;
+    uint8_t core;
+} trace_event_t;
+
+static const char *s_names[TRACE_MAX] = {
+    [TRACE_CAPTURE]       = "capture",
+    [TRACE_DETECT]        = "detect",
+    [TRACE_FACES]         = "faces",
+    [TRACE_RECOGNIZE]     = "recognize",
+    [TRACE_ENCODE]        = "encode",
+    [TRACE_SEND]          = "send",
+    [TRACE_HTTPD]         = "httpd",
+    [TRACE_NN]            = "nn",
+    [TRACE_REC]           = "rec",
+    [TRACE_PIR]           = "pir",
+    [TRACE_PIR_ISR]       = "pir_isr",
+    [TRACE_BUTTON_ISR]    = "button_isr",
+    [TRACE_LED]           = "led",
+    [TRACE_WIFI]          = "wifi",
+    [TRACE_DETECT_QUEUE]  = "detect_queue",
+    [TRACE_ENCODE_QUEUE]  = "encode_queue",
+    [TRACE_AUDIO_QUEUE]   = "audio_queue",
+};
+
+volatile bool app_tracer_enabled = false;
+static trace_event_t *s_events = NULL;
+/* Events recorded since tracing started, the ring index is this modulo TRACER_EVENTS */
+static uint32_t s_next = 0;
+
+void IRAM_ATTR app_tracer_record(trace_id_t id, trace_phase_t phase, uint32_t arg)
+{
+    uint32_t n = __atomic_fetch_add(&s_next, 1, __ATOMIC_RELAXED);
+    trace_event_t *event = &s_events[n % TRACER_EVENTS];
+
+    event->time = (uint32_t)esp_timer_get_time();
+    event->task = xPortInIsrContext() ? 0 : (uint32_t)xTaskGetCurrentTaskHandle();
+    event->arg = arg;
+    event->id = id;
+    event->phase = phase;
+    event->core = xPortGetCoreID();
+
+#ifdef CONFIG_SYSVIEW_ENABLE
+    // with SystemView over JTAG the markers show next to the task switches, as user events of their id
+    switch (phase)
+    {
+    case TRACE_PHASE_BEGIN:
+        SEGGER_SYSVIEW_OnUserStart(id);
+        break;
+    case TRACE_PHASE_END:
+        SEGGER_SYSVIEW_OnUserStop(id);
+        break;
+    case TRACE_PHASE_INSTANT:
+        SEGGER_SYSVIEW_OnUserStart(id);
+        SEGGER_SYSVIEW_OnUserStop(id);
+        break;
+    default:
+        break;
+    }
+#endif
+}
+
+esp_err_t app_tracer_enable(bool enable)
+{
+    if (!enable)
+    {
+        app_tracer_enabled = false;
+        return ESP_OK;
+    }
+    if (!s_events)
+    {
+        s_events = app_mem_alloc(APP_MEM_TRACE, TRACER_EVENTS * sizeof(trace_event_t));
+        if (!s_events)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    if (!app_tracer_enabled)
+    {
+        s_next = 0;
+        ESP_LOGI(TAG, "Tracing into %d events", TRACER_EVENTS);
+    }
+    app_tracer_enabled = true;
+    return ESP_OK;
+}
+
+/* Names the track of a task after the first marker it recorded, handles of deleted tasks can't be asked for their name */
+static int tracer_write_task(const trace_event_t *event, uint32_t *tasks, int *task_count, char *buf, int size)
+{
+    for (int i = 0; i < *task_count; i++)
+    {
+        if (tasks[i] == event->task)
+        {
+            return 0;
+        }
+    }
+    if (*task_count == TRACER_MAX_TASKS)
+    {
+        return 0;
+    }
+    tasks[(*task_count)++] = event->task;
+    if (!event->task)
+    {
+        return snprintf(buf, size, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"isr\"}}");
+    }
+    return snprintf(buf, size, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s %08x\"}}",
+            event->task, s_names[event->id], event->task);
+}
+
+static int tracer_write_event(const trace_event_t *event, uint32_t start, char *buf, int size)
+{
+    uint32_t ts = event->time - start;
+
+    switch (event->phase)
+    {
+    case TRACE_PHASE_BEGIN:
+        return snprintf(buf, size, ",\n{\"name\":\"%s\",\"ph\":\"B\",\"ts\":%u,\"pid\":1,\"tid\":%u,\"args\":{\"arg\":%u,\"core\":%u}}",
+                s_names[event->id], ts, event->task, event->arg, event->core);
+    case TRACE_PHASE_END:
+        return snprintf(buf, size, ",\n{\"ph\":\"E\",\"ts\":%u,\"pid\":1,\"tid\":%u}", ts, event->task);
+    case TRACE_PHASE_INSTANT:
+        return snprintf(buf, size, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%u,\"pid\":1,\"tid\":%u,\"args\":{\"arg\":%u,\"core\":%u}}",
+                s_names[event->id], ts, event->task, event->arg, event->core);
+    default:
+        return snprintf(buf, size, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%u,\"pid\":1,\"args\":{\"value\":%u}}",
+                s_names[event->id], ts, event->arg);
+    }
+}
+
+esp_err_t app_tracer_write_json(tracer_write_cb write, void *arg)
+{
+    char buf[TRACER_LINE_LEN];
+    uint32_t tasks[TRACER_MAX_TASKS];
+    int task_count = 0;
+    esp_err_t res = ESP_OK;
+    bool enabled = app_tracer_enabled;
+
+    app_tracer_enabled = false;
+    // a marker that saw the flag set may still be writing its event
+    vTaskDelay(1);
+
+    uint32_t next = s_events ? s_next : 0;
+    uint32_t count = next < TRACER_EVENTS ? next : TRACER_EVENTS;
+    uint32_t start = count ? s_events[(next - count) % TRACER_EVENTS].time : 0;
+    int n = snprintf(buf, sizeof(buf), "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+            "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"esp32\"}}");
+
+    for (uint32_t i = next - count; i != next && res == ESP_OK; i++)
+    {
+        const trace_event_t *event = &s_events[i % TRACER_EVENTS];
+
+        // the longest event needs less than a quarter of the buffer
+        if (n > TRACER_LINE_LEN * 3 / 4)
+        {
+            res = write(arg, buf, n);
+            n = 0;
+        }
+        n += tracer_write_task(event, tasks, &task_count, buf + n, sizeof(buf) - n);
+        n += tracer_write_event(event, start, buf + n, sizeof(buf) - n);
+    }
+    if (res == ESP_OK)
+    {
+        n += snprintf(buf + n, sizeof(buf) - n, "\n]}\n");
+        res = write(arg, buf, n);
+    }
+
+    app_tracer_enabled = enabled;
+    return res;
+}
+#endif
@@ -0,0 +1,199 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "esp_log.h"
+#include "app_track.h"
+#include "app_pipeline.h"
+#include "app_mem.h"
+
+static const char *TAG = "app_track";
+
+/* Region searched around a tracked face, relative to the face size */
+#define TRACK_ROI_SCALE     2.0f
+/* Smallest face searched in a region, relative to the tracked face */
+#define TRACK_MIN_FACE      0.6f
+/* P-Net input size, regions and faces below it cannot be detected */
+#define TRACK_MIN_SIZE      12
+
+static box_t s_boxes[PIPELINE_MAX_FACES];
+static int s_count = 0;
+static int s_frames = 0;
+static int s_width = 0;
+static int s_height = 0;
+static dl_matrix3du_t *s_roi = NULL;
+static size_t s_roi_pixels = 0;
+// result of the region around one tracked face
+static track_faces_t s_region;
+
+static void track_store(dl_matrix3du_t *image_matrix, const track_faces_t *faces)
+{
+    s_width = image_matrix->w;
+    s_height = image_matrix->h;
+    s_count = faces->array.len < PIPELINE_MAX_FACES ? faces->array.len : PIPELINE_MAX_FACES;
+    memcpy(s_boxes, faces->box, s_count * sizeof(box_t));
+}
+
+static bool track_roi_alloc(size_t pixels)
+{
+    if (s_roi && pixels <= s_roi_pixels)
+    {
+        return true;
+    }
+    if (s_roi)
+    {
+        app_mem_matrix_free(APP_MEM_TRACK_ROI, s_roi);
+    }
+    // regions never exceed the detector input, size the buffer for it once
+    s_roi = app_mem_matrix_alloc(APP_MEM_TRACK_ROI, s_width, s_height, 3);
+    s_roi_pixels = s_roi ? s_width * s_height : 0;
+    return s_roi && pixels <= s_roi_pixels;
+}
+
+static bool track_roi_detect(dl_matrix3du_t *image_matrix, mtmn_config_t *config, box_t *box, track_faces_t *found)
+{
+    float w = box->box_p[2] - box->box_p[0] + 1;
+    float h = box->box_p[3] - box->box_p[1] + 1;
+    float cx = (box->box_p[0] + box->box_p[2]) / 2;
+    float cy = (box->box_p[1] + box->box_p[3]) / 2;
+    float side = (w > h ? w : h) * TRACK_ROI_SCALE;
+
+    int x0 = (int)(cx - side / 2);
+    int y0 = (int)(cy - side / 2);
+    int x1 = (int)(cx + side / 2);
+    int y1 = (int)(cy + side / 2);
+    x0 = x0 < 0 ? 0 : x0;
+    y0 = y0 < 0 ? 0 : y0;
+    x1 = x1 > image_matrix->w ? image_matrix->w : x1;
+    y1 = y1 > image_matrix->h ? image_matrix->h : y1;
+
+    int roi_w = x1 - x0;
+    int roi_h = y1 - y0;
+    if (roi_w < TRACK_MIN_SIZE || roi_h < TRACK_MIN_SIZE || !track_roi_alloc(roi_w * roi_h))
+    {
+        return false;
+    }
+
+    s_roi->w = roi_w;
+    s_roi->h = roi_h;
+    s_roi->stride = roi_w * 3;
+    for (int y = 0; y < roi_h; y++)
+    {
+        memcpy(s_roi->item + y * roi_w * 3, image_matrix->item + ((y0 + y) * image_matrix->w + x0) * 3, roi_w * 3);
+    }
+
+    mtmn_config_t roi_config = *config;
+    roi_config.min_face = (w < h ? w : h) * TRACK_MIN_FACE;
+    if (roi_config.min_face < TRACK_MIN_SIZE)
+    {
+        roi_config.min_face = TRACK_MIN_SIZE;
+    }
+    if (app_track_face_detect(s_roi, &roi_config, found) == 0)
+    {
+        return false;
+    }
+
+    // only the best match is kept
+    found->box[0].box_p[0] += x0;
+    found->box[0].box_p[1] += y0;
+    found->box[0].box_p[2] += x0;
+    found->box[0].box_p[3] += y0;
+    for (int j = 0; j < 10; j += 2)
+    {
+        found->landmark[0].landmark_p[j] += x0;
+        found->landmark[0].landmark_p[j + 1] += y0;
+    }
+    return true;
+}
+
+void app_track_reset()
+{
+    s_count = 0;
+    s_frames = 0;
+}
+
+int app_track_face_detect(dl_matrix3du_t *image_matrix, mtmn_config_t *config, track_faces_t *faces)
+{
+    faces->array.box = faces->box;
+    faces->array.landmark = faces->landmark;
+    faces->array.len = 0;
+
+    box_array_t *boxes = face_detect(image_matrix, config);
+    if (!boxes)
+    {
+        return 0;
+    }
+    int len = boxes->len < TRACK_MAX_FACES ? boxes->len : TRACK_MAX_FACES;
+    memcpy(faces->box, boxes->box, len * sizeof(box_t));
+    if (boxes->landmark)
+    {
+        memcpy(faces->landmark, boxes->landmark, len * sizeof(landmark_t));
+    }
+    else
+    {
+        memset(faces->landmark, 0, len * sizeof(landmark_t));
+    }
+    faces->array.len = len;
+
+    // returned right away, nothing else gets to allocate around the detector's arrays
+    free(boxes->box);
+    free(boxes->landmark);
+    free(boxes);
+    return len;
+}
+
+int app_track_detect(dl_matrix3du_t *image_matrix, mtmn_config_t *config, track_faces_t *faces)
+{
+    int tracked = s_count;
+
+    if (CONFIG_FACE_TRACK_FRAMES == 0 || s_count == 0 || s_frames >= CONFIG_FACE_TRACK_FRAMES
+    || image_matrix->w != s_width || image_matrix->h != s_height)
+    {
+        app_track_face_detect(image_matrix, config, faces);
+        track_store(image_matrix, faces);
+        s_frames = 0;
+        return faces->array.len;
+    }
+
+    faces->array.box = faces->box;
+    faces->array.landmark = faces->landmark;
+    faces->array.len = 0;
+    // one best match per tracked face, the region may catch a neighbour as well
+    for (int i = 0; i < tracked; i++)
+    {
+        if (track_roi_detect(image_matrix, config, &s_boxes[i], &s_region))
+        {
+            faces->box[faces->array.len] = s_region.box[0];
+            faces->landmark[faces->array.len] = s_region.landmark[0];
+            faces->array.len++;
+        }
+    }
+    s_frames++;
+
+    track_store(image_matrix, faces);
+    if (faces->array.len < tracked)
+    {
+        // a face moved out of its region or left the frame, search the whole frame next time
+        ESP_LOGD(TAG, "Lost %d of %d tracked faces", tracked - faces->array.len, tracked);
+        s_frames = CONFIG_FACE_TRACK_FRAMES;
+    }
+    return faces->array.len;
+}
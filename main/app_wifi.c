@@ -24,6 +24,7 @@
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
 #include "esp_system.h"
+#include "esp_attr.h"
 #include "esp_wifi.h"
 #include "esp_event_loop.h"
 #include "esp_log.h"
@@ -33,17 +34,76 @@
 #include "lwip/err.h"
 #include "lwip/sys.h"
 #include "app_wifi.h"
+#include "app_config.h"
+#include "app_event.h"
+#include "app_boot.h"
+#include "app_tracer.h"
 
 static const char *TAG = "app_wifi";
 
-#define EXAMPLE_ESP_WIFI_MODE_AP   1 //TRUE:AP FALSE:STA
-#define EXAMPLE_ESP_WIFI_SSID      CONFIG_ESP_WIFI_SSID
-#define EXAMPLE_ESP_WIFI_PASS      CONFIG_ESP_WIFI_PASSWORD
+EventGroupHandle_t g_wifi_event_group;
+
 #define EXAMPLE_MAX_STA_CONN       CONFIG_MAX_STA_CONN
 #define EXAMPLE_IP_ADDR            CONFIG_SERVER_IP
 
+#ifdef CONFIG_WIFI_FAST_CONNECT
+/* RTC memory is loaded from the image on a cold boot, so the magic is only there after deep sleep */
+#define WIFI_CACHE_MAGIC    0x57464331
+
+typedef struct {
+    uint32_t magic;
+    char ssid[NETWORK_SSID_MAX];        /* the cache is for this network only */
+    uint8_t bssid[6];
+    uint8_t channel;
+    tcpip_adapter_ip_info_t ip_info;    /* last DHCP lease */
+} wifi_cache_t;
+
+static RTC_DATA_ATTR wifi_cache_t s_cache;
+static bool s_fast;                     /* joining the cached access point, no IP yet */
+
+static bool wifi_cache_valid(const network_config_t *config)
+{
+    return s_cache.magic == WIFI_CACHE_MAGIC && !strcmp(s_cache.ssid, config->ssid);
+}
+
+static void wifi_cache_store(const tcpip_adapter_ip_info_t *ip_info)
+{
+    wifi_ap_record_t ap;
+    wifi_config_t wifi_config;
+
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK || esp_wifi_get_config(ESP_IF_WIFI_STA, &wifi_config) != ESP_OK)
+    {
+        return;
+    }
+    memset(&s_cache, 0, sizeof(s_cache));
+    memcpy(s_cache.ssid, wifi_config.sta.ssid, strnlen((char *)wifi_config.sta.ssid, sizeof(s_cache.ssid) - 1));
+    memcpy(s_cache.bssid, ap.bssid, sizeof(s_cache.bssid));
+    s_cache.channel = ap.primary;
+    s_cache.ip_info = *ip_info;
+    s_cache.magic = WIFI_CACHE_MAGIC;
+}
+
+// the access point moved or is gone, scan for the SSID like on a cold boot
+static void wifi_fast_fallback()
+{
+    wifi_config_t wifi_config;
+
+    ESP_LOGW(TAG, "No connection on channel %d, scanning", s_cache.channel);
+    s_fast = false;
+    s_cache.magic = 0;
+    esp_wifi_get_config(ESP_IF_WIFI_STA, &wifi_config);
+    wifi_config.sta.bssid_set = false;
+    wifi_config.sta.channel = 0;
+    esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config);
+#ifdef CONFIG_WIFI_STA_REUSE_LEASE
+    tcpip_adapter_dhcpc_start(TCPIP_ADAPTER_IF_STA);
+#endif
+}
+#endif
+
 static esp_err_t event_handler(void *ctx, system_event_t *event)
 {/*{{{*/
+    TRACE_INSTANT(TRACE_WIFI, event->event_id);
     switch(event->event_id) {
     case SYSTEM_EVENT_STA_START:
         esp_wifi_connect();
@@ -51,6 +111,12 @@ static esp_err_t event_handler(void *ctx, system_event_t *event)
     case SYSTEM_EVENT_STA_GOT_IP:
         ESP_LOGI(TAG, "got ip:%s",
                  ip4addr_ntoa(&event->event_info.got_ip.ip_info.ip));
+        app_boot_mark(BOOT_PHASE_WIFI_IP);
+        xEventGroupSetBits(g_wifi_event_group, WIFI_CONNECTED_BIT);
+#ifdef CONFIG_WIFI_FAST_CONNECT
+        s_fast = false;
+        wifi_cache_store(&event->event_info.got_ip.ip_info);
+#endif
         break;
     case SYSTEM_EVENT_AP_STACONNECTED:
         ESP_LOGI(TAG, "station:" MACSTR " join, AID=%d",
@@ -64,6 +130,13 @@ static esp_err_t event_handler(void *ctx, system_event_t *event)
 
         break;
     case SYSTEM_EVENT_STA_DISCONNECTED:
+        xEventGroupClearBits(g_wifi_event_group, WIFI_CONNECTED_BIT);
+#ifdef CONFIG_WIFI_FAST_CONNECT
+        if (s_fast)
+        {
+            wifi_fast_fallback();
+        }
+#endif
         esp_wifi_connect();
         break;
     default:
@@ -72,11 +145,22 @@ static esp_err_t event_handler(void *ctx, system_event_t *event)
     return ESP_OK;
 }/*}}}*/
 
-#if EXAMPLE_ESP_WIFI_MODE_AP
-static void wifi_init_softap()
+static bool s_prepared;
+static bool s_started;
+static network_mode_t s_mode;
+static bool s_force_ps;
+
+static void wifi_set_rate(wifi_interface_t ifx, const network_config_t *config)
 {
-    tcpip_adapter_init();
+    ESP_ERROR_CHECK(esp_wifi_set_protocol(ifx, WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N));
+    if (esp_wifi_set_bandwidth(ifx, config->ht40 ? WIFI_BW_HT40 : WIFI_BW_HT20) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Could not set the channel width");
+    }
+}
 
+static void wifi_init_softap(const network_config_t *config)
+{
     if (strcmp(EXAMPLE_IP_ADDR, "192.168.4.1"))
     {
         int a, b, c, d;
@@ -90,8 +174,6 @@ static void wifi_init_softap()
         ESP_ERROR_CHECK(tcpip_adapter_dhcps_start(WIFI_IF_AP));
     }
 
-    ESP_ERROR_CHECK(esp_event_loop_init(event_handler, NULL));
-
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
@@ -100,68 +182,129 @@ static void wifi_init_softap()
     
     wifi_config_t wifi_config;
     memset(&wifi_config, 0, sizeof(wifi_config_t));
-    if (strlen(EXAMPLE_ESP_WIFI_SSID) == 0)
+    if (strlen(config->ssid) == 0)
     {
         snprintf((char *)wifi_config.ap.ssid, 32, "esp-eye-%x%x", mac[4], mac[5]);
     }
     else
     {
-        memcpy(wifi_config.ap.ssid, EXAMPLE_ESP_WIFI_SSID, sizeof(EXAMPLE_ESP_WIFI_SSID));
+        // 32 characters fill the field without a terminator, ssid_len bounds it
+        memcpy(wifi_config.ap.ssid, config->ssid, strnlen(config->ssid, sizeof(wifi_config.ap.ssid)));
     }
-    memcpy(wifi_config.ap.password, EXAMPLE_ESP_WIFI_PASS, sizeof(EXAMPLE_ESP_WIFI_PASS));
-    wifi_config.ap.ssid_len = strlen(EXAMPLE_ESP_WIFI_SSID);
+    memcpy(wifi_config.ap.password, config->password, strnlen(config->password, sizeof(wifi_config.ap.password)));
+    wifi_config.ap.ssid_len = strnlen((char *)wifi_config.ap.ssid, sizeof(wifi_config.ap.ssid));
     wifi_config.ap.max_connection = EXAMPLE_MAX_STA_CONN;
     wifi_config.ap.authmode = WIFI_AUTH_WPA_WPA2_PSK;
-    if (strlen(EXAMPLE_ESP_WIFI_PASS) == 0) {
+    if (strlen(config->password) == 0) {
         wifi_config.ap.authmode = WIFI_AUTH_OPEN;
     }
 
     esp_wifi_set_ps(WIFI_PS_NONE);
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_AP));
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &wifi_config));
+    wifi_set_rate(ESP_IF_WIFI_AP, config);
 
     ESP_ERROR_CHECK(esp_wifi_start());
 
     ESP_LOGI(TAG, "wifi_init_softap finished.SSID:%s password:%s",
-            wifi_config.ap.ssid, EXAMPLE_ESP_WIFI_PASS);
+            wifi_config.ap.ssid, config->password);
+}
 
-    char buf[80];
-    sprintf(buf, "SSID:%s", wifi_config.ap.ssid);
-    sprintf(buf, "PASSWORD:%s", wifi_config.ap.password);
+#if defined(CONFIG_WIFI_STA_STATIC_IP) || defined(CONFIG_WIFI_STA_REUSE_LEASE)
+// DHCP stays off for a static address, or a reused lease until the fast connect fails
+static void wifi_set_sta_address()
+{
+    tcpip_adapter_ip_info_t ip_info;
 
+#if defined(CONFIG_WIFI_STA_STATIC_IP)
+    if (!ip4addr_aton(CONFIG_WIFI_STATIC_IP_ADDR, &ip_info.ip)
+    || !ip4addr_aton(CONFIG_WIFI_STATIC_GATEWAY, &ip_info.gw)
+    || !ip4addr_aton(CONFIG_WIFI_STATIC_NETMASK, &ip_info.netmask))
+    {
+        ESP_LOGE(TAG, "Invalid static address, using DHCP");
+        return;
+    }
+#elif defined(CONFIG_WIFI_STA_REUSE_LEASE)
+    if (!s_fast)
+    {
+        return;
+    }
+    ip_info = s_cache.ip_info;
+#endif
+    tcpip_adapter_dhcpc_stop(TCPIP_ADAPTER_IF_STA);
+    ESP_ERROR_CHECK(tcpip_adapter_set_ip_info(TCPIP_ADAPTER_IF_STA, &ip_info));
+    ESP_LOGI(TAG, "Address %s without DHCP", ip4addr_ntoa(&ip_info.ip));
 }
+#endif
 
-#else
-
-static void wifi_init_sta() 
+static void wifi_init_sta(const network_config_t *config)
 {
-    tcpip_adapter_init();
-    ESP_ERROR_CHECK(esp_event_loop_init(event_handler, NULL));
-
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
     wifi_config_t wifi_config = {0};
     memset(&wifi_config, 0, sizeof(wifi_config_t));
-    memcpy(wifi_config.sta.ssid, EXAMPLE_ESP_WIFI_SSID, sizeof(EXAMPLE_ESP_WIFI_SSID));
-    memcpy(wifi_config.sta.password, EXAMPLE_ESP_WIFI_PASS, sizeof(EXAMPLE_ESP_WIFI_PASS));
+    memcpy(wifi_config.sta.ssid, config->ssid, strnlen(config->ssid, sizeof(wifi_config.sta.ssid)));
+    memcpy(wifi_config.sta.password, config->password, strnlen(config->password, sizeof(wifi_config.sta.password)));
+#ifdef CONFIG_WIFI_FAST_CONNECT
+    // with the channel set, the fast scan only probes that channel for that BSSID
+    s_fast = wifi_cache_valid(config);
+    if (s_fast)
+    {
+        wifi_config.sta.channel = s_cache.channel;
+        wifi_config.sta.bssid_set = true;
+        memcpy(wifi_config.sta.bssid, s_cache.bssid, sizeof(wifi_config.sta.bssid));
+        ESP_LOGI(TAG, "Joining " MACSTR " on channel %d", MAC2STR(s_cache.bssid), s_cache.channel);
+    }
+#endif
+#if defined(CONFIG_WIFI_STA_STATIC_IP) || defined(CONFIG_WIFI_STA_REUSE_LEASE)
+    wifi_set_sta_address();
+#endif
 
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config));
+    wifi_set_rate(ESP_IF_WIFI_STA, config);
 
     ESP_ERROR_CHECK(esp_wifi_start());
 
-    ESP_LOGI(TAG, "connect to ap SSID:%s password:%s", wifi_config.sta.ssid, wifi_config.sta.password);
-    
-    char buf[80];
-    sprintf(buf, "SSID:%s", wifi_config.sta.ssid);
-    sprintf(buf, "PASSWORD:%s", wifi_config.sta.password);
+    ESP_LOGI(TAG, "connect to ap SSID:%s", config->ssid);
+}
+
+/*
+ * Modem sleep delays every frame until the next beacon, so it is only
+ * allowed while nobody watches. An access point never sleeps.
+ */
+static bool wifi_streaming(en_fsm_state state)
+{
+    return state != WAIT_FOR_WAKEUP && state != WAIT_FOR_CONNECT;
+}
+
+static void wifi_state_changed(en_fsm_state state, en_fsm_state prev, app_event_type_t event, void *arg)
+{
+    bool streaming = wifi_streaming(state);
 
+    if (s_mode == NETWORK_MODE_STA && streaming != wifi_streaming(prev))
+    {
+        esp_wifi_set_ps(streaming && !s_force_ps ? WIFI_PS_NONE : WIFI_PS_MIN_MODEM);
+    }
 }
-#endif
 
-void app_wifi_init ()
+void app_wifi_set_power_save(bool force)
 {
+    s_force_ps = force;
+    // idle states sleep anyway, the next state change applies the rest
+    if (s_started && s_mode == NETWORK_MODE_STA && wifi_streaming(app_event_state()))
+    {
+        esp_wifi_set_ps(force ? WIFI_PS_MIN_MODEM : WIFI_PS_NONE);
+    }
+}
+
+void app_wifi_prepare()
+{
+    if (s_prepared) {
+        return;
+    }
+
     //Initialize NVS
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES) {
@@ -169,14 +312,31 @@ void app_wifi_init ()
       ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
-    
-#if EXAMPLE_ESP_WIFI_MODE_AP
-    ESP_LOGI(TAG, "ESP_WIFI_MODE_AP");
-    wifi_init_softap();
-#else
-    ESP_LOGI(TAG, "ESP_WIFI_MODE_STA");
-    wifi_init_sta();
-#endif /*EXAMPLE_ESP_WIFI_MODE_AP*/
 
+    g_wifi_event_group = xEventGroupCreate();
+    tcpip_adapter_init();
+    ESP_ERROR_CHECK(esp_event_loop_init(event_handler, NULL));
+    s_prepared = true;
 }
 
+void app_wifi_init ()
+{
+    network_config_t config;
+
+    app_wifi_prepare();
+    app_config_get_network(&config);
+    s_mode = config.mode;
+
+    if (config.mode == NETWORK_MODE_AP)
+    {
+        ESP_LOGI(TAG, "ESP_WIFI_MODE_AP");
+        wifi_init_softap(&config);
+    }
+    else
+    {
+        ESP_LOGI(TAG, "ESP_WIFI_MODE_STA");
+        wifi_init_sta(&config);
+    }
+    app_event_subscribe(wifi_state_changed, NULL);
+    s_started = true;
+}
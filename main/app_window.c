@@ -0,0 +1,230 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_camera.h"
+#include "app_window.h"
+#include "app_camera.h"
+#include "app_pipeline.h"
+
+#ifdef CONFIG_SENSOR_WINDOW
+
+static const char *TAG = "app_window";
+
+/* Driver SCCB access, the sensor_t of this driver has no register setter */
+extern int SCCB_Write(uint8_t slv_addr, uint8_t reg, uint8_t data);
+
+/* OV2640 DSP bank, sizes are in units of 4 pixels */
+#define OV2640_BANK_SEL     0xFF
+#define OV2640_BANK_DSP     0x00
+#define OV2640_R_BYPASS     0x05
+#define OV2640_HSIZE        0x51
+#define OV2640_VSIZE        0x52
+#define OV2640_XOFFL        0x53
+#define OV2640_YOFFL        0x54
+#define OV2640_VHYX         0x55
+#define OV2640_TEST         0x57
+#define OV2640_ZMOW         0x5A
+#define OV2640_ZMOH         0x5B
+#define OV2640_ZMHH         0x5C
+#define OV2640_RESET        0xE0
+
+/* DSP input in SVGA mode, CIF mode and below see the same field at half the size */
+#define WINDOW_FULL_W       800
+#define WINDOW_FULL_H       600
+
+/*
+ * Frames captured after a window change that may still show the old one:
+ * those in the pipeline, in the driver and the one being read out.
+ */
+#define WINDOW_SETTLE_FRAMES    (PIPELINE_DEPTH + CONFIG_CAMERA_FB_COUNT + 1)
+
+static bool s_active = false;           /* sensor in SVGA mode behind a window */
+static framesize_t s_frame_size;        /* size the frames keep meanwhile */
+static int s_x = 0;
+static int s_y = 0;
+static int s_w = WINDOW_FULL_W;
+static int s_h = WINDOW_FULL_H;
+static int s_lost = 0;
+static uint32_t s_settle_seq = 0;       /* first frame through the current window */
+static bool s_moved = false;
+static portMUX_TYPE s_window_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void window_settle(uint32_t seq)
+{
+    portENTER_CRITICAL(&s_window_mux);
+    s_settle_seq = seq + WINDOW_SETTLE_FRAMES;
+    s_moved = true;
+    portEXIT_CRITICAL(&s_window_mux);
+}
+
+static void window_full()
+{
+    s_active = false;
+    s_x = 0;
+    s_y = 0;
+    s_w = WINDOW_FULL_W;
+    s_h = WINDOW_FULL_H;
+}
+
+static int window_write(sensor_t *s, uint8_t reg, uint8_t value)
+{
+    return SCCB_Write(s->slv_addr, reg, value);
+}
+
+static void window_apply(sensor_t *s, int x, int y, int w, int h, uint32_t seq)
+{
+    size_t out_w, out_h;
+
+    if (!s_active)
+    {
+        // the driver sets up the sensor and the DSP input, the window goes on top
+        s_frame_size = s->status.framesize;
+        s->set_framesize(s, FRAMESIZE_SVGA);
+        s_active = true;
+    }
+    app_camera_get_resolution(s_frame_size, &out_w, &out_h);
+
+    int hsize = w / 4;
+    int vsize = h / 4;
+    int zmow = out_w / 4;
+    int zmoh = out_h / 4;
+    // the DSP is bypassed while it is set up, like the driver does for a frame size
+    window_write(s, OV2640_BANK_SEL, OV2640_BANK_DSP);
+    window_write(s, OV2640_R_BYPASS, 0x01);
+    window_write(s, OV2640_HSIZE, hsize & 0xFF);
+    window_write(s, OV2640_VSIZE, vsize & 0xFF);
+    window_write(s, OV2640_XOFFL, x & 0xFF);
+    window_write(s, OV2640_YOFFL, y & 0xFF);
+    window_write(s, OV2640_VHYX, ((vsize >> 1) & 0x80) | ((y >> 4) & 0x70) | ((hsize >> 5) & 0x08) | ((x >> 8) & 0x07));
+    window_write(s, OV2640_TEST, (hsize >> 2) & 0x80);
+    window_write(s, OV2640_ZMOW, zmow & 0xFF);
+    window_write(s, OV2640_ZMOH, zmoh & 0xFF);
+    window_write(s, OV2640_ZMHH, ((zmoh >> 6) & 0x04) | ((zmow >> 8) & 0x03));
+    window_write(s, OV2640_RESET, 0x00);
+    window_write(s, OV2640_R_BYPASS, 0x00);
+
+    s_x = x;
+    s_y = y;
+    s_w = w;
+    s_h = h;
+    window_settle(seq);
+    ESP_LOGD(TAG, "Window %dx%d at %d,%d", w, h, x, y);
+}
+
+static void window_restore(sensor_t *s, uint32_t seq)
+{
+    s->set_framesize(s, s_frame_size);
+    window_full();
+    window_settle(seq);
+    ESP_LOGD(TAG, "Full frame");
+}
+
+static inline int window_clamp(int v, int min, int max)
+{
+    return v < min ? min : (v > max ? max : v);
+}
+
+void app_window_update(uint32_t seq, const box_array_t *faces, int width, int height)
+{
+    sensor_t *s = esp_camera_sensor_get();
+
+    if (!s || s->id.PID != OV2640_PID || (int32_t)(seq - s_settle_seq) < 0)
+    {
+        // the boxes of a frame read out through the previous window do not fit this one
+        return;
+    }
+    if (s_active && s->status.framesize != FRAMESIZE_SVGA)
+    {
+        // the frame size was changed over /config or by the rate controller
+        window_full();
+    }
+    if (!faces || faces->len == 0)
+    {
+        if (s_active && ++s_lost >= CONFIG_SENSOR_WINDOW_LOST_FRAMES)
+        {
+            window_restore(s, seq);
+        }
+        return;
+    }
+    s_lost = 0;
+    // frames of SVGA and larger are read out in a mode the window gains nothing in
+    if (!s_active && s->status.framesize > FRAMESIZE_CIF)
+    {
+        return;
+    }
+
+    // all faces in sensor pixels
+    float sx = (float)s_w / width;
+    float sy = (float)s_h / height;
+    float x0 = width, y0 = height, x1 = 0, y1 = 0;
+    for (int i = 0; i < faces->len; i++)
+    {
+        const box_t *box = &faces->box[i];
+        x0 = box->box_p[0] < x0 ? box->box_p[0] : x0;
+        y0 = box->box_p[1] < y0 ? box->box_p[1] : y0;
+        x1 = box->box_p[2] > x1 ? box->box_p[2] : x1;
+        y1 = box->box_p[3] > y1 ? box->box_p[3] : y1;
+    }
+    x0 = s_x + x0 * sx;
+    x1 = s_x + x1 * sx;
+    y0 = s_y + y0 * sy;
+    y1 = s_y + y1 * sy;
+
+    // the window keeps the aspect of the frame, and is never smaller than it
+    size_t out_w, out_h;
+    app_camera_get_resolution(s_active ? s_frame_size : s->status.framesize, &out_w, &out_h);
+    float side = x1 - x0 > (y1 - y0) * out_w / out_h ? x1 - x0 : (y1 - y0) * out_w / out_h;
+    int w = window_clamp((int)(side * CONFIG_SENSOR_WINDOW_MARGIN / 100), out_w, WINDOW_FULL_W) & ~7;
+    int h = (w * out_h / out_w) & ~3;
+    int x = window_clamp((int)((x0 + x1) / 2) - w / 2, 0, WINDOW_FULL_W - w) & ~1;
+    int y = window_clamp((int)((y0 + y1) / 2) - h / 2, 0, WINDOW_FULL_H - h) & ~1;
+
+    // each move costs a few frames, the window stays while the faces are well inside it
+    int margin = s_w / 8;
+    if (x0 >= s_x + margin && x1 <= s_x + s_w - margin && y0 >= s_y + margin && y1 <= s_y + s_h - margin
+    && w * 4 >= s_w * 3 && w * 3 <= s_w * 4)
+    {
+        return;
+    }
+    if (w == WINDOW_FULL_W && !s_active)
+    {
+        return;
+    }
+    window_apply(s, x, y, w, h, seq);
+}
+
+bool app_window_moved(uint32_t seq)
+{
+    bool moved = false;
+
+    portENTER_CRITICAL(&s_window_mux);
+    if (s_moved && (int32_t)(seq - s_settle_seq) >= 0)
+    {
+        s_moved = false;
+        moved = true;
+    }
+    portEXIT_CRITICAL(&s_window_mux);
+    return moved;
+}
+
+#endif
@@ -0,0 +1,674 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "lwip/sockets.h"
+#include "mbedtls/sha1.h"
+#include "mbedtls/base64.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "sdkconfig.h"
+#include "app_ws.h"
+#include "app_event.h"
+#include "app_config.h"
+#include "app_face_store.h"
+#include "app_stream.h"
+#include "app_tasks.h"
+#include "app_display.h"
+
+static const char *TAG = "app_ws";
+
+#define WS_HANDSHAKE_MAX        1024
+#define WS_HANDSHAKE_TIMEOUT_S  2
+#define WS_PAYLOAD_MAX          512
+#define WS_MSG_MAX              64
+#define WS_QUEUE_LEN            8
+#define WS_POLL_MS              50
+#define WS_METRICS_MIN_MS       100
+#define WS_GUID                 "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+#define WS_OP_CONTINUATION      0x0
+#define WS_OP_TEXT              0x1
+#define WS_OP_BINARY            0x2
+#define WS_OP_CLOSE             0x8
+#define WS_OP_PING              0x9
+#define WS_OP_PONG              0xA
+
+#define WS_CLOSE_UNSUPPORTED    1003
+#define WS_CLOSE_TOO_BIG        1009
+
+typedef struct {
+    int fd;
+    uint16_t metrics_ms;        /* 0 when not subscribed */
+    int64_t metrics_next;
+} ws_client_t;
+
+// queued by other tasks, only the ws task writes to the sockets
+typedef struct {
+    uint8_t len;
+    uint8_t data[WS_MSG_MAX];
+} ws_msg_t;
+
+static ws_client_t s_clients[WS_MAX_CLIENTS];
+static volatile int s_client_count = 0;
+static QueueHandle_t s_queue = NULL;
+static int s_last_faces = 0;
+
+static inline uint8_t *ws_put16(uint8_t *p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v;
+    return p + 2;
+}
+
+static inline uint8_t *ws_put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+    return p + 4;
+}
+
+static esp_err_t ws_recv_all(int fd, uint8_t *buf, size_t len)
+{
+    while (len > 0)
+    {
+        int ret = recv(fd, buf, len, 0);
+        if (ret <= 0)
+        {
+            return ESP_FAIL;
+        }
+        buf += ret;
+        len -= ret;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t ws_send(int fd, uint8_t opcode, const uint8_t *data, size_t len)
+{
+    uint8_t header[4];
+    size_t header_len = 2;
+
+    // server frames are never masked or fragmented
+    header[0] = 0x80 | opcode;
+    if (len < 126)
+    {
+        header[1] = len;
+    }
+    else
+    {
+        header[1] = 126;
+        ws_put16(header + 2, len);
+        header_len = 4;
+    }
+    struct iovec iov[2] = {
+        { .iov_base = header, .iov_len = header_len },
+        { .iov_base = (void *)data, .iov_len = len },
+    };
+    // a short write leaves a broken frame behind, the client is dropped then
+    return writev(fd, iov, len ? 2 : 1) == header_len + len ? ESP_OK : ESP_FAIL;
+}
+
+static void ws_send_close(int fd, uint16_t code)
+{
+    uint8_t payload[2];
+
+    ws_put16(payload, code);
+    ws_send(fd, WS_OP_CLOSE, payload, sizeof(payload));
+}
+
+static void ws_close(ws_client_t *client)
+{
+    ESP_LOGI(TAG, "Client %d left", client->fd);
+    close(client->fd);
+    client->fd = -1;
+    client->metrics_ms = 0;
+    s_client_count--;
+}
+
+static void ws_post(const uint8_t *data, size_t len)
+{
+    ws_msg_t msg;
+
+    if (s_client_count == 0 || len > WS_MSG_MAX)
+    {
+        return;
+    }
+    msg.len = len;
+    memcpy(msg.data, data, len);
+    // telemetry is best effort, the next message supersedes a lost one
+    xQueueSend(s_queue, &msg, 0);
+}
+
+static esp_err_t ws_send_result(ws_client_t *client, uint8_t cmd, esp_err_t err)
+{
+    uint8_t msg[6] = { WS_MSG_RESULT, cmd };
+
+    ws_put32(msg + 2, err);
+    return ws_send(client->fd, WS_OP_BINARY, msg, sizeof(msg));
+}
+
+static esp_err_t ws_send_metrics(ws_client_t *client)
+{
+    uint8_t msg[1 + 16 + 6];
+    uint8_t *p = msg;
+    pipeline_depths_t depths;
+
+    app_pipeline_get_depths(&depths);
+    *p++ = WS_MSG_METRICS;
+    p = ws_put32(p, esp_timer_get_time() / 1000);
+    p = ws_put32(p, heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+    p = ws_put32(p, heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+    p = ws_put32(p, app_pipeline_stale_frames());
+    *p++ = app_stream_client_count();
+    *p++ = app_event_state();
+    *p++ = depths.free;
+    *p++ = depths.detect;
+    *p++ = depths.encode;
+    *p++ = depths.send;
+    return ws_send(client->fd, WS_OP_BINARY, msg, p - msg);
+}
+
+#ifdef CONFIG_APP_RECOGNITION
+static bool ws_streaming()
+{
+    en_fsm_state state = app_event_state();
+
+    return state == START_DETECT || state == START_RECOGNITION;
+}
+#endif
+
+/* PackBits: n < 128 is followed by n + 1 bytes, n > 128 by one byte repeated 257 - n times */
+static int ws_unpack(const uint8_t *src, size_t len, uint8_t *dst, size_t size)
+{
+    size_t out = 0;
+
+    for (size_t i = 0; i < len; )
+    {
+        uint8_t n = src[i++];
+        if (n < 128)
+        {
+            if (i + n + 1 > len || out + n + 1 > size)
+            {
+                return -1;
+            }
+            memcpy(dst + out, src + i, n + 1);
+            i += n + 1;
+            out += n + 1;
+        }
+        else if (n > 128)
+        {
+            if (i >= len || out + 257 - n > size)
+            {
+                return -1;
+            }
+            memset(dst + out, src[i++], 257 - n);
+            out += 257 - n;
+        }
+    }
+    return out;
+}
+
+static esp_err_t ws_display_update(const uint8_t *p, size_t len)
+{
+    uint8_t columns[DISPLAY_WIDTH];
+
+    if (len < 1)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint8_t flags = *p++;
+    len--;
+    // updates before a bad one stay applied, the server sends the page again
+    while (len > 0)
+    {
+        if (len < 5)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        uint8_t page = p[0];
+        uint8_t x0 = p[1];
+        uint8_t x1 = p[2];
+        size_t packed = (p[3] << 8) | p[4];
+        p += 5;
+        len -= 5;
+        if (packed > len || x1 < x0)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        int count = ws_unpack(p, packed, columns, sizeof(columns));
+        if (count != x1 - x0 + 1)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        esp_err_t err = app_display_columns(page, x0, columns, count);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+        p += packed;
+        len -= packed;
+    }
+    if (flags & WS_DISPLAY_FLUSH)
+    {
+        app_display_flush(NULL, NULL);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t ws_handle_command(ws_client_t *client, uint8_t *payload, size_t len)
+{
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+    uint8_t cmd = payload[0];
+
+    switch (cmd)
+    {
+#ifdef CONFIG_APP_ENROLLMENT
+    case WS_CMD_ENROLL:
+        // the state machine ignores events that do not apply, say so instead
+        err = ws_streaming() ? ESP_OK : ESP_ERR_INVALID_STATE;
+        if (err == ESP_OK)
+        {
+            app_event_post(APP_EVENT_ENROLL);
+        }
+        break;
+#endif
+#ifdef CONFIG_APP_RECOGNITION
+    case WS_CMD_DELETE:
+        if (len != 3)
+        {
+            break;
+        }
+        uint16_t id = (payload[1] << 8) | payload[2];
+        if (id != WS_DELETE_OLDEST)
+        {
+            err = app_face_store_remove(id);
+            break;
+        }
+        err = ws_streaming() ? ESP_OK : ESP_ERR_INVALID_STATE;
+        if (err == ESP_OK)
+        {
+            app_event_post(APP_EVENT_DELETE);
+        }
+        break;
+#endif
+    case WS_CMD_CONFIG:
+        // the payload buffer has room for the terminator
+        payload[len] = 0;
+        err = app_config_from_json((const char *)payload + 1);
+        break;
+    case WS_CMD_METRICS:
+        if (len != 3)
+        {
+            break;
+        }
+        client->metrics_ms = (payload[1] << 8) | payload[2];
+        if (client->metrics_ms > 0 && client->metrics_ms < WS_METRICS_MIN_MS)
+        {
+            client->metrics_ms = WS_METRICS_MIN_MS;
+        }
+        client->metrics_next = esp_timer_get_time();
+        err = ESP_OK;
+        break;
+    case WS_CMD_DISPLAY:
+        err = ws_display_update(payload + 1, len - 1);
+        break;
+    default:
+        err = ESP_ERR_NOT_SUPPORTED;
+        break;
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Command 0x%02x failed: %s", cmd, esp_err_to_name(err));
+    }
+    return ws_send_result(client, cmd, err);
+}
+
+static esp_err_t ws_receive(ws_client_t *client)
+{
+    uint8_t header[2];
+    uint8_t mask[4];
+    uint8_t payload[WS_PAYLOAD_MAX + 1];
+    size_t len;
+
+    if (ws_recv_all(client->fd, header, sizeof(header)) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+    bool fin = header[0] & 0x80;
+    uint8_t opcode = header[0] & 0x0F;
+    len = header[1] & 0x7F;
+    // clients have to mask every frame
+    if (!(header[1] & 0x80))
+    {
+        return ESP_FAIL;
+    }
+    if (len == 126)
+    {
+        uint8_t ext[2];
+        if (ws_recv_all(client->fd, ext, sizeof(ext)) != ESP_OK)
+        {
+            return ESP_FAIL;
+        }
+        len = (ext[0] << 8) | ext[1];
+    }
+    else if (len == 127)
+    {
+        len = WS_PAYLOAD_MAX + 1;
+    }
+    if (len > WS_PAYLOAD_MAX)
+    {
+        ws_send_close(client->fd, WS_CLOSE_TOO_BIG);
+        return ESP_FAIL;
+    }
+    if (ws_recv_all(client->fd, mask, sizeof(mask)) != ESP_OK
+    || ws_recv_all(client->fd, payload, len) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+    for (size_t i = 0; i < len; i++)
+    {
+        payload[i] ^= mask[i & 3];
+    }
+
+    switch (opcode)
+    {
+    case WS_OP_BINARY:
+        // every command fits one frame
+        if (!fin || len == 0)
+        {
+            break;
+        }
+        return ws_handle_command(client, payload, len);
+    case WS_OP_PING:
+        return ws_send(client->fd, WS_OP_PONG, payload, len);
+    case WS_OP_PONG:
+        return ESP_OK;
+    case WS_OP_CLOSE:
+        ws_send(client->fd, WS_OP_CLOSE, payload, len < 2 ? len : 2);
+        return ESP_FAIL;
+    default:
+        break;
+    }
+    ws_send_close(client->fd, WS_CLOSE_UNSUPPORTED);
+    return ESP_FAIL;
+}
+
+// value of a request header, the name includes the leading "\r\n"
+static bool ws_header(const char *req, const char *name, char *value, size_t len)
+{
+    size_t name_len = strlen(name);
+
+    for (const char *line = strstr(req, "\r\n"); line; line = strstr(line + 2, "\r\n"))
+    {
+        if (strncasecmp(line, name, name_len))
+        {
+            continue;
+        }
+        const char *start = line + name_len;
+        while (*start == ' ')
+        {
+            start++;
+        }
+        const char *end = strstr(start, "\r\n");
+        size_t n = end ? end - start : strlen(start);
+        if (n >= len)
+        {
+            return false;
+        }
+        memcpy(value, start, n);
+        value[n] = 0;
+        return true;
+    }
+    return false;
+}
+
+static esp_err_t ws_handshake(int fd)
+{
+    char req[WS_HANDSHAKE_MAX + 1];
+    char res[160];
+    char key[32];
+    char upgrade[16];
+    uint8_t sha1[20];
+    uint8_t accept[32];
+    size_t accept_len = 0;
+    size_t len = 0;
+
+    req[0] = 0;
+    while (!strstr(req, "\r\n\r\n"))
+    {
+        if (len == WS_HANDSHAKE_MAX)
+        {
+            return ESP_FAIL;
+        }
+        int ret = recv(fd, req + len, WS_HANDSHAKE_MAX - len, 0);
+        if (ret <= 0)
+        {
+            return ESP_FAIL;
+        }
+        len += ret;
+        req[len] = 0;
+    }
+    if (strncmp(req, "GET ", 4)
+    || !ws_header(req, "\r\nUpgrade:", upgrade, sizeof(upgrade)) || strcasecmp(upgrade, "websocket")
+    || !ws_header(req, "\r\nSec-WebSocket-Key:", key, sizeof(key)))
+    {
+        static const char bad_request[] = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n";
+        send(fd, bad_request, sizeof(bad_request) - 1, 0);
+        return ESP_FAIL;
+    }
+
+    char digest_in[sizeof(key) + sizeof(WS_GUID)];
+    int n = snprintf(digest_in, sizeof(digest_in), "%s%s", key, WS_GUID);
+    mbedtls_sha1_ret((const unsigned char *)digest_in, n, sha1);
+    mbedtls_base64_encode(accept, sizeof(accept) - 1, &accept_len, sha1, sizeof(sha1));
+    accept[accept_len] = 0;
+
+    n = snprintf(res, sizeof(res), "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+            "Connection: Upgrade\r\nSec-WebSocket-Accept: %s\r\n\r\n", accept);
+    return send(fd, res, n, 0) == n ? ESP_OK : ESP_FAIL;
+}
+
+static void ws_accept(int listener)
+{
+    ws_client_t *client = NULL;
+
+    int fd = accept(listener, NULL, NULL);
+    if (fd < 0)
+    {
+        return;
+    }
+    for (int i = 0; i < WS_MAX_CLIENTS; i++)
+    {
+        if (s_clients[i].fd < 0)
+        {
+            client = &s_clients[i];
+            break;
+        }
+    }
+    if (!client)
+    {
+        static const char busy[] = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n";
+        send(fd, busy, sizeof(busy) - 1, 0);
+        close(fd);
+        return;
+    }
+
+    // also bounds the rest of a frame once select saw its first byte
+    struct timeval tv = { .tv_sec = WS_HANDSHAKE_TIMEOUT_S, .tv_usec = 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    int nodelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+    if (ws_handshake(fd) != ESP_OK)
+    {
+        close(fd);
+        return;
+    }
+    ESP_LOGI(TAG, "Client %d joined", fd);
+    client->fd = fd;
+    client->metrics_ms = 0;
+    s_client_count++;
+}
+
+static void ws_task(void *arg)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CONFIG_WS_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    ws_msg_t msg;
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, 1) != 0)
+    {
+        ESP_LOGE(TAG, "Could not listen on port %d", CONFIG_WS_PORT);
+        if (listener >= 0)
+        {
+            close(listener);
+        }
+        app_task_exit(APP_TASK_WS);
+    }
+    ESP_LOGI(TAG, "Listening on port %d", CONFIG_WS_PORT);
+
+    while (true)
+    {
+        fd_set fds;
+        int max_fd = listener;
+        struct timeval tv = { .tv_sec = 0, .tv_usec = WS_POLL_MS * 1000 };
+
+        FD_ZERO(&fds);
+        FD_SET(listener, &fds);
+        for (int i = 0; i < WS_MAX_CLIENTS; i++)
+        {
+            if (s_clients[i].fd >= 0)
+            {
+                FD_SET(s_clients[i].fd, &fds);
+                max_fd = s_clients[i].fd > max_fd ? s_clients[i].fd : max_fd;
+            }
+        }
+        if (select(max_fd + 1, &fds, NULL, NULL, &tv) > 0)
+        {
+            for (int i = 0; i < WS_MAX_CLIENTS; i++)
+            {
+                if (s_clients[i].fd >= 0 && FD_ISSET(s_clients[i].fd, &fds) && ws_receive(&s_clients[i]) != ESP_OK)
+                {
+                    ws_close(&s_clients[i]);
+                }
+            }
+            if (FD_ISSET(listener, &fds))
+            {
+                ws_accept(listener);
+            }
+        }
+
+        while (xQueueReceive(s_queue, &msg, 0) == pdTRUE)
+        {
+            for (int i = 0; i < WS_MAX_CLIENTS; i++)
+            {
+                if (s_clients[i].fd >= 0 && ws_send(s_clients[i].fd, WS_OP_BINARY, msg.data, msg.len) != ESP_OK)
+                {
+                    ws_close(&s_clients[i]);
+                }
+            }
+        }
+
+        int64_t now = esp_timer_get_time();
+        for (int i = 0; i < WS_MAX_CLIENTS; i++)
+        {
+            ws_client_t *client = &s_clients[i];
+            if (client->fd < 0 || client->metrics_ms == 0 || now < client->metrics_next)
+            {
+                continue;
+            }
+            client->metrics_next = now + client->metrics_ms * 1000LL;
+            if (ws_send_metrics(client) != ESP_OK)
+            {
+                ws_close(client);
+            }
+        }
+    }
+}
+
+static void ws_state_changed(en_fsm_state state, en_fsm_state prev, app_event_type_t event, void *arg)
+{
+    uint8_t msg[] = { WS_MSG_STATE, state, prev, event };
+
+    ws_post(msg, sizeof(msg));
+}
+
+void app_ws_publish_faces(const frame_desc_t *frame)
+{
+    uint8_t msg[6 + PIPELINE_MAX_FACES * 11];
+    uint8_t *p = msg;
+
+    if (s_client_count == 0 || frame->err != ESP_OK || (frame->face_count == 0 && s_last_faces == 0))
+    {
+        return;
+    }
+    s_last_faces = frame->face_count;
+
+    *p++ = WS_MSG_FACES;
+    p = ws_put32(p, frame->seq);
+    *p++ = frame->face_count;
+    for (int i = 0; i < frame->face_count; i++)
+    {
+        const box_t *box = &frame->face_boxes[i];
+        p = ws_put16(p, frame->face_ids[i]);
+        // cosine similarity can be negative, the percentage is clamped before the conversion
+        float similarity = frame->face_similarity[i];
+        *p++ = similarity <= 0 ? 0 : similarity >= 1 ? 100 : (uint8_t)(similarity * 100 + 0.5f);
+        for (int j = 0; j < 4; j++)
+        {
+            p = ws_put16(p, (int16_t)box->box_p[j]);
+        }
+    }
+    ws_post(msg, p - msg);
+}
+
+esp_err_t app_ws_init()
+{
+    for (int i = 0; i < WS_MAX_CLIENTS; i++)
+    {
+        s_clients[i].fd = -1;
+    }
+    s_queue = xQueueCreate(WS_QUEUE_LEN, sizeof(ws_msg_t));
+    if (!s_queue)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = app_event_subscribe(ws_state_changed, NULL);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    return app_task_create(APP_TASK_WS, &ws_task, NULL, NULL);
+}
@@ -0,0 +1,135 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_spi_flash.h"
+#include "app_www.h"
+
+static const char *TAG = "app_www";
+
+#define WWW_PARTITION_NAME  "www"
+#define WWW_PARTITION_TYPE  0x40
+#define WWW_MAGIC           0x31575757  /* "WWW1" */
+
+typedef struct {
+    uint32_t magic;
+    uint32_t count;
+} www_header_t;
+
+/* Layout written by www/mkwww.py */
+typedef struct {
+    char path[32];          /* URI, / for index.html */
+    char type[32];          /* Content-Type */
+    uint32_t offset;        /* gzip data from the start of the image */
+    uint32_t length;
+    uint32_t crc;           /* CRC32 of the gzip data, the ETag */
+    uint32_t max_age;       /* 0 to revalidate on every load */
+} www_file_t;
+
+static const uint8_t *s_map = NULL;
+static spi_flash_mmap_handle_t s_map_handle;
+static httpd_uri_t s_uris[WWW_MAX_FILES];
+
+static esp_err_t www_handler(httpd_req_t *req)
+{
+    const www_file_t *file = (const www_file_t *)req->user_ctx;
+    char etag[11];
+    char match[sizeof(etag)];
+    char cache[48];
+
+    // the headers are only read when the response is sent
+    snprintf(etag, sizeof(etag), "\"%08x\"", file->crc);
+    httpd_resp_set_hdr(req, "ETag", etag);
+    if (file->max_age)
+    {
+        // index.html asks for it with its ETag in the query, see mkwww.py
+        snprintf(cache, sizeof(cache), "public, max-age=%u, immutable", file->max_age);
+        httpd_resp_set_hdr(req, "Cache-Control", cache);
+    }
+    else
+    {
+        httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    }
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", match, sizeof(match)) == ESP_OK
+    && !strcmp(match, etag))
+    {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+    httpd_resp_set_type(req, file->type);
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    return httpd_resp_send(req, (const char *)s_map + file->offset, file->length);
+}
+
+static bool www_file_valid(const www_file_t *file, size_t size)
+{
+    return memchr(file->path, 0, sizeof(file->path)) && memchr(file->type, 0, sizeof(file->type))
+        && file->offset <= size && file->length <= size - file->offset;
+}
+
+esp_err_t app_www_init(httpd_handle_t server)
+{
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+            (esp_partition_subtype_t)WWW_PARTITION_TYPE, WWW_PARTITION_NAME);
+    if (!partition)
+    {
+        ESP_LOGW(TAG, "No " WWW_PARTITION_NAME " partition");
+        return ESP_ERR_NOT_FOUND;
+    }
+    esp_err_t err = esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA,
+            (const void **)&s_map, &s_map_handle);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    const www_header_t *header = (const www_header_t *)s_map;
+    const www_file_t *files = (const www_file_t *)(header + 1);
+    if (header->magic != WWW_MAGIC || header->count > WWW_MAX_FILES)
+    {
+        ESP_LOGW(TAG, "No web UI in the " WWW_PARTITION_NAME " partition, flash it with make flash");
+        spi_flash_munmap(s_map_handle);
+        s_map = NULL;
+        return ESP_ERR_NOT_FOUND;
+    }
+    for (int i = 0; i < header->count; i++)
+    {
+        if (!www_file_valid(&files[i], partition->size))
+        {
+            ESP_LOGE(TAG, "File %d of the web UI is broken", i);
+            continue;
+        }
+        s_uris[i].uri = files[i].path;
+        s_uris[i].method = HTTP_GET;
+        s_uris[i].handler = www_handler;
+        s_uris[i].user_ctx = (void *)&files[i];
+        err = httpd_register_uri_handler(server, &s_uris[i]);
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "%s not registered (0x%x)", files[i].path, err);
+        }
+    }
+    ESP_LOGI(TAG, "Web UI with %d files", header->count);
+    return ESP_OK;
+}
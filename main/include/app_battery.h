@@ -0,0 +1,68 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_BATTERY_H_
+#define _APP_BATTERY_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+/*
+ * Battery governor, see CONFIG_BATTERY_GOVERNOR. A task polls the IP5306 power
+ * bank chip on the display bus and trades speed for battery life in steps.
+ */
+typedef enum {
+    BATTERY_LEVEL_FULL,     /* charging or over half full, nothing is limited */
+    BATTERY_LEVEL_LOW,      /* detection halved, lower CPU clock, modem sleep */
+    BATTERY_LEVEL_CRITICAL, /* small frames, lowest CPU clock */
+    BATTERY_LEVEL_MAX,
+} battery_level_t;
+
+typedef struct {
+    bool valid;             /* the IP5306 answered the last poll */
+    bool charging;          /* input power is connected */
+    bool full;              /* charging is done */
+    uint8_t percent;        /* fuel gauge, in steps of 25 */
+    battery_level_t level;  /* what the governor applies */
+} battery_status_t;
+
+#ifdef CONFIG_BATTERY_GOVERNOR
+/**
+ * Starts the task polling the IP5306. The display must be set up, it
+ * installs the bus.
+ */
+esp_err_t app_battery_init();
+
+void app_battery_get(battery_status_t *status);
+
+const char *app_battery_level_name(battery_level_t level);
+#endif
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,103 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_BENCH_H_
+#define _APP_BENCH_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "app_pipeline.h"
+
+/* Lab tool for the face pipeline: replay of recorded frames with per stage timing */
+
+typedef struct {
+    uint32_t count;                 /* frames the stage ran on */
+    uint32_t mean_us;
+    uint32_t p50_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+} bench_stats_t;
+
+typedef struct {
+    uint32_t frames;                /* timed, at most CONFIG_BENCH_MAX_FRAMES */
+    uint32_t skipped;               /* too large, not decodable or larger than the frame pool */
+    uint32_t faces;                 /* summed over all frames */
+    bool truncated;                 /* the rest of the recording was not read */
+    size_t width;                   /* of the last frame timed */
+    size_t height;
+    bench_stats_t stages[BENCH_STAGE_MAX];
+    bench_stats_t total;            /* all stages of a frame */
+} bench_result_t;
+
+/**
+ * Fills buf with up to len bytes of the recording, returns the bytes read, 0 at the end and < 0 on error.
+ */
+typedef int (*bench_read_cb)(void *arg, void *buf, size_t len);
+
+/**
+ * Splits a recording into JPEGs at their start and end of image markers and runs
+ * each through app_pipeline_bench_frame. Concatenated JPEGs and a saved
+ * multipart /stream response both work, anything between the images is skipped.
+ * Returns ESP_ERR_INVALID_STATE when the pipeline runs.
+ */
+esp_err_t app_bench_run(bench_read_cb read, void *arg, bench_result_t *result);
+
+/**
+ * Bench result as a JSON object, free the string after use.
+ */
+char *app_bench_to_json(const bench_result_t *result);
+
+typedef enum {
+    BENCH_KERNEL_RGB565_TO_BGR,     /* VGA */
+    BENCH_KERNEL_BGR_TO_LUMA,       /* VGA */
+    BENCH_KERNEL_RESIZE_BILINEAR,   /* VGA RGB565 to QVGA BGR888, a detector input */
+    BENCH_KERNEL_RESIZE_AREA,       /* VGA RGB565 to 128x96 luma, a thumbnail */
+    BENCH_KERNEL_CROP,              /* 200x200 of VGA BGR888 to 56x56, a face crop */
+    BENCH_KERNEL_ROTATE_90,         /* VGA RGB565 */
+    BENCH_KERNEL_FLIP_H,            /* VGA BGR888 */
+    BENCH_KERNEL_MAX
+} bench_kernel_t;
+
+typedef struct {
+    uint32_t pixels;                /* written per run */
+    bench_stats_t stats;
+} bench_kernel_result_t;
+
+/**
+ * Times every image kernel on synthetic frames in PSRAM, CONFIG_BENCH_KERNEL_RUNS times each.
+ */
+esp_err_t app_bench_kernels(bench_kernel_result_t results[BENCH_KERNEL_MAX]);
+
+/**
+ * Kernel timings as a JSON object, free the string after use.
+ */
+char *app_bench_kernels_to_json(const bench_kernel_result_t results[BENCH_KERNEL_MAX]);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,80 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_BOOT_H_
+#define _APP_BOOT_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Boot phases timed with esp_timer_get_time(). Phases run in other tasks
+ * with CONFIG_WARM_START, so they can overlap.
+ */
+typedef enum {
+    BOOT_PHASE_APP_MAIN,    /* checkpoint, app_main entered */
+    BOOT_PHASE_POWER,
+    BOOT_PHASE_OLED,        /* splash drawn by mssd1306_init */
+    BOOT_PHASE_DISPLAY,     /* display task and camera preview */
+    BOOT_PHASE_CONFIG,      /* NVS settings */
+    BOOT_PHASE_SPEECH,      /* wake word model and tasks */
+    BOOT_PHASE_PIR,
+    BOOT_PHASE_WAKE_WAIT,   /* until the wake word or the PIR */
+    BOOT_PHASE_WIFI,
+    BOOT_PHASE_WIFI_IP,     /* checkpoint, station got its address */
+    BOOT_PHASE_CAMERA,
+    BOOT_PHASE_HTTPSERVER,  /* includes the pipeline and the face DB */
+    BOOT_PHASE_FACE_DB,     /* face store scan, or conversion from read_face_id_from_flash */
+    BOOT_PHASE_FIRST_FRAME, /* checkpoint, first frame handed to viewers */
+    BOOT_PHASE_CAPTURE,     /* time-lapse shot, after the sensor settled */
+    BOOT_PHASE_UPLOAD,      /* time-lapse shot, including the wait for an address */
+    BOOT_PHASE_MAX,
+} boot_phase_t;
+
+void app_boot_begin(boot_phase_t phase);
+
+void app_boot_end(boot_phase_t phase);
+
+/**
+ * Records a checkpoint, only the first call for a phase counts.
+ */
+void app_boot_mark(boot_phase_t phase);
+
+const char *app_boot_phase_name(boot_phase_t phase);
+
+/**
+ * Times of a phase since the timer started, false if it has not ended yet.
+ */
+bool app_boot_get(boot_phase_t phase, int64_t *start_us, int64_t *end_us);
+
+/**
+ * Logs the phases recorded so far, only the first call logs.
+ */
+void app_boot_report();
+
+#if __cplusplus
+}
+#endif
+#endif
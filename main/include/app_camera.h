@@ -24,6 +24,7 @@
 #ifndef _APP_CAMERA_H_
 #define _APP_CAMERA_H_
 
+#include <stdbool.h>
 #include "esp_log.h"
 #include "esp_system.h"
 #include "esp_camera.h"
@@ -35,7 +36,13 @@
  * PIXFORMAT_JPEG,      // JPEG/COMPRESSED
  * PIXFORMAT_RGB888,    // 3BPP/RGB888
  */
+#ifdef CONFIG_CAMERA_GRAYSCALE
+#define CAMERA_PIXEL_FORMAT PIXFORMAT_GRAYSCALE
+#elif defined(CONFIG_CAMERA_RGB565)
+#define CAMERA_PIXEL_FORMAT PIXFORMAT_RGB565
+#else
 #define CAMERA_PIXEL_FORMAT PIXFORMAT_JPEG
+#endif
 
 /*
  * FRAMESIZE_QQVGA,    // 160x120
@@ -50,7 +57,11 @@
  * FRAMESIZE_SXGA,     // 1280x1024
  * FRAMESIZE_UXGA,     // 1600x1200
  */
+#if defined(CONFIG_CAMERA_FRAME_SIZE_VGA)
+#define CAMERA_FRAME_SIZE FRAMESIZE_VGA
+#else
 #define CAMERA_FRAME_SIZE FRAMESIZE_QVGA
+#endif
 
 #define PWDN_GPIO_NUM    -1
 #define RESET_GPIO_NUM   -1
@@ -70,8 +81,103 @@
 #define HREF_GPIO_NUM     27
 #define PCLK_GPIO_NUM     25
 
+/* XCLK of frame sizes without a tuned clock, see CONFIG_CAMERA_TUNE */
 #define XCLK_FREQ       20000000
 
+/**
+ * Sensor settings that can be changed while the camera runs.
+ */
+typedef struct {
+    framesize_t frame_size;
+    pixformat_t pixel_format;   /* JPEG, GRAYSCALE or RGB565 */
+    int quality;                /* JPEG quality 0-63, lower is better */
+    bool gain_ctrl;             /* automatic gain */
+    int agc_gain;               /* manual gain 0-30 */
+    bool exposure_ctrl;         /* automatic exposure */
+    int aec_value;              /* manual exposure 0-1200 */
+} camera_settings_t;
+
 void app_camera_init();
 
+/**
+ * Output size of the sensor for the given frame size.
+ */
+void app_camera_get_resolution(framesize_t frame_size, size_t *width, size_t *height);
+
+/**
+ * Frame size, pixel format and JPEG quality currently set.
+ */
+framesize_t app_camera_frame_size();
+pixformat_t app_camera_pixel_format();
+int app_camera_quality();
+
+void app_camera_get_settings(camera_settings_t *settings);
+
+/**
+ * Returns true when the settings need the driver to be restarted:
+ * another pixel format, or a frame larger than its buffers were allocated for.
+ */
+bool app_camera_needs_restart(const camera_settings_t *settings);
+
+/**
+ * Applies the settings, restarting the driver when needed. No frame buffer
+ * may be held across a restart, see app_pipeline_set_camera.
+ */
+esp_err_t app_camera_apply(const camera_settings_t *settings);
+
+/**
+ * Current settings as JSON, to be freed by the caller.
+ */
+char *app_camera_to_json();
+
+/**
+ * Overlays the members found in the JSON onto settings and validates them.
+ */
+esp_err_t app_camera_from_json(const char *json, camera_settings_t *settings);
+
+/**
+ * XCLK the driver runs at.
+ */
+uint32_t app_camera_xclk_hz();
+
+/**
+ * Starts the driver again with the same config and sensor settings, after
+ * the sensor or the DMA stalled. No frame buffer may be held, as for a restart
+ * by app_camera_apply.
+ */
+esp_err_t app_camera_recover();
+
+#ifdef CONFIG_CAMERA_TUNE
+/* XCLK frequencies tried, from slow to fast */
+#define CAMERA_TUNE_STEPS   6
+
+typedef struct {
+    uint32_t xclk_hz;
+    int frames;
+    int lost;               /* capture timeouts and JPEGs cut short by a DMA overflow */
+    float fps;
+    uint32_t kbps;          /* written into PSRAM by the DMA */
+} camera_tune_step_t;
+
+typedef struct {
+    framesize_t frame_size;
+    int steps;
+    int best;               /* step kept, -1 when none ran without loss */
+    camera_tune_step_t step[CAMERA_TUNE_STEPS];
+} camera_tune_t;
+
+/**
+ * Runs the sensor at each XCLK for a moment and keeps the fastest one that
+ * lost no frame for the current frame size, saved to NVS. app_camera_init
+ * and restarts for that frame size use it from then on. Takes a few seconds
+ * per step, no frame buffer may be held meanwhile, see app_pipeline_tune_camera.
+ */
+esp_err_t app_camera_tune(camera_tune_t *result);
+
+/**
+ * Steps of a tune as JSON, to be freed by the caller.
+ */
+char *app_camera_tune_to_json(const camera_tune_t *result);
+#endif
+
 #endif
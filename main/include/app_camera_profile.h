@@ -0,0 +1,80 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _APP_CAMERA_PROFILE_H_
+#define _APP_CAMERA_PROFILE_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+
+/*
+ * Camera profiles of CONFIG_CAMERA_PROFILES. The pipeline starts active and
+ * drops to idle watch after CONFIG_CAMERA_IDLE_AFTER_S without motion, PIR or
+ * faces. Idle watch captures CAMERA_IDLE_FRAME_SIZE frames at
+ * CONFIG_CAMERA_IDLE_FPS for the motion gate, and the first activity switches
+ * back. The pixel format stays, so a switch is a frame size write to the
+ * sensor: the frame pools and the driver buffers are sized for the active
+ * frame size and hold the idle frames as they are.
+ */
+
+#define CAMERA_IDLE_FRAME_SIZE  FRAMESIZE_QQVGA
+
+typedef enum {
+    CAMERA_PROFILE_ACTIVE,      /* camera frame size at full rate */
+    CAMERA_PROFILE_IDLE,        /* small frames at a few per second */
+    CAMERA_PROFILE_MAX,
+} camera_profile_t;
+
+/**
+ * Subscribes to the PIR sensor, which switches to active at once.
+ */
+esp_err_t app_camera_profile_init();
+
+/**
+ * Back to active, called when the pipeline starts.
+ */
+void app_camera_profile_reset();
+
+/**
+ * Feeds the profile with a frame of the detect stage, activity is true when
+ * the motion gate let it through or faces were found.
+ */
+void app_camera_profile_update(bool activity);
+
+/**
+ * Called by the capture stage before each frame. Waits out the idle frame
+ * period, or until activity switches to active.
+ */
+void app_camera_profile_throttle();
+
+camera_profile_t app_camera_profile();
+const char *app_camera_profile_name(camera_profile_t profile);
+
+#if __cplusplus
+}
+#endif
+#endif
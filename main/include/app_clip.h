@@ -0,0 +1,67 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_CLIP_H_
+#define _APP_CLIP_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+
+/**
+ * Called for consecutive pieces of the clip, a failure ends the transfer.
+ */
+typedef esp_err_t (*clip_write_cb)(void *arg, const uint8_t *data, size_t len);
+
+/**
+ * Allocates the PSRAM ring, or reserves it in himem with CONFIG_CLIP_HIMEM,
+ * and records PIR edges as triggers.
+ */
+esp_err_t app_clip_init();
+
+/**
+ * Copies a sensor JPEG into the ring, at most CONFIG_CLIP_FPS of them a second.
+ * Never blocks, frames are skipped while a finished clip waits to be fetched.
+ * With CONFIG_CLIP_HIMEM the copy may wait for a piece of a clip being sent.
+ */
+void app_clip_add_frame(const camera_fb_t *fb);
+
+/**
+ * Keeps CONFIG_CLIP_PRE_S before and CONFIG_CLIP_POST_S after now as a clip.
+ * Ignored while a clip is being recorded or waits to be fetched.
+ */
+void app_clip_trigger(const char *reason);
+
+/**
+ * Passes the finished clip to write as an MJPEG AVI, then recording starts over.
+ * Returns ESP_ERR_NOT_FOUND when there is no finished clip.
+ */
+esp_err_t app_clip_send(clip_write_cb write, void *arg);
+
+#if __cplusplus
+}
+#endif
+#endif
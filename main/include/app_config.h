@@ -0,0 +1,110 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_CONFIG_H_
+#define _APP_CONFIG_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "fd_forward.h"
+
+#define APP_NVS_NAMESPACE    "who"
+
+#define SPEECH_MODEL_NAME_MAX   24
+
+/* Wake word settings, read once at boot */
+typedef struct {
+    char model[SPEECH_MODEL_NAME_MAX];  /* one of the models linked in, see app_speech_model_name */
+    int det_mode;                       /* 90 or 95, as DET_MODE_90 and DET_MODE_95 */
+} speech_config_t;
+
+#define NETWORK_SSID_MAX        33
+#define NETWORK_PASSWORD_MAX    65
+
+typedef enum {
+    NETWORK_MODE_AP,        /* own network, the camera is at CONFIG_SERVER_IP */
+    NETWORK_MODE_STA,       /* joins an existing network, address by DHCP */
+} network_mode_t;
+
+/* WiFi settings, read once at boot */
+typedef struct {
+    network_mode_t mode;
+    char ssid[NETWORK_SSID_MAX];            /* empty in AP mode for esp-eye-XXXX */
+    char password[NETWORK_PASSWORD_MAX];    /* empty for an open network, otherwise 8 characters or more */
+    bool ht40;                              /* 40 MHz channel, twice the 802.11n rate where the band is clear */
+} network_config_t;
+
+/**
+ * Loads the settings saved in NVS, falling back to the library defaults.
+ * NVS must be initialized. Called at boot, before the wake word model is created.
+ */
+esp_err_t app_config_init();
+
+/**
+ * Copies the current MTMN cascade settings.
+ * Returns a generation number that changes with every update.
+ */
+uint32_t app_config_get_mtmn(mtmn_config_t *config);
+
+/**
+ * Validates, applies and saves new MTMN cascade settings.
+ */
+esp_err_t app_config_set_mtmn(const mtmn_config_t *config);
+
+/**
+ * Copies the wake word settings.
+ */
+void app_config_get_speech(speech_config_t *config);
+
+/**
+ * Validates and saves new wake word settings, they take effect after a reboot.
+ */
+esp_err_t app_config_set_speech(const speech_config_t *config);
+
+/**
+ * Copies the WiFi settings.
+ */
+void app_config_get_network(network_config_t *config);
+
+/**
+ * Validates and saves new WiFi settings, they take effect after a reboot.
+ */
+esp_err_t app_config_set_network(const network_config_t *config);
+
+/**
+ * Settings as a JSON object without the WiFi password, free the string after use.
+ */
+char *app_config_to_json();
+
+/**
+ * Applies the fields present in a JSON object, the others keep their value.
+ * Returns ESP_ERR_INVALID_ARG for malformed JSON or out of range values.
+ */
+esp_err_t app_config_from_json(const char *json);
+
+#if __cplusplus
+}
+#endif
+#endif
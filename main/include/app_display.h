@@ -0,0 +1,109 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_DISPLAY_H_
+#define _APP_DISPLAY_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/i2c.h"
+#include "nano_gfx_types.h"
+
+/* bus the ssd1306 library puts the panel on, the IP5306 shares it */
+#define DISPLAY_I2C_NUM         I2C_NUM_1
+
+#define DISPLAY_WIDTH           128
+#define DISPLAY_HEIGHT          64
+#define DISPLAY_PAGES           (DISPLAY_HEIGHT / 8)
+
+/* Longest text of app_display_printf, with the terminator, 21 chars fill a line at 1x */
+#define DISPLAY_TEXT_MAX        32
+
+/* Flush callbacks waiting at a time */
+#define DISPLAY_MAX_WAITERS     4
+
+/* Chars of the ascii font pre-scaled for status text, drawn in normal style at double size */
+#define DISPLAY_ATLAS_FIRST     32
+#define DISPLAY_ATLAS_COUNT     96
+
+/**
+ * Called from the display task once everything drawn before app_display_flush is on the panel.
+ */
+typedef void (*display_done_cb_t)(void *arg);
+
+/**
+ * Starts the task that sends the frame buffer to the panel. The panel must be
+ * set up by the ssd1306 library before, afterwards only the task talks to it.
+ * The font set then is scaled in advance for FONT_SIZE_2X text.
+ * Without CONFIG_APP_DISPLAY no task is started and everything drawn is dropped.
+ */
+esp_err_t app_display_init();
+
+/*
+ * Drawing only touches the frame buffer in RAM and never waits for the bus.
+ */
+void app_display_clear();
+
+/**
+ * Draws text in the font set with ssd1306_setFixedFont, clipped at the right edge.
+ */
+void app_display_text(uint8_t x, uint8_t y, const char *text, EFontStyle style, EFontSize size);
+
+/**
+ * Formats text on the stack, cut at DISPLAY_TEXT_MAX - 1 chars, and draws it
+ * like app_display_text. No heap is used unless the format converts floats.
+ */
+void app_display_printf(uint8_t x, uint8_t y, EFontStyle style, EFontSize size, const char *format, ...)
+    __attribute__ ((format (printf, 5, 6)));
+
+/**
+ * Replaces the frame buffer with a page-layout image, a byte a column of 8
+ * pixels. Only the pages that differ from what is drawn are sent on the next flush.
+ */
+void app_display_image(const uint8_t image[DISPLAY_PAGES][DISPLAY_WIDTH]);
+
+/**
+ * Replaces len columns of a page from x on, a byte a column of 8 pixels.
+ * Returns ESP_ERR_INVALID_ARG when they do not fit the panel.
+ */
+esp_err_t app_display_columns(uint8_t page, uint8_t x, const uint8_t *data, size_t len);
+
+/**
+ * Has the pages drawn since the last flush sent in the background. Returns
+ * ESP_ERR_NO_MEM when DISPLAY_MAX_WAITERS callbacks are pending, the pages are
+ * sent anyway.
+ */
+esp_err_t app_display_flush(display_done_cb_t done, void *arg);
+
+/**
+ * Runs fn with the panel to itself, the display task waits meanwhile. The frame
+ * buffer is sent in full afterwards, over whatever fn left on the panel.
+ */
+void app_display_run(void (*fn)(void *arg), void *arg);
+
+#if __cplusplus
+}
+#endif
+#endif
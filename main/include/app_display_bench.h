@@ -0,0 +1,77 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_DISPLAY_BENCH_H_
+#define _APP_DISPLAY_BENCH_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/* Lab tool for the panel: times the ssd1306 library calls the app and the HAL changes depend on */
+
+/* Runs of every operation */
+#define DISPLAY_BENCH_RUNS      20
+
+typedef enum {
+    DISPLAY_BENCH_CLEAR,            /* ssd1306_clearScreen */
+    DISPLAY_BENCH_PRINT,            /* ssd1306_printFixed, a line of 6x8 chars */
+    DISPLAY_BENCH_PRINT_2X,         /* ssd1306_printFixedN at FONT_SIZE_2X */
+    DISPLAY_BENCH_BITMAP,           /* ssd1306_drawBitmap, full screen */
+    DISPLAY_BENCH_CANVAS_FILL,      /* NanoCanvas1 fillRect, in RAM only */
+    DISPLAY_BENCH_CANVAS_BLT,       /* NanoCanvas1 blt, full screen */
+    DISPLAY_BENCH_TILER,            /* NanoEngine1 refresh and display, full screen */
+    DISPLAY_BENCH_MAX,
+} display_bench_op_t;
+
+typedef struct {
+    uint32_t mean_us;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t bytes;                 /* pixel data sent to the panel per run */
+    uint32_t bus_bytes;             /* per run with the commands, 0 without CONFIG_SSD1306_INTF_STATS_ENABLE */
+    uint32_t transactions;          /* per run, 0 without CONFIG_SSD1306_INTF_STATS_ENABLE */
+} display_bench_stats_t;
+
+typedef struct {
+    uint32_t clock_hz;              /* of the i2c bus */
+    display_bench_stats_t ops[DISPLAY_BENCH_MAX];
+} display_bench_result_t;
+
+/**
+ * Sets the i2c bus to clock_hz and runs every operation DISPLAY_BENCH_RUNS
+ * times with the panel taken from the display task, see app_display_run.
+ * The bus goes back to CONFIG_OLED_I2C_CLOCK_HZ afterwards.
+ */
+esp_err_t app_display_bench_run(uint32_t clock_hz, display_bench_result_t *result);
+
+/**
+ * Results of several runs as a JSON object, free the string after use.
+ */
+char *app_display_bench_to_json(const display_bench_result_t *results, int count);
+
+#if __cplusplus
+}
+#endif
+#endif
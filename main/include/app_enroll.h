@@ -0,0 +1,83 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_ENROLL_H_
+#define _APP_ENROLL_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "freertos/FreeRTOS.h"
+#include "dl_lib_matrix3d.h"
+
+/* Completed enrollments stay on the stream overlay this long */
+#define ENROLL_SHOW_US      (2 * 1000000)
+
+typedef enum {
+    ENROLL_EVENT_NONE,
+    ENROLL_EVENT_SAMPLE,    /* another sample was taken */
+    ENROLL_EVENT_DONE,      /* the face was saved under id */
+    ENROLL_EVENT_FAILED,    /* the face store is full */
+} enroll_event_type_t;
+
+typedef struct {
+    enroll_event_type_t type;
+    int samples;
+    int id;
+    int64_t time;
+} enroll_event_t;
+
+esp_err_t app_enroll_init();
+
+/**
+ * Hands a copy of an aligned face to the enrollment task, never blocks.
+ * Returns false when the task is still busy or has all the samples it needs.
+ */
+bool app_enroll_submit(dl_matrix3du_t *aligned_face);
+
+/**
+ * Latest enrollment event, for the stream overlay.
+ */
+void app_enroll_get_status(enroll_event_t *status);
+
+/**
+ * Waits for the next enrollment event, for the display.
+ * Only the latest event is kept.
+ */
+bool app_enroll_get_event(enroll_event_t *event, TickType_t timeout);
+
+#ifdef CONFIG_ENROLL_UPLOAD
+/**
+ * Queues JPEGs, stored back to back in buf, to be enrolled as one face by a
+ * background task, and takes buf in any case. buf comes from
+ * app_mem_alloc(APP_MEM_ENROLL_UPLOAD, len). The face is named when name is
+ * not empty. Progress and the result show up as enrollment events. Returns
+ * ESP_ERR_INVALID_STATE while the last upload is still queued,
+ * ESP_ERR_INVALID_ARG when buf does not start with a whole JPEG.
+ */
+esp_err_t app_enroll_upload(uint8_t *buf, size_t len, const char *name);
+#endif
+
+#if __cplusplus
+}
+#endif
+#endif
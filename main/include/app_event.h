@@ -0,0 +1,117 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_EVENT_H_
+#define _APP_EVENT_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "esp_err.h"
+
+typedef enum
+{
+    WAIT_FOR_WAKEUP,
+    WAIT_FOR_CONNECT,
+    START_DETECT,
+    START_RECOGNITION,
+    START_ENROLL,
+    START_DELETE,
+} en_fsm_state;
+
+#define APP_STATE_MAX   (START_DELETE + 1)
+
+typedef enum {
+    APP_EVENT_WAKEUP,           /* wake word heard or PIR trigger */
+    APP_EVENT_VIEWER_FIRST,     /* the first viewer joined the stream */
+    APP_EVENT_VIEWER_LAST,      /* the last viewer left */
+    APP_EVENT_ENROLL,           /* button pressed once or voice command */
+    APP_EVENT_ENROLL_DONE,      /* the enrollment task saved the face or gave up */
+    APP_EVENT_DELETE,           /* button pressed twice or voice command, drops the oldest face */
+    APP_EVENT_MAX,
+} app_event_type_t;
+
+/* State bits, see app_state_wait */
+#define STATE_LISTEN_BIT    BIT0    /* audio goes to the wake word model, also while streaming with CONFIG_SPEECH_CONTINUOUS */
+#define STATE_WAKEUP_BIT    BIT1    /* the wake word was heard */
+
+#define APP_EVENT_MAX_SUBSCRIBERS   8
+
+/* Time spent in a state since app_event_init */
+typedef struct {
+    uint32_t entries;
+    int64_t total_us;       /* including the visit in progress */
+    int64_t max_us;         /* longest visit, including the one in progress */
+    int64_t last_us;        /* last finished visit */
+} app_state_stats_t;
+
+/**
+ * Called from the event task after every state change, in the order of subscription.
+ * Must not block for long, later subscribers and events wait.
+ */
+typedef void (*app_state_cb)(en_fsm_state state, en_fsm_state prev, app_event_type_t event, void *arg);
+
+/**
+ * Starts the task that runs the state machine, in WAIT_FOR_WAKEUP.
+ */
+esp_err_t app_event_init();
+
+/**
+ * Queues an event for the state machine, never blocks.
+ * Events that do not apply to the current state are ignored.
+ */
+void app_event_post(app_event_type_t type);
+
+void app_event_post_from_isr(app_event_type_t type, BaseType_t *woken);
+
+/**
+ * Returns ESP_ERR_NO_MEM when APP_EVENT_MAX_SUBSCRIBERS are registered already.
+ */
+esp_err_t app_event_subscribe(app_state_cb callback, void *arg);
+
+en_fsm_state app_event_state();
+
+const char *app_event_state_name(en_fsm_state state);
+
+void app_event_get_state_stats(en_fsm_state state, app_state_stats_t *stats);
+
+/**
+ * Returns how often the state machine went from one state to another.
+ */
+uint32_t app_event_transitions(en_fsm_state from, en_fsm_state to);
+
+/**
+ * Returns esp_timer_get_time() of the last state change.
+ */
+int64_t app_event_state_since();
+
+/**
+ * Waits until any of the STATE_*_BIT bits is set, returns the bits set.
+ */
+EventBits_t app_state_wait(EventBits_t bits, TickType_t timeout);
+
+#if __cplusplus
+}
+#endif
+#endif
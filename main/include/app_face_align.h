@@ -0,0 +1,51 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_FACE_ALIGN_H_
+#define _APP_FACE_ALIGN_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "esp_err.h"
+#include "dl_lib_matrix3d.h"
+#include "image_util.h"
+#include "sdkconfig.h"
+
+#ifdef CONFIG_FACE_ALIGN_FAST
+/**
+ * Aligns a face for recognition from its five landmarks, in place of
+ * align_face. The similarity transform that best maps them onto a reference
+ * face gives the warp, which samples a copy of the face region in internal
+ * RAM, so the image is only read row by row over that region.
+ *
+ * @param image BGR888 frame the landmarks were found on
+ * @param landmark eyes, nose and mouth corners of the face
+ * @param aligned FACE_WIDTH x FACE_HEIGHT output
+ */
+esp_err_t app_face_align(dl_matrix3du_t *image, const landmark_t *landmark, dl_matrix3du_t *aligned);
+#endif
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,54 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_FACE_CACHE_H_
+#define _APP_FACE_CACHE_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include "image_util.h"
+
+/**
+ * Forgets every cached face.
+ */
+void app_face_cache_reset();
+
+/**
+ * Looks for a face recognized recently whose box overlaps the given one.
+ * On a hit the entry follows the box and its ID and similarity are written out.
+ * Returns false when the face has to be recognized, including when
+ * the cached result is due for a refresh. That result is still written out,
+ * to be shown until the face was recognized again.
+ */
+bool app_face_cache_lookup(const box_t *box, int *id, float *similarity);
+
+/**
+ * Remembers the recognition result of a box, id is -1 for an unknown face.
+ */
+void app_face_cache_store(const box_t *box, int id, float similarity);
+
+#if __cplusplus
+}
+#endif
+#endif
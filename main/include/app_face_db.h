@@ -0,0 +1,127 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_FACE_DB_H_
+#define _APP_FACE_DB_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "esp_err.h"
+#include "fr_forward.h"
+
+/* Matches returned by a lookup */
+#define FACE_DB_TOP_K       3
+
+/* Longest face name, including the terminating 0 */
+#define FACE_NAME_MAX       32
+
+typedef struct {
+    int id;
+    float similarity;       /* cosine similarity, 1 for the same vector */
+} face_match_t;
+
+/**
+ * A stored embedding, unit length as int8 times scale.
+ * The vector and the name are not copied, they stay in the face store (flash)
+ * they were read from. The name is NULL for a face that has not been named.
+ */
+typedef struct {
+    int id;
+    float scale;
+    const int8_t *vec;
+    const char *name;
+} face_entry_t;
+
+esp_err_t app_face_db_init(int capacity);
+
+int app_face_db_count();
+
+/**
+ * Number of entries with a name.
+ */
+int app_face_db_named();
+
+/**
+ * Changes whenever an entry is added, removed or the database is cleared.
+ */
+uint32_t app_face_db_generation();
+
+/**
+ * Quantizes a get_face_id embedding to FACE_ID_SIZE int8 values, returns the scale.
+ */
+float app_face_db_quantize(dl_matrix3d_t *face_id, int8_t *vec);
+
+/**
+ * Adds an entry, or points an existing entry with the same id at a new copy of its vector.
+ */
+esp_err_t app_face_db_add(const face_entry_t *entry);
+
+/**
+ * Points an entry at other copies of the same vector and name, ESP_ERR_NOT_FOUND when it was removed.
+ */
+esp_err_t app_face_db_relocate(int id, const int8_t *vec, const char *name);
+
+/**
+ * Removes an entry in constant time, the last entry takes its place.
+ */
+esp_err_t app_face_db_remove(int id);
+
+void app_face_db_clear();
+
+/**
+ * Points an entry at a name kept by the caller.
+ */
+esp_err_t app_face_db_set_name(int id, const char *name);
+
+/**
+ * Copies the name of a face, an empty string when it has none.
+ */
+esp_err_t app_face_db_get_name(int id, char *name, size_t len);
+
+/**
+ * Copies the entry of a face, its vector and name stay where the entry points.
+ */
+esp_err_t app_face_db_get(int id, face_entry_t *entry);
+
+/**
+ * Copies up to max entries, returns how many were copied.
+ */
+int app_face_db_snapshot(face_entry_t *entries, int max);
+
+/**
+ * Compares an embedding against every stored one in a single pass, or with
+ * CONFIG_FACE_DB_INDEX against the entries of the clusters closest to it.
+ * Fills up to k matches, best first, and returns how many were found.
+ */
+int app_face_db_match(dl_matrix3d_t *face_id, face_match_t *matches, int k);
+
+/**
+ * Rebuilds the cluster index of CONFIG_FACE_DB_INDEX when the gallery is large enough
+ * and has grown or shrunk since the last build. Slow, meant for a background task.
+ */
+void app_face_db_reindex();
+
+#if __cplusplus
+}
+#endif
+#endif
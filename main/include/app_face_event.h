@@ -0,0 +1,49 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_FACE_EVENT_H_
+#define _APP_FACE_EVENT_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "esp_err.h"
+#include "app_pipeline.h"
+
+/**
+ * Opens the UDP socket face events are sent from, to CONFIG_FACE_EVENT_HOST
+ * or as a broadcast when it is empty.
+ */
+esp_err_t app_face_event_init();
+
+/**
+ * Sends the faces of a frame as one JSON datagram, called by the pipeline for
+ * every frame that went through detection, before it is encoded. Frames without
+ * faces are only sent once after the last face left. "frame" is the X-Seq of the
+ * frame in the stream.
+ */
+void app_face_event_publish(const frame_desc_t *frame);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,57 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_FACE_QUALITY_H_
+#define _APP_FACE_QUALITY_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "esp_err.h"
+#include "dl_lib_matrix3d.h"
+#include "image_util.h"
+
+esp_err_t app_face_quality_init();
+
+/**
+ * Scores an aligned face from 0 to 1. The product of its sharpness, from the
+ * variance of the Laplacian, the box size and how frontal the landmarks are.
+ */
+float app_face_quality_score(const dl_matrix3du_t *aligned_face, const box_t *box, const landmark_t *landmark);
+
+/**
+ * Keeps the best aligned face of a box over CONFIG_FACE_QUALITY_WINDOW_MS.
+ * Returns it once the window is over, NULL while the window is open or when
+ * no face in it scored CONFIG_FACE_QUALITY_MIN. The face returned stays valid
+ * until the next call for the same box.
+ */
+dl_matrix3du_t *app_face_quality_select(const box_t *box, float score, const dl_matrix3du_t *aligned_face);
+
+/**
+ * Forgets every box, for a new enrollment or recognition session.
+ */
+void app_face_quality_reset();
+
+#if __cplusplus
+}
+#endif
+#endif
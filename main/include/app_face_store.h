@@ -0,0 +1,178 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_FACE_STORE_H_
+#define _APP_FACE_STORE_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "esp_err.h"
+#include "fr_forward.h"
+
+/*
+ * Face registry export, to provision other cameras without enrolling again.
+ * All fields are little endian:
+ *
+ *   header      magic:u32 "WFX1" version:u16 vec_len:u16 name_len:u16
+ *               reserved:u16 count:u32
+ *   faces       count times id:i32 scale:f32 vec:i8[vec_len] name:char[name_len]
+ *
+ * vec times scale is the unit length embedding as quantized by
+ * app_face_db_quantize. Names are 0 padded, empty for unnamed faces.
+ */
+#define FACE_EXPORT_MAGIC       0x31584657
+#define FACE_EXPORT_VERSION     1
+
+/*
+ * Changes to the registry, to keep cameras in sync without a full export.
+ * Every record appended to the store takes the next change number, a delta
+ * holds the records after a given change in the order they were made:
+ *
+ *   header      magic:u32 "WFD1" version:u16 vec_len:u16 name_len:u16
+ *               reserved:u16 since:u32 last:u32 count:u32
+ *   changes     count times change:u32 op:u16 len:u16 id:i32 scale:f32 payload:u8[len]
+ *
+ * op is 1 for an enrolled face with vec:i8[vec_len] as payload, 2 for a
+ * removed face without payload and 3 for a name with name:char[name_len].
+ * Pull again from last for the next delta. Face IDs are the same on all
+ * cameras, so faces should be enrolled on one of them only.
+ */
+#define FACE_DELTA_MAGIC        0x31444657
+#define FACE_DELTA_VERSION      1
+
+typedef esp_err_t (*face_store_write_cb)(void *arg, const char *buf, size_t len);
+
+/**
+ * Maps the fr partition and indexes the stored faces into app_face_db.
+ * Faces saved by the esp-face flash functions are converted on the first boot.
+ */
+esp_err_t app_face_store_init();
+
+/**
+ * Number of faces the store can hold, limited by the fr partition and CONFIG_FACE_DB_CAPACITY.
+ * Faces take their room in the partition only once they are named, so each
+ * name set lowers the capacity by about a tenth of a face.
+ */
+int app_face_store_capacity();
+
+/**
+ * Queues a face embedding for saving and returns its new ID, -1 when the store is full.
+ * The face can be recognized once the background writer has appended it.
+ */
+int app_face_store_add(dl_matrix3d_t *face_id);
+
+/**
+ * Queues the removal of a face, it stops matching right away.
+ */
+esp_err_t app_face_store_remove(int id);
+
+/**
+ * Removes the face enrolled first, returns the number of faces left.
+ */
+int app_face_store_remove_oldest();
+
+/**
+ * Queues a new name for a face, an empty name removes it.
+ * Returns ESP_ERR_INVALID_ARG when the name is FACE_NAME_MAX long or longer,
+ * ESP_ERR_NO_MEM when the store is too full to name another face.
+ */
+esp_err_t app_face_store_set_name(int id, const char *name);
+
+/**
+ * Lists the stored faces as {"capacity":n,"faces":[{"id":n,"name":"..."}]}.
+ * The string has to be freed by the caller.
+ */
+char *app_face_store_to_json();
+
+/**
+ * Applies {"id":n,"name":"..."} or {"id":n,"delete":true}.
+ */
+esp_err_t app_face_store_from_json(const char *json);
+
+/**
+ * Passes all stored faces to write in the export format, a face per call.
+ */
+esp_err_t app_face_store_export(face_store_write_cb write, void *arg);
+
+/**
+ * Starts replacing all faces with an export, which is then passed in pieces of
+ * any size to app_face_store_import_write. The faces are written sector by
+ * sector into the unused bank as they arrive, nothing changes before
+ * app_face_store_import_end commits. Faces cannot be added, named or removed
+ * in the meantime. Returns ESP_ERR_INVALID_STATE while enrolled faces are
+ * still waiting to be written.
+ */
+esp_err_t app_face_store_import_begin();
+
+/**
+ * Returns ESP_ERR_INVALID_VERSION or ESP_ERR_INVALID_ARG for an export this
+ * store cannot read, ESP_ERR_INVALID_SIZE when it has more faces or names
+ * than fit or data past its last face.
+ */
+esp_err_t app_face_store_import_write(const uint8_t *data, size_t len);
+
+/**
+ * Switches to the imported faces when commit is set and the whole export was
+ * written, otherwise the current faces stay. Must follow a successful
+ * app_face_store_import_begin in any case.
+ */
+esp_err_t app_face_store_import_end(bool commit);
+
+/**
+ * Number of the last change made to the store, 0 before any.
+ */
+uint32_t app_face_store_last_change();
+
+/**
+ * Passes the changes after since to write in the delta format. Returns
+ * ESP_ERR_NOT_FOUND without writing anything when some of them were compacted
+ * away or since is ahead of the store, a full export is needed then.
+ */
+esp_err_t app_face_store_changes(uint32_t since, face_store_write_cb write, void *arg);
+
+/**
+ * Starts applying a delta, which is then passed in pieces of any size to
+ * app_face_store_apply_write. Each change is appended as a change of this
+ * store once it is complete. Changes the store already has, like its own
+ * coming back from a peer, are skipped, so a delta may be applied twice.
+ * Returns ESP_ERR_INVALID_STATE like app_face_store_import_begin.
+ */
+esp_err_t app_face_store_apply_begin();
+
+/**
+ * Returns ESP_ERR_INVALID_VERSION or ESP_ERR_INVALID_ARG for a delta this
+ * store cannot read, ESP_ERR_NO_MEM when an enrolled face or a name does not fit.
+ */
+esp_err_t app_face_store_apply_write(const uint8_t *data, size_t len);
+
+/**
+ * Must follow a successful app_face_store_apply_begin. The changes before an
+ * error stay applied, complete is clear when the delta broke off early.
+ * Returns ESP_ERR_INVALID_SIZE when complete is set but changes are missing.
+ */
+esp_err_t app_face_store_apply_end(bool complete);
+
+#if __cplusplus
+}
+#endif
+#endif
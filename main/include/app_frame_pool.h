@@ -0,0 +1,94 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_FRAME_POOL_H_
+#define _APP_FRAME_POOL_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "freertos/FreeRTOS.h"
+#include "dl_lib_matrix3d.h"
+#include "fd_forward.h"
+#include "app_camera.h"
+
+/**
+ * JPEG output buffer taken from the pool, filled by the encoder.
+ */
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t size;
+} frame_jpg_t;
+
+/**
+ * Preallocates count RGB888 matrices and count JPEG output buffers
+ * for the given frame size. Called once, before streaming starts.
+ */
+esp_err_t app_frame_pool_init(framesize_t frame_size, int count);
+
+/**
+ * Reallocates the pool for a larger frame size, smaller frames fit as they are.
+ * Every matrix and JPEG buffer must be back in the pool.
+ */
+esp_err_t app_frame_pool_resize(framesize_t frame_size);
+
+/**
+ * Takes a free RGB888 matrix of the pool frame size, NULL on timeout.
+ */
+dl_matrix3du_t *app_frame_pool_acquire(TickType_t timeout);
+
+void app_frame_pool_release(dl_matrix3du_t *matrix);
+
+/**
+ * Reshapes a pooled matrix to a frame of at most the pool frame size.
+ * Returns false when the frame does not fit.
+ */
+bool app_frame_pool_fit(dl_matrix3du_t *matrix, size_t width, size_t height);
+
+/**
+ * Takes a free JPEG output buffer, NULL on timeout.
+ */
+frame_jpg_t *app_frame_pool_acquire_jpg(TickType_t timeout);
+
+void app_frame_pool_release_jpg(frame_jpg_t *jpg);
+
+/**
+ * Encodes an RGB888 matrix into a pooled JPEG buffer without touching the heap.
+ */
+bool app_frame_pool_encode(dl_matrix3du_t *matrix, uint8_t quality, frame_jpg_t *jpg);
+
+/**
+ * Same as app_frame_pool_encode, with CONFIG_JPEG_ROI the area outside the
+ * face boxes is encoded at CONFIG_JPEG_ROI_BACKGROUND_QUALITY.
+ */
+bool app_frame_pool_encode_faces(dl_matrix3du_t *matrix, uint8_t quality, const box_t *boxes, int count, frame_jpg_t *jpg);
+
+/**
+ * Encodes a raw sensor frame (grayscale, RGB565) into a pooled JPEG buffer.
+ */
+bool app_frame_pool_encode_fb(camera_fb_t *fb, uint8_t quality, frame_jpg_t *jpg);
+
+#if __cplusplus
+}
+#endif
+#endif
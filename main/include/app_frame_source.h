@@ -0,0 +1,81 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _APP_FRAME_SOURCE_H_
+#define _APP_FRAME_SOURCE_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+
+/* Where the pipeline takes its frames from, see CONFIG_FRAME_SOURCE */
+typedef enum {
+    FRAME_SOURCE_CAMERA,
+    FRAME_SOURCE_COLORBAR,      /* the sensor's color bar test pattern, still JPEG from the driver */
+    FRAME_SOURCE_CORPUS,        /* JPEGs loaded with app_frame_source_load, in a loop */
+    FRAME_SOURCE_MAX,
+} frame_source_t;
+
+/**
+ * Next frame of the selected source, NULL when there is none.
+ * Called by the capture task in place of esp_camera_fb_get.
+ */
+camera_fb_t *app_frame_source_get();
+
+/**
+ * Gives a frame of app_frame_source_get back to the source it came from,
+ * also after the source was changed.
+ */
+void app_frame_source_return(camera_fb_t *fb);
+
+frame_source_t app_frame_source();
+const char *app_frame_source_name(frame_source_t source);
+
+/**
+ * Switches the source, the pipeline may run meanwhile.
+ * Returns ESP_ERR_INVALID_STATE for the corpus while none is loaded.
+ */
+esp_err_t app_frame_source_select(frame_source_t source);
+
+/**
+ * Takes concatenated JPEGs of up to CONFIG_FRAME_SOURCE_CORPUS_KB as the
+ * corpus, buf is allocated with app_mem_alloc(APP_MEM_FRAME_CORPUS) and owned
+ * by the corpus from now on, also when this fails. Returns
+ * ESP_ERR_INVALID_STATE while the corpus is selected or any of its frames
+ * is in the pipeline, and ESP_ERR_NOT_FOUND when buf holds no JPEG.
+ */
+esp_err_t app_frame_source_load(uint8_t *buf, size_t len);
+
+/**
+ * Selected source and corpus size as JSON, free the string after use.
+ */
+char *app_frame_source_to_json();
+
+#if __cplusplus
+}
+#endif
+#endif
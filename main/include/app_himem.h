@@ -0,0 +1,67 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _APP_HIMEM_H_
+#define _APP_HIMEM_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/*
+ * PSRAM above the first 4 MB, reached through the bank switching window of
+ * CONFIG_SPIRAM_BANKSWITCH_RESERVE. It is not part of any heap, data goes in
+ * and out by copy. A few 32 KB blocks stay mapped, so that sequential access
+ * only remaps once per block.
+ */
+
+typedef struct {
+    size_t size;                /* bytes of himem taken at the first reserve */
+    size_t reserved;            /* handed out by app_himem_reserve */
+    uint32_t hits;              /* block accesses that found the block mapped */
+    uint32_t misses;            /* block accesses that had to remap */
+} himem_stats_t;
+
+/**
+ * Hands out size bytes of the store as an offset for app_himem_read and
+ * app_himem_write. The first call takes all free himem. Returns
+ * ESP_ERR_NO_MEM when less than size is left, or there is no himem at all.
+ */
+esp_err_t app_himem_reserve(size_t size, size_t *offset);
+
+/**
+ * Copies len bytes at offset in and out of the store. Any task may call
+ * them, one copy runs at a time.
+ */
+esp_err_t app_himem_write(size_t offset, const void *data, size_t len);
+esp_err_t app_himem_read(size_t offset, void *data, size_t len);
+
+void app_himem_get_stats(himem_stats_t *stats);
+
+#if __cplusplus
+}
+#endif
+#endif
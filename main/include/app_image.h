@@ -0,0 +1,96 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_IMAGE_H_
+#define _APP_IMAGE_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "esp_camera.h"
+#include "dl_lib_matrix3d.h"
+#include "fd_forward.h"
+
+/**
+ * Starts the task that decodes the lower band of a frame for app_image_decode_full.
+ * Does nothing without CONFIG_JPEG_DECODE_DUAL_CORE.
+ */
+esp_err_t app_image_init();
+
+/**
+ * True for the frame formats app_image_decode_scaled can scale.
+ */
+bool app_image_can_scale(pixformat_t format);
+
+/**
+ * Decodes a JPEG frame, or expands a grayscale or RGB565 one, into a BGR888 matrix at
+ * 1/scale of its resolution. scale must be 1, 2, 4 or 8 and the matrix must be
+ * (width/scale)x(height/scale). Other formats only decode at scale 1.
+ */
+bool app_image_decode_scaled(camera_fb_t *fb, int scale, dl_matrix3du_t *image_matrix);
+
+/**
+ * Bytes of strip app_image_decode_strips needs for frames up to width pixels wide.
+ */
+size_t app_image_strip_len(size_t width, int scale);
+
+/**
+ * As app_image_decode_scaled, but a JPEG is decoded a row of MCUs at a time
+ * into strip, a small buffer in internal RAM, and each finished row goes into
+ * the matrix with one copy instead of one write per block line. Worth it when
+ * the matrix is in PSRAM. A NULL or too small strip writes the blocks straight
+ * into the matrix.
+ */
+bool app_image_decode_strips(camera_fb_t *fb, int scale, dl_matrix3du_t *image_matrix, uint8_t *strip, size_t strip_len);
+
+/**
+ * Converts a frame of any format to a BGR888 matrix of its size, as fmt2rgb888.
+ * With CONFIG_JPEG_DECODE_DUAL_CORE a JPEG with restart markers is cut in two
+ * bands at a restart interval, decoded on both cores at once.
+ */
+bool app_image_decode_full(camera_fb_t *fb, dl_matrix3du_t *image_matrix);
+
+/**
+ * Maps boxes and landmarks found on a 1/scale image back to full resolution.
+ */
+void app_image_scale_boxes(box_array_t *boxes, int scale);
+
+/**
+ * Resamples a square around a full resolution box, grown by half its size,
+ * into dst. src is the frame at 1/scale, the square is clipped to it.
+ */
+void app_image_crop(const dl_matrix3du_t *src, int scale, const box_t *box, dl_matrix3du_t *dst);
+
+/**
+ * Intersection over union of two boxes, 0 when they do not overlap.
+ */
+float app_image_box_iou(const box_t *a, const box_t *b);
+
+/**
+ * Reads the frame size from the start of frame segment of a JPEG.
+ */
+bool app_image_jpeg_size(const uint8_t *buf, size_t len, size_t *width, size_t *height);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,122 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_IMAGE_KERNEL_H_
+#define _APP_IMAGE_KERNEL_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+#include "dl_lib_matrix3d.h"
+
+/*
+ * Image kernels for the frame consumers: crops, resizes, color conversion,
+ * rotation and flips. Kernels stream rows, each source row is read once and
+ * in order, and converted into line buffers in internal RAM. Positions are
+ * 16.16 fixed point, no floats are used.
+ */
+
+typedef enum {
+    IMAGE_BGR888,           /* 3 bytes, blue first, as the detector and fb_gfx take it */
+    IMAGE_RGB565,           /* 2 bytes, high byte first, as the sensor sends it */
+    IMAGE_LUMA,             /* 1 byte */
+} image_format_t;
+
+typedef struct {
+    uint8_t *buf;
+    int width;
+    int height;
+    int stride;             /* bytes per row, 0 for rows without padding */
+    image_format_t format;
+} image_t;
+
+typedef struct {
+    int x;
+    int y;
+    int width;
+    int height;
+} image_rect_t;
+
+typedef enum {
+    IMAGE_RESIZE_BILINEAR,
+    IMAGE_RESIZE_AREA,      /* mean of the source pixels under each output pixel, bilinear when enlarging */
+} image_resize_t;
+
+typedef enum {
+    IMAGE_FLIP_H,
+    IMAGE_FLIP_V,
+    IMAGE_ROTATE_90,        /* clockwise */
+    IMAGE_ROTATE_180,
+    IMAGE_ROTATE_270,
+} image_transform_t;
+
+/**
+ * Bytes per pixel.
+ */
+int app_image_bpp(image_format_t format);
+
+/**
+ * Wraps a camera frame, false for formats the kernels do not take.
+ */
+bool app_image_from_fb(const camera_fb_t *fb, image_t *image);
+
+/**
+ * Wraps a BGR888 matrix.
+ */
+void app_image_from_matrix(dl_matrix3du_t *matrix, image_t *image);
+
+/**
+ * Converts src into the format of dst, both the same size.
+ */
+esp_err_t app_image_convert(const image_t *src, image_t *dst);
+
+/**
+ * Crops rect out of src, or takes all of it when rect is NULL, and resizes it
+ * to dst, converting to the format of dst on the way. A rect the size of dst
+ * is only copied.
+ */
+esp_err_t app_image_resize(const image_t *src, const image_rect_t *rect, image_t *dst, image_resize_t mode);
+
+/**
+ * Rotates or flips src into dst, both in the same format. dst has width and
+ * height swapped for quarter turns. src and dst must not overlap.
+ */
+esp_err_t app_image_transform(const image_t *src, image_t *dst, image_transform_t transform);
+
+/**
+ * Fills dst with src sampled under the affine map m, bilinear. The point x, y
+ * of dst is src at m[0] * x + m[1] * y + m[2], m[3] * x + m[4] * y + m[5],
+ * in 16.16 fixed point, where pixel i spans i to i + 1 and is sampled at its
+ * center. Positions off src take its edge.
+ * Both are BGR888. src is read at random, keep it in internal RAM.
+ */
+esp_err_t app_image_warp(const image_t *src, const int32_t m[6], image_t *dst);
+
+#if __cplusplus
+}
+#endif
+#endif
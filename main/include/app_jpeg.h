@@ -0,0 +1,132 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_JPEG_H_
+#define _APP_JPEG_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "dl_lib_matrix3d.h"
+#include "fd_forward.h"
+#include "app_frame_pool.h"
+
+/**
+ * Huffman codes of a table by symbol, size 0 when the symbol has none.
+ */
+typedef struct {
+    uint16_t code[256];
+    uint8_t size[256];
+} jpeg_huff_code_t;
+
+/**
+ * Entropy coded data output. Bytes past size are dropped and flag overflow.
+ */
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t size;
+    uint32_t acc;
+    int bits;
+    bool overflow;
+} jpeg_writer_t;
+
+#define JPEG_ROI_MAX    8
+
+/* zigzag position to natural position in the 8x8 block */
+extern const uint8_t app_jpeg_natural[64];
+
+/**
+ * Derives the codes from the 16 code length counts and the symbols of a DHT.
+ * Returns false for counts that do not form a prefix code.
+ */
+bool app_jpeg_huff_codes(jpeg_huff_code_t *t, const uint8_t *counts, const uint8_t *vals);
+
+static inline void app_jpeg_put_byte(jpeg_writer_t *w, uint8_t b)
+{
+    if (w->len < w->size)
+    {
+        w->buf[w->len++] = b;
+    }
+    else
+    {
+        w->overflow = true;
+    }
+}
+
+/* Appends the low n bits of code, n is 1 to 16 */
+static inline void app_jpeg_put_bits(jpeg_writer_t *w, uint32_t code, int n)
+{
+    w->acc = (w->acc << n) | (code & ((1u << n) - 1));
+    w->bits += n;
+    while (w->bits >= 8)
+    {
+        uint8_t b = w->acc >> (w->bits - 8);
+        app_jpeg_put_byte(w, b);
+        if (b == 0xFF)
+        {
+            app_jpeg_put_byte(w, 0x00);
+        }
+        w->bits -= 8;
+    }
+}
+
+/**
+ * Pads the last byte with ones, before a marker or the end of the scan.
+ */
+void app_jpeg_flush_bits(jpeg_writer_t *w);
+
+/**
+ * Huffman codes the quantized coefficients of one block in zigzag order.
+ * Returns false when the tables have no code for one of them.
+ */
+bool app_jpeg_encode_block(jpeg_writer_t *w, const jpeg_huff_code_t *dc, const jpeg_huff_code_t *ac, int *pred, const int16_t *zz);
+
+/**
+ * Encodes a BGR888 frame as baseline 4:2:2 JPEG into a pooled buffer.
+ * Faster than fmt2jpg: fixed point AAN DCT, cached tables per quality and
+ * the working set of one MCU row in internal RAM. With
+ * CONFIG_JPEG_ENCODE_DUAL_CORE the lower half is encoded on the other core.
+ */
+bool app_jpeg_encode(const dl_matrix3du_t *matrix, uint8_t quality, frame_jpg_t *jpg);
+
+/**
+ * Like app_jpeg_encode, but only the MCUs under boxes, grown by one MCU,
+ * keep quality. The others are quantized as at bg_quality and written in
+ * steps of the quality tables, as baseline JPEG has one set of tables per
+ * frame. Boxes are in pixels of matrix, up to JPEG_ROI_MAX are used.
+ */
+bool app_jpeg_encode_roi(const dl_matrix3du_t *matrix, uint8_t quality, uint8_t bg_quality,
+                         const box_t *boxes, int count, frame_jpg_t *jpg);
+
+/**
+ * Starts the helper task of CONFIG_JPEG_ENCODE_DUAL_CORE.
+ */
+esp_err_t app_jpeg_init();
+
+#if __cplusplus
+}
+#endif
+#endif
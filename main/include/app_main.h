@@ -2,6 +2,7 @@
 #include "app_httpserver.h"
 #include "app_wifi.h"
 #include "app_speech_srcif.h"
+#include "app_event.h"
 
 #define VERSION "0.9.0"
 
@@ -9,16 +10,3 @@
 #define GPIO_LED_WHITE  22
 #define GPIO_BUTTON     0
 #define GPIO_PIR        19
-typedef enum
-{
-    WAIT_FOR_WAKEUP,
-    WAIT_FOR_CONNECT,
-    START_DETECT,
-    START_RECOGNITION,
-    START_ENROLL,
-    START_DELETE,
-} en_fsm_state;
-
-extern en_fsm_state g_state;
-extern int g_is_enrolling;
-extern int g_is_deleting;
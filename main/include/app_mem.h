@@ -0,0 +1,155 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_MEM_H_
+#define _APP_MEM_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "dl_lib_matrix3d.h"
+
+/*
+ * Buffers whose placement is decided by the table in app_mem.c. Small ones
+ * touched for every pixel or every face go to internal RAM, whole frames and
+ * anything read once per frame stay in PSRAM.
+ */
+typedef enum {
+    APP_MEM_ALIGNED_FACE,   /* recognizer input, one per face recognized in a frame */
+    APP_MEM_OVERLAY_MASK,   /* per block bitmap of the composed overlays */
+    APP_MEM_JPEG_STRIP,     /* one MCU row of YCbCr for the fast encoder */
+    APP_MEM_MOTION,         /* 1/8 scale frame of the motion gate */
+    APP_MEM_DETECT_INPUT,   /* scaled detector input, see CONFIG_DETECT_INPUT_INTERNAL */
+    APP_MEM_DECODE_STRIP,   /* row of MCUs on its way into a PSRAM detector input */
+    APP_MEM_TRACK_ROI,
+    APP_MEM_FACE_SAMPLE,    /* aligned faces kept for enrollment and quality selection */
+    APP_MEM_FRAME,          /* pooled RGB888 frames */
+    APP_MEM_FRAME_JPEG,     /* pooled re-encode outputs */
+    APP_MEM_JPEG_HALF,      /* lower half of CONFIG_JPEG_ENCODE_DUAL_CORE */
+    APP_MEM_OVERLAY_TEXT,
+    APP_MEM_FACE_CROP,
+    APP_MEM_FONT_ATLAS,     /* status text font pre-scaled for app_display */
+    APP_MEM_PREVIEW_FRAME,  /* sensor frame copied for app_preview */
+    APP_MEM_PREVIEW_STRIP,  /* RGB565 rows on their way to the preview panel */
+    APP_MEM_TRACE,          /* event ring of app_tracer */
+    APP_MEM_FACE_DB,        /* enrolled faces and their hash index */
+    APP_MEM_FACE_INDEX,     /* cluster centroids searched for every face */
+    APP_MEM_FACE_IMPORT,    /* flash sector being filled by a face import */
+    APP_MEM_AUDIO_RING,     /* chunks between the recorder and the wake word model */
+    APP_MEM_AUDIO_DMA,      /* I2S frames before the downmix */
+    APP_MEM_CLIP,           /* JPEG ring of CONFIG_EVENT_CLIP */
+    APP_MEM_CAMERA,         /* taken by the camera driver, counted with app_mem_account */
+    APP_MEM_TASK_STACK,     /* stacks of the tasks in app_tasks.c, counted with app_mem_account */
+    APP_MEM_OFFLOAD,        /* frame on its way to the inference server */
+    APP_MEM_RTCLOG,         /* RTC log records of the last boot */
+    APP_MEM_ENROLL_UPLOAD,  /* JPEGs uploaded for enrollment and their decode */
+    APP_MEM_FRAME_CORPUS,   /* JPEGs looped by CONFIG_FRAME_SOURCE */
+    APP_MEM_OTA,            /* delta patch state and its flash sector buffers */
+    APP_MEM_OTA_INFLATE,    /* zlib state and window of the patch */
+    APP_MEM_MAX,
+} app_mem_id_t;
+
+/* Subsystems the buffers are summed up by */
+typedef enum {
+    APP_MEM_TAG_CAMERA,
+    APP_MEM_TAG_PIPELINE,   /* frames, JPEG outputs, overlays and clips */
+    APP_MEM_TAG_DETECT,
+    APP_MEM_TAG_RECOGNIZE,
+    APP_MEM_TAG_FACE_DB,
+    APP_MEM_TAG_AUDIO,
+    APP_MEM_TAG_DISPLAY,
+    APP_MEM_TAG_TASKS,
+    APP_MEM_TAG_DEBUG,
+    APP_MEM_TAG_MAX,
+} app_mem_tag_t;
+
+typedef enum {
+    APP_MEM_INTERNAL,
+    APP_MEM_SPIRAM,
+} app_mem_region_t;
+
+typedef struct {
+    const char *name;
+    app_mem_region_t region;    /* preferred, the other one is used when it is full */
+    app_mem_tag_t tag;
+} app_mem_desc_t;
+
+typedef struct {
+    size_t internal;            /* bytes allocated for the buffer in each region */
+    size_t spiram;
+    size_t peak_internal;       /* highest since boot */
+    size_t peak_spiram;
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t fallbacks;         /* allocations that went to the other region */
+} app_mem_usage_t;
+
+const app_mem_desc_t *app_mem_desc(app_mem_id_t id);
+
+const char *app_mem_tag_name(app_mem_tag_t tag);
+
+void app_mem_get_usage(app_mem_id_t id, app_mem_usage_t *usage);
+
+/**
+ * Sums the usage of the buffers of a tag. The peaks are those of the sum.
+ */
+void app_mem_get_tag_usage(app_mem_tag_t tag, app_mem_usage_t *usage);
+
+/**
+ * Counts memory that was allocated or freed elsewhere, by a driver or for a
+ * task stack, as one allocation or free of the buffer.
+ */
+void app_mem_account(app_mem_id_t id, app_mem_region_t region, size_t size, bool add);
+
+/**
+ * Heaps, usage per tag and per buffer, and what the heaps hold beyond the
+ * tracked buffers, as a JSON object. Free the string after use.
+ */
+char *app_mem_to_json();
+
+/**
+ * Allocates a buffer in the region of its table entry, or in the other one
+ * when that has no room. Internal RAM is never taken below
+ * CONFIG_MEM_INTERNAL_RESERVE_KB. Returns NULL when neither has room.
+ */
+void *app_mem_alloc(app_mem_id_t id, size_t size);
+
+/**
+ * Frees a buffer of app_mem_alloc, size is the one it was allocated with.
+ */
+void app_mem_free(app_mem_id_t id, void *ptr, size_t size);
+
+/**
+ * Allocates a matrix with its items placed like app_mem_alloc. It must be
+ * freed with app_mem_matrix_free, not dl_matrix3du_free.
+ */
+dl_matrix3du_t *app_mem_matrix_alloc(app_mem_id_t id, int w, int h, int c);
+
+void app_mem_matrix_free(app_mem_id_t id, dl_matrix3du_t *matrix);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,84 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_METRICS_H_
+#define _APP_METRICS_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+typedef enum {
+    METRIC_CAPTURE_WAIT,    /* capture until the detect stage picks the frame up */
+    METRIC_DECODE,          /* JPEG decode for the detector */
+    METRIC_DETECT,
+    METRIC_RECOGNIZE,       /* alignment, recognition and overlays */
+    METRIC_ENCODE,
+    METRIC_SEND,            /* one frame to one viewer */
+    METRIC_LATENCY,         /* sensor frame until handed to the viewers */
+    METRIC_FRAME,           /* interval between published frames */
+    METRIC_SPEECH_DETECT,   /* wake word model on one audio chunk */
+    METRIC_WAKE_LATENCY,    /* end of a word until it was recognized */
+    METRIC_THUMBNAIL,       /* OLED thumbnail dithered from the detector input */
+    METRIC_CAPTURE_RECOVERY, /* failed capture until the driver was started again */
+    METRIC_MAX,
+} metric_id_t;
+
+/* Buckets of a histogram, upper bounds from 1 ms to 2 s and the one above */
+#define METRIC_BUCKETS      12
+
+/* Observations of a histogram per bucket, counted since boot */
+typedef struct {
+    uint32_t count[METRIC_BUCKETS];
+} metric_snapshot_t;
+
+typedef esp_err_t (*metrics_write_cb)(void *arg, const char *buf, size_t len);
+
+/**
+ * Records a duration in microseconds. Lock free, safe to call from an ISR.
+ */
+void app_metrics_observe(metric_id_t id, int64_t us);
+
+/**
+ * Copies the bucket counts of a histogram.
+ */
+void app_metrics_snapshot(metric_id_t id, metric_snapshot_t *snapshot);
+
+/**
+ * Estimates the pct-th percentile in microseconds of the observations made
+ * between two snapshots, interpolated within its bucket as Prometheus does.
+ * Durations above 2 s count as 2 s. Returns 0 without observations.
+ */
+uint32_t app_metrics_percentile(const metric_snapshot_t *from, const metric_snapshot_t *to, int pct);
+
+/**
+ * Writes all histograms and gauges in the Prometheus text format.
+ */
+esp_err_t app_metrics_write(metrics_write_cb write, void *arg);
+
+#if __cplusplus
+}
+#endif
+#endif
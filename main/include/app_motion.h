@@ -0,0 +1,50 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_MOTION_H_
+#define _APP_MOTION_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "esp_camera.h"
+
+/* Blocks the luma plane is split into */
+#define MOTION_GRID_W       8
+#define MOTION_GRID_H       6
+
+/* Frames detection keeps running after the scene went still */
+#define MOTION_HOLD_FRAMES  10
+
+esp_err_t app_motion_init(framesize_t frame_size);
+
+/**
+ * Compares a 1/8 scale luma plane of the frame with the one of the previous frame.
+ * Returns true while something moved in the last MOTION_HOLD_FRAMES frames,
+ * or the PIR sensor triggered since the last frame when CONFIG_MOTION_USE_PIR is set.
+ */
+bool app_motion_detect(camera_fb_t *fb);
+
+#if __cplusplus
+}
+#endif
+#endif
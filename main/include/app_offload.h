@@ -0,0 +1,92 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_OFFLOAD_H_
+#define _APP_OFFLOAD_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+#include "app_pipeline.h"
+
+/*
+ * Detection on a remote inference server, see CONFIG_OFFLOAD_INFERENCE.
+ * The camera keeps a TCP connection to CONFIG_OFFLOAD_HOST and sends it
+ * sensor JPEGs one at a time, each one is answered with the faces found.
+ * Multi-byte fields are big endian.
+ *
+ * Camera to server:
+ *   frame           seq:u32 width:u16 height:u16 len:u32 then the JPEG
+ *
+ * Server to camera:
+ *   faces           seq:u32 count:u8 then per face id:i16 similarity_pct:u8
+ *                   x0:i16 y0:i16 x1:i16 y1:i16, id -1 when not recognized,
+ *                   the layout of WS_MSG_FACES after the seq
+ *
+ * While answers come back within CONFIG_OFFLOAD_MAX_RTT_MS and frames go
+ * out at CONFIG_OFFLOAD_MIN_KBPS or more, the detect stage skips local
+ * detection. Otherwise a frame per CONFIG_OFFLOAD_PROBE_MS keeps measuring
+ * the link.
+ */
+
+typedef struct {
+    bool connected;
+    bool active;            /* detection runs on the server */
+    uint32_t rtt_ms;        /* mean from the start of a frame until its answer */
+    uint32_t kbps;          /* mean rate frames were sent at */
+    uint32_t sent;
+    uint32_t answered;
+    uint32_t fallbacks;     /* times detection went back to the device */
+} offload_stats_t;
+
+/**
+ * Starts the task that connects to the server. Does nothing without
+ * CONFIG_OFFLOAD_INFERENCE.
+ */
+esp_err_t app_offload_init();
+
+/**
+ * True while detection is left to the server.
+ */
+bool app_offload_active();
+
+/**
+ * Offers a sensor JPEG to the server. It is copied when the connection is
+ * idle and the frame is due, never blocks.
+ */
+void app_offload_submit(const camera_fb_t *fb, uint32_t seq);
+
+/**
+ * Sets the faces of the latest answer on the frame, scaled to its size.
+ * Answers older than CONFIG_OFFLOAD_MAX_AGE_MS leave it without faces.
+ */
+void app_offload_get_faces(frame_desc_t *frame);
+
+void app_offload_get_stats(offload_stats_t *stats);
+
+#if __cplusplus
+}
+#endif
+#endif
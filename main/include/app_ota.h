@@ -0,0 +1,86 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _APP_OTA_H_
+#define _APP_OTA_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/*
+ * Delta updates of CONFIG_DELTA_OTA. A patch is a zlib stream of
+ *
+ *   "WHOD", old size, SHA-256 of the old image, new size, SHA-256 of the new image
+ *
+ * followed by bsdiff records until the new image is complete:
+ *
+ *   diff length, extra length, seek, then the diff and the extra bytes
+ *
+ * All numbers are 32 bit little endian, seek is signed. As in bspatch, each
+ * diff byte is added to the old byte at the old position, both advance, the
+ * extra bytes are copied as they are, then seek moves the old position.
+ * The old image is the running one, the new one goes to the other slot.
+ */
+
+#define OTA_URL_MAX     256
+
+typedef enum {
+    OTA_IDLE,
+    OTA_DOWNLOADING,        /* and writing the new image */
+    OTA_VERIFYING,
+    OTA_DONE,               /* restarting into the new image */
+    OTA_FAILED,
+} ota_state_t;
+
+typedef struct {
+    ota_state_t state;
+    esp_err_t err;              /* of the last update that failed */
+    uint32_t received;          /* patch bytes */
+    uint32_t patch_size;        /* 0 when the server sent no length */
+    uint32_t written;           /* bytes of the new image */
+    uint32_t image_size;
+} ota_status_t;
+
+/**
+ * Downloads the patch at url in a task of its own and applies it to the
+ * slot not running. Once the new image checked out, it is made the boot
+ * image and the board restarts. Returns ESP_ERR_INVALID_STATE while an
+ * update runs and ESP_ERR_NOT_SUPPORTED without a second app slot.
+ */
+esp_err_t app_ota_start(const char *url);
+
+void app_ota_get_status(ota_status_t *status);
+
+/**
+ * Status as JSON, free the string after use.
+ */
+char *app_ota_to_json();
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,89 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_OVERLAY_H_
+#define _APP_OVERLAY_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "dl_lib_matrix3d.h"
+#include "app_frame_pool.h"
+
+#define OVERLAY_MAX_OPS     24
+#define OVERLAY_MAX_TEXTS   6
+#define OVERLAY_TEXT_MAX    48
+
+typedef struct {
+    int16_t x;
+    int16_t y;
+    int16_t w;
+    int16_t h;
+    uint32_t color;             /* 0x00BBGGRR like the fb_gfx colors */
+    int8_t text;                /* index into texts, -1 for a filled rectangle */
+} overlay_op_t;
+
+/**
+ * Boxes and text to be drawn onto a frame, in drawing order.
+ */
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint8_t count;
+    uint8_t text_count;
+    overlay_op_t ops[OVERLAY_MAX_OPS];
+    char texts[OVERLAY_MAX_TEXTS][OVERLAY_TEXT_MAX];
+} overlay_t;
+
+void app_overlay_reset(overlay_t *overlay, size_t width, size_t height);
+
+/**
+ * Ops that do not fit are dropped, the frame is still sent.
+ */
+void app_overlay_fill_rect(overlay_t *overlay, int x, int y, int w, int h, uint32_t color);
+
+/**
+ * Text is printed with fb_gfx_print at x, y, clipped to the frame.
+ */
+void app_overlay_print(overlay_t *overlay, int x, int y, uint32_t color, const char *str);
+
+/**
+ * Draws the overlay into an RGB888 frame of the overlay size.
+ */
+void app_overlay_draw(const overlay_t *overlay, dl_matrix3du_t *image_matrix);
+
+/**
+ * Copies a baseline JPEG into jpg with the overlay drawn on it. Only the MCUs
+ * the overlay touches are decoded and encoded again, the others keep their
+ * coefficients. With restart markers, intervals without overlay are copied as
+ * they are. Returns ESP_ERR_NOT_SUPPORTED for JPEG layouts it cannot splice,
+ * the overlay then has to be drawn into a full decode.
+ */
+esp_err_t app_overlay_compose(const uint8_t *src, size_t src_len, const overlay_t *overlay, frame_jpg_t *jpg);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,120 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_PERF_H_
+#define _APP_PERF_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "app_pipeline.h"
+#include "app_frame_source.h"
+#include "app_speech_capture.h"
+#include "app_display_bench.h"
+
+/*
+ * Performance suite, see CONFIG_PERF_SUITE. Runs the wake word model over
+ * recorded audio, streams the synthetic frame source through the pipeline
+ * and times the panel, then reports them with the heaps and the boot phases
+ * in one JSON object that perf/perf_compare.py compares between builds.
+ */
+
+/* Pipeline stages of the suite, timed by app_metrics while it streams */
+typedef enum {
+    PERF_STAGE_CAPTURE_WAIT,
+    PERF_STAGE_DECODE,
+    PERF_STAGE_DETECT,
+    PERF_STAGE_RECOGNIZE,
+    PERF_STAGE_ENCODE,
+    PERF_STAGE_SEND,
+    PERF_STAGE_LATENCY,     /* sensor frame until handed to the viewers */
+    PERF_STAGE_FRAME,       /* interval between published frames */
+    PERF_STAGE_MAX,
+} perf_stage_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t p50_us;
+    uint32_t p99_us;
+} perf_stage_stats_t;
+
+typedef struct {
+    esp_err_t err;                  /* ESP_OK when the pipeline streamed */
+    frame_source_t source;          /* corpus when one was loaded, colorbar otherwise */
+    uint32_t duration_ms;           /* after the warmup */
+    uint32_t frames;                /* handed to the suite's viewer */
+    uint32_t bytes;                 /* of those frames */
+    uint32_t dropped[FRAME_DROP_MAX];
+    perf_stage_stats_t stages[PERF_STAGE_MAX];
+} perf_pipeline_t;
+
+typedef struct {
+    uint32_t free;
+    uint32_t min_free;              /* lowest since boot */
+    uint32_t largest;
+} perf_heap_t;
+
+typedef enum {
+    PERF_HEAP_INTERNAL,
+    PERF_HEAP_DMA,
+    PERF_HEAP_SPIRAM,
+    PERF_HEAP_MAX,
+} perf_heap_id_t;
+
+typedef struct {
+    bool has_speech;                /* audio was posted, CONFIG_SPEECH_CAPTURE */
+    speech_replay_t speech;
+    perf_pipeline_t pipeline;
+    bool has_display;               /* CONFIG_DISPLAY_BENCH */
+    display_bench_result_t display;
+    perf_heap_t heaps[PERF_HEAP_MAX];
+    uint32_t elapsed_ms;            /* of the whole suite */
+} perf_result_t;
+
+/**
+ * Fills buf with up to len bytes of audio, returns the bytes read, 0 at the end and < 0 on error.
+ */
+typedef int (*perf_read_cb)(void *arg, void *buf, size_t len);
+
+/**
+ * Runs the suite. read gives raw 16 kHz 16 bit mono PCM for the wake word
+ * model, as for app_speech_replay, or NULL to leave it out. The pipeline
+ * streams to a viewer of the suite for CONFIG_PERF_PIPELINE_S seconds after
+ * CONFIG_PERF_WARMUP_S, the board is woken up for it. The frame source is
+ * set back when done. Returns the error of the pipeline part, the other
+ * parts run and are reported in result either way.
+ */
+esp_err_t app_perf_run(perf_read_cb read, void *arg, perf_result_t *result);
+
+/**
+ * Suite result as a JSON object with the build and the boot phases, free the string after use.
+ */
+char *app_perf_to_json(const perf_result_t *result);
+
+#if __cplusplus
+}
+#endif
+#endif
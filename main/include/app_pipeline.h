@@ -0,0 +1,244 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_PIPELINE_H_
+#define _APP_PIPELINE_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <sys/time.h>
+#include "freertos/FreeRTOS.h"
+#include "app_camera.h"
+#include "fd_forward.h"
+#include "fr_forward.h"
+#include "fr_flash.h"
+#include "app_frame_pool.h"
+#include "app_event.h"
+#include "app_overlay.h"
+
+#define ENROLL_CONFIRM_TIMES    3
+#define FACE_ID_SAVE_NUMBER     10
+
+/* Face detection workers taking turns on frames, one per core with CONFIG_DETECT_DUAL_WORKER */
+#ifdef CONFIG_DETECT_DUAL_WORKER
+#define PIPELINE_DETECT_WORKERS 2
+#else
+#define PIPELINE_DETECT_WORKERS 1
+#endif
+
+/*
+ * Number of frames in flight between capture and send.
+ * Every stage and every detection worker holds at most one frame, the rest wait in queues.
+ */
+#define PIPELINE_DEPTH          (2 + PIPELINE_DETECT_WORKERS)
+
+/* Faces reported per frame in the stream metadata */
+#define PIPELINE_MAX_FACES      4
+
+#ifdef CONFIG_FACE_CROPS
+#define FACE_CROP_SIZE          CONFIG_FACE_CROP_SIZE
+/* room for the headers and a detailed face */
+#define FACE_CROP_JPEG_MAX      (FACE_CROP_SIZE * FACE_CROP_SIZE + 1024)
+#endif
+
+#ifdef CONFIG_STREAM_FACE_METADATA
+#define PIPELINE_DRAW_OVERLAY   0
+#else
+#define PIPELINE_DRAW_OVERLAY   1
+#endif
+
+#define PIPELINE_DETECT_CORE    1
+#define PIPELINE_ENCODE_CORE    0
+
+/*
+ * Why a frame was not sent. Frames a slow viewer misses are counted by app_stream.
+ */
+typedef enum {
+    FRAME_DROP_NONE,
+    FRAME_DROP_STILL,               /* no motion, see CONFIG_MOTION_DROP_STATIC */
+    FRAME_DROP_ERROR,               /* capture, decode or encode failed */
+    FRAME_DROP_STOPPED,             /* in flight when the pipeline stopped */
+    FRAME_DROP_MAX,
+} frame_drop_t;
+
+/**
+ * Frame descriptor, passed by pointer through the
+ * capture -> detect/recognize -> encode -> send queues.
+ */
+typedef struct {
+    camera_fb_t *fb;                /* sensor frame, NULL once returned to the driver */
+    dl_matrix3du_t *image_matrix;   /* pooled RGB888 frame, only set when overlays are drawn */
+    frame_jpg_t *jpg;               /* pooled re-encode output */
+    uint8_t *jpg_buf;               /* data to send, fb->buf when forwarded untouched */
+    size_t jpg_buf_len;
+    size_t width;
+    size_t height;
+    int face_id;                    /* ID of the first face, -1 when not recognized */
+    int face_ids[PIPELINE_MAX_FACES];
+    float face_similarity[PIPELINE_MAX_FACES];  /* of the best match, 0 when not recognized */
+    int enroll_samples;             /* samples taken of the face being enrolled */
+    int enrolled_id;                /* face enrolled just before, -1 for none */
+    int face_count;
+    box_t face_boxes[PIPELINE_MAX_FACES];
+    landmark_t face_landmarks[PIPELINE_MAX_FACES];
+    esp_err_t err;
+    en_fsm_state state;             /* state when the detect stage picked the frame up */
+    bool video;                     /* encoded for viewers, jpg_buf is NULL for raw frames otherwise */
+    bool compose;                   /* overlay is spliced into the sensor JPEG by the encode stage */
+    overlay_t overlay;
+    int crop_count;                 /* faces in face_crops, 0 without /face_crops viewers */
+    frame_jpg_t face_crops[PIPELINE_MAX_FACES];     /* len 0 when the crop did not fit */
+    frame_drop_t drop;
+    int refs;                       /* viewers still sending the frame, see app_stream */
+
+    uint32_t seq;                   /* of the sensor frame, frames skipped in the driver leave gaps */
+    int64_t fr_sensor;              /* sensor finished the frame, as far as esp_camera_fb_get tells */
+    int64_t fr_capture;             /* esp_camera_fb_get returned */
+    int64_t fr_start;               /* detect stage picked the frame up */
+    int64_t fr_ready;
+    int64_t fr_face;
+    int64_t fr_recognize;
+    int64_t fr_encode;
+    int64_t fr_sent;
+} frame_desc_t;
+
+typedef struct {
+    int free;
+    int detect;
+    int encode;
+    int send;
+} pipeline_depths_t;
+
+const char *number_suffix(int32_t number);
+
+void app_pipeline_init();
+
+/**
+ * Starts the capture, detect and encode stages.
+ * Frames are then pulled in capture order with app_pipeline_get_frame.
+ */
+esp_err_t app_pipeline_start();
+
+/**
+ * Stops all stages and waits until every frame is back in the free list.
+ */
+void app_pipeline_stop();
+
+/**
+ * Applies camera settings. A new frame size or pixel format pauses the
+ * pipeline while the frame pools and the driver are resized.
+ */
+esp_err_t app_pipeline_set_camera(const camera_settings_t *settings);
+
+#ifdef CONFIG_CAMERA_TUNE
+/**
+ * Pauses the pipeline for app_camera_tune, for the better part of a minute.
+ */
+esp_err_t app_pipeline_tune_camera(camera_tune_t *result);
+#endif
+
+/**
+ * Turns JPEG output on or off. Without it frames still go through detection and
+ * recognition, but nothing is drawn or encoded.
+ */
+void app_pipeline_set_video(bool enabled);
+
+/**
+ * Turns the face crops of CONFIG_FACE_CROPS on or off. Each face found is then
+ * cut from the frame before overlays are drawn and encoded on its own.
+ */
+void app_pipeline_set_face_crops(bool enabled);
+
+/**
+ * Takes one frame straight from the driver, ESP_ERR_INVALID_STATE while the
+ * pipeline runs. The frame must be handed back with esp_camera_fb_return.
+ */
+esp_err_t app_pipeline_capture_still(camera_fb_t **fb);
+
+/*
+ * Stages timed by app_pipeline_bench_frame
+ */
+typedef enum {
+    BENCH_STAGE_DECODE,     /* scaled decode for the detector, and the full one when faces are found */
+    BENCH_STAGE_DETECT,
+    BENCH_STAGE_ALIGN,
+    BENCH_STAGE_RECOGNIZE,
+    BENCH_STAGE_OVERLAY,
+    BENCH_STAGE_ENCODE,     /* overlay splice or full encode */
+    BENCH_STAGE_MAX,
+} bench_stage_t;
+
+/**
+ * Runs a recorded frame through the detect and encode stage functions as if
+ * it had been streamed, and stores the time each stage took in us, -1 for the
+ * stages the frame skipped. Unlike streaming every face is aligned and
+ * recognized, the face cache and the quality window are left out so that runs
+ * compare. Returns ESP_ERR_INVALID_STATE while the pipeline runs.
+ */
+esp_err_t app_pipeline_bench_frame(camera_fb_t *fb, int64_t us[BENCH_STAGE_MAX], int *faces);
+
+/**
+ * Returns the next encoded frame or NULL on timeout.
+ * The frame must be handed back with app_pipeline_return_frame.
+ */
+frame_desc_t *app_pipeline_get_frame(TickType_t timeout);
+
+void app_pipeline_return_frame(frame_desc_t *frame);
+
+/**
+ * Formats the faces of a frame as X-Face-* header lines for its multipart part.
+ * Returns the length written, 0 when the overlays are drawn into the frame.
+ */
+size_t app_pipeline_format_faces(frame_desc_t *frame, char *buf, size_t len);
+
+/**
+ * Logs the per-stage timing of a frame that has been sent and records it in the metrics.
+ */
+void app_pipeline_log_frame(frame_desc_t *frame);
+
+/**
+ * System time of the sensor frame, for the X-Timestamp of the stream.
+ */
+void app_pipeline_frame_time(const frame_desc_t *frame, struct timeval *tv);
+
+/**
+ * Sensor frames skipped because a newer one was already waiting.
+ */
+uint32_t app_pipeline_stale_frames();
+
+/**
+ * Frames dropped for a reason since boot.
+ */
+uint32_t app_pipeline_dropped_frames(frame_drop_t reason);
+
+const char *app_pipeline_drop_name(frame_drop_t reason);
+
+/**
+ * Frames waiting in each queue.
+ */
+void app_pipeline_get_depths(pipeline_depths_t *depths);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,64 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_PIR_H_
+#define _APP_PIR_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define PIR_MAX_SUBSCRIBERS     4
+
+typedef struct {
+    bool level;                     /* true on the rising edge */
+    int64_t time;                   /* esp_timer time the edge was seen in the ISR */
+} pir_event_t;
+
+/**
+ * Called from the PIR task for every edge, in the order of subscription.
+ * Must not block for long, later subscribers wait.
+ */
+typedef void (*pir_callback_t)(const pir_event_t *event, void *arg);
+
+/**
+ * Sets up the edge interrupt on GPIO_PIR and the task that hands edges to the subscribers.
+ */
+esp_err_t app_pir_init();
+
+/**
+ * Returns ESP_ERR_NO_MEM when PIR_MAX_SUBSCRIBERS are registered already.
+ */
+esp_err_t app_pir_subscribe(pir_callback_t callback, void *arg);
+
+/**
+ * Sensor level as of the last edge, without touching the GPIO.
+ */
+bool app_pir_active();
+
+#if __cplusplus
+}
+#endif
+#endif
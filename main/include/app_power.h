@@ -0,0 +1,59 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_POWER_H_
+#define _APP_POWER_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "esp_err.h"
+
+typedef enum {
+    POWER_LOCK_PIPELINE,    /* camera pipeline running, full CPU clock and no light sleep */
+    POWER_LOCK_AUDIO,       /* recording for the wake word model, no light sleep */
+    POWER_LOCK_MAX,
+} power_lock_id_t;
+
+/**
+ * Lets the CPU clock drop to CONFIG_POWER_SAVE_MIN_MHZ and, with tickless idle,
+ * the chip light sleep while no lock is held. Does nothing without CONFIG_POWER_SAVE.
+ */
+esp_err_t app_power_init();
+
+/**
+ * Takes or drops a lock, repeated calls in the same direction have no effect.
+ */
+void app_power_acquire(power_lock_id_t id);
+
+void app_power_release(power_lock_id_t id);
+
+/**
+ * Caps the CPU clock, also while the pipeline lock is held. 0 lifts the cap
+ * back to the default clock. Needs CONFIG_POWER_SAVE.
+ */
+esp_err_t app_power_set_max_mhz(int mhz);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,51 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_PREVIEW_H_
+#define _APP_PREVIEW_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "esp_err.h"
+#include "esp_camera.h"
+
+/* Rows of pixels sent to the panel with one window */
+#define PREVIEW_STRIP_ROWS      16
+
+/**
+ * Sets up the panel of CONFIG_PREVIEW_PANEL on its own SPI bus, beside the
+ * OLED, and the task that draws frames on it.
+ */
+esp_err_t app_preview_init();
+
+/**
+ * Copies a sensor frame, JPEG or RGB565, for the preview and returns. At most
+ * CONFIG_PREVIEW_FPS frames a second are taken, frames are skipped while the
+ * previous one is drawn.
+ */
+void app_preview_add_frame(const camera_fb_t *fb);
+
+#if __cplusplus
+}
+#endif
+#endif
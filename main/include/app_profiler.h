@@ -0,0 +1,63 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_PROFILER_H_
+#define _APP_PROFILER_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/*
+ * Statistical profiler, see CONFIG_PROFILER. The tick interrupt of each core
+ * samples the PC the running task was interrupted at and the return address
+ * of its function, counted per task.
+ */
+
+typedef esp_err_t (*profiler_write_cb)(void *arg, const char *buf, size_t len);
+
+typedef struct {
+    uint32_t samples;
+    uint32_t dropped;       /* samples whose stack found no free slot */
+    uint32_t stacks;        /* distinct task, caller and PC triples */
+} profiler_stats_t;
+
+/**
+ * Samples both cores for the given time and blocks meanwhile. Only one
+ * profile runs at a time, ESP_ERR_INVALID_STATE while another one does.
+ */
+esp_err_t app_profiler_run(uint32_t seconds, profiler_stats_t *stats);
+
+/**
+ * Writes the samples of the last run as folded stacks, one "task;caller;pc count"
+ * line per stack with the addresses in hex. Symbolize them against the ELF,
+ * e.g. with xtensa-esp32-elf-addr2line, before feeding them to flamegraph.pl.
+ */
+esp_err_t app_profiler_write_folded(profiler_write_cb write, void *arg);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,76 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_RATE_H_
+#define _APP_RATE_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "app_pipeline.h"
+
+/* Sensor JPEG quality, lower is better */
+#define RATE_SENSOR_QUALITY_BEST    10
+/* Overlay re-encode quality, higher is better */
+#define RATE_OVERLAY_QUALITY_BEST   90
+/* Frame size limit that does not limit anything */
+#define RATE_FRAME_SIZE_MAX         FRAMESIZE_UXGA
+
+typedef enum {
+    RATE_LIMIT_SHED,        /* load shedding, see app_shed.h */
+    RATE_LIMIT_PROFILE,     /* idle camera profile, see app_camera_profile.h */
+    RATE_LIMIT_MAX,
+} rate_limit_t;
+
+void app_rate_init();
+
+/**
+ * Feeds the controller with a frame a viewer has just sent and the time the send took.
+ * Adjusts the sensor frame size and quality when the link is congested or has room.
+ */
+void app_rate_update(frame_desc_t *frame, int64_t send_us);
+
+/**
+ * Keeps the sensor frame size at or below frame_size, whatever the level.
+ * Each owner sets its own limit and the smallest one holds.
+ * RATE_FRAME_SIZE_MAX lifts the limit of the owner.
+ */
+void app_rate_set_frame_size_limit(rate_limit_t owner, framesize_t frame_size);
+
+/**
+ * Serializes sensor updates with those of the controller, for owners of a
+ * limit that must read their state and set the limit in one step. Nests,
+ * and app_rate_set_frame_size_limit may be called while it is held.
+ */
+void app_rate_lock();
+
+void app_rate_unlock();
+
+/**
+ * Quality for re-encoding frames with overlays.
+ */
+uint8_t app_rate_overlay_quality();
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,78 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_RTCLOG_H_
+#define _APP_RTCLOG_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "app_pipeline.h"
+
+/*
+ * Fixed size event and frame records in RTC slow memory, see CONFIG_RTC_LOG.
+ * The memory keeps its content over any reset but a power cycle, so the
+ * records of the last boot can be read after a panic or a watchdog reset.
+ * Recording copies a few words and formats nothing.
+ */
+typedef enum {
+    RTCLOG_BOOT,            /* a: esp_reset_reason of this boot */
+    RTCLOG_STATE,           /* a: new state, b: previous state, arg: event */
+    RTCLOG_STALL,           /* a: shed_stage_t, b: ms the stage took */
+    RTCLOG_ALLOC_FAIL,      /* a: app_mem_id_t, b: bytes asked for */
+    RTCLOG_MAX,
+} rtclog_type_t;
+
+typedef esp_err_t (*rtclog_write_cb)(void *arg, const char *buf, size_t len);
+
+#ifdef CONFIG_RTC_LOG
+/**
+ * Keeps the records of the last boot in RAM for app_rtclog_write_json, and
+ * starts the ones of this boot. Call it first thing.
+ */
+esp_err_t app_rtclog_init();
+
+/**
+ * Adds an event, the oldest one is overwritten once the ring is full.
+ * Safe from any task, not from an ISR.
+ */
+void app_rtclog_event(rtclog_type_t type, uint8_t arg, uint32_t a, uint32_t b);
+
+/**
+ * Adds the stage times of a frame that went through the pipeline.
+ */
+void app_rtclog_frame(const frame_desc_t *frame);
+
+/**
+ * Writes the records of the last boot and of this one as a JSON object.
+ */
+esp_err_t app_rtclog_write_json(rtclog_write_cb write, void *arg);
+#endif
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,94 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_SHED_H_
+#define _APP_SHED_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "app_pipeline.h"
+
+/*
+ * Deadline monitor, see CONFIG_LOAD_SHEDDING. Every frame is timed against a
+ * budget per stage, and load is shed one level at a time while a stage is over.
+ */
+
+typedef enum {
+    SHED_STAGE_DETECT,      /* capture until the faces are found */
+    SHED_STAGE_RECOGNIZE,
+    SHED_STAGE_ENCODE,
+    SHED_STAGE_SEND,        /* one frame to one viewer */
+    SHED_STAGE_MAX
+} shed_stage_t;
+
+typedef enum {
+    SHED_LEVEL_NONE,
+    SHED_LEVEL_NO_RECOGNITION,
+    SHED_LEVEL_HALF_DETECT,
+    SHED_LEVEL_LOW_RESOLUTION,
+    SHED_LEVEL_MAX
+} shed_level_t;
+
+/**
+ * Back to full load, or to the floor, called when the pipeline starts.
+ */
+void app_shed_reset();
+
+/**
+ * Feeds the monitor with a frame that made it through the pipeline.
+ */
+void app_shed_update(frame_desc_t *frame);
+
+/**
+ * Feeds the monitor with the time a viewer took to send a frame.
+ */
+void app_shed_update_send(int64_t send_us);
+
+/**
+ * True while recognition is shed, faces are then only detected.
+ */
+bool app_shed_skip_recognition();
+
+/**
+ * Called by the detect stage once per frame, true when detection is shed on this one.
+ */
+bool app_shed_skip_detection();
+
+/**
+ * Holds the level at or above floor until the floor is lowered again, so
+ * load stays shed while the battery is low, however fast the frames are.
+ */
+void app_shed_set_floor(shed_level_t floor);
+
+shed_level_t app_shed_level();
+const char *app_shed_level_name(shed_level_t level);
+
+/**
+ * Steps taken since boot, up or down.
+ */
+uint32_t app_shed_steps(bool up);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,60 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_SLEEP_H_
+#define _APP_SLEEP_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "app_camera.h"
+#include "app_config.h"
+
+/**
+ * Tells a wakeup from deep sleep by the button or the PIR apart from a cold
+ * boot, to be called first thing in app_main. After a timer wakeup that finds
+ * the PIR low it puts the chip back to sleep and does not return.
+ * Returns false without CONFIG_DEEP_SLEEP.
+ */
+bool app_sleep_check();
+
+/**
+ * Starts the task that puts the chip into deep sleep after CONFIG_DEEP_SLEEP_IDLE_S
+ * seconds without viewers, enrollment or PIR activity. Does nothing without
+ * CONFIG_DEEP_SLEEP.
+ */
+esp_err_t app_sleep_init();
+
+/*
+ * Settings kept in RTC memory over deep sleep, false after a cold boot
+ * or when there were none to keep.
+ */
+bool app_sleep_get_network(network_config_t *config);
+
+bool app_sleep_get_camera(camera_settings_t *settings);
+
+#if __cplusplus
+}
+#endif
+#endif
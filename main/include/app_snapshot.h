@@ -0,0 +1,57 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_SNAPSHOT_H_
+#define _APP_SNAPSHOT_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "app_pipeline.h"
+
+/**
+ * Called with the snapshot lock held, tag changes with every new image.
+ */
+typedef esp_err_t (*snapshot_write_cb)(void *arg, const uint8_t *jpg, size_t len, const char *tag);
+
+esp_err_t app_snapshot_init();
+
+/**
+ * Copies a frame handed to the viewers once the cached one is older than
+ * CONFIG_CAPTURE_MAX_AGE_MS. Never blocks, skipped while the cache is being read.
+ */
+void app_snapshot_update(const frame_desc_t *frame);
+
+/**
+ * Passes the latest JPEG to write. A cached image older than CONFIG_CAPTURE_MAX_AGE_MS
+ * is replaced by the next streamed frame or, while the pipeline is stopped,
+ * by a frame taken from the camera.
+ */
+esp_err_t app_snapshot_get(snapshot_write_cb write, void *arg);
+
+#if __cplusplus
+}
+#endif
+#endif
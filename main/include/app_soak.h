@@ -0,0 +1,51 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_SOAK_H_
+#define _APP_SOAK_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "esp_err.h"
+
+/*
+ * Lab mode for long runs, see CONFIG_SOAK_TEST. A built-in viewer keeps the
+ * stream running, free size and largest free block of every heap and the
+ * frame rate are sampled every CONFIG_SOAK_SAMPLE_S seconds.
+ */
+
+/**
+ * Wakes the board up and starts the task that streams to the built-in viewer
+ * and takes the samples.
+ */
+esp_err_t app_soak_init();
+
+/**
+ * Last sample, baseline, trend per hour and verdict as a JSON object, free the string after use.
+ */
+char *app_soak_to_json();
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,96 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_SPEECH_CAPTURE_H_
+#define _APP_SPEECH_CAPTURE_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+
+/* Lab tools for the wake word path: raw audio capture and offline replay */
+
+#define SPEECH_REPLAY_MAX_DETECTIONS    8
+
+typedef struct {
+    int word;                       /* index in the model, 1 for the first word */
+    uint32_t at_ms;                 /* audio position of the end of the chunk it fired on */
+} speech_detection_t;
+
+typedef struct {
+    uint32_t chunks;
+    uint32_t chunk_samples;
+    uint32_t detect_us;             /* model time summed over all chunks */
+    int detection_count;            /* may exceed the detections kept */
+    speech_detection_t detections[SPEECH_REPLAY_MAX_DETECTIONS];
+} speech_replay_t;
+
+/**
+ * Fills buf with up to len bytes of PCM, returns the bytes read, 0 at the end and < 0 on error.
+ */
+typedef int (*speech_replay_read_cb)(void *arg, void *buf, size_t len);
+
+/**
+ * Copies every chunk the recorder hands to the wake word model while a capture runs.
+ * Called by the model task, returns at once when no capture runs.
+ */
+void app_speech_capture_feed(const int16_t *samples, size_t count);
+
+/**
+ * Starts copying recorded audio, 16 kHz 16 bit mono little endian.
+ * Returns ESP_ERR_INVALID_STATE when a capture already runs.
+ */
+esp_err_t app_speech_capture_start();
+
+/**
+ * Takes up to len bytes of captured audio, waiting up to timeout for some.
+ * Returns the bytes copied, 0 on timeout.
+ */
+size_t app_speech_capture_read(void *buf, size_t len, TickType_t timeout);
+
+void app_speech_capture_stop();
+
+/**
+ * Bytes lost since the capture started because the reader fell behind.
+ */
+uint32_t app_speech_capture_dropped();
+
+/**
+ * Runs 16 kHz 16 bit mono PCM through a fresh instance of the wake word model,
+ * chunk by chunk as the recorder would, and reports the time taken and the detections.
+ * A trailing partial chunk is ignored.
+ */
+esp_err_t app_speech_replay(speech_replay_read_cb read, void *arg, speech_replay_t *result);
+
+/**
+ * Replay result as a JSON object, free the string after use.
+ */
+char *app_speech_replay_to_json(const speech_replay_t *result);
+
+#if __cplusplus
+}
+#endif
+#endif
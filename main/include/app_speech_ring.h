@@ -0,0 +1,88 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_SPEECH_RING_H_
+#define _APP_SPEECH_RING_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+
+/**
+ * Single producer, single consumer ring of fixed size audio chunks.
+ * The producer converts I2S data straight into a chunk slot and the consumer
+ * runs on the chunk in place, no copy is made on either side. The size is a
+ * multiple of the chunk, so a chunk never wraps.
+ */
+typedef struct {
+    int16_t *buf;
+    uint32_t size;                  /* samples */
+    uint32_t chunk;                 /* samples */
+    uint32_t chunks;                /* slots, size / chunk */
+    volatile uint32_t head;         /* chunks written, modulo twice the slots, only moved by the producer */
+    volatile uint32_t tail;         /* chunks consumed, modulo twice the slots, only moved by the consumer */
+    volatile uint32_t overruns;     /* chunks dropped because the ring was full */
+    volatile uint32_t high_water;   /* most chunks waiting at once */
+    uint32_t *stamps;               /* esp_timer time each chunk was published, low 32 bits */
+    volatile TaskHandle_t reader;
+} speech_ring_t;
+
+/**
+ * Allocates room for chunks chunks of chunk samples, in internal RAM when it fits.
+ */
+esp_err_t app_speech_ring_init(speech_ring_t *ring, size_t chunk, size_t chunks);
+
+/**
+ * Slot for the next chunk, NULL when the ring is full and the chunk has to be dropped.
+ */
+int16_t *app_speech_ring_write_begin(speech_ring_t *ring);
+
+/**
+ * Publishes the chunk filled after app_speech_ring_write_begin and wakes the reader.
+ */
+void app_speech_ring_write_end(speech_ring_t *ring);
+
+/**
+ * Oldest unread chunk, NULL on timeout. It stays valid until app_speech_ring_read_end.
+ */
+const int16_t *app_speech_ring_read_begin(speech_ring_t *ring, TickType_t timeout);
+
+void app_speech_ring_read_end(speech_ring_t *ring);
+
+/**
+ * Chunks written and not yet consumed.
+ */
+uint32_t app_speech_ring_used(const speech_ring_t *ring);
+
+/**
+ * Time in microseconds, low 32 bits of esp_timer, at which the chunk
+ * returned by app_speech_ring_read_begin was published.
+ */
+uint32_t app_speech_ring_read_stamp(const speech_ring_t *ring);
+
+#if __cplusplus
+}
+#endif
+#endif
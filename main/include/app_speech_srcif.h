@@ -1,19 +1,21 @@
 #ifndef SRC_IF_H
 #define SRC_IF_H
 
+#include <stdbool.h>
 #include "freertos/FreeRTOS.h"
-#include "freertos/queue.h"
+#include "app_speech_ring.h"
+#include "esp_sr_iface.h"
 /*
 Basic, somewhat quick and dirty, interface for an audio source. The main code uses this to grab samples 
 from whatever input source it instantiates. Here's how to use it:
 
 - Create a src_cfg_t variable
-- Set item_size to the amount of samples per queue read.
-- Set queue to a queue with an item size of (item_size * sizeof(int16_t))
+- Set item_size to the size of one chunk in bytes.
+- Set ring to a ring initialized with chunks of (item_size / sizeof(int16_t)) samples
 - Create a task for the worker function of the input method of your choice (e.g. wavsrcTask). Pass the
   src_cfg_t variable address as the argument.
-- The worker task should now start filling the queue. Receive from it and do with the samples as 
-  you please.
+- The worker task should now start filling the ring. Read chunks from it in place and do with the
+  samples as you please.
 
 Note that at the moment all source interfaces are expected to return signed 16-bit samples at an 16KHz 
 sample rate.
@@ -21,10 +23,44 @@ sample rate.
 
 
 typedef struct {
-    QueueHandle_t *queue;
+    speech_ring_t *ring;
     int item_size; //in bytes
 } src_cfg_t;
 
+typedef struct {
+    uint32_t i2s_overruns;      /* reads that came later than the I2S DMA buffers last */
+    uint32_t ring_overruns;     /* chunks dropped because the ring was full */
+    uint32_t ring_high_water;   /* most chunks waiting at once */
+    uint32_t ring_chunks;
+    uint32_t detected;          /* chunks run through the model */
+    uint32_t silent;            /* chunks the VAD kept from the model */
+    uint32_t late;              /* chunks dropped to catch up while streaming */
+    uint32_t detect_us;         /* mean model time per chunk */
+    uint32_t chunk_us;          /* audio per chunk */
+    const char *model;
+    int det_mode;
+} speech_stats_t;
+
 void recsrcTask(void *arg);
 void app_speech_wakeup_init();
+
+/**
+ * Reads that came later than the I2S DMA buffers could hold audio for.
+ */
+uint32_t app_speech_i2s_overruns();
+
+void app_speech_get_stats(speech_stats_t *stats);
+
+/**
+ * Name of the i-th wake word model linked into the image, lightest first.
+ * NULL past the last one.
+ */
+const char *app_speech_model_name(int i);
+
+bool app_speech_has_model(const char *name);
+
+/**
+ * The wake word model in use and its detection mode, 90 or 95.
+ */
+const esp_sr_iface_t *app_speech_get_model(int *det_mode);
 #endif
@@ -0,0 +1,99 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_STREAM_H_
+#define _APP_STREAM_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "esp_http_server.h"
+#include "app_pipeline.h"
+
+/* One viewer per SoftAP station */
+#define STREAM_MAX_CLIENTS      CONFIG_MAX_STA_CONN
+
+/*
+ * Viewer sockets stay open in the HTTP server until the viewer leaves,
+ * these are on top of them for requests made during the stream.
+ */
+#define STREAM_CONTROL_SOCKETS  3
+
+/**
+ * A viewer that is not an HTTP socket. send is called from its viewer task
+ * for every frame, close once after the viewer was removed or send failed.
+ */
+typedef struct {
+    const char *name;                                   /* transport shown on /status */
+    esp_err_t (*send)(void *arg, frame_desc_t *frame);
+    void (*close)(void *arg);
+    void *arg;
+} stream_sink_t;
+
+void app_stream_init(httpd_handle_t server);
+
+/**
+ * Takes over the socket of a /face_stream request and streams to it from a viewer task.
+ * The first viewer starts the pipeline, the last one leaving stops it again.
+ * Returns ESP_ERR_NO_MEM when all viewer slots are busy.
+ */
+esp_err_t app_stream_add_client(httpd_req_t *req);
+
+/**
+ * Like app_stream_add_client for a /face_crops request. The viewer gets a part
+ * per face found instead of the frames, see CONFIG_FACE_CROPS.
+ */
+esp_err_t app_stream_add_crop_client(httpd_req_t *req);
+
+/**
+ * Adds a viewer that sends frames itself, fd only identifies it in logs and on /status.
+ * Same errors as app_stream_add_client. The sink must stay valid until close was called.
+ */
+esp_err_t app_stream_add_sink(const stream_sink_t *sink, int fd);
+
+/**
+ * Stops sending to a sink, close follows from its viewer task.
+ */
+void app_stream_remove_sink(const stream_sink_t *sink);
+
+int app_stream_client_count();
+
+/**
+ * Disconnects every viewer. The last one leaving stops the pipeline
+ * and returns to waiting for the wake word.
+ */
+void app_stream_stop();
+
+/**
+ * State and viewers as a JSON object, free the string after use.
+ */
+char *app_stream_status_to_json();
+
+/**
+ * Frames skipped for viewers that were still sending an older one.
+ */
+uint32_t app_stream_dropped_frames();
+
+#if __cplusplus
+}
+#endif
+#endif
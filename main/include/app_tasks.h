@@ -0,0 +1,99 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_TASKS_H_
+#define _APP_TASKS_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+
+/*
+ * Every task the application starts. Stack size, priority and core of
+ * each one are set in the table in app_tasks.c and nowhere else.
+ */
+typedef enum {
+    APP_TASK_EVENT,
+    APP_TASK_WARM_START,
+    APP_TASK_PIR,
+    APP_TASK_ENROLL_DISPLAY,
+    APP_TASK_DISPLAY,
+    APP_TASK_PREVIEW,
+    APP_TASK_SPEECH_REC,
+    APP_TASK_SPEECH_NN,
+    APP_TASK_CAPTURE,
+    APP_TASK_DETECT,
+    APP_TASK_DETECT_2,      /* second worker of CONFIG_DETECT_DUAL_WORKER */
+    APP_TASK_FACES,         /* recognition and overlays after two workers */
+    APP_TASK_RECOGNIZE,
+    APP_TASK_ENCODE,
+    APP_TASK_JPEG,          /* lower half of CONFIG_JPEG_ENCODE_DUAL_CORE */
+    APP_TASK_JPEG_DECODE,   /* lower band of CONFIG_JPEG_DECODE_DUAL_CORE */
+    APP_TASK_STREAM_HUB,
+    APP_TASK_VIEWER,
+    APP_TASK_HTTPD,         /* started by esp_http_server from app_httpserver_init */
+    APP_TASK_RTSP,
+    APP_TASK_WS,
+    APP_TASK_ENROLL,
+    APP_TASK_ENROLL_UPLOAD, /* CONFIG_ENROLL_UPLOAD, below the pipeline stages */
+    APP_TASK_FACE_STORE,
+    APP_TASK_STATS,
+    APP_TASK_SLEEP,
+    APP_TASK_SOAK,
+    APP_TASK_OFFLOAD,
+    APP_TASK_BATTERY,
+    APP_TASK_OTA,           /* CONFIG_DELTA_OTA, below the pipeline stages */
+    APP_TASK_MAX,
+} app_task_id_t;
+
+typedef struct {
+    const char *name;
+    uint32_t stack_size;
+    UBaseType_t priority;
+    BaseType_t core;
+} app_task_desc_t;
+
+const app_task_desc_t *app_task_desc(app_task_id_t id);
+
+/**
+ * Creates a task with the placement of its table entry.
+ */
+esp_err_t app_task_create(app_task_id_t id, TaskFunction_t fn, void *arg, TaskHandle_t *handle);
+
+/**
+ * Deletes the calling task, which app_task_create started with this id.
+ */
+void app_task_exit(app_task_id_t id);
+
+/**
+ * Logs the CPU share of every task each CONFIG_TASK_STATS_PERIOD_S seconds.
+ * Does nothing without CONFIG_TASK_STATS.
+ */
+void app_task_stats_init();
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,44 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_THUMBNAIL_H_
+#define _APP_THUMBNAIL_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "dl_lib_matrix3d.h"
+#include "image_util.h"
+
+/**
+ * Dithers the detector input to the OLED with the face boxes on top, at most
+ * CONFIG_OLED_THUMBNAIL_FPS times a second. Image is BGR888 at any scale of a
+ * frame_width x frame_height frame, boxes are in frame coordinates and may be NULL.
+ */
+void app_thumbnail_draw(const dl_matrix3du_t *image, size_t frame_width, size_t frame_height,
+                        const box_array_t *boxes);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,109 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_TRACER_H_
+#define _APP_TRACER_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+/*
+ * Begin and end markers of the pipeline stages, the tasks around them and
+ * the ISRs, kept in a RAM ring while tracing is on, see CONFIG_TRACE. Off,
+ * a marker costs the test of one flag.
+ */
+typedef enum {
+    TRACE_CAPTURE,          /* sensor frame taken from the driver */
+    TRACE_DETECT,           /* decode, motion gate and detector of a worker */
+    TRACE_FACES,            /* recognition, crops and overlays of the faces found */
+    TRACE_RECOGNIZE,        /* recognizer on the second core */
+    TRACE_ENCODE,
+    TRACE_SEND,             /* one frame to one viewer, arg is the socket */
+    TRACE_HTTPD,            /* request handlers of the HTTP server */
+    TRACE_NN,               /* wake word model on one audio chunk */
+    TRACE_REC,              /* audio chunk mixed down into the ring */
+    TRACE_PIR,              /* PIR subscribers called for an edge */
+    TRACE_PIR_ISR,          /* instant, arg is the level */
+    TRACE_BUTTON_ISR,       /* instant */
+    TRACE_LED,              /* instant, arg is the state shown */
+    TRACE_WIFI,             /* instant, arg is the system event */
+    TRACE_DETECT_QUEUE,     /* counter, frames waiting for a worker */
+    TRACE_ENCODE_QUEUE,     /* counter, frames waiting for the encoder */
+    TRACE_AUDIO_QUEUE,      /* counter, audio chunks waiting for the model */
+    TRACE_MAX,
+} trace_id_t;
+
+typedef enum {
+    TRACE_PHASE_BEGIN,
+    TRACE_PHASE_END,
+    TRACE_PHASE_INSTANT,
+    TRACE_PHASE_COUNTER,
+} trace_phase_t;
+
+typedef esp_err_t (*tracer_write_cb)(void *arg, const char *buf, size_t len);
+
+#ifdef CONFIG_TRACE
+extern volatile bool app_tracer_enabled;
+
+/**
+ * Adds an event to the ring, the oldest one is overwritten once it is full.
+ * Lock free, safe to call from an ISR. Use the TRACE_ macros instead.
+ */
+void app_tracer_record(trace_id_t id, trace_phase_t phase, uint32_t arg);
+
+#define TRACE_EVENT(id, phase, arg) do { \
+        if (app_tracer_enabled) { \
+            app_tracer_record((id), (phase), (uint32_t)(arg)); \
+        } \
+    } while (0)
+#else
+#define TRACE_EVENT(id, phase, arg) do { } while (0)
+#endif
+
+#define TRACE_BEGIN(id, arg)    TRACE_EVENT(id, TRACE_PHASE_BEGIN, arg)
+#define TRACE_END(id, arg)      TRACE_EVENT(id, TRACE_PHASE_END, arg)
+#define TRACE_INSTANT(id, arg)  TRACE_EVENT(id, TRACE_PHASE_INSTANT, arg)
+#define TRACE_COUNTER(id, arg)  TRACE_EVENT(id, TRACE_PHASE_COUNTER, arg)
+
+/**
+ * Turns tracing on or off. The ring is allocated the first time tracing is
+ * turned on, and emptied every time. Turned off, the events stay until the
+ * next start.
+ */
+esp_err_t app_tracer_enable(bool enable);
+
+/**
+ * Writes the events in the ring as a Chrome trace JSON object, which
+ * Perfetto and chrome://tracing open. Recording pauses meanwhile.
+ */
+esp_err_t app_tracer_write_json(tracer_write_cb write, void *arg);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,66 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_TRACK_H_
+#define _APP_TRACK_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "fd_forward.h"
+
+/* Faces kept of one detection, the rest of a crowd is dropped */
+#define TRACK_MAX_FACES     8
+
+/**
+ * Detection result owned by the caller and reused for every frame.
+ * array points into box and landmark, it is what the esp-face helpers take.
+ */
+typedef struct {
+    box_t box[TRACK_MAX_FACES];
+    landmark_t landmark[TRACK_MAX_FACES];
+    box_array_t array;
+} track_faces_t;
+
+/**
+ * Forgets the tracked faces, the next frame runs a full frame detection.
+ */
+void app_track_reset();
+
+/**
+ * Runs face_detect and copies its result into faces. The arrays the detector
+ * allocates are freed before returning. Returns the number of faces found.
+ */
+int app_track_face_detect(dl_matrix3du_t *image_matrix, mtmn_config_t *config, track_faces_t *faces);
+
+/**
+ * Detects faces, either over the whole image or, while faces are being tracked,
+ * only in an enlarged region around each face of the previous frame.
+ * A full frame detection runs every CONFIG_FACE_TRACK_FRAMES frames and whenever
+ * a tracked face is lost. Returns the number of faces written to faces.
+ */
+int app_track_detect(dl_matrix3du_t *image_matrix, mtmn_config_t *config, track_faces_t *faces);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -1,6 +1,27 @@
+#include <stdbool.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
 
+/* Set while the station has an address */
+#define WIFI_CONNECTED_BIT  BIT0
+
 extern EventGroupHandle_t g_wifi_event_group;
 
+/**
+ * Initializes NVS and the TCP/IP stack without turning the radio on,
+ * so the HTTP server can be started ahead of it.
+ * app_wifi_init does this itself when it has not been done.
+ */
+void app_wifi_prepare();
+
+/**
+ * Starts the access point or joins a network, as saved in the WiFi settings.
+ * In station mode modem sleep is turned off while frames are streamed.
+ */
 void app_wifi_init();
+
+/**
+ * Keeps modem sleep on in station mode, also while frames are streamed,
+ * at the cost of latency. Can be called before app_wifi_init.
+ */
+void app_wifi_set_power_save(bool force);
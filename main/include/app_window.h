@@ -0,0 +1,56 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_WINDOW_H_
+#define _APP_WINDOW_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "fd_forward.h"
+
+/*
+ * Sensor side zoom on tracked faces, see CONFIG_SENSOR_WINDOW. While faces
+ * are in view the OV2640 is read out in SVGA mode and its DSP scales a window
+ * around them down to the frame size, so frames keep their size but show
+ * the faces with more pixels. Box coordinates are those of the window.
+ */
+
+/**
+ * Moves the window onto the faces of a frame, or back to the full frame once
+ * no face was found for CONFIG_SENSOR_WINDOW_LOST_FRAMES frames. Frames must
+ * be passed in the order they were captured, faces may be NULL.
+ */
+void app_window_update(uint32_t seq, const box_array_t *faces, int width, int height);
+
+/**
+ * True for the first frame read out through a new window, the boxes of
+ * earlier frames do not fit it.
+ */
+bool app_window_moved(uint32_t seq);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,86 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _APP_WS_H_
+#define _APP_WS_H_
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "esp_err.h"
+#include "app_pipeline.h"
+
+#define WS_MAX_CLIENTS      2
+/* listening socket and the clients */
+#define WS_SOCKETS          (1 + WS_MAX_CLIENTS)
+
+/*
+ * Binary messages, multi-byte fields are big endian.
+ *
+ * Client to camera, each one is answered with WS_MSG_RESULT:
+ *   WS_CMD_ENROLL   -                  enroll the next face seen
+ *   WS_CMD_DELETE   id:u16             remove a face, WS_DELETE_OLDEST for the oldest
+ *   WS_CMD_CONFIG   JSON               same body as POST /config
+ *   WS_CMD_METRICS  interval_ms:u16    send WS_MSG_METRICS periodically, 0 stops
+ *   WS_CMD_DISPLAY  flags:u8 then per update page:u8 x0:u8 x1:u8 len:u16 data[len]
+ *                                      columns x0 to x1 of an OLED page, data is PackBits
+ *                                      packed, WS_DISPLAY_FLUSH sends the pages once applied
+ *
+ * Camera to client:
+ *   WS_MSG_RESULT   cmd:u8 err:i32     esp_err_t of the command
+ *   WS_MSG_STATE    state:u8 prev:u8 event:u8
+ *   WS_MSG_METRICS  uptime_ms:u32 heap_internal:u32 heap_spiram:u32 stale_frames:u32
+ *                   viewers:u8 state:u8 free:u8 detect:u8 encode:u8 send:u8
+ *   WS_MSG_FACES    frame:u32 count:u8 then per face id:i16 similarity_pct:u8 x0:i16 y0:i16 x1:i16 y1:i16,
+ *                   for every frame with faces and once when the last one left, as soon as
+ *                   detection is done, also for frames the video skips. frame is the X-Seq
+ *                   of the frame in the stream
+ */
+#define WS_CMD_ENROLL       0x01
+#define WS_CMD_DELETE       0x02
+#define WS_CMD_CONFIG       0x03
+#define WS_CMD_METRICS      0x04
+#define WS_CMD_DISPLAY      0x05
+
+#define WS_MSG_RESULT       0x80
+#define WS_MSG_STATE        0x81
+#define WS_MSG_METRICS      0x82
+#define WS_MSG_FACES        0x83
+
+#define WS_DELETE_OLDEST    0xFFFF
+
+#define WS_DISPLAY_FLUSH    0x01
+
+/**
+ * Starts the WebSocket server on CONFIG_WS_PORT, e.g. ws://192.168.4.1:81/.
+ */
+esp_err_t app_ws_init();
+
+/**
+ * Sends the faces of a frame to all clients, never blocks.
+ */
+void app_ws_publish_faces(const frame_desc_t *frame);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,124 @@
+#!/usr/bin/env python
+#
+# Compares two reports of the performance suite, POST /perf in app_perf.c,
+# and flags what got worse by more than its threshold.
+#
+# usage: perf_compare.py [--scale F] [--all] BASELINE REPORT
+#
+# Reports are flattened to dotted paths, e.g. pipeline.stages.detect.p99_us.
+# The first rule matching a path decides whether it is compared: which way is
+# better, the change in percent and the absolute change that must both be
+# exceeded. Stage times come from histogram buckets, small changes are noise.
+# --scale multiplies the percentages, --all also prints unchanged values.
+# Exits with 1 when something regressed.
+
+from __future__ import print_function
+import json
+import re
+import sys
+
+LOWER = -1      # lower is better
+HIGHER = 1
+EQUAL = 0       # any change is flagged
+
+RULES = [
+    (r'pipeline\.fps$',                         HIGHER, 5, 0.5),
+    (r'pipeline\.stages\.[^.]+\.p50_us$',       LOWER, 10, 1000),
+    (r'pipeline\.stages\.[^.]+\.p99_us$',       LOWER, 20, 2000),
+    (r'pipeline\.dropped\.[^.]+$',              LOWER, 50, 5),
+    (r'speech\.realtime_factor$',               HIGHER, 5, 0.05),
+    (r'speech\.detection_count$',               EQUAL, 0, 0),
+    (r'display\.results\.\d+\.ops\.[^.]+\.mean_us$', LOWER, 10, 50),
+    (r'display\.results\.\d+\.ops\.[^.]+\.(bus_bytes|transactions)$', LOWER, 0, 0),
+    (r'heaps\.[^.]+\.(min_free|largest)$',      HIGHER, 5, 1024),
+    (r'buffer_peaks\.[^.]+$',                   LOWER, 5, 1024),
+    (r'boot\.[^.]+\.ms$',                       LOWER, 20, 50),
+]
+
+
+def flatten(node, prefix='', out=None):
+    if out is None:
+        out = {}
+    if isinstance(node, dict):
+        items = node.items()
+    elif isinstance(node, list):
+        items = enumerate(node)
+    else:
+        out[prefix] = node
+        return out
+    for key, value in items:
+        flatten(value, '%s.%s' % (prefix, key) if prefix else str(key), out)
+    return out
+
+
+def rule_for(path):
+    for pattern, better, pct, minimum in RULES:
+        if re.match(pattern, path):
+            return better, pct, minimum
+    return None
+
+
+def compare(base, new, better, pct, minimum):
+    """Returns 'regressed', 'improved' or None for a change within the threshold."""
+    delta = new - base
+    if better == EQUAL:
+        return 'regressed' if delta else None
+    if abs(delta) <= minimum or abs(delta) <= abs(base) * pct / 100.0:
+        return None
+    return 'improved' if delta * better > 0 else 'regressed'
+
+
+def load(path):
+    with open(path) as f:
+        return json.load(f)
+
+
+def main():
+    args = sys.argv[1:]
+    scale = 1.0
+    show_all = False
+    while args and args[0].startswith('--'):
+        opt = args.pop(0)
+        if opt == '--scale' and args:
+            scale = float(args.pop(0))
+        elif opt == '--all':
+            show_all = True
+        else:
+            args = []
+    if len(args) != 2:
+        print('usage: perf_compare.py [--scale F] [--all] BASELINE REPORT', file=sys.stderr)
+        return 2
+    base = flatten(load(args[0]))
+    new = flatten(load(args[1]))
+
+    regressions = 0
+    improvements = 0
+    for key in ('pipeline.error',):
+        if key in new and key not in base:
+            print('%-48s %s' % (key, new[key]))
+            regressions += 1
+    for path in sorted(set(base) | set(new)):
+        rule = rule_for(path)
+        if not rule:
+            continue
+        if path not in new or path not in base:
+            print('%-48s only in the %s' % (path, 'baseline' if path in base else 'report'))
+            continue
+        better, pct, minimum = rule
+        verdict = compare(base[path], new[path], better, pct * scale, minimum)
+        if verdict == 'regressed':
+            regressions += 1
+        elif verdict == 'improved':
+            improvements += 1
+        elif not show_all:
+            continue
+        change = (new[path] - base[path]) * 100.0 / base[path] if base[path] else 0
+        print('%-48s %12g -> %-12g %+6.1f%%  %s' % (path, base[path], new[path], change,
+                                                    verdict.upper() if verdict else ''))
+
+    print('%d regressions, %d improvements' % (regressions, improvements))
+    return 1 if regressions else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,6 @@
+#
+# Unit tests of the main component, built by the unit-test-app of ESP-IDF
+# with this directory added to EXTRA_COMPONENT_DIRS.
+#
+
+COMPONENT_ADD_LDFLAGS = -Wl,--whole-archive -l$(COMPONENT_NAME) -Wl,--no-whole-archive
@@ -0,0 +1,69 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include "unity.h"
+#include "app_mem.h"
+#include "app_jpeg.h"
+
+/* The quantization tables of an encoded frame, both of them with their index bytes */
+static const uint8_t *test_jpeg_dqt(const frame_jpg_t *jpg)
+{
+    for (size_t i = 0; i + 4 + 2 * 65 <= jpg->len; i++)
+    {
+        if (jpg->buf[i] == 0xFF && jpg->buf[i + 1] == 0xDB)
+        {
+            return jpg->buf + i + 4;
+        }
+    }
+    return NULL;
+}
+
+TEST_CASE("region of interest keeps its quality after the cache has cycled", "[app_jpeg]")
+{
+    // four qualities the other tests do not use fill the cache round robin, the
+    // slot up next is then the one of the first
+    static const uint8_t qualities[] = { 91, 81, 71, 61 };
+    static uint8_t out[4096];
+    static uint8_t ref[2 * 65];
+    frame_jpg_t jpg = { .buf = out, .len = 0, .size = sizeof(out) };
+    dl_matrix3du_t *matrix = app_mem_matrix_alloc(APP_MEM_FRAME, 32, 16, 3);
+    TEST_ASSERT_NOT_NULL(matrix);
+    memset(matrix->item, 0x80, 32 * 16 * 3);
+
+    for (int i = 0; i < sizeof(qualities); i++)
+    {
+        TEST_ASSERT_TRUE(app_jpeg_encode(matrix, qualities[i], &jpg));
+        if (i == 0)
+        {
+            TEST_ASSERT_NOT_NULL(test_jpeg_dqt(&jpg));
+            memcpy(ref, test_jpeg_dqt(&jpg), sizeof(ref));
+        }
+    }
+
+    box_t box = { .box_p = { 0, 0, 8, 8 } };
+    TEST_ASSERT_TRUE(app_jpeg_encode_roi(matrix, qualities[0], 51, &box, 1, &jpg));
+    TEST_ASSERT_NOT_NULL(test_jpeg_dqt(&jpg));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(ref, test_jpeg_dqt(&jpg), sizeof(ref));
+
+    app_mem_matrix_free(APP_MEM_FRAME, matrix);
+}
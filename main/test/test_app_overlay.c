@@ -0,0 +1,92 @@
+/* ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include "unity.h"
+#include "app_overlay.h"
+
+/* Segments of an 8x8 grayscale JPEG up to its scan, with ac_counts for the AC table */
+static size_t test_jpeg_header(uint8_t *buf, const uint8_t ac_counts[16])
+{
+    static const uint8_t head[] = {
+        0xFF, 0xD8,
+        0xFF, 0xDB, 0x00, 0x43, 0x00,
+    };
+    static const uint8_t sof_dc[] = {
+        0xFF, 0xC0, 0x00, 0x0B, 0x08, 0x00, 0x08, 0x00, 0x08, 0x01, 0x01, 0x11, 0x00,
+        // one DC code of length 1
+        0xFF, 0xC4, 0x00, 0x14, 0x00, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x00,
+    };
+    static const uint8_t sos[] = {
+        0xFF, 0xDA, 0x00, 0x08, 0x01, 0x01, 0x01, 0x00, 0x3F, 0x00,
+        0x00, 0xFF, 0xD9,
+    };
+    size_t len = 0;
+    int total = 0;
+
+    memcpy(buf + len, head, sizeof(head));
+    len += sizeof(head);
+    memset(buf + len, 1, 64);
+    len += 64;
+    memcpy(buf + len, sof_dc, sizeof(sof_dc));
+    len += sizeof(sof_dc);
+
+    for (int l = 0; l < 16; l++)
+    {
+        total += ac_counts[l];
+    }
+    buf[len++] = 0xFF;
+    buf[len++] = 0xC4;
+    buf[len++] = (2 + 17 + total) >> 8;
+    buf[len++] = 2 + 17 + total;
+    buf[len++] = 0x11;
+    memcpy(buf + len, ac_counts, 16);
+    len += 16;
+    for (int i = 0; i < total; i++)
+    {
+        buf[len++] = i;
+    }
+
+    memcpy(buf + len, sos, sizeof(sos));
+    len += sizeof(sos);
+    return len;
+}
+
+TEST_CASE("an oversubscribed Huffman table is rejected", "[app_overlay]")
+{
+    // two codes of length 1 fill the code space, sixteen of them would index far
+    // past the 256 entry lookup tables of the last table in the parser state
+    static const uint8_t complete[16] = { 2 };
+    static const uint8_t oversubscribed[16] = { 16 };
+    static uint8_t src[512];
+    static uint8_t out[512];
+    frame_jpg_t jpg = { .buf = out, .len = 0, .size = sizeof(out) };
+    overlay_t overlay;
+
+    // the overlay does not match the frame, a header that parses ends there
+    app_overlay_reset(&overlay, 16, 16);
+    size_t len = test_jpeg_header(src, complete);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, app_overlay_compose(src, len, &overlay, &jpg));
+
+    len = test_jpeg_header(src, oversubscribed);
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, app_overlay_compose(src, len, &overlay, &jpg));
+}
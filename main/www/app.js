@@ -0,0 +1,80 @@
+// Viewer and controls on top of /face_stream, /status, /camera and /faces
+(function () {
+    'use strict';
+
+    function $(id) { return document.getElementById(id); }
+
+    function request(method, url, body) {
+        return fetch(url, {
+            method: method,
+            headers: body ? { 'Content-Type': 'application/json' } : {},
+            body: body ? JSON.stringify(body) : undefined,
+        }).then(function (res) {
+            if (!res.ok) throw new Error(res.status + ' ' + res.statusText);
+            return res.json();
+        });
+    }
+
+    // the stream is refused until the wake word or the PIR woke the board up
+    var stream = $('stream');
+    function openStream() {
+        stream.src = '/face_stream?t=' + Date.now();
+    }
+    stream.onload = function () { $('hint').textContent = ''; };
+    stream.onerror = function () {
+        $('hint').textContent = 'Waiting for the wakeup';
+        setTimeout(openStream, 3000);
+    };
+
+    function showStatus(status) {
+        $('state').textContent = status.state;
+        $('status').textContent = 'up ' + status.uptime + ' s, ' + status.viewers.length + ' viewers, ' +
+            Math.round(status.heap_internal / 1024) + ' KB internal free';
+    }
+
+    function pollStatus() {
+        request('GET', '/status').then(showStatus).catch(function () {}).then(function () {
+            setTimeout(pollStatus, 2000);
+        });
+    }
+
+    var camera = $('camera');
+    function showCamera(settings) {
+        Array.prototype.forEach.call(camera.querySelectorAll('[name]'), function (input) {
+            if (input.type === 'checkbox') input.checked = settings[input.name];
+            else input.value = settings[input.name];
+        });
+    }
+    camera.addEventListener('change', function (e) {
+        var input = e.target, body = {};
+        body[input.name] = input.type === 'checkbox' ? input.checked : parseInt(input.value, 10);
+        request('POST', '/camera', body).then(showCamera).catch(function (err) { alert(err.message); });
+    });
+
+    function showFaces(list) {
+        var ul = $('faces');
+        $('count').textContent = list.faces.length + '/' + list.capacity;
+        ul.textContent = '';
+        list.faces.forEach(function (face) {
+            var li = document.createElement('li'), name = document.createElement('input'),
+                del = document.createElement('button');
+            name.value = face.name;
+            name.placeholder = 'ID ' + face.id;
+            name.onchange = function () {
+                request('POST', '/faces', { id: face.id, name: name.value }).then(showFaces);
+            };
+            del.textContent = 'Delete';
+            del.onclick = function () {
+                request('POST', '/faces', { id: face.id, delete: true }).then(showFaces);
+            };
+            li.appendChild(name);
+            li.appendChild(del);
+            ul.appendChild(li);
+        });
+    }
+
+    openStream();
+    pollStatus();
+    request('GET', '/camera').then(showCamera);
+    request('GET', '/faces').then(showFaces);
+})();
@@ -0,0 +1,89 @@
+#!/usr/bin/env python
+#
+# Packs the web UI into an image for the "www" partition, read by app_www.c.
+#
+# usage: mkwww.py OUTPUT FILE...
+#
+# Every file is gzipped and served at /<name>, index.html at /. The image is
+# a header (magic, count), a directory of www_file_t entries and the data:
+#   path[32] type[32] offset length crc max_age, all little endian.
+# "@name@" in index.html is replaced by the ETag of that file, so the other
+# files can be cached for a year and index.html is always revalidated.
+
+from __future__ import print_function
+import gzip
+import io
+import os
+import struct
+import sys
+import zlib
+
+WWW_MAGIC = 0x31575757      # "WWW1"
+WWW_MAX_FILES = 4
+WWW_PARTITION_SIZE = 48 * 1024
+ENTRY = struct.Struct('<32s32sIIII')
+HEADER = struct.Struct('<II')
+
+TYPES = {
+    '.html': 'text/html',
+    '.js': 'application/javascript',
+    '.css': 'text/css',
+    '.svg': 'image/svg+xml',
+    '.ico': 'image/x-icon',
+}
+
+YEAR = 365 * 24 * 3600
+
+
+def compress(data):
+    buf = io.BytesIO()
+    # no name and no time in the header, the same input always packs the same
+    with gzip.GzipFile(filename='', mode='wb', compresslevel=9, fileobj=buf, mtime=0) as f:
+        f.write(data)
+    return buf.getvalue()
+
+
+def main():
+    if len(sys.argv) < 3:
+        print('usage: mkwww.py OUTPUT FILE...', file=sys.stderr)
+        return 1
+    files = sorted(sys.argv[2:], key=lambda p: os.path.basename(p) == 'index.html')
+    if len(files) > WWW_MAX_FILES:
+        print('at most %d files' % WWW_MAX_FILES, file=sys.stderr)
+        return 1
+
+    packed = []
+    etags = {}
+    for path in files:
+        name = os.path.basename(path)
+        with open(path, 'rb') as f:
+            data = f.read()
+        if name == 'index.html':
+            for other, crc in etags.items():
+                data = data.replace(('@%s@' % other).encode(), ('%08x' % crc).encode())
+        gz = compress(data)
+        crc = zlib.crc32(gz) & 0xffffffff
+        etags[name] = crc
+        uri = '/' if name == 'index.html' else '/' + name
+        packed.append((uri, TYPES.get(os.path.splitext(name)[1], 'application/octet-stream'),
+                       gz, crc, 0 if name == 'index.html' else YEAR))
+
+    offset = HEADER.size + ENTRY.size * len(packed)
+    header = HEADER.pack(WWW_MAGIC, len(packed))
+    directory = b''
+    data = b''
+    for uri, mime, gz, crc, max_age in packed:
+        directory += ENTRY.pack(uri.encode(), mime.encode(), offset + len(data), len(gz), crc, max_age)
+        data += gz
+    image = header + directory + data
+    if len(image) > WWW_PARTITION_SIZE:
+        print('%d bytes do not fit the www partition' % len(image), file=sys.stderr)
+        return 1
+    with open(sys.argv[1], 'wb') as f:
+        f.write(image)
+    print('www: %d files, %d bytes' % (len(packed), len(image)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())